@@ -21,7 +21,7 @@
 
 #include "CommPort.h"
 
-const String ECommError::ErrorString[19] = {
+const String ECommError::ErrorString[22] = {
     "BAD_SERIAL_PORT"    ,
     "BAD_BAUD_RATE"      ,
     "BAD_PORT_NUMBER"    ,
@@ -41,6 +41,9 @@ const String ECommError::ErrorString[19] = {
     "SETUPCOMM"          ,
     "SETCOMMTIMEOUTS"    ,
     "CLEARCOMMERROR"     ,
+    "CREATEEVENT"        ,
+    "NOT_OVERLAPPED"     ,
+    "READ_PENDING"       ,
 };
 
 ECommError::ECommError( ErrorType error)
@@ -118,9 +121,14 @@ TCommPort::TCommPort( DWORD ReadTimeOut, DWORD WriteTimeOut )
     m_CommPort( _D( "\\\\.\\COM1" ) ),
     m_hCom(0),
     m_readTimeOut( ReadTimeOut ),
-    m_writeTimeOut( WriteTimeOut )
+    m_writeTimeOut( WriteTimeOut ),
+    m_overlapped( false ),
+    m_readPending( false )
 
 {
+    ZeroMemory(&m_readOv, sizeof(OVERLAPPED));
+    ZeroMemory(&m_writeOv, sizeof(OVERLAPPED));
+
     // initialize the comm port to  N81 9600 baud communications.  These values
     // will be used to initialize the port if OpenCommPort is called before any
     // of the SetXXXX functions are called.
@@ -183,7 +191,7 @@ void TCommPort::OpenCommPort()
                         0,    /* comm devices must be opened w/exclusive-access */
                         NULL, /* no security attrs */
                         OPEN_EXISTING, /* comm devices must use OPEN_EXISTING */
-                        0,    /* not overlapped I/O */
+                        m_overlapped ? FILE_FLAG_OVERLAPPED : 0,
                         NULL  /* hTemplate must be NULL for comm devices */
                         );
 
@@ -234,6 +242,10 @@ void TCommPort::OpenCommPort()
     m_TimeOuts.ReadTotalTimeoutMultiplier  = 0;
 //    m_TimeOuts.ReadTotalTimeoutConstant    = 1000;
     m_TimeOuts.ReadTotalTimeoutConstant    = m_readTimeOut;
+    // In overlapped mode a read waits for all its bytes (no comm timeouts):
+    // the deadline is enforced on each operation by EndRead().
+    if(m_overlapped)
+        m_TimeOuts.ReadTotalTimeoutConstant = 0;
 
     m_TimeOuts.WriteTotalTimeoutMultiplier = 0;
 //    m_TimeOuts.WriteTotalTimeoutConstant   = 1000;
@@ -246,6 +258,19 @@ void TCommPort::OpenCommPort()
         throw ECommError(ECommError::ErrorType::SETCOMMTIMEOUTS);
     }
 
+    // overlapped mode needs a completion event for reads and one for writes
+    if(m_overlapped)
+    {
+        m_readOv.hEvent  = CreateEvent(NULL, TRUE, FALSE, NULL);
+        m_writeOv.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        if(!m_readOv.hEvent || !m_writeOv.hEvent)
+        {
+            CloseEvents();
+            CloseHandle(m_hCom);
+            throw ECommError(ECommError::ErrorType::CREATEEVENT);
+        }
+    }
+
     // if we made it to here then success
     m_CommOpen = true;
 }
@@ -268,12 +293,34 @@ void TCommPort::OpenCommPort()
 void TCommPort::CloseCommPort() noexcept
 {
     if ( m_CommOpen ) {
+        if ( m_readPending ) {
+            // the buffer of a pending read must not be written after we return;
+            // CancelIoEx() also reaches a read started by another thread
+            DWORD dummy;
+            if ( ::CancelIoEx( m_hCom, &m_readOv ) || ::GetLastError() != ERROR_NOT_FOUND ) {
+                ::GetOverlappedResult( m_hCom, &m_readOv, &dummy, TRUE );
+            }
+            m_readPending = false;
+        }
         if ( m_hCom != INVALID_HANDLE_VALUE ) {
             ::CloseHandle( m_hCom );
         }
+        CloseEvents();
         m_CommOpen = false;
     }
 }
+
+void TCommPort::CloseEvents() noexcept
+{
+    if ( m_readOv.hEvent ) {
+        ::CloseHandle( m_readOv.hEvent );
+        m_readOv.hEvent = NULL;
+    }
+    if ( m_writeOv.hEvent ) {
+        ::CloseHandle( m_writeOv.hEvent );
+        m_writeOv.hEvent = NULL;
+    }
+}
 ///// end of TCommPort::CloseCommPort
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -451,6 +498,52 @@ void TCommPort::SetStopBits(BYTE newStopBits)
 ///// end of TCommPort::SetParity()
 ////////////////////////////////////////////////////////////////////////////////
 
+////////////////////////////////////////////////////////////////////////////////
+/////  TCommPort::SetReadTimeOut()
+/////
+/////       scope:  TCommPort public function.
+/////    purpose :  set the total read timeout (ReadTotalTimeoutConstant).
+/////       args :  DWORD of the new timeout in milliseconds.
+/////    remarks :  If the port is open, SetCommTimeouts is called at once;
+/////               otherwise the value is used by the next OpenCommPort().
+/////               In overlapped mode it is only the default timeout of
+/////               ReadBytes() and GetByte(): the comm timeouts stay at 0.
+void TCommPort::SetReadTimeOut(DWORD newReadTimeOut)
+{
+    DWORD oldReadTimeOut = m_readTimeOut;  // make a backup of the old timeout
+    m_readTimeOut = newReadTimeOut;
+
+    if(m_CommOpen && !m_overlapped)
+    {
+        m_TimeOuts.ReadTotalTimeoutConstant = m_readTimeOut;
+        if(!SetCommTimeouts(m_hCom, &m_TimeOuts))
+        {
+            m_readTimeOut = oldReadTimeOut;
+            m_TimeOuts.ReadTotalTimeoutConstant = m_readTimeOut;
+            throw ECommError(ECommError::ErrorType::SETCOMMTIMEOUTS);
+        }
+    }
+}
+///// end of TCommPort::SetReadTimeOut()
+////////////////////////////////////////////////////////////////////////////////
+
+DWORD TCommPort::GetReadTimeOut() const noexcept
+{
+  return m_readTimeOut;
+}
+
+void TCommPort::SetOverlapped(bool newOverlapped)
+{
+    VerifyClosed();   // the mode is chosen by CreateFile
+
+    m_overlapped = newOverlapped;
+}
+
+bool TCommPort::GetOverlapped() const noexcept
+{
+  return m_overlapped;
+}
+
 unsigned int TCommPort::GetBaudRate() const noexcept
 {
   return m_dcb.BaudRate;
@@ -474,24 +567,20 @@ BYTE TCommPort::GetStopBits() const noexcept
 void TCommPort::WriteBuffer(BYTE *buffer, unsigned int ByteCount)
 {
     VerifyOpen();
-    DWORD dummy;
     if( (ByteCount == 0) || (buffer == NULL))
         return;
 
-    if(!WriteFile(m_hCom,buffer,ByteCount,&dummy,NULL))
-        throw ECommError(ECommError::ErrorType::WRITE_ERROR);
+    Write(buffer, ByteCount);
 }
 
 void TCommPort::WriteBufferSlowly(BYTE *buffer, unsigned int ByteCount)
 {
     VerifyOpen();
-    DWORD dummy;
     BYTE *ptr = buffer;
 
     for (unsigned int j=0; j<ByteCount; j++)
     {
-        if(!WriteFile(m_hCom,ptr,1,&dummy,NULL))
-            throw ECommError(ECommError::ErrorType::WRITE_ERROR);
+        Write(ptr, 1);
 
         // Use FlushCommPort to wait until the character has been sent.
         FlushCommPort();
@@ -503,23 +592,139 @@ void TCommPort::WriteString(const char *outString)
 {
     VerifyOpen();
 
-    DWORD dummy;
-    if(!WriteFile(m_hCom,outString, strlen(outString),&dummy,NULL))
-        throw ECommError(ECommError::ErrorType::WRITE_ERROR);
+    Write(outString, strlen(outString));
 }
 
 unsigned int TCommPort::ReadBytes(BYTE *buffer, unsigned int MaxBytes)
 {
     VerifyOpen();
-    unsigned int bytes_read;
 
-    if(!ReadFile(m_hCom,buffer,MaxBytes,(unsigned long*)&bytes_read,NULL)) {
+    return Read(buffer, MaxBytes, m_readTimeOut);
+}
+
+unsigned int TCommPort::ReadBytes(BYTE *buffer, unsigned int MaxBytes, DWORD TimeOut)
+{
+    VerifyOpen();
+
+    return Read(buffer, MaxBytes, TimeOut);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/////  TCommPort::BeginRead()
+/////
+/////       scope:  TCommPort public function.
+/////    purpose :  start an overlapped read and return at once.
+/////       args :  buffer and number of bytes to read.
+/////    remarks :  The comm timeouts are 0 in overlapped mode, so the read
+/////               completes (and the read event is signalled) only when all
+/////               the bytes have arrived, or when EndRead() cancels it.
+void TCommPort::BeginRead(BYTE *buffer, unsigned int MaxBytes)
+{
+    VerifyOverlapped();
+    VerifyNoPendingRead();
+
+    ResetEvent(m_readOv.hEvent);
+    m_readOv.Offset = m_readOv.OffsetHigh = 0;
+
+    DWORD dummy;
+    if(!ReadFile(m_hCom,buffer,MaxBytes,&dummy,&m_readOv) && GetLastError() != ERROR_IO_PENDING)
         throw ECommError(ECommError::ErrorType::READ_ERROR);
+    m_readPending = true;
+}
+///// end of TCommPort::BeginRead()
+////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////
+/////  TCommPort::EndRead()
+/////
+/////       scope:  TCommPort public function.
+/////    purpose :  complete the read started by BeginRead().
+/////       args :  DWORD of the longest wait in milliseconds.
+/////    returns :  number of bytes read.
+/////    remarks :  When the wait expires the read is cancelled; the bytes
+/////               already transferred to the buffer are still counted.
+/////               CancelIoEx() cancels the read even if BeginRead() ran on
+/////               another thread; ERROR_NOT_FOUND means it had completed.
+unsigned int TCommPort::EndRead(DWORD TimeOut)
+{
+    VerifyOverlapped();
+    if(!m_readPending)
+        return 0;
+
+    if(WaitForSingleObject(m_readOv.hEvent, TimeOut) != WAIT_OBJECT_0 &&
+       !CancelIoEx(m_hCom, &m_readOv) && GetLastError() != ERROR_NOT_FOUND)
+        throw ECommError(ECommError::ErrorType::READ_ERROR);
+    m_readPending = false;
+
+    DWORD bytes_read = 0;
+    if(!GetOverlappedResult(m_hCom,&m_readOv,&bytes_read,TRUE) &&
+       GetLastError() != ERROR_OPERATION_ABORTED)
+        throw ECommError(ECommError::ErrorType::READ_ERROR);
+
+    return bytes_read;
+}
+///// end of TCommPort::EndRead()
+////////////////////////////////////////////////////////////////////////////////
+
+int TCommPort::WaitForRead(TCommPort * const *Ports, size_t Count, DWORD TimeOut)
+{
+    HANDLE Events[MAXIMUM_WAIT_OBJECTS];
+    int    Index[MAXIMUM_WAIT_OBJECTS];
+    DWORD  EventCount = 0;
+
+    for(size_t i = 0; i < Count && EventCount < MAXIMUM_WAIT_OBJECTS; ++i)
+    {
+        if(Ports[i]->m_readPending)
+        {
+            Events[EventCount] = Ports[i]->m_readOv.hEvent;
+            Index[EventCount++] = static_cast<int>(i);
+        }
+    }
+    if(!EventCount)
+        return -1;
+
+    DWORD Result = WaitForMultipleObjects(EventCount, Events, FALSE, TimeOut);
+    if(Result >= WAIT_OBJECT_0 && Result < WAIT_OBJECT_0 + EventCount)
+        return Index[Result - WAIT_OBJECT_0];
+    return -1;
+}
+
+DWORD TCommPort::Read(void *buffer, DWORD byteCount, DWORD TimeOut)
+{
+    if(m_overlapped)
+    {
+        BeginRead(static_cast<BYTE*>(buffer), byteCount);
+        return EndRead(TimeOut);
     }
 
+    if(TimeOut != m_readTimeOut)
+        SetReadTimeOut(TimeOut);
+
+    DWORD bytes_read;
+    if(!ReadFile(m_hCom,buffer,byteCount,&bytes_read,NULL))
+        throw ECommError(ECommError::ErrorType::READ_ERROR);
     return bytes_read;
 }
 
+void TCommPort::Write(const void *buffer, DWORD byteCount)
+{
+    DWORD dummy;
+    if(!m_overlapped)
+    {
+        if(!WriteFile(m_hCom,buffer,byteCount,&dummy,NULL))
+            throw ECommError(ECommError::ErrorType::WRITE_ERROR);
+        return;
+    }
+
+    // the write timeouts still apply: GetOverlappedResult cannot wait forever
+    ResetEvent(m_writeOv.hEvent);
+    m_writeOv.Offset = m_writeOv.OffsetHigh = 0;
+    if(!WriteFile(m_hCom,buffer,byteCount,&dummy,&m_writeOv) && GetLastError() != ERROR_IO_PENDING)
+        throw ECommError(ECommError::ErrorType::WRITE_ERROR);
+    if(!GetOverlappedResult(m_hCom,&m_writeOv,&dummy,TRUE))
+        throw ECommError(ECommError::ErrorType::WRITE_ERROR);
+}
+
 unsigned int TCommPort::ReadString(char *str, unsigned int MaxBytes)
 {
     VerifyOpen();
@@ -589,9 +794,7 @@ void TCommPort::PutByte(BYTE value)
 {
     VerifyOpen();
 
-    DWORD dummy;
-    if(!WriteFile(m_hCom,&value,1,&dummy,NULL))
-        throw ECommError(ECommError::ErrorType::WRITE_ERROR);
+    Write(&value, 1);
 }
 
 
@@ -599,11 +802,8 @@ BYTE TCommPort::GetByte()
 {
     VerifyOpen();
 
-    DWORD dummy;
     BYTE  value;
-    if(!ReadFile(m_hCom,&value,1,&dummy,NULL)) {
-        throw ECommError(ECommError::ErrorType::READ_ERROR);
-    }
+    static_cast<void>( Read(&value, 1, m_readTimeOut) );
 
     return value;
 }
@@ -11,6 +11,11 @@
  *
  *  ECommError is thrown by TCommPort whenever an API call fails; inspect the
  *  @c Error member for the ErrorType and @c Errno for the Win32 last-error code.
+ *
+ *  In overlapped mode (SetOverlapped()) the port is opened with FILE_FLAG_OVERLAPPED:
+ *  every read carries its own timeout instead of the port-wide COMMTIMEOUTS, and a read
+ *  can be started with BeginRead() and completed later, so that one thread can wait on
+ *  the reads of many ports at once (WaitForRead()).
  */
 
 //---------------------------------------------------------------------------
@@ -68,7 +73,10 @@ public:
         SETCOMMSTATE       ,  ///< SetCommState() failed.
         SETUPCOMM          ,  ///< SetupComm() failed.
         SETCOMMTIMEOUTS    ,  ///< SetCommTimeouts() failed.
-        CLEARCOMMERROR        ///< ClearCommError() failed.
+        CLEARCOMMERROR     ,  ///< ClearCommError() failed.
+        CREATEEVENT        ,  ///< CreateEvent() failed (overlapped mode).
+        NOT_OVERLAPPED     ,  ///< Operation requires overlapped mode.
+        READ_PENDING          ///< A read started with BeginRead() has not been completed.
     };
 
     /**
@@ -81,7 +89,7 @@ public:
     DWORD     Errno;  ///< Win32 error code from GetLastError() at the time of failure.
 private:
     static String FormatErrorMessage( ErrorType Err );
-    static const String ErrorString[19];
+    static const String ErrorString[22];
 };
 
 /**
@@ -120,7 +128,11 @@ class TCommPort
     /** @brief Opens the COM port using the currently configured parameters. @throws ECommError on failure. */
     void OpenCommPort();
 
-    /** @brief Closes the COM port. @throws ECommError on failure. */
+    /**
+     * @brief Closes the COM port.
+     * @details A pending overlapped read is cancelled and waited for first, even when
+     *  another thread started it, so its buffer is no longer written after the call.
+     */
     void CloseCommPort() noexcept;
 
     /** @brief Sets the COM port device name (e.g., L"COM3" or L"\\\\.\\COM10"). */
@@ -148,6 +160,19 @@ class TCommPort
     /** @brief Returns the configured stop bits. */
     [[ nodiscard ]] BYTE GetStopBits() const noexcept;
 
+    /** @brief Sets the read timeout in milliseconds; applied at once if the port is open. */
+    void SetReadTimeOut(DWORD newReadTimeOut);
+    /** @brief Returns the read timeout in milliseconds. */
+    [[ nodiscard ]] DWORD GetReadTimeOut() const noexcept;
+
+    /**
+     * @brief Selects overlapped (event-driven) I/O for the next OpenCommPort().
+     * @throws ECommError (PORT_ALREADY_OPEN) if the port is open.
+     */
+    void SetOverlapped(bool newOverlapped);
+    /** @brief Returns @c true if the port uses (or will use) overlapped I/O. */
+    [[ nodiscard ]] bool GetOverlapped() const noexcept;
+
     /** @brief Applies a raw DCB structure (prefer the Set* methods instead). */
     void SetCommDCBProperties(DCB &properties);
     /** @brief Retrieves the current DCB structure. */
@@ -178,6 +203,58 @@ class TCommPort
      */
     [[ nodiscard ]] unsigned int ReadBytes(BYTE *bytes, unsigned int byteCount);
 
+    /**
+     * @brief Reads up to @p byteCount bytes, waiting at most @p TimeOut ms for them.
+     * @details In overlapped mode the timeout belongs to this read only.  Otherwise it
+     *  becomes the port read timeout (SetReadTimeOut(), one SetCommTimeouts() call
+     *  whenever it changes).
+     * @return Number of bytes actually read (less than @p byteCount on timeout).
+     * @throws ECommError on I/O error (non-timeout).
+     */
+    [[ nodiscard ]] unsigned int ReadBytes(BYTE *bytes, unsigned int byteCount, DWORD TimeOut);
+
+    /**
+     * @brief Starts an overlapped read of @p byteCount bytes into @p bytes.
+     * @details The buffer must stay valid until EndRead() (or CloseCommPort()).  The event
+     *  returned by GetReadEvent() is signalled when all the bytes have arrived.
+     * @throws ECommError (NOT_OVERLAPPED, READ_PENDING, READ_ERROR).
+     */
+    void BeginRead(BYTE *bytes, unsigned int byteCount);
+
+    /**
+     * @brief Completes the read started by BeginRead(), waiting at most @p TimeOut ms.
+     * @details On timeout the read is cancelled and the bytes received so far are counted.
+     *  The cancel (CancelIoEx()) does not depend on the thread that called BeginRead().
+     *  Without a pending read, returns 0 at once.
+     * @return Number of bytes read.
+     * @throws ECommError (NOT_OVERLAPPED, READ_ERROR).
+     */
+    [[ nodiscard ]] unsigned int EndRead(DWORD TimeOut = 0);
+
+    /** @brief Returns @c true between BeginRead() and EndRead(). */
+    [[ nodiscard ]] bool IsReadPending() const noexcept
+    {
+        return m_readPending;
+    }
+
+    /**
+     * @brief Returns the manual-reset event signalled when the pending read completes
+     *        (overlapped mode, port open), for use with WaitForMultipleObjects().
+     */
+    [[ nodiscard ]] HANDLE GetReadEvent() const noexcept
+    {
+        return m_readOv.hEvent;
+    }
+
+    /**
+     * @brief Waits until the pending read of one of @p Ports completes.
+     * @details Ports without a pending read are skipped; at most MAXIMUM_WAIT_OBJECTS
+     *  ports can be waited on.  Complete the read with EndRead() on the returned port.
+     * @return Index in @p Ports of a port whose read completed, or -1 on timeout (or if no
+     *  port has a pending read).
+     */
+    [[ nodiscard ]] static int WaitForRead(TCommPort * const *Ports, size_t Count, DWORD TimeOut);
+
     /** @brief Discards up to @p MaxBytes bytes from the receive buffer. */
     void DiscardBytes(unsigned int MaxBytes);
 
@@ -236,6 +313,22 @@ class TCommPort
         if(m_CommOpen)
             throw ECommError(ECommError::ErrorType::PORT_ALREADY_OPEN) ;
     }
+    void VerifyOverlapped()
+    {
+        VerifyOpen();
+        if(!m_overlapped)
+            throw ECommError(ECommError::ErrorType::NOT_OVERLAPPED) ;
+    }
+    void VerifyNoPendingRead()
+    {
+        if(m_readPending)
+            throw ECommError(ECommError::ErrorType::READ_PENDING) ;
+    }
+
+    // Single entry points for ReadFile/WriteFile in both modes
+    DWORD Read(void *buffer, DWORD byteCount, DWORD TimeOut);
+    void Write(const void *buffer, DWORD byteCount);
+    void CloseEvents() noexcept;
 
   // this stuff is private because we want to hide these details from clients
     bool           m_CommOpen;
@@ -245,6 +338,10 @@ class TCommPort
     HANDLE         m_hCom;       // handle to the comm port.
     DWORD          m_readTimeOut;
     DWORD          m_writeTimeOut;
+    bool           m_overlapped;
+    bool           m_readPending;
+    OVERLAPPED     m_readOv;     // overlapped mode: read and write operations and
+    OVERLAPPED     m_writeOv;    // their manual-reset completion events
 };
 
 //---------------------------------------------------------------------------
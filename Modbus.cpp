@@ -1,9 +1,13 @@
 
 #pragma hdrstop
 
+#include <chrono>
 #include <memory>
+#include <thread>
+#include <vector>
 
 #include "Modbus.h"
+#include "ModbusPDU.h"
 
 //---------------------------------------------------------------------------
 namespace Modbus {
@@ -20,7 +24,7 @@ void DebugBytesToHex( String Prologue, TBytes Data )
 #endif
 }
 
-static const String ExceptionCodeText[8] = {
+static const String ExceptionCodeText[11] = {
     _D( "Illegal Function" ),
     _D( "Illegal Data Address" ),
     _D( "Illegal Data Value" ),
@@ -29,9 +33,12 @@ static const String ExceptionCodeText[8] = {
     _D( "Slave Device Busy" ),
     _D( "Negative Acknowledge" ),
     _D( "Memory Parity Error" ),
+    _D( "Unknown Exception" ),
+    _D( "Gateway Path Unavailable" ),
+    _D( "Gateway Target Device Failed to Respond" ),
 };
 
-static const String ExceptionCodeDescription[8] = {
+static const String ExceptionCodeDescription[11] = {
     _D( "The function code received in the query "
         "is not an allowable action for the slave. "
         "If a Poll Program Complete command "
@@ -77,6 +84,17 @@ static const String ExceptionCodeDescription[8] = {
         "the memory. The master can retry the "
         "request, but service may be required on "
         "the slave device." ),
+
+    _D( "Exception code 9 is not defined by the "
+        "Modbus application protocol." ),
+
+    _D( "The gateway could not allocate a path "
+        "from the input port to the output port: "
+        "it is misconfigured or overloaded." ),
+
+    _D( "No response was obtained from the target "
+        "device behind the gateway, usually because "
+        "it is not present on the network." ),
 };
 //---------------------------------------------------------------------------
 
@@ -121,17 +139,272 @@ void RaiseStandardException( Context const & Context, ExceptionCode Code,
         case ExceptionCode::SlaveDeviceBusy:     throw ESlaveDeviceBusy( Context, Prefix );
         case ExceptionCode::NegativeAcknowledge: throw ENegativeAcknowledge( Context, Prefix );
         case ExceptionCode::MemoryParityError:   throw EMemoryParityError( Context, Prefix );
+        case ExceptionCode::GatewayPathUnavailable:
+            throw EGatewayPathUnavailable( Context, Prefix );
+        case ExceptionCode::GatewayTargetFailedToRespond:
+            throw EGatewayTargetFailedToRespond( Context, Prefix );
         default:
             throw EProtocolException(
                 Context, Code, _D( "Unknown Modbus exception code" )
             );
     }
 }
+//---------------------------------------------------------------------------
+
+static Request MakeRequest( FunctionCode FnCode, Context::SlaveAddrType SlaveAddr,
+                            uint16_t Addr, uint16_t PointCount )
+{
+    Request Req {};
+    Req.FnCode = FnCode;
+    Req.SlaveAddr = SlaveAddr;
+    Req.Addr = Addr;
+    Req.PointCount = PointCount;
+    Req.Status = RequestStatus::Pending;
+    return Req;
+}
+//---------------------------------------------------------------------------
+
+String DeviceIdentification::GetText( DeviceObjectId Id ) const
+{
+    auto const It = Objects.find( static_cast<DeviceObjectIdType>( Id ) );
+    return It != Objects.end() ? String( It->second.c_str() ) : String();
+}
+//---------------------------------------------------------------------------
+
+Request Request::ReadCoilStatus( Context::SlaveAddrType SlaveAddr,
+                                 CoilAddrType StartAddr, CoilCountType PointCount,
+                                 CoilDataType* Data )
+{
+    Request Req =
+        MakeRequest( FunctionCode::ReadCoilStatus, SlaveAddr, StartAddr, PointCount );
+    Req.CoilData = Data;
+    return Req;
+}
+//---------------------------------------------------------------------------
+
+Request Request::ReadInputStatus( Context::SlaveAddrType SlaveAddr,
+                                  CoilAddrType StartAddr, CoilCountType PointCount,
+                                  CoilDataType* Data )
+{
+    Request Req =
+        MakeRequest( FunctionCode::ReadInputStatus, SlaveAddr, StartAddr, PointCount );
+    Req.CoilData = Data;
+    return Req;
+}
+//---------------------------------------------------------------------------
+
+Request Request::ReadHoldingRegisters( Context::SlaveAddrType SlaveAddr,
+                                       RegAddrType StartAddr, RegCountType PointCount,
+                                       RegDataType* Data )
+{
+    Request Req =
+        MakeRequest( FunctionCode::ReadHoldingRegisters, SlaveAddr, StartAddr, PointCount );
+    Req.RegData = Data;
+    return Req;
+}
+//---------------------------------------------------------------------------
+
+Request Request::ReadInputRegisters( Context::SlaveAddrType SlaveAddr,
+                                     RegAddrType StartAddr, RegCountType PointCount,
+                                     RegDataType* Data )
+{
+    Request Req =
+        MakeRequest( FunctionCode::ReadInputRegisters, SlaveAddr, StartAddr, PointCount );
+    Req.RegData = Data;
+    return Req;
+}
+//---------------------------------------------------------------------------
+
+Request Request::ForceSingleCoil( Context::SlaveAddrType SlaveAddr,
+                                  CoilAddrType Addr, bool Value )
+{
+    Request Req = MakeRequest( FunctionCode::ForceSingleCoil, SlaveAddr, Addr, 1 );
+    Req.Value = Value ? 1 : 0;
+    return Req;
+}
+//---------------------------------------------------------------------------
+
+Request Request::PresetSingleRegister( Context::SlaveAddrType SlaveAddr,
+                                       RegAddrType Addr, RegDataType Data )
+{
+    Request Req = MakeRequest( FunctionCode::PresetSingleRegister, SlaveAddr, Addr, 1 );
+    Req.Value = Data;
+    return Req;
+}
+//---------------------------------------------------------------------------
+
+Request Request::Diagnostics( Context::SlaveAddrType SlaveAddr,
+                              DiagSubFnType SubFunction, RegDataType Data,
+                              RegDataType* Result )
+{
+    Request Req = MakeRequest( FunctionCode::Diagnostics, SlaveAddr, SubFunction, 1 );
+    Req.Value = Data;
+    Req.RegData = Result;
+    return Req;
+}
+//---------------------------------------------------------------------------
+
+Request Request::FetchCommEventCtr( Context::SlaveAddrType SlaveAddr, RegDataType* Result )
+{
+    Request Req = MakeRequest( FunctionCode::FetchCommEventCtr, SlaveAddr, 0, 0 );
+    Req.RegData = Result;
+    return Req;
+}
+//---------------------------------------------------------------------------
+
+Request Request::ForceMultipleCoils( Context::SlaveAddrType SlaveAddr,
+                                     CoilAddrType StartAddr, CoilCountType PointCount,
+                                     const CoilDataType* Data )
+{
+    Request Req =
+        MakeRequest( FunctionCode::ForceMultipleCoils, SlaveAddr, StartAddr, PointCount );
+    Req.CoilSource = Data;
+    return Req;
+}
+//---------------------------------------------------------------------------
+
+Request Request::PresetMultipleRegisters( Context::SlaveAddrType SlaveAddr,
+                                          RegAddrType StartAddr, RegCountType PointCount,
+                                          const RegDataType* Data )
+{
+    Request Req =
+        MakeRequest( FunctionCode::PresetMultipleRegisters, SlaveAddr, StartAddr, PointCount );
+    Req.RegSource = Data;
+    return Req;
+}
+//---------------------------------------------------------------------------
+
+Request Request::ReadGeneralReference( Context::SlaveAddrType SlaveAddr,
+                                       const FileSubRequest* SubRequests,
+                                       size_t SubReqCount, RegDataType* Data )
+{
+    Request Req = MakeRequest( FunctionCode::ReadGeneralReference, SlaveAddr, 0, 0 );
+    Req.SubRequests = SubRequests;
+    Req.SubReqCount = SubReqCount;
+    Req.RegData = Data;
+    return Req;
+}
+//---------------------------------------------------------------------------
+
+Request Request::WriteGeneralReference( Context::SlaveAddrType SlaveAddr,
+                                        const FileSubRequest* SubRequests,
+                                        size_t SubReqCount, const RegDataType* Data )
+{
+    Request Req = MakeRequest( FunctionCode::WriteGeneralReference, SlaveAddr, 0, 0 );
+    Req.SubRequests = SubRequests;
+    Req.SubReqCount = SubReqCount;
+    Req.RegSource = Data;
+    return Req;
+}
+//---------------------------------------------------------------------------
+
+Request Request::MaskWrite4XRegister( Context::SlaveAddrType SlaveAddr,
+                                      RegAddrType Addr, RegDataType AndMask,
+                                      RegDataType OrMask )
+{
+    Request Req = MakeRequest( FunctionCode::MaskWrite4XRegister, SlaveAddr, Addr, 1 );
+    Req.AndMask = AndMask;
+    Req.Value = OrMask;
+    return Req;
+}
+//---------------------------------------------------------------------------
+
+Request Request::ReadFIFOQueue( Context::SlaveAddrType SlaveAddr,
+                                FIFOAddrType FIFOAddr, RegDataType* Data )
+{
+    Request Req = MakeRequest( FunctionCode::ReadFIFOQueue, SlaveAddr, FIFOAddr, 0 );
+    Req.RegData = Data;
+    return Req;
+}
+//---------------------------------------------------------------------------
+
+void RaiseExceptionIfRequestFailed( Context const & Context, Request const & Req,
+                                    String Prefix )
+{
+    switch ( Req.Status ) {
+        case RequestStatus::Completed:
+            return;
+        case RequestStatus::Exception:
+            RaiseStandardException( Context, Req.ExceptCode, Prefix );
+        case RequestStatus::Failed:
+            throw EContextException(
+                Context,
+                Format( _D( "%s: %s" ), ARRAYOFCONST( ( Prefix, Req.ErrorMessage ) ) )
+            );
+        default:
+            throw EContextException(
+                Context, Format( _D( "%s: not executed" ), ARRAYOFCONST( ( Prefix ) ) )
+            );
+    }
+}
+//---------------------------------------------------------------------------
+
+TransactionPolicy TransactionPolicy::MergedWith( TransactionPolicy const & Fallback ) const
+{
+    TransactionPolicy Result { *this };
+    if ( !Result.Timeout ) {
+        Result.Timeout = Fallback.Timeout;
+    }
+    if ( !Result.RetryCount ) {
+        Result.RetryCount = Fallback.RetryCount;
+    }
+    if ( !Result.Backoff ) {
+        Result.Backoff = Fallback.Backoff;
+    }
+    if ( !Result.Priority ) {
+        Result.Priority = Fallback.Priority;
+    }
+    if ( !Result.MaxRegisterCount ) {
+        Result.MaxRegisterCount = Fallback.MaxRegisterCount;
+    }
+    if ( !Result.MaxCoilCount ) {
+        Result.MaxCoilCount = Fallback.MaxCoilCount;
+    }
+    return Result;
+}
 
 //---------------------------------------------------------------------------
 namespace Master {
 //---------------------------------------------------------------------------
 
+void RoundTripEstimator::AddSample( Duration RoundTrip ) noexcept
+{
+    if ( !sampleCount_ ) {
+        srtt_ = RoundTrip;
+        rttvar_ = RoundTrip / 2;
+    }
+    else {
+        Duration const Error = srtt_ > RoundTrip ? srtt_ - RoundTrip : RoundTrip - srtt_;
+        rttvar_ = ( 3 * rttvar_ + Error ) / 4;
+        srtt_ = ( 7 * srtt_ + RoundTrip ) / 8;
+    }
+    ++sampleCount_;
+    backoffShift_ = 0;
+}
+//---------------------------------------------------------------------------
+
+void RoundTripEstimator::AddTimeout() noexcept
+{
+    if ( backoffShift_ < MaxBackoffShift ) {
+        ++backoffShift_;
+    }
+}
+//---------------------------------------------------------------------------
+
+unsigned RoundTripEstimator::GetTimeout( unsigned Min, unsigned Max ) const noexcept
+{
+    if ( !sampleCount_ ) {
+        return Max;
+    }
+    Duration const Rto = ( srtt_ + 4 * rttvar_ ) * ( 1U << backoffShift_ );
+    auto const Ms =
+        std::chrono::ceil<std::chrono::milliseconds>( Rto ).count();
+    return static_cast<unsigned>(
+        std::clamp<decltype( Ms )>( Ms, Min, Max )
+    );
+}
+//---------------------------------------------------------------------------
+
 Protocol::Protocol()
 {
 }
@@ -205,8 +478,19 @@ void Protocol::DoPresetSingleRegister( Context const & /* Context */,
 //    DoDiagnostics
 //    DoProgram484
 //    DoPoll484
-//    DoFetchCommEventCtr
-//    DoFetchCommEventLog
+
+CommEventCounter Protocol::DoFetchCommEventCtr( Context const & /* Context */ )
+{
+    RaiseFunctionCodeNotImplementedException( FunctionCode::FetchCommEventCtr );
+}
+//---------------------------------------------------------------------------
+
+CommEventLog Protocol::DoFetchCommEventLog( Context const & /* Context */ )
+{
+    RaiseFunctionCodeNotImplementedException( FunctionCode::FetchCommEventLog );
+}
+//---------------------------------------------------------------------------
+
 //    DoProgramController
 //    DoPollController
 //    DoForceMultipleCoils
@@ -220,10 +504,25 @@ void Protocol::DoPresetMultipleRegisters( Context const & /* Context */,
 }
 //---------------------------------------------------------------------------
 
-//    ReportSlave
+std::vector<uint8_t> Protocol::DoReportSlave( Context const & /* Context */ )
+{
+    RaiseFunctionCodeNotImplementedException( FunctionCode::ReportSlave );
+}
+//---------------------------------------------------------------------------
+
 //    Program884_M84
 //    ResetCommLink
 
+std::optional<DeviceObjectIdType> Protocol::DoReadDeviceIdentification(
+                                       Context const & /* Context */,
+                                       ReadDeviceIdCode /* Code */,
+                                       DeviceObjectIdType /* ObjectId */,
+                                       DeviceIdentification& /* Result */ )
+{
+    RaiseFunctionCodeNotImplementedException( FunctionCode::EncapsulatedInterfaceTransport );
+}
+//---------------------------------------------------------------------------
+
 void Protocol::DoReadGeneralReference( Context const & /* Context */,
                                        const FileSubRequest* /*SubRequests*/,
                                        size_t /*SubReqCount*/,
@@ -248,12 +547,314 @@ void Protocol::DoMaskWrite4XRegister( Context const & Context,
                                       RegDataType AndMask,
                                       RegDataType OrMask )
 {
-    RaiseFunctionCodeNotImplementedException( FunctionCode::PresetMultipleRegisters );
+    RaiseFunctionCodeNotImplementedException( FunctionCode::MaskWrite4XRegister );
 }
 //    ReadWrite4XRegisters
 //    ReadFIFOQueue
 //---------------------------------------------------------------------------
 
+DeviceIdentification Protocol::ReadDeviceIdentification( Context const & Context,
+                                                         ReadDeviceIdCode Code,
+                                                         DeviceObjectIdType FirstObject )
+{
+    RaiseExceptionIfIsNotConnected( _D( "ReadDeviceIdentification failed" ) );
+
+    // The next object id always grows (the codec checks it): the loop ends
+    DeviceIdentification Result;
+    std::optional<DeviceObjectIdType> Next = FirstObject;
+    do {
+        Next = DoReadDeviceIdentification( Context, Code, *Next, Result );
+    } while ( Next && Code != ReadDeviceIdCode::Individual );
+    return Result;
+}
+//---------------------------------------------------------------------------
+
+size_t Protocol::Execute( Request* Requests, size_t RequestCount )
+{
+    RaiseExceptionIfIsNotConnected( _D( "Execute failed" ) );
+
+    for ( size_t Idx = 0 ; Idx < RequestCount ; ++Idx ) {
+        Requests[Idx].Status = RequestStatus::Pending;
+        Requests[Idx].ErrorMessage = String();
+    }
+
+    DoExecute( Requests, RequestCount );
+
+    return std::count_if(
+        Requests, Requests + RequestCount,
+        []( Request const & Req ) { return Req.Status == RequestStatus::Completed; }
+    );
+}
+//---------------------------------------------------------------------------
+
+void Protocol::DoExecute( Request* Requests, size_t RequestCount )
+{
+    for ( size_t Idx = 0 ; Idx < RequestCount ; ++Idx ) {
+        Request& Req = Requests[Idx];
+        try {
+            ExecuteRequest( Context( Req.SlaveAddr, Req.Policy ), Req );
+            Req.Status = RequestStatus::Completed;
+        }
+        catch ( Exception const & E ) {
+            SetRequestError( Req, E );
+        }
+    }
+}
+//---------------------------------------------------------------------------
+
+void Protocol::ExecuteRequest( Context const & Context, Request& Req )
+{
+    switch ( Req.FnCode ) {
+        case FunctionCode::ReadCoilStatus:
+            DoReadCoilStatus( Context, Req.Addr, Req.PointCount, Req.CoilData );
+            break;
+        case FunctionCode::ReadInputStatus:
+            DoReadInputStatus( Context, Req.Addr, Req.PointCount, Req.CoilData );
+            break;
+        case FunctionCode::ReadHoldingRegisters:
+            DoReadHoldingRegisters( Context, Req.Addr, Req.PointCount, Req.RegData );
+            break;
+        case FunctionCode::ReadInputRegisters:
+            DoReadInputRegisters( Context, Req.Addr, Req.PointCount, Req.RegData );
+            break;
+        case FunctionCode::ForceSingleCoil:
+            DoForceSingleCoil( Context, Req.Addr, Req.Value != 0 );
+            break;
+        case FunctionCode::PresetSingleRegister:
+            DoPresetSingleRegister( Context, Req.Addr, Req.Value );
+            break;
+        case FunctionCode::Diagnostics: {
+            RegDataType const Result = DoDiagnostics( Context, Req.Addr, Req.Value );
+            if ( Req.RegData ) {
+                *Req.RegData = Result;
+            }
+            break;
+        }
+        case FunctionCode::FetchCommEventCtr: {
+            CommEventCounter const Result = DoFetchCommEventCtr( Context );
+            Req.Value = Result.EventCount;
+            if ( Req.RegData ) {
+                Req.RegData[0] = Result.Status;
+                Req.RegData[1] = Result.EventCount;
+            }
+            break;
+        }
+        case FunctionCode::ForceMultipleCoils:
+            DoForceMultipleCoils( Context, Req.Addr, Req.PointCount, Req.CoilSource );
+            break;
+        case FunctionCode::PresetMultipleRegisters:
+            DoPresetMultipleRegisters( Context, Req.Addr, Req.PointCount, Req.RegSource );
+            break;
+        case FunctionCode::ReadGeneralReference:
+            DoReadGeneralReference( Context, Req.SubRequests, Req.SubReqCount, Req.RegData );
+            break;
+        case FunctionCode::WriteGeneralReference:
+            DoWriteGeneralReference( Context, Req.SubRequests, Req.SubReqCount, Req.RegSource );
+            break;
+        case FunctionCode::MaskWrite4XRegister:
+            DoMaskWrite4XRegister( Context, Req.Addr, Req.AndMask, Req.Value );
+            break;
+        case FunctionCode::ReadFIFOQueue:
+            Req.Value = DoReadFIFOQueue( Context, Req.Addr, Req.RegData );
+            break;
+        default:
+            RaiseFunctionCodeNotImplementedException( Req.FnCode );
+    }
+}
+//---------------------------------------------------------------------------
+
+void Protocol::ReadRange( Context const & Context, FunctionCode FnCode,
+                          uint16_t StartAddr, size_t PointCount,
+                          RegDataType* RegData, CoilDataType* CoilData )
+{
+    if ( !PointCount || StartAddr + PointCount > 0x10000 ) {
+        throw EContextException( Context, _D( "Invalid range" ) );
+    }
+
+    TransactionPolicy const Policy = GetEffectivePolicy( Context );
+    size_t ChunkSize;
+    if ( RegData ) {
+        ChunkSize =
+            std::min<size_t>(
+                PDU::Codec<FunctionCode::ReadHoldingRegisters>::MaxPointCount,
+                std::max( Policy.MaxRegisterCount.value_or( 0xFFFF ), 1U )
+            );
+    }
+    else {
+        // Every chunk but the last fills whole bytes of the caller's buffer
+        ChunkSize =
+            std::min<size_t>(
+                PDU::Codec<FunctionCode::ReadCoilStatus>::MaxPointCount,
+                std::max( Policy.MaxCoilCount.value_or( 0xFFFF ) / 8 * 8, 8U )
+            );
+    }
+
+    std::vector<Request> Requests;
+    Requests.reserve( ( PointCount + ChunkSize - 1 ) / ChunkSize );
+    for ( size_t Offset = 0 ; Offset < PointCount ; Offset += ChunkSize ) {
+        uint16_t const Addr = static_cast<uint16_t>( StartAddr + Offset );
+        uint16_t const Count = static_cast<uint16_t>( std::min( ChunkSize, PointCount - Offset ) );
+        switch ( FnCode ) {
+            case FunctionCode::ReadCoilStatus:
+                Requests.push_back(
+                    Request::ReadCoilStatus(
+                        Context.GetSlaveAddr(), Addr, Count, CoilData + Offset / 8
+                    )
+                );
+                break;
+            case FunctionCode::ReadInputStatus:
+                Requests.push_back(
+                    Request::ReadInputStatus(
+                        Context.GetSlaveAddr(), Addr, Count, CoilData + Offset / 8
+                    )
+                );
+                break;
+            case FunctionCode::ReadHoldingRegisters:
+                Requests.push_back(
+                    Request::ReadHoldingRegisters(
+                        Context.GetSlaveAddr(), Addr, Count, RegData + Offset
+                    )
+                );
+                break;
+            case FunctionCode::ReadInputRegisters:
+                Requests.push_back(
+                    Request::ReadInputRegisters(
+                        Context.GetSlaveAddr(), Addr, Count, RegData + Offset
+                    )
+                );
+                break;
+            default:
+                RaiseFunctionCodeNotImplementedException( FnCode );
+        }
+        Requests.back().Policy = Context.GetPolicy();
+    }
+
+    if ( Execute( Requests.data(), Requests.size() ) == Requests.size() ) {
+        return;
+    }
+    for ( Request const & Req : Requests ) {
+        if ( Req.Status != RequestStatus::Completed ) {
+            RaiseExceptionIfRequestFailed(
+                Context, Req,
+                Format( _D( "range read at %u" ), ARRAYOFCONST( ( static_cast<unsigned>( Req.Addr ) ) ) )
+            );
+        }
+    }
+}
+//---------------------------------------------------------------------------
+
+void Protocol::SetRequestError( Request& Req, Exception const & E )
+{
+    if ( EProtocolException const * PE = dynamic_cast<EProtocolException const *>( &E ) ) {
+        Req.Status = RequestStatus::Exception;
+        Req.ExceptCode = PE->GetCode();
+    }
+    else {
+        Req.Status = RequestStatus::Failed;
+    }
+    Req.ErrorMessage = E.Message;
+}
+//---------------------------------------------------------------------------
+
+void Protocol::SetSlavePolicy( Context::SlaveAddrType SlaveAddr,
+                               TransactionPolicy const & Policy )
+{
+    slavePolicies_[SlaveAddr] = Policy;
+}
+//---------------------------------------------------------------------------
+
+void Protocol::ClearSlavePolicy( Context::SlaveAddrType SlaveAddr )
+{
+    slavePolicies_.erase( SlaveAddr );
+}
+//---------------------------------------------------------------------------
+
+TransactionPolicy Protocol::GetSlavePolicy( Context::SlaveAddrType SlaveAddr ) const
+{
+    auto const It = slavePolicies_.find( SlaveAddr );
+    return It != slavePolicies_.end() ? It->second : TransactionPolicy();
+}
+//---------------------------------------------------------------------------
+
+TransactionPolicy Protocol::GetEffectivePolicy( Context const & Context ) const
+{
+    TransactionPolicy Policy =
+        Context.GetPolicy().MergedWith( GetSlavePolicy( Context.GetSlaveAddr() ) );
+    if ( adaptiveTimeout_ && !Policy.Timeout ) {
+        RoundTripEstimator const * const Estimator =
+            GetRoundTripEstimator( Context.GetSlaveAddr() );
+        Policy.Timeout =
+            Estimator ?
+                Estimator->GetTimeout( adaptiveTimeoutMin_, adaptiveTimeoutMax_ )
+              : adaptiveTimeoutMax_;
+    }
+    return Policy;
+}
+//---------------------------------------------------------------------------
+
+void Protocol::SetAdaptiveTimeoutBounds( unsigned Min, unsigned Max )
+{
+    if ( !Min || Min > Max ) {
+        throw EBaseException(
+            Format(
+                _D( "Invalid adaptive timeout bounds: %u-%u ms" ),
+                ARRAYOFCONST( ( Min, Max ) )
+            )
+        );
+    }
+    adaptiveTimeoutMin_ = Min;
+    adaptiveTimeoutMax_ = Max;
+}
+//---------------------------------------------------------------------------
+
+RoundTripEstimator const * Protocol::GetRoundTripEstimator(
+                                         Context::SlaveAddrType SlaveAddr ) const
+{
+    auto const It = roundTrips_.find( SlaveAddr );
+    return It != roundTrips_.end() ? &It->second : nullptr;
+}
+//---------------------------------------------------------------------------
+
+void Protocol::AddRoundTripSample( Context const & Context,
+                                   std::chrono::steady_clock::duration RoundTrip )
+{
+    if ( adaptiveTimeout_ ) {
+        roundTrips_[Context.GetSlaveAddr()].AddSample(
+            std::chrono::duration_cast<RoundTripEstimator::Duration>( RoundTrip )
+        );
+    }
+}
+//---------------------------------------------------------------------------
+
+void Protocol::AddRoundTripTimeout( Context const & Context )
+{
+    if ( adaptiveTimeout_ ) {
+        auto const It = roundTrips_.find( Context.GetSlaveAddr() );
+        if ( It != roundTrips_.end() ) {
+            It->second.AddTimeout();
+        }
+    }
+}
+//---------------------------------------------------------------------------
+
+void Protocol::WaitBeforeRetry( unsigned Backoff, int Retry )
+{
+    std::chrono::milliseconds const Pause = GetRetryPause( Backoff, Retry );
+    if ( Pause.count() ) {
+        std::this_thread::sleep_for( Pause );
+    }
+}
+//---------------------------------------------------------------------------
+
+std::chrono::milliseconds Protocol::GetRetryPause( unsigned Backoff, int Retry ) noexcept
+{
+    if ( !Backoff || Retry <= 0 ) {
+        return std::chrono::milliseconds::zero();
+    }
+    return std::chrono::milliseconds( Backoff ) * ( 1U << std::min( Retry - 1, 16 ) );
+}
+//---------------------------------------------------------------------------
+
 
 void Protocol::RaiseExceptionIfIsConnected( String Msg ) const
 {
@@ -7,6 +7,7 @@
  *  - Context: identifies a transaction target (slave address + optional transaction ID).
  *  - Exception classes: EBaseException, EContextException, EProtocolException,
  *    EProtocolStdException and its typed aliases (EIllegalFunction, EIllegalDataAddress, etc.).
+ *  - Request and RequestStatus: batch item descriptors for Master::Protocol::Execute().
  *  - Master::Protocol: abstract base class for all Modbus master transport implementations.
  *  - Master::SessionManager: RAII helper that calls Protocol::Open() on construction
  *    and Protocol::Close() on destruction.
@@ -21,11 +22,25 @@
 
 #include <cstdint>
 
+#include <chrono>
 #include <string>
 #include <algorithm>
 #include <functional>
 #include <cctype>
 #include <locale>
+#include <map>
+#include <optional>
+#include <vector>
+
+/** @brief Default lower bound (ms) of the adaptive response timeouts. */
+#if !defined( MODBUS_ADAPTIVE_TIMEOUT_DEFAULT_MIN )
+  #define MODBUS_ADAPTIVE_TIMEOUT_DEFAULT_MIN  20
+#endif
+
+/** @brief Default upper bound (ms) of the adaptive response timeouts. */
+#if !defined( MODBUS_ADAPTIVE_TIMEOUT_DEFAULT_MAX )
+  #define MODBUS_ADAPTIVE_TIMEOUT_DEFAULT_MAX  2000
+#endif
 
 //---------------------------------------------------------------------------
 namespace Modbus {
@@ -64,7 +79,8 @@ enum class FunctionCode {
     WriteGeneralReference = 21,
     MaskWrite4XRegister = 22,
     ReadWrite4XRegisters = 23,
-    ReadFIFOQueue = 24
+    ReadFIFOQueue = 24,
+    EncapsulatedInterfaceTransport = 43
 };
 
 /**
@@ -119,6 +135,49 @@ enum class ExceptionCode {
                              // the memory. The master can retry the
                              // request, but service may be required on
                              // the slave device.
+
+   GatewayPathUnavailable = 10, // The gateway could not allocate a path
+                             // from the input port to the output port:
+                             // it is misconfigured or overloaded.
+
+   GatewayTargetFailedToRespond = 11, // No response was obtained from
+                             // the target device behind the gateway,
+                             // usually because it is not present.
+};
+
+//---------------------------------------------------------------------------
+
+/**
+ * @brief Timeout and retry policy of a transaction.
+ *
+ * @details Every field is optional.  A field left empty in the policy of a call (carried
+ *  by its Context or Request) is taken from the policy of the slave
+ *  (Master::Protocol::SetSlavePolicy()), and a field still empty from the settings of
+ *  the transport (TimeoutValue, RetryCount, ...).  Fast slaves can thus give up after a
+ *  few tens of milliseconds while slow ones on the same line keep a long timeout.
+ *
+ *  Master::Protocol::Execute() applies the effective policy of each Request item as a
+ *  single call does: Timeout bounds the wait for its reply, and RetryCount and Backoff
+ *  govern the retransmissions after a timeout or a malformed reply.  An exception
+ *  response is an answer and is never retried.  On a pipelined TCP batch
+ *  (Master::TCPProtocol) a read waits for the longest Timeout among the items in flight,
+ *  a failure costs each of them one attempt, and the retries of one failure share a
+ *  single pause, the longest of their backoffs.
+ *
+ *  MaxRegisterCount and MaxCoilCount describe devices that answer fewer points per
+ *  request than the protocol allows; the range reads (Master::Protocol::
+ *  ReadHoldingRegisterRange(), ...) split their transactions accordingly.
+ */
+struct TransactionPolicy {
+    std::optional<unsigned> Timeout;    ///< Response timeout (ms).
+    std::optional<int>      RetryCount; ///< Retransmissions after the first attempt.
+    std::optional<unsigned> Backoff;    ///< Pause (ms) before the first retry, doubled before each further one.
+    std::optional<int>      Priority;   ///< Scheduling priority of queued requests (higher first); transports ignore it.
+    std::optional<unsigned> MaxRegisterCount; ///< Registers per FC03/FC04 transaction of a range read (device limit).
+    std::optional<unsigned> MaxCoilCount;     ///< Bits per FC01/FC02 transaction of a range read (device limit).
+
+    /** @brief Returns this policy with its empty fields taken from @p Fallback. */
+    [[ nodiscard ]] TransactionPolicy MergedWith( TransactionPolicy const & Fallback ) const;
 };
 
 //---------------------------------------------------------------------------
@@ -143,11 +202,23 @@ public:
      * @param SlaveAddr Modbus slave (unit) address (1–247 for RTU; 0–255 for TCP/UDP).
      */
     explicit Context( SlaveAddrType SlaveAddr ) : slaveAddr_( SlaveAddr ) {}
+
+    /**
+     * @brief Constructs a Context with the given slave address and transaction policy.
+     * @param SlaveAddr Modbus slave (unit) address.
+     * @param Policy    Timeout and retry policy of the calls made with this context.
+     */
+    Context( SlaveAddrType SlaveAddr, TransactionPolicy const & Policy )
+        : slaveAddr_( SlaveAddr ), policy_( Policy ) {}
+
     virtual ~Context() = default;
 
     /** @brief Returns the slave (unit) address. */
     [[ nodiscard ]] SlaveAddrType GetSlaveAddr() const noexcept { return DoGetSlaveAddr(); }
 
+    /** @brief Returns the transaction policy of the call (empty fields use the defaults). */
+    [[ nodiscard ]] TransactionPolicy const & GetPolicy() const noexcept { return policy_; }
+
     /** @brief Returns the transaction identifier (0 for RTU; meaningful for TCP/UDP). */
     [[ nodiscard ]] TransactionIdType GetTransactionIdentifier() const noexcept {
         return DoGetTransactionIdentifier();
@@ -161,6 +232,7 @@ protected:
     }
 private:
     SlaveAddrType slaveAddr_;
+    TransactionPolicy policy_;
 };
 //---------------------------------------------------------------------------
 
@@ -319,6 +391,16 @@ using
   EMemoryParityError =
     EProtocolStdException<ExceptionCode::MemoryParityError>;
 
+/** @brief Thrown when a gateway reports ExceptionCode::GatewayPathUnavailable (no path to the target). */
+using
+  EGatewayPathUnavailable =
+    EProtocolStdException<ExceptionCode::GatewayPathUnavailable>;
+
+/** @brief Thrown when a gateway reports ExceptionCode::GatewayTargetFailedToRespond (target absent). */
+using
+  EGatewayTargetFailedToRespond =
+    EProtocolStdException<ExceptionCode::GatewayTargetFailedToRespond>;
+
 using CoilAddrType  = uint16_t;  ///< Type for a coil (discrete output) address.
 using CoilCountType = uint16_t;  ///< Type for the number of coils in a request.
 using CoilDataType  = uint8_t;   ///< Type for packed coil data bytes.
@@ -332,6 +414,35 @@ using DiagSubFnType = uint16_t;           ///< Type for a Diagnostics (FC08) sub
 using FIFOAddrType  = uint16_t;           ///< Type for the FIFO pointer register address (FC24).
 using FIFOCountType = uint16_t;           ///< Type for the number of FIFO register values (FC24).
 
+/**
+ * @brief Result of Master::Protocol::FetchCommEventCtr() (FC11).
+ *
+ * @details The slave increments EventCount for every message it completes normally;
+ *  exception responses, poll commands and FC11 itself are not counted.  A change of
+ *  the count therefore reveals traffic (writes by another master, for instance) since
+ *  the previous fetch.
+ */
+struct CommEventCounter {
+    RegDataType Status {};      ///< 0xFFFF while a previous program command is in progress, else 0.
+    RegDataType EventCount {};  ///< Event counter, wraps at 0xFFFF.
+
+    [[ nodiscard ]] bool IsBusy() const noexcept { return Status == 0xFFFF; }
+};
+
+/**
+ * @brief Result of Master::Protocol::FetchCommEventLog() (FC12).
+ */
+struct CommEventLog {
+    RegDataType Status {};        ///< As in CommEventCounter.
+    RegDataType EventCount {};    ///< As in CommEventCounter.
+    RegDataType MessageCount {};  ///< Messages processed since the last restart.
+
+    /** @brief Event bytes, most recent first (at most 64). */
+    std::vector<uint8_t> Events;
+
+    [[ nodiscard ]] bool IsBusy() const noexcept { return Status == 0xFFFF; }
+};
+
 using FileNumberType   = uint16_t;  ///< Type for a file number in FC20/FC21 file record access.
 using RecordNumberType = uint16_t;  ///< Type for a record number within a file (FC20/FC21).
 using RecordLengthType = uint16_t;  ///< Type for the number of registers in a file record (FC20/FC21).
@@ -354,6 +465,44 @@ struct FileSubRequest {
     RecordLengthType RecordLength;  ///< Number of registers to read/write.
 };
 
+using DeviceObjectIdType = uint8_t;  ///< Type for a device identification object id (FC43/14).
+
+/**
+ * @brief Read Device ID code of an FC43/14 (Read Device Identification) request.
+ */
+enum class ReadDeviceIdCode : uint8_t {
+    Basic      = 0x01,  ///< Stream access to the basic objects (0x00–0x02).
+    Regular    = 0x02,  ///< Stream access to the regular objects (0x03–0x7F).
+    Extended   = 0x03,  ///< Stream access to the extended, private objects (0x80–0xFF).
+    Individual = 0x04,  ///< Access to one object.
+};
+
+/**
+ * @brief Standard device identification objects (FC43/14).
+ */
+enum class DeviceObjectId : DeviceObjectIdType {
+    VendorName          = 0x00,  ///< Basic, mandatory.
+    ProductCode         = 0x01,  ///< Basic, mandatory.
+    MajorMinorRevision  = 0x02,  ///< Basic, mandatory.
+    VendorUrl           = 0x03,  ///< Regular, optional.
+    ProductName         = 0x04,  ///< Regular, optional.
+    ModelName           = 0x05,  ///< Regular, optional.
+    UserApplicationName = 0x06,  ///< Regular, optional.
+};
+
+/**
+ * @brief Result of Master::Protocol::ReadDeviceIdentification().
+ */
+struct DeviceIdentification {
+    uint8_t ConformityLevel {};  ///< Identification conformity level of the device.
+
+    /** @brief Object values as sent by the device, by object id (binary safe). */
+    std::map<DeviceObjectIdType,std::string> Objects;
+
+    /** @brief Returns an ASCII object as a String, or an empty String if it was not read. */
+    [[ nodiscard ]] String GetText( DeviceObjectId Id ) const;
+};
+
 /**
  * @brief Standard Diagnostics sub-function codes for FC08.
  *
@@ -378,10 +527,185 @@ enum class DiagnosticsSubFunction : DiagSubFnType {
     ClearOverrunCounterAndFlag = 0x0014,  ///< Clear the overrun counter and error flag.
 };
 
+/**
+ * @brief Outcome of a single Request executed through Master::Protocol::Execute().
+ */
+enum class RequestStatus {
+    Pending,    ///< Not executed (yet), e.g. the batch was aborted before it was sent.
+    Completed,  ///< Transaction completed; the output buffer (if any) has been filled.
+    Exception,  ///< The slave returned an exception response (see Request::ExceptCode).
+    Failed      ///< Communication or framing error (see Request::ErrorMessage).
+};
+
+/**
+ * @brief Describes one item of a heterogeneous batch submitted to
+ *        Master::Protocol::Execute().
+ *
+ * @details A batch may freely mix function codes and slave addresses.  Supported
+ *  function codes are FC01, FC02, FC03, FC04, FC05, FC06, FC08, FC11, FC15, FC16,
+ *  FC20, FC21, FC22 and FC24.
+ *
+ *  Build items with the static factory functions, which mirror the signatures of
+ *  the corresponding Protocol methods.  Data buffers are referenced, not copied:
+ *  they must remain valid until Execute() returns.
+ *
+ *  After Execute() returns, Status, ExceptCode and ErrorMessage describe the
+ *  outcome of the item.
+ */
+struct Request {
+    FunctionCode           FnCode;      ///< Function code of the transaction.
+    Context::SlaveAddrType SlaveAddr;   ///< Target slave (unit) address.
+    uint16_t               Addr;        ///< Start address (coil or register).
+    uint16_t               PointCount;  ///< Number of coils/registers (1 for FC05/FC06).
+    RegDataType*           RegData;     ///< FC03/FC04/FC24 destination buffer; FC08 response data; FC11 status and event count.
+    const RegDataType*     RegSource;   ///< FC16 source buffer.
+    CoilDataType*          CoilData;    ///< FC01/FC02 destination buffer (packed bits).
+    const CoilDataType*    CoilSource;  ///< FC15 source buffer (packed bits).
+    RegDataType            Value;       ///< FC06 register value; FC05 coil state (non-zero = ON); FC08 data; FC11 event count, FC24 FIFO count (set by Execute()).
+    RegDataType            AndMask;     ///< FC22 AND mask (Value holds the OR mask).
+    const FileSubRequest*  SubRequests; ///< FC20/FC21 sub-requests (RegData/RegSource hold the records).
+    size_t                 SubReqCount; ///< Number of FC20/FC21 sub-requests.
+
+    RequestStatus          Status;      ///< Outcome, set by Execute().
+    ExceptionCode          ExceptCode;  ///< Valid when Status is RequestStatus::Exception.
+    String                 ErrorMessage;///< Error text when Status is Exception or Failed.
+    TransactionPolicy      Policy;      ///< Timeout and retry policy of the item.
+
+    /** @brief Builds an FC01 (Read Coil Status) item. */
+    [[ nodiscard ]] static Request ReadCoilStatus( Context::SlaveAddrType SlaveAddr,
+                                                   CoilAddrType StartAddr,
+                                                   CoilCountType PointCount,
+                                                   CoilDataType* Data );
+    /** @brief Builds an FC02 (Read Input Status) item. */
+    [[ nodiscard ]] static Request ReadInputStatus( Context::SlaveAddrType SlaveAddr,
+                                                    CoilAddrType StartAddr,
+                                                    CoilCountType PointCount,
+                                                    CoilDataType* Data );
+    /** @brief Builds an FC03 (Read Holding Registers) item. */
+    [[ nodiscard ]] static Request ReadHoldingRegisters( Context::SlaveAddrType SlaveAddr,
+                                                         RegAddrType StartAddr,
+                                                         RegCountType PointCount,
+                                                         RegDataType* Data );
+    /** @brief Builds an FC04 (Read Input Registers) item. */
+    [[ nodiscard ]] static Request ReadInputRegisters( Context::SlaveAddrType SlaveAddr,
+                                                       RegAddrType StartAddr,
+                                                       RegCountType PointCount,
+                                                       RegDataType* Data );
+    /** @brief Builds an FC05 (Force Single Coil) item. */
+    [[ nodiscard ]] static Request ForceSingleCoil( Context::SlaveAddrType SlaveAddr,
+                                                    CoilAddrType Addr, bool Value );
+    /** @brief Builds an FC06 (Preset Single Register) item. */
+    [[ nodiscard ]] static Request PresetSingleRegister( Context::SlaveAddrType SlaveAddr,
+                                                         RegAddrType Addr,
+                                                         RegDataType Data );
+    /**
+     * @brief Builds an FC08 (Diagnostics) item; Addr holds the sub-function, Value the
+     *        request data and the data field of the response is stored in @p Result.
+     */
+    [[ nodiscard ]] static Request Diagnostics( Context::SlaveAddrType SlaveAddr,
+                                                DiagSubFnType SubFunction,
+                                                RegDataType Data,
+                                                RegDataType* Result );
+    /**
+     * @brief Builds an FC11 (Fetch Comm Event Counter) item; Value receives the event
+     *        count and, unless @p Result is null, @p Result[0] the status word and
+     *        @p Result[1] the event count.
+     */
+    [[ nodiscard ]] static Request FetchCommEventCtr( Context::SlaveAddrType SlaveAddr,
+                                                      RegDataType* Result = nullptr );
+    /** @brief Builds an FC15 (Force Multiple Coils) item. */
+    [[ nodiscard ]] static Request ForceMultipleCoils( Context::SlaveAddrType SlaveAddr,
+                                                       CoilAddrType StartAddr,
+                                                       CoilCountType PointCount,
+                                                       const CoilDataType* Data );
+    /** @brief Builds an FC16 (Preset Multiple Registers) item. */
+    [[ nodiscard ]] static Request PresetMultipleRegisters( Context::SlaveAddrType SlaveAddr,
+                                                            RegAddrType StartAddr,
+                                                            RegCountType PointCount,
+                                                            const RegDataType* Data );
+    /** @brief Builds an FC20 (Read General Reference) item. */
+    [[ nodiscard ]] static Request ReadGeneralReference( Context::SlaveAddrType SlaveAddr,
+                                                         const FileSubRequest* SubRequests,
+                                                         size_t SubReqCount,
+                                                         RegDataType* Data );
+    /** @brief Builds an FC21 (Write General Reference) item. */
+    [[ nodiscard ]] static Request WriteGeneralReference( Context::SlaveAddrType SlaveAddr,
+                                                          const FileSubRequest* SubRequests,
+                                                          size_t SubReqCount,
+                                                          const RegDataType* Data );
+    /** @brief Builds an FC22 (Mask Write 4X Register) item; Value holds the OR mask. */
+    [[ nodiscard ]] static Request MaskWrite4XRegister( Context::SlaveAddrType SlaveAddr,
+                                                        RegAddrType Addr,
+                                                        RegDataType AndMask,
+                                                        RegDataType OrMask );
+    /**
+     * @brief Builds an FC24 (Read FIFO Queue) item; Addr holds the FIFO pointer address,
+     *        @p Data must hold 31 values and Value receives the FIFO count.
+     */
+    [[ nodiscard ]] static Request ReadFIFOQueue( Context::SlaveAddrType SlaveAddr,
+                                                  FIFOAddrType FIFOAddr,
+                                                  RegDataType* Data );
+};
+
+/**
+ * @brief Raises the exception that describes the outcome of a batch item, if the item
+ *        did not complete.
+ * @param Prefix Text that identifies the item in the message.
+ * @throws EProtocolException (the standard subclass of the code) if the slave returned an
+ *  exception response, EContextException if the item failed or was not executed.
+ */
+extern void RaiseExceptionIfRequestFailed( Context const & Context, Request const & Req,
+                                           String Prefix );
+
 //---------------------------------------------------------------------------
 namespace Master {
 //---------------------------------------------------------------------------
 
+/**
+ * @brief Round-trip time estimator of one slave (Jacobson/Karels, as TCP, RFC 6298).
+ *
+ * @details Keeps the smoothed round-trip time SRTT and its mean deviation RTTVAR.  The
+ *  first sample R sets SRTT = R and RTTVAR = R/2; each further sample updates
+ *  RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R| and then SRTT = 7/8 SRTT + 1/8 R.  The timeout
+ *  is SRTT + 4 RTTVAR, doubled for every timeout since the last sample (exponential
+ *  backoff), so a slave that stopped answering is not hammered with short deadlines.
+ *
+ *  Only transactions answered at the first attempt are sampled (Karn's algorithm): the
+ *  answer to a retry cannot be told apart from a late answer to the first attempt.
+ */
+class RoundTripEstimator {
+public:
+    using Duration = std::chrono::microseconds;
+
+    /** @brief Adds a round-trip sample and clears the timeout backoff. */
+    void AddSample( Duration RoundTrip ) noexcept;
+
+    /** @brief Records a transaction attempt that got no valid answer: doubles the timeout. */
+    void AddTimeout() noexcept;
+
+    /** @brief Number of samples taken so far. */
+    [[ nodiscard ]] unsigned GetSampleCount() const noexcept { return sampleCount_; }
+
+    /** @brief Smoothed round-trip time (SRTT). */
+    [[ nodiscard ]] Duration GetSmoothedRoundTrip() const noexcept { return srtt_; }
+
+    /** @brief Round-trip time mean deviation (RTTVAR). */
+    [[ nodiscard ]] Duration GetRoundTripVariation() const noexcept { return rttvar_; }
+
+    /**
+     * @brief Returns the response timeout (ms, rounded up) clamped to [@p Min, @p Max],
+     *        or @p Max if no sample was taken yet.
+     */
+    [[ nodiscard ]] unsigned GetTimeout( unsigned Min, unsigned Max ) const noexcept;
+private:
+    static constexpr unsigned MaxBackoffShift = 6;
+
+    Duration srtt_ {};
+    Duration rttvar_ {};
+    unsigned sampleCount_ {};
+    unsigned backoffShift_ {};
+};
+
 /**
  * @brief Abstract base class for all Modbus master transport implementations.
  *
@@ -584,8 +908,37 @@ public:
 
 //    Program484
 //    Poll484
-//    FetchCommEventCtr
-//    FetchCommEventLog
+
+    /**
+     * @brief Fetches the status word and the event counter of the slave (FC11).
+     * @param Context Transaction context (slave address, transaction ID).
+     *
+     * @details The request is one byte and the response four, which makes FC11 the
+     *  cheapest liveness probe there is; an unchanged event counter tells that no
+     *  message has been completed by the slave since the previous fetch (see
+     *  Master::HealthMonitor).
+     *
+     * @throws EIllegalFunction if the slave does not support FC11.
+     * @throws EBaseException on communication error or timeout.
+     */
+    [[ nodiscard ]]
+    CommEventCounter FetchCommEventCtr( Context const & Context )
+    {
+        return DoFetchCommEventCtr( Context );
+    }
+
+    /**
+     * @brief Fetches the status word, the counters and the event log of the slave (FC12).
+     * @param Context Transaction context (slave address, transaction ID).
+     * @throws EIllegalFunction if the slave does not support FC12.
+     * @throws EBaseException on communication error or timeout.
+     */
+    [[ nodiscard ]]
+    CommEventLog FetchCommEventLog( Context const & Context )
+    {
+        return DoFetchCommEventLog( Context );
+    }
+
 //    ProgramController
 //    PollController
 
@@ -621,7 +974,22 @@ public:
     {
         DoPresetMultipleRegisters( Context, StartAddr, PointCount, Data );
     }
-//    ReportSlave
+
+    /**
+     * @brief Reads the slave description (FC17 — Report Slave ID).
+     * @param Context Transaction context (slave address, transaction ID).
+     * @return The data of the response: slave ID, run indicator status (0x00 = OFF,
+     *         0xFF = ON) and additional data.  The length of each part is device
+     *         specific.
+     * @throws EIllegalFunction if the slave does not support FC17.
+     * @throws EBaseException on communication error or timeout.
+     */
+    [[ nodiscard ]]
+    std::vector<uint8_t> ReportSlave( Context const & Context )
+    {
+        return DoReportSlave( Context );
+    }
+
 //    Program884_M84
 //    ResetCommLink
 
@@ -748,6 +1116,161 @@ public:
         return DoReadFIFOQueue( Context, FIFOAddr, Data );
     }
 
+    /**
+     * @brief Reads the identification objects of a device (FC43, MEI type 14).
+     * @param Context     Transaction context (slave address, transaction ID).
+     * @param Code        Objects to read: a category (stream access) or one object.
+     * @param FirstObject Object to start from (stream access) or to read (Individual).
+     *
+     * @details With stream access the device may split the objects over several
+     *  responses ("more follows"): the requests are repeated from the next object id
+     *  until the last one.  Objects already in @p Result are overwritten.
+     *
+     * @throws EIllegalDataAddress if @p FirstObject does not exist (Individual access).
+     * @throws EIllegalFunction if the slave does not support FC43/14.
+     * @throws EContextException if a response is malformed.
+     * @throws EBaseException on communication error or timeout, or if the transport does
+     *  not implement FC43.
+     */
+    [[ nodiscard ]] DeviceIdentification ReadDeviceIdentification(
+                                             Context const & Context,
+                                             ReadDeviceIdCode Code = ReadDeviceIdCode::Basic,
+                                             DeviceObjectIdType FirstObject = 0 );
+
+    /**
+     * @brief Executes a batch of heterogeneous requests.
+     * @param Requests     Pointer to an array of request descriptors (see Request).
+     * @param RequestCount Number of descriptors.
+     * @return The number of items whose Status is RequestStatus::Completed.
+     *
+     * @details Every item reports its own outcome: a Modbus exception response or a
+     *  communication error on one item does not prevent the remaining items from
+     *  being executed.  The base implementation runs the items back to back through
+     *  the Do…() hooks; transports may override DoExecute() to overlap them on the
+     *  wire (Modbus TCP pipelines the requests, see TCPProtocol).
+     *
+     * @throws EBaseException if the protocol is not connected.
+     */
+    size_t Execute( Request* Requests, size_t RequestCount );
+
+    /**
+     * @brief Reads a range of coils of any length (FC01).
+     * @param Context    Transaction context; its policy applies to every transaction.
+     * @param StartAddr  Zero-based start coil address.
+     * @param PointCount Number of coils; @p StartAddr + @p PointCount must not exceed 65536.
+     * @param[out] Data  Packed coil bytes, as ReadCoilStatus(); required size is
+     *                   @c (PointCount + 7) / 8 bytes.
+     *
+     * @details The range is split into transactions of at most 2000 coils, or of the
+     *  MaxCoilCount of the effective policy rounded down to a multiple of 8 (at least
+     *  8), and the transactions are submitted as one Execute() batch: Modbus TCP
+     *  pipelines them, so the read time is bound by the bandwidth rather than by the
+     *  number of round trips.
+     *
+     * @throws EContextException if the range is empty or exceeds the address space.
+     * @throws EProtocolException (or EBaseException on a communication error) raised by
+     *  the first transaction, in address order, that did not complete.
+     */
+    void ReadCoilStatusRange( Context const & Context,
+                              CoilAddrType StartAddr, size_t PointCount,
+                              CoilDataType* Data )
+    {
+        ReadRange( Context, FunctionCode::ReadCoilStatus, StartAddr, PointCount,
+                   nullptr, Data );
+    }
+
+    /** @brief Reads a range of discrete inputs of any length (FC02, see ReadCoilStatusRange()). */
+    void ReadInputStatusRange( Context const & Context,
+                               CoilAddrType StartAddr, size_t PointCount,
+                               CoilDataType* Data )
+    {
+        ReadRange( Context, FunctionCode::ReadInputStatus, StartAddr, PointCount,
+                   nullptr, Data );
+    }
+
+    /**
+     * @brief Reads a range of holding registers of any length (FC03).
+     * @param Context    Transaction context; its policy applies to every transaction.
+     * @param StartAddr  Zero-based start register address.
+     * @param PointCount Number of registers; @p StartAddr + @p PointCount must not exceed 65536.
+     * @param[out] Data  Output buffer; must hold at least @p PointCount elements.
+     *
+     * @details The range is split into transactions of at most 125 registers, or of
+     *  the MaxRegisterCount of the effective policy, submitted as one Execute() batch
+     *  (pipelined by Modbus TCP).  The values are stored in address order.
+     *
+     * @throws EContextException if the range is empty or exceeds the address space.
+     * @throws EProtocolException (or EBaseException on a communication error) raised by
+     *  the first transaction, in address order, that did not complete.
+     */
+    void ReadHoldingRegisterRange( Context const & Context,
+                                   RegAddrType StartAddr, size_t PointCount,
+                                   RegDataType* Data )
+    {
+        ReadRange( Context, FunctionCode::ReadHoldingRegisters, StartAddr, PointCount,
+                   Data, nullptr );
+    }
+
+    /** @brief Reads a range of input registers of any length (FC04, see ReadHoldingRegisterRange()). */
+    void ReadInputRegisterRange( Context const & Context,
+                                 RegAddrType StartAddr, size_t PointCount,
+                                 RegDataType* Data )
+    {
+        ReadRange( Context, FunctionCode::ReadInputRegisters, StartAddr, PointCount,
+                   Data, nullptr );
+    }
+
+    /**
+     * @brief Sets the transaction policy of a slave.
+     * @details The fields set in @p Policy apply to every transaction addressed to
+     *  @p SlaveAddr, unless the Context of the call sets them too.
+     */
+    void SetSlavePolicy( Context::SlaveAddrType SlaveAddr, TransactionPolicy const & Policy );
+
+    /** @brief Removes the transaction policy of a slave. */
+    void ClearSlavePolicy( Context::SlaveAddrType SlaveAddr );
+
+    /** @brief Returns the transaction policy of a slave (empty if none was set). */
+    [[ nodiscard ]] TransactionPolicy GetSlavePolicy( Context::SlaveAddrType SlaveAddr ) const;
+
+    /**
+     * @brief Returns the policy that applies to a transaction: the policy of @p Context,
+     *        completed by the policy of its slave.
+     * @details Fields still empty after the merge are left to the transport defaults.
+     */
+    [[ nodiscard ]] TransactionPolicy GetEffectivePolicy( Context const & Context ) const;
+
+    /** @brief Returns @c true if the response timeouts adapt to the measured round-trip times. */
+    [[ nodiscard ]] bool GetAdaptiveTimeout() const noexcept { return adaptiveTimeout_; }
+
+    /**
+     * @brief Enables or disables (default) the adaptive response timeouts.
+     * @details When enabled, every transaction whose policy (call and slave) sets no
+     *  Timeout waits for the timeout of the RoundTripEstimator of its slave, clamped to
+     *  the adaptive timeout bounds.  A slave without samples gets the upper bound.  The
+     *  RTU, ASCII and TCP/UDP transports feed the estimators.
+     */
+    void SetAdaptiveTimeout( bool Val ) noexcept { adaptiveTimeout_ = Val; }
+
+    /** @brief Lower bound (ms) of the adaptive timeouts (default: MODBUS_ADAPTIVE_TIMEOUT_DEFAULT_MIN). */
+    [[ nodiscard ]] unsigned GetAdaptiveTimeoutMin() const noexcept { return adaptiveTimeoutMin_; }
+
+    /** @brief Upper bound (ms) of the adaptive timeouts (default: MODBUS_ADAPTIVE_TIMEOUT_DEFAULT_MAX). */
+    [[ nodiscard ]] unsigned GetAdaptiveTimeoutMax() const noexcept { return adaptiveTimeoutMax_; }
+
+    /**
+     * @brief Sets the bounds (ms) of the adaptive timeouts.
+     * @throws EBaseException if @p Min is 0 or greater than @p Max.
+     */
+    void SetAdaptiveTimeoutBounds( unsigned Min, unsigned Max );
+
+    /** @brief Returns the estimator of a slave, or @c nullptr if it has none yet. */
+    [[ nodiscard ]] RoundTripEstimator const * GetRoundTripEstimator(
+                                                   Context::SlaveAddrType SlaveAddr ) const;
+
+    /** @brief Discards the round-trip estimates of all the slaves. */
+    void ClearRoundTripEstimators() { roundTrips_.clear(); }
+
 protected:
     virtual String DoGetProtocolName() const = 0;
     virtual String DoGetProtocolParamsStr() const = 0;
@@ -825,8 +1348,8 @@ protected:
                                        RegDataType Data ) = 0;
 //    DoProgram484
 //    DoPoll484
-//    DoFetchCommEventCtr
-//    DoFetchCommEventLog
+    virtual CommEventCounter DoFetchCommEventCtr( Context const & Context );
+    virtual CommEventLog DoFetchCommEventLog( Context const & Context );
 //    DoProgramController
 //    DoPollController
     virtual void DoForceMultipleCoils( Context const & Context,
@@ -837,7 +1360,7 @@ protected:
                                               RegAddrType StartAddr,
                                               RegCountType PointCount,
                                               const RegDataType* Data ) = 0;
-//    DoReportSlave
+    virtual std::vector<uint8_t> DoReportSlave( Context const & Context );
 //    DoProgram884_M84
 //    DoResetCommLink
     virtual void DoReadGeneralReference( Context const & Context,
@@ -863,12 +1386,115 @@ protected:
                                           FIFOAddrType FIFOAddr,
                                           RegDataType* Data ) = 0;
 
+    /**
+     * @brief Virtual hook for one FC43/14 transaction of ReadDeviceIdentification().
+     * @details Adds the objects of the response to @p Result and sets its conformity
+     *  level.  The default implementation raises "function code not implemented".
+     * @return The next object id if the device announced that more objects follow.
+     */
+    virtual std::optional<DeviceObjectIdType> DoReadDeviceIdentification(
+                                                  Context const & Context,
+                                                  ReadDeviceIdCode Code,
+                                                  DeviceObjectIdType ObjectId,
+                                                  DeviceIdentification& Result );
+
+    /**
+     * @brief Virtual hook for Execute().
+     *
+     * @details The default implementation executes the items one after the other
+     *  through ExecuteRequest(), recording the outcome of each one.  Overrides must
+     *  set the Status of every item they process and leave the others Pending.
+     */
+    virtual void DoExecute( Request* Requests, size_t RequestCount );
+
+    /**
+     * @brief Dispatches a single batch item to the matching Do…() hook.
+     * @throws EBaseException (or a subclass) exactly as the underlying hook does.
+     */
+    void ExecuteRequest( Context const & Context, Request& Req );
+
+    /** @brief Stores the outcome of a failed item from the exception that was caught. */
+    static void SetRequestError( Request& Req, Exception const & E );
+
     void RaiseExceptionIfIsConnected( String SubMsg ) const;
     void RaiseExceptionIfIsNotConnected( String SubMsg ) const;
+
+    /**
+     * @brief Pauses before retry number @p Retry (1 = first retry) of a transaction:
+     *        @p Backoff ms, doubled for each further retry.
+     */
+    static void WaitBeforeRetry( unsigned Backoff, int Retry );
+
+    /** @brief Length of the pause taken by WaitBeforeRetry(). */
+    [[ nodiscard ]] static std::chrono::milliseconds GetRetryPause( unsigned Backoff,
+                                                                    int Retry ) noexcept;
+
+    /**
+     * @brief Reports the round-trip time of a transaction answered at the first attempt
+     *        (no-op unless the adaptive timeouts are enabled).
+     */
+    void AddRoundTripSample( Context const & Context,
+                             std::chrono::steady_clock::duration RoundTrip );
+
+    /**
+     * @brief Reports a transaction attempt that got no valid answer (no-op unless the
+     *        adaptive timeouts are enabled).
+     */
+    void AddRoundTripTimeout( Context const & Context );
+
+    /**
+     * @brief Runs attempt number @p Attempt (0 = first) of a transaction and reports its
+     *        outcome to the round-trip estimator of the slave.
+     * @param Fn Callable that performs the attempt and returns @c true if it got a valid
+     *           answer, @c false (or throws) otherwise.  An exception response counts as
+     *           an answer.
+     * @return The result of @p Fn.
+     */
+    template<typename AttemptFn>
+    bool RunAttempt( Context const & Context, int Attempt, AttemptFn Fn );
 private:
+    std::map<Context::SlaveAddrType,TransactionPolicy> slavePolicies_;
+    std::map<Context::SlaveAddrType,RoundTripEstimator> roundTrips_;
+    bool adaptiveTimeout_ {};
+    unsigned adaptiveTimeoutMin_ { MODBUS_ADAPTIVE_TIMEOUT_DEFAULT_MIN };
+    unsigned adaptiveTimeoutMax_ { MODBUS_ADAPTIVE_TIMEOUT_DEFAULT_MAX };
+
+    /** @brief Splits a range read into an Execute() batch (one of @p RegData, @p CoilData is set). */
+    void ReadRange( Context const & Context, FunctionCode FnCode,
+                    uint16_t StartAddr, size_t PointCount,
+                    RegDataType* RegData, CoilDataType* CoilData );
 };
 //---------------------------------------------------------------------------
 
+template<typename AttemptFn>
+bool Protocol::RunAttempt( Context const & Context, int Attempt, AttemptFn Fn )
+{
+    auto const Started = std::chrono::steady_clock::now();
+    bool Answered;
+    try {
+        Answered = Fn();
+    }
+    catch ( EProtocolException const & ) {
+        if ( !Attempt ) {
+            AddRoundTripSample( Context, std::chrono::steady_clock::now() - Started );
+        }
+        throw;
+    }
+    catch ( EBaseException const & ) {
+        AddRoundTripTimeout( Context );
+        throw;
+    }
+    // Karn: the answer to a retry may be a late answer to an earlier attempt
+    if ( !Answered ) {
+        AddRoundTripTimeout( Context );
+    }
+    else if ( !Attempt ) {
+        AddRoundTripSample( Context, std::chrono::steady_clock::now() - Started );
+    }
+    return Answered;
+}
+//---------------------------------------------------------------------------
+
 /**
  * @brief RAII session guard for a Modbus::Master::Protocol.
  *
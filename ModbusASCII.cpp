@@ -0,0 +1,716 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
+#include "ModbusASCII.h"
+
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace Master {
+//---------------------------------------------------------------------------
+
+namespace {
+
+/** @brief Marks a character that is not a hex digit in HexTables::Values. */
+constexpr uint8_t InvalidHexDigit = 0xFF;
+
+struct HexTables {
+    uint8_t Digits[256][2];   // Byte -> upper-case hex digits
+    uint8_t Values[256];      // Character -> nibble, or InvalidHexDigit
+};
+
+constexpr HexTables MakeHexTables() noexcept
+{
+    constexpr char Hex[] = "0123456789ABCDEF";
+    constexpr char LowerHex[] = "0123456789abcdef";
+
+    HexTables Tables {};
+    for ( int Idx = 0 ; Idx < 256 ; ++Idx ) {
+        Tables.Digits[Idx][0] = static_cast<uint8_t>( Hex[Idx >> 4] );
+        Tables.Digits[Idx][1] = static_cast<uint8_t>( Hex[Idx & 0x0F] );
+        Tables.Values[Idx] = InvalidHexDigit;
+    }
+    for ( int Idx = 0 ; Idx < 16 ; ++Idx ) {
+        Tables.Values[static_cast<uint8_t>( Hex[Idx] )] = static_cast<uint8_t>( Idx );
+        Tables.Values[static_cast<uint8_t>( LowerHex[Idx] )] = static_cast<uint8_t>( Idx );
+    }
+    return Tables;
+}
+
+constexpr HexTables HexTable = MakeHexTables();
+
+} // End of anonymous namespace
+
+//---------------------------------------------------------------------------
+
+ASCIIProtocol::ASCIIProtocol( int RetryCount )
+  : retryCount_( RetryCount )
+{
+    commPort_.SetParity( EVENPARITY );
+    commPort_.SetByteSize( 7 );
+    commPort_.SetStopBits( ONESTOPBIT );
+    commPort_.SetBaudRate( 9600 );
+}
+//---------------------------------------------------------------------------
+
+ASCIIProtocol::~ASCIIProtocol()
+{
+}
+//---------------------------------------------------------------------------
+
+String ASCIIProtocol::GetCommPort() const
+{
+    return const_cast<TCommPort&>( commPort_ ).GetCommPort().c_str();
+}
+//---------------------------------------------------------------------------
+
+void ASCIIProtocol::SetCommPort( String Val )
+{
+    commPort_.SetCommPort( Val.c_str() );
+}
+//---------------------------------------------------------------------------
+
+int ASCIIProtocol::GetCommSpeed() const noexcept
+{
+    return const_cast<TCommPort&>( commPort_ ).GetBaudRate();
+}
+//---------------------------------------------------------------------------
+
+void ASCIIProtocol::SetCommSpeed( int Val )
+{
+    commPort_.SetBaudRate( Val );
+}
+//---------------------------------------------------------------------------
+
+int ASCIIProtocol::GetCommParity() const noexcept
+{
+    return const_cast<TCommPort&>( commPort_ ).GetParity();
+}
+//---------------------------------------------------------------------------
+
+void ASCIIProtocol::SetCommParity( int Val )
+{
+    commPort_.SetParity( Val );
+}
+//---------------------------------------------------------------------------
+
+int ASCIIProtocol::GetCommBits() const noexcept
+{
+    return const_cast<TCommPort&>( commPort_ ).GetByteSize();
+}
+//---------------------------------------------------------------------------
+
+void ASCIIProtocol::SetCommBits( int Val )
+{
+    commPort_.SetByteSize( Val );
+}
+//---------------------------------------------------------------------------
+
+int ASCIIProtocol::GetCommStopBits() const noexcept
+{
+    return const_cast<TCommPort&>( commPort_ ).GetStopBits();
+}
+//---------------------------------------------------------------------------
+
+void ASCIIProtocol::SetCommStopBits( int Val )
+{
+    commPort_.SetStopBits( Val );
+}
+//---------------------------------------------------------------------------
+
+bool ASCIIProtocol::GetCommOverlapped() const noexcept
+{
+    return commPort_.GetOverlapped();
+}
+//---------------------------------------------------------------------------
+
+void ASCIIProtocol::SetCommOverlapped( bool Val )
+{
+    commPort_.SetOverlapped( Val );
+}
+//---------------------------------------------------------------------------
+
+String ASCIIProtocol::ParityToStr( int Val )
+{
+    switch ( Val ) {
+        case NOPARITY:     return _D( "N" );
+        case ODDPARITY:    return _D( "O" );
+        case EVENPARITY:   return _D( "E" );
+        case MARKPARITY:   return _D( "M" );
+        case SPACEPARITY:  return _D( "S" );
+        default:           return _D( "-" );
+    }
+}
+//---------------------------------------------------------------------------
+
+String ASCIIProtocol::StopBitsToStr( int Val )
+{
+    switch ( Val ) {
+        case ONESTOPBIT:   return _D( "1" );
+        case ONE5STOPBITS: return _D( "1.5" );
+        case TWOSTOPBITS:  return _D( "2" );
+        default:           return _D( "-" );
+    }
+}
+//---------------------------------------------------------------------------
+
+String ASCIIProtocol::DoGetProtocolParamsStr() const
+{
+    return
+        Format(
+            _D( "%s:%d,%s,%d,%s" )
+          , ARRAYOFCONST( (
+                ExtractFileName( GetCommPort() ),
+                GetCommSpeed(),
+                ParityToStr( GetCommParity() ),
+                GetCommBits(),
+                StopBitsToStr( GetCommStopBits() )
+            ) )
+        );
+}
+//---------------------------------------------------------------------------
+
+void ASCIIProtocol::DoOpen()
+{
+    commPort_.SetReadTimeOut( timeoutValue_ );
+    commPort_.OpenCommPort();
+}
+//---------------------------------------------------------------------------
+
+void ASCIIProtocol::DoClose()
+{
+    commPort_.CloseCommPort();
+}
+//---------------------------------------------------------------------------
+
+bool ASCIIProtocol::DoIsConnected() const noexcept
+{
+    return const_cast<TCommPort&>( commPort_ ).GetConnected();
+}
+//---------------------------------------------------------------------------
+
+void ASCIIProtocol::DoInputBufferClear()
+{
+    commPort_.PurgeCommPort();
+}
+//---------------------------------------------------------------------------
+
+void ASCIIProtocol::DoWrite( FrameCont const & TxChars )
+{
+    commPort_.WriteBuffer(
+        const_cast<FrameCont::value_type*>( &TxChars[0] ), TxChars.size()
+    );
+}
+//---------------------------------------------------------------------------
+
+size_t ASCIIProtocol::DoRead( uint8_t* Buffer, size_t Length )
+{
+    // ReadBytes() returns early only when the read timeout elapses
+    size_t BytesRead {};
+    while ( BytesRead < Length ) {
+        unsigned int const Count =
+            commPort_.ReadBytes(
+                Buffer + BytesRead, static_cast<unsigned int>( Length - BytesRead ),
+                transactionTimeout_.value_or( timeoutValue_ )
+            );
+        if ( !Count ) {
+            break;
+        }
+        BytesRead += Count;
+    }
+    return BytesRead;
+}
+//---------------------------------------------------------------------------
+
+ASCIIProtocol::FrameCont ASCIIProtocol::ToASCII( FrameCont const & Frame )
+{
+    FrameCont Chars;
+    Chars.reserve( 1 + 2 * ( Frame.size() + 1 ) + 2 );
+    Chars.push_back( ':' );
+
+    uint8_t LRC {};
+    for ( uint8_t const Byte : Frame ) {
+        Chars.insert( Chars.end(), HexTable.Digits[Byte], HexTable.Digits[Byte] + 2 );
+        LRC += Byte;
+    }
+    LRC = static_cast<uint8_t>( -LRC );
+    Chars.insert( Chars.end(), HexTable.Digits[LRC], HexTable.Digits[LRC] + 2 );
+
+    Chars.push_back( '\r' );
+    Chars.push_back( '\n' );
+    return Chars;
+}
+//---------------------------------------------------------------------------
+
+bool ASCIIProtocol::FromASCII( FrameCont::const_iterator Begin, FrameCont::const_iterator End,
+                               FrameCont& Frame, uint8_t& LRCSum ) noexcept
+{
+    if ( ( End - Begin ) % 2 ) {
+        return false;
+    }
+    while ( Begin != End ) {
+        uint8_t const Hi = HexTable.Values[*Begin++];
+        uint8_t const Lo = HexTable.Values[*Begin++];
+        if ( ( Hi | Lo ) == InvalidHexDigit ) {
+            return false;
+        }
+        uint8_t const Byte = static_cast<uint8_t>( ( Hi << 4 ) | Lo );
+        Frame.push_back( Byte );
+        LRCSum += Byte;
+    }
+    return true;
+}
+//---------------------------------------------------------------------------
+
+bool ASCIIProtocol::ReadChars( FrameCont& RxChars, FrameCont::size_type Count )
+{
+    FrameCont::size_type const Offset = RxChars.size();
+    RxChars.resize( Offset + Count );
+    size_t const CharsRead = Count ? DoRead( &RxChars[Offset], Count ) : 0;
+    RxChars.resize( Offset + CharsRead );
+    return CharsRead == Count;
+}
+//---------------------------------------------------------------------------
+
+bool ASCIIProtocol::ReadFrameStart( FrameCont& RxChars )
+{
+    // Line noise or the tail of a late response may precede the colon: drop it and
+    // top the buffer up until it holds the start of a frame.  A colon always starts
+    // a new frame, so the last one received wins.
+    FrameCont::size_type Discarded {};
+    do {
+        if ( !ReadChars( RxChars, ExceptionFrameChars - RxChars.size() ) ) {
+            return false;
+        }
+        auto const Last = std::find( RxChars.rbegin(), RxChars.rend(), ':' );
+        auto const Colon = Last == RxChars.rend() ? RxChars.end() : std::prev( Last.base() );
+        Discarded += Colon - RxChars.begin();
+        RxChars.erase( RxChars.begin(), Colon );
+    } while ( RxChars.size() < ExceptionFrameChars && Discarded <= MaxFrameChars );
+
+    return RxChars.size() == ExceptionFrameChars;
+}
+//---------------------------------------------------------------------------
+
+ASCIIProtocol::FrameCont ASCIIProtocol::Transact( Context const & Context,
+                                                  FrameCont const & TxFrame,
+                                                  size_t ResponseLength )
+{
+    return Transact(
+        Context, TxFrame, 1, [ResponseLength]( FrameCont const & ) { return ResponseLength; }
+    );
+}
+//---------------------------------------------------------------------------
+
+//    ASCIIProtocol::DoReadCoilStatus
+//    ASCIIProtocol::DoReadInputStatus
+
+template<FunctionCode FC>
+void ASCIIProtocol::ReadBits( Context const & Context,
+                              CoilAddrType StartAddr, CoilCountType PointCount,
+                              CoilDataType* Data )
+{
+    using Codec = PDU::Codec<FC>;
+
+    Codec::RaiseExceptionIfPointCountIsNotValid( Context, PointCount );
+
+    FrameCont const RxFrame =
+        Transact(
+            Context,
+            EncodeFrame<Codec>( Context, Codec::RequestLength, StartAddr, PointCount ),
+            Codec::ResponseLength( PointCount )
+        );
+
+    DecodeFrame<Codec>( Context, RxFrame, PointCount, Data );
+}
+//---------------------------------------------------------------------------
+
+void ASCIIProtocol::DoReadCoilStatus( Context const & Context,
+                                      CoilAddrType StartAddr,
+                                      CoilCountType PointCount,
+                                      CoilDataType* Data )
+{
+    ReadBits<FunctionCode::ReadCoilStatus>( Context, StartAddr, PointCount, Data );
+}
+//---------------------------------------------------------------------------
+
+void ASCIIProtocol::DoReadInputStatus( Context const & Context,
+                                       CoilAddrType StartAddr,
+                                       CoilCountType PointCount,
+                                       CoilDataType* Data )
+{
+    ReadBits<FunctionCode::ReadInputStatus>( Context, StartAddr, PointCount, Data );
+}
+//---------------------------------------------------------------------------
+
+//    ASCIIProtocol::DoReadHoldingRegisters
+//    ASCIIProtocol::DoReadInputRegisters
+
+template<FunctionCode FC>
+void ASCIIProtocol::ReadRegisters( Context const & Context,
+                                   RegAddrType StartAddr, RegCountType PointCount,
+                                   RegDataType* Data )
+{
+    using Codec = PDU::Codec<FC>;
+
+    Codec::RaiseExceptionIfPointCountIsNotValid( Context, PointCount );
+
+    FrameCont const RxFrame =
+        Transact(
+            Context,
+            EncodeFrame<Codec>( Context, Codec::RequestLength, StartAddr, PointCount ),
+            Codec::ResponseLength( PointCount )
+        );
+
+    DecodeFrame<Codec>( Context, RxFrame, PointCount, Data );
+}
+//---------------------------------------------------------------------------
+
+void ASCIIProtocol::DoReadHoldingRegisters( Context const & Context,
+                                            RegAddrType StartAddr,
+                                            RegCountType PointCount,
+                                            RegDataType* Data )
+{
+    ReadRegisters<FunctionCode::ReadHoldingRegisters>(
+        Context, StartAddr, PointCount, Data
+    );
+}
+//---------------------------------------------------------------------------
+
+void ASCIIProtocol::DoReadInputRegisters( Context const & Context,
+                                          RegAddrType StartAddr,
+                                          RegCountType PointCount,
+                                          RegDataType* Data )
+{
+    ReadRegisters<FunctionCode::ReadInputRegisters>(
+        Context, StartAddr, PointCount, Data
+    );
+}
+//---------------------------------------------------------------------------
+
+//    ASCIIProtocol::DoForceSingleCoil
+void ASCIIProtocol::DoForceSingleCoil( Context const & Context,
+                                       CoilAddrType Addr, bool Value )
+{
+    using Codec = PDU::Codec<FunctionCode::ForceSingleCoil>;
+
+    FrameCont const RxFrame =
+        Transact(
+            Context,
+            EncodeFrame<Codec>( Context, Codec::RequestLength, Addr, Value ),
+            Codec::ResponseLength
+        );
+
+    DecodeFrame<Codec>( Context, RxFrame, Addr, Value );
+}
+//---------------------------------------------------------------------------
+
+//    ASCIIProtocol::DoPresetSingleRegister
+void ASCIIProtocol::DoPresetSingleRegister( Context const & Context,
+                                            RegAddrType Addr, RegDataType Data )
+{
+    using Codec = PDU::Codec<FunctionCode::PresetSingleRegister>;
+
+    FrameCont const RxFrame =
+        Transact(
+            Context,
+            EncodeFrame<Codec>( Context, Codec::RequestLength, Addr, Data ),
+            Codec::ResponseLength
+        );
+
+    DecodeFrame<Codec>( Context, RxFrame, Addr, Data );
+}
+//---------------------------------------------------------------------------
+
+//    ASCIIProtocol::DoReadExceptionStatus
+ExceptionStatusDataType ASCIIProtocol::DoReadExceptionStatus( Context const & Context )
+{
+    using Codec = PDU::Codec<FunctionCode::ReadExceptionStatus>;
+
+    FrameCont const RxFrame =
+        Transact(
+            Context,
+            EncodeFrame<Codec>( Context, Codec::RequestLength ),
+            Codec::ResponseLength
+        );
+
+    return DecodeFrame<Codec>( Context, RxFrame );
+}
+//---------------------------------------------------------------------------
+
+//    ASCIIProtocol::DoDiagnostics
+RegDataType ASCIIProtocol::DoDiagnostics( Context const & Context,
+                                          DiagSubFnType SubFunction,
+                                          RegDataType Data )
+{
+    using Codec = PDU::Codec<FunctionCode::Diagnostics>;
+
+    FrameCont const RxFrame =
+        Transact(
+            Context,
+            EncodeFrame<Codec>( Context, Codec::RequestLength, SubFunction, Data ),
+            Codec::ResponseLength
+        );
+
+    return DecodeFrame<Codec>( Context, RxFrame, SubFunction );
+}
+//---------------------------------------------------------------------------
+
+//    ASCIIProtocol::DoFetchCommEventCtr
+CommEventCounter ASCIIProtocol::DoFetchCommEventCtr( Context const & Context )
+{
+    using Codec = PDU::Codec<FunctionCode::FetchCommEventCtr>;
+
+    FrameCont const RxFrame =
+        Transact(
+            Context,
+            EncodeFrame<Codec>( Context, Codec::RequestLength ),
+            Codec::ResponseLength
+        );
+
+    return DecodeFrame<Codec>( Context, RxFrame );
+}
+//---------------------------------------------------------------------------
+
+//    ASCIIProtocol::DoFetchCommEventLog
+CommEventLog ASCIIProtocol::DoFetchCommEventLog( Context const & Context )
+{
+    using Codec = PDU::Codec<FunctionCode::FetchCommEventLog>;
+
+    // FC + ByteCount announce the rest of the frame
+    FrameCont const RxFrame =
+        Transact(
+            Context,
+            EncodeFrame<Codec>( Context, Codec::RequestLength ),
+            Codec::HeaderLength,
+            [&Context]( FrameCont const & Header ) {
+                return Codec::ResponseLength( Codec::DecodeHeader( Context, &Header[2] ) );
+            }
+        );
+
+    return DecodeFrame<Codec>( Context, RxFrame );
+}
+//---------------------------------------------------------------------------
+
+//    ASCIIProtocol::DoForceMultipleCoils
+void ASCIIProtocol::DoForceMultipleCoils( Context const & Context,
+                                          CoilAddrType StartAddr,
+                                          CoilCountType PointCount,
+                                          const CoilDataType* Data )
+{
+    using Codec = PDU::Codec<FunctionCode::ForceMultipleCoils>;
+
+    Codec::RaiseExceptionIfPointCountIsNotValid( Context, PointCount );
+
+    FrameCont const RxFrame =
+        Transact(
+            Context,
+            EncodeFrame<Codec>(
+                Context, Codec::RequestLength( PointCount ), StartAddr, PointCount, Data
+            ),
+            Codec::ResponseLength
+        );
+
+    DecodeFrame<Codec>( Context, RxFrame, StartAddr, PointCount );
+}
+//---------------------------------------------------------------------------
+
+//    ASCIIProtocol::DoPresetMultipleRegisters
+void ASCIIProtocol::DoPresetMultipleRegisters( Context const & Context,
+                                               RegAddrType StartAddr,
+                                               RegCountType PointCount,
+                                               const RegDataType* Data )
+{
+    using Codec = PDU::Codec<FunctionCode::PresetMultipleRegisters>;
+
+    Codec::RaiseExceptionIfPointCountIsNotValid( Context, PointCount );
+
+    FrameCont const RxFrame =
+        Transact(
+            Context,
+            EncodeFrame<Codec>(
+                Context, Codec::RequestLength( PointCount ), StartAddr, PointCount, Data
+            ),
+            Codec::ResponseLength
+        );
+
+    DecodeFrame<Codec>( Context, RxFrame, StartAddr, PointCount );
+}
+//---------------------------------------------------------------------------
+
+//    ASCIIProtocol::DoReportSlave
+std::vector<uint8_t> ASCIIProtocol::DoReportSlave( Context const & Context )
+{
+    using Codec = PDU::Codec<FunctionCode::ReportSlave>;
+
+    // FC + ByteCount announce the rest of the frame
+    FrameCont const RxFrame =
+        Transact(
+            Context,
+            EncodeFrame<Codec>( Context, Codec::RequestLength ),
+            Codec::HeaderLength,
+            [&Context]( FrameCont const & Header ) {
+                return Codec::ResponseLength( Codec::DecodeHeader( Context, &Header[2] ) );
+            }
+        );
+
+    return DecodeFrame<Codec>( Context, RxFrame );
+}
+//---------------------------------------------------------------------------
+
+//    ASCIIProtocol::DoReadGeneralReference
+void ASCIIProtocol::DoReadGeneralReference( Context const & Context,
+                                            const FileSubRequest* SubRequests,
+                                            size_t SubReqCount,
+                                            RegDataType* Data )
+{
+    using Codec = PDU::Codec<FunctionCode::ReadGeneralReference>;
+
+    Codec::RaiseExceptionIfSubRequestsAreNotValid( Context, SubRequests, SubReqCount );
+
+    // FC + RespDataLength announce the rest of the PDU
+    FrameCont const RxFrame =
+        Transact(
+            Context,
+            EncodeFrame<Codec>(
+                Context, Codec::RequestLength( SubReqCount ), SubRequests, SubReqCount
+            ),
+            2,
+            []( FrameCont const & Header ) { return size_t( 2 ) + Header[2]; }
+        );
+
+    DecodeFrame<Codec>( Context, RxFrame, SubRequests, SubReqCount, Data );
+}
+//---------------------------------------------------------------------------
+
+//    ASCIIProtocol::DoWriteGeneralReference
+void ASCIIProtocol::DoWriteGeneralReference( Context const & Context,
+                                             const FileSubRequest* SubRequests,
+                                             size_t SubReqCount,
+                                             const RegDataType* Data )
+{
+    using Codec = PDU::Codec<FunctionCode::WriteGeneralReference>;
+
+    Codec::RaiseExceptionIfSubRequestsAreNotValid( Context, SubRequests, SubReqCount );
+
+    // The response echoes the request: FC + ByteCount announce its length
+    FrameCont const RxFrame =
+        Transact(
+            Context,
+            EncodeFrame<Codec>(
+                Context, Codec::RequestLength( SubRequests, SubReqCount ),
+                SubRequests, SubReqCount, Data
+            ),
+            2,
+            []( FrameCont const & Header ) { return size_t( 2 ) + Header[2]; }
+        );
+
+    DecodeFrame<Codec>( Context, RxFrame, SubRequests, SubReqCount, Data );
+}
+//---------------------------------------------------------------------------
+
+//    ASCIIProtocol::DoMaskWrite4XRegister
+void ASCIIProtocol::DoMaskWrite4XRegister( Context const & Context,
+                                           RegAddrType Addr,
+                                           RegDataType AndMask,
+                                           RegDataType OrMask )
+{
+    using Codec = PDU::Codec<FunctionCode::MaskWrite4XRegister>;
+
+    FrameCont const RxFrame =
+        Transact(
+            Context,
+            EncodeFrame<Codec>( Context, Codec::RequestLength, Addr, AndMask, OrMask ),
+            Codec::ResponseLength
+        );
+
+    DecodeFrame<Codec>( Context, RxFrame, Addr, AndMask, OrMask );
+}
+//---------------------------------------------------------------------------
+
+//    ASCIIProtocol::DoReadWrite4XRegisters
+void ASCIIProtocol::DoReadWrite4XRegisters( Context const & Context,
+                                            RegAddrType ReadStartAddr,
+                                            RegCountType ReadPointCount,
+                                            RegDataType* ReadData,
+                                            RegAddrType WriteStartAddr,
+                                            RegCountType WritePointCount,
+                                            const RegDataType* WriteData )
+{
+    using Codec = PDU::Codec<FunctionCode::ReadWrite4XRegisters>;
+
+    Codec::RaiseExceptionIfPointCountIsNotValid( Context, ReadPointCount, WritePointCount );
+
+    FrameCont const RxFrame =
+        Transact(
+            Context,
+            EncodeFrame<Codec>(
+                Context, Codec::RequestLength( WritePointCount ),
+                ReadStartAddr, ReadPointCount, WriteStartAddr, WritePointCount, WriteData
+            ),
+            Codec::ResponseLength( ReadPointCount )
+        );
+
+    DecodeFrame<Codec>( Context, RxFrame, ReadPointCount, ReadData );
+}
+//---------------------------------------------------------------------------
+
+//    ASCIIProtocol::DoReadFIFOQueue
+FIFOCountType ASCIIProtocol::DoReadFIFOQueue( Context const & Context,
+                                              FIFOAddrType FIFOAddr,
+                                              RegDataType* Data )
+{
+    using Codec = PDU::Codec<FunctionCode::ReadFIFOQueue>;
+
+    // The fixed header (FC + ByteCount + FIFOCount) announces the rest of the frame
+    FrameCont const RxFrame =
+        Transact(
+            Context,
+            EncodeFrame<Codec>( Context, Codec::RequestLength, FIFOAddr ),
+            Codec::HeaderLength,
+            [&Context]( FrameCont const & Header ) {
+                return Codec::ResponseLength( Codec::DecodeHeader( Context, &Header[2] ) );
+            }
+        );
+
+    return DecodeFrame<Codec>( Context, RxFrame, Data );
+}
+//---------------------------------------------------------------------------
+
+//    ASCIIProtocol::DoReadDeviceIdentification
+std::optional<DeviceObjectIdType> ASCIIProtocol::DoReadDeviceIdentification(
+                                                    Context const & Context,
+                                                    ReadDeviceIdCode Code,
+                                                    DeviceObjectIdType ObjectId,
+                                                    DeviceIdentification& Result )
+{
+    using Codec = PDU::Codec<FunctionCode::EncapsulatedInterfaceTransport>;
+
+    // No length field: the header gives the object count, each object header the
+    // length of its value
+    FrameCont const RxFrame =
+        Transact(
+            Context,
+            EncodeFrame<Codec>( Context, Codec::RequestLength, Code, ObjectId ),
+            Codec::HeaderLength,
+            []( FrameCont const & Header ) {
+                return Codec::ResponseLength( &Header[2], Header.size() - 2 );
+            }
+        );
+
+    return DecodeFrame<Codec>( Context, RxFrame, Code, ObjectId, std::ref( Result ) );
+}
+
+//---------------------------------------------------------------------------
+}; // End of namespace Master
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
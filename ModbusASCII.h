@@ -0,0 +1,485 @@
+/**
+ * @file ModbusASCII.h
+ * @brief Modbus::Master::ASCIIProtocol — Modbus ASCII master over a Win32 serial (COM) port.
+ *
+ * @details In ASCII mode every byte of the frame (slave address, PDU and LRC) is sent as
+ *  two upper-case hexadecimal characters; a frame starts with a colon and ends with CR LF
+ *  (Modbus over serial line, 2.5.2).  The PDUs are built and checked by the same
+ *  Modbus::PDU codecs used by the RTU and TCP/UDP transports.
+ *
+ *  Hex encoding and decoding go through 256-entry lookup tables, and the LRC is computed
+ *  while the response is decoded.  Responses are read in at most three bulk reads, as for
+ *  RTU: the length of an exception response, the rest of a variable-length header and the
+ *  remainder of the frame.  An FC43/14 response has no length field and is read in
+ *  stages, object header by object header, up to the CR LF that ends it.  Characters
+ *  received before the colon are discarded.
+ */
+
+//---------------------------------------------------------------------------
+
+#ifndef ModbusASCIIH
+#define ModbusASCIIH
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "CommPort.h"
+#include "Modbus.h"
+#include "ModbusPDU.h"
+
+#if !defined( MODBUS_ASCII_DEFAULT_RETRY_COUNT )
+  /** @brief Default number of retransmission attempts for ASCII transactions. Override before including this header. */
+  #define  MODBUS_ASCII_DEFAULT_RETRY_COUNT  3
+#endif
+
+#if !defined( MODBUS_ASCII_DEFAULT_TIMEOUT )
+  /** @brief Default time (ms) an ASCII master waits for a response to start. */
+  #define  MODBUS_ASCII_DEFAULT_TIMEOUT  1000
+#endif
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace Master {
+//---------------------------------------------------------------------------
+
+/**
+ * @brief Modbus ASCII master protocol over a Win32 serial (COM) port.
+ *
+ * @details ASCIIProtocol implements every function code hook of Protocol with ASCII
+ *  framing.  The serial I/O goes through three protected virtual hooks,
+ *  DoInputBufferClear(), DoWrite() and DoRead(), implemented on a TCommPort.
+ *
+ *  Features:
+ *  - Default line settings 9600 baud, 7 data bits, even parity, 1 stop bit.
+ *  - Automatic retry on timeout, malformed frame or LRC error; retry count defaults to
+ *    MODBUS_ASCII_DEFAULT_RETRY_COUNT.  Exception responses are raised at once.
+ *  - Lower-case hex digits are accepted in responses.
+ *
+ *  @note Open the port by calling Protocol::Open() before issuing any requests (inherited method).
+ *        Close it with Protocol::Close() when done, or use a SessionManager guard.
+ */
+class ASCIIProtocol : public Protocol {
+public:
+    /** @brief Container type for raw frame bytes and ASCII frame characters. */
+    using FrameCont = std::vector<uint8_t>;
+
+    /**
+     * @brief Constructs the ASCII protocol object.
+     * @param RetryCount Maximum number of retransmission attempts per transaction
+     *                   (default: MODBUS_ASCII_DEFAULT_RETRY_COUNT = 3).
+     */
+    explicit ASCIIProtocol( int RetryCount = MODBUS_ASCII_DEFAULT_RETRY_COUNT );
+
+    /** @brief Destructor; closes the serial port if it is still open. */
+    ~ASCIIProtocol();
+
+    /** @brief Returns the COM port name (e.g., L"COM1"). */
+    [[ nodiscard ]] String GetCommPort() const;
+    /** @brief Sets the COM port name (e.g., L"COM3"). Must be called before Open(). */
+    void SetCommPort( String Val );
+
+    /** @brief Returns the configured baud rate (e.g., 9600, 19200). */
+    [[ nodiscard ]] int GetCommSpeed() const noexcept;
+    /** @brief Sets the baud rate. Must be called before Open(). */
+    void SetCommSpeed( int Val );
+
+    /** @brief Returns the configured parity (NOPARITY, ODDPARITY, EVENPARITY, etc.). */
+    [[ nodiscard ]] int GetCommParity() const noexcept;
+    /** @brief Sets the parity. Must be called before Open(). */
+    void SetCommParity( int Val );
+
+    /** @brief Returns the configured data bits (7 or 8). */
+    [[ nodiscard ]] int GetCommBits() const noexcept;
+    /** @brief Sets the data bits. Must be called before Open(). */
+    void SetCommBits( int Val );
+
+    /** @brief Returns the configured stop bits (ONESTOPBIT, TWOSTOPBITS, etc.). */
+    [[ nodiscard ]] int GetCommStopBits() const noexcept;
+    /** @brief Sets the stop bits. Must be called before Open(). */
+    void SetCommStopBits( int Val );
+
+    /** @brief Returns @c true if the serial port uses overlapped (event-driven) I/O. */
+    [[ nodiscard ]] bool GetCommOverlapped() const noexcept;
+    /**
+     * @brief Selects overlapped I/O (default: off): each read then waits for the response
+     *        timeout of its own transaction, without reprogramming the port timeouts.
+     *        Must be called before Open().
+     */
+    void SetCommOverlapped( bool Val );
+
+    /** @brief Maximum number of retransmission attempts on timeout, framing or LRC error. */
+    __property int RetryCount = { read = retryCount_, write = retryCount_ };
+
+    /**
+     * @brief Read timeout (ms) of the serial port: the longest wait for a response to
+     *        start (default: MODBUS_ASCII_DEFAULT_TIMEOUT).  The TransactionPolicy of a
+     *        call or of its slave overrides it.
+     */
+    __property unsigned TimeoutValue = { read = timeoutValue_, write = timeoutValue_ };
+protected:
+    virtual String DoGetProtocolName() const override { return _D( "Modbus ASCII" ); }
+    virtual String DoGetProtocolParamsStr() const override;
+    virtual void DoOpen() override;
+    virtual void DoClose() override;
+    virtual bool DoIsConnected() const noexcept override;
+
+    /** @brief Discards any character already received, before a request is sent. */
+    virtual void DoInputBufferClear();
+
+    /** @brief Transmits the characters of a complete request frame. */
+    virtual void DoWrite( FrameCont const & TxChars );
+
+    /**
+     * @brief Reads up to @p Length characters into @p Buffer.
+     * @return Number of characters read; less than @p Length means that the read timed out.
+     */
+    virtual size_t DoRead( uint8_t* Buffer, size_t Length );
+
+    virtual void DoReadCoilStatus( Context const & Context,
+                                   CoilAddrType StartAddr,
+                                   CoilCountType PointCount,
+                                   CoilDataType* Data ) override;
+    virtual void DoReadInputStatus( Context const & Context,
+                                    CoilAddrType StartAddr,
+                                    CoilCountType PointCount,
+                                    CoilDataType* Data ) override;
+    virtual void DoReadHoldingRegisters( Context const & Context,
+                                         RegAddrType StartAddr,
+                                         RegCountType PointCount,
+                                         RegDataType* Data ) override;
+    virtual void DoReadInputRegisters( Context const & Context,
+                                       RegAddrType StartAddr,
+                                       RegCountType PointCount,
+                                       RegDataType* Data ) override;
+    virtual void DoForceSingleCoil( Context const & Context,
+                                    CoilAddrType Addr, bool Value ) override;
+    virtual void DoPresetSingleRegister( Context const & Context,
+                                         RegAddrType Addr, RegDataType Data ) override;
+    virtual ExceptionStatusDataType DoReadExceptionStatus(
+                                        Context const & Context ) override;
+    virtual RegDataType DoDiagnostics( Context const & Context,
+                                       DiagSubFnType SubFunction,
+                                       RegDataType Data ) override;
+    virtual CommEventCounter DoFetchCommEventCtr( Context const & Context ) override;
+    virtual CommEventLog DoFetchCommEventLog( Context const & Context ) override;
+    virtual void DoForceMultipleCoils( Context const & Context,
+                                       CoilAddrType StartAddr,
+                                       CoilCountType PointCount,
+                                       const CoilDataType* Data ) override;
+    virtual void DoPresetMultipleRegisters( Context const & Context,
+                                            RegAddrType StartAddr,
+                                            RegCountType PointCount,
+                                            const RegDataType* Data ) override;
+    virtual std::vector<uint8_t> DoReportSlave( Context const & Context ) override;
+    virtual void DoReadGeneralReference( Context const & Context,
+                                         const FileSubRequest* SubRequests,
+                                         size_t SubReqCount,
+                                         RegDataType* Data ) override;
+    virtual void DoWriteGeneralReference( Context const & Context,
+                                          const FileSubRequest* SubRequests,
+                                          size_t SubReqCount,
+                                          const RegDataType* Data ) override;
+    virtual void DoMaskWrite4XRegister( Context const & Context,
+                                        RegAddrType Addr,
+                                        RegDataType AndMask,
+                                        RegDataType OrMask ) override;
+    virtual void DoReadWrite4XRegisters( Context const & Context,
+                                         RegAddrType ReadStartAddr,
+                                         RegCountType ReadPointCount,
+                                         RegDataType* ReadData,
+                                         RegAddrType WriteStartAddr,
+                                         RegCountType WritePointCount,
+                                         const RegDataType* WriteData ) override;
+    virtual FIFOCountType DoReadFIFOQueue( Context const & Context,
+                                          FIFOAddrType FIFOAddr,
+                                          RegDataType* Data ) override;
+    virtual std::optional<DeviceObjectIdType> DoReadDeviceIdentification(
+                                                  Context const & Context,
+                                                  ReadDeviceIdCode Code,
+                                                  DeviceObjectIdType ObjectId,
+                                                  DeviceIdentification& Result ) override;
+private:
+    TCommPort commPort_;
+    int retryCount_;
+    unsigned timeoutValue_ { MODBUS_ASCII_DEFAULT_TIMEOUT };
+    std::optional<unsigned> transactionTimeout_;
+
+    /** @brief Length in characters of an exception response, and of the shortest valid response. */
+    static constexpr FrameCont::size_type ExceptionFrameChars = 11;
+
+    /** @brief Maximum length in characters of an ASCII frame (Modbus over serial line, 2.5.2.1). */
+    static constexpr FrameCont::size_type MaxFrameChars = 513;
+
+    /** @brief ASCII frame length for a PDU of @p PDULength bytes (colon, address, LRC, CR LF added). */
+    static constexpr FrameCont::size_type GetFrameChars( size_t PDULength ) noexcept {
+        return 1 + 2 * ( 1 + PDULength + 1 ) + 2;
+    }
+
+    /**
+     * @brief Sends @p TxFrame (slave address and PDU) and returns the response (slave
+     *        address and PDU, LRC removed), retrying on timeout, malformed frame, LRC
+     *        error or mismatched response.
+     * @details The TransactionPolicy of @p Context (completed by the slave policy)
+     *  overrides RetryCount and TimeoutValue, and sets the pause before each retry.
+     * @param HeaderLength Number of PDU bytes needed by @p GetPDULength.
+     * @param GetPDULength Callable that returns the length of the response PDU given the
+     *                     slave address and the first @p HeaderLength PDU bytes.  If the
+     *                     frame read does not end with CR LF, it is called again with
+     *                     every byte read and the reading goes on while the length grows.
+     */
+    template<typename PDULengthFn>
+    FrameCont Transact( Context const & Context, FrameCont const & TxFrame,
+                        size_t HeaderLength, PDULengthFn GetPDULength );
+
+    /** @brief Transact() for a response PDU of fixed length. */
+    FrameCont Transact( Context const & Context, FrameCont const & TxFrame,
+                        size_t ResponseLength );
+
+    template<typename PDULengthFn>
+    bool TransactInt( Context const & Context,
+                      FrameCont const & TxFrame, FrameCont const & TxChars,
+                      FrameCont& RxFrame,
+                      size_t HeaderLength, PDULengthFn GetPDULength,
+                      bool NoThrow );
+
+    /**
+     * @brief Reads the first ExceptionFrameChars characters of a frame, discarding
+     *        whatever precedes the colon; @c false on timeout.
+     */
+    bool ReadFrameStart( FrameCont& RxChars );
+
+    /** @brief Appends @p Count characters read from the port; @c false on timeout. */
+    bool ReadChars( FrameCont& RxChars, FrameCont::size_type Count );
+
+    /** @brief Returns @c true if @p RxChars ends with CR LF. */
+    static bool IsTerminated( FrameCont const & RxChars ) noexcept {
+        return RxChars.size() >= 2 &&
+               RxChars[RxChars.size() - 2] == '\r' && RxChars.back() == '\n';
+    }
+
+    /** @brief Encodes slave address and PDU as an ASCII frame, LRC and delimiters included. */
+    static FrameCont ToASCII( FrameCont const & Frame );
+
+    /**
+     * @brief Decodes the hex characters in [@p Begin, @p End) and appends the bytes to
+     *        @p Frame, summing them into @p LRCSum (0 for a frame with a valid LRC).
+     * @return @c false on an odd number of characters or on a non-hex character.
+     */
+    static bool FromASCII( FrameCont::const_iterator Begin, FrameCont::const_iterator End,
+                           FrameCont& Frame, uint8_t& LRCSum ) noexcept;
+
+    /** @brief Builds slave address and the PDU written by @p CodecT::Encode( Args... ). */
+    template<typename CodecT, typename... ArgsT>
+    static FrameCont EncodeFrame( Context const & Context, size_t PDULength,
+                                  ArgsT... Args );
+
+    /** @brief Passes the body of a response PDU returned by Transact() to @p CodecT::Decode. */
+    template<typename CodecT, typename... ArgsT>
+    static auto DecodeFrame( Context const & Context, FrameCont const & RxFrame,
+                             ArgsT... Args );
+
+    template<FunctionCode FC>
+    void ReadRegisters( Context const & Context,
+                        RegAddrType StartAddr, RegCountType PointCount,
+                        RegDataType* Data );
+
+    template<FunctionCode FC>
+    void ReadBits( Context const & Context,
+                   CoilAddrType StartAddr, CoilCountType PointCount,
+                   CoilDataType* Data );
+
+    static String ParityToStr( int Val );
+    static String StopBitsToStr( int Val );
+};
+//---------------------------------------------------------------------------
+
+template<typename CodecT, typename... ArgsT>
+ASCIIProtocol::FrameCont ASCIIProtocol::EncodeFrame( Context const & Context,
+                                                     size_t PDULength,
+                                                     ArgsT... Args )
+{
+    FrameCont TxFrame;
+    TxFrame.reserve( 1 + PDULength );
+    std::back_insert_iterator<FrameCont> TxFrameBkInsIt( TxFrame );
+    *TxFrameBkInsIt++ = Context.GetSlaveAddr();
+    CodecT::Encode( TxFrameBkInsIt, Args... );
+    return TxFrame;
+}
+//---------------------------------------------------------------------------
+
+template<typename CodecT, typename... ArgsT>
+auto ASCIIProtocol::DecodeFrame( Context const & Context, FrameCont const & RxFrame,
+                                 ArgsT... Args )
+{
+    // Skip slave address and function code
+    return CodecT::Decode( Context, RxFrame.data() + 2, RxFrame.size() - 2, Args... );
+}
+//---------------------------------------------------------------------------
+
+template<typename PDULengthFn>
+ASCIIProtocol::FrameCont ASCIIProtocol::Transact( Context const & Context,
+                                                  FrameCont const & TxFrame,
+                                                  size_t HeaderLength,
+                                                  PDULengthFn GetPDULength )
+{
+    TransactionPolicy Policy = GetEffectivePolicy( Context );
+    int const Retries = Policy.RetryCount.value_or( retryCount_ );
+
+    FrameCont const TxChars = ToASCII( TxFrame );
+    FrameCont RxFrame;
+    for ( int Idx = 0 ; ; ++Idx ) {
+        WaitBeforeRetry( Policy.Backoff.value_or( 0 ), Idx );
+        // An adaptive timeout grows after every unanswered attempt
+        if ( Idx && GetAdaptiveTimeout() ) {
+            Policy = GetEffectivePolicy( Context );
+        }
+        transactionTimeout_ = Policy.Timeout;
+        bool const Answered =
+            RunAttempt(
+                Context, Idx,
+                [&]() {
+                    return TransactInt( Context, TxFrame, TxChars, RxFrame, HeaderLength,
+                                        GetPDULength, Idx < Retries );
+                }
+            );
+        if ( Answered ) {
+            return RxFrame;
+        }
+    }
+}
+//---------------------------------------------------------------------------
+
+template<typename PDULengthFn>
+bool ASCIIProtocol::TransactInt( Context const & Context,
+                                 FrameCont const & TxFrame, FrameCont const & TxChars,
+                                 FrameCont& RxFrame,
+                                 size_t HeaderLength, PDULengthFn GetPDULength,
+                                 bool NoThrow )
+{
+    DoInputBufferClear();
+
+    DoWrite( TxChars );
+
+    // Every response is at least as long as an exception response: read that much
+    // first, then the rest of the header (if any) and finally the rest of the frame.
+    FrameCont RxChars;
+    RxChars.reserve( GetFrameChars( PDU::MaxLength ) );
+    bool Complete = ReadFrameStart( RxChars );
+
+    FrameCont Header;
+    uint8_t LRCSum {};
+    if ( Complete && FromASCII( RxChars.begin() + 1, RxChars.begin() + 5, Header, LRCSum )
+                  && !( Header[1] & 0x80 ) ) {
+        FrameCont::size_type const HeaderChars = 1 + 2 * ( 1 + HeaderLength );
+        if ( HeaderChars > RxChars.size() ) {
+            Complete = ReadChars( RxChars, HeaderChars - RxChars.size() );
+        }
+        size_t PDULength {};
+        if ( Complete ) {
+            Header.clear();
+            if ( FromASCII( RxChars.begin() + 1, RxChars.begin() + HeaderChars,
+                            Header, LRCSum ) ) {
+                PDULength = GetPDULength( Header );
+            }
+        }
+        // Hex digits never include CR LF: a response read in stages (FC43) that does not
+        // end yet goes on with the characters read in place of the LRC and terminator
+        while ( Complete ) {
+            FrameCont::size_type const FrameChars = GetFrameChars( PDULength );
+            if ( !PDULength || PDULength > PDU::MaxLength || FrameChars < RxChars.size() ) {
+                if ( NoThrow ) {
+                    return false;
+                }
+                else {
+                    throw EContextException( Context, _D( "Invalid frame length" ) );
+                }
+            }
+            Complete = ReadChars( RxChars, FrameChars - RxChars.size() );
+            if ( !Complete || IsTerminated( RxChars ) ) {
+                break;
+            }
+            Header.clear();
+            if ( !FromASCII( RxChars.begin() + 1, RxChars.end(), Header, LRCSum ) ) {
+                break;
+            }
+            size_t const Length = GetPDULength( Header );
+            if ( Length <= PDULength ) {
+                break;
+            }
+            PDULength = Length;
+        }
+    }
+
+    if ( !Complete ) {
+        if ( NoThrow ) {
+            return false;
+        }
+        else {
+            throw EContextException( Context, _D( "Timeout error" ) );
+        }
+    }
+
+    if ( !IsTerminated( RxChars ) ) {
+        if ( NoThrow ) {
+            return false;
+        }
+        else {
+            throw EContextException( Context, _D( "Missing frame terminator (RX)" ) );
+        }
+    }
+
+    RxFrame.clear();
+    LRCSum = 0;
+    if ( !FromASCII( RxChars.begin() + 1, RxChars.end() - 2, RxFrame, LRCSum ) ) {
+        if ( NoThrow ) {
+            return false;
+        }
+        else {
+            throw EContextException( Context, _D( "Invalid character (RX)" ) );
+        }
+    }
+
+    if ( LRCSum ) {
+        if ( NoThrow ) {
+            return false;
+        }
+        else {
+            throw EContextException( Context, _D( "Bad LRC (RX)" ) );
+        }
+    }
+    RxFrame.pop_back();
+
+    if ( RxFrame[0] != TxFrame[0] ) {
+        if ( NoThrow ) {
+            return false;
+        }
+        else {
+            throw EContextException( Context, _D( "Slave address mismatch" ) );
+        }
+    }
+
+    // A well-formed exception response is the slave's answer: retrying cannot change it
+    if ( RxFrame.size() == 3 && ( RxFrame[1] & 0x7F ) == TxFrame[1] && ( RxFrame[1] & 0x80 ) ) {
+        RaiseStandardException( Context, ExceptionCode( RxFrame[2] ) );
+    }
+
+    if ( RxFrame[1] != TxFrame[1] ) {
+        if ( NoThrow ) {
+            return false;
+        }
+        else {
+            throw EContextException( Context, _D( "Function code mismatch" ) );
+        }
+    }
+
+    return true;
+}
+
+//---------------------------------------------------------------------------
+}; // End of namespace Master
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
+#endif
@@ -0,0 +1,710 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <utility>
+
+#include "ModbusCapture.h"
+#include "ModbusPDU.h"
+#include "ModbusTCP.h"
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace Master {
+//---------------------------------------------------------------------------
+
+namespace {
+
+constexpr char FileMagic[4] = { 'M', 'B', 'C', 'P' };
+constexpr uint16_t FileVersion = 1;
+constexpr size_t FileHeaderLength = 8;
+constexpr size_t RecordHeaderLength = 16;
+constexpr size_t MBAPHeaderLength = 7;
+
+using FileRecordCodec = PDU::FileRecordCodec;
+
+void PutLE( uint8_t* Out, uint64_t Val, size_t Size ) noexcept
+{
+    for ( size_t Idx = 0 ; Idx < Size ; ++Idx ) {
+        Out[Idx] = static_cast<uint8_t>( Val >> ( 8 * Idx ) );
+    }
+}
+
+uint64_t GetLE( uint8_t const * In, size_t Size ) noexcept
+{
+    uint64_t Val {};
+    for ( size_t Idx = Size ; Idx ; --Idx ) {
+        Val = ( Val << 8 ) | In[Idx - 1];
+    }
+    return Val;
+}
+
+uint16_t GetBE( uint8_t const * In ) noexcept
+{
+    return static_cast<uint16_t>( ( static_cast<uint16_t>( In[0] ) << 8 ) | In[1] );
+}
+
+int64_t GetCaptureTime() noexcept
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    ).count();
+}
+
+/** @brief Returns @c true if an RTU frame ends with the CRC of its other bytes. */
+bool IsRTUFrameValid( std::vector<uint8_t> const & Frame )
+{
+    if ( Frame.size() < 4 ) {
+        return false;
+    }
+    uint8_t CRC[2];
+    RTUFramingProtocol::WriteCRC( CRC, Frame.begin(), Frame.end() - 2 );
+    return CRC[0] == Frame[Frame.size() - 2] && CRC[1] == Frame[Frame.size() - 1];
+}
+
+} // End of anonymous namespace
+
+//---------------------------------------------------------------------------
+
+CaptureRecorder::CaptureRecorder( String const & FileName, size_t RingCapacity )
+  : fileName_( FileName )
+  , out_( std::filesystem::path( FileName.c_str() ), std::ios::binary | std::ios::trunc )
+  , ringCapacity_( RingCapacity )
+{
+    uint8_t Header[FileHeaderLength] {};
+    std::memcpy( Header, FileMagic, sizeof FileMagic );
+    PutLE( Header + 4, FileVersion, 2 );
+    out_.write( reinterpret_cast<char const *>( Header ), sizeof Header );
+    out_.flush();
+    if ( !out_ ) {
+        throw EBaseException(
+            Format( _D( "Unable to create \"%s\"" ), ARRAYOFCONST( ( FileName ) ) )
+        );
+    }
+}
+//---------------------------------------------------------------------------
+
+CaptureRecorder::~CaptureRecorder()
+{
+    Stop();
+    for ( auto const & Item : links_ ) {
+        if ( Item->TCPIP ) {
+            Item->TCPIP->SetFlowEventHandler( Item->PrevTCPIPEvent );
+        }
+        else {
+            Item->RTU->SetFlowEventHandler( Item->PrevRTUEvent );
+        }
+    }
+}
+//---------------------------------------------------------------------------
+
+CaptureRecorder::Link& CaptureRecorder::AddLink( void const * Proto, uint16_t LinkId,
+                                                 CaptureFraming Framing )
+{
+    if ( IsRunning() ) {
+        throw EBaseException( _D( "Links must be attached before the capture starts" ) );
+    }
+    for ( auto const & Item : links_ ) {
+        if ( Item->TCPIP == Proto || Item->RTU == Proto ) {
+            throw EBaseException(
+                Format( _D( "Link %u is already attached" ),
+                        ARRAYOFCONST( ( static_cast<unsigned>( Item->LinkId ) ) ) )
+            );
+        }
+    }
+    links_.push_back( std::make_unique<Link>( LinkId, Framing, ringCapacity_ ) );
+    return *links_.back();
+}
+//---------------------------------------------------------------------------
+
+void CaptureRecorder::Attach( TCPIPProtocol& Proto, uint16_t LinkId )
+{
+    Link& Target = AddLink( &Proto, LinkId, CaptureFraming::MBAP );
+    Target.TCPIP = &Proto;
+    Target.PrevTCPIPEvent = Proto.SetFlowEventHandler( OnTCPIPFlow );
+}
+//---------------------------------------------------------------------------
+
+void CaptureRecorder::Attach( RTUFramingProtocol& Proto, uint16_t LinkId )
+{
+    Link& Target = AddLink( &Proto, LinkId, CaptureFraming::RTU );
+    Target.RTU = &Proto;
+    Target.PrevRTUEvent = Proto.SetFlowEventHandler( OnRTUFlow );
+}
+//---------------------------------------------------------------------------
+
+void __fastcall CaptureRecorder::OnTCPIPFlow( TCPIPProtocol& Sender,
+                                              TCPIPProtocol::FlowDirection Dir,
+                                              TBytes const & Frame )
+{
+    for ( auto const & Item : links_ ) {
+        if ( Item->TCPIP == &Sender ) {
+            size_t const Length = static_cast<size_t>( Frame.Length );
+            Record(
+                *Item,
+                Dir == TCPIPProtocol::FlowDirection::TX ? CaptureDirection::TX : CaptureDirection::RX,
+                Length ? &Frame[0] : nullptr, Length
+            );
+            if ( Item->PrevTCPIPEvent ) {
+                Item->PrevTCPIPEvent( Sender, Dir, Frame );
+            }
+            return;
+        }
+    }
+}
+//---------------------------------------------------------------------------
+
+void __fastcall CaptureRecorder::OnRTUFlow( RTUFramingProtocol& Sender,
+                                            RTUFramingProtocol::FlowDirection Dir,
+                                            RTUFramingProtocol::FrameCont const & Frame )
+{
+    for ( auto const & Item : links_ ) {
+        if ( Item->RTU == &Sender ) {
+            Record(
+                *Item,
+                Dir == RTUFramingProtocol::FlowDirection::TX ? CaptureDirection::TX : CaptureDirection::RX,
+                Frame.data(), Frame.size()
+            );
+            if ( Item->PrevRTUEvent ) {
+                Item->PrevRTUEvent( Sender, Dir, Frame );
+            }
+            return;
+        }
+    }
+}
+//---------------------------------------------------------------------------
+
+void CaptureRecorder::Record( Link& Target, CaptureDirection Dir, uint8_t const * Data,
+                              size_t Length )
+{
+    if ( Length > MODBUS_CAPTURE_MAX_FRAME_LENGTH ) {
+        dropped_.fetch_add( 1, std::memory_order_relaxed );
+        return;
+    }
+    Slot Item;
+    Item.Time = GetCaptureTime();
+    Item.Length = static_cast<uint16_t>( Length );
+    Item.Dir = Dir;
+    if ( Length ) {
+        std::memcpy( Item.Data, Data, Length );
+    }
+    if ( !Target.Ring.Push( &Item, 1 ) ) {
+        dropped_.fetch_add( 1, std::memory_order_relaxed );
+    }
+}
+//---------------------------------------------------------------------------
+
+void CaptureRecorder::Start()
+{
+    if ( writer_.joinable() ) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> Lock( mutex_ );
+        stopped_ = false;
+    }
+    writer_ = std::thread( &CaptureRecorder::Run, this );
+}
+//---------------------------------------------------------------------------
+
+void CaptureRecorder::Stop()
+{
+    {
+        std::lock_guard<std::mutex> Lock( mutex_ );
+        stopped_ = true;
+    }
+    wakeUp_.notify_one();
+    if ( writer_.joinable() ) {
+        writer_.join();
+        // The writer is gone: this thread is now the only consumer of the rings
+        Drain();
+    }
+}
+//---------------------------------------------------------------------------
+
+void CaptureRecorder::Run()
+{
+    std::unique_lock<std::mutex> Lock( mutex_ );
+    while ( !stopped_ ) {
+        wakeUp_.wait_for(
+            Lock, std::chrono::milliseconds( MODBUS_CAPTURE_DEFAULT_FLUSH_INTERVAL ),
+            [this]() { return stopped_; }
+        );
+        Lock.unlock();
+        Drain();
+        Lock.lock();
+    }
+}
+//---------------------------------------------------------------------------
+
+void CaptureRecorder::Drain()
+{
+    constexpr size_t BatchSize = 32;
+    Slot Batch[BatchSize];
+    uint8_t Header[RecordHeaderLength] {};
+
+    for ( auto const & Item : links_ ) {
+        while ( size_t const Count = Item->Ring.Pop( Batch, BatchSize ) ) {
+            if ( failed_ ) {
+                dropped_.fetch_add( Count, std::memory_order_relaxed );
+                continue;
+            }
+            for ( size_t Idx = 0 ; Idx < Count ; ++Idx ) {
+                Slot const & Frame = Batch[Idx];
+                PutLE( Header, static_cast<uint64_t>( Frame.Time ), 8 );
+                PutLE( Header + 8, Item->LinkId, 2 );
+                Header[10] = static_cast<uint8_t>( Frame.Dir );
+                Header[11] = static_cast<uint8_t>( Item->Framing );
+                PutLE( Header + 12, Frame.Length, 2 );
+                out_.write( reinterpret_cast<char const *>( Header ), sizeof Header );
+                out_.write( reinterpret_cast<char const *>( Frame.Data ), Frame.Length );
+            }
+            if ( !out_ ) {
+                failed_ = true;
+                dropped_.fetch_add( Count, std::memory_order_relaxed );
+            }
+            else {
+                written_.fetch_add( Count, std::memory_order_relaxed );
+            }
+        }
+    }
+    out_.flush();
+    if ( !out_ ) {
+        failed_ = true;
+    }
+}
+//---------------------------------------------------------------------------
+
+CaptureReader::CaptureReader( String const & FileName )
+  : fileName_( FileName )
+  , in_( std::filesystem::path( FileName.c_str() ), std::ios::binary )
+{
+    if ( !in_ ) {
+        throw EBaseException(
+            Format( _D( "Unable to open \"%s\"" ), ARRAYOFCONST( ( FileName ) ) )
+        );
+    }
+    uint8_t Header[FileHeaderLength] {};
+    in_.read( reinterpret_cast<char*>( Header ), sizeof Header );
+    if ( !in_ || std::memcmp( Header, FileMagic, sizeof FileMagic ) ||
+         GetLE( Header + 4, 2 ) != FileVersion ) {
+        throw EBaseException(
+            Format(
+                _D( "\"%s\" is not a capture file of version %u" )
+              , ARRAYOFCONST( ( FileName, static_cast<unsigned>( FileVersion ) ) )
+            )
+        );
+    }
+}
+//---------------------------------------------------------------------------
+
+bool CaptureReader::Read( CaptureFrame& Frame )
+{
+    uint8_t Header[RecordHeaderLength];
+    in_.read( reinterpret_cast<char*>( Header ), sizeof Header );
+    if ( !in_.gcount() && in_.eof() ) {
+        return false;
+    }
+    if ( in_ ) {
+        Frame.Time = static_cast<int64_t>( GetLE( Header, 8 ) );
+        Frame.LinkId = static_cast<uint16_t>( GetLE( Header + 8, 2 ) );
+        Frame.Dir = static_cast<CaptureDirection>( Header[10] );
+        Frame.Framing = static_cast<CaptureFraming>( Header[11] );
+        Frame.Data.resize( static_cast<size_t>( GetLE( Header + 12, 2 ) ) );
+        in_.read( reinterpret_cast<char*>( Frame.Data.data() ),
+                  static_cast<std::streamsize>( Frame.Data.size() ) );
+    }
+    if ( !in_ ) {
+        throw EBaseException(
+            Format( _D( "Truncated capture file \"%s\"" ), ARRAYOFCONST( ( fileName_ ) ) )
+        );
+    }
+    return true;
+}
+//---------------------------------------------------------------------------
+
+std::vector<CaptureFrame> CaptureReader::Load( String const & FileName )
+{
+    CaptureReader Reader( FileName );
+    std::vector<CaptureFrame> Frames;
+    CaptureFrame Frame;
+    while ( Reader.Read( Frame ) ) {
+        Frames.push_back( Frame );
+    }
+    return Frames;
+}
+//---------------------------------------------------------------------------
+
+/** @brief Serves the captured reply of the request in progress as if read from a socket. */
+class CaptureReplayer::ReplayProtocol : public TCPProtocol {
+public:
+    void SetReply( std::vector<uint8_t> const & Reply ) noexcept {
+        reply_ = &Reply;
+        offset_ = 0;
+    }
+protected:
+    virtual String DoGetProtocolName() const override { return _D( "Modbus capture replay" ); }
+    virtual String DoGetHost() const override { return String(); }
+    virtual void DoSetHost( String /*Val*/ ) override {}
+    virtual uint16_t DoGetPort() const override { return 0; }
+    virtual void DoSetPort( uint16_t /*Val*/ ) override {}
+    virtual void DoOpen() override { open_ = true; }
+    virtual void DoClose() override { open_ = false; }
+    virtual bool DoIsConnected() const noexcept override { return open_; }
+
+    virtual void DoWrite( TBytes const OutBuffer ) override
+    {
+        // The reply must echo the transaction identifier of the request
+        std::copy( GetData( OutBuffer ), GetData( OutBuffer ) + 2, transactionId_ );
+    }
+
+    virtual void DoRead( TBytes& InBuffer, size_t Length ) override
+    {
+        if ( !reply_ || reply_->size() - offset_ < Length ) {
+            throw EBaseException( _D( "Captured reply is shorter than its header" ) );
+        }
+        SetLength( InBuffer, static_cast<int>( Length ) );
+        std::copy(
+            reply_->data() + offset_, reply_->data() + offset_ + Length,
+            GetData( InBuffer )
+        );
+        if ( !offset_ && Length >= 2 ) {
+            std::copy( transactionId_, transactionId_ + 2, GetData( InBuffer ) );
+        }
+        offset_ += Length;
+    }
+private:
+    std::vector<uint8_t> const * reply_ {};
+    size_t                       offset_ {};
+    uint8_t                      transactionId_[2] {};
+    bool                         open_ {};
+};
+//---------------------------------------------------------------------------
+
+CaptureReplayer::CaptureReplayer( std::vector<CaptureFrame> const & Frames )
+  : proto_( std::make_unique<ReplayProtocol>() )
+{
+    // Links are paired independently; records of different links may interleave
+    std::vector<size_t> Order( Frames.size() );
+    for ( size_t Idx = 0 ; Idx < Order.size() ; ++Idx ) {
+        Order[Idx] = Idx;
+    }
+    std::stable_sort(
+        Order.begin(), Order.end(),
+        [&Frames]( size_t Lhs, size_t Rhs ) { return Frames[Lhs].Time < Frames[Rhs].Time; }
+    );
+
+    std::vector<Item> Parsed;
+    std::map<std::pair<uint16_t,uint16_t>,size_t> PendingMBAP;   // ( Link, TID ) -> Parsed
+    std::map<uint16_t,size_t> PendingRTU;                         // Link -> Parsed
+
+    for ( size_t FrameIdx : Order ) {
+        CaptureFrame const & Frame = Frames[FrameIdx];
+        std::vector<uint8_t> const & Data = Frame.Data;
+        bool const IsRTU = Frame.Framing == CaptureFraming::RTU;
+
+        if ( Frame.Dir == CaptureDirection::TX ) {
+            Item Target;
+            Target.Time = Frame.Time;
+            bool Valid;
+            if ( IsRTU ) {
+                Valid = IsRTUFrameValid( Data ) &&
+                        ParseRequest( Target, Data.data() + 1, Data.size() - 3, Data[0] );
+            }
+            else {
+                Valid = Data.size() > MBAPHeaderLength &&
+                        GetBE( Data.data() + 4 ) == Data.size() - 6 &&
+                        ParseRequest( Target, Data.data() + MBAPHeaderLength,
+                                      Data.size() - MBAPHeaderLength, Data[6] );
+            }
+            if ( !Valid ) {
+                ++skipped_;
+                continue;
+            }
+            Parsed.push_back( std::move( Target ) );
+            if ( IsRTU ) {
+                PendingRTU[Frame.LinkId] = Parsed.size() - 1;
+            }
+            else {
+                PendingMBAP[std::make_pair( Frame.LinkId, GetBE( Data.data() ) )] =
+                    Parsed.size() - 1;
+            }
+            continue;
+        }
+
+        if ( IsRTU ) {
+            auto const It = PendingRTU.find( Frame.LinkId );
+            if ( It == PendingRTU.end() || !IsRTUFrameValid( Data ) ) {
+                ++unmatched_;
+                continue;
+            }
+            // Unit and PDU behind an MBAP header; the transaction identifier is set on replay
+            std::vector<uint8_t>& Reply = Parsed[It->second].Reply;
+            size_t const Length = Data.size() - 2;
+            Reply.assign( MBAPHeaderLength - 1, 0 );
+            Reply[4] = static_cast<uint8_t>( Length >> 8 );
+            Reply[5] = static_cast<uint8_t>( Length );
+            Reply.insert( Reply.end(), Data.begin(), Data.end() - 2 );
+            PendingRTU.erase( It );
+        }
+        else {
+            auto const It =
+                Data.size() >= 2 ?
+                  PendingMBAP.find( std::make_pair( Frame.LinkId, GetBE( Data.data() ) ) )
+                :
+                  PendingMBAP.end();
+            if ( It == PendingMBAP.end() ) {
+                ++unmatched_;
+                continue;
+            }
+            Parsed[It->second].Reply = Data;
+            PendingMBAP.erase( It );
+        }
+    }
+
+    for ( Item& Target : Parsed ) {
+        if ( Target.Reply.empty() ) {
+            ++unanswered_;
+        }
+        else {
+            items_.push_back( std::move( Target ) );
+        }
+    }
+
+    // The buffers no longer move
+    for ( Item& Target : items_ ) {
+        Request& Req = Target.Req;
+        switch ( Req.FnCode ) {
+            case FunctionCode::ReadCoilStatus:
+            case FunctionCode::ReadInputStatus:
+                Req.CoilData = Target.Bits.data();
+                break;
+            case FunctionCode::ReadHoldingRegisters:
+            case FunctionCode::ReadInputRegisters:
+            case FunctionCode::Diagnostics:
+            case FunctionCode::FetchCommEventCtr:
+            case FunctionCode::ReadFIFOQueue:
+                Req.RegData = Target.Regs.data();
+                break;
+            case FunctionCode::ReadGeneralReference:
+                Req.SubRequests = Target.SubRequests.data();
+                Req.RegData = Target.Regs.data();
+                break;
+            case FunctionCode::WriteGeneralReference:
+                Req.SubRequests = Target.SubRequests.data();
+                Req.RegSource = Target.Regs.data();
+                break;
+            case FunctionCode::ForceMultipleCoils:
+                Req.CoilSource = Target.Bits.data();
+                break;
+            case FunctionCode::PresetMultipleRegisters:
+                Req.RegSource = Target.Regs.data();
+                break;
+            default:
+                break;
+        }
+    }
+
+    proto_->Open();
+}
+//---------------------------------------------------------------------------
+
+CaptureReplayer::~CaptureReplayer()
+{
+}
+//---------------------------------------------------------------------------
+
+bool CaptureReplayer::ParseRequest( Item& Target, uint8_t const * PDU, size_t Length,
+                                    Context::SlaveAddrType SlaveAddr )
+{
+    if ( !Length ) {
+        return false;
+    }
+    switch ( static_cast<FunctionCode>( PDU[0] ) ) {
+        case FunctionCode::ReadCoilStatus:
+        case FunctionCode::ReadInputStatus:
+            if ( Length != 5 ) {
+                return false;
+            }
+            Target.Bits.resize( ( GetBE( PDU + 3 ) + 7U ) / 8U );
+            Target.Req =
+                static_cast<FunctionCode>( PDU[0] ) == FunctionCode::ReadCoilStatus ?
+                  Request::ReadCoilStatus( SlaveAddr, GetBE( PDU + 1 ), GetBE( PDU + 3 ), nullptr )
+                :
+                  Request::ReadInputStatus( SlaveAddr, GetBE( PDU + 1 ), GetBE( PDU + 3 ), nullptr );
+            return true;
+        case FunctionCode::ReadHoldingRegisters:
+        case FunctionCode::ReadInputRegisters:
+            if ( Length != 5 ) {
+                return false;
+            }
+            Target.Regs.resize( GetBE( PDU + 3 ) );
+            Target.Req =
+                static_cast<FunctionCode>( PDU[0] ) == FunctionCode::ReadHoldingRegisters ?
+                  Request::ReadHoldingRegisters( SlaveAddr, GetBE( PDU + 1 ), GetBE( PDU + 3 ), nullptr )
+                :
+                  Request::ReadInputRegisters( SlaveAddr, GetBE( PDU + 1 ), GetBE( PDU + 3 ), nullptr );
+            return true;
+        case FunctionCode::ForceSingleCoil:
+            if ( Length != 5 ) {
+                return false;
+            }
+            Target.Req =
+                Request::ForceSingleCoil( SlaveAddr, GetBE( PDU + 1 ), GetBE( PDU + 3 ) == 0xFF00 );
+            return true;
+        case FunctionCode::PresetSingleRegister:
+            if ( Length != 5 ) {
+                return false;
+            }
+            Target.Req =
+                Request::PresetSingleRegister( SlaveAddr, GetBE( PDU + 1 ), GetBE( PDU + 3 ) );
+            return true;
+        case FunctionCode::Diagnostics:
+            if ( Length != 5 ) {
+                return false;
+            }
+            Target.Regs.resize( 1 );
+            Target.Req =
+                Request::Diagnostics( SlaveAddr, GetBE( PDU + 1 ), GetBE( PDU + 3 ), nullptr );
+            return true;
+        case FunctionCode::FetchCommEventCtr:
+            if ( Length != 1 ) {
+                return false;
+            }
+            Target.Regs.resize( 2 );
+            Target.Req = Request::FetchCommEventCtr( SlaveAddr, nullptr );
+            return true;
+        case FunctionCode::ForceMultipleCoils:
+            if ( Length < 6 || Length != 6U + PDU[5] ||
+                 PDU[5] != ( GetBE( PDU + 3 ) + 7U ) / 8U ) {
+                return false;
+            }
+            Target.Bits.assign( PDU + 6, PDU + Length );
+            Target.Req =
+                Request::ForceMultipleCoils( SlaveAddr, GetBE( PDU + 1 ), GetBE( PDU + 3 ), nullptr );
+            return true;
+        case FunctionCode::PresetMultipleRegisters:
+            if ( Length < 6 || Length != 6U + PDU[5] || PDU[5] != 2U * GetBE( PDU + 3 ) ) {
+                return false;
+            }
+            for ( size_t Idx = 6 ; Idx < Length ; Idx += 2 ) {
+                Target.Regs.push_back( GetBE( PDU + Idx ) );
+            }
+            Target.Req =
+                Request::PresetMultipleRegisters( SlaveAddr, GetBE( PDU + 1 ), GetBE( PDU + 3 ), nullptr );
+            return true;
+        case FunctionCode::ReadGeneralReference: {
+            // Byte count, then one sub-request header per record range
+            if ( Length < 2 || Length != 2U + PDU[1] || !PDU[1] ||
+                 PDU[1] % FileRecordCodec::SubRequestLength ) {
+                return false;
+            }
+            size_t Count = 0;
+            for ( size_t Offset = 2 ; Offset < Length ;
+                  Offset += FileRecordCodec::SubRequestLength ) {
+                if ( PDU[Offset] != FileRecordCodec::ReferenceType ) {
+                    return false;
+                }
+                FileSubRequest const Sub {
+                    GetBE( PDU + Offset + 1 ), GetBE( PDU + Offset + 3 ), GetBE( PDU + Offset + 5 )
+                };
+                Target.SubRequests.push_back( Sub );
+                Count += Sub.RecordLength;
+            }
+            Target.Regs.resize( Count );
+            Target.Req = Request::ReadGeneralReference( SlaveAddr, nullptr, 0, nullptr );
+            Target.Req.SubReqCount = Target.SubRequests.size();
+            return true;
+        }
+        case FunctionCode::WriteGeneralReference: {
+            // Data length, then each sub-request header followed by its records
+            if ( Length < 2 || Length != 2U + PDU[1] || !PDU[1] ) {
+                return false;
+            }
+            size_t Offset = 2;
+            while ( Offset < Length ) {
+                if ( Length - Offset < FileRecordCodec::SubRequestLength ||
+                     PDU[Offset] != FileRecordCodec::ReferenceType ) {
+                    return false;
+                }
+                FileSubRequest const Sub {
+                    GetBE( PDU + Offset + 1 ), GetBE( PDU + Offset + 3 ), GetBE( PDU + Offset + 5 )
+                };
+                Offset += FileRecordCodec::SubRequestLength;
+                if ( Length - Offset < 2U * Sub.RecordLength ) {
+                    return false;
+                }
+                for ( RecordLengthType Rec = 0 ; Rec < Sub.RecordLength ; ++Rec, Offset += 2 ) {
+                    Target.Regs.push_back( GetBE( PDU + Offset ) );
+                }
+                Target.SubRequests.push_back( Sub );
+            }
+            Target.Req = Request::WriteGeneralReference( SlaveAddr, nullptr, 0, nullptr );
+            Target.Req.SubReqCount = Target.SubRequests.size();
+            return true;
+        }
+        case FunctionCode::MaskWrite4XRegister:
+            if ( Length != 7 ) {
+                return false;
+            }
+            Target.Req =
+                Request::MaskWrite4XRegister(
+                    SlaveAddr, GetBE( PDU + 1 ), GetBE( PDU + 3 ), GetBE( PDU + 5 )
+                );
+            return true;
+        case FunctionCode::ReadFIFOQueue:
+            if ( Length != 3 ) {
+                return false;
+            }
+            Target.Regs.resize( 31 );
+            Target.Req = Request::ReadFIFOQueue( SlaveAddr, GetBE( PDU + 1 ), nullptr );
+            return true;
+        default:
+            return false;
+    }
+}
+//---------------------------------------------------------------------------
+
+ReplayResult CaptureReplayer::Replay( ReplayMode Mode )
+{
+    using Clock = std::chrono::steady_clock;
+
+    ReplayResult Result;
+    Clock::time_point const Start = Clock::now();
+    int64_t const Origin = items_.empty() ? 0 : items_.front().Time;
+    for ( Item& Target : items_ ) {
+        if ( Mode == ReplayMode::RealTime ) {
+            std::this_thread::sleep_until(
+                Start + std::chrono::microseconds( Target.Time - Origin )
+            );
+        }
+        proto_->SetReply( Target.Reply );
+        proto_->Execute( &Target.Req, 1 );
+        ++Result.Transactions;
+        switch ( Target.Req.Status ) {
+            case RequestStatus::Completed:
+                ++Result.Completed;
+                break;
+            case RequestStatus::Exception:
+                ++Result.Exceptions;
+                break;
+            default:
+                ++Result.Failed;
+                break;
+        }
+    }
+    Result.Elapsed =
+        std::chrono::duration_cast<std::chrono::nanoseconds>( Clock::now() - Start );
+    return Result;
+}
+
+//---------------------------------------------------------------------------
+}; // End of namespace Master
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
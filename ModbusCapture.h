@@ -0,0 +1,272 @@
+/**
+ * @file ModbusCapture.h
+ * @brief Modbus::Master::CaptureRecorder, CaptureReader and CaptureReplayer — wire capture
+ *        to a binary file and replay through the MBAP decoder.
+ *
+ * @details A CaptureRecorder attaches to the frame-flow callbacks of any number of links
+ *  (TCPIPProtocol::SetFlowEventHandler(), RTUFramingProtocol::SetFlowEventHandler()) and
+ *  records every frame with a timestamp, its direction and the link identifier given
+ *  to Attach().  The callback only copies the frame into a lock-free ring of its link
+ *  (SPSCRing); a background thread drains the rings to the file, so a slow disk never
+ *  delays a transaction.  Frames that find their ring full, or that are longer than
+ *  MODBUS_CAPTURE_MAX_FRAME_LENGTH bytes, are counted by GetDroppedCount() and lost.
+ *  The callbacks installed before Attach() are still called.
+ *
+ *  File format, little-endian:
+ *  - Header (8 bytes): "MBCP", version (uint16, 1), reserved (uint16).
+ *  - One record per frame: time (int64, microseconds since 1970-01-01 UTC), link
+ *    identifier (uint16), direction (uint8: 0 RX, 1 TX), framing (uint8: 0 MBAP, 1 RTU),
+ *    length (uint16), reserved (uint16), then the frame bytes as seen on the wire (RTU
+ *    frames with their CRC).
+ *  Records are in time order within a link; the records of different links may
+ *  interleave slightly out of order.
+ *
+ *  A CaptureReplayer pairs each request of a capture with its reply (by transaction
+ *  identifier for MBAP, by order for RTU, within each link), rebuilds the Request items
+ *  and runs them through Protocol::Execute() on a TCP transport that serves the captured
+ *  replies: every reply goes through the same framing checks and decoders as live
+ *  traffic.  Replay() runs as fast as possible, to benchmark decoding against a real
+ *  traffic mix, or with the captured timing, to reproduce a field issue.  RTU frames are
+ *  replayed as MBAP frames after their CRC is checked.  Only the function codes Request
+ *  accepts are replayed (FC01–FC06, FC08, FC11, FC15, FC16, FC20–FC22 and FC24); the
+ *  other requests are counted as skipped.
+ */
+
+//---------------------------------------------------------------------------
+
+#ifndef ModbusCaptureH
+#define ModbusCaptureH
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Modbus.h"
+#include "ModbusFIFOStream.h"
+#include "ModbusRTU.h"
+#include "ModbusTCP_IP.h"
+
+/** @brief Default capacity (frames) of the ring of each link. */
+#if !defined( MODBUS_CAPTURE_DEFAULT_RING_CAPACITY )
+  #define MODBUS_CAPTURE_DEFAULT_RING_CAPACITY  1024
+#endif
+
+/** @brief Longest frame recorded: an MBAP header and a PDU of 253 bytes. */
+#if !defined( MODBUS_CAPTURE_MAX_FRAME_LENGTH )
+  #define MODBUS_CAPTURE_MAX_FRAME_LENGTH  260
+#endif
+
+/** @brief Default time (ms) between two drains of the rings to the file. */
+#if !defined( MODBUS_CAPTURE_DEFAULT_FLUSH_INTERVAL )
+  #define MODBUS_CAPTURE_DEFAULT_FLUSH_INTERVAL  50
+#endif
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace Master {
+//---------------------------------------------------------------------------
+
+enum class CaptureDirection : uint8_t { RX, TX };
+
+/** @brief Framing of a captured frame. */
+enum class CaptureFraming : uint8_t {
+    MBAP,   ///< Modbus TCP/UDP: MBAP header and PDU.
+    RTU,    ///< Unit, PDU and CRC.
+};
+
+/** @brief One captured frame. */
+struct CaptureFrame {
+    int64_t              Time {};   ///< Microseconds since 1970-01-01 UTC.
+    uint16_t             LinkId {};
+    CaptureDirection     Dir { CaptureDirection::TX };
+    CaptureFraming       Framing { CaptureFraming::MBAP };
+    std::vector<uint8_t> Data;
+};
+
+/** @brief Records the frames of one or more links to a capture file (see file description). */
+class CaptureRecorder {
+public:
+    /**
+     * @brief Creates (or truncates) the capture file and writes its header.
+     * @param RingCapacity Frames buffered per link while the writer catches up.
+     * @throws EBaseException if the file cannot be created.
+     */
+    explicit CaptureRecorder( String const & FileName,
+                              size_t RingCapacity = MODBUS_CAPTURE_DEFAULT_RING_CAPACITY );
+
+    /** @brief Stops the writer, restores the callbacks of the links and closes the file. */
+    ~CaptureRecorder();
+
+    CaptureRecorder( CaptureRecorder const & Rhs ) = delete;
+    CaptureRecorder& operator=( CaptureRecorder const & Rhs ) = delete;
+
+    /**
+     * @brief Records the frames of a link from now on.
+     * @details Attach every link before Start(); the protocols must outlive the
+     *  recorder or be detached by its destruction first.
+     * @throws EBaseException if the recorder is running or @p Proto is already attached.
+     */
+    void Attach( TCPIPProtocol& Proto, uint16_t LinkId );
+    void Attach( RTUFramingProtocol& Proto, uint16_t LinkId );
+
+    /** @brief Starts the background writer. */
+    void Start();
+
+    /** @brief Writes the buffered frames, flushes the file and stops the writer. */
+    void Stop();
+
+    [[ nodiscard ]] bool IsRunning() const noexcept { return writer_.joinable(); }
+
+    /** @brief Number of frames written to the file. */
+    [[ nodiscard ]] uint64_t GetFrameCount() const noexcept { return written_.load(); }
+
+    /** @brief Number of frames lost: ring full or frame too long. */
+    [[ nodiscard ]] uint64_t GetDroppedCount() const noexcept { return dropped_.load(); }
+
+    /** @brief Returns @c true if writing the file failed; recording stopped at that point. */
+    [[ nodiscard ]] bool HasFailed() const noexcept { return failed_.load(); }
+private:
+    /** @brief A frame in a ring; fixed size, so recording allocates nothing. */
+    struct Slot {
+        int64_t          Time;
+        uint16_t         Length;
+        CaptureDirection Dir;
+        uint8_t          Data[MODBUS_CAPTURE_MAX_FRAME_LENGTH];
+    };
+
+    struct Link {
+        Link( uint16_t Id, CaptureFraming LinkFraming, size_t RingCapacity )
+          : LinkId( Id ), Framing( LinkFraming ), Ring( RingCapacity ) {}
+
+        uint16_t                        LinkId;
+        CaptureFraming                  Framing;
+        SPSCRing<Slot>                  Ring;
+        TCPIPProtocol*                  TCPIP {};
+        TCPIPProtocol::TFlowEvent       PrevTCPIPEvent {};
+        RTUFramingProtocol*             RTU {};
+        RTUFramingProtocol::TFlowEvent  PrevRTUEvent {};
+    };
+
+    String                              fileName_;
+    std::ofstream                       out_;
+    size_t                              ringCapacity_;
+    std::vector<std::unique_ptr<Link>>  links_;
+    std::thread                         writer_;
+    std::mutex                          mutex_;
+    std::condition_variable             wakeUp_;
+    bool                                stopped_ { true };
+    std::atomic<uint64_t>               written_ {};
+    std::atomic<uint64_t>               dropped_ {};
+    std::atomic<bool>                   failed_ {};
+
+    void __fastcall OnTCPIPFlow( TCPIPProtocol& Sender, TCPIPProtocol::FlowDirection Dir,
+                                 TBytes const & Frame );
+    void __fastcall OnRTUFlow( RTUFramingProtocol& Sender,
+                               RTUFramingProtocol::FlowDirection Dir,
+                               RTUFramingProtocol::FrameCont const & Frame );
+    Link& AddLink( void const * Proto, uint16_t LinkId, CaptureFraming Framing );
+    void Record( Link& Target, CaptureDirection Dir, uint8_t const * Data, size_t Length );
+    void Run();
+    void Drain();
+};
+
+/** @brief Reads the frames of a capture file. */
+class CaptureReader {
+public:
+    /**
+     * @brief Opens a capture file and checks its header.
+     * @throws EBaseException if the file cannot be opened or is not a capture file of a
+     *         known version.
+     */
+    explicit CaptureReader( String const & FileName );
+
+    /**
+     * @brief Reads the next frame.
+     * @return @c false at the end of the file.
+     * @throws EBaseException if the file ends within a record.
+     */
+    bool Read( CaptureFrame& Frame );
+
+    /** @brief Reads every frame of a capture file. */
+    [[ nodiscard ]] static std::vector<CaptureFrame> Load( String const & FileName );
+private:
+    String        fileName_;
+    std::ifstream in_;
+};
+
+/** @brief How CaptureReplayer::Replay() paces the transactions. */
+enum class ReplayMode {
+    MaxSpeed,   ///< Back to back.
+    RealTime,   ///< Each request at its captured time from the first one.
+};
+
+/** @brief Outcome of a replay. */
+struct ReplayResult {
+    size_t                   Transactions {};  ///< Requests replayed.
+    size_t                   Completed {};
+    size_t                   Exceptions {};    ///< Replies that are exception responses.
+    size_t                   Failed {};        ///< Replies rejected by the decoder.
+    std::chrono::nanoseconds Elapsed {};
+};
+
+/** @brief Replays a capture through the MBAP decoder (see file description). */
+class CaptureReplayer {
+public:
+    /** @brief Pairs and parses the requests and replies of a capture. */
+    explicit CaptureReplayer( std::vector<CaptureFrame> const & Frames );
+    ~CaptureReplayer();
+
+    CaptureReplayer( CaptureReplayer const & Rhs ) = delete;
+    CaptureReplayer& operator=( CaptureReplayer const & Rhs ) = delete;
+
+    /** @brief Number of requests that will be replayed. */
+    [[ nodiscard ]] size_t GetTransactionCount() const noexcept { return items_.size(); }
+
+    /** @brief Requests not replayed: function code not supported or malformed frame. */
+    [[ nodiscard ]] size_t GetSkippedCount() const noexcept { return skipped_; }
+
+    /** @brief Requests without a captured reply (not replayed). */
+    [[ nodiscard ]] size_t GetUnansweredCount() const noexcept { return unanswered_; }
+
+    /** @brief Replies that answer no captured request, or with a bad RTU CRC. */
+    [[ nodiscard ]] size_t GetUnmatchedCount() const noexcept { return unmatched_; }
+
+    /** @brief Runs every paired request, in capture order. */
+    ReplayResult Replay( ReplayMode Mode = ReplayMode::MaxSpeed );
+private:
+    class ReplayProtocol;
+
+    /** @brief A request rebuilt from its frame, with its buffers and captured reply. */
+    struct Item {
+        int64_t                     Time {};
+        Request                     Req {};
+        std::vector<RegDataType>    Regs;
+        std::vector<CoilDataType>   Bits;
+        std::vector<FileSubRequest> SubRequests;   ///< FC20/FC21.
+        std::vector<uint8_t>        Reply;         ///< MBAP frame.
+    };
+
+    std::vector<Item>                items_;
+    std::unique_ptr<ReplayProtocol>  proto_;
+    size_t                           skipped_ {};
+    size_t                           unanswered_ {};
+    size_t                           unmatched_ {};
+
+    bool ParseRequest( Item& Target, uint8_t const * PDU, size_t Length,
+                       Context::SlaveAddrType SlaveAddr );
+};
+
+//---------------------------------------------------------------------------
+}; // End of namespace Master
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
+#endif
@@ -0,0 +1,215 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "ModbusChangeDetect.h"
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace ChangeDetect {
+//---------------------------------------------------------------------------
+
+ChangeDetector::ChangeDetector( BlockType Type, size_t PointCount, std::vector<Tag> Tags )
+  : type_( Type )
+  , pointCount_( PointCount )
+  , tags_( std::move( Tags ) )
+{
+    for ( size_t Idx = 0 ; Idx < tags_.size() ; ++Idx ) {
+        Tag const & Item = tags_[Idx];
+        bool const Valid =
+            type_ == BlockType::Bits ?
+                Item.Type == TagType::Bit && Item.Offset < pointCount_
+            :
+                Item.Type != TagType::Bit &&
+                Item.Offset + GetTagSize( Item.Type ) / sizeof( RegDataType ) <= pointCount_;
+        if ( !Valid ) {
+            throw EBaseException(
+                Format(
+                    _D( "Tag %d does not fit the scanned block" )
+                  , ARRAYOFCONST( ( static_cast<int>( Idx ) ) )
+                )
+            );
+        }
+    }
+
+    size_t const ImageSize =
+        type_ == BlockType::Bits ?
+            ( pointCount_ + 7 ) / 8
+        :
+            pointCount_ * sizeof( RegDataType );
+    image_.resize( ImageSize );
+    changedMask_.resize( ( ImageSize + 63 ) / 64 );
+    reported_.resize( tags_.size() );
+    changes_.reserve( tags_.size() );
+}
+//---------------------------------------------------------------------------
+
+size_t ChangeDetector::Update( RegDataType const * Regs )
+{
+    if ( type_ != BlockType::Registers ) {
+        throw EBaseException( _D( "Change detector expects a bit block" ) );
+    }
+    return Scan( Regs );
+}
+//---------------------------------------------------------------------------
+
+size_t ChangeDetector::Update( CoilDataType const * Bits )
+{
+    if ( type_ != BlockType::Bits ) {
+        throw EBaseException( _D( "Change detector expects a register block" ) );
+    }
+    return Scan( Bits );
+}
+//---------------------------------------------------------------------------
+
+void ChangeDetector::Subscribe( TChangeEvent EventHandler )
+{
+    if ( EventHandler ) {
+        subscribers_.push_back( EventHandler );
+    }
+}
+//---------------------------------------------------------------------------
+
+void ChangeDetector::Unsubscribe( TChangeEvent EventHandler )
+{
+    subscribers_.erase(
+        std::remove( subscribers_.begin(), subscribers_.end(), EventHandler ),
+        subscribers_.end()
+    );
+}
+//---------------------------------------------------------------------------
+
+size_t ChangeDetector::Scan( void const * Data )
+{
+    bool const Changed =
+        DataConv::UpdateImage( Data, image_.data(), image_.size(), changedMask_.data() );
+
+    changes_.clear();
+    if ( !primed_ ) {
+        for ( size_t Idx = 0 ; Idx < tags_.size() ; ++Idx ) {
+            reported_[Idx] = GetTagValue( tags_[Idx] );
+            changes_.push_back( { Idx, reported_[Idx] } );
+        }
+        primed_ = true;
+    }
+    else if ( Changed ) {
+        for ( size_t Idx = 0 ; Idx < tags_.size() ; ++Idx ) {
+            Tag const & Item = tags_[Idx];
+            if ( IsTagChanged( Item ) ) {
+                double const Value = GetTagValue( Item );
+                if ( IsBeyondDeadband( Item, reported_[Idx], Value ) ) {
+                    reported_[Idx] = Value;
+                    changes_.push_back( { Idx, Value } );
+                }
+            }
+        }
+    }
+
+    if ( !changes_.empty() ) {
+        // Index loop: a subscriber may unsubscribe itself from the callback
+        for ( size_t Idx = 0 ; Idx < subscribers_.size() ; ++Idx ) {
+            subscribers_[Idx]( *this, changes_.data(), changes_.size() );
+        }
+    }
+    return changes_.size();
+}
+//---------------------------------------------------------------------------
+
+size_t ChangeDetector::GetTagSize( TagType Type ) noexcept
+{
+    switch ( Type ) {
+        case TagType::UInt16:
+        case TagType::Int16:
+            return 2;
+        case TagType::UInt32:
+        case TagType::Int32:
+        case TagType::Float32:
+            return 4;
+        case TagType::Float64:
+            return 8;
+        default:
+            return 0;
+    }
+}
+//---------------------------------------------------------------------------
+
+bool ChangeDetector::IsTagChanged( Tag const & Item ) const noexcept
+{
+    size_t First, Last;
+    if ( type_ == BlockType::Bits ) {
+        First = Last = Item.Offset / 8;
+    }
+    else {
+        First = Item.Offset * sizeof( RegDataType );
+        Last = First + GetTagSize( Item.Type ) - 1;
+    }
+    for ( size_t Byte = First ; Byte <= Last ; ++Byte ) {
+        if ( changedMask_[Byte / 64] & ( uint64_t( 1 ) << ( Byte % 64 ) ) ) {
+            return true;
+        }
+    }
+    return false;
+}
+//---------------------------------------------------------------------------
+
+namespace {
+
+template<typename T>
+double DecodeTag( uint8_t const * Image, size_t Offset, DataConv::WordOrder Order )
+{
+    T Value;
+    DataConv::FromRegisters(
+        reinterpret_cast<RegDataType const *>( Image + Offset * sizeof( RegDataType ) ),
+        1, &Value, Order
+    );
+    return static_cast<double>( Value );
+}
+
+} // End of anonymous namespace
+//---------------------------------------------------------------------------
+
+double ChangeDetector::GetTagValue( Tag const & Item ) const
+{
+    uint8_t const * Image = image_.data();
+    switch ( Item.Type ) {
+        case TagType::UInt16:  return DecodeTag<uint16_t>( Image, Item.Offset, Item.Order );
+        case TagType::Int16:   return DecodeTag<int16_t>( Image, Item.Offset, Item.Order );
+        case TagType::UInt32:  return DecodeTag<uint32_t>( Image, Item.Offset, Item.Order );
+        case TagType::Int32:   return DecodeTag<int32_t>( Image, Item.Offset, Item.Order );
+        case TagType::Float32: return DecodeTag<float>( Image, Item.Offset, Item.Order );
+        case TagType::Float64: return DecodeTag<double>( Image, Item.Offset, Item.Order );
+        case TagType::Bit:     return ( Image[Item.Offset / 8] >> ( Item.Offset % 8 ) ) & 1;
+        default:               return 0.0;
+    }
+}
+//---------------------------------------------------------------------------
+
+bool ChangeDetector::IsBeyondDeadband( Tag const & Item, double Reported,
+                                       double Value ) noexcept
+{
+    if ( Item.Type == TagType::Bit ) {
+        return Value != Reported;
+    }
+    switch ( Item.Deadband ) {
+        case DeadbandType::Absolute:
+            return std::fabs( Value - Reported ) > Item.DeadbandValue;
+        case DeadbandType::Percent:
+            return std::fabs( Value - Reported ) >
+                   std::fabs( Reported ) * Item.DeadbandValue / 100.0;
+        default:
+            return Value != Reported;
+    }
+}
+
+//---------------------------------------------------------------------------
+}; // End of namespace ChangeDetect
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
+
+#pragma package(smart_init)
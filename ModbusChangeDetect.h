@@ -0,0 +1,155 @@
+/**
+ * @file ModbusChangeDetect.h
+ * @brief Modbus::ChangeDetect — deadband change detection on scanned data blocks.
+ *
+ * @details A ChangeDetector sits after the read path: every scanned block (registers
+ *  from FC03/FC04/FC23 or packed bits from FC01/FC02) is handed to Update(), which
+ *  compares it with the previous image using the vector kernel DataConv::UpdateImage()
+ *  and evaluates only the tags whose bytes actually changed.  A tag is reported when
+ *  its new value moves beyond its deadband with respect to the last *reported* value,
+ *  so slow drifts are eventually reported as well.  The changes of one scan are
+ *  delivered to every subscriber as a single array of (tag index, value) pairs.
+ *
+ *  The first Update() after construction or Reset() reports every tag.
+ *
+ *  @code
+ *  std::vector<ChangeDetect::Tag> Tags {
+ *      { 0, ChangeDetect::TagType::Float32, DataConv::WordOrder::CDAB,
+ *        ChangeDetect::DeadbandType::Absolute, 0.5 },
+ *      { 2, ChangeDetect::TagType::UInt16 },
+ *  };
+ *  ChangeDetect::ChangeDetector Detector( ChangeDetect::BlockType::Registers, 125, Tags );
+ *  Detector.Subscribe( Historian->OnChanges );
+ *  ...
+ *  Proto.ReadHoldingRegisters( Ctx, 0, 125, Regs );
+ *  Detector.Update( Regs );
+ *  @endcode
+ */
+
+//---------------------------------------------------------------------------
+
+#ifndef ModbusChangeDetectH
+#define ModbusChangeDetectH
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "Modbus.h"
+#include "ModbusDataConv.h"
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace ChangeDetect {
+//---------------------------------------------------------------------------
+
+/** @brief Kind of data block scanned by a ChangeDetector. */
+enum class BlockType {
+    Registers,  ///< 16-bit registers in host order (FC03/FC04/FC23).
+    Bits,       ///< Packed coils or discrete inputs (FC01/FC02).
+};
+
+/** @brief Value type of a tag. Bit is the only type allowed in a BlockType::Bits block. */
+enum class TagType { UInt16, Int16, UInt32, Int32, Float32, Float64, Bit };
+
+/** @brief How a tag decides that its value has changed. */
+enum class DeadbandType {
+    None,       ///< Any change of value is reported.
+    Absolute,   ///< |New - Reported| > Deadband.
+    Percent,    ///< |New - Reported| > |Reported| * Deadband / 100.
+};
+
+/** @brief Describes one value inside a scanned block. */
+struct Tag {
+    size_t                Offset {};   ///< Register offset (Registers) or bit offset (Bits) in the block.
+    TagType               Type { TagType::UInt16 };
+    DataConv::WordOrder   Order { DataConv::WordOrder::ABCD };  ///< For 32/64-bit types.
+    DeadbandType          Deadband { DeadbandType::None };
+    double                DeadbandValue {};
+};
+
+/** @brief One entry of the delta stream. */
+struct Change {
+    size_t TagIndex;    ///< Index of the tag in the detector's tag list.
+    double Value;       ///< New value (0 or 1 for TagType::Bit).
+};
+
+/**
+ * @brief Change detection stage for one scanned block.
+ * @details Not thread-safe: call Update() from the thread that scans the block.
+ */
+class ChangeDetector {
+public:
+    /**
+     * @brief Signature of a delta stream subscriber.
+     * @details Called at the end of each Update() that produced at least one change.
+     *  @p Changes is only valid for the duration of the call.
+     */
+    using TChangeEvent =
+       void __fastcall ( __closure * )(
+           ChangeDetector& Sender, Change const * Changes, size_t Count
+       );
+
+    /**
+     * @brief Constructs the detector.
+     * @param Type       Kind of block passed to Update().
+     * @param PointCount Number of registers or bits in the block.
+     * @param Tags       Tags to watch; each must lie entirely inside the block.
+     * @throws EBaseException if a tag does not fit the block or its type does not
+     *         match @p Type.
+     */
+    ChangeDetector( BlockType Type, size_t PointCount, std::vector<Tag> Tags );
+
+    /**
+     * @brief Feeds a register block and reports the tags that changed.
+     * @return Number of changes delivered to the subscribers.
+     * @throws EBaseException if the detector was built for BlockType::Bits.
+     */
+    size_t Update( RegDataType const * Regs );
+
+    /**
+     * @brief Feeds a packed bit block and reports the tags that changed.
+     * @return Number of changes delivered to the subscribers.
+     * @throws EBaseException if the detector was built for BlockType::Registers.
+     */
+    size_t Update( CoilDataType const * Bits );
+
+    /** @brief Forgets the previous image: the next Update() reports every tag. */
+    void Reset() noexcept { primed_ = false; }
+
+    void Subscribe( TChangeEvent EventHandler );
+    void Unsubscribe( TChangeEvent EventHandler );
+
+    [[ nodiscard ]] BlockType GetBlockType() const noexcept { return type_; }
+    [[ nodiscard ]] size_t GetPointCount() const noexcept { return pointCount_; }
+    [[ nodiscard ]] size_t GetTagCount() const noexcept { return tags_.size(); }
+    [[ nodiscard ]] Tag const & GetTag( size_t Idx ) const { return tags_.at( Idx ); }
+
+    /** @brief Returns the last value reported for tag @p Idx. */
+    [[ nodiscard ]] double GetReportedValue( size_t Idx ) const { return reported_.at( Idx ); }
+private:
+    BlockType type_;
+    size_t pointCount_;
+    std::vector<Tag> tags_;
+    std::vector<uint8_t> image_;
+    std::vector<uint64_t> changedMask_;
+    std::vector<double> reported_;
+    std::vector<Change> changes_;
+    std::vector<TChangeEvent> subscribers_;
+    bool primed_ {};
+
+    [[ nodiscard ]] static size_t GetTagSize( TagType Type ) noexcept;
+    [[ nodiscard ]] bool IsTagChanged( Tag const & Item ) const noexcept;
+    [[ nodiscard ]] double GetTagValue( Tag const & Item ) const;
+    [[ nodiscard ]] static bool IsBeyondDeadband( Tag const & Item, double Reported,
+                                                  double Value ) noexcept;
+    size_t Scan( void const * Data );
+};
+
+//---------------------------------------------------------------------------
+}; // End of namespace ChangeDetect
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
+#endif
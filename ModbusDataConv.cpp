@@ -0,0 +1,435 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstring>
+
+#include "ModbusDataConv.h"
+
+//---------------------------------------------------------------------------
+
+#if !defined( MODBUS_DATACONV_NO_SIMD )
+  #if defined( __x86_64__ ) || defined( _M_X64 ) || defined( __i386__ ) || defined( _M_IX86 )
+    #if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+      // The AVX2 kernels are built with the SSE2 ones and enabled by CPUID at run time
+      #define MODBUS_DATACONV_SSE2
+    #endif
+  #elif defined( __aarch64__ ) || defined( _M_ARM64 )
+    #define MODBUS_DATACONV_NEON
+  #endif
+#endif
+
+#if defined( MODBUS_DATACONV_SSE2 )
+  #include <immintrin.h>
+  #if defined( _MSC_VER ) && !defined( __clang__ )
+    #include <intrin.h>
+    #define MODBUS_DATACONV_TARGET_AVX2
+  #else
+    #include <cpuid.h>
+    #define MODBUS_DATACONV_TARGET_AVX2  __attribute__(( target( "avx2" ) ))
+  #endif
+#endif
+
+#if defined( MODBUS_DATACONV_NEON )
+  #include <arm_neon.h>
+#endif
+
+static_assert( std::endian::native == std::endian::little,
+               "Modbus::DataConv assumes a little-endian host" );
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace DataConv {
+//---------------------------------------------------------------------------
+
+namespace {
+
+void PermuteScalar( uint8_t const * Src, uint8_t* Dst, size_t Count, size_t ValueSize,
+                    bool SwapBytes, bool ReverseWords )
+{
+    size_t const WordCount = ValueSize / 2;
+    uint16_t Words[4];
+    for ( ; Count-- ; Src += ValueSize, Dst += ValueSize ) {
+        std::memcpy( Words, Src, ValueSize );
+        for ( size_t Idx = 0 ; Idx < WordCount ; ++Idx ) {
+            uint16_t Word = Words[ReverseWords ? WordCount - 1 - Idx : Idx];
+            if ( SwapBytes ) {
+                Word = static_cast<uint16_t>( ( Word << 8 ) | ( Word >> 8 ) );
+            }
+            std::memcpy( Dst + Idx * 2, &Word, 2 );
+        }
+    }
+}
+//---------------------------------------------------------------------------
+
+bool UpdateImageScalar( uint8_t const * Src, uint8_t* Image, size_t Size, uint64_t* Mask )
+{
+    uint64_t Any {};
+    for ( size_t Idx = 0 ; Idx < Size ; Idx += 64 ) {
+        uint64_t Bits {};
+        size_t const ChunkSize = std::min<size_t>( Size - Idx, 64 );
+        for ( size_t Bit = 0 ; Bit < ChunkSize ; ++Bit ) {
+            if ( Src[Idx + Bit] != Image[Idx + Bit] ) {
+                Bits |= uint64_t( 1 ) << Bit;
+            }
+        }
+        std::memcpy( Image + Idx, Src + Idx, ChunkSize );
+        Mask[Idx / 64] = Bits;
+        Any |= Bits;
+    }
+    return Any != 0;
+}
+//---------------------------------------------------------------------------
+
+// The vector kernels process whole 16/32-byte blocks (always a whole number
+// of values, or whole 64-byte mask words for the image compare) and return
+// the amount of data processed; the caller finishes the tail with the scalar
+// kernel.
+
+#if defined( MODBUS_DATACONV_SSE2 )
+
+size_t PermuteSSE2( uint8_t const * Src, uint8_t* Dst, size_t Count, size_t ValueSize,
+                    bool SwapBytes, bool ReverseWords )
+{
+    size_t const BlockCount = Count * ValueSize / 16;
+    for ( size_t Idx = 0 ; Idx < BlockCount ; ++Idx, Src += 16, Dst += 16 ) {
+        __m128i X = _mm_loadu_si128( reinterpret_cast<__m128i const *>( Src ) );
+        if ( SwapBytes ) {
+            X = _mm_or_si128( _mm_slli_epi16( X, 8 ), _mm_srli_epi16( X, 8 ) );
+        }
+        if ( ReverseWords ) {
+            if ( ValueSize == 4 ) {
+                X = _mm_shufflelo_epi16( X, _MM_SHUFFLE( 2, 3, 0, 1 ) );
+                X = _mm_shufflehi_epi16( X, _MM_SHUFFLE( 2, 3, 0, 1 ) );
+            }
+            else {
+                X = _mm_shufflelo_epi16( X, _MM_SHUFFLE( 0, 1, 2, 3 ) );
+                X = _mm_shufflehi_epi16( X, _MM_SHUFFLE( 0, 1, 2, 3 ) );
+            }
+        }
+        _mm_storeu_si128( reinterpret_cast<__m128i*>( Dst ), X );
+    }
+    return BlockCount * 16 / ValueSize;
+}
+//---------------------------------------------------------------------------
+
+size_t UpdateImageSSE2( uint8_t const * Src, uint8_t* Image, size_t Size,
+                        uint64_t* Mask, uint64_t& Any )
+{
+    size_t const ChunkCount = Size / 64;
+    for ( size_t Idx = 0 ; Idx < ChunkCount ; ++Idx, Src += 64, Image += 64 ) {
+        uint64_t Bits {};
+        for ( int Part = 0 ; Part < 4 ; ++Part ) {
+            __m128i const New = _mm_loadu_si128( reinterpret_cast<__m128i const *>( Src + Part * 16 ) );
+            __m128i const Old = _mm_loadu_si128( reinterpret_cast<__m128i const *>( Image + Part * 16 ) );
+            uint64_t const Eq = static_cast<uint16_t>( _mm_movemask_epi8( _mm_cmpeq_epi8( New, Old ) ) );
+            Bits |= ( ~Eq & 0xFFFF ) << ( Part * 16 );
+            _mm_storeu_si128( reinterpret_cast<__m128i*>( Image + Part * 16 ), New );
+        }
+        Mask[Idx] = Bits;
+        Any |= Bits;
+    }
+    return ChunkCount * 64;
+}
+//---------------------------------------------------------------------------
+
+MODBUS_DATACONV_TARGET_AVX2
+size_t PermuteAVX2( uint8_t const * Src, uint8_t* Dst, size_t Count, size_t ValueSize,
+                    bool SwapBytes, bool ReverseWords )
+{
+    // The whole permutation is a single in-lane byte shuffle
+    size_t const WordCount = ValueSize / 2;
+    alignas( 32 ) uint8_t Mask[32];
+    for ( size_t Idx = 0 ; Idx < 16 ; ++Idx ) {
+        size_t const Word = Idx / 2;
+        size_t const First = Word - Word % WordCount;
+        size_t const SrcWord =
+            ReverseWords ? First + WordCount - 1 - Word % WordCount : Word;
+        size_t const SrcByte = SwapBytes ? 1 - Idx % 2 : Idx % 2;
+        Mask[Idx] = Mask[Idx + 16] = static_cast<uint8_t>( SrcWord * 2 + SrcByte );
+    }
+    __m256i const Shuffle = _mm256_load_si256( reinterpret_cast<__m256i const *>( Mask ) );
+
+    size_t const BlockCount = Count * ValueSize / 32;
+    for ( size_t Idx = 0 ; Idx < BlockCount ; ++Idx, Src += 32, Dst += 32 ) {
+        __m256i const X = _mm256_loadu_si256( reinterpret_cast<__m256i const *>( Src ) );
+        _mm256_storeu_si256(
+            reinterpret_cast<__m256i*>( Dst ), _mm256_shuffle_epi8( X, Shuffle )
+        );
+    }
+    return BlockCount * 32 / ValueSize;
+}
+//---------------------------------------------------------------------------
+
+MODBUS_DATACONV_TARGET_AVX2
+size_t UpdateImageAVX2( uint8_t const * Src, uint8_t* Image, size_t Size,
+                        uint64_t* Mask, uint64_t& Any )
+{
+    size_t const ChunkCount = Size / 64;
+    for ( size_t Idx = 0 ; Idx < ChunkCount ; ++Idx, Src += 64, Image += 64 ) {
+        uint64_t Bits {};
+        for ( int Part = 0 ; Part < 2 ; ++Part ) {
+            __m256i const New = _mm256_loadu_si256( reinterpret_cast<__m256i const *>( Src + Part * 32 ) );
+            __m256i const Old = _mm256_loadu_si256( reinterpret_cast<__m256i const *>( Image + Part * 32 ) );
+            uint64_t const Eq = static_cast<uint32_t>( _mm256_movemask_epi8( _mm256_cmpeq_epi8( New, Old ) ) );
+            Bits |= ( ~Eq & 0xFFFFFFFF ) << ( Part * 32 );
+            _mm256_storeu_si256( reinterpret_cast<__m256i*>( Image + Part * 32 ), New );
+        }
+        Mask[Idx] = Bits;
+        Any |= Bits;
+    }
+    return ChunkCount * 64;
+}
+//---------------------------------------------------------------------------
+
+bool IsAVX2Supported() noexcept
+{
+    // AVX2 needs both the CPU feature and the OS saving the YMM state
+#if defined( _MSC_VER ) && !defined( __clang__ )
+    int Regs[4];
+    __cpuid( Regs, 0 );
+    if ( Regs[0] < 7 ) {
+        return false;
+    }
+    __cpuid( Regs, 1 );
+    if ( ( Regs[2] & ( 1 << 27 ) ) == 0 || ( Regs[2] & ( 1 << 28 ) ) == 0 ) {
+        return false;
+    }
+    if ( ( _xgetbv( 0 ) & 0x06 ) != 0x06 ) {
+        return false;
+    }
+    __cpuidex( Regs, 7, 0 );
+    return ( Regs[1] & ( 1 << 5 ) ) != 0;
+#else
+    unsigned int Eax, Ebx, Ecx, Edx;
+    if ( __get_cpuid_max( 0, nullptr ) < 7 ) {
+        return false;
+    }
+    __cpuid( 1, Eax, Ebx, Ecx, Edx );
+    if ( ( Ecx & ( 1u << 27 ) ) == 0 || ( Ecx & ( 1u << 28 ) ) == 0 ) {
+        return false;
+    }
+    unsigned int XcrLo, XcrHi;
+    __asm__ volatile ( "xgetbv" : "=a"( XcrLo ), "=d"( XcrHi ) : "c"( 0 ) );
+    if ( ( XcrLo & 0x06 ) != 0x06 ) {
+        return false;
+    }
+    __cpuid_count( 7, 0, Eax, Ebx, Ecx, Edx );
+    return ( Ebx & ( 1u << 5 ) ) != 0;
+#endif
+}
+
+#endif
+//---------------------------------------------------------------------------
+
+#if defined( MODBUS_DATACONV_NEON )
+
+size_t PermuteNEON( uint8_t const * Src, uint8_t* Dst, size_t Count, size_t ValueSize,
+                    bool SwapBytes, bool ReverseWords )
+{
+    size_t const BlockCount = Count * ValueSize / 16;
+    for ( size_t Idx = 0 ; Idx < BlockCount ; ++Idx, Src += 16, Dst += 16 ) {
+        uint8x16_t X = vld1q_u8( Src );
+        if ( SwapBytes ) {
+            X = vrev16q_u8( X );
+        }
+        if ( ReverseWords ) {
+            uint16x8_t const W = vreinterpretq_u16_u8( X );
+            X = vreinterpretq_u8_u16( ValueSize == 4 ? vrev32q_u16( W ) : vrev64q_u16( W ) );
+        }
+        vst1q_u8( Dst, X );
+    }
+    return BlockCount * 16 / ValueSize;
+}
+//---------------------------------------------------------------------------
+
+size_t UpdateImageNEON( uint8_t const * Src, uint8_t* Image, size_t Size,
+                        uint64_t* Mask, uint64_t& Any )
+{
+    // No movemask on NEON: weight each differing byte by its bit and add up
+    static uint8_t const Weights[16] = {
+        1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128
+    };
+    uint8x16_t const W = vld1q_u8( Weights );
+    size_t const ChunkCount = Size / 64;
+    for ( size_t Idx = 0 ; Idx < ChunkCount ; ++Idx, Src += 64, Image += 64 ) {
+        uint64_t Bits {};
+        for ( int Part = 0 ; Part < 4 ; ++Part ) {
+            uint8x16_t const New = vld1q_u8( Src + Part * 16 );
+            uint8x16_t const Ne =
+                vandq_u8( vmvnq_u8( vceqq_u8( New, vld1q_u8( Image + Part * 16 ) ) ), W );
+            uint64_t const Lo = vaddv_u8( vget_low_u8( Ne ) );
+            uint64_t const Hi = vaddv_u8( vget_high_u8( Ne ) );
+            Bits |= ( Lo | ( Hi << 8 ) ) << ( Part * 16 );
+            vst1q_u8( Image + Part * 16, New );
+        }
+        Mask[Idx] = Bits;
+        Any |= Bits;
+    }
+    return ChunkCount * 64;
+}
+
+#endif
+//---------------------------------------------------------------------------
+
+SimdLevel DetectSimdLevel() noexcept
+{
+    for ( auto Level : { SimdLevel::AVX2, SimdLevel::SSE2, SimdLevel::NEON } ) {
+        if ( IsSimdLevelSupported( Level ) ) {
+            return Level;
+        }
+    }
+    return SimdLevel::Scalar;
+}
+//---------------------------------------------------------------------------
+
+std::atomic<SimdLevel> simdLevel_ { DetectSimdLevel() };
+
+} // End of anonymous namespace
+//---------------------------------------------------------------------------
+
+bool IsSimdLevelSupported( SimdLevel Level ) noexcept
+{
+    switch ( Level ) {
+        case SimdLevel::Scalar:
+            return true;
+#if defined( MODBUS_DATACONV_SSE2 )
+        case SimdLevel::SSE2:
+            return true;
+        case SimdLevel::AVX2: {
+                static bool const Supported = IsAVX2Supported();
+                return Supported;
+            }
+#endif
+#if defined( MODBUS_DATACONV_NEON )
+        case SimdLevel::NEON:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+//---------------------------------------------------------------------------
+
+SimdLevel GetSimdLevel() noexcept
+{
+    return simdLevel_.load( std::memory_order_relaxed );
+}
+//---------------------------------------------------------------------------
+
+void SetSimdLevel( SimdLevel Level )
+{
+    if ( !IsSimdLevelSupported( Level ) ) {
+        throw EBaseException(
+            Format(
+                _D( "Instruction set %s is not supported" )
+              , ARRAYOFCONST( ( SimdLevelToStr( Level ) ) )
+            )
+        );
+    }
+    simdLevel_.store( Level, std::memory_order_relaxed );
+}
+//---------------------------------------------------------------------------
+
+String SimdLevelToStr( SimdLevel Level )
+{
+    switch ( Level ) {
+        case SimdLevel::Scalar: return _D( "Scalar" );
+        case SimdLevel::SSE2:   return _D( "SSE2" );
+        case SimdLevel::AVX2:   return _D( "AVX2" );
+        case SimdLevel::NEON:   return _D( "NEON" );
+        default:                return _D( "Unknown" );
+    }
+}
+//---------------------------------------------------------------------------
+
+void Permute( void const * Src, void* Dst, size_t Count, size_t ValueSize,
+              bool SwapBytes, bool ReverseWords )
+{
+    if ( ValueSize != 2 && ValueSize != 4 && ValueSize != 8 ) {
+        throw EBaseException(
+            Format(
+                _D( "Invalid value size (%d)" )
+              , ARRAYOFCONST( ( static_cast<int>( ValueSize ) ) )
+            )
+        );
+    }
+
+    auto In = static_cast<uint8_t const *>( Src );
+    auto Out = static_cast<uint8_t*>( Dst );
+
+    if ( ValueSize == 2 ) {
+        ReverseWords = false;
+    }
+    if ( !SwapBytes && !ReverseWords ) {
+        if ( In != Out ) {
+            std::memmove( Out, In, Count * ValueSize );
+        }
+        return;
+    }
+
+    size_t Done {};
+    switch ( GetSimdLevel() ) {
+#if defined( MODBUS_DATACONV_SSE2 )
+        case SimdLevel::SSE2:
+            Done = PermuteSSE2( In, Out, Count, ValueSize, SwapBytes, ReverseWords );
+            break;
+        case SimdLevel::AVX2:
+            Done = PermuteAVX2( In, Out, Count, ValueSize, SwapBytes, ReverseWords );
+            break;
+#endif
+#if defined( MODBUS_DATACONV_NEON )
+        case SimdLevel::NEON:
+            Done = PermuteNEON( In, Out, Count, ValueSize, SwapBytes, ReverseWords );
+            break;
+#endif
+        default:
+            break;
+    }
+    PermuteScalar(
+        In + Done * ValueSize, Out + Done * ValueSize, Count - Done, ValueSize,
+        SwapBytes, ReverseWords
+    );
+}
+//---------------------------------------------------------------------------
+
+bool UpdateImage( void const * Src, void* Image, size_t Size, uint64_t* Mask )
+{
+    auto In = static_cast<uint8_t const *>( Src );
+    auto Out = static_cast<uint8_t*>( Image );
+
+    uint64_t Any {};
+    size_t Done {};
+    switch ( GetSimdLevel() ) {
+#if defined( MODBUS_DATACONV_SSE2 )
+        case SimdLevel::SSE2:
+            Done = UpdateImageSSE2( In, Out, Size, Mask, Any );
+            break;
+        case SimdLevel::AVX2:
+            Done = UpdateImageAVX2( In, Out, Size, Mask, Any );
+            break;
+#endif
+#if defined( MODBUS_DATACONV_NEON )
+        case SimdLevel::NEON:
+            Done = UpdateImageNEON( In, Out, Size, Mask, Any );
+            break;
+#endif
+        default:
+            break;
+    }
+    bool const TailChanged =
+        UpdateImageScalar( In + Done, Out + Done, Size - Done, Mask + Done / 64 );
+    return Any != 0 || TailChanged;
+}
+
+//---------------------------------------------------------------------------
+}; // End of namespace DataConv
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
+
+#pragma package(smart_init)
@@ -0,0 +1,149 @@
+/**
+ * @file ModbusDataConv.h
+ * @brief Modbus::DataConv — register block to host type conversion kernels.
+ *
+ * @details Converts blocks of Modbus registers (big-endian on the wire) into host
+ *  16/32/64-bit values and back, in a single pass.  Multi-register values are laid out
+ *  according to a WordOrder, named after the position of the value bytes A (most
+ *  significant) ... D (least significant) as they appear on the wire:
+ *  - ABCD: big-endian registers, most significant register first (Modbus default).
+ *  - CDAB: big-endian registers, least significant register first ("word swap").
+ *  - BADC: byte-swapped registers, most significant register first ("byte swap").
+ *  - DCBA: byte-swapped registers, least significant register first (little-endian).
+ *
+ *  For 64-bit values the same rules apply to the four registers (CDAB reverses the
+ *  whole register sequence).
+ *
+ *  The conversion is a fixed byte permutation per value, so a single set of kernels
+ *  serves every type.  Kernels are provided for SSE2, AVX2 and NEON and the best one
+ *  supported by the running CPU is selected at start-up; define
+ *  MODBUS_DATACONV_NO_SIMD to build the scalar kernel only.  Source and destination
+ *  may be the same buffer; partially overlapping buffers are not supported.
+ *  A little-endian host is assumed.
+ *
+ *  The same dispatch serves UpdateImage(), the block compare kernel of the change
+ *  detection stage.
+ */
+
+//---------------------------------------------------------------------------
+
+#ifndef ModbusDataConvH
+#define ModbusDataConvH
+
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+
+#include "Modbus.h"
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace DataConv {
+//---------------------------------------------------------------------------
+
+/** @brief Layout of a multi-register value on the wire (see file description). */
+enum class WordOrder { ABCD, CDAB, BADC, DCBA };
+
+/** @brief Instruction set used by the conversion kernels. */
+enum class SimdLevel { Scalar, SSE2, AVX2, NEON };
+
+/** @brief Returns true if the running CPU (and the build) supports @p Level. */
+[[ nodiscard ]] bool IsSimdLevelSupported( SimdLevel Level ) noexcept;
+
+/** @brief Returns the instruction set currently used by the kernels. */
+[[ nodiscard ]] SimdLevel GetSimdLevel() noexcept;
+
+/**
+ * @brief Forces the instruction set used by the kernels (mainly for testing).
+ * @throws EBaseException if @p Level is not supported.
+ */
+void SetSimdLevel( SimdLevel Level );
+
+/** @brief Returns the name of @p Level ("Scalar", "SSE2", ...). */
+[[ nodiscard ]] String SimdLevelToStr( SimdLevel Level );
+
+/**
+ * @brief Low-level kernel: copies @p Count values of @p ValueSize bytes (2, 4 or 8),
+ *        optionally swapping the bytes of every 16-bit word and/or reversing the
+ *        order of the 16-bit words inside each value.
+ */
+void Permute( void const * Src, void* Dst, size_t Count, size_t ValueSize,
+              bool SwapBytes, bool ReverseWords );
+
+/**
+ * @brief Compares a new data block with its previous image and refreshes the image.
+ * @details Bit i of @p Mask is set when byte i of @p Src differs from byte i of
+ *  @p Image; @p Image then holds a copy of @p Src.  Used by the change detection
+ *  stage (see ModbusChangeDetect.h) and dispatched like the conversion kernels.
+ * @param Mask ( Size + 63 ) / 64 words, overwritten.
+ * @return true if at least one byte differs.
+ */
+bool UpdateImage( void const * Src, void* Image, size_t Size, uint64_t* Mask );
+
+//---------------------------------------------------------------------------
+
+template<typename T>
+inline constexpr bool IsConvertible =
+    std::is_arithmetic_v<T> &&
+    ( sizeof( T ) == 2 || sizeof( T ) == 4 || sizeof( T ) == 8 );
+
+[[ nodiscard ]] constexpr bool HasByteSwap( WordOrder Order ) noexcept {
+    return Order == WordOrder::BADC || Order == WordOrder::DCBA;
+}
+
+[[ nodiscard ]] constexpr bool HasWordSwap( WordOrder Order ) noexcept {
+    return Order == WordOrder::CDAB || Order == WordOrder::DCBA;
+}
+
+/**
+ * @brief Converts a register block as received on the wire into host values.
+ * @param Src   Register bytes, sizeof( T ) per value.
+ * @param Count Number of values (not registers) to convert.
+ * @param Dst   Destination buffer of @p Count values.
+ * @param Order Word order of the values on the wire.
+ */
+template<typename T>
+void FromWire( uint8_t const * Src, size_t Count, T* Dst,
+               WordOrder Order = WordOrder::ABCD )
+{
+    static_assert( IsConvertible<T>, "Unsupported value type" );
+    Permute( Src, Dst, Count, sizeof( T ), !HasByteSwap( Order ), !HasWordSwap( Order ) );
+}
+
+/** @brief Converts host values into a register block in wire byte order (inverse of FromWire). */
+template<typename T>
+void ToWire( T const * Src, size_t Count, uint8_t* Dst,
+             WordOrder Order = WordOrder::ABCD )
+{
+    static_assert( IsConvertible<T>, "Unsupported value type" );
+    Permute( Src, Dst, Count, sizeof( T ), !HasByteSwap( Order ), !HasWordSwap( Order ) );
+}
+
+/**
+ * @brief Converts registers already in host order (as returned by
+ *        Protocol::ReadHoldingRegisters() and friends) into host values.
+ */
+template<typename T>
+void FromRegisters( RegDataType const * Src, size_t Count, T* Dst,
+                    WordOrder Order = WordOrder::ABCD )
+{
+    static_assert( IsConvertible<T>, "Unsupported value type" );
+    Permute( Src, Dst, Count, sizeof( T ), HasByteSwap( Order ), !HasWordSwap( Order ) );
+}
+
+/** @brief Converts host values into registers in host order (inverse of FromRegisters). */
+template<typename T>
+void ToRegisters( T const * Src, size_t Count, RegDataType* Dst,
+                  WordOrder Order = WordOrder::ABCD )
+{
+    static_assert( IsConvertible<T>, "Unsupported value type" );
+    Permute( Src, Dst, Count, sizeof( T ), HasByteSwap( Order ), !HasWordSwap( Order ) );
+}
+
+//---------------------------------------------------------------------------
+}; // End of namespace DataConv
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
+#endif
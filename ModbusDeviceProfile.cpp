@@ -0,0 +1,344 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+
+#include "ModbusDeviceProfile.h"
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace Master {
+//---------------------------------------------------------------------------
+
+namespace {
+
+char const * const SectionName = "[Device]";
+
+char const * const WordOrderNames[] = { "ABCD", "CDAB", "BADC", "DCBA" };
+
+std::string Escape( std::string const & Val )
+{
+    std::string Result;
+    Result.reserve( Val.size() );
+    for ( char Ch : Val ) {
+        switch ( Ch ) {
+            case '\\': Result += "\\\\"; break;
+            case '\n': Result += "\\n";  break;
+            case '\r': Result += "\\r";  break;
+            default:   Result += Ch;     break;
+        }
+    }
+    return Result;
+}
+//---------------------------------------------------------------------------
+
+std::string Unescape( std::string const & Val )
+{
+    std::string Result;
+    Result.reserve( Val.size() );
+    for ( size_t Idx = 0 ; Idx < Val.size() ; ++Idx ) {
+        if ( Val[Idx] == '\\' && Idx + 1 < Val.size() ) {
+            switch ( Val[++Idx] ) {
+                case 'n': Result += '\n'; break;
+                case 'r': Result += '\r'; break;
+                default:  Result += Val[Idx]; break;
+            }
+        }
+        else {
+            Result += Val[Idx];
+        }
+    }
+    return Result;
+}
+//---------------------------------------------------------------------------
+
+[[ noreturn ]] void RaiseInvalidLineException( size_t LineNo )
+{
+    throw EBaseException(
+        Format(
+            _D( "Invalid device profile file, line %u" ),
+            ARRAYOFCONST( ( static_cast<unsigned>( LineNo ) ) )
+        )
+    );
+}
+//---------------------------------------------------------------------------
+
+unsigned long ParseNumber( std::string const & Val, size_t LineNo )
+{
+    char* End {};
+    unsigned long const Result = std::strtoul( Val.c_str(), &End, 10 );
+    if ( Val.empty() || *End ) {
+        RaiseInvalidLineException( LineNo );
+    }
+    return Result;
+}
+//---------------------------------------------------------------------------
+
+void ParseValue( DeviceProfile& Profile, std::string const & Key, std::string const & Val,
+                 size_t LineNo )
+{
+    if ( Key == "Endpoint" ) {
+        Profile.Endpoint = Unescape( Val );
+    }
+    else if ( Key == "Unit" ) {
+        unsigned long const SlaveAddr = ParseNumber( Val, LineNo );
+        if ( SlaveAddr > 0xFF ) {
+            RaiseInvalidLineException( LineNo );
+        }
+        Profile.SlaveAddr = static_cast<Context::SlaveAddrType>( SlaveAddr );
+    }
+    else if ( Key == "VendorName" ) {
+        Profile.VendorName = Unescape( Val );
+    }
+    else if ( Key == "ProductCode" ) {
+        Profile.ProductCode = Unescape( Val );
+    }
+    else if ( Key == "Revision" ) {
+        Profile.Revision = Unescape( Val );
+    }
+    else if ( Key == "MaxRegisterCount" ) {
+        Profile.MaxRegisterCount = ParseNumber( Val, LineNo );
+    }
+    else if ( Key == "MaxCoilCount" ) {
+        Profile.MaxCoilCount = ParseNumber( Val, LineNo );
+    }
+    else if ( Key == "FunctionCodes" ) {
+        size_t Begin = 0;
+        while ( Begin < Val.size() ) {
+            size_t End = Val.find( ',', Begin );
+            if ( End == std::string::npos ) {
+                End = Val.size();
+            }
+            Profile.FunctionCodes.insert(
+                static_cast<FunctionCode>(
+                    ParseNumber( Val.substr( Begin, End - Begin ), LineNo )
+                )
+            );
+            Begin = End + 1;
+        }
+    }
+    else if ( Key == "WordOrder" ) {
+        auto const It =
+            std::find( std::begin( WordOrderNames ), std::end( WordOrderNames ), Val );
+        if ( It == std::end( WordOrderNames ) ) {
+            RaiseInvalidLineException( LineNo );
+        }
+        Profile.WordOrder =
+            static_cast<DataConv::WordOrder>( It - std::begin( WordOrderNames ) );
+    }
+    else if ( Key == "ResponseTime" ) {
+        Profile.ResponseTime = std::chrono::microseconds( ParseNumber( Val, LineNo ) );
+    }
+}
+
+} // End of anonymous namespace
+
+//---------------------------------------------------------------------------
+
+bool DeviceProfile::Supports( FunctionCode FnCode ) const
+{
+    return FunctionCodes.empty() || FunctionCodes.count( FnCode );
+}
+//---------------------------------------------------------------------------
+
+TransactionPolicy DeviceProfile::GetPolicy() const
+{
+    TransactionPolicy Policy;
+    Policy.MaxRegisterCount = MaxRegisterCount;
+    Policy.MaxCoilCount = MaxCoilCount;
+    return Policy;
+}
+//---------------------------------------------------------------------------
+
+DeviceProfile IdentifyDevice( Protocol& Proto, Context::SlaveAddrType SlaveAddr )
+{
+    auto const Start = std::chrono::steady_clock::now();
+    DeviceIdentification const Id =
+        Proto.ReadDeviceIdentification( Context( SlaveAddr ), ReadDeviceIdCode::Basic );
+    auto const Elapsed = std::chrono::steady_clock::now() - Start;
+
+    auto const GetObject = [&Id]( DeviceObjectId ObjectId ) {
+        auto const It = Id.Objects.find( static_cast<DeviceObjectIdType>( ObjectId ) );
+        return It == Id.Objects.end() ? std::string() : It->second;
+    };
+
+    DeviceProfile Profile;
+    Profile.Endpoint = UTF8String( Proto.GetProtocolParamsStr() ).c_str();
+    Profile.SlaveAddr = SlaveAddr;
+    Profile.VendorName = GetObject( DeviceObjectId::VendorName );
+    Profile.ProductCode = GetObject( DeviceObjectId::ProductCode );
+    Profile.Revision = GetObject( DeviceObjectId::MajorMinorRevision );
+    Profile.FunctionCodes.insert( FunctionCode::EncapsulatedInterfaceTransport );
+    Profile.ResponseTime =
+        std::chrono::duration_cast<std::chrono::microseconds>( Elapsed );
+    return Profile;
+}
+//---------------------------------------------------------------------------
+
+DeviceProfile const * DeviceProfileCache::Find( std::string const & Endpoint,
+                                                Context::SlaveAddrType SlaveAddr ) const
+{
+    auto const It = profiles_.find( KeyType( Endpoint, SlaveAddr ) );
+    return It == profiles_.end() ? nullptr : &It->second;
+}
+//---------------------------------------------------------------------------
+
+DeviceProfile const * DeviceProfileCache::Find( Protocol const & Proto,
+                                                Context::SlaveAddrType SlaveAddr ) const
+{
+    return Find( UTF8String( Proto.GetProtocolParamsStr() ).c_str(), SlaveAddr );
+}
+//---------------------------------------------------------------------------
+
+void DeviceProfileCache::Store( DeviceProfile const & Profile )
+{
+    profiles_[KeyType( Profile.Endpoint, Profile.SlaveAddr )] = Profile;
+}
+//---------------------------------------------------------------------------
+
+bool DeviceProfileCache::Erase( std::string const & Endpoint,
+                                Context::SlaveAddrType SlaveAddr )
+{
+    return profiles_.erase( KeyType( Endpoint, SlaveAddr ) ) != 0;
+}
+//---------------------------------------------------------------------------
+
+bool DeviceProfileCache::Load( String const & FileName )
+{
+    profiles_.clear();
+
+    std::filesystem::path const Path( FileName.c_str() );
+    std::error_code Error;
+    if ( !std::filesystem::exists( Path, Error ) ) {
+        return false;
+    }
+
+    std::ifstream In( Path, std::ios::binary );
+    if ( !In ) {
+        throw EBaseException(
+            Format( _D( "Unable to open \"%s\"" ), ARRAYOFCONST( ( FileName ) ) )
+        );
+    }
+
+    std::optional<DeviceProfile> Profile;
+    std::string Line;
+    for ( size_t LineNo = 1 ; std::getline( In, Line ) ; ++LineNo ) {
+        if ( !Line.empty() && Line.back() == '\r' ) {
+            Line.pop_back();
+        }
+        if ( Line.empty() || Line[0] == '#' ) {
+            continue;
+        }
+        if ( Line == SectionName ) {
+            if ( Profile ) {
+                Store( *Profile );
+            }
+            Profile.emplace();
+            continue;
+        }
+        size_t const Sep = Line.find( '=' );
+        if ( !Profile || Sep == std::string::npos ) {
+            profiles_.clear();
+            RaiseInvalidLineException( LineNo );
+        }
+        try {
+            ParseValue( *Profile, Line.substr( 0, Sep ), Line.substr( Sep + 1 ), LineNo );
+        }
+        catch ( ... ) {
+            profiles_.clear();
+            throw;
+        }
+    }
+    if ( Profile ) {
+        Store( *Profile );
+    }
+    return true;
+}
+//---------------------------------------------------------------------------
+
+void DeviceProfileCache::Save( String const & FileName ) const
+{
+    std::filesystem::path const Path( FileName.c_str() );
+    std::filesystem::path TempPath( Path );
+    TempPath += ".tmp";
+
+    {
+        std::ofstream Out( TempPath, std::ios::binary | std::ios::trunc );
+        Out << "# Modbus device profiles\n";
+        for ( auto const & Item : profiles_ ) {
+            DeviceProfile const & Profile = Item.second;
+            Out << '\n' << SectionName << '\n'
+                << "Endpoint=" << Escape( Profile.Endpoint ) << '\n'
+                << "Unit=" << static_cast<unsigned>( Profile.SlaveAddr ) << '\n'
+                << "VendorName=" << Escape( Profile.VendorName ) << '\n'
+                << "ProductCode=" << Escape( Profile.ProductCode ) << '\n'
+                << "Revision=" << Escape( Profile.Revision ) << '\n';
+            if ( Profile.MaxRegisterCount ) {
+                Out << "MaxRegisterCount=" << *Profile.MaxRegisterCount << '\n';
+            }
+            if ( Profile.MaxCoilCount ) {
+                Out << "MaxCoilCount=" << *Profile.MaxCoilCount << '\n';
+            }
+            if ( !Profile.FunctionCodes.empty() ) {
+                Out << "FunctionCodes=";
+                char const * Sep = "";
+                for ( FunctionCode FnCode : Profile.FunctionCodes ) {
+                    Out << Sep << static_cast<unsigned>( FnCode );
+                    Sep = ",";
+                }
+                Out << '\n';
+            }
+            Out << "WordOrder="
+                << WordOrderNames[static_cast<size_t>( Profile.WordOrder )] << '\n'
+                << "ResponseTime=" << Profile.ResponseTime.count() << '\n';
+        }
+        Out.close();
+        if ( !Out ) {
+            std::error_code Error;
+            std::filesystem::remove( TempPath, Error );
+            throw EBaseException(
+                Format( _D( "Unable to write \"%s\"" ), ARRAYOFCONST( ( FileName ) ) )
+            );
+        }
+    }
+
+    // Readers see either the old file or the new one, never a partial one
+    std::error_code Error;
+    std::filesystem::rename( TempPath, Path, Error );
+    if ( Error ) {
+        std::filesystem::remove( TempPath, Error );
+        throw EBaseException(
+            Format( _D( "Unable to write \"%s\"" ), ARRAYOFCONST( ( FileName ) ) )
+        );
+    }
+}
+//---------------------------------------------------------------------------
+
+size_t DeviceProfileCache::ApplyPolicies( Protocol& Proto ) const
+{
+    std::string const Endpoint = UTF8String( Proto.GetProtocolParamsStr() ).c_str();
+    size_t Count {};
+    for ( auto It = profiles_.lower_bound( KeyType( Endpoint, 0 ) ) ;
+          It != profiles_.end() && It->first.first == Endpoint ; ++It ) {
+        DeviceProfile const & Profile = It->second;
+        Proto.SetSlavePolicy(
+            Profile.SlaveAddr,
+            Profile.GetPolicy().MergedWith( Proto.GetSlavePolicy( Profile.SlaveAddr ) )
+        );
+        ++Count;
+    }
+    return Count;
+}
+
+//---------------------------------------------------------------------------
+}; // End of namespace Master
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
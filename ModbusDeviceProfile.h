@@ -0,0 +1,142 @@
+/**
+ * @file ModbusDeviceProfile.h
+ * @brief Modbus::Master::DeviceProfileCache — persistent per-device capabilities.
+ *
+ * @details A DeviceProfile records what is known about one device: its identification
+ *  (FC43/14 basic objects), the largest register and coil blocks it answers, the function
+ *  codes it implements, the word order of its multi-register values and its measured
+ *  response time.  A DeviceProfileCache keeps the profiles by endpoint and unit (slave)
+ *  address and saves them to a text file, so an application can configure its range
+ *  reads and schedulers at start-up without probing every device again.
+ *
+ *  The endpoint is the Protocol::GetProtocolParamsStr() of the transport the device is
+ *  reached through ("host:port" for Modbus TCP), so the same unit address behind two
+ *  gateways gives two profiles.
+ *
+ *  IdentifyDevice() fills a profile from one FC43/14 basic stream read and times it.
+ *  The limits, the function codes and the word order cannot be read from a device: the
+ *  application stores them, from its configuration or from its own probing, and
+ *  ApplyPolicies() turns the limits into slave policies (see
+ *  Protocol::SetSlavePolicy()) used by Protocol::ReadRange() and by every request.
+ *
+ *  File format: one @c [Device] section per profile followed by @c Key=Value lines, in
+ *  UTF-8.  Unknown keys are ignored; backslashes and line breaks in the values are
+ *  escaped.  Save() writes a temporary file and renames it over the old one.
+ *
+ *  A DeviceProfileCache is not synchronised: share it between threads under a lock.
+ */
+
+//---------------------------------------------------------------------------
+
+#ifndef ModbusDeviceProfileH
+#define ModbusDeviceProfileH
+
+#include <cstddef>
+#include <chrono>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <utility>
+
+#include "Modbus.h"
+#include "ModbusDataConv.h"
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace Master {
+//---------------------------------------------------------------------------
+
+/** @brief What is known about one device (see file description). */
+struct DeviceProfile {
+    std::string             Endpoint;     ///< Protocol::GetProtocolParamsStr(), UTF-8.
+    Context::SlaveAddrType  SlaveAddr {};
+
+    std::string             VendorName;   ///< FC43 object 0x00.
+    std::string             ProductCode;  ///< FC43 object 0x01.
+    std::string             Revision;     ///< FC43 object 0x02.
+
+    std::optional<unsigned> MaxRegisterCount; ///< Registers per FC03/FC04 transaction.
+    std::optional<unsigned> MaxCoilCount;     ///< Bits per FC01/FC02 transaction.
+
+    /** @brief Function codes the device implements; empty if not known. */
+    std::set<FunctionCode>  FunctionCodes;
+
+    DataConv::WordOrder     WordOrder { DataConv::WordOrder::ABCD };
+
+    /** @brief Measured response time (zero if not measured). */
+    std::chrono::microseconds ResponseTime {};
+
+    /**
+     * @brief Returns @c true if @p FnCode is in FunctionCodes, or if FunctionCodes is
+     *        empty (nothing known: assume the device implements it).
+     */
+    [[ nodiscard ]] bool Supports( FunctionCode FnCode ) const;
+
+    /** @brief Returns a policy holding the limits of the profile (other fields empty). */
+    [[ nodiscard ]] TransactionPolicy GetPolicy() const;
+};
+
+/**
+ * @brief Reads the basic identification objects of a device (FC43/14) and times the
+ *        read.
+ * @return A profile with Endpoint, SlaveAddr, the identification, ResponseTime and
+ *         FunctionCode::EncapsulatedInterfaceTransport in FunctionCodes.
+ * @throws EProtocolException (e.g. EIllegalFunction) raised by the device, or
+ *         EBaseException on a communication error.
+ */
+[[ nodiscard ]] DeviceProfile IdentifyDevice( Protocol& Proto, Context::SlaveAddrType SlaveAddr );
+
+/** @brief Profiles by endpoint and unit address, saved to a file (see file description). */
+class DeviceProfileCache {
+public:
+    /** @brief Returns the profile of a device, or @c nullptr if there is none. */
+    [[ nodiscard ]] DeviceProfile const * Find( std::string const & Endpoint,
+                                                Context::SlaveAddrType SlaveAddr ) const;
+
+    /** @brief Returns the profile of a device reached through @p Proto, or @c nullptr. */
+    [[ nodiscard ]] DeviceProfile const * Find( Protocol const & Proto,
+                                                Context::SlaveAddrType SlaveAddr ) const;
+
+    /** @brief Adds a profile or replaces the one with the same endpoint and unit. */
+    void Store( DeviceProfile const & Profile );
+
+    /** @brief Removes a profile; returns @c false if there was none. */
+    bool Erase( std::string const & Endpoint, Context::SlaveAddrType SlaveAddr );
+
+    void Clear() noexcept { profiles_.clear(); }
+
+    [[ nodiscard ]] size_t GetCount() const noexcept { return profiles_.size(); }
+
+    /**
+     * @brief Replaces the content of the cache with the profiles of a file.
+     * @return @c false, with the cache left empty, if the file does not exist.
+     * @throws EBaseException if the file cannot be read or is not a profile file.
+     */
+    bool Load( String const & FileName );
+
+    /**
+     * @brief Saves the profiles, replacing the file as a whole.
+     * @throws EBaseException if the file cannot be written.
+     */
+    void Save( String const & FileName ) const;
+
+    /**
+     * @brief Sets the limits of the profiles of the endpoint of @p Proto as the slave
+     *        policies of their units, merged with the slave policies already set.
+     * @return The number of profiles applied.
+     */
+    size_t ApplyPolicies( Protocol& Proto ) const;
+private:
+    using KeyType = std::pair<std::string,Context::SlaveAddrType>;
+
+    std::map<KeyType,DeviceProfile> profiles_;
+};
+
+//---------------------------------------------------------------------------
+}; // End of namespace Master
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
+#endif
@@ -0,0 +1,276 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include <algorithm>
+
+#include "ModbusDiscovery.h"
+#include "ModbusRTU.h"
+#include "ModbusTCP_IP.h"
+
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace Master {
+//---------------------------------------------------------------------------
+
+namespace {
+
+// Test word echoed back by FC08 sub-function 00
+constexpr RegDataType EchoTestWord = 0xA55A;
+
+} // End of anonymous namespace
+
+//---------------------------------------------------------------------------
+
+SlaveScanner::SlaveScanner( Protocol& Proto, ProbeMethod Method )
+    : proto_( Proto )
+    , rtu_( dynamic_cast<RTUFramingProtocol*>( &Proto ) )
+    , method_( Method )
+{
+}
+//---------------------------------------------------------------------------
+
+void SlaveScanner::SetRange( Context::SlaveAddrType First, Context::SlaveAddrType Last )
+{
+    if ( !First || First > Last ) {
+        throw EBaseException(
+            Format(
+                _D( "Invalid scan range %u-%u" ),
+                ARRAYOFCONST( ( static_cast<unsigned>( First ), static_cast<unsigned>( Last ) ) )
+            )
+        );
+    }
+    firstAddr_ = First;
+    lastAddr_ = Last;
+}
+//---------------------------------------------------------------------------
+
+unsigned SlaveScanner::GetProbeTimeout() const
+{
+    if ( rtu_ ) {
+        // Request (8 chars) and response (8 chars for the echo, 7 for one register),
+        // plus two 3.5 character silences rounded up
+        size_t const Chars = 8 + ( method_ == ProbeMethod::Echo ? 8 : 7 ) + 7;
+        unsigned const FrameTime = rtu_->GetFrameTime( Chars );
+        if ( FrameTime ) {
+            return ( FrameTime + 999 ) / 1000 + turnaround_;
+        }
+    }
+    // No line speed (RTU over TCP/UDP, other transports): the network round trip
+    // dominates, and is never assumed shorter than the network floor
+    return std::max( networkRoundTrip_, GetMeasuredRoundTrip() ) + turnaround_;
+}
+//---------------------------------------------------------------------------
+
+unsigned SlaveScanner::GetRequestTimeout( Context::SlaveAddrType SlaveAddr ) const
+{
+    // The timeout of the slave policy, else the response timeout of the transport
+    if ( auto const Timeout = proto_.GetEffectivePolicy( Context( SlaveAddr ) ).Timeout ) {
+        return *Timeout;
+    }
+    if ( rtu_ ) {
+        return rtu_->GetResponseTimeout();
+    }
+    if ( auto const TcpIp = dynamic_cast<TCPIPProtocol const *>( &proto_ ) ) {
+        return TcpIp->GetResponseTimeout();
+    }
+    return 0;
+}
+//---------------------------------------------------------------------------
+
+unsigned SlaveScanner::GetMeasuredRoundTrip() const
+{
+    // Slowest SRTT + 4 RTTVAR among the slaves the protocol has estimates for
+    RoundTripEstimator::Duration Slowest {};
+    for ( unsigned Addr = 0 ; Addr <= 255 ; ++Addr ) {
+        RoundTripEstimator const * const Estimator =
+            proto_.GetRoundTripEstimator( static_cast<Context::SlaveAddrType>( Addr ) );
+        if ( Estimator && Estimator->GetSampleCount() ) {
+            Slowest = std::max(
+                Slowest,
+                Estimator->GetSmoothedRoundTrip() + 4 * Estimator->GetRoundTripVariation()
+            );
+        }
+    }
+    return static_cast<unsigned>( ( Slowest.count() + 999 ) / 1000 );
+}
+//---------------------------------------------------------------------------
+
+Request SlaveScanner::MakeProbe( Context::SlaveAddrType SlaveAddr, RegDataType* Result ) const
+{
+    Request Req =
+        method_ == ProbeMethod::Echo ?
+            Request::Diagnostics(
+                SlaveAddr,
+                static_cast<DiagSubFnType>( DiagnosticsSubFunction::ReturnQueryData ),
+                EchoTestWord, Result
+            )
+          : Request::ReadHoldingRegisters( SlaveAddr, probeAddr_, 1, Result );
+    // The re-probe passes are the retries, whatever the policy of the slave says
+    Req.Policy.RetryCount = 0;
+    return Req;
+}
+//---------------------------------------------------------------------------
+
+bool SlaveScanner::IsAnswer( Request const & Req ) noexcept
+{
+    switch ( Req.Status ) {
+        case RequestStatus::Completed:
+            return true;
+        case RequestStatus::Exception:
+            // A gateway answers on behalf of a target that did not
+            return Req.ExceptCode != ExceptionCode::GatewayPathUnavailable &&
+                   Req.ExceptCode != ExceptionCode::GatewayTargetFailedToRespond;
+        default:
+            return false;
+    }
+}
+//---------------------------------------------------------------------------
+
+bool SlaveScanner::IsDefinitelyAbsent( Request const & Req ) noexcept
+{
+    // The gateway already waited for the target: probing again cannot help
+    return Req.Status == RequestStatus::Exception &&
+           Req.ExceptCode == ExceptionCode::GatewayTargetFailedToRespond;
+}
+//---------------------------------------------------------------------------
+
+void SlaveScanner::Reopen()
+{
+    // A late response to a timed out probe is skipped by transaction identifier,
+    // but a link closed by a failure must be opened again
+    if ( !proto_.IsConnected() ) {
+        proto_.Open();
+    }
+}
+//---------------------------------------------------------------------------
+
+void SlaveScanner::Probe( Request* Requests, size_t RequestCount )
+{
+    // A silent unit costs one probe timeout, shared with the probes in flight with
+    // it: a pipelined batch goes on after a timeout and reopens a link closed by it
+    // (see TCPProtocol::DoExecute()), so probes left pending mean that the link is lost
+    Reopen();
+    proto_.Execute( Requests, RequestCount );
+    if ( std::any_of(
+             Requests, Requests + RequestCount,
+             []( Request const & Req ) { return Req.Status == RequestStatus::Pending; }
+         ) ) {
+        throw EBaseException( _D( "Scan failed: connection lost" ) );
+    }
+}
+//---------------------------------------------------------------------------
+
+void SlaveScanner::Sweep( AddrCont& Silent, DeviceInventory& Inventory, unsigned Pass,
+                          unsigned Timeout )
+{
+    // Every pass is one batch, pipelined on Modbus TCP; a probe never waits longer
+    // than a normal request to its slave
+    std::vector<RegDataType> Results( Silent.size() );
+    std::vector<Request> Requests;
+    Requests.reserve( Silent.size() );
+    for ( size_t Idx = 0 ; Idx < Silent.size() ; ++Idx ) {
+        Request Req = MakeProbe( Silent[Idx], &Results[Idx] );
+        unsigned const RequestTimeout = GetRequestTimeout( Silent[Idx] );
+        Req.Policy.Timeout = RequestTimeout ? std::min( Timeout, RequestTimeout ) : Timeout;
+        Requests.push_back( Req );
+    }
+    Probe( Requests.data(), Requests.size() );
+
+    AddrCont StillSilent;
+    for ( Request const & Req : Requests ) {
+        if ( IsAnswer( Req ) ) {
+            DeviceInfo Device {};
+            Device.SlaveAddr = Req.SlaveAddr;
+            Device.ExceptionResponse = Req.Status == RequestStatus::Exception;
+            Device.ExceptCode = Req.ExceptCode;
+            Device.Pass = Pass;
+            Inventory.push_back( Device );
+        }
+        else if ( !IsDefinitelyAbsent( Req ) ) {
+            StillSilent.push_back( Req.SlaveAddr );
+        }
+    }
+    Silent.swap( StillSilent );
+}
+//---------------------------------------------------------------------------
+
+void SlaveScanner::Measure( DeviceInfo& Device )
+{
+    using Clock = std::chrono::steady_clock;
+    using std::chrono::microseconds;
+
+    microseconds Total {};
+    for ( unsigned Idx = 0 ; Idx < timingSamples_ ; ++Idx ) {
+        RegDataType Result {};
+        Request Req = MakeProbe( Device.SlaveAddr, &Result );
+        Reopen();
+        Clock::time_point const Start = Clock::now();
+        proto_.Execute( &Req, 1 );
+        microseconds const Elapsed =
+            std::chrono::duration_cast<microseconds>( Clock::now() - Start );
+        if ( !IsAnswer( Req ) ) {
+            continue;
+        }
+        if ( !Device.TimedProbes || Elapsed < Device.MinResponseTime ) {
+            Device.MinResponseTime = Elapsed;
+        }
+        Device.MaxResponseTime = std::max( Device.MaxResponseTime, Elapsed );
+        Total += Elapsed;
+        ++Device.TimedProbes;
+    }
+    if ( Device.TimedProbes ) {
+        Device.AvgResponseTime = Total / Device.TimedProbes;
+    }
+}
+//---------------------------------------------------------------------------
+
+DeviceInventory SlaveScanner::Scan()
+{
+    if ( !proto_.IsConnected() ) {
+        throw EBaseException( _D( "Scan failed: protocol not open" ) );
+    }
+
+    AddrCont Silent;
+    for ( unsigned Addr = firstAddr_ ; Addr <= lastAddr_ ; ++Addr ) {
+        Silent.push_back( static_cast<Context::SlaveAddrType>( Addr ) );
+    }
+
+    DeviceInventory Inventory;
+    unsigned Timeout = GetProbeTimeout();
+
+    for ( unsigned Pass = 0 ; Pass <= reprobeCount_ && !Silent.empty() ; ++Pass ) {
+        size_t const Known = Inventory.size();
+        Sweep( Silent, Inventory, Pass, Timeout );
+
+        // Time the new devices with the normal timeout, then make sure the next
+        // pass waits well beyond the slowest of them
+        std::chrono::microseconds Slowest {};
+        for ( size_t Idx = Known ; Idx < Inventory.size() ; ++Idx ) {
+            Measure( Inventory[Idx] );
+            Slowest = std::max( Slowest, Inventory[Idx].MaxResponseTime );
+        }
+        Timeout = std::max(
+            Timeout * 2, static_cast<unsigned>( ( 2 * Slowest.count() + 999 ) / 1000 )
+        );
+    }
+
+    Reopen();
+    std::sort(
+        Inventory.begin(), Inventory.end(),
+        []( DeviceInfo const & Lhs, DeviceInfo const & Rhs ) {
+            return Lhs.SlaveAddr < Rhs.SlaveAddr;
+        }
+    );
+    return Inventory;
+}
+
+//---------------------------------------------------------------------------
+}; // End of namespace Master
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
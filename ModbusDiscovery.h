@@ -0,0 +1,196 @@
+/**
+ * @file ModbusDiscovery.h
+ * @brief Modbus::Master::SlaveScanner — discovery of the slaves on a line or behind a gateway.
+ *
+ * @details A SlaveScanner probes a range of slave (unit) addresses and returns a
+ *  DeviceInventory: the addresses that answered, whether they answered the probe with an
+ *  exception response, and the response times measured on a few extra probes.
+ *
+ *  The probe is FC08 sub-function 00 (Return Query Data, the slave echoes a test word) or
+ *  a one-register FC03 read for devices that do not implement FC08.  Any answer counts,
+ *  exception responses included, except the gateway exceptions 0Ah/0Bh, which report that
+ *  nothing answered behind the gateway.
+ *
+ *  Each pass over the addresses is one Protocol::Execute() batch, which Modbus TCP
+ *  pipelines (see TCPProtocol::GetPipelineDepth()) and the other transports send one
+ *  request at a time.  The probes carry their own policy (TransactionPolicy, overriding
+ *  the policy of the slave and the transport settings, which the scan leaves alone):
+ *  - A short Timeout instead of the normal response timeout (see GetProbeTimeout()).  On
+ *    a serial RTU line it is the time the line needs to carry the request and the response
+ *    plus a turnaround allowance: at 19200 baud and the default allowance about 40 ms per
+ *    silent address, so a full 1-247 sweep takes seconds instead of minutes.  Without a
+ *    line speed (Modbus TCP, RTU over TCP/UDP) the line time is replaced by the network
+ *    round trip, the larger of GetNetworkRoundTrip() and the round trips the protocol
+ *    measured (see Protocol::SetAdaptiveTimeout()).  A silent unit then costs one short
+ *    timeout, shared on Modbus TCP with the probes in flight with it.
+ *  - No retries (RetryCount 0): the re-probe passes take their place.
+ *
+ *  Re-probing: addresses that stayed silent are probed again, up to GetReprobeCount() more
+ *  passes.  Each pass doubles the probe timeout and never waits less than twice the
+ *  slowest response seen so far; a probe never waits longer than a normal request to its
+ *  slave.
+ *
+ *  The protocol must be open; a link closed by a failure during the scan is opened again.
+ */
+
+//---------------------------------------------------------------------------
+
+#ifndef ModbusDiscoveryH
+#define ModbusDiscoveryH
+
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <vector>
+
+#include "Modbus.h"
+
+/**
+ * @brief Default time (ms) a slave is given to turn a probe around, on top of the line
+ *        time of the request and of the response.
+ */
+#if !defined( MODBUS_SCAN_DEFAULT_TURNAROUND )
+  #define MODBUS_SCAN_DEFAULT_TURNAROUND  20
+#endif
+
+/**
+ * @brief Default network round trip (ms) assumed by the probe timeout on the transports
+ *        that do not know a line speed (Modbus TCP, RTU over TCP/UDP).
+ */
+#if !defined( MODBUS_SCAN_DEFAULT_NETWORK_ROUND_TRIP )
+  #define MODBUS_SCAN_DEFAULT_NETWORK_ROUND_TRIP  100
+#endif
+
+/** @brief Default number of re-probe passes over the addresses that did not answer. */
+#if !defined( MODBUS_SCAN_DEFAULT_REPROBE_COUNT )
+  #define MODBUS_SCAN_DEFAULT_REPROBE_COUNT  2
+#endif
+
+/** @brief Default number of timed probes sent to every device found. */
+#if !defined( MODBUS_SCAN_DEFAULT_TIMING_SAMPLES )
+  #define MODBUS_SCAN_DEFAULT_TIMING_SAMPLES  3
+#endif
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace Master {
+//---------------------------------------------------------------------------
+
+class RTUFramingProtocol;
+
+/** @brief Request used to probe an address. */
+enum class ProbeMethod {
+    Echo,                 ///< FC08 sub-function 00 (Return Query Data).
+    ReadHoldingRegisters  ///< FC03, one register at SlaveScanner::GetProbeAddress().
+};
+
+/** @brief One device found by SlaveScanner::Scan(). */
+struct DeviceInfo {
+    Context::SlaveAddrType    SlaveAddr;
+    bool                      ExceptionResponse; ///< The probe was answered with an exception.
+    ExceptionCode             ExceptCode;        ///< Valid when ExceptionResponse is @c true.
+    unsigned                  Pass;              ///< Pass that found it (0 = first sweep).
+    unsigned                  TimedProbes;       ///< Timing probes that were answered.
+    std::chrono::microseconds MinResponseTime;
+    std::chrono::microseconds AvgResponseTime;
+    std::chrono::microseconds MaxResponseTime;
+};
+
+/** @brief Devices found by a scan, in ascending address order. */
+using DeviceInventory = std::vector<DeviceInfo>;
+
+/** @brief Probes a range of slave addresses (see file description). */
+class SlaveScanner {
+public:
+    /**
+     * @param Proto  Protocol used for the probes; must outlive the scanner.
+     * @param Method Probe request.
+     */
+    explicit SlaveScanner( Protocol& Proto, ProbeMethod Method = ProbeMethod::Echo );
+
+    SlaveScanner( SlaveScanner const & Rhs ) = delete;
+    SlaveScanner& operator=( SlaveScanner const & Rhs ) = delete;
+
+    [[ nodiscard ]] Context::SlaveAddrType GetFirstAddress() const noexcept { return firstAddr_; }
+    [[ nodiscard ]] Context::SlaveAddrType GetLastAddress() const noexcept { return lastAddr_; }
+
+    /**
+     * @brief Sets the address range to scan (default 1-247).
+     * @throws EBaseException if First is 0 (broadcast) or greater than Last.
+     */
+    void SetRange( Context::SlaveAddrType First, Context::SlaveAddrType Last );
+
+    [[ nodiscard ]] ProbeMethod GetMethod() const noexcept { return method_; }
+    void SetMethod( ProbeMethod Val ) noexcept { method_ = Val; }
+
+    /** @brief Register read by ProbeMethod::ReadHoldingRegisters (default 0). */
+    [[ nodiscard ]] RegAddrType GetProbeAddress() const noexcept { return probeAddr_; }
+    void SetProbeAddress( RegAddrType Val ) noexcept { probeAddr_ = Val; }
+
+    /** @brief Slave turnaround allowance (ms) of the probe timeout. */
+    [[ nodiscard ]] unsigned GetTurnaround() const noexcept { return turnaround_; }
+    void SetTurnaround( unsigned Val ) noexcept { turnaround_ = Val; }
+
+    /**
+     * @brief Minimum round trip (ms) of a probe over the network; replaces the line time
+     *        on the transports without a line speed.
+     */
+    [[ nodiscard ]] unsigned GetNetworkRoundTrip() const noexcept { return networkRoundTrip_; }
+    void SetNetworkRoundTrip( unsigned Val ) noexcept { networkRoundTrip_ = Val; }
+
+    /** @brief Number of re-probe passes over the silent addresses. */
+    [[ nodiscard ]] unsigned GetReprobeCount() const noexcept { return reprobeCount_; }
+    void SetReprobeCount( unsigned Val ) noexcept { reprobeCount_ = Val; }
+
+    /** @brief Number of timed probes per device found (0 skips the measurement). */
+    [[ nodiscard ]] unsigned GetTimingSamples() const noexcept { return timingSamples_; }
+    void SetTimingSamples( unsigned Val ) noexcept { timingSamples_ = Val; }
+
+    /**
+     * @brief Returns the probe timeout (ms) of the first pass: line time of the request
+     *        and of the response, two inter-frame silences and the turnaround allowance.
+     *        Without a line speed (Modbus TCP, RTU over TCP/UDP, ASCII) the network round
+     *        trip replaces the line time.
+     */
+    [[ nodiscard ]] unsigned GetProbeTimeout() const;
+
+    /**
+     * @brief Runs the scan.
+     * @return The devices found, in ascending address order.
+     * @throws EBaseException if the protocol is not open, or on a transport failure that
+     *  reopening the connection does not cure.
+     */
+    [[ nodiscard ]] DeviceInventory Scan();
+private:
+    using AddrCont = std::vector<Context::SlaveAddrType>;
+
+    Protocol&              proto_;
+    RTUFramingProtocol*    rtu_;
+    ProbeMethod            method_;
+    Context::SlaveAddrType firstAddr_ { 1 };
+    Context::SlaveAddrType lastAddr_ { 247 };
+    RegAddrType            probeAddr_ {};
+    unsigned               turnaround_ { MODBUS_SCAN_DEFAULT_TURNAROUND };
+    unsigned               networkRoundTrip_ { MODBUS_SCAN_DEFAULT_NETWORK_ROUND_TRIP };
+    unsigned               reprobeCount_ { MODBUS_SCAN_DEFAULT_REPROBE_COUNT };
+    unsigned               timingSamples_ { MODBUS_SCAN_DEFAULT_TIMING_SAMPLES };
+
+    [[ nodiscard ]] unsigned GetMeasuredRoundTrip() const;
+    [[ nodiscard ]] unsigned GetRequestTimeout( Context::SlaveAddrType SlaveAddr ) const;
+    [[ nodiscard ]] Request MakeProbe( Context::SlaveAddrType SlaveAddr, RegDataType* Result ) const;
+    void Probe( Request* Requests, size_t RequestCount );
+    void Sweep( AddrCont& Silent, DeviceInventory& Inventory, unsigned Pass, unsigned Timeout );
+    void Measure( DeviceInfo& Device );
+    void Reopen();
+
+    [[ nodiscard ]] static bool IsAnswer( Request const & Req ) noexcept;
+    [[ nodiscard ]] static bool IsDefinitelyAbsent( Request const & Req ) noexcept;
+};
+
+//---------------------------------------------------------------------------
+}; // End of namespace Master
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
+#endif
@@ -38,6 +38,8 @@ namespace Master {
  *      DoPresetMultipleRegisters / DoMaskWrite4XRegister / DoReadWrite4XRegisters /
  *      DoWriteGeneralReference: discarded.
  *    - DoReadExceptionStatus returns 0; DoDiagnostics echoes input data.
+ *    - DoFetchCommEventCtr / DoFetchCommEventLog return zero counters and an empty log;
+ *      DoReportSlave returns no data.
  *  - DoOpen() sets the internal connected flag to @c true.
  *  - DoClose() sets the internal connected flag to @c false.
  *  - DoIsConnected() returns the current flag state.
@@ -89,8 +91,10 @@ protected:
     { return Data; }
 //    DoProgram484
 //    DoPoll484
-//    DoFetchCommEventCtr
-//    DoFetchCommEventLog
+    virtual CommEventCounter DoFetchCommEventCtr( Context const & Context ) override
+    { return CommEventCounter(); }
+    virtual CommEventLog DoFetchCommEventLog( Context const & Context ) override
+    { return CommEventLog(); }
 //    DoProgramController
 //    DoPollController
     virtual void DoForceMultipleCoils( Context const & Context,
@@ -102,7 +106,8 @@ protected:
                                     RegCountType PointCount,
                                     const RegDataType* Data ) noexcept override {}
 
-//    DoReportSlave
+    virtual std::vector<uint8_t> DoReportSlave( Context const & Context ) override
+    { return std::vector<uint8_t>(); }
 //    DoProgram884_M84
 //    DoResetCommLink
     virtual void DoReadGeneralReference( Context const & Context,
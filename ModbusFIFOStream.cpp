@@ -0,0 +1,263 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include "ModbusFIFOStream.h"
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace Master {
+//---------------------------------------------------------------------------
+
+FIFOStreamReader::FIFOStreamReader( Protocol& Proto, Context::SlaveAddrType SlaveAddr,
+                                    FIFOAddrType FIFOAddr, size_t RingCapacity )
+  : proto_( Proto )
+  , slaveAddr_( SlaveAddr )
+  , fifoAddr_( FIFOAddr )
+  , ring_( RingCapacity )
+{
+}
+//---------------------------------------------------------------------------
+
+FIFOStreamReader::~FIFOStreamReader()
+{
+    Stop();
+}
+//---------------------------------------------------------------------------
+
+void FIFOStreamReader::Start()
+{
+    if ( worker_.joinable() ) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> Lock( mutex_ );
+        stopped_ = false;
+        interval_ = maxInterval_;
+        lastPause_ = maxInterval_;
+    }
+    depth_ = 1;
+    overflowing_ = false;
+    worker_ = std::thread( &FIFOStreamReader::Run, this );
+}
+//---------------------------------------------------------------------------
+
+void FIFOStreamReader::Stop()
+{
+    {
+        std::lock_guard<std::mutex> Lock( mutex_ );
+        stopped_ = true;
+    }
+    wakeUp_.notify_one();
+    if ( worker_.joinable() ) {
+        worker_.join();
+    }
+}
+//---------------------------------------------------------------------------
+
+String FIFOStreamReader::GetLastError() const
+{
+    std::lock_guard<std::mutex> Lock( mutex_ );
+    return lastError_;
+}
+//---------------------------------------------------------------------------
+
+unsigned FIFOStreamReader::GetMinInterval() const
+{
+    std::lock_guard<std::mutex> Lock( mutex_ );
+    return minInterval_;
+}
+//---------------------------------------------------------------------------
+
+void FIFOStreamReader::SetMinInterval( unsigned Val )
+{
+    std::lock_guard<std::mutex> Lock( mutex_ );
+    minInterval_ = Val;
+}
+//---------------------------------------------------------------------------
+
+unsigned FIFOStreamReader::GetMaxInterval() const
+{
+    std::lock_guard<std::mutex> Lock( mutex_ );
+    return maxInterval_;
+}
+//---------------------------------------------------------------------------
+
+void FIFOStreamReader::SetMaxInterval( unsigned Val )
+{
+    std::lock_guard<std::mutex> Lock( mutex_ );
+    maxInterval_ = Val;
+}
+//---------------------------------------------------------------------------
+
+size_t FIFOStreamReader::GetMaxDepth() const
+{
+    std::lock_guard<std::mutex> Lock( mutex_ );
+    return maxDepth_;
+}
+//---------------------------------------------------------------------------
+
+void FIFOStreamReader::SetMaxDepth( size_t Val )
+{
+    std::lock_guard<std::mutex> Lock( mutex_ );
+    maxDepth_ = std::max<size_t>( Val, 1 );
+}
+//---------------------------------------------------------------------------
+
+TransactionPolicy FIFOStreamReader::GetPolicy() const
+{
+    std::lock_guard<std::mutex> Lock( mutex_ );
+    return policy_;
+}
+//---------------------------------------------------------------------------
+
+void FIFOStreamReader::SetPolicy( TransactionPolicy const & Val )
+{
+    std::lock_guard<std::mutex> Lock( mutex_ );
+    policy_ = Val;
+}
+//---------------------------------------------------------------------------
+
+FIFOStreamReader::TAcknowledgeEvent FIFOStreamReader::SetAcknowledgeHandler(
+                                        TAcknowledgeEvent EventHandler )
+{
+    std::lock_guard<std::mutex> Lock( mutex_ );
+    TAcknowledgeEvent Old = onAcknowledge_;
+    onAcknowledge_ = EventHandler;
+    return Old;
+}
+//---------------------------------------------------------------------------
+
+void FIFOStreamReader::Run()
+{
+    std::vector<Request> Requests;
+    std::vector<RegDataType> Values;
+    for ( ;; ) {
+        unsigned const Pause = Poll( Requests, Values );
+        std::unique_lock<std::mutex> Lock( mutex_ );
+        if ( wakeUp_.wait_for(
+                 Lock, std::chrono::milliseconds( Pause ), [this]() { return stopped_; }
+             ) ) {
+            return;
+        }
+    }
+}
+//---------------------------------------------------------------------------
+
+unsigned FIFOStreamReader::Poll( std::vector<Request>& Requests,
+                                 std::vector<RegDataType>& Values )
+{
+    unsigned MinInterval;
+    unsigned MaxInterval;
+    size_t MaxDepth;
+    TransactionPolicy Policy;
+    TAcknowledgeEvent OnAcknowledge;
+    {
+        std::lock_guard<std::mutex> Lock( mutex_ );
+        MinInterval = minInterval_;
+        MaxInterval = std::max( maxInterval_, minInterval_ );
+        MaxDepth = maxDepth_;
+        Policy = policy_;
+        OnAcknowledge = onAcknowledge_;
+    }
+
+    size_t const Depth = std::min( depth_.load(), MaxDepth );
+    Values.resize( Depth * MaxFIFOCount );
+    Requests.clear();
+    for ( size_t Idx = 0 ; Idx < Depth ; ++Idx ) {
+        Requests.push_back(
+            Request::ReadFIFOQueue( slaveAddr_, fifoAddr_, Values.data() + Idx * MaxFIFOCount )
+        );
+        Requests.back().Policy = Policy;
+    }
+
+    String Error;
+    try {
+        if ( !OnAcknowledge ) {
+            proto_.Execute( Requests.data(), Requests.size() );
+        }
+        else {
+            // A read cannot be sent before the previous one is acknowledged, or it
+            // would return the same values
+            size_t Count {};
+            while ( Count < Depth ) {
+                Request& Req = Requests[Count++];
+                proto_.Execute( &Req, 1 );
+                if ( Req.Status != RequestStatus::Completed ) {
+                    break;
+                }
+                if ( Req.Value ) {
+                    try {
+                        OnAcknowledge( proto_, slaveAddr_, fifoAddr_,
+                                       static_cast<FIFOCountType>( Req.Value ) );
+                    }
+                    catch ( Exception const & E ) {
+                        // Not removed from the device: read again by the next burst
+                        Req.Status = RequestStatus::Failed;
+                        Req.ErrorMessage = E.Message;
+                        break;
+                    }
+                }
+                if ( Req.Value < MaxFIFOCount ) {
+                    break;
+                }
+            }
+            Requests.resize( Count );
+        }
+    }
+    catch ( Exception const & E ) {
+        // Protocol not open
+        Error = E.Message;
+    }
+
+    // The reads complete in order: push their values as they came
+    size_t Total {};
+    for ( Request const & Req : Requests ) {
+        if ( Req.Status != RequestStatus::Completed ) {
+            if ( Error.IsEmpty() ) {
+                Error = Req.ErrorMessage;
+            }
+            continue;
+        }
+        Total += Req.Value;
+        dropped_ += Req.Value - ring_.Push( Req.RegData, Req.Value );
+    }
+    received_ += Total;
+
+    if ( !Error.IsEmpty() ) {
+        ++errors_;
+        std::lock_guard<std::mutex> Lock( mutex_ );
+        lastError_ = Error;
+        return lastPause_ = MaxInterval;
+    }
+
+    unsigned Interval = interval_;
+    if ( Requests.back().Value == MaxFIFOCount ) {
+        // The device has more: follow at once with a longer burst
+        if ( Depth >= MaxDepth && !lastPause_ ) {
+            ++overflows_;
+            overflowing_ = true;
+        }
+        depth_ = std::min( Depth * 2, MaxDepth );
+        interval_ = std::max( Interval / 2, MinInterval );
+        return lastPause_ = 0;
+    }
+
+    overflowing_ = false;
+    depth_ = std::clamp<size_t>( ( Total + MaxFIFOCount - 1 ) / MaxFIFOCount, 1, MaxDepth );
+    if ( Total * 2 > Depth * MaxFIFOCount ) {
+        Interval /= 2;
+    }
+    else if ( Total * 8 < Depth * MaxFIFOCount ) {
+        Interval = std::max( Interval * 2, 1U );
+    }
+    interval_ = Interval = std::clamp( Interval, MinInterval, MaxInterval );
+    return lastPause_ = Interval;
+}
+
+//---------------------------------------------------------------------------
+}; // End of namespace Master
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
@@ -0,0 +1,293 @@
+/**
+ * @file ModbusFIFOStream.h
+ * @brief Modbus::Master::FIFOStreamReader — continuous drain of a device FIFO (FC24).
+ *
+ * @details An FC24 response carries at most 31 values, so a device that buffers samples
+ *  faster than one FIFO per round trip (a weigh-scale controller sampling at 200 Hz, say)
+ *  cannot be kept up with by a caller-side loop of ReadFIFOQueue() calls.  A
+ *  FIFOStreamReader drains the FIFO from a worker thread instead and delivers the values,
+ *  in device order, through a lock-free single-producer/single-consumer ring
+ *  (SPSCRing): the consumer thread calls Read() and never blocks the poll loop.
+ *
+ *  Each poll cycle submits a burst of FC24 reads as one Protocol::Execute() batch, which
+ *  Modbus TCP pipelines.  The reader adapts to the fill level it observes:
+ *  - The last read of the burst came back full (31 values): the device has more, so the
+ *    next burst follows at once and is twice as long, up to GetMaxDepth() reads.
+ *  - Otherwise the burst is sized for the values just read and the poll interval is
+ *    halved when the reads were more than half full, doubled when they were less than an
+ *    eighth full, within [GetMinInterval(), GetMaxInterval()].
+ *
+ *  Overflow: a burst of GetMaxDepth() reads sent without any pause that still ends with a
+ *  full read means the device produces faster than the link can drain it; the burst is
+ *  counted by GetOverflowCount() and IsOverflowing() stays @c true until a burst empties
+ *  the FIFO.  Values that do not fit in the ring because the consumer is too slow are
+ *  discarded and counted by GetDroppedCount().
+ *
+ *  Destructive reads: the Modbus specification says that FC24 reads the queue "but does
+ *  not clear" it.  Without an acknowledge handler the reader assumes a device whose FIFO
+ *  forgets the values it returns; on a device that follows the specification it would
+ *  deliver the same values at every read.  For such a device, install a TAcknowledgeEvent
+ *  (SetAcknowledgeHandler()) that removes the values read, typically with a write to a
+ *  device-specific register.  The reads of a burst are then sent one at a time, each
+ *  followed by its acknowledge, and the values of a read are delivered only once it has
+ *  been acknowledged: a failed acknowledge leaves them in the device for the next read.
+ *
+ *  The Protocol must be open while the reader runs and must not be used directly by other
+ *  threads (a RequestScheduler cannot share the link either).  A failed burst is counted
+ *  by GetErrorCount() and retried after GetMaxInterval().
+ */
+
+//---------------------------------------------------------------------------
+
+#ifndef ModbusFIFOStreamH
+#define ModbusFIFOStreamH
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Modbus.h"
+
+/** @brief Default capacity (values) of the ring between the reader and the consumer. */
+#if !defined( MODBUS_FIFO_STREAM_DEFAULT_RING_CAPACITY )
+  #define MODBUS_FIFO_STREAM_DEFAULT_RING_CAPACITY  4096
+#endif
+
+/** @brief Default lower bound (ms) of the poll interval. */
+#if !defined( MODBUS_FIFO_STREAM_DEFAULT_MIN_INTERVAL )
+  #define MODBUS_FIFO_STREAM_DEFAULT_MIN_INTERVAL  5
+#endif
+
+/** @brief Default upper bound (ms) of the poll interval, also the pause after a failure. */
+#if !defined( MODBUS_FIFO_STREAM_DEFAULT_MAX_INTERVAL )
+  #define MODBUS_FIFO_STREAM_DEFAULT_MAX_INTERVAL  100
+#endif
+
+/** @brief Default maximum number of FC24 reads in one burst. */
+#if !defined( MODBUS_FIFO_STREAM_DEFAULT_MAX_DEPTH )
+  #define MODBUS_FIFO_STREAM_DEFAULT_MAX_DEPTH  8
+#endif
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+
+/**
+ * @brief Bounded lock-free queue for exactly one producer thread and one consumer thread.
+ *
+ * @details The capacity is rounded up to a power of two.  The producer owns the head
+ *  index and the consumer the tail index; each publishes its index with a release store
+ *  and reads the other's with an acquire load, so no lock is taken on either side.  The
+ *  two indices live on separate cache lines.
+ */
+template<typename T>
+class SPSCRing {
+public:
+    explicit SPSCRing( size_t Capacity )
+      : buffer_( RoundUpToPowerOfTwo( std::max<size_t>( Capacity, 2 ) ) )
+      , mask_( buffer_.size() - 1 )
+    {
+    }
+
+    SPSCRing( SPSCRing const & Rhs ) = delete;
+    SPSCRing& operator=( SPSCRing const & Rhs ) = delete;
+
+    [[ nodiscard ]] size_t GetCapacity() const noexcept { return buffer_.size(); }
+
+    /** @brief Number of values queued (exact for the producer and for the consumer). */
+    [[ nodiscard ]] size_t GetSize() const noexcept {
+        return head_.load( std::memory_order_acquire ) - tail_.load( std::memory_order_acquire );
+    }
+
+    /**
+     * @brief Appends up to @p Count values (producer side).
+     * @return The number of values appended; less than @p Count if the ring is full.
+     */
+    size_t Push( T const * Data, size_t Count ) noexcept
+    {
+        size_t const Head = head_.load( std::memory_order_relaxed );
+        size_t const Tail = tail_.load( std::memory_order_acquire );
+        Count = std::min( Count, buffer_.size() - ( Head - Tail ) );
+        for ( size_t Idx = 0 ; Idx < Count ; ++Idx ) {
+            buffer_[( Head + Idx ) & mask_] = Data[Idx];
+        }
+        head_.store( Head + Count, std::memory_order_release );
+        return Count;
+    }
+
+    /**
+     * @brief Removes up to @p MaxCount values (consumer side).
+     * @return The number of values stored in @p Data.
+     */
+    size_t Pop( T* Data, size_t MaxCount ) noexcept
+    {
+        size_t const Tail = tail_.load( std::memory_order_relaxed );
+        size_t const Head = head_.load( std::memory_order_acquire );
+        size_t const Count = std::min( MaxCount, Head - Tail );
+        for ( size_t Idx = 0 ; Idx < Count ; ++Idx ) {
+            Data[Idx] = buffer_[( Tail + Idx ) & mask_];
+        }
+        tail_.store( Tail + Count, std::memory_order_release );
+        return Count;
+    }
+private:
+    static constexpr size_t CacheLineSize = 64;
+
+    std::vector<T> buffer_;
+    size_t         mask_;
+    alignas( CacheLineSize ) std::atomic<size_t> head_ {};
+    alignas( CacheLineSize ) std::atomic<size_t> tail_ {};
+
+    static size_t RoundUpToPowerOfTwo( size_t Val ) noexcept
+    {
+        size_t Result = 1;
+        while ( Result < Val ) {
+            Result <<= 1;
+        }
+        return Result;
+    }
+};
+
+//---------------------------------------------------------------------------
+namespace Master {
+//---------------------------------------------------------------------------
+
+/** @brief Drains a device FIFO into a lock-free ring (see file description). */
+class FIFOStreamReader {
+public:
+    /**
+     * @brief Signature of the acknowledge handler (see file description).
+     * @details Called from the worker thread after every read that returned values, with
+     *  the protocol of the reader and the number of values read; it must remove them from
+     *  the device FIFO before returning, and raise an exception if it cannot.
+     */
+    using TAcknowledgeEvent =
+       void __fastcall ( __closure * )(
+           Protocol& Proto, Context::SlaveAddrType SlaveAddr, FIFOAddrType FIFOAddr,
+           FIFOCountType Count
+       );
+
+    /**
+     * @param Proto        Protocol used for the reads; must outlive the reader.
+     * @param SlaveAddr    Slave (unit) address.
+     * @param FIFOAddr     Address of the FIFO pointer register.
+     * @param RingCapacity Capacity of the ring, rounded up to a power of two.
+     */
+    FIFOStreamReader( Protocol& Proto, Context::SlaveAddrType SlaveAddr,
+                      FIFOAddrType FIFOAddr,
+                      size_t RingCapacity = MODBUS_FIFO_STREAM_DEFAULT_RING_CAPACITY );
+
+    /** @brief Stops the worker thread (see Stop()). */
+    ~FIFOStreamReader();
+
+    FIFOStreamReader( FIFOStreamReader const & Rhs ) = delete;
+    FIFOStreamReader& operator=( FIFOStreamReader const & Rhs ) = delete;
+
+    /** @brief Starts the worker thread; no effect if it is running. */
+    void Start();
+
+    /** @brief Stops the worker thread once the burst in progress, if any, is complete. */
+    void Stop();
+
+    [[ nodiscard ]] bool IsRunning() const noexcept { return worker_.joinable(); }
+
+    /**
+     * @brief Moves up to @p MaxCount values, oldest first, from the ring to @p Data.
+     * @details Never blocks; call it from one consumer thread only.
+     * @return The number of values stored in @p Data.
+     */
+    size_t Read( RegDataType* Data, size_t MaxCount ) noexcept { return ring_.Pop( Data, MaxCount ); }
+
+    /** @brief Number of values waiting in the ring. */
+    [[ nodiscard ]] size_t GetAvailable() const noexcept { return ring_.GetSize(); }
+
+    /** @brief Number of values read from the device since construction. */
+    [[ nodiscard ]] uint64_t GetReceivedCount() const noexcept { return received_.load(); }
+
+    /** @brief Values discarded because the ring was full. */
+    [[ nodiscard ]] uint64_t GetDroppedCount() const noexcept { return dropped_.load(); }
+
+    /** @brief Bursts at full depth and rate that still left values in the FIFO. */
+    [[ nodiscard ]] uint64_t GetOverflowCount() const noexcept { return overflows_.load(); }
+
+    /** @brief @c true from an overflowing burst until a burst empties the FIFO. */
+    [[ nodiscard ]] bool IsOverflowing() const noexcept { return overflowing_.load(); }
+
+    /** @brief Bursts with at least one failed read. */
+    [[ nodiscard ]] uint64_t GetErrorCount() const noexcept { return errors_.load(); }
+
+    /** @brief Message of the last failed read (empty if none). */
+    [[ nodiscard ]] String GetLastError() const;
+
+    /** @brief Poll interval (ms) currently in use. */
+    [[ nodiscard ]] unsigned GetInterval() const noexcept { return interval_.load(); }
+
+    /** @brief Number of reads of the next burst. */
+    [[ nodiscard ]] size_t GetDepth() const noexcept { return depth_.load(); }
+
+    [[ nodiscard ]] unsigned GetMinInterval() const;
+    void SetMinInterval( unsigned Val );
+
+    [[ nodiscard ]] unsigned GetMaxInterval() const;
+    void SetMaxInterval( unsigned Val );
+
+    [[ nodiscard ]] size_t GetMaxDepth() const;
+    void SetMaxDepth( size_t Val );
+
+    /** @brief Transaction policy applied to every read. */
+    [[ nodiscard ]] TransactionPolicy GetPolicy() const;
+    void SetPolicy( TransactionPolicy const & Val );
+
+    /**
+     * @brief Installs the acknowledge handler of a device whose FC24 reads do not clear
+     *        its FIFO, and returns the previous one.
+     * @param EventHandler New handler (pass @c nullptr for a device with destructive reads).
+     */
+    TAcknowledgeEvent SetAcknowledgeHandler( TAcknowledgeEvent EventHandler );
+private:
+    static constexpr size_t MaxFIFOCount = 31;
+
+    Protocol&               proto_;
+    Context::SlaveAddrType  slaveAddr_;
+    FIFOAddrType            fifoAddr_;
+    SPSCRing<RegDataType>   ring_;
+
+    mutable std::mutex      mutex_;
+    std::condition_variable wakeUp_;
+    bool                    stopped_ {};
+    unsigned                minInterval_ { MODBUS_FIFO_STREAM_DEFAULT_MIN_INTERVAL };
+    unsigned                maxInterval_ { MODBUS_FIFO_STREAM_DEFAULT_MAX_INTERVAL };
+    size_t                  maxDepth_ { MODBUS_FIFO_STREAM_DEFAULT_MAX_DEPTH };
+    TransactionPolicy       policy_;
+    TAcknowledgeEvent       onAcknowledge_ {};
+    String                  lastError_;
+
+    std::atomic<unsigned>   interval_ { MODBUS_FIFO_STREAM_DEFAULT_MAX_INTERVAL };
+    std::atomic<size_t>     depth_ { 1 };
+    std::atomic<uint64_t>   received_ {};
+    std::atomic<uint64_t>   dropped_ {};
+    std::atomic<uint64_t>   overflows_ {};
+    std::atomic<bool>       overflowing_ {};
+    std::atomic<uint64_t>   errors_ {};
+    unsigned                lastPause_ {};   // worker thread only
+
+    std::thread             worker_;
+
+    void Run();
+
+    /** @brief Runs one burst; returns the pause (ms) before the next one. */
+    unsigned Poll( std::vector<Request>& Requests, std::vector<RegDataType>& Values );
+};
+
+//---------------------------------------------------------------------------
+}; // End of namespace Master
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
+#endif
@@ -0,0 +1,207 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include <algorithm>
+
+#include "ModbusFileTransfer.h"
+#include "ModbusPDU.h"
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace Master {
+//---------------------------------------------------------------------------
+
+FileTransfer::FileTransfer( Protocol& Proto, Context::SlaveAddrType SlaveAddr,
+                            FunctionCode FnCode,
+                            const FileSubRequest* Segments, size_t SegmentCount,
+                            RegDataType* Data, const RegDataType* Source )
+  : proto_( Proto )
+  , slaveAddr_( SlaveAddr )
+  , fnCode_( FnCode )
+  , data_( Data )
+  , source_( Source )
+{
+    Pack( Segments, SegmentCount );
+}
+//---------------------------------------------------------------------------
+
+FileTransfer FileTransfer::Read( Protocol& Proto, Context::SlaveAddrType SlaveAddr,
+                                 const FileSubRequest* Segments, size_t SegmentCount,
+                                 RegDataType* Data )
+{
+    return FileTransfer(
+        Proto, SlaveAddr, FunctionCode::ReadGeneralReference,
+        Segments, SegmentCount, Data, nullptr
+    );
+}
+//---------------------------------------------------------------------------
+
+FileTransfer FileTransfer::Write( Protocol& Proto, Context::SlaveAddrType SlaveAddr,
+                                  const FileSubRequest* Segments, size_t SegmentCount,
+                                  const RegDataType* Data )
+{
+    return FileTransfer(
+        Proto, SlaveAddr, FunctionCode::WriteGeneralReference,
+        Segments, SegmentCount, nullptr, Data
+    );
+}
+//---------------------------------------------------------------------------
+
+void FileTransfer::Pack( const FileSubRequest* Segments, size_t SegmentCount )
+{
+    using Codec = PDU::FileRecordCodec;
+
+    // A read sub-request costs 7 bytes of request and 2 + 2n of response; a write
+    // sub-request 7 + 2n bytes of request, echoed by the response
+    bool const Reading = fnCode_ == FunctionCode::ReadGeneralReference;
+    size_t const SubOverhead =
+        Reading ? Codec::SubResponseHeaderLength : Codec::SubRequestLength;
+
+    size_t RequestLength {};
+    size_t ResponseLength {};
+    for ( size_t Idx = 0 ; Idx < SegmentCount ; ++Idx ) {
+        FileSubRequest const & Segment = Segments[Idx];
+        if ( !Segment.RecordLength ||
+             Segment.RecordNumber + Segment.RecordLength - 1 > Codec::MaxRecordNumber ) {
+            throw EBaseException( _D( "Invalid file segment" ) );
+        }
+
+        size_t Record = Segment.RecordNumber;
+        size_t Left = Segment.RecordLength;
+        while ( Left ) {
+            size_t Room {};
+            if ( !chunks_.empty() &&
+                 RequestLength + Codec::SubRequestLength <= PDU::MaxLength ) {
+                size_t const Used = Reading ? ResponseLength : RequestLength;
+                if ( Used + SubOverhead < PDU::MaxLength ) {
+                    Room = ( PDU::MaxLength - Used - SubOverhead ) / sizeof( RegDataType );
+                }
+            }
+            if ( !Room ) {
+                chunks_.push_back( { subRequests_.size(), 0, recordCount_, 0, false } );
+                RequestLength = ResponseLength = 2;
+                continue;
+            }
+
+            size_t const Count = std::min( Left, Room );
+            subRequests_.push_back(
+                {
+                    Segment.FileNumber,
+                    static_cast<RecordNumberType>( Record ),
+                    static_cast<RecordLengthType>( Count )
+                }
+            );
+            Chunk& Item = chunks_.back();
+            ++Item.SubReqCount;
+            Item.RecordCount += Count;
+            RequestLength += Codec::SubRequestLength;
+            ResponseLength += Codec::SubResponseHeaderLength;
+            ( Reading ? ResponseLength : RequestLength ) += Count * sizeof( RegDataType );
+
+            Record += Count;
+            Left -= Count;
+            recordCount_ += Count;
+        }
+    }
+}
+//---------------------------------------------------------------------------
+
+Request FileTransfer::MakeRequest( Chunk const & Item ) const
+{
+    const FileSubRequest* SubRequests = subRequests_.data() + Item.FirstSubRequest;
+    Request Req =
+        fnCode_ == FunctionCode::ReadGeneralReference ?
+            Request::ReadGeneralReference(
+                slaveAddr_, SubRequests, Item.SubReqCount, data_ + Item.Offset
+            )
+        :
+            Request::WriteGeneralReference(
+                slaveAddr_, SubRequests, Item.SubReqCount, source_ + Item.Offset
+            );
+    Req.Policy = policy_;
+    return Req;
+}
+//---------------------------------------------------------------------------
+
+void FileTransfer::Run()
+{
+    std::vector<Request> Requests;
+    std::vector<size_t> Items;
+    Requests.reserve( std::min( batchSize_, chunks_.size() ) );
+    Items.reserve( Requests.capacity() );
+
+    size_t Next = 0;
+    for ( ;; ) {
+        Requests.clear();
+        Items.clear();
+        for ( ; Next < chunks_.size() && Items.size() < batchSize_ ; ++Next ) {
+            if ( !chunks_[Next].Done ) {
+                Items.push_back( Next );
+                Requests.push_back( MakeRequest( chunks_[Next] ) );
+            }
+        }
+        if ( Items.empty() ) {
+            return;
+        }
+
+        size_t const Completed = proto_.Execute( Requests.data(), Requests.size() );
+        for ( size_t Idx = 0 ; Idx < Items.size() ; ++Idx ) {
+            if ( Requests[Idx].Status == RequestStatus::Completed ) {
+                Chunk& Item = chunks_[Items[Idx]];
+                Item.Done = true;
+                transferred_ += Item.RecordCount;
+            }
+        }
+        if ( Completed == Requests.size() ) {
+            continue;
+        }
+
+        // Stop at the first batch with failures: the chunks done are kept for Run()
+        for ( size_t Idx = 0 ; Idx < Items.size() ; ++Idx ) {
+            if ( Requests[Idx].Status != RequestStatus::Completed ) {
+                FileSubRequest const & Sub = subRequests_[chunks_[Items[Idx]].FirstSubRequest];
+                RaiseExceptionIfRequestFailed(
+                    Context( slaveAddr_, policy_ ), Requests[Idx],
+                    Format(
+                        _D( "file %u record %u" ),
+                        ARRAYOFCONST( (
+                            static_cast<unsigned>( Sub.FileNumber ),
+                            static_cast<unsigned>( Sub.RecordNumber )
+                        ) )
+                    )
+                );
+            }
+        }
+    }
+}
+//---------------------------------------------------------------------------
+
+size_t FileTransfer::GetResumePoint() const noexcept
+{
+    auto const It =
+        std::find_if(
+            chunks_.begin(), chunks_.end(),
+            []( Chunk const & Item ) { return !Item.Done; }
+        );
+    return It == chunks_.end() ? recordCount_ : It->Offset;
+}
+//---------------------------------------------------------------------------
+
+void FileTransfer::SetResumePoint( size_t Val ) noexcept
+{
+    transferred_ = 0;
+    for ( Chunk& Item : chunks_ ) {
+        Item.Done = Item.Offset + Item.RecordCount <= Val;
+        if ( Item.Done ) {
+            transferred_ += Item.RecordCount;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+}; // End of namespace Master
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
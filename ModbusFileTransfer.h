@@ -0,0 +1,158 @@
+/**
+ * @file ModbusFileTransfer.h
+ * @brief Modbus::Master::FileTransfer — bulk file record transfer over FC20/FC21.
+ *
+ * @details A FileTransfer moves a list of file record segments of any length between
+ *  the slave and a contiguous register buffer.  A segment is a FileSubRequest whose
+ *  RecordLength is not limited by the PDU size: a whole file is one segment of up to
+ *  10000 records.
+ *
+ *  At construction the segments are cut and packed into chunks, each one FC20 or FC21
+ *  transaction filled up to the 253-byte PDU limit: a chunk carries as many sub-requests
+ *  as fit, and a segment that does not fit is continued in the next chunk.  A read chunk
+ *  carries up to 124 records (123 when it spans two segments), a write chunk up to 122.
+ *
+ *  Run() submits the chunks to Protocol::Execute() in batches of GetBatchSize() items,
+ *  which Modbus TCP pipelines, so the transfer time is bound by the bandwidth rather than
+ *  by the number of round trips.  The records go straight to (or come straight from) the
+ *  caller's buffer, at the offset of each chunk: no intermediate copy is made, and the
+ *  buffer may be a view of a memory-mapped file.
+ *
+ *  Resuming: every chunk that completes is marked done.  If a batch has failures, Run()
+ *  raises the error of the first failed chunk once the batch is over; calling Run()
+ *  again transfers only the chunks that are not done.  GetResumePoint() returns the
+ *  number of leading registers already transferred, which an application can store to
+ *  resume an interrupted transfer in a new FileTransfer with SetResumePoint().
+ */
+
+//---------------------------------------------------------------------------
+
+#ifndef ModbusFileTransferH
+#define ModbusFileTransferH
+
+#include <cstddef>
+#include <vector>
+
+#include "Modbus.h"
+
+/**
+ * @brief Default number of chunks submitted to Protocol::Execute() at a time.
+ */
+#if !defined( MODBUS_FILE_TRANSFER_DEFAULT_BATCH_SIZE )
+  #define MODBUS_FILE_TRANSFER_DEFAULT_BATCH_SIZE  32
+#endif
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace Master {
+//---------------------------------------------------------------------------
+
+/** @brief Transfers file record segments in pipelined chunks (see file description). */
+class FileTransfer {
+public:
+    /**
+     * @brief Builds a transfer that reads the segments (FC20).
+     * @param Proto        Protocol used for the transfer; must outlive the object.
+     * @param SlaveAddr    Slave (unit) address.
+     * @param Segments     Segments to read; they are copied.
+     * @param SegmentCount Number of segments.
+     * @param[out] Data    Receives the records of all segments, in segment order; must
+     *                     hold the sum of the RecordLength fields and stay valid for the
+     *                     lifetime of the object.
+     * @throws EBaseException if a segment is empty or exceeds record 9999.
+     */
+    [[ nodiscard ]] static FileTransfer Read( Protocol& Proto,
+                                              Context::SlaveAddrType SlaveAddr,
+                                              const FileSubRequest* Segments,
+                                              size_t SegmentCount,
+                                              RegDataType* Data );
+
+    /**
+     * @brief Builds a transfer that writes the segments (FC21).
+     * @param Data Records of all segments, in segment order (see Read()).
+     */
+    [[ nodiscard ]] static FileTransfer Write( Protocol& Proto,
+                                               Context::SlaveAddrType SlaveAddr,
+                                               const FileSubRequest* Segments,
+                                               size_t SegmentCount,
+                                               const RegDataType* Data );
+
+    FileTransfer( FileTransfer const & Rhs ) = delete;
+    FileTransfer& operator=( FileTransfer const & Rhs ) = delete;
+
+    /**
+     * @brief Transfers the chunks that are not done yet.
+     * @throws EProtocolException (or EBaseException on a communication error) raised by
+     *  the first chunk, in buffer order, that did not complete.
+     * @throws EBaseException if the protocol is not open.
+     */
+    void Run();
+
+    /** @brief Returns @c true once every chunk is done. */
+    [[ nodiscard ]] bool IsComplete() const noexcept { return transferred_ == recordCount_; }
+
+    /** @brief Total number of registers (records) of the segments. */
+    [[ nodiscard ]] size_t GetRecordCount() const noexcept { return recordCount_; }
+
+    /** @brief Number of registers transferred by the chunks done so far. */
+    [[ nodiscard ]] size_t GetTransferredCount() const noexcept { return transferred_; }
+
+    /** @brief Number of FC20/FC21 transactions the transfer is made of. */
+    [[ nodiscard ]] size_t GetChunkCount() const noexcept { return chunks_.size(); }
+
+    /**
+     * @brief Returns the number of leading registers of the buffer that are transferred,
+     *        i.e. the offset of the first chunk that is not done.
+     */
+    [[ nodiscard ]] size_t GetResumePoint() const noexcept;
+
+    /**
+     * @brief Marks as done the chunks that lie within the first @p Val registers and the
+     *        others as not done (0 restarts the transfer).  A chunk that straddles
+     *        @p Val is transferred again.
+     */
+    void SetResumePoint( size_t Val ) noexcept;
+
+    /** @brief Number of chunks submitted to Protocol::Execute() at a time. */
+    [[ nodiscard ]] size_t GetBatchSize() const noexcept { return batchSize_; }
+    void SetBatchSize( size_t Val ) noexcept { batchSize_ = Val ? Val : 1; }
+
+    /** @brief Transaction policy applied to every chunk. */
+    [[ nodiscard ]] TransactionPolicy const & GetPolicy() const noexcept { return policy_; }
+    void SetPolicy( TransactionPolicy const & Val ) { policy_ = Val; }
+private:
+    struct Chunk {
+        size_t FirstSubRequest;
+        size_t SubReqCount;
+        size_t Offset;          ///< Offset of the records in the buffer.
+        size_t RecordCount;
+        bool   Done;
+    };
+
+    Protocol&                   proto_;
+    Context::SlaveAddrType      slaveAddr_;
+    FunctionCode                fnCode_;
+    RegDataType*                data_;
+    const RegDataType*          source_;
+    TransactionPolicy           policy_;
+    size_t                      batchSize_ { MODBUS_FILE_TRANSFER_DEFAULT_BATCH_SIZE };
+    std::vector<FileSubRequest> subRequests_;
+    std::vector<Chunk>          chunks_;
+    size_t                      recordCount_ {};
+    size_t                      transferred_ {};
+
+    FileTransfer( Protocol& Proto, Context::SlaveAddrType SlaveAddr, FunctionCode FnCode,
+                  const FileSubRequest* Segments, size_t SegmentCount,
+                  RegDataType* Data, const RegDataType* Source );
+
+    void Pack( const FileSubRequest* Segments, size_t SegmentCount );
+    [[ nodiscard ]] Request MakeRequest( Chunk const & Item ) const;
+};
+
+//---------------------------------------------------------------------------
+}; // End of namespace Master
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
+#endif
@@ -0,0 +1,142 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include <algorithm>
+
+#include "ModbusHealth.h"
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace Master {
+//---------------------------------------------------------------------------
+
+HealthMonitor::HealthMonitor( Protocol& Proto )
+  : proto_( Proto )
+{
+}
+//---------------------------------------------------------------------------
+
+void HealthMonitor::AddDevice( Context::SlaveAddrType SlaveAddr )
+{
+    if ( !devices_.count( SlaveAddr ) ) {
+        devices_[SlaveAddr].Health.SlaveAddr = SlaveAddr;
+    }
+}
+//---------------------------------------------------------------------------
+
+bool HealthMonitor::RemoveDevice( Context::SlaveAddrType SlaveAddr )
+{
+    return devices_.erase( SlaveAddr ) != 0;
+}
+//---------------------------------------------------------------------------
+
+DeviceHealth const * HealthMonitor::GetDevice( Context::SlaveAddrType SlaveAddr ) const
+{
+    auto const It = devices_.find( SlaveAddr );
+    return It == devices_.end() ? nullptr : &It->second.Health;
+}
+//---------------------------------------------------------------------------
+
+void HealthMonitor::Acknowledge( Context::SlaveAddrType SlaveAddr, unsigned MessageCount )
+{
+    auto const It = devices_.find( SlaveAddr );
+    if ( It != devices_.end() ) {
+        It->second.Acknowledged += MessageCount;
+    }
+}
+//---------------------------------------------------------------------------
+
+std::vector<Context::SlaveAddrType> HealthMonitor::Poll()
+{
+    std::vector<Request> Requests;
+    Requests.reserve( devices_.size() );
+    for ( auto& Item : devices_ ) {
+        Requests.push_back( Request::FetchCommEventCtr( Item.first, Item.second.Result ) );
+        Requests.back().Policy = policy_;
+    }
+
+    proto_.Execute( Requests.data(), Requests.size() );
+
+    // A transport failure in a pipelined batch costs every poll in flight an attempt:
+    // poll the failed ones again one at a time, so that only the devices that do not
+    // answer are charged with a failure.  Polls left pending could not be sent at all.
+    if ( proto_.IsConnected() &&
+         std::count_if(
+             Requests.cbegin(), Requests.cend(),
+             []( Request const & Req ) { return Req.Status == RequestStatus::Failed; }
+         ) > 1 ) {
+        for ( Request& Req : Requests ) {
+            if ( Req.Status == RequestStatus::Failed ) {
+                proto_.Execute( &Req, 1 );
+            }
+        }
+    }
+
+    std::vector<Context::SlaveAddrType> Changed;
+    auto Req = Requests.cbegin();
+    for ( auto& Item : devices_ ) {
+        if ( Update( Item.second, *Req++ ) ) {
+            Changed.push_back( Item.first );
+        }
+    }
+    return Changed;
+}
+//---------------------------------------------------------------------------
+
+bool HealthMonitor::Update( Device& Item, Request const & Req )
+{
+    // Never sent: nothing is known about the device
+    if ( Req.Status == RequestStatus::Pending ) {
+        return false;
+    }
+
+    DeviceHealth& Health = Item.Health;
+    unsigned const Acknowledged = Item.Acknowledged;
+    Item.Acknowledged = 0;
+
+    bool Answered = Req.Status == RequestStatus::Completed;
+    if ( Req.Status == RequestStatus::Exception ) {
+        // A gateway exception means that nothing answered behind the gateway
+        Answered =
+            Req.ExceptCode != ExceptionCode::GatewayPathUnavailable &&
+            Req.ExceptCode != ExceptionCode::GatewayTargetFailedToRespond;
+    }
+    if ( !Answered ) {
+        Health.LastError = Req.ErrorMessage;
+        if ( ++Health.FailedPolls >= offlineThreshold_ ) {
+            Health.Online = false;
+            Health.EventCount.reset();
+        }
+        return false;
+    }
+
+    bool const WasOnline = Health.Online;
+    Health.Online = true;
+    Health.FailedPolls = 0;
+    if ( Req.Status == RequestStatus::Exception ) {
+        if ( Req.ExceptCode == ExceptionCode::IllegalFunction ) {
+            Health.Supported = false;
+        }
+        Health.Busy = Req.ExceptCode == ExceptionCode::SlaveDeviceBusy;
+        return !Health.Supported || !WasOnline;
+    }
+
+    // The counter wraps at 16 bits
+    std::optional<RegDataType> const Previous = Health.EventCount;
+    Health.Supported = true;
+    Health.Busy = Item.Result[0] == 0xFFFF;
+    Health.EventCount = Item.Result[1];
+    if ( !WasOnline || !Previous ) {
+        return true;
+    }
+    RegDataType const Moved = static_cast<RegDataType>( *Health.EventCount - *Previous );
+    return Moved > Acknowledged;
+}
+
+//---------------------------------------------------------------------------
+}; // End of namespace Master
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
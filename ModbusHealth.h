@@ -0,0 +1,130 @@
+/**
+ * @file ModbusHealth.h
+ * @brief Modbus::Master::HealthMonitor — liveness and change polling over FC11.
+ *
+ * @details On a busy serial line, reading every device's data at each scan cycle to
+ *  find out whether it is alive and whether anything changed is the most expensive
+ *  way to do it.  A HealthMonitor polls the devices with FC11 (Fetch Comm Event
+ *  Counter) instead: a 4-byte request frame and an 8-byte response frame per device on
+ *  an RTU line, submitted as one Protocol::Execute() batch (pipelined by Modbus TCP).
+ *
+ *  A slave increments its event counter for every message it completes normally, so a
+ *  counter that moved since the previous poll means some master talked to the device —
+ *  another HMI writing a setpoint, typically.  Poll() returns the devices whose data
+ *  should be scanned:
+ *  - devices whose counter moved by more than the messages this master exchanged with
+ *    them, as declared with Acknowledge();
+ *  - devices answering for the first time, or again after being offline;
+ *  - devices that answered FC11 with IllegalFunction: they cannot be watched and are
+ *    returned at every poll.
+ *
+ *  Exception responses, FC11 and poll commands are not counted by the slave, so the
+ *  health polls themselves never make a counter move.
+ *
+ *  A device that fails GetOfflineThreshold() polls in a row (no response, or a gateway
+ *  exception) goes offline; see GetDevice().  The polls carry GetPolicy(), retries
+ *  included.  A timeout in a pipelined batch costs every poll in flight an attempt, so
+ *  when a batch fails more than one poll, those polls are sent again one at a time: only
+ *  the devices that do not answer are charged.  A poll left unsent because the link
+ *  could not be reopened leaves its device unchanged.  A HealthMonitor is not synchronised:
+ *  call it from one thread, or through the thread that owns the Protocol.
+ */
+
+//---------------------------------------------------------------------------
+
+#ifndef ModbusHealthH
+#define ModbusHealthH
+
+#include <cstddef>
+#include <map>
+#include <optional>
+#include <vector>
+
+#include "Modbus.h"
+
+/** @brief Default number of failed polls in a row after which a device is offline. */
+#if !defined( MODBUS_HEALTH_DEFAULT_OFFLINE_THRESHOLD )
+  #define MODBUS_HEALTH_DEFAULT_OFFLINE_THRESHOLD  2
+#endif
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace Master {
+//---------------------------------------------------------------------------
+
+/** @brief Health of one device, as seen by the last polls of a HealthMonitor. */
+struct DeviceHealth {
+    Context::SlaveAddrType     SlaveAddr {};
+    bool                       Online {};          ///< Answered before the last GetOfflineThreshold() polls failed.
+    bool                       Busy {};            ///< Status word of the last answer was 0xFFFF.
+    bool                       Supported { true }; ///< @c false once the device answered FC11 with IllegalFunction.
+    std::optional<RegDataType> EventCount;         ///< Event counter of the last answer.
+    unsigned                   FailedPolls {};     ///< Polls failed in a row.
+    String                     LastError;          ///< Message of the last failed poll.
+};
+
+/** @brief Polls devices with FC11 to find the ones to scan (see file description). */
+class HealthMonitor {
+public:
+    /** @param Proto Protocol used for the polls; must outlive the monitor. */
+    explicit HealthMonitor( Protocol& Proto );
+
+    HealthMonitor( HealthMonitor const & Rhs ) = delete;
+    HealthMonitor& operator=( HealthMonitor const & Rhs ) = delete;
+
+    /** @brief Adds a device to the polls; no effect if it is there already. */
+    void AddDevice( Context::SlaveAddrType SlaveAddr );
+
+    /** @brief Removes a device; returns @c false if it was not there. */
+    bool RemoveDevice( Context::SlaveAddrType SlaveAddr );
+
+    [[ nodiscard ]] size_t GetDeviceCount() const noexcept { return devices_.size(); }
+
+    /** @brief Returns the health of a device, or @c nullptr if it is not polled. */
+    [[ nodiscard ]] DeviceHealth const * GetDevice( Context::SlaveAddrType SlaveAddr ) const;
+
+    /**
+     * @brief Polls every device once and returns, in address order, the devices whose
+     *        data should be scanned.
+     * @throws EBaseException if the protocol is not open.
+     */
+    [[ nodiscard ]] std::vector<Context::SlaveAddrType> Poll();
+
+    /**
+     * @brief Declares @p MessageCount messages completed with a device by this master
+     *        since the last Poll() (its data scan, its writes).
+     * @details The device counts them too: they are subtracted from the counter change
+     *  seen by the next poll, so they do not report the device as changed.
+     */
+    void Acknowledge( Context::SlaveAddrType SlaveAddr, unsigned MessageCount );
+
+    /** @brief Number of failed polls in a row after which a device is offline (at least 1). */
+    [[ nodiscard ]] unsigned GetOfflineThreshold() const noexcept { return offlineThreshold_; }
+    void SetOfflineThreshold( unsigned Val ) noexcept { offlineThreshold_ = Val ? Val : 1; }
+
+    /** @brief Transaction policy applied to every poll (a short timeout, typically). */
+    [[ nodiscard ]] TransactionPolicy const & GetPolicy() const noexcept { return policy_; }
+    void SetPolicy( TransactionPolicy const & Val ) { policy_ = Val; }
+private:
+    struct Device {
+        DeviceHealth Health;
+        unsigned     Acknowledged {};   ///< Messages of this master since the last poll.
+        RegDataType  Result[2] {};      ///< Status and event count of the last poll.
+    };
+
+    Protocol&                                proto_;
+    std::map<Context::SlaveAddrType,Device>  devices_;
+    unsigned                                 offlineThreshold_ { MODBUS_HEALTH_DEFAULT_OFFLINE_THRESHOLD };
+    TransactionPolicy                        policy_;
+
+    /** @brief Updates a device with the outcome of its poll; returns @c true to scan it. */
+    bool Update( Device& Item, Request const & Req );
+};
+
+//---------------------------------------------------------------------------
+}; // End of namespace Master
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
+#endif
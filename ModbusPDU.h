@@ -0,0 +1,1007 @@
+/**
+ * @file ModbusPDU.h
+ * @brief Modbus::PDU — compile-time request/response codecs, one per function code.
+ *
+ * @details The layout of every fixed-format function code is described exactly once,
+ *  by a specialisation of Modbus::PDU::Codec.  Each codec exposes:
+ *  - FnCode: the function code it describes.
+ *  - RequestLength / ResponseLength: PDU sizes in bytes, function code included.
+ *    They are constants when the PDU has a fixed size and constexpr functions of the
+ *    point count otherwise, so the transports know the frame size before any I/O.
+ *  - Encode(): writes the request PDU through an output iterator (raw pointer into a
+ *    pre-sized buffer or a back_insert_iterator).
+ *  - Decode(): validates the response PDU body (the bytes that follow the function
+ *    code) against the request and extracts its data.
+ *
+ *  The transports only add their framing (MBAP header for TCP/UDP, slave address and
+ *  CRC for RTU) and check the function code / exception response before decoding.
+ *
+ *  FC20/FC21 PDUs are lists of variable-length sub-requests: their lengths are
+ *  functions of the FileSubRequest array.
+ *
+ *  The FC43/14 (Read Device Identification) response announces no total length: only
+ *  the TCP/UDP transports, whose MBAP header carries it, implement FC43.
+ */
+
+//---------------------------------------------------------------------------
+
+#ifndef ModbusPDUH
+#define ModbusPDUH
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "Modbus.h"
+#include "ModbusDataConv.h"
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace PDU {
+//---------------------------------------------------------------------------
+
+/** @brief Maximum size of a Modbus PDU, function code included. */
+constexpr size_t MaxLength = 253;
+
+/** @brief Writes one byte and returns the advanced iterator. */
+template<typename OutputIterator>
+constexpr OutputIterator PutByte( OutputIterator Out, uint8_t Data )
+{
+    *Out++ = Data;
+    return Out;
+}
+
+/** @brief Writes a 16-bit value in Modbus (big-endian) byte order. */
+template<typename OutputIterator>
+constexpr OutputIterator PutWord( OutputIterator Out, uint16_t Data )
+{
+    *Out++ = static_cast<uint8_t>( ( Data >> 8 ) & 0xFF );   // Data Hi
+    *Out++ = static_cast<uint8_t>( Data & 0xFF );            // Data Lo
+    return Out;
+}
+
+/** @brief Reads a 16-bit value stored in Modbus (big-endian) byte order. */
+constexpr uint16_t GetWord( uint8_t const * In ) noexcept
+{
+    return static_cast<uint16_t>( ( static_cast<uint16_t>( In[0] ) << 8 ) | In[1] );
+}
+
+/** @brief Number of bytes needed to pack @p PointCount coils/inputs. */
+constexpr size_t GetBitByteCount( size_t PointCount ) noexcept
+{
+    return ( PointCount + 7 ) / 8;
+}
+
+/**
+ * @brief Primary template; only the specialisations below are defined.
+ * @tparam FC Function code described by the specialisation.
+ */
+template<FunctionCode FC>
+struct Codec;
+
+/**
+ * @brief Point count limit shared by the codecs of multi-point function codes.
+ * @tparam Max Maximum number of points allowed in a single PDU.
+ */
+template<size_t Max>
+struct PointCountLimit {
+    /** @brief Largest point count that fits in a single PDU. */
+    static constexpr size_t MaxPointCount = Max;
+
+    /** @throws EContextException if @p PointCount is 0 or larger than MaxPointCount. */
+    static void RaiseExceptionIfPointCountIsNotValid( Context const & Context,
+                                                      size_t PointCount )
+    {
+        if ( PointCount == 0 || PointCount > Max ) {
+            throw EContextException( Context, _D( "Invalid point count" ) );
+        }
+    }
+};
+
+/**
+ * @brief Raises EContextException if a reply body has not the expected length.
+ */
+inline void RaiseExceptionIfLengthIsNotEQ( Context const & Context,
+                                           size_t Length, size_t ExpectedLength )
+{
+    if ( Length != ExpectedLength ) {
+        throw EContextException( Context, _D( "Invalid reply length" ) );
+    }
+}
+
+//---------------------------------------------------------------------------
+// FC01, FC02
+//---------------------------------------------------------------------------
+
+/**
+ * @brief FC01/FC02 layout.
+ * @details Request: FC(1) + StartAddr(2) + PointCount(2).
+ *  Response: FC(1) + ByteCount(1) + packed bits (ByteCount).
+ */
+template<FunctionCode FC>
+struct ReadBitsCodec : PointCountLimit<2000> {
+    static constexpr FunctionCode FnCode = FC;
+    static constexpr size_t RequestLength = 5;
+
+    static constexpr size_t ResponseLength( size_t PointCount ) noexcept {
+        return 2 + GetBitByteCount( PointCount );
+    }
+
+    template<typename OutputIterator>
+    static OutputIterator Encode( OutputIterator Out,
+                                  CoilAddrType StartAddr, CoilCountType PointCount )
+    {
+        Out = PutByte( Out, static_cast<uint8_t>( FC ) );
+        Out = PutWord( Out, StartAddr );
+        return PutWord( Out, PointCount );
+    }
+
+    static void Decode( Context const & Context, uint8_t const * Body, size_t Length,
+                        CoilCountType PointCount, CoilDataType* Data )
+    {
+        size_t const ByteCount = GetBitByteCount( PointCount );
+        if ( Length != ByteCount + 1 || Body[0] != ByteCount ) {
+            throw EContextException( Context, _D( "Byte count mismatch" ) );
+        }
+        std::copy( Body + 1, Body + 1 + ByteCount, Data );
+    }
+};
+
+template<>
+struct Codec<FunctionCode::ReadCoilStatus>
+    : ReadBitsCodec<FunctionCode::ReadCoilStatus> {};
+
+template<>
+struct Codec<FunctionCode::ReadInputStatus>
+    : ReadBitsCodec<FunctionCode::ReadInputStatus> {};
+
+//---------------------------------------------------------------------------
+// FC03, FC04
+//---------------------------------------------------------------------------
+
+/**
+ * @brief FC03/FC04 layout.
+ * @details Request: FC(1) + StartAddr(2) + PointCount(2).
+ *  Response: FC(1) + ByteCount(1) + registers (PointCount * 2).
+ */
+template<FunctionCode FC>
+struct ReadRegistersCodec : PointCountLimit<125> {
+    static constexpr FunctionCode FnCode = FC;
+    static constexpr size_t RequestLength = 5;
+
+    static constexpr size_t ResponseLength( size_t PointCount ) noexcept {
+        return 2 + PointCount * sizeof( RegDataType );
+    }
+
+    template<typename OutputIterator>
+    static OutputIterator Encode( OutputIterator Out,
+                                  RegAddrType StartAddr, RegCountType PointCount )
+    {
+        Out = PutByte( Out, static_cast<uint8_t>( FC ) );
+        Out = PutWord( Out, StartAddr );
+        return PutWord( Out, PointCount );
+    }
+
+    static void Decode( Context const & Context, uint8_t const * Body, size_t Length,
+                        RegCountType PointCount, RegDataType* Data )
+    {
+        size_t const ByteCount = PointCount * sizeof( RegDataType );
+        if ( Length != ByteCount + 1 || Body[0] != ByteCount ) {
+            throw EContextException( Context, _D( "Byte count mismatch" ) );
+        }
+        DataConv::FromWire( Body + 1, PointCount, Data );
+    }
+};
+
+template<>
+struct Codec<FunctionCode::ReadHoldingRegisters>
+    : ReadRegistersCodec<FunctionCode::ReadHoldingRegisters> {};
+
+template<>
+struct Codec<FunctionCode::ReadInputRegisters>
+    : ReadRegistersCodec<FunctionCode::ReadInputRegisters> {};
+
+//---------------------------------------------------------------------------
+// FC05, FC06
+//---------------------------------------------------------------------------
+
+/**
+ * @brief FC05/FC06 layout.
+ * @details Request and response (echo): FC(1) + Addr(2) + Value(2).
+ */
+template<FunctionCode FC>
+struct WriteSingleCodec {
+    static constexpr FunctionCode FnCode = FC;
+    static constexpr size_t RequestLength = 5;
+    static constexpr size_t ResponseLength = 5;
+
+    template<typename OutputIterator>
+    static OutputIterator EncodeValue( OutputIterator Out, uint16_t Addr, uint16_t Value )
+    {
+        Out = PutByte( Out, static_cast<uint8_t>( FC ) );
+        Out = PutWord( Out, Addr );
+        return PutWord( Out, Value );
+    }
+
+    static void DecodeValue( Context const & Context, uint8_t const * Body, size_t Length,
+                             uint16_t Addr, uint16_t Value )
+    {
+        RaiseExceptionIfLengthIsNotEQ( Context, Length, ResponseLength - 1 );
+        if ( GetWord( Body ) != Addr ) {
+            throw EContextException( Context, _D( "Address mismatch" ) );
+        }
+        if ( GetWord( Body + 2 ) != Value ) {
+            throw EContextException( Context, _D( "Data mismatch" ) );
+        }
+    }
+};
+
+template<>
+struct Codec<FunctionCode::ForceSingleCoil>
+    : WriteSingleCodec<FunctionCode::ForceSingleCoil>
+{
+    /** @brief Wire representation of a coil state (0xFF00 = ON, 0x0000 = OFF). */
+    static constexpr uint16_t GetCoilValue( bool Value ) noexcept {
+        return Value ? 0xFF00 : 0x0000;
+    }
+
+    template<typename OutputIterator>
+    static OutputIterator Encode( OutputIterator Out, CoilAddrType Addr, bool Value )
+    {
+        return EncodeValue( Out, Addr, GetCoilValue( Value ) );
+    }
+
+    static void Decode( Context const & Context, uint8_t const * Body, size_t Length,
+                        CoilAddrType Addr, bool Value )
+    {
+        DecodeValue( Context, Body, Length, Addr, GetCoilValue( Value ) );
+    }
+};
+
+template<>
+struct Codec<FunctionCode::PresetSingleRegister>
+    : WriteSingleCodec<FunctionCode::PresetSingleRegister>
+{
+    template<typename OutputIterator>
+    static OutputIterator Encode( OutputIterator Out, RegAddrType Addr, RegDataType Data )
+    {
+        return EncodeValue( Out, Addr, Data );
+    }
+
+    static void Decode( Context const & Context, uint8_t const * Body, size_t Length,
+                        RegAddrType Addr, RegDataType Data )
+    {
+        DecodeValue( Context, Body, Length, Addr, Data );
+    }
+};
+
+//---------------------------------------------------------------------------
+// FC07
+//---------------------------------------------------------------------------
+
+/**
+ * @brief FC07 layout.
+ * @details Request: FC(1).  Response: FC(1) + ExceptionStatus(1).
+ */
+template<>
+struct Codec<FunctionCode::ReadExceptionStatus> {
+    static constexpr FunctionCode FnCode = FunctionCode::ReadExceptionStatus;
+    static constexpr size_t RequestLength = 1;
+    static constexpr size_t ResponseLength = 2;
+
+    template<typename OutputIterator>
+    static OutputIterator Encode( OutputIterator Out )
+    {
+        return PutByte( Out, static_cast<uint8_t>( FnCode ) );
+    }
+
+    static ExceptionStatusDataType Decode( Context const & Context,
+                                           uint8_t const * Body, size_t Length )
+    {
+        RaiseExceptionIfLengthIsNotEQ( Context, Length, ResponseLength - 1 );
+        return static_cast<ExceptionStatusDataType>( Body[0] );
+    }
+};
+
+//---------------------------------------------------------------------------
+// FC08
+//---------------------------------------------------------------------------
+
+/**
+ * @brief FC08 layout.
+ * @details Request and response: FC(1) + SubFunction(2) + Data(2).
+ */
+template<>
+struct Codec<FunctionCode::Diagnostics> {
+    static constexpr FunctionCode FnCode = FunctionCode::Diagnostics;
+    static constexpr size_t RequestLength = 5;
+    static constexpr size_t ResponseLength = 5;
+
+    template<typename OutputIterator>
+    static OutputIterator Encode( OutputIterator Out,
+                                  DiagSubFnType SubFunction, RegDataType Data )
+    {
+        Out = PutByte( Out, static_cast<uint8_t>( FnCode ) );
+        Out = PutWord( Out, SubFunction );
+        return PutWord( Out, Data );
+    }
+
+    static RegDataType Decode( Context const & Context, uint8_t const * Body,
+                               size_t Length, DiagSubFnType SubFunction )
+    {
+        RaiseExceptionIfLengthIsNotEQ( Context, Length, ResponseLength - 1 );
+        if ( GetWord( Body ) != SubFunction ) {
+            throw EContextException( Context, _D( "Sub-function mismatch" ) );
+        }
+        return GetWord( Body + 2 );
+    }
+};
+
+//---------------------------------------------------------------------------
+// FC11
+//---------------------------------------------------------------------------
+
+/**
+ * @brief FC11 layout.
+ * @details Request: FC(1).  Response: FC(1) + Status(2) + EventCount(2).
+ */
+template<>
+struct Codec<FunctionCode::FetchCommEventCtr> {
+    static constexpr FunctionCode FnCode = FunctionCode::FetchCommEventCtr;
+    static constexpr size_t RequestLength = 1;
+    static constexpr size_t ResponseLength = 5;
+
+    template<typename OutputIterator>
+    static OutputIterator Encode( OutputIterator Out )
+    {
+        return PutByte( Out, static_cast<uint8_t>( FnCode ) );
+    }
+
+    static CommEventCounter Decode( Context const & Context,
+                                    uint8_t const * Body, size_t Length )
+    {
+        RaiseExceptionIfLengthIsNotEQ( Context, Length, ResponseLength - 1 );
+        return { GetWord( Body ), GetWord( Body + 2 ) };
+    }
+};
+
+//---------------------------------------------------------------------------
+// FC12
+//---------------------------------------------------------------------------
+
+/**
+ * @brief FC12 layout.
+ * @details Request: FC(1).
+ *  Response: FC(1) + ByteCount(1) + Status(2) + EventCount(2) + MessageCount(2) +
+ *  events (ByteCount - 6, at most 64).
+ */
+template<>
+struct Codec<FunctionCode::FetchCommEventLog> {
+    static constexpr FunctionCode FnCode = FunctionCode::FetchCommEventLog;
+    static constexpr size_t RequestLength = 1;
+    static constexpr size_t HeaderLength = 2;
+    static constexpr size_t MaxEventCount = 64;
+
+    static constexpr size_t ResponseLength( size_t EventCount ) noexcept {
+        return HeaderLength + 6 + EventCount;
+    }
+
+    template<typename OutputIterator>
+    static OutputIterator Encode( OutputIterator Out )
+    {
+        return PutByte( Out, static_cast<uint8_t>( FnCode ) );
+    }
+
+    /**
+     * @brief Returns the event count announced by a response header.
+     * @param Body Response bytes following the function code (at least 1).
+     * @throws EContextException if the byte count is not valid.
+     */
+    static size_t DecodeHeader( Context const & Context, uint8_t const * Body )
+    {
+        if ( Body[0] < 6 || Body[0] > 6 + MaxEventCount ) {
+            throw EContextException( Context, _D( "Invalid byte count" ) );
+        }
+        return Body[0] - 6;
+    }
+
+    static CommEventLog Decode( Context const & Context, uint8_t const * Body,
+                                size_t Length )
+    {
+        if ( Length < HeaderLength - 1 ) {
+            throw EContextException( Context, _D( "Invalid reply length" ) );
+        }
+        size_t const EventCount = DecodeHeader( Context, Body );
+        RaiseExceptionIfLengthIsNotEQ( Context, Length, ResponseLength( EventCount ) - 1 );
+        CommEventLog Result;
+        Result.Status = GetWord( Body + 1 );
+        Result.EventCount = GetWord( Body + 3 );
+        Result.MessageCount = GetWord( Body + 5 );
+        Result.Events.assign( Body + 7, Body + 7 + EventCount );
+        return Result;
+    }
+};
+
+//---------------------------------------------------------------------------
+// FC15, FC16
+//---------------------------------------------------------------------------
+
+/**
+ * @brief Response layout shared by FC15/FC16: FC(1) + StartAddr(2) + PointCount(2).
+ */
+template<FunctionCode FC, size_t Max>
+struct WriteMultipleCodec : PointCountLimit<Max> {
+    static constexpr FunctionCode FnCode = FC;
+    static constexpr size_t ResponseLength = 5;
+
+    static void Decode( Context const & Context, uint8_t const * Body, size_t Length,
+                        uint16_t StartAddr, uint16_t PointCount )
+    {
+        RaiseExceptionIfLengthIsNotEQ( Context, Length, ResponseLength - 1 );
+        if ( GetWord( Body ) != StartAddr ) {
+            throw EContextException( Context, _D( "Start address mismatch" ) );
+        }
+        if ( GetWord( Body + 2 ) != PointCount ) {
+            throw EContextException( Context, _D( "Point count mismatch" ) );
+        }
+    }
+};
+
+/**
+ * @brief FC15 layout.
+ * @details Request: FC(1) + StartAddr(2) + PointCount(2) + ByteCount(1) + packed bits.
+ */
+template<>
+struct Codec<FunctionCode::ForceMultipleCoils>
+    : WriteMultipleCodec<FunctionCode::ForceMultipleCoils, 1968>
+{
+    static constexpr size_t RequestLength( size_t PointCount ) noexcept {
+        return 6 + GetBitByteCount( PointCount );
+    }
+
+    template<typename OutputIterator>
+    static OutputIterator Encode( OutputIterator Out,
+                                  CoilAddrType StartAddr, CoilCountType PointCount,
+                                  CoilDataType const * Data )
+    {
+        uint8_t const ByteCount = static_cast<uint8_t>( GetBitByteCount( PointCount ) );
+        Out = PutByte( Out, static_cast<uint8_t>( FnCode ) );
+        Out = PutWord( Out, StartAddr );
+        Out = PutWord( Out, PointCount );
+        Out = PutByte( Out, ByteCount );
+        return std::copy( Data, Data + ByteCount, Out );
+    }
+};
+
+/**
+ * @brief FC16 layout.
+ * @details Request: FC(1) + StartAddr(2) + PointCount(2) + ByteCount(1) + registers.
+ */
+template<>
+struct Codec<FunctionCode::PresetMultipleRegisters>
+    : WriteMultipleCodec<FunctionCode::PresetMultipleRegisters, 123>
+{
+    static constexpr size_t RequestLength( size_t PointCount ) noexcept {
+        return 6 + PointCount * sizeof( RegDataType );
+    }
+
+    template<typename OutputIterator>
+    static OutputIterator Encode( OutputIterator Out,
+                                  RegAddrType StartAddr, RegCountType PointCount,
+                                  RegDataType const * Data )
+    {
+        Out = PutByte( Out, static_cast<uint8_t>( FnCode ) );
+        Out = PutWord( Out, StartAddr );
+        Out = PutWord( Out, PointCount );
+        Out = PutByte( Out, static_cast<uint8_t>( PointCount * sizeof( RegDataType ) ) );
+        while ( PointCount-- ) {
+            Out = PutWord( Out, *Data++ );
+        }
+        return Out;
+    }
+};
+
+//---------------------------------------------------------------------------
+// FC17
+//---------------------------------------------------------------------------
+
+/**
+ * @brief FC17 layout.
+ * @details Request: FC(1).  Response: FC(1) + ByteCount(1) + data (ByteCount): slave
+ *  ID, run indicator status and additional data, all device specific in length.
+ */
+template<>
+struct Codec<FunctionCode::ReportSlave> {
+    static constexpr FunctionCode FnCode = FunctionCode::ReportSlave;
+    static constexpr size_t RequestLength = 1;
+    static constexpr size_t HeaderLength = 2;
+    static constexpr size_t MaxByteCount = MaxLength - HeaderLength;
+
+    static constexpr size_t ResponseLength( size_t ByteCount ) noexcept {
+        return HeaderLength + ByteCount;
+    }
+
+    template<typename OutputIterator>
+    static OutputIterator Encode( OutputIterator Out )
+    {
+        return PutByte( Out, static_cast<uint8_t>( FnCode ) );
+    }
+
+    /**
+     * @brief Returns the byte count announced by a response header.
+     * @param Body Response bytes following the function code (at least 1).
+     * @throws EContextException if the byte count is not valid.
+     */
+    static size_t DecodeHeader( Context const & Context, uint8_t const * Body )
+    {
+        if ( !Body[0] || Body[0] > MaxByteCount ) {
+            throw EContextException( Context, _D( "Invalid byte count" ) );
+        }
+        return Body[0];
+    }
+
+    static std::vector<uint8_t> Decode( Context const & Context, uint8_t const * Body,
+                                        size_t Length )
+    {
+        if ( Length < HeaderLength - 1 ) {
+            throw EContextException( Context, _D( "Invalid reply length" ) );
+        }
+        size_t const ByteCount = DecodeHeader( Context, Body );
+        RaiseExceptionIfLengthIsNotEQ( Context, Length, ResponseLength( ByteCount ) - 1 );
+        return std::vector<uint8_t>( Body + 1, Body + 1 + ByteCount );
+    }
+};
+
+//---------------------------------------------------------------------------
+// FC20, FC21
+//---------------------------------------------------------------------------
+
+/**
+ * @brief Sub-request layout shared by FC20 and FC21.
+ * @details Sub-request: RefType(1) + FileNumber(2) + RecordNumber(2) + RecordLength(2),
+ *  followed by the record data for FC21.  Sub-response: Length(1) + RefType(1) + data.
+ */
+struct FileRecordCodec {
+    static constexpr uint8_t ReferenceType = 0x06;
+    static constexpr size_t SubRequestLength = 7;
+    static constexpr size_t SubResponseHeaderLength = 2;
+    static constexpr RecordNumberType MaxRecordNumber = 0x270F;
+
+    /** @brief Total number of registers carried by the sub-requests. */
+    static size_t GetRegisterCount( FileSubRequest const * SubRequests,
+                                    size_t SubReqCount ) noexcept
+    {
+        size_t Count = 0;
+        for ( size_t Idx = 0 ; Idx < SubReqCount ; ++Idx ) {
+            Count += SubRequests[Idx].RecordLength;
+        }
+        return Count;
+    }
+
+    template<typename OutputIterator>
+    static OutputIterator PutSubRequest( OutputIterator Out, FileSubRequest const & Sub )
+    {
+        Out = PutByte( Out, ReferenceType );
+        Out = PutWord( Out, Sub.FileNumber );
+        Out = PutWord( Out, Sub.RecordNumber );
+        return PutWord( Out, Sub.RecordLength );
+    }
+};
+
+/**
+ * @brief FC20 layout.
+ * @details Request: FC(1) + ByteCount(1) + sub-requests (7 bytes each).
+ *  Response: FC(1) + RespDataLength(1) + sub-responses (2 + RecordLength * 2 bytes each).
+ */
+template<>
+struct Codec<FunctionCode::ReadGeneralReference> : FileRecordCodec {
+    static constexpr FunctionCode FnCode = FunctionCode::ReadGeneralReference;
+
+    static constexpr size_t RequestLength( size_t SubReqCount ) noexcept {
+        return 2 + SubReqCount * SubRequestLength;
+    }
+
+    static size_t ResponseLength( FileSubRequest const * SubRequests,
+                                  size_t SubReqCount ) noexcept
+    {
+        return 2 + SubReqCount * SubResponseHeaderLength +
+               GetRegisterCount( SubRequests, SubReqCount ) * sizeof( RegDataType );
+    }
+
+    /** @throws EContextException if there is no sub-request or either PDU is too long. */
+    static void RaiseExceptionIfSubRequestsAreNotValid( Context const & Context,
+                                                        FileSubRequest const * SubRequests,
+                                                        size_t SubReqCount )
+    {
+        if ( !SubReqCount || RequestLength( SubReqCount ) > MaxLength ||
+             ResponseLength( SubRequests, SubReqCount ) > MaxLength ) {
+            throw EContextException( Context, _D( "Invalid sub-request count or length" ) );
+        }
+    }
+
+    template<typename OutputIterator>
+    static OutputIterator Encode( OutputIterator Out, FileSubRequest const * SubRequests,
+                                  size_t SubReqCount )
+    {
+        Out = PutByte( Out, static_cast<uint8_t>( FnCode ) );
+        Out = PutByte( Out, static_cast<uint8_t>( SubReqCount * SubRequestLength ) );
+        for ( size_t Idx = 0 ; Idx < SubReqCount ; ++Idx ) {
+            Out = PutSubRequest( Out, SubRequests[Idx] );
+        }
+        return Out;
+    }
+
+    static void Decode( Context const & Context, uint8_t const * Body, size_t Length,
+                        FileSubRequest const * SubRequests, size_t SubReqCount,
+                        RegDataType* Data )
+    {
+        if ( Length < 1 ) {
+            throw EContextException( Context, _D( "Invalid reply length" ) );
+        }
+        size_t Offset = 1;   // skip RespDataLength
+        for ( size_t Idx = 0 ; Idx < SubReqCount ; ++Idx ) {
+            if ( Offset + SubResponseHeaderLength > Length ) {
+                throw EContextException( Context, _D( "Truncated response" ) );
+            }
+            size_t const SubLength = Body[Offset++];
+            if ( Body[Offset++] != ReferenceType ) {
+                throw EContextException( Context, _D( "Invalid reference type" ) );
+            }
+            size_t const RecordLength = SubRequests[Idx].RecordLength;
+            if ( SubLength != 1 + RecordLength * sizeof( RegDataType ) ) {
+                throw EContextException( Context, _D( "Sub-response length mismatch" ) );
+            }
+            if ( Offset + RecordLength * sizeof( RegDataType ) > Length ) {
+                throw EContextException( Context, _D( "Truncated response" ) );
+            }
+            DataConv::FromWire( Body + Offset, RecordLength, Data );
+            Data += RecordLength;
+            Offset += RecordLength * sizeof( RegDataType );
+        }
+    }
+};
+
+/**
+ * @brief FC21 layout.
+ * @details Request and response (echo): FC(1) + ByteCount(1) + sub-requests, each
+ *  followed by its RecordLength registers.
+ */
+template<>
+struct Codec<FunctionCode::WriteGeneralReference> : FileRecordCodec {
+    static constexpr FunctionCode FnCode = FunctionCode::WriteGeneralReference;
+
+    static size_t RequestLength( FileSubRequest const * SubRequests,
+                                 size_t SubReqCount ) noexcept
+    {
+        return 2 + SubReqCount * SubRequestLength +
+               GetRegisterCount( SubRequests, SubReqCount ) * sizeof( RegDataType );
+    }
+
+    static size_t ResponseLength( FileSubRequest const * SubRequests,
+                                  size_t SubReqCount ) noexcept
+    {
+        return RequestLength( SubRequests, SubReqCount );
+    }
+
+    /** @throws EContextException if there is no sub-request or the PDU is too long. */
+    static void RaiseExceptionIfSubRequestsAreNotValid( Context const & Context,
+                                                        FileSubRequest const * SubRequests,
+                                                        size_t SubReqCount )
+    {
+        if ( !SubReqCount || RequestLength( SubRequests, SubReqCount ) > MaxLength ) {
+            throw EContextException( Context, _D( "Invalid sub-request count or length" ) );
+        }
+    }
+
+    template<typename OutputIterator>
+    static OutputIterator Encode( OutputIterator Out, FileSubRequest const * SubRequests,
+                                  size_t SubReqCount, RegDataType const * Data )
+    {
+        Out = PutByte( Out, static_cast<uint8_t>( FnCode ) );
+        Out = PutByte(
+            Out, static_cast<uint8_t>( RequestLength( SubRequests, SubReqCount ) - 2 )
+        );
+        for ( size_t Idx = 0 ; Idx < SubReqCount ; ++Idx ) {
+            Out = PutSubRequest( Out, SubRequests[Idx] );
+            for ( RecordLengthType Rec = 0 ; Rec < SubRequests[Idx].RecordLength ; ++Rec ) {
+                Out = PutWord( Out, *Data++ );
+            }
+        }
+        return Out;
+    }
+
+    static void Decode( Context const & Context, uint8_t const * Body, size_t Length,
+                        FileSubRequest const * SubRequests, size_t SubReqCount,
+                        RegDataType const * Data )
+    {
+        RaiseExceptionIfLengthIsNotEQ(
+            Context, Length, ResponseLength( SubRequests, SubReqCount ) - 1
+        );
+        std::vector<uint8_t> Request;
+        Request.reserve( RequestLength( SubRequests, SubReqCount ) );
+        Encode( std::back_inserter( Request ), SubRequests, SubReqCount, Data );
+        if ( !std::equal( Request.begin() + 1, Request.end(), Body ) ) {
+            throw EContextException( Context, _D( "Response does not echo the request" ) );
+        }
+    }
+};
+
+//---------------------------------------------------------------------------
+// FC22
+//---------------------------------------------------------------------------
+
+/**
+ * @brief FC22 layout.
+ * @details Request and response (echo): FC(1) + Addr(2) + AndMask(2) + OrMask(2).
+ */
+template<>
+struct Codec<FunctionCode::MaskWrite4XRegister> {
+    static constexpr FunctionCode FnCode = FunctionCode::MaskWrite4XRegister;
+    static constexpr size_t RequestLength = 7;
+    static constexpr size_t ResponseLength = 7;
+
+    template<typename OutputIterator>
+    static OutputIterator Encode( OutputIterator Out, RegAddrType Addr,
+                                  RegDataType AndMask, RegDataType OrMask )
+    {
+        Out = PutByte( Out, static_cast<uint8_t>( FnCode ) );
+        Out = PutWord( Out, Addr );
+        Out = PutWord( Out, AndMask );
+        return PutWord( Out, OrMask );
+    }
+
+    static void Decode( Context const & Context, uint8_t const * Body, size_t Length,
+                        RegAddrType Addr, RegDataType AndMask, RegDataType OrMask )
+    {
+        RaiseExceptionIfLengthIsNotEQ( Context, Length, ResponseLength - 1 );
+        if ( GetWord( Body ) != Addr ) {
+            throw EContextException( Context, _D( "Address mismatch" ) );
+        }
+        if ( GetWord( Body + 2 ) != AndMask ) {
+            throw EContextException( Context, _D( "And Mask mismatch" ) );
+        }
+        if ( GetWord( Body + 4 ) != OrMask ) {
+            throw EContextException( Context, _D( "Or Mask mismatch" ) );
+        }
+    }
+};
+
+//---------------------------------------------------------------------------
+// FC23
+//---------------------------------------------------------------------------
+
+/**
+ * @brief FC23 layout.
+ * @details Request: FC(1) + ReadAddr(2) + ReadCount(2) + WriteAddr(2) + WriteCount(2)
+ *  + WriteByteCount(1) + write registers.
+ *  Response: FC(1) + ByteCount(1) + read registers.
+ */
+template<>
+struct Codec<FunctionCode::ReadWrite4XRegisters> {
+    static constexpr FunctionCode FnCode = FunctionCode::ReadWrite4XRegisters;
+    static constexpr size_t MaxReadPointCount = 125;
+    static constexpr size_t MaxWritePointCount = 121;
+
+    static constexpr size_t RequestLength( size_t WritePointCount ) noexcept {
+        return 10 + WritePointCount * sizeof( RegDataType );
+    }
+
+    static constexpr size_t ResponseLength( size_t ReadPointCount ) noexcept {
+        return 2 + ReadPointCount * sizeof( RegDataType );
+    }
+
+    /** @throws EContextException if either point count is out of range. */
+    static void RaiseExceptionIfPointCountIsNotValid( Context const & Context,
+                                                      size_t ReadPointCount,
+                                                      size_t WritePointCount )
+    {
+        PointCountLimit<MaxReadPointCount>::RaiseExceptionIfPointCountIsNotValid(
+            Context, ReadPointCount
+        );
+        PointCountLimit<MaxWritePointCount>::RaiseExceptionIfPointCountIsNotValid(
+            Context, WritePointCount
+        );
+    }
+
+    template<typename OutputIterator>
+    static OutputIterator Encode( OutputIterator Out,
+                                  RegAddrType ReadStartAddr, RegCountType ReadPointCount,
+                                  RegAddrType WriteStartAddr, RegCountType WritePointCount,
+                                  RegDataType const * WriteData )
+    {
+        Out = PutByte( Out, static_cast<uint8_t>( FnCode ) );
+        Out = PutWord( Out, ReadStartAddr );
+        Out = PutWord( Out, ReadPointCount );
+        Out = PutWord( Out, WriteStartAddr );
+        Out = PutWord( Out, WritePointCount );
+        Out = PutByte( Out, static_cast<uint8_t>( WritePointCount * sizeof( RegDataType ) ) );
+        while ( WritePointCount-- ) {
+            Out = PutWord( Out, *WriteData++ );
+        }
+        return Out;
+    }
+
+    static void Decode( Context const & Context, uint8_t const * Body, size_t Length,
+                        RegCountType ReadPointCount, RegDataType* ReadData )
+    {
+        ReadRegistersCodec<FnCode>::Decode( Context, Body, Length, ReadPointCount, ReadData );
+    }
+};
+
+//---------------------------------------------------------------------------
+// FC24
+//---------------------------------------------------------------------------
+
+/**
+ * @brief FC24 layout.
+ * @details Request: FC(1) + FIFOAddr(2).
+ *  Response: FC(1) + ByteCount(2) + FIFOCount(2) + values (FIFOCount * 2).
+ *  The response size is only known once HeaderLength bytes have been received.
+ */
+template<>
+struct Codec<FunctionCode::ReadFIFOQueue> {
+    static constexpr FunctionCode FnCode = FunctionCode::ReadFIFOQueue;
+    static constexpr size_t RequestLength = 3;
+    static constexpr size_t HeaderLength = 5;
+    static constexpr size_t MaxFIFOCount = 31;
+
+    static constexpr size_t ResponseLength( size_t FIFOCount ) noexcept {
+        return HeaderLength + FIFOCount * sizeof( RegDataType );
+    }
+
+    template<typename OutputIterator>
+    static OutputIterator Encode( OutputIterator Out, FIFOAddrType FIFOAddr )
+    {
+        Out = PutByte( Out, static_cast<uint8_t>( FnCode ) );
+        return PutWord( Out, FIFOAddr );
+    }
+
+    /**
+     * @brief Returns the FIFO count announced by a response header.
+     * @param Body Response bytes following the function code (at least 4).
+     * @throws EContextException if the count or the byte count is not valid.
+     */
+    static FIFOCountType DecodeHeader( Context const & Context, uint8_t const * Body )
+    {
+        uint16_t const ByteCount = GetWord( Body );
+        uint16_t const FIFOCount = GetWord( Body + 2 );
+        if ( FIFOCount > MaxFIFOCount ) {
+            throw EContextException( Context, _D( "FIFO count exceeds maximum (31)" ) );
+        }
+        if ( ByteCount != 2 + FIFOCount * sizeof( RegDataType ) ) {
+            throw EContextException( Context, _D( "Byte count mismatch" ) );
+        }
+        return static_cast<FIFOCountType>( FIFOCount );
+    }
+
+    static FIFOCountType Decode( Context const & Context, uint8_t const * Body,
+                                 size_t Length, RegDataType* Data )
+    {
+        if ( Length < HeaderLength - 1 ) {
+            throw EContextException( Context, _D( "Invalid reply length" ) );
+        }
+        FIFOCountType const FIFOCount = DecodeHeader( Context, Body );
+        RaiseExceptionIfLengthIsNotEQ( Context, Length, ResponseLength( FIFOCount ) - 1 );
+        DataConv::FromWire( Body + 4, FIFOCount, Data );
+        return FIFOCount;
+    }
+};
+
+//---------------------------------------------------------------------------
+// FC43
+//---------------------------------------------------------------------------
+
+/**
+ * @brief FC43 layout; only MEI type 14 (Read Device Identification) is described.
+ * @details Request: FC(1) + MEIType(1) + ReadDevIdCode(1) + ObjectId(1).
+ *  Response: FC(1) + MEIType(1) + ReadDevIdCode(1) + ConformityLevel(1) + MoreFollows(1)
+ *  + NextObjectId(1) + NumberOfObjects(1) + objects, each ObjectId(1) + Length(1) + value.
+ *  The response length is only known once every object header has been read: the
+ *  framings without a length field (RTU, ASCII) read it in stages (ResponseLength()).
+ */
+template<>
+struct Codec<FunctionCode::EncapsulatedInterfaceTransport> {
+    static constexpr FunctionCode FnCode = FunctionCode::EncapsulatedInterfaceTransport;
+    static constexpr uint8_t MEIType = 0x0E;
+    static constexpr size_t RequestLength = 4;
+    static constexpr size_t HeaderLength = 7;
+
+    template<typename OutputIterator>
+    static OutputIterator Encode( OutputIterator Out, ReadDeviceIdCode Code,
+                                  DeviceObjectIdType ObjectId )
+    {
+        Out = PutByte( Out, static_cast<uint8_t>( FnCode ) );
+        Out = PutByte( Out, MEIType );
+        Out = PutByte( Out, static_cast<uint8_t>( Code ) );
+        return PutByte( Out, ObjectId );
+    }
+
+    /**
+     * @brief Length of the response PDU (function code included) as far as the first
+     *        @p Length bytes of its body tell: the header and every object whose header
+     *        is among them.
+     * @details A serial framing reads this many bytes and its trailer, then calls again
+     *  with the bytes read in place of the trailer, until the length stops growing.
+     */
+    static size_t ResponseLength( uint8_t const * Body, size_t Length ) noexcept
+    {
+        size_t Offset = HeaderLength - 1;
+        if ( Length < Offset ) {
+            return HeaderLength;
+        }
+        size_t const ObjectCount = Body[5];
+        for ( size_t Idx = 0 ; Idx < ObjectCount && Offset + 2 <= Length ; ++Idx ) {
+            Offset += 2 + Body[Offset + 1];
+        }
+        return 1 + Offset;
+    }
+
+    /**
+     * @brief Adds the objects of a response to @p Result.
+     * @return The next object id if the device announced that more objects follow.
+     * @throws EContextException if the response is malformed, or if the next object id
+     *  does not follow @p ObjectId.
+     */
+    static std::optional<DeviceObjectIdType> Decode( Context const & Context,
+                                                     uint8_t const * Body, size_t Length,
+                                                     ReadDeviceIdCode Code,
+                                                     DeviceObjectIdType ObjectId,
+                                                     DeviceIdentification& Result )
+    {
+        if ( Length < HeaderLength - 1 ) {
+            throw EContextException( Context, _D( "Invalid reply length" ) );
+        }
+        if ( Body[0] != MEIType || Body[1] != static_cast<uint8_t>( Code ) ) {
+            throw EContextException( Context, _D( "MEI type or Read Device ID code mismatch" ) );
+        }
+        Result.ConformityLevel = Body[2];
+        bool const MoreFollows = Body[3] != 0;
+        DeviceObjectIdType const NextObjectId = Body[4];
+        size_t const ObjectCount = Body[5];
+
+        size_t Offset = HeaderLength - 1;
+        for ( size_t Idx = 0 ; Idx < ObjectCount ; ++Idx ) {
+            if ( Offset + 2 > Length || Offset + 2 + Body[Offset + 1] > Length ) {
+                throw EContextException( Context, _D( "Truncated response" ) );
+            }
+            DeviceObjectIdType const Id = Body[Offset];
+            size_t const ValueLength = Body[Offset + 1];
+            Result.Objects[Id].assign(
+                reinterpret_cast<char const *>( Body + Offset + 2 ), ValueLength
+            );
+            Offset += 2 + ValueLength;
+        }
+        RaiseExceptionIfLengthIsNotEQ( Context, Length, Offset );
+
+        if ( !MoreFollows ) {
+            return std::nullopt;
+        }
+        if ( NextObjectId <= ObjectId ) {
+            throw EContextException( Context, _D( "Invalid next object id" ) );
+        }
+        return NextObjectId;
+    }
+};
+
+//---------------------------------------------------------------------------
+
+static_assert( Codec<FunctionCode::ReadCoilStatus>::ResponseLength( 2000 ) <= MaxLength );
+static_assert( Codec<FunctionCode::ReadHoldingRegisters>::ResponseLength( 125 ) <= MaxLength );
+static_assert( Codec<FunctionCode::ForceMultipleCoils>::RequestLength( 1968 ) <= MaxLength );
+static_assert( Codec<FunctionCode::PresetMultipleRegisters>::RequestLength( 123 ) <= MaxLength );
+static_assert( Codec<FunctionCode::ReadGeneralReference>::RequestLength( 35 ) <= MaxLength );
+static_assert( Codec<FunctionCode::ReadWrite4XRegisters>::RequestLength( 121 ) <= MaxLength );
+static_assert( Codec<FunctionCode::ReadFIFOQueue>::ResponseLength( 31 ) <= MaxLength );
+static_assert( Codec<FunctionCode::FetchCommEventLog>::ResponseLength( 64 ) <= MaxLength );
+
+//---------------------------------------------------------------------------
+}; // End of namespace PDU
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
+#endif
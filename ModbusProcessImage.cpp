@@ -0,0 +1,421 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+#include "ModbusProcessImage.h"
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace Master {
+//---------------------------------------------------------------------------
+
+namespace {
+
+constexpr uint32_t ImageMagic = 0x4950424DU;   // "MBPI"
+constexpr uint32_t ImageVersion = 1;
+
+struct ImageHeader {
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t BlockCount;
+    uint32_t Reserved;
+    uint64_t Size;          ///< Size of the whole section.
+};
+
+struct ImageBlock {
+    std::atomic<uint32_t> Sequence;   ///< Odd while the block is being written.
+    uint32_t              Valid;
+    int64_t               UpdateTime; ///< Milliseconds since the Unix epoch.
+    uint32_t              DataOffset; ///< From the start of the section.
+    uint16_t              Addr;
+    uint16_t              PointCount;
+    uint8_t               SlaveAddr;
+    uint8_t               FnCode;
+    uint8_t               Reserved[6];
+};
+
+static_assert( std::atomic<uint32_t>::is_always_lock_free,
+               "Process image sequences must be address-free atomics" );
+static_assert( sizeof( ImageHeader ) % 8 == 0 && sizeof( ImageBlock ) % 8 == 0,
+               "Process image descriptors must keep 8-byte alignment" );
+
+size_t Align8( size_t Val ) noexcept
+{
+    return ( Val + 7 ) & ~size_t( 7 );
+}
+
+ImageBlock* GetImageBlocks( uint8_t* View ) noexcept
+{
+    return reinterpret_cast<ImageBlock*>( View + sizeof( ImageHeader ) );
+}
+
+ImageBlock const * GetImageBlocks( uint8_t const * View ) noexcept
+{
+    return reinterpret_cast<ImageBlock const *>( View + sizeof( ImageHeader ) );
+}
+
+[[ noreturn ]] void RaiseImageError( String const & Text, String const & Name )
+{
+    throw EBaseException(
+        Format(
+            _D( "%s \"%s\": %s" )
+          , ARRAYOFCONST( ( Text, Name, SysErrorMessage( ::GetLastError() ) ) )
+        )
+    );
+}
+
+} // End of anonymous namespace
+
+//---------------------------------------------------------------------------
+
+bool ProcessImageBlock::IsBits() const noexcept
+{
+    return FnCode == FunctionCode::ReadCoilStatus ||
+           FnCode == FunctionCode::ReadInputStatus;
+}
+//---------------------------------------------------------------------------
+
+size_t ProcessImageBlock::GetDataSize() const noexcept
+{
+    return IsBits() ?
+             ( PointCount + 7U ) / 8U * sizeof( CoilDataType )
+           :
+             PointCount * sizeof( RegDataType );
+}
+//---------------------------------------------------------------------------
+
+ProcessImageWriter::ProcessImageWriter( String Name, std::vector<ProcessImageBlock> Blocks )
+  : name_( Name ), blocks_( std::move( Blocks ) )
+{
+    size_t Size = sizeof( ImageHeader ) + blocks_.size() * sizeof( ImageBlock );
+    for ( auto const & Block : blocks_ ) {
+        if ( !Block.PointCount ||
+             ( !Block.IsBits() &&
+               Block.FnCode != FunctionCode::ReadHoldingRegisters &&
+               Block.FnCode != FunctionCode::ReadInputRegisters ) ) {
+            throw EBaseException(
+                Format(
+                    _D( "Invalid process image block: unit %u, function %u, %u point(s)" )
+                  , ARRAYOFCONST( (
+                        static_cast<unsigned>( Block.SlaveAddr ),
+                        static_cast<unsigned>( Block.FnCode ),
+                        static_cast<unsigned>( Block.PointCount )
+                    ) )
+                )
+            );
+        }
+        Size += Align8( Block.GetDataSize() );
+    }
+
+    mapping_ = ::CreateFileMapping(
+        INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+        static_cast<DWORD>( static_cast<uint64_t>( Size ) >> 32 ),
+        static_cast<DWORD>( Size ), name_.c_str()
+    );
+    if ( !mapping_ ) {
+        RaiseImageError( _D( "Unable to create process image" ), name_ );
+    }
+    // Readers keep the section of a writer that stopped: it may be smaller than this
+    // layout, so map all of it
+    bool const Exists = ::GetLastError() == ERROR_ALREADY_EXISTS;
+    view_ = static_cast<uint8_t*>(
+        ::MapViewOfFile( mapping_, FILE_MAP_WRITE, 0, 0, Exists ? 0 : Size )
+    );
+    if ( !view_ ) {
+        ::CloseHandle( mapping_ );
+        RaiseImageError( _D( "Unable to map process image" ), name_ );
+    }
+
+    if ( Exists ) {
+        Reopen( Size );
+    }
+    else {
+        Initialize( Size );
+    }
+}
+//---------------------------------------------------------------------------
+
+void ProcessImageWriter::Initialize( size_t Size )
+{
+    // The section comes zeroed; readers check the magic, written last
+    ImageBlock* Entries = GetImageBlocks( view_ );
+    size_t Offset = sizeof( ImageHeader ) + blocks_.size() * sizeof( ImageBlock );
+    for ( size_t Idx = 0 ; Idx < blocks_.size() ; ++Idx ) {
+        ProcessImageBlock const & Block = blocks_[Idx];
+        ImageBlock& Entry = Entries[Idx];
+        Entry.DataOffset = static_cast<uint32_t>( Offset );
+        Entry.Addr = Block.Addr;
+        Entry.PointCount = Block.PointCount;
+        Entry.SlaveAddr = Block.SlaveAddr;
+        Entry.FnCode = static_cast<uint8_t>( Block.FnCode );
+        Offset += Align8( Block.GetDataSize() );
+    }
+    ImageHeader& Header = *reinterpret_cast<ImageHeader*>( view_ );
+    Header.Version = ImageVersion;
+    Header.BlockCount = static_cast<uint32_t>( blocks_.size() );
+    Header.Size = Size;
+    std::atomic_thread_fence( std::memory_order_release );
+    Header.Magic = ImageMagic;
+}
+//---------------------------------------------------------------------------
+
+void ProcessImageWriter::Reopen( size_t Size )
+{
+    ImageHeader const & Header = *reinterpret_cast<ImageHeader const *>( view_ );
+    bool Match = Header.Magic == ImageMagic;
+    std::atomic_thread_fence( std::memory_order_acquire );
+    Match = Match && Header.Version == ImageVersion && Header.Size == Size &&
+            Header.BlockCount == blocks_.size();
+
+    ImageBlock* Entries = GetImageBlocks( view_ );
+    size_t Offset = sizeof( ImageHeader ) + blocks_.size() * sizeof( ImageBlock );
+    for ( size_t Idx = 0 ; Match && Idx < blocks_.size() ; ++Idx ) {
+        ProcessImageBlock const & Block = blocks_[Idx];
+        ImageBlock const & Entry = Entries[Idx];
+        Match = Entry.DataOffset == Offset && Entry.Addr == Block.Addr &&
+                Entry.PointCount == Block.PointCount && Entry.SlaveAddr == Block.SlaveAddr &&
+                Entry.FnCode == static_cast<uint8_t>( Block.FnCode );
+        Offset += Align8( Block.GetDataSize() );
+    }
+    if ( !Match ) {
+        ::UnmapViewOfFile( view_ );
+        ::CloseHandle( mapping_ );
+        throw EBaseException(
+            Format(
+                _D( "Process image \"%s\" already exists with another layout" )
+              , ARRAYOFCONST( ( name_ ) )
+            )
+        );
+    }
+
+    // Take over the blocks and their sequences; a block the previous writer left in
+    // the middle of an update may be torn
+    for ( size_t Idx = 0 ; Idx < blocks_.size() ; ++Idx ) {
+        ImageBlock& Entry = Entries[Idx];
+        uint32_t const Sequence = Entry.Sequence.load( std::memory_order_relaxed );
+        if ( Sequence & 1U ) {
+            Entry.Valid = false;
+            Entry.Sequence.store( Sequence + 1, std::memory_order_release );
+        }
+    }
+}
+//---------------------------------------------------------------------------
+
+ProcessImageWriter::~ProcessImageWriter()
+{
+    ::UnmapViewOfFile( view_ );
+    ::CloseHandle( mapping_ );
+}
+//---------------------------------------------------------------------------
+
+void ProcessImageWriter::Update( size_t Idx, void const * Data, bool Valid )
+{
+    ProcessImageBlock const & Block = blocks_.at( Idx );
+    ImageBlock& Entry = GetImageBlocks( view_ )[Idx];
+
+    uint32_t const Sequence = Entry.Sequence.load( std::memory_order_relaxed );
+    Entry.Sequence.store( Sequence + 1, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_release );
+
+    if ( Data ) {
+        std::memcpy( view_ + Entry.DataOffset, Data, Block.GetDataSize() );
+    }
+    Entry.Valid = Valid;
+    Entry.UpdateTime =
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()
+        ).count();
+
+    Entry.Sequence.store( Sequence + 2, std::memory_order_release );
+}
+//---------------------------------------------------------------------------
+
+void ProcessImageWriter::Write( size_t Idx, RegDataType const * Data )
+{
+    if ( blocks_.at( Idx ).IsBits() ) {
+        throw EBaseException( _D( "Process image block holds bits, not registers" ) );
+    }
+    Update( Idx, Data, true );
+}
+//---------------------------------------------------------------------------
+
+void ProcessImageWriter::Write( size_t Idx, CoilDataType const * Data )
+{
+    if ( !blocks_.at( Idx ).IsBits() ) {
+        throw EBaseException( _D( "Process image block holds registers, not bits" ) );
+    }
+    Update( Idx, Data, true );
+}
+//---------------------------------------------------------------------------
+
+void ProcessImageWriter::Invalidate( size_t Idx )
+{
+    Update( Idx, nullptr, false );
+}
+//---------------------------------------------------------------------------
+
+void ProcessImageWriter::Publish( Request const * Requests, size_t Count )
+{
+    if ( Count != blocks_.size() ) {
+        throw EBaseException(
+            Format(
+                _D( "Process image has %u block(s), %u request(s) given" )
+              , ARRAYOFCONST( (
+                    static_cast<unsigned>( blocks_.size() ),
+                    static_cast<unsigned>( Count )
+                ) )
+            )
+        );
+    }
+    for ( size_t Idx = 0 ; Idx < Count ; ++Idx ) {
+        Request const & Req = Requests[Idx];
+        if ( Req.FnCode != blocks_[Idx].FnCode ||
+             Req.PointCount != blocks_[Idx].PointCount ) {
+            throw EBaseException(
+                Format(
+                    _D( "Request %u does not match process image block %u" )
+                  , ARRAYOFCONST( (
+                        static_cast<unsigned>( Idx ), static_cast<unsigned>( Idx )
+                    ) )
+                )
+            );
+        }
+    }
+    for ( size_t Idx = 0 ; Idx < Count ; ++Idx ) {
+        Request const & Req = Requests[Idx];
+        if ( Req.Status == RequestStatus::Completed ) {
+            Update(
+                Idx,
+                blocks_[Idx].IsBits() ?
+                  static_cast<void const *>( Req.CoilData )
+                :
+                  static_cast<void const *>( Req.RegData ),
+                true
+            );
+        }
+        else {
+            Invalidate( Idx );
+        }
+    }
+}
+//---------------------------------------------------------------------------
+
+ProcessImageReader::ProcessImageReader( String Name )
+  : name_( Name )
+{
+    mapping_ = ::OpenFileMapping( FILE_MAP_READ, FALSE, name_.c_str() );
+    if ( !mapping_ ) {
+        RaiseImageError( _D( "Unable to open process image" ), name_ );
+    }
+    // The whole section: its size is only known from the header
+    view_ = static_cast<uint8_t const *>( ::MapViewOfFile( mapping_, FILE_MAP_READ, 0, 0, 0 ) );
+    if ( !view_ ) {
+        ::CloseHandle( mapping_ );
+        RaiseImageError( _D( "Unable to map process image" ), name_ );
+    }
+
+    ImageHeader const & Header = *reinterpret_cast<ImageHeader const *>( view_ );
+    bool const Valid = Header.Magic == ImageMagic;
+    std::atomic_thread_fence( std::memory_order_acquire );
+    if ( !Valid || Header.Version != ImageVersion ) {
+        ::UnmapViewOfFile( view_ );
+        ::CloseHandle( mapping_ );
+        throw EBaseException(
+            Format(
+                _D( "\"%s\" is not a process image of version %u" )
+              , ARRAYOFCONST( ( name_, static_cast<unsigned>( ImageVersion ) ) )
+            )
+        );
+    }
+
+    // The descriptors do not change after the writer published the header
+    ImageBlock const * Entries = GetImageBlocks( view_ );
+    blocks_.reserve( Header.BlockCount );
+    for ( uint32_t Idx = 0 ; Idx < Header.BlockCount ; ++Idx ) {
+        ProcessImageBlock Block;
+        Block.SlaveAddr = Entries[Idx].SlaveAddr;
+        Block.FnCode = static_cast<FunctionCode>( Entries[Idx].FnCode );
+        Block.Addr = Entries[Idx].Addr;
+        Block.PointCount = Entries[Idx].PointCount;
+        blocks_.push_back( Block );
+    }
+}
+//---------------------------------------------------------------------------
+
+ProcessImageReader::~ProcessImageReader()
+{
+    ::UnmapViewOfFile( view_ );
+    ::CloseHandle( mapping_ );
+}
+//---------------------------------------------------------------------------
+
+uint32_t ProcessImageReader::GetSequence( size_t Idx ) const
+{
+    if ( Idx >= blocks_.size() ) {
+        throw std::out_of_range( "Process image block index out of range" );
+    }
+    return GetImageBlocks( view_ )[Idx].Sequence.load( std::memory_order_acquire );
+}
+//---------------------------------------------------------------------------
+
+bool ProcessImageReader::Snapshot( size_t Idx, void* Data, ProcessImageBlockState& State ) const
+{
+    size_t const Size = blocks_[Idx].GetDataSize();
+    ImageBlock const & Entry = GetImageBlocks( view_ )[Idx];
+
+    for ( unsigned Attempt = 0 ; Attempt < readRetries_ ; ++Attempt ) {
+        uint32_t const Before = Entry.Sequence.load( std::memory_order_acquire );
+        if ( Before & 1U ) {
+            std::this_thread::yield();
+            continue;
+        }
+        std::memcpy( Data, view_ + Entry.DataOffset, Size );
+        bool const Valid = Entry.Valid != 0;
+        int64_t const UpdateTime = Entry.UpdateTime;
+        std::atomic_thread_fence( std::memory_order_acquire );
+        if ( Entry.Sequence.load( std::memory_order_relaxed ) == Before ) {
+            State.Sequence = Before;
+            State.Valid = Valid;
+            State.UpdateTime =
+                std::chrono::system_clock::time_point(
+                    std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                        std::chrono::milliseconds( UpdateTime )
+                    )
+                );
+            return true;
+        }
+    }
+    return false;
+}
+//---------------------------------------------------------------------------
+
+bool ProcessImageReader::Read( size_t Idx, RegDataType* Data,
+                               ProcessImageBlockState& State ) const
+{
+    if ( blocks_.at( Idx ).IsBits() ) {
+        throw EBaseException( _D( "Process image block holds bits, not registers" ) );
+    }
+    return Snapshot( Idx, Data, State );
+}
+//---------------------------------------------------------------------------
+
+bool ProcessImageReader::Read( size_t Idx, CoilDataType* Data,
+                               ProcessImageBlockState& State ) const
+{
+    if ( !blocks_.at( Idx ).IsBits() ) {
+        throw EBaseException( _D( "Process image block holds registers, not bits" ) );
+    }
+    return Snapshot( Idx, Data, State );
+}
+
+//---------------------------------------------------------------------------
+}; // End of namespace Master
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
@@ -0,0 +1,173 @@
+/**
+ * @file ModbusProcessImage.h
+ * @brief Modbus::Master::ProcessImageWriter / ProcessImageReader — scanned blocks shared
+ *        between processes.
+ *
+ * @details A process image is a named shared memory section (a Win32 file mapping
+ *  backed by the paging file) holding a copy of every scanned block.  One process owns
+ *  the Modbus link and writes the image after each scan (see Publish() and
+ *  TagScanner::SetProcessImage()); any number of processes (HMI, historian, alarm
+ *  engine) open it by name and read the blocks, without polling the devices again and
+ *  without any call to the writer.
+ *
+ *  Every block has its own sequence counter, used as a seqlock: the writer makes it odd
+ *  while it updates the block and even again after, and a reader copies the block
+ *  between two reads of the counter, retrying if the counter was odd or moved.  Readers
+ *  never block the writer and take no lock; GetSequence() tells them, with one load,
+ *  whether a block changed since they last read it.
+ *
+ *  Section layout (version 1, native byte order): a header, one descriptor per block
+ *  (unit, function code, address, point count, data offset, sequence, validity and
+ *  update time) and the data of the blocks, 8-byte aligned: registers as RegDataType,
+ *  bits packed as returned by FC01/FC02.
+ *
+ *  The section lives as long as a writer or a reader keeps it open.  A writer that
+ *  restarts while readers still hold the section takes it over if the layout is the
+ *  same: the blocks keep their data, validity and sequence, and a block left in the
+ *  middle of an update is marked invalid.  A name must have one writer at a time; this
+ *  is not checked.
+ */
+
+//---------------------------------------------------------------------------
+
+#ifndef ModbusProcessImageH
+#define ModbusProcessImageH
+
+#include <windows.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <chrono>
+#include <vector>
+
+#include "Modbus.h"
+
+/** @brief Default number of attempts of a reader to get a consistent copy of a block. */
+#if !defined( MODBUS_PROCESS_IMAGE_DEFAULT_READ_RETRIES )
+  #define MODBUS_PROCESS_IMAGE_DEFAULT_READ_RETRIES  1000
+#endif
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace Master {
+//---------------------------------------------------------------------------
+
+/** @brief Describes one block of a process image. */
+struct ProcessImageBlock {
+    Context::SlaveAddrType SlaveAddr {};
+    FunctionCode           FnCode { FunctionCode::ReadHoldingRegisters };  ///< FC01, FC02, FC03 or FC04.
+    uint16_t               Addr {};
+    uint16_t               PointCount {};
+
+    /** @brief Returns @c true for FC01/FC02 blocks (packed bits). */
+    [[ nodiscard ]] bool IsBits() const noexcept;
+
+    /** @brief Size of the data of the block in bytes. */
+    [[ nodiscard ]] size_t GetDataSize() const noexcept;
+};
+
+/** @brief State of a block, read together with its data. */
+struct ProcessImageBlockState {
+    uint32_t                              Sequence {};  ///< Even; grows by 2 at every update.
+    bool                                  Valid {};     ///< @c false if the last read of the block failed.
+    std::chrono::system_clock::time_point UpdateTime;   ///< Time of the last update.
+};
+
+/** @brief Creates a process image and writes its blocks (see file description). */
+class ProcessImageWriter {
+public:
+    /**
+     * @brief Creates the section @p Name with the layout @p Blocks; every block is
+     *        invalid until it is written.  If the section already exists with the same
+     *        layout (the writer restarted while readers kept it), it is reopened.
+     * @throws EBaseException if a block has no points or is not an FC01–FC04 block,
+     *         if the section cannot be created, or if it exists with another layout.
+     */
+    ProcessImageWriter( String Name, std::vector<ProcessImageBlock> Blocks );
+    ~ProcessImageWriter();
+
+    ProcessImageWriter( ProcessImageWriter const & Rhs ) = delete;
+    ProcessImageWriter& operator=( ProcessImageWriter const & Rhs ) = delete;
+
+    [[ nodiscard ]] String GetName() const { return name_; }
+    [[ nodiscard ]] size_t GetBlockCount() const noexcept { return blocks_.size(); }
+    [[ nodiscard ]] ProcessImageBlock const & GetBlock( size_t Idx ) const { return blocks_.at( Idx ); }
+
+    /** @brief Writes a register block and marks it valid. */
+    void Write( size_t Idx, RegDataType const * Data );
+
+    /** @brief Writes a packed bit block and marks it valid. */
+    void Write( size_t Idx, CoilDataType const * Data );
+
+    /** @brief Marks a block invalid, keeping its last data. */
+    void Invalidate( size_t Idx );
+
+    /**
+     * @brief Writes block @c i from @p Requests[i] for every completed request, and
+     *        invalidates the blocks of the other requests.
+     * @throws EBaseException if @p Count is not the block count, or a request does not
+     *         match the function code and point count of its block.
+     */
+    void Publish( Request const * Requests, size_t Count );
+private:
+    String                          name_;
+    std::vector<ProcessImageBlock>  blocks_;
+    HANDLE                          mapping_ {};
+    uint8_t*                        view_ {};
+
+    void Initialize( size_t Size );
+    void Reopen( size_t Size );
+    void Update( size_t Idx, void const * Data, bool Valid );
+};
+
+/** @brief Opens a process image by name and reads its blocks (see file description). */
+class ProcessImageReader {
+public:
+    /**
+     * @brief Opens the section @p Name.
+     * @throws EBaseException if the section does not exist or is not a process image
+     *         of a known version.
+     */
+    explicit ProcessImageReader( String Name );
+    ~ProcessImageReader();
+
+    ProcessImageReader( ProcessImageReader const & Rhs ) = delete;
+    ProcessImageReader& operator=( ProcessImageReader const & Rhs ) = delete;
+
+    [[ nodiscard ]] String GetName() const { return name_; }
+    [[ nodiscard ]] size_t GetBlockCount() const noexcept { return blocks_.size(); }
+    [[ nodiscard ]] ProcessImageBlock const & GetBlock( size_t Idx ) const { return blocks_.at( Idx ); }
+
+    /** @brief Returns the current sequence of a block (odd while it is being written). */
+    [[ nodiscard ]] uint32_t GetSequence( size_t Idx ) const;
+
+    /**
+     * @brief Copies a consistent snapshot of a register block and its state.
+     * @return @c false if no consistent copy was obtained in GetReadRetries() attempts
+     *         (the writer stopped in the middle of an update).
+     * @throws EBaseException if the block is a bit block.
+     */
+    bool Read( size_t Idx, RegDataType* Data, ProcessImageBlockState& State ) const;
+
+    /** @brief Copies a consistent snapshot of a packed bit block and its state. */
+    bool Read( size_t Idx, CoilDataType* Data, ProcessImageBlockState& State ) const;
+
+    [[ nodiscard ]] unsigned GetReadRetries() const noexcept { return readRetries_; }
+    void SetReadRetries( unsigned Val ) noexcept { readRetries_ = Val ? Val : 1; }
+private:
+    String                          name_;
+    std::vector<ProcessImageBlock>  blocks_;
+    HANDLE                          mapping_ {};
+    uint8_t const *                 view_ {};
+    unsigned                        readRetries_ { MODBUS_PROCESS_IMAGE_DEFAULT_READ_RETRIES };
+
+    bool Snapshot( size_t Idx, void* Data, ProcessImageBlockState& State ) const;
+};
+
+//---------------------------------------------------------------------------
+}; // End of namespace Master
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
+#endif
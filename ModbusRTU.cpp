@@ -6,9 +6,12 @@
 #include <iterator>
 #include <algorithm>
 #include <iostream>
+#include <chrono>
+#include <thread>
 
 #include "Modbus.h"
 #include "ModbusRTU.h"
+#include "ModbusPDU.h"
 
 using std::vector;
 using std::back_insert_iterator;
@@ -27,10 +30,114 @@ namespace Modbus {
 namespace Master {
 //---------------------------------------------------------------------------
 
-RTUProtocol::RTUProtocol( int pRetryCount )
+RTUFramingProtocol::RTUFramingProtocol( int RetryCount )
   : cancelTXEcho_( false )
-  , retryCount_( pRetryCount )
+  , retryCount_( RetryCount )
   , onFlowEvent_( 0 )
+{
+}
+//---------------------------------------------------------------------------
+
+RTUFramingProtocol::TFlowEvent RTUFramingProtocol::SetFlowEventHandler(
+                                   TFlowEvent EventHandler ) noexcept
+{
+    TFlowEvent Old = onFlowEvent_;
+    onFlowEvent_ = EventHandler;
+    return Old;
+}
+//---------------------------------------------------------------------------
+
+unsigned RTUFramingProtocol::DoGetBroadcastDelay( FrameCont::size_type /*FrameLength*/ ) const
+{
+    return broadcastTurnaround_;
+}
+//---------------------------------------------------------------------------
+
+void RTUFramingProtocol::SendFrame( const FrameCont& TxFrame )
+{
+#if defined ( _DEBUG ) && defined( VIEW_RTU_PROTOCOL_DIAG )
+    ShowBuffer(
+        Format(
+            _D( "TX(%s): " ), ARRAYOFCONST( ( GetProtocolParamsStr() ) )
+        ),
+        TxFrame.begin(), TxFrame.end()
+    );
+#endif
+    if ( onFlowEvent_ )
+        onFlowEvent_( *this, FlowDirection::TX, TxFrame );
+
+    DoInputBufferClear();
+
+    DoWrite( TxFrame );
+}
+//---------------------------------------------------------------------------
+
+bool RTUFramingProtocol::ReadTXEcho( Context const & Context, const FrameCont& TxFrame,
+                                     FrameCont& RxFrame, FrameCont::size_type Lookahead,
+                                     bool NoThrow )
+{
+    FrameCont::size_type const EchoLength = TxFrame.size();
+
+    RxFrame.clear();
+    ReadFrameBytes( RxFrame, EchoLength + Lookahead, true );
+    FrameCont::size_type const EchoRead = std::min( RxFrame.size(), EchoLength );
+    if ( !std::equal( RxFrame.begin(), RxFrame.begin() + EchoRead, TxFrame.begin() ) ) {
+        if ( NoThrow ) {
+            return false;
+        }
+        else {
+            throw ERTUBusCollision( Context, _D( "TX echo mismatch (bus collision)" ) );
+        }
+    }
+    if ( EchoRead < EchoLength ) {
+        if ( NoThrow ) {
+            return false;
+        }
+        else {
+            throw EContextException( Context, _D( "TX echo timeout" ) );
+        }
+    }
+    RxFrame.erase( RxFrame.begin(), RxFrame.begin() + EchoLength );
+    return true;
+}
+//---------------------------------------------------------------------------
+
+void RTUFramingProtocol::Broadcast( Context const & Context, const FrameCont& TxFrame,
+                                    int RetryCount )
+{
+    TransactionPolicy const Policy = GetEffectivePolicy( Context );
+    int const Retries = Policy.RetryCount.value_or( RetryCount );
+    transactionTimeout_ = Policy.Timeout;
+
+    // Nothing comes back from a broadcast: only a corrupted echo can trigger a retry
+    for ( int Idx = 0 ; ; ++Idx ) {
+        WaitBeforeRetry( Policy.Backoff.value_or( 0 ), Idx );
+        SendFrame( TxFrame );
+        FrameCont Echo;
+        if ( !CancelTXEcho || ReadTXEcho( Context, TxFrame, Echo, 0, Idx < Retries ) ) {
+            break;
+        }
+    }
+
+    std::this_thread::sleep_for(
+        std::chrono::milliseconds( DoGetBroadcastDelay( TxFrame.size() ) )
+    );
+}
+//---------------------------------------------------------------------------
+
+bool RTUFramingProtocol::ReadFrameBytes( FrameCont& RxFrame, FrameCont::size_type Count,
+                                         bool FrameStart )
+{
+    FrameCont::size_type const Offset = RxFrame.size();
+    RxFrame.resize( Offset + Count );
+    size_t const BytesRead = Count ? DoRead( &RxFrame[Offset], Count, FrameStart ) : 0;
+    RxFrame.resize( Offset + BytesRead );
+    return BytesRead == Count;
+}
+//---------------------------------------------------------------------------
+
+RTUProtocol::RTUProtocol( int pRetryCount )
+  : RTUFramingProtocol( pRetryCount )
 {
     commPort_.SetParity( NOPARITY );
     commPort_.SetByteSize( 8 );
@@ -104,6 +211,18 @@ void RTUProtocol::SetCommStopBits( int Val )
 }
 //---------------------------------------------------------------------------
 
+bool RTUProtocol::GetCommOverlapped() const noexcept
+{
+    return commPort_.GetOverlapped();
+}
+//---------------------------------------------------------------------------
+
+void RTUProtocol::SetCommOverlapped( bool Val )
+{
+    commPort_.SetOverlapped( Val );
+}
+//---------------------------------------------------------------------------
+
 unsigned int RTUProtocol::GetParityBitCount() const
 {
     switch ( const_cast<TCommPort&>( commPort_ ).GetParity() ) {
@@ -120,7 +239,7 @@ unsigned int RTUProtocol::GetParityBitCount() const
 
 unsigned int RTUProtocol::GetStopBitCount() const
 {
-    switch ( const_cast<TCommPort&>( commPort_ ).GetParity() ) {
+    switch ( const_cast<TCommPort&>( commPort_ ).GetStopBits() ) {
         case ONESTOPBIT :
             return 1;
         case ONE5STOPBITS:
@@ -132,11 +251,40 @@ unsigned int RTUProtocol::GetStopBitCount() const
 }
 //---------------------------------------------------------------------------
 
-RTUProtocol::TFlowEvent RTUProtocol::SetFlowEventHandler( TFlowEvent EventHandler ) noexcept
+template<typename T>
+__int64 RTUProtocol::GetMinimumFrameTime( T FrameLen ) const
 {
-    TFlowEvent Old = onFlowEvent_;
-    onFlowEvent_ = EventHandler;
-    return Old;
+    // Microseconds needed to put FrameLen characters on the line
+    unsigned int const CharBits =
+        1 + GetCommBits() + GetParityBitCount() + GetStopBitCount();
+    return static_cast<__int64>( FrameLen * CharBits * 1000000.0 / GetCommSpeed() );
+}
+//---------------------------------------------------------------------------
+
+unsigned RTUProtocol::DoGetBroadcastDelay( FrameCont::size_type FrameLength ) const
+{
+    // WriteFile() may return while the frame is still leaving the UART; then the
+    // line must stay idle for 3.5 characters, a fixed 1750 us above 19200 baud
+    // (Modbus over serial line, 2.5.1.1)
+    __int64 const SilentInterval =
+        GetCommSpeed() > 19200 ? 1750 : GetMinimumFrameTime( 3.5 );
+    __int64 const LineTime = GetMinimumFrameTime( FrameLength ) + SilentInterval;
+
+    return RTUFramingProtocol::DoGetBroadcastDelay( FrameLength ) +
+           static_cast<unsigned>( ( LineTime + 999 ) / 1000 );
+}
+//---------------------------------------------------------------------------
+
+unsigned RTUProtocol::DoGetFrameTime( FrameCont::size_type FrameLength ) const
+{
+    return static_cast<unsigned>( GetMinimumFrameTime( FrameLength ) );
+}
+//---------------------------------------------------------------------------
+
+void RTUProtocol::DoSetResponseTimeout( unsigned Val )
+{
+    timeoutValue_ = Val;
+    commPort_.SetReadTimeOut( Val );
 }
 //---------------------------------------------------------------------------
 
@@ -182,6 +330,7 @@ String RTUProtocol::DoGetProtocolParamsStr() const
 
 void RTUProtocol::DoOpen()
 {
+    commPort_.SetReadTimeOut( timeoutValue_ );
     commPort_.OpenCommPort();
 }
 //---------------------------------------------------------------------------
@@ -198,978 +347,550 @@ bool RTUProtocol::DoIsConnected() const noexcept
 }
 //---------------------------------------------------------------------------
 
-//    RTUProtocol::DoReadCoilStatus
-//    RTUProtocol::DoReadInputStatus
+void RTUProtocol::DoInputBufferClear()
+{
+    commPort_.PurgeCommPort();
+}
+//---------------------------------------------------------------------------
 
-void RTUProtocol::ReadBits( FunctionCode FnCode, Context const & Context,
-                            CoilAddrType StartAddr, CoilCountType PointCount,
-                            CoilDataType* Data )
+void RTUProtocol::DoWrite( FrameCont const & TxFrame )
 {
-    if ( PointCount == 0 || PointCount > 2000 ) {
-        throw EContextException(
-            Context, _D( "Too many points have been requested" )
-        );
+    commPort_.WriteBuffer(
+        const_cast<FrameCont::value_type*>( &TxFrame[0] ), TxFrame.size()
+    );
+}
+//---------------------------------------------------------------------------
+
+size_t RTUProtocol::DoRead( uint8_t* Buffer, size_t Length, bool /*FrameStart*/ )
+{
+    // ReadBytes() returns early only when the timeout elapses.  The timeout of the
+    // transaction may differ from TimeoutValue: the port reprograms its timeouts only
+    // if it changed, and never in overlapped mode
+    size_t BytesRead {};
+    while ( BytesRead < Length ) {
+        unsigned int const Count =
+            commPort_.ReadBytes(
+                Buffer + BytesRead, static_cast<unsigned int>( Length - BytesRead ),
+                GetTransactionTimeout()
+            );
+        if ( !Count ) {
+            break;
+        }
+        BytesRead += Count;
     }
+    return BytesRead;
+}
+//---------------------------------------------------------------------------
 
-    FrameCont TxFrame;
-    const FrameCont::size_type ExpectedByteCount( ( PointCount + 7 ) / 8 );
-    const FrameCont::size_type ExpectedRxFramelength( ExpectedByteCount + 5 );
-    FrameCont RxFrame;
+//    RTUFramingProtocol::DoReadCoilStatus
+//    RTUFramingProtocol::DoReadInputStatus
 
-    RxFrame.reserve( ExpectedRxFramelength );
-    TxFrame.reserve( 8 );
+template<FunctionCode FC>
+void RTUFramingProtocol::ReadBits( Context const & Context,
+                                   CoilAddrType StartAddr, CoilCountType PointCount,
+                                   CoilDataType* Data )
+{
+    using Codec = PDU::Codec<FC>;
 
-    back_insert_iterator<FrameCont> TxFrameBkInsIt( TxFrame );
-    *TxFrameBkInsIt++ = Context.GetSlaveAddr();
-    *TxFrameBkInsIt++ = static_cast<RegDataType>( FnCode );
-    TxFrameBkInsIt =
-        WriteAddressPointCountPair( TxFrameBkInsIt, StartAddr, PointCount );
-    WriteCRC( TxFrameBkInsIt, TxFrame.begin(), TxFrame.end() );
+    Codec::RaiseExceptionIfPointCountIsNotValid( Context, PointCount );
 
-    SendAndReceiveFrames(
-        Context, TxFrame, back_inserter( RxFrame ),
-        ExpectedRxFramelength, retryCount_
+    FrameCont::size_type const ExpectedRxFramelength(
+        GetFrameLength( Codec::ResponseLength( PointCount ) )
     );
+    FrameCont RxFrame;
+    RxFrame.reserve( ExpectedRxFramelength );
 
-    FrameCont::const_iterator RxInIt = RxFrame.begin();
-
-    const FrameCont::size_type RxByteCount =
-        static_cast<FrameCont::size_type>( *RxInIt++ );
-
-    if ( RxByteCount != ExpectedByteCount ) {
-        throw EContextException( Context, _D( "Byte count mismatch" ) );
-    }
+    SendAndReceiveFrames(
+        Context,
+        EncodeFrame<Codec>( Context, Codec::RequestLength, StartAddr, PointCount ),
+        back_inserter( RxFrame ), ExpectedRxFramelength, retryCount_
+    );
 
-    for ( FrameCont::size_type Idx = 0; Idx < RxByteCount; ++Idx ) {
-        *Data++ = *RxInIt++;
-    }
+    DecodeFrame<Codec>( Context, RxFrame, PointCount, Data );
 }
 //---------------------------------------------------------------------------
 
-void RTUProtocol::DoReadCoilStatus( Context const & Context,
-                                    CoilAddrType StartAddr,
-                                    CoilCountType PointCount,
-                                    CoilDataType* Data )
+void RTUFramingProtocol::DoReadCoilStatus( Context const & Context,
+                                           CoilAddrType StartAddr,
+                                           CoilCountType PointCount,
+                                           CoilDataType* Data )
 {
-    ReadBits( FunctionCode::ReadCoilStatus, Context, StartAddr,
-              PointCount, Data );
+    ReadBits<FunctionCode::ReadCoilStatus>( Context, StartAddr, PointCount, Data );
 }
 //---------------------------------------------------------------------------
 
-void RTUProtocol::DoReadInputStatus( Context const & Context,
-                                     CoilAddrType StartAddr,
-                                     CoilCountType PointCount,
-                                     CoilDataType* Data )
+void RTUFramingProtocol::DoReadInputStatus( Context const & Context,
+                                            CoilAddrType StartAddr,
+                                            CoilCountType PointCount,
+                                            CoilDataType* Data )
 {
-    ReadBits( FunctionCode::ReadInputStatus, Context, StartAddr,
-              PointCount, Data );
+    ReadBits<FunctionCode::ReadInputStatus>( Context, StartAddr, PointCount, Data );
 }
 
 //---------------------------------------------------------------------------
 
-void RTUProtocol::ReadRegisters( FunctionCode FnCode, Context const & Context,
-                                 RegAddrType StartAddr, RegCountType PointCount,
-                                 RegDataType* Data )
+template<FunctionCode FC>
+void RTUFramingProtocol::ReadRegisters( Context const & Context,
+                                        RegAddrType StartAddr, RegCountType PointCount,
+                                        RegDataType* Data )
 {
-    FrameCont TxFrame;
-    FrameCont::size_type const ExpectedRxFramelength( PointCount * 2 + 5 );
-    FrameCont RxFrame;
+    using Codec = PDU::Codec<FC>;
+
+    Codec::RaiseExceptionIfPointCountIsNotValid( Context, PointCount );
 
+    FrameCont::size_type const ExpectedRxFramelength(
+        GetFrameLength( Codec::ResponseLength( PointCount ) )
+    );
+    FrameCont RxFrame;
     RxFrame.reserve( ExpectedRxFramelength );
-    TxFrame.reserve( 8 );
-    back_insert_iterator<FrameCont> TxFrameBkInsIt( TxFrame );
-    *TxFrameBkInsIt++ = Context.GetSlaveAddr();
-    *TxFrameBkInsIt++ = static_cast<RegDataType>( FnCode );
-    TxFrameBkInsIt =
-        WriteAddressPointCountPair( TxFrameBkInsIt, StartAddr, PointCount );
-    WriteCRC( TxFrameBkInsIt, TxFrame.begin(), TxFrame.end() );
 
     SendAndReceiveFrames(
-        Context, TxFrame, back_inserter( RxFrame ),
-        ExpectedRxFramelength, retryCount_
+        Context,
+        EncodeFrame<Codec>( Context, Codec::RequestLength, StartAddr, PointCount ),
+        back_inserter( RxFrame ), ExpectedRxFramelength, retryCount_
     );
 
-    FrameCont::const_iterator RxInIt = RxFrame.begin();
-
-    const FrameCont::size_type RxByteCount =
-        static_cast<FrameCont::size_type>( *RxInIt++ );
-
-    if ( RxByteCount !=  ExpectedRxFramelength - 5 ) {
-        throw EContextException( Context, _D( "Byte count mismatch" ) );
-    }
-
-    while ( PointCount-- ) {
-        RxInIt = Read( RxInIt, *Data++ );
-    }
+    DecodeFrame<Codec>( Context, RxFrame, PointCount, Data );
 }
 //---------------------------------------------------------------------------
 
-void RTUProtocol::DoReadHoldingRegisters( Context const & Context,
-                                          RegAddrType StartAddr,
-                                          RegCountType PointCount,
-                                          RegDataType* Data )
+void RTUFramingProtocol::DoReadHoldingRegisters( Context const & Context,
+                                                 RegAddrType StartAddr,
+                                                 RegCountType PointCount,
+                                                 RegDataType* Data )
 {
-    ReadRegisters( FunctionCode::ReadHoldingRegisters, Context, StartAddr,
-                   PointCount, Data );
-/*
-    if ( PointCount > 125 ) {
-        throw EContextException(
-            Context, _D( "Too many points have been requested" )
-        );
-    }
-
-    FrameCont TxFrame;
-    FrameCont::size_type const ExpectedRxFramelength( PointCount * 2 + 5 );
-    FrameCont RxFrame;
-
-    RxFrame.reserve( ExpectedRxFramelength );
-    TxFrame.reserve( 8 );
-    back_insert_iterator<FrameCont> TxFrameBkInsIt( TxFrame );
-    *TxFrameBkInsIt++ = Context.GetSlaveAddr();
-    *TxFrameBkInsIt++ =
-        static_cast<RegDataType>( FunctionCode::ReadHoldingRegisters );
-    TxFrameBkInsIt =
-        WriteAddressPointCountPair( TxFrameBkInsIt, StartAddr, PointCount );
-    WriteCRC( TxFrameBkInsIt, TxFrame.begin(), TxFrame.end() );
-
-    SendAndReceiveFrames(
-        Context, TxFrame, back_inserter( RxFrame ),
-        ExpectedRxFramelength, retryCount_
+    ReadRegisters<FunctionCode::ReadHoldingRegisters>(
+        Context, StartAddr, PointCount, Data
     );
-
-    FrameCont::const_iterator RxInIt = RxFrame.begin();
-
-    const FrameCont::size_type RxByteCount =
-        static_cast<FrameCont::size_type>( *RxInIt++ );
-
-    if ( RxByteCount !=  ExpectedRxFramelength - 5 ) {
-        throw EContextException( Context, _D( "Byte count mismatch" ) );
-    }
-
-    while ( PointCount-- ) {
-        RxInIt = Read( RxInIt, *Data++ );
-    }
-*/
 }
 //---------------------------------------------------------------------------
 
-void RTUProtocol::DoReadInputRegisters( Context const & Context,
-                                        RegAddrType StartAddr,
-                                        RegCountType PointCount,
-                                        RegDataType* Data )
+void RTUFramingProtocol::DoReadInputRegisters( Context const & Context,
+                                               RegAddrType StartAddr,
+                                               RegCountType PointCount,
+                                               RegDataType* Data )
 {
-    ReadRegisters( FunctionCode::ReadInputRegisters, Context, StartAddr,
-                   PointCount, Data );
+    ReadRegisters<FunctionCode::ReadInputRegisters>(
+        Context, StartAddr, PointCount, Data
+    );
 }
 //---------------------------------------------------------------------------
 
-//    RTUProtocol::DoForceSingleCoil
-void RTUProtocol::DoForceSingleCoil( Context const & Context,
-                                     CoilAddrType Addr, bool Value )
+//    RTUFramingProtocol::DoForceSingleCoil
+void RTUFramingProtocol::DoForceSingleCoil( Context const & Context,
+                                            CoilAddrType Addr, bool Value )
 {
-    FrameCont TxFrame;
-    const FrameCont::size_type ExpectedRxFramelength( 8 );
-    FrameCont RxFrame;
+    using Codec = PDU::Codec<FunctionCode::ForceSingleCoil>;
 
-    RxFrame.reserve( ExpectedRxFramelength );
-    TxFrame.reserve( 8 );
+    FrameCont const TxFrame =
+        EncodeFrame<Codec>( Context, Codec::RequestLength, Addr, Value );
 
-    back_insert_iterator<FrameCont> TxFrameBkInsIt( TxFrame );
+    if ( Context.GetSlaveAddr() == BroadcastAddress ) {
+        Broadcast( Context, TxFrame, retryCount_ );
+        return;
+    }
 
-    *TxFrameBkInsIt++ = Context.GetSlaveAddr();
-    *TxFrameBkInsIt++ =
-        static_cast<RegDataType>( FunctionCode::ForceSingleCoil );
-    TxFrameBkInsIt = Write( TxFrameBkInsIt, Addr );
-    TxFrameBkInsIt = Write( TxFrameBkInsIt, static_cast<uint16_t>( Value ? 0xFF00 : 0x0000 ) );
-    WriteCRC( TxFrameBkInsIt, TxFrame.begin(), TxFrame.end() );
+    FrameCont RxFrame;
+    RxFrame.reserve( GetFrameLength( Codec::ResponseLength ) );
 
     SendAndReceiveFrames(
-        Context, TxFrame, back_inserter( RxFrame ),
-        ExpectedRxFramelength, retryCount_
+        Context, TxFrame,
+        back_inserter( RxFrame ), GetFrameLength( Codec::ResponseLength ), retryCount_
     );
 
-    RegAddrType ReadAddr;
-    FrameCont::const_iterator RxInIt = Read( RxFrame.begin(), ReadAddr );
-    if ( ReadAddr != Addr ) {
-        throw EContextException( Context, _D( "Address mismatch" ) );
-    }
-
-    uint16_t ReadValue;
-    RxInIt = Read( RxInIt, ReadValue );
-    uint16_t const ExpectedValue = Value ? 0xFF00 : 0x0000;
-    if ( ReadValue != ExpectedValue ) {
-        throw EContextException( Context, _D( "Data mismatch" ) );
-    }
+    DecodeFrame<Codec>( Context, RxFrame, Addr, Value );
 }
 //---------------------------------------------------------------------------
 
-void RTUProtocol::DoPresetSingleRegister( Context const & Context,
-                                          RegAddrType Addr, RegDataType Data )
+void RTUFramingProtocol::DoPresetSingleRegister( Context const & Context,
+                                                 RegAddrType Addr, RegDataType Data )
 {
-    FrameCont TxFrame;
-    const FrameCont::size_type ExpectedRxFramelength( 8 );
-    FrameCont RxFrame;
+    using Codec = PDU::Codec<FunctionCode::PresetSingleRegister>;
 
-    RxFrame.reserve( ExpectedRxFramelength );
-    TxFrame.reserve( 8 );
-
-    back_insert_iterator<FrameCont> TxFrameBkInsIt( TxFrame );
+    FrameCont const TxFrame =
+        EncodeFrame<Codec>( Context, Codec::RequestLength, Addr, Data );
 
-    *TxFrameBkInsIt++ = Context.GetSlaveAddr();
-    *TxFrameBkInsIt++ =
-        static_cast<RegDataType>( FunctionCode::PresetSingleRegister );
-    TxFrameBkInsIt = Write( TxFrameBkInsIt, Addr );
-    TxFrameBkInsIt = Write( TxFrameBkInsIt, Data );
-    WriteCRC( TxFrameBkInsIt, TxFrame.begin(), TxFrame.end() );
+    if ( Context.GetSlaveAddr() == BroadcastAddress ) {
+        Broadcast( Context, TxFrame, retryCount_ );
+        return;
+    }
 
-    back_insert_iterator<FrameCont> RxFrameBkInsIt( RxFrame );
+    FrameCont RxFrame;
+    RxFrame.reserve( GetFrameLength( Codec::ResponseLength ) );
 
     SendAndReceiveFrames(
-        Context, TxFrame, back_inserter( RxFrame ),
-        ExpectedRxFramelength, retryCount_
+        Context, TxFrame,
+        back_inserter( RxFrame ), GetFrameLength( Codec::ResponseLength ), retryCount_
     );
 
-    RegAddrType ReadAddr;
-    FrameCont::const_iterator RxInIt = Read( RxFrame.begin(), ReadAddr );
-    if ( ReadAddr != Addr ) {
-        throw EContextException( Context, _D( "Address mismatch" ) );
-    }
-
-    RegDataType ReadData;
-    RxInIt = Read( RxInIt, ReadData );
-    if ( ReadData != Data ) {
-        throw EContextException( Context, _D( "Data mismatch" ) );
-    }
+    DecodeFrame<Codec>( Context, RxFrame, Addr, Data );
 }
 //---------------------------------------------------------------------------
 
-//    RTUProtocol::DoReadExceptionStatus
-ExceptionStatusDataType RTUProtocol::DoReadExceptionStatus(
+//    RTUFramingProtocol::DoReadExceptionStatus
+ExceptionStatusDataType RTUFramingProtocol::DoReadExceptionStatus(
                                          Context const & Context )
 {
-    FrameCont TxFrame;
-    // Response: SlaveAddr(1) + FC(1) + ExceptionStatus(1) + CRC(2) = 5
-    const FrameCont::size_type ExpectedRxFramelength( 5 );
-    FrameCont RxFrame;
-
-    RxFrame.reserve( ExpectedRxFramelength );
-    TxFrame.reserve( 4 );
+    using Codec = PDU::Codec<FunctionCode::ReadExceptionStatus>;
 
-    back_insert_iterator<FrameCont> TxFrameBkInsIt( TxFrame );
-
-    *TxFrameBkInsIt++ = Context.GetSlaveAddr();
-    *TxFrameBkInsIt++ =
-        static_cast<RegDataType>( FunctionCode::ReadExceptionStatus );
-    WriteCRC( TxFrameBkInsIt, TxFrame.begin(), TxFrame.end() );
+    FrameCont RxFrame;
+    RxFrame.reserve( GetFrameLength( Codec::ResponseLength ) );
 
     SendAndReceiveFrames(
-        Context, TxFrame, back_inserter( RxFrame ),
-        ExpectedRxFramelength, retryCount_
+        Context,
+        EncodeFrame<Codec>( Context, Codec::RequestLength ),
+        back_inserter( RxFrame ), GetFrameLength( Codec::ResponseLength ), retryCount_
     );
 
-    // RxFrame payload (after SendAndReceiveFrames strips SlaveAddr+FC+CRC):
-    // ExceptionStatus(1)
-    return static_cast<ExceptionStatusDataType>( RxFrame[0] );
+    return DecodeFrame<Codec>( Context, RxFrame );
 }
 //---------------------------------------------------------------------------
 
-//    RTUProtocol::DoDiagnostics
-RegDataType RTUProtocol::DoDiagnostics( Context const & Context,
-                                        DiagSubFnType SubFunction,
-                                        RegDataType Data )
+//    RTUFramingProtocol::DoDiagnostics
+RegDataType RTUFramingProtocol::DoDiagnostics( Context const & Context,
+                                               DiagSubFnType SubFunction,
+                                               RegDataType Data )
 {
-    FrameCont TxFrame;
-    // Response: SlaveAddr(1) + FC(1) + SubFunction(2) + Data(2) + CRC(2) = 8
-    const FrameCont::size_type ExpectedRxFramelength( 8 );
-    FrameCont RxFrame;
-
-    RxFrame.reserve( ExpectedRxFramelength );
-    TxFrame.reserve( 8 );
+    using Codec = PDU::Codec<FunctionCode::Diagnostics>;
 
-    back_insert_iterator<FrameCont> TxFrameBkInsIt( TxFrame );
-
-    *TxFrameBkInsIt++ = Context.GetSlaveAddr();
-    *TxFrameBkInsIt++ =
-        static_cast<RegDataType>( FunctionCode::Diagnostics );
-    TxFrameBkInsIt = Write( TxFrameBkInsIt, SubFunction );
-    TxFrameBkInsIt = Write( TxFrameBkInsIt, Data );
-    WriteCRC( TxFrameBkInsIt, TxFrame.begin(), TxFrame.end() );
+    FrameCont RxFrame;
+    RxFrame.reserve( GetFrameLength( Codec::ResponseLength ) );
 
     SendAndReceiveFrames(
-        Context, TxFrame, back_inserter( RxFrame ),
-        ExpectedRxFramelength, retryCount_
+        Context,
+        EncodeFrame<Codec>( Context, Codec::RequestLength, SubFunction, Data ),
+        back_inserter( RxFrame ), GetFrameLength( Codec::ResponseLength ), retryCount_
     );
 
-    // RxFrame payload: SubFunction(2) + Data(2)
-    FrameCont::const_iterator RxInIt = RxFrame.begin();
-
-    uint16_t ReadSubFn;
-    RxInIt = Read( RxInIt, ReadSubFn );
-    if ( ReadSubFn != SubFunction ) {
-        throw EContextException( Context, _D( "Sub-function mismatch" ) );
-    }
-
-    RegDataType ReadData;
-    RxInIt = Read( RxInIt, ReadData );
-    return ReadData;
+    return DecodeFrame<Codec>( Context, RxFrame, SubFunction );
 }
 
 //---------------------------------------------------------------------------
 
-//    RTUProtocol::DoProgram484
+//    RTUFramingProtocol::DoProgram484
 
 //---------------------------------------------------------------------------
 
-//    RTUProtocol::DoPoll484
+//    RTUFramingProtocol::DoPoll484
 
 //---------------------------------------------------------------------------
 
-//    RTUProtocol::DoFetchCommEventCtr
+//    RTUFramingProtocol::DoFetchCommEventCtr
+CommEventCounter RTUFramingProtocol::DoFetchCommEventCtr( Context const & Context )
+{
+    using Codec = PDU::Codec<FunctionCode::FetchCommEventCtr>;
+
+    FrameCont RxFrame;
+    RxFrame.reserve( GetFrameLength( Codec::ResponseLength ) );
+
+    SendAndReceiveFrames(
+        Context,
+        EncodeFrame<Codec>( Context, Codec::RequestLength ),
+        back_inserter( RxFrame ), GetFrameLength( Codec::ResponseLength ), retryCount_
+    );
 
+    return DecodeFrame<Codec>( Context, RxFrame );
+}
 //---------------------------------------------------------------------------
 
-//    RTUProtocol::DoFetchCommEventLog
+//    RTUFramingProtocol::DoFetchCommEventLog
+CommEventLog RTUFramingProtocol::DoFetchCommEventLog( Context const & Context )
+{
+    using Codec = PDU::Codec<FunctionCode::FetchCommEventLog>;
+
+    // SlaveAddr + FC + ByteCount announce the rest of the frame
+    FrameCont RxFrame;
+    RxFrame.reserve( GetFrameLength( Codec::ResponseLength( Codec::MaxEventCount ) ) );
+
+    Transact(
+        Context, EncodeFrame<Codec>( Context, Codec::RequestLength ), RxFrame,
+        GetFrameLength( Codec::HeaderLength ) - 2,
+        [&Context]( FrameCont const & Header ) {
+            return GetFrameLength(
+                Codec::ResponseLength( Codec::DecodeHeader( Context, &Header[2] ) )
+            );
+        },
+        retryCount_
+    );
 
+    // Skip SlaveAddr + FC, leave out the CRC
+    return Codec::Decode( Context, &RxFrame[2], RxFrame.size() - 4 );
+}
 //---------------------------------------------------------------------------
 
-//    RTUProtocol::DoProgramController
+//    RTUFramingProtocol::DoProgramController
 
 //---------------------------------------------------------------------------
 
-//    RTUProtocol::DoPollController
+//    RTUFramingProtocol::DoPollController
 
 //---------------------------------------------------------------------------
 
-//    RTUProtocol::DoForceMultipleCoils
-void RTUProtocol::DoForceMultipleCoils( Context const & Context,
-                                        CoilAddrType StartAddr,
-                                        CoilCountType PointCount,
-                                        const CoilDataType* Data )
+//    RTUFramingProtocol::DoForceMultipleCoils
+void RTUFramingProtocol::DoForceMultipleCoils( Context const & Context,
+                                               CoilAddrType StartAddr,
+                                               CoilCountType PointCount,
+                                               const CoilDataType* Data )
 {
-    if ( PointCount == 0 || PointCount > 1968 ) {
-        throw EContextException(
-            Context, _D( "Too many points have been requested" )
-        );
-    }
+    using Codec = PDU::Codec<FunctionCode::ForceMultipleCoils>;
 
-    const uint8_t ByteCount = static_cast<uint8_t>( ( PointCount + 7 ) / 8 );
+    Codec::RaiseExceptionIfPointCountIsNotValid( Context, PointCount );
 
-    FrameCont TxFrame;
-    const FrameCont::size_type ExpectedRxFramelength( 8 );
-    FrameCont RxFrame;
+    FrameCont const TxFrame =
+        EncodeFrame<Codec>(
+            Context, Codec::RequestLength( PointCount ), StartAddr, PointCount, Data
+        );
 
-    RxFrame.reserve( ExpectedRxFramelength );
-    TxFrame.reserve( 8 + ByteCount );
-    back_insert_iterator<FrameCont> TxFrameBkInsIt( TxFrame );
-    *TxFrameBkInsIt++ = Context.GetSlaveAddr();
-    *TxFrameBkInsIt++ =
-        static_cast<RegDataType>( FunctionCode::ForceMultipleCoils );
-    TxFrameBkInsIt =
-        WriteAddressPointCountPair( TxFrameBkInsIt, StartAddr, PointCount );
-    TxFrameBkInsIt =
-        Write( TxFrameBkInsIt, ByteCount );
-
-    for ( uint8_t Idx = 0; Idx < ByteCount; ++Idx ) {
-        TxFrameBkInsIt = Write( TxFrameBkInsIt, Data[Idx] );
+    if ( Context.GetSlaveAddr() == BroadcastAddress ) {
+        Broadcast( Context, TxFrame, retryCount_ );
+        return;
     }
 
-    WriteCRC( TxFrameBkInsIt, TxFrame.begin(), TxFrame.end() );
+    FrameCont RxFrame;
+    RxFrame.reserve( GetFrameLength( Codec::ResponseLength ) );
 
     SendAndReceiveFrames(
-        Context, TxFrame, back_inserter( RxFrame ),
-        ExpectedRxFramelength, retryCount_
+        Context, TxFrame,
+        back_inserter( RxFrame ), GetFrameLength( Codec::ResponseLength ), retryCount_
     );
 
-    RegAddrType ReadStartAddr;
-    FrameCont::const_iterator RxInIt = Read( RxFrame.begin(), ReadStartAddr );
-    if ( ReadStartAddr != StartAddr ) {
-        throw EContextException( Context, _D( "Start address mismatch" ) );
-    }
-
-    CoilCountType ReadPointCount;
-    RxInIt = Read( RxInIt, ReadPointCount );
-    if ( ReadPointCount != PointCount ) {
-        throw EContextException( Context, _D( "Point count mismatch" ) );
-    }
+    DecodeFrame<Codec>( Context, RxFrame, StartAddr, PointCount );
 }
 //---------------------------------------------------------------------------
 
-void RTUProtocol::DoPresetMultipleRegisters( Context const & Context,
-                                             RegAddrType StartAddr,
-                                             RegCountType PointCount,
-                                             const RegDataType* Data )
+void RTUFramingProtocol::DoPresetMultipleRegisters( Context const & Context,
+                                                    RegAddrType StartAddr,
+                                                    RegCountType PointCount,
+                                                    const RegDataType* Data )
 {
-    if ( PointCount > 123 ) {
-        throw EContextException(
-            Context, _D( "Too many points have been requested" )
-        );
-    }
+    using Codec = PDU::Codec<FunctionCode::PresetMultipleRegisters>;
 
-    const size_t DataByteCount = PointCount * sizeof( RegDataType );
+    Codec::RaiseExceptionIfPointCountIsNotValid( Context, PointCount );
 
-    FrameCont TxFrame;
-    const FrameCont::size_type ExpectedRxFramelength( 8 );
-    FrameCont RxFrame;
+    FrameCont const TxFrame =
+        EncodeFrame<Codec>(
+            Context, Codec::RequestLength( PointCount ), StartAddr, PointCount, Data
+        );
 
-    RxFrame.reserve( ExpectedRxFramelength );
-    TxFrame.reserve( 8 + DataByteCount );
-    back_insert_iterator<FrameCont> TxFrameBkInsIt( TxFrame );
-    *TxFrameBkInsIt++ = Context.GetSlaveAddr();
-    *TxFrameBkInsIt++ =
-        static_cast<RegDataType>( FunctionCode::PresetMultipleRegisters );
-    TxFrameBkInsIt =
-        WriteAddressPointCountPair( TxFrameBkInsIt, StartAddr, PointCount );
-    TxFrameBkInsIt =
-        Write( TxFrameBkInsIt, static_cast<uint8_t>( DataByteCount ) );
-
-    for ( RegCountType Idx = 0 ; Idx < PointCount ; ++Idx ) {
-        TxFrameBkInsIt = Write( TxFrameBkInsIt, *Data++ );
+    if ( Context.GetSlaveAddr() == BroadcastAddress ) {
+        Broadcast( Context, TxFrame, retryCount_ );
+        return;
     }
 
-    WriteCRC( TxFrameBkInsIt, TxFrame.begin(), TxFrame.end() );
-
-    back_insert_iterator<FrameCont> RxFrameBkInsIt( RxFrame );
+    FrameCont RxFrame;
+    RxFrame.reserve( GetFrameLength( Codec::ResponseLength ) );
 
     SendAndReceiveFrames(
-        Context, TxFrame, back_inserter( RxFrame ),
-        ExpectedRxFramelength, retryCount_
+        Context, TxFrame,
+        back_inserter( RxFrame ), GetFrameLength( Codec::ResponseLength ), retryCount_
     );
 
-    RegAddrType ReadStartAddr;
-    FrameCont::const_iterator RxInIt = Read( RxFrame.begin(), ReadStartAddr );
-    if ( ReadStartAddr != StartAddr ) {
-        throw EContextException( Context, _D( "Start address mismatch" ) );
-    }
-
-    RegCountType ReadPointCount;
-    RxInIt = Read( RxInIt, ReadPointCount );
-    if ( ReadPointCount != PointCount ) {
-        throw EContextException( Context, _D( "Point count mismatch" ) );
-    }
+    DecodeFrame<Codec>( Context, RxFrame, StartAddr, PointCount );
 }
 //---------------------------------------------------------------------------
 
-//    RTUProtocol::DoReportSlave
+//    RTUFramingProtocol::DoReportSlave
+std::vector<uint8_t> RTUFramingProtocol::DoReportSlave( Context const & Context )
+{
+    using Codec = PDU::Codec<FunctionCode::ReportSlave>;
+
+    // SlaveAddr + FC + ByteCount announce the rest of the frame
+    FrameCont RxFrame;
+    RxFrame.reserve( GetFrameLength( Codec::ResponseLength( Codec::MaxByteCount ) ) );
+
+    Transact(
+        Context, EncodeFrame<Codec>( Context, Codec::RequestLength ), RxFrame,
+        GetFrameLength( Codec::HeaderLength ) - 2,
+        [&Context]( FrameCont const & Header ) {
+            return GetFrameLength(
+                Codec::ResponseLength( Codec::DecodeHeader( Context, &Header[2] ) )
+            );
+        },
+        retryCount_
+    );
 
+    // Skip SlaveAddr + FC, leave out the CRC
+    return Codec::Decode( Context, &RxFrame[2], RxFrame.size() - 4 );
+}
 //---------------------------------------------------------------------------
 
-//    RTUProtocol::DoProgram884_M84
+//    RTUFramingProtocol::DoProgram884_M84
 
 //---------------------------------------------------------------------------
 
-//    RTUProtocol::DoResetCommLink
+//    RTUFramingProtocol::DoResetCommLink
 
 //---------------------------------------------------------------------------
 
-//    RTUProtocol::DoReadGeneralReference
-void RTUProtocol::DoReadGeneralReference( Context const & Context,
-                                          const FileSubRequest* SubRequests,
-                                          size_t SubReqCount,
-                                          RegDataType* Data )
+//    RTUFramingProtocol::DoReadGeneralReference
+void RTUFramingProtocol::DoReadGeneralReference( Context const & Context,
+                                                 const FileSubRequest* SubRequests,
+                                                 size_t SubReqCount,
+                                                 RegDataType* Data )
 {
-    // FC20 request PDU:
-    //   FC(1) + ByteCount(1) + N * [RefType(1) + FileNo(2) + RecNo(2) + RecLen(2)]
-    // Each sub-request group is 7 bytes; RefType is always 0x06.
-    const size_t subReqBytes = SubReqCount * 7;
-
-    FrameCont TxFrame;
-    TxFrame.reserve( 1 + 1 + 1 + subReqBytes + 2 ); // SlaveAddr+FC+ByteCount+subs+CRC
-    back_insert_iterator<FrameCont> TxFrameBkInsIt( TxFrame );
-
-    *TxFrameBkInsIt++ = Context.GetSlaveAddr();
-    *TxFrameBkInsIt++ =
-        static_cast<uint8_t>( FunctionCode::ReadGeneralReference );
-    *TxFrameBkInsIt++ = static_cast<uint8_t>( subReqBytes );
-
-    size_t totalRegs = 0;
-    for ( size_t i = 0; i < SubReqCount; ++i ) {
-        *TxFrameBkInsIt++ = 0x06; // reference type
-        TxFrameBkInsIt = Write( TxFrameBkInsIt, SubRequests[i].FileNumber );
-        TxFrameBkInsIt = Write( TxFrameBkInsIt, SubRequests[i].RecordNumber );
-        TxFrameBkInsIt = Write( TxFrameBkInsIt, SubRequests[i].RecordLength );
-        totalRegs += SubRequests[i].RecordLength;
-    }
-    WriteCRC( TxFrameBkInsIt, TxFrame.begin(), TxFrame.end() );
+    using Codec = PDU::Codec<FunctionCode::ReadGeneralReference>;
 
-    // FC20 response PDU (variable-length):
-    //   SlaveAddr(1) + FC(1) + RespDataLen(1)
-    //   + N * [SubRespLen(1) + RefType(1) + Data(RecordLength*2)]
-    //   + CRC(2)
-    // We use manual I/O like DoReadFIFOQueue because the response is variable-length.
+    Codec::RaiseExceptionIfSubRequestsAreNotValid( Context, SubRequests, SubReqCount );
 
-    if ( onFlowEvent_ )
-        onFlowEvent_( *this, FlowDirection::TX, TxFrame );
-
-    commPort_.PurgeCommPort();
-    commPort_.WriteBuffer(
-        const_cast<FrameCont::value_type*>( &TxFrame[0] ), TxFrame.size()
-    );
-
-    if ( CancelTXEcho ) {
-        for ( FrameCont::size_type Cnt = TxFrame.size() ; Cnt ; --Cnt ) {
-            uint8_t Char;
-            if ( !commPort_.ReadBytes( &Char, 1 ) ) {
-                throw EContextException( Context, _D( "TX echo timeout" ) );
-            }
-        }
-    }
-
-    // Read fixed header: SlaveAddr(1) + FC(1) + RespDataLen(1) = 3
+    // SlaveAddr + FC + RespDataLength announce the rest of the frame
     FrameCont RxFrame;
-    RxFrame.reserve( 3 + SubReqCount * ( 2 + totalRegs * 2 ) + 2 );
-
-    for ( int I = 0; I < 3; ++I ) {
-        uint8_t Char;
-        if ( !commPort_.ReadBytes( &Char, 1 ) ) {
-            throw EContextException( Context, _D( "Timeout error" ) );
-        }
-        RxFrame.push_back( Char );
-
-        if ( I == 1 && ( Char & 0x80 ) ) {
-            // Exception response
-            for ( int J = 0; J < 3; ++J ) {
-                if ( !commPort_.ReadBytes( &Char, 1 ) ) {
-                    throw EContextException( Context, _D( "Timeout error" ) );
-                }
-                RxFrame.push_back( Char );
-            }
-            if ( ComputeCRC( RxFrame.begin(), RxFrame.end() ) ) {
-                throw EContextException( Context, _D( "Bad CRC (RX)" ) );
-            }
-            if ( RxFrame[0] != Context.GetSlaveAddr() ) {
-                throw EContextException( Context, _D( "Slave address mismatch" ) );
-            }
-            RaiseStandardException( Context, ExceptionCode( RxFrame[2] ) );
-        }
-    }
-
-    if ( RxFrame[0] != Context.GetSlaveAddr() ) {
-        throw EContextException( Context, _D( "Slave address mismatch" ) );
-    }
-    if ( RxFrame[1] != static_cast<uint8_t>( FunctionCode::ReadGeneralReference ) ) {
-        throw EContextException( Context, _D( "Function code mismatch" ) );
-    }
-
-    const uint8_t respDataLen = RxFrame[2];
-
-    // Read remaining bytes: respDataLen + CRC(2)
-    const int Remaining = respDataLen + 2;
-    for ( int I = 0; I < Remaining; ++I ) {
-        uint8_t Char;
-        if ( !commPort_.ReadBytes( &Char, 1 ) ) {
-            throw EContextException( Context, _D( "Timeout error" ) );
-        }
-        RxFrame.push_back( Char );
-    }
-
-    if ( onFlowEvent_ ) {
-        onFlowEvent_( *this, FlowDirection::RX, RxFrame );
-    }
-
-    if ( ComputeCRC( RxFrame.begin(), RxFrame.end() ) ) {
-        throw EContextException( Context, _D( "Bad CRC (RX)" ) );
-    }
+    RxFrame.reserve( GetFrameLength( Codec::ResponseLength( SubRequests, SubReqCount ) ) );
+
+    Transact(
+        Context,
+        EncodeFrame<Codec>(
+            Context, Codec::RequestLength( SubReqCount ), SubRequests, SubReqCount
+        ),
+        RxFrame, 3,
+        []( FrameCont const & Header ) { return GetFrameLength( 2 + Header[2] ); },
+        retryCount_
+    );
 
-    // Parse sub-response groups starting at offset 3
-    size_t off = 3;
-    RegDataType* dataOut = Data;
-    for ( size_t i = 0; i < SubReqCount; ++i ) {
-        if ( off >= RxFrame.size() - 2 ) {
-            throw EContextException( Context, _D( "Truncated response" ) );
-        }
-        const uint8_t subRespLen = RxFrame[off++];
-        const uint8_t refType    = RxFrame[off++];
-        if ( refType != 0x06 ) {
-            throw EContextException( Context, _D( "Invalid reference type" ) );
-        }
-        // subRespLen includes RefType(1) + Data(N*2), so data bytes = subRespLen - 1
-        const size_t dataBytes = subRespLen - 1;
-        if ( dataBytes != SubRequests[i].RecordLength * 2 ) {
-            throw EContextException( Context, _D( "Sub-response length mismatch" ) );
-        }
-        for ( RecordLengthType r = 0; r < SubRequests[i].RecordLength; ++r ) {
-            *dataOut++ = static_cast<RegDataType>(
-                ( static_cast<uint16_t>( RxFrame[off] ) << 8 ) |
-                ( static_cast<uint16_t>( RxFrame[off + 1] ) & 0xFF )
-            );
-            off += 2;
-        }
-    }
+    // Skip SlaveAddr + FC, leave out the CRC
+    Codec::Decode( Context, &RxFrame[2], RxFrame.size() - 4, SubRequests, SubReqCount, Data );
 }
 //---------------------------------------------------------------------------
 
-//    RTUProtocol::DoWriteGeneralReference
-void RTUProtocol::DoWriteGeneralReference( Context const & Context,
-                                           const FileSubRequest* SubRequests,
-                                           size_t SubReqCount,
-                                           const RegDataType* Data )
+//    RTUFramingProtocol::DoWriteGeneralReference
+void RTUFramingProtocol::DoWriteGeneralReference( Context const & Context,
+                                                  const FileSubRequest* SubRequests,
+                                                  size_t SubReqCount,
+                                                  const RegDataType* Data )
 {
-    // FC21 request PDU:
-    //   FC(1) + ByteCount(1) + N * [RefType(1) + FileNo(2) + RecNo(2) + RecLen(2) + Data(RecLen*2)]
-    size_t totalRegs = 0;
-    for ( size_t i = 0; i < SubReqCount; ++i )
-        totalRegs += SubRequests[i].RecordLength;
-
-    const size_t reqBytes = SubReqCount * 7 + totalRegs * 2;
-
-    FrameCont TxFrame;
-    TxFrame.reserve( 1 + 1 + 1 + reqBytes + 2 ); // SlaveAddr+FC+ByteCount+data+CRC
-    back_insert_iterator<FrameCont> TxFrameBkInsIt( TxFrame );
-
-    *TxFrameBkInsIt++ = Context.GetSlaveAddr();
-    *TxFrameBkInsIt++ =
-        static_cast<uint8_t>( FunctionCode::WriteGeneralReference );
-    *TxFrameBkInsIt++ = static_cast<uint8_t>( reqBytes );
-
-    const RegDataType* dataIn = Data;
-    for ( size_t i = 0; i < SubReqCount; ++i ) {
-        *TxFrameBkInsIt++ = 0x06; // reference type
-        TxFrameBkInsIt = Write( TxFrameBkInsIt, SubRequests[i].FileNumber );
-        TxFrameBkInsIt = Write( TxFrameBkInsIt, SubRequests[i].RecordNumber );
-        TxFrameBkInsIt = Write( TxFrameBkInsIt, SubRequests[i].RecordLength );
-        for ( RecordLengthType r = 0; r < SubRequests[i].RecordLength; ++r ) {
-            TxFrameBkInsIt = Write( TxFrameBkInsIt, *dataIn++ );
-        }
-    }
-    WriteCRC( TxFrameBkInsIt, TxFrame.begin(), TxFrame.end() );
+    using Codec = PDU::Codec<FunctionCode::WriteGeneralReference>;
 
-    // FC21 response is an echo of the request (variable-length).
-    // Use manual I/O.
+    Codec::RaiseExceptionIfSubRequestsAreNotValid( Context, SubRequests, SubReqCount );
 
-    if ( onFlowEvent_ )
-        onFlowEvent_( *this, FlowDirection::TX, TxFrame );
-
-    commPort_.PurgeCommPort();
-    commPort_.WriteBuffer(
-        const_cast<FrameCont::value_type*>( &TxFrame[0] ), TxFrame.size()
-    );
-
-    if ( CancelTXEcho ) {
-        for ( FrameCont::size_type Cnt = TxFrame.size() ; Cnt ; --Cnt ) {
-            uint8_t Char;
-            if ( !commPort_.ReadBytes( &Char, 1 ) ) {
-                throw EContextException( Context, _D( "TX echo timeout" ) );
-            }
-        }
-    }
-
-    // Read fixed header: SlaveAddr(1) + FC(1) + RespDataLen(1) = 3
+    // The response echoes the request: SlaveAddr + FC + ByteCount announce its length
     FrameCont RxFrame;
-    RxFrame.reserve( TxFrame.size() );
-
-    for ( int I = 0; I < 3; ++I ) {
-        uint8_t Char;
-        if ( !commPort_.ReadBytes( &Char, 1 ) ) {
-            throw EContextException( Context, _D( "Timeout error" ) );
-        }
-        RxFrame.push_back( Char );
-
-        if ( I == 1 && ( Char & 0x80 ) ) {
-            for ( int J = 0; J < 3; ++J ) {
-                if ( !commPort_.ReadBytes( &Char, 1 ) ) {
-                    throw EContextException( Context, _D( "Timeout error" ) );
-                }
-                RxFrame.push_back( Char );
-            }
-            if ( ComputeCRC( RxFrame.begin(), RxFrame.end() ) ) {
-                throw EContextException( Context, _D( "Bad CRC (RX)" ) );
-            }
-            if ( RxFrame[0] != Context.GetSlaveAddr() ) {
-                throw EContextException( Context, _D( "Slave address mismatch" ) );
-            }
-            RaiseStandardException( Context, ExceptionCode( RxFrame[2] ) );
-        }
-    }
-
-    if ( RxFrame[0] != Context.GetSlaveAddr() ) {
-        throw EContextException( Context, _D( "Slave address mismatch" ) );
-    }
-    if ( RxFrame[1] != static_cast<uint8_t>( FunctionCode::WriteGeneralReference ) ) {
-        throw EContextException( Context, _D( "Function code mismatch" ) );
-    }
-
-    const uint8_t respDataLen = RxFrame[2];
-
-    // Read remaining bytes: respDataLen + CRC(2)
-    const int Remaining = respDataLen + 2;
-    for ( int I = 0; I < Remaining; ++I ) {
-        uint8_t Char;
-        if ( !commPort_.ReadBytes( &Char, 1 ) ) {
-            throw EContextException( Context, _D( "Timeout error" ) );
-        }
-        RxFrame.push_back( Char );
-    }
-
-    if ( onFlowEvent_ ) {
-        onFlowEvent_( *this, FlowDirection::RX, RxFrame );
-    }
+    RxFrame.reserve( GetFrameLength( Codec::ResponseLength( SubRequests, SubReqCount ) ) );
+
+    Transact(
+        Context,
+        EncodeFrame<Codec>(
+            Context, Codec::RequestLength( SubRequests, SubReqCount ),
+            SubRequests, SubReqCount, Data
+        ),
+        RxFrame, 3,
+        []( FrameCont const & Header ) { return GetFrameLength( 2 + Header[2] ); },
+        retryCount_
+    );
 
-    if ( ComputeCRC( RxFrame.begin(), RxFrame.end() ) ) {
-        throw EContextException( Context, _D( "Bad CRC (RX)" ) );
-    }
+    // Skip SlaveAddr + FC, leave out the CRC
+    Codec::Decode( Context, &RxFrame[2], RxFrame.size() - 4, SubRequests, SubReqCount, Data );
 }
 //---------------------------------------------------------------------------
 
-//    RTUProtocol::DoMaskWrite4XRegister
-void RTUProtocol::DoMaskWrite4XRegister( Context const & Context,
-                                         RegAddrType Addr,
-                                         RegDataType AndMask,
-                                         RegDataType OrMask )
+//    RTUFramingProtocol::DoMaskWrite4XRegister
+void RTUFramingProtocol::DoMaskWrite4XRegister( Context const & Context,
+                                                RegAddrType Addr,
+                                                RegDataType AndMask,
+                                                RegDataType OrMask )
 {
-    FrameCont TxFrame;
-    const FrameCont::size_type ExpectedRxFramelength = 10;
-    FrameCont RxFrame;
-
-    RxFrame.reserve( ExpectedRxFramelength );
-    TxFrame.reserve( 10 );
+    using Codec = PDU::Codec<FunctionCode::MaskWrite4XRegister>;
 
-    back_insert_iterator<FrameCont> TxFrameBkInsIt( TxFrame );
-
-    *TxFrameBkInsIt++ = Context.GetSlaveAddr();
-    *TxFrameBkInsIt++ =
-        static_cast<RegDataType>( FunctionCode::MaskWrite4XRegister );
-    TxFrameBkInsIt = Write( TxFrameBkInsIt, Addr );
-    TxFrameBkInsIt = Write( TxFrameBkInsIt, AndMask );
-    TxFrameBkInsIt = Write( TxFrameBkInsIt, OrMask );
-    WriteCRC( TxFrameBkInsIt, TxFrame.begin(), TxFrame.end() );
-
-    back_insert_iterator<FrameCont> RxFrameBkInsIt( RxFrame );
+    FrameCont RxFrame;
+    RxFrame.reserve( GetFrameLength( Codec::ResponseLength ) );
 
     SendAndReceiveFrames(
-        Context, TxFrame, back_inserter( RxFrame ),
-        ExpectedRxFramelength, retryCount_
+        Context,
+        EncodeFrame<Codec>( Context, Codec::RequestLength, Addr, AndMask, OrMask ),
+        back_inserter( RxFrame ), GetFrameLength( Codec::ResponseLength ), retryCount_
     );
 
-    RegAddrType ReadAddr;
-    FrameCont::const_iterator RxInIt = Read( RxFrame.begin(), ReadAddr );
-    if ( ReadAddr != Addr ) {
-        throw EContextException( Context, _D( "Address mismatch" ) );
-    }
-
-    RegDataType ReadData;
-    RxInIt = Read( RxInIt, ReadData );
-    if ( ReadData != AndMask ) {
-        throw EContextException( Context, _D( "And Mask mismatch" ) );
-    }
-
-    RxInIt = Read( RxInIt, ReadData );
-    if ( ReadData != OrMask ) {
-        throw EContextException( Context, _D( "Or Mask mismatch" ) );
-    }
+    DecodeFrame<Codec>( Context, RxFrame, Addr, AndMask, OrMask );
 }
 //---------------------------------------------------------------------------
 
-//    RTUProtocol::DoReadWrite4XRegisters
-void RTUProtocol::DoReadWrite4XRegisters( Context const & Context,
-                                          RegAddrType ReadStartAddr,
-                                          RegCountType ReadPointCount,
-                                          RegDataType* ReadData,
-                                          RegAddrType WriteStartAddr,
-                                          RegCountType WritePointCount,
-                                          const RegDataType* WriteData )
+//    RTUFramingProtocol::DoReadWrite4XRegisters
+void RTUFramingProtocol::DoReadWrite4XRegisters( Context const & Context,
+                                                 RegAddrType ReadStartAddr,
+                                                 RegCountType ReadPointCount,
+                                                 RegDataType* ReadData,
+                                                 RegAddrType WriteStartAddr,
+                                                 RegCountType WritePointCount,
+                                                 const RegDataType* WriteData )
 {
-    const size_t WriteByteCount = WritePointCount * sizeof( RegDataType );
+    using Codec = PDU::Codec<FunctionCode::ReadWrite4XRegisters>;
 
-    FrameCont TxFrame;
-    // Response: SlaveAddr(1) + FC(1) + ByteCount(1) + ReadData(ReadPointCount*2) + CRC(2)
-    FrameCont::size_type const ExpectedRxFramelength( ReadPointCount * 2 + 5 );
-    FrameCont RxFrame;
+    Codec::RaiseExceptionIfPointCountIsNotValid( Context, ReadPointCount, WritePointCount );
 
+    FrameCont::size_type const ExpectedRxFramelength(
+        GetFrameLength( Codec::ResponseLength( ReadPointCount ) )
+    );
+    FrameCont RxFrame;
     RxFrame.reserve( ExpectedRxFramelength );
-    TxFrame.reserve( 13 + WriteByteCount );
-    back_insert_iterator<FrameCont> TxFrameBkInsIt( TxFrame );
-    *TxFrameBkInsIt++ = Context.GetSlaveAddr();
-    *TxFrameBkInsIt++ =
-        static_cast<RegDataType>( FunctionCode::ReadWrite4XRegisters );
-    TxFrameBkInsIt =
-        WriteAddressPointCountPair( TxFrameBkInsIt, ReadStartAddr, ReadPointCount );
-    TxFrameBkInsIt =
-        WriteAddressPointCountPair( TxFrameBkInsIt, WriteStartAddr, WritePointCount );
-    TxFrameBkInsIt =
-        Write( TxFrameBkInsIt, static_cast<uint8_t>( WriteByteCount ) );
-
-    for ( RegCountType Idx = 0; Idx < WritePointCount; ++Idx ) {
-        TxFrameBkInsIt = Write( TxFrameBkInsIt, WriteData[Idx] );
-    }
-
-    WriteCRC( TxFrameBkInsIt, TxFrame.begin(), TxFrame.end() );
 
     SendAndReceiveFrames(
-        Context, TxFrame, back_inserter( RxFrame ),
-        ExpectedRxFramelength, retryCount_
+        Context,
+        EncodeFrame<Codec>(
+            Context, Codec::RequestLength( WritePointCount ),
+            ReadStartAddr, ReadPointCount, WriteStartAddr, WritePointCount, WriteData
+        ),
+        back_inserter( RxFrame ), ExpectedRxFramelength, retryCount_
     );
 
-    FrameCont::const_iterator RxInIt = RxFrame.begin();
-
-    const FrameCont::size_type RxByteCount =
-        static_cast<FrameCont::size_type>( *RxInIt++ );
-
-    if ( RxByteCount != ReadPointCount * 2 ) {
-        throw EContextException( Context, _D( "Byte count mismatch" ) );
-    }
-
-    RegCountType Remaining = ReadPointCount;
-    while ( Remaining-- ) {
-        RxInIt = Read( RxInIt, *ReadData++ );
-    }
+    DecodeFrame<Codec>( Context, RxFrame, ReadPointCount, ReadData );
 }
 //---------------------------------------------------------------------------
 
-//    RTUProtocol::DoReadFIFOQueue
-FIFOCountType RTUProtocol::DoReadFIFOQueue( Context const & Context,
-                                            FIFOAddrType FIFOAddr,
-                                            RegDataType* Data )
+//    RTUFramingProtocol::DoReadFIFOQueue
+FIFOCountType RTUFramingProtocol::DoReadFIFOQueue( Context const & Context,
+                                                   FIFOAddrType FIFOAddr,
+                                                   RegDataType* Data )
 {
-    FrameCont TxFrame;
-    // We don't know the FIFO count yet, so first try with max response size:
-    // SlaveAddr(1) + FC(1) + ByteCount(2) + FIFOCount(2) + MaxValues(31*2) + CRC(2) = 70
-    // But SendAndReceiveFrames expects the exact length.
-    // We'll send the request and read a minimal response first to get the count.
-    // Actually, the RTU framing reads byte-by-byte, so we need a two-phase approach:
-    //
-    // Phase 1: Send request, read header to determine FIFO count.
-    // For RTU, SendAndReceiveFrames reads exactly ExpectedRxFramelength bytes.
-    // We must first read the minimum response (no FIFO values) to learn the count,
-    // then read the remaining values. However, the existing RTU framework reads
-    // the full frame in one call.
-    //
-    // Since the RTU protocol reads byte-by-byte with CRC validation, we can use
-    // a max-size approach: request the maximum possible frame length (70 bytes)
-    // but the actual slave response will be shorter. The timeout on missing bytes
-    // triggers a retry, which won't work for variable-length responses.
-    //
-    // Instead, we do manual I/O similar to SendAndReceiveFramesInt but handle
-    // the variable-length response ourselves.
-
-    TxFrame.reserve( 6 );
-    back_insert_iterator<FrameCont> TxFrameBkInsIt( TxFrame );
-
-    *TxFrameBkInsIt++ = Context.GetSlaveAddr();
-    *TxFrameBkInsIt++ =
-        static_cast<RegDataType>( FunctionCode::ReadFIFOQueue );
-    TxFrameBkInsIt = Write( TxFrameBkInsIt, FIFOAddr );
-    WriteCRC( TxFrameBkInsIt, TxFrame.begin(), TxFrame.end() );
-
-    // Read the fixed header portion first:
-    // SlaveAddr(1) + FC(1) + ByteCount(2) + FIFOCount(2) + CRC(2) = 8
-    // Then we know how many more bytes to expect.
-    // However, we need to handle this in a single read because CRC covers everything.
-    //
-    // Alternative: read the fixed header (6 bytes: SlaveAddr+FC+ByteCount+FIFOCount),
-    // compute remaining bytes from FIFOCount, read the rest, then validate CRC.
-    //
-    // For simplicity and consistency with the existing pattern, we use a reasonable
-    // upper bound. The Modbus spec limits FIFO to 31 values, so max frame = 70 bytes.
-    // We'll read exactly 8 bytes first (minimum valid response), extract FIFOCount,
-    // then compute the full expected length and re-read if needed.
-    //
-    // Actually, the cleanest approach that fits the existing architecture:
-    // Just use SendAndReceiveFrames with the minimum header length (8 = empty FIFO),
-    // but that won't work if FIFOCount > 0.
-    //
-    // Let's do a direct serial I/O approach:
-
-    if ( onFlowEvent_ )
-        onFlowEvent_( *this, FlowDirection::TX, TxFrame );
+    using Codec = PDU::Codec<FunctionCode::ReadFIFOQueue>;
 
-    commPort_.PurgeCommPort();
-    commPort_.WriteBuffer(
-        const_cast<FrameCont::value_type*>( &TxFrame[0] ), TxFrame.size()
-    );
+    // The response length depends on the FIFO count, so SendAndReceiveFrames()
+    // (which expects a known frame length) cannot be used: the fixed header
+    // (SlaveAddr + FC + ByteCount + FIFOCount) announces the rest of the frame.
 
-    if ( CancelTXEcho ) {
-        for ( FrameCont::size_type Cnt = TxFrame.size() ; Cnt ; --Cnt ) {
-            uint8_t Char;
-            if ( !commPort_.ReadBytes( &Char, 1 ) ) {
-                throw EContextException( Context, _D( "TX echo timeout" ) );
-            }
-        }
-    }
+    FrameCont const TxFrame =
+        EncodeFrame<Codec>( Context, Codec::RequestLength, FIFOAddr );
 
-    // Read fixed header: SlaveAddr(1) + FC(1) + ByteCount(2) + FIFOCount(2) = 6
     FrameCont RxFrame;
-    RxFrame.reserve( 70 );
-
-    for ( int I = 0; I < 6; ++I ) {
-        uint8_t Char;
-        if ( !commPort_.ReadBytes( &Char, 1 ) ) {
-            throw EContextException( Context, _D( "Timeout error" ) );
-        }
-        RxFrame.push_back( Char );
-
-        // Check for exception response at byte index 1
-        if ( I == 1 && ( Char & 0x80 ) ) {
-            // Exception response: read one more byte (exception code) + CRC(2)
-            for ( int J = 0; J < 3; ++J ) {
-                if ( !commPort_.ReadBytes( &Char, 1 ) ) {
-                    throw EContextException( Context, _D( "Timeout error" ) );
-                }
-                RxFrame.push_back( Char );
-            }
-            // Validate CRC
-            if ( ComputeCRC( RxFrame.begin(), RxFrame.end() ) ) {
-                throw EContextException( Context, _D( "Bad CRC (RX)" ) );
-            }
-            if ( RxFrame[0] != Context.GetSlaveAddr() ) {
-                throw EContextException( Context, _D( "Slave address mismatch" ) );
-            }
-            RaiseStandardException( Context, ExceptionCode( RxFrame[2] ) );
-        }
-    }
-
-    // Validate slave address and function code
-    if ( RxFrame[0] != Context.GetSlaveAddr() ) {
-        throw EContextException( Context, _D( "Slave address mismatch" ) );
-    }
-    if ( RxFrame[1] != static_cast<uint8_t>( FunctionCode::ReadFIFOQueue ) ) {
-        throw EContextException( Context, _D( "Function code mismatch" ) );
-    }
+    RxFrame.reserve( GetFrameLength( Codec::ResponseLength( Codec::MaxFIFOCount ) ) );
 
-    uint16_t const ByteCount =
-        ( static_cast<uint16_t>( RxFrame[2] ) << 8 ) |
-        ( static_cast<uint16_t>( RxFrame[3] ) & 0xFF );
-
-    uint16_t const FIFOCount =
-        ( static_cast<uint16_t>( RxFrame[4] ) << 8 ) |
-        ( static_cast<uint16_t>( RxFrame[5] ) & 0xFF );
-
-    if ( FIFOCount > 31 ) {
-        throw EContextException( Context, _D( "FIFO count exceeds maximum (31)" ) );
-    }
-
-    if ( ByteCount != 2 + FIFOCount * 2 ) {
-        throw EContextException( Context, _D( "Byte count mismatch" ) );
-    }
-
-    // Read remaining bytes: FIFOValues(FIFOCount * 2) + CRC(2)
-    const int Remaining = FIFOCount * 2 + 2;
-    for ( int I = 0; I < Remaining; ++I ) {
-        uint8_t Char;
-        if ( !commPort_.ReadBytes( &Char, 1 ) ) {
-            throw EContextException( Context, _D( "Timeout error" ) );
-        }
-        RxFrame.push_back( Char );
-    }
+    Transact(
+        Context, TxFrame, RxFrame, GetFrameLength( Codec::HeaderLength ) - 2,
+        [&Context]( FrameCont const & Header ) {
+            return GetFrameLength(
+                Codec::ResponseLength( Codec::DecodeHeader( Context, &Header[2] ) )
+            );
+        },
+        retryCount_
+    );
 
-    if ( onFlowEvent_ ) {
-        onFlowEvent_( *this, FlowDirection::RX, RxFrame );
-    }
+    // Skip SlaveAddr + FC, leave out the CRC
+    return Codec::Decode( Context, &RxFrame[2], RxFrame.size() - 4, Data );
+}
+//---------------------------------------------------------------------------
 
-    // Validate CRC over entire frame
-    if ( ComputeCRC( RxFrame.begin(), RxFrame.end() ) ) {
-        throw EContextException( Context, _D( "Bad CRC (RX)" ) );
-    }
+//    RTUFramingProtocol::DoReadDeviceIdentification
+std::optional<DeviceObjectIdType> RTUFramingProtocol::DoReadDeviceIdentification(
+                                                         Context const & Context,
+                                                         ReadDeviceIdCode Code,
+                                                         DeviceObjectIdType ObjectId,
+                                                         DeviceIdentification& Result )
+{
+    using Codec = PDU::Codec<FunctionCode::EncapsulatedInterfaceTransport>;
 
-    // Extract FIFO register values (starting at byte offset 6)
-    for ( FIFOCountType I = 0; I < FIFOCount; ++I ) {
-        int const Off = 6 + I * 2;
-        Data[I] = static_cast<RegDataType>(
-            ( static_cast<uint16_t>( RxFrame[Off] ) << 8 ) |
-            ( static_cast<uint16_t>( RxFrame[Off + 1] ) & 0xFF )
-        );
-    }
+    // No length field: the header gives the object count, each object header the
+    // length of its value
+    FrameCont RxFrame;
+    RxFrame.reserve( MaxFrameLength );
+
+    Transact(
+        Context, EncodeFrame<Codec>( Context, Codec::RequestLength, Code, ObjectId ), RxFrame,
+        GetFrameLength( Codec::HeaderLength ) - 2,
+        []( FrameCont const & Frame ) {
+            return GetFrameLength( Codec::ResponseLength( &Frame[2], Frame.size() - 2 ) );
+        },
+        retryCount_
+    );
 
-    return static_cast<FIFOCountType>( FIFOCount );
+    // Skip SlaveAddr + FC, leave out the CRC
+    return Codec::Decode( Context, &RxFrame[2], RxFrame.size() - 4, Code, ObjectId, Result );
 }
 //---------------------------------------------------------------------------
 
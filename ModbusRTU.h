@@ -1,10 +1,14 @@
 /**
  * @file ModbusRTU.h
- * @brief ERTUParametersError and Modbus::Master::RTUProtocol — serial RS-485 RTU transport.
+ * @brief ERTUParametersError, ERTUBusCollision, Modbus::Master::RTUFramingProtocol and
+ *        Modbus::Master::RTUProtocol — RTU framing and the serial RS-485 RTU transport.
  *
- * @details RTUProtocol implements the Modbus RTU framing protocol over a Win32 serial (COM)
- *  port.  It uses CRC16 framing, supports configurable baud rate, parity, data bits and
- *  stop bits, and performs automatic retry on CRC errors or timeouts.
+ * @details RTUFramingProtocol implements the Modbus RTU framing protocol (slave address,
+ *  PDU, CRC16) on top of an abstract byte transport, and performs automatic retry on CRC
+ *  errors or timeouts.  RTUProtocol is the transport over a Win32 serial (COM) port, with
+ *  configurable baud rate, parity, data bits and stop bits.  RTU frames tunnelled through
+ *  serial device servers are handled by RTUOverTCPProtocolWinSock and
+ *  RTUOverUDPProtocolWinSock.
  *
  *  An optional flow-event callback (TFlowEvent) allows the caller to observe raw TX and RX
  *  frames for diagnostics or logging.
@@ -17,6 +21,7 @@
 //---------------------------------------------------------------------------
 
 #include <vector>
+#include <iterator>
 #include <algorithm>
 
 #include <System.DateUtils.hpp>
@@ -46,6 +51,29 @@
   #define  MODBUS_RTU_DEFAULT_RETRY_COUNT  3
 #endif
 
+#if !defined( MODBUS_RTU_OVER_IP_DEFAULT_RESPONSE_TIMEOUT )
+  /** @brief Default time (ms) an RTU-over-TCP/UDP master waits for the first byte of a response. */
+  #define  MODBUS_RTU_OVER_IP_DEFAULT_RESPONSE_TIMEOUT  1000
+#endif
+
+#if !defined( MODBUS_RTU_OVER_IP_DEFAULT_SEGMENT_TIMEOUT )
+  /**
+   * @brief Default time (ms) an RTU-over-TCP/UDP master waits for the next segment of a
+   *        response that has already started to arrive.
+   */
+  #define  MODBUS_RTU_OVER_IP_DEFAULT_SEGMENT_TIMEOUT  100
+#endif
+
+#if !defined( MODBUS_RTU_DEFAULT_TIMEOUT )
+  /** @brief Default time (ms) a serial RTU master waits for a response to start. */
+  #define  MODBUS_RTU_DEFAULT_TIMEOUT  1000
+#endif
+
+#if !defined( MODBUS_RTU_DEFAULT_BROADCAST_TURNAROUND )
+  /** @brief Default turnaround delay (ms) granted to the slaves after a broadcast request. */
+  #define  MODBUS_RTU_DEFAULT_BROADCAST_TURNAROUND  100
+#endif
+
 //---------------------------------------------------------------------------
 namespace Modbus {
 //---------------------------------------------------------------------------
@@ -63,32 +91,54 @@ public:
     ERTUParametersError( String Msg ) : EBaseException( Msg ) {}
 };
 
+/**
+ * @brief Exception thrown when the TX echo of a half-duplex link differs from the
+ *        transmitted frame.
+ *
+ * @details With CancelTXEcho set, every byte put on a two-wire RS-485 bus is read back.
+ *  A mismatch means another node drove the bus at the same time; the transaction is
+ *  retried like a timeout and this exception is raised once the retries are exhausted.
+ */
+class ERTUBusCollision : public EContextException
+{
+public:
+    /** @brief Constructs with the transaction context and a descriptive message. */
+    ERTUBusCollision( Context const & Context, String Msg )
+      : EContextException( Context, Msg ) {}
+};
+
 //---------------------------------------------------------------------------
 namespace Master {
 //---------------------------------------------------------------------------
 
 /**
- * @brief Modbus RTU master protocol over a Win32 serial (COM) port.
+ * @brief Modbus RTU framing layer over an abstract byte transport.
  *
- * @details RTUProtocol is a concrete transport that frames Modbus requests using the RTU encoding:
- *  each PDU is preceded by the slave address byte and terminated with a two-byte CRC16
- *  (little-endian, using the standard Modbus CRC16 polynomial).  It implements all the
- *  virtual NVI hooks (DoOpen, DoClose, DoReadHoldingRegisters, etc.) defined in Protocol.
+ * @details RTUFramingProtocol frames Modbus requests using the RTU encoding: each PDU is
+ *  preceded by the slave address byte and terminated with a two-byte CRC16 (little-endian,
+ *  using the standard Modbus CRC16 polynomial).  It implements all the function code hooks
+ *  (DoReadHoldingRegisters, etc.) defined in Protocol; concrete subclasses move the bytes
+ *  by implementing DoOpen(), DoClose(), DoIsConnected(), DoInputBufferClear(), DoWrite()
+ *  and DoRead().
+ *
+ *  Responses are read in at most three bulk reads: the first five bytes (enough to tell
+ *  an exception response apart), the rest of a variable-length header (FC20/FC21/FC24)
+ *  and the remainder of the frame.  An FC43/14 response has no length field: after its
+ *  header, every object header read tells how far to read next.
  *
  *  Features:
- *  - Configurable serial port (name, baud rate, parity, data bits, stop bits).
  *  - Automatic retry on timeout or CRC error; retry count defaults to MODBUS_RTU_DEFAULT_RETRY_COUNT.
- *  - Optional TX-echo cancellation for half-duplex RS-485 adapters that loop back transmitted bytes.
+ *    Exception responses are raised at once.
+ *  - Broadcast (slave address 0) for FC05, FC06, FC15 and FC16: the request is sent once and
+ *    no response is awaited; the master only waits for the turnaround delay returned by
+ *    DoGetBroadcastDelay().  Any other function code addressed to slave 0 is rejected.
+ *  - Optional TX-echo cancellation for half-duplex RS-485 links that loop back transmitted bytes.
+ *    The echo and the start of the response are fetched by the same bulk read, and the echo
+ *    is compared with the transmitted frame to detect bus collisions (ERTUBusCollision).
  *  - Optional TFlowEvent callback to observe raw TX/RX frames for diagnostics.
- *  - CancelTXEcho, RetryCount, and TimeoutValue exposed as C++Builder __property members.
- *
- *  **Architecture:** Inherits from Protocol and implements all protected Do…() virtual methods
- *  following the NVI pattern. Public methods are inherited from Protocol.
- *
- *  @note Open the port by calling Protocol::Open() before issuing any requests (inherited method).
- *        Close it with Protocol::Close() when done, or use a SessionManager guard.
+ *  - CancelTXEcho and RetryCount exposed as C++Builder __property members.
  */
-class RTUProtocol : public Protocol {
+class RTUFramingProtocol : public Protocol {
 public:
     /** @brief Container type for raw RTU frame bytes. */
     using FrameCont = std::vector<uint8_t>;
@@ -99,62 +149,115 @@ public:
     /**
      * @brief Signature of the optional frame-flow diagnostic callback.
      * @details Called once for each transmitted frame (FlowDirection::TX) immediately
-     *  before it is written to the COM port, and once for each received frame
-     *  (FlowDirection::RX) immediately after it passes CRC validation.
+     *  before it is written to the transport, and once for each received frame
+     *  (FlowDirection::RX) immediately before it is validated.
      */
     using TFlowEvent =
        void __fastcall ( __closure * )(
-           RTUProtocol& Sender, FlowDirection Dir, const FrameCont& Frame
+           RTUFramingProtocol& Sender, FlowDirection Dir, const FrameCont& Frame
        );
 
     /**
-     * @brief Constructs the RTU protocol object.
-     * @param RetryCount Maximum number of retransmission attempts per transaction
-     *                   (default: MODBUS_RTU_DEFAULT_RETRY_COUNT = 3).
+     * @brief Installs a frame-flow diagnostic callback and returns the previous one.
+     * @param EventHandler New callback (pass @c nullptr to remove the current one).
+     * @return The previously installed callback, or @c nullptr if none was installed.
      */
-    explicit RTUProtocol( int RetryCount = MODBUS_RTU_DEFAULT_RETRY_COUNT );
+    TFlowEvent SetFlowEventHandler( TFlowEvent EventHandler ) noexcept;
 
-    /** @brief Destructor; closes the serial port if it is still open. */
-    ~RTUProtocol();
+    /**
+     * @brief Computes and appends the Modbus CRC16 to an output iterator range.
+     * @tparam OutputIterator Output iterator type (must accept uint8_t values).
+     * @tparam InputIterator  Input iterator type over the frame bytes to checksum.
+     * @param Out   Output iterator to receive the two CRC bytes (LSB first).
+     * @param Begin Iterator to the start of the frame data.
+     * @param End   Iterator past the end of the frame data.
+     * @return Iterator past the written CRC bytes.
+     */
+    template<typename OutputIterator, typename InputIterator>
+    static OutputIterator WriteCRC( OutputIterator Out,
+                                    InputIterator Begin, InputIterator End );
 
-    /** @brief Returns the COM port name (e.g., L"COM1"). */
-    [[ nodiscard ]] String GetCommPort() const;
-    /** @brief Sets the COM port name (e.g., L"COM3"). Must be called before Open(). */
-    void SetCommPort( String Val );
+    /**
+     * @brief When @c true, the protocol reads back echoed TX bytes (half-duplex RS-485),
+     *        checks them against the transmitted frame and discards them.
+     */
+    __property bool CancelTXEcho = { read = cancelTXEcho_, write = cancelTXEcho_ };
 
-    /** @brief Returns the configured baud rate (e.g., 9600, 19200). */
-    [[ nodiscard ]] int GetCommSpeed() const noexcept;
-    /** @brief Sets the baud rate. Must be called before Open(). */
-    void SetCommSpeed( int Val );
+    /** @brief Maximum number of retransmission attempts on timeout or CRC error. */
+    __property int RetryCount = { read = retryCount_, write = retryCount_ };
 
-    /** @brief Returns the configured parity (NOPARITY, ODDPARITY, EVENPARITY, etc.). */
-    [[ nodiscard ]] int GetCommParity() const noexcept;
-    /** @brief Sets the parity. Must be called before Open(). */
-    void SetCommParity( int Val );
+    /** @brief Slave address that makes a write request a broadcast. */
+    static constexpr Context::SlaveAddrType BroadcastAddress = 0;
 
-    /** @brief Returns the configured data bits (typically 8). */
-    [[ nodiscard ]] int GetCommBits() const noexcept;
-    /** @brief Sets the data bits. Must be called before Open(). */
-    void SetCommBits( int Val );
+    /**
+     * @brief Time (ms) the slaves are given to process a broadcast before the next request
+     *        (default: MODBUS_RTU_DEFAULT_BROADCAST_TURNAROUND).
+     */
+    __property unsigned BroadcastTurnaround = { read = broadcastTurnaround_, write = broadcastTurnaround_ };
 
-    /** @brief Returns the configured stop bits (ONESTOPBIT, TWOSTOPBITS, etc.). */
-    [[ nodiscard ]] int GetCommStopBits() const noexcept;
-    /** @brief Sets the stop bits. Must be called before Open(). */
-    void SetCommStopBits( int Val );
+    /** @brief Returns the time (ms) the transport waits for a response to start. */
+    [[ nodiscard ]] unsigned GetResponseTimeout() const { return DoGetResponseTimeout(); }
+
+    /** @brief Sets the time (ms) the transport waits for a response to start. */
+    void SetResponseTimeout( unsigned Val ) { DoSetResponseTimeout( Val ); }
 
     /**
-     * @brief Installs a frame-flow diagnostic callback and returns the previous one.
-     * @param EventHandler New callback (pass @c nullptr to remove the current one).
-     * @return The previously installed callback, or @c nullptr if none was installed.
+     * @brief Returns the time (us) the line needs to carry @p FrameLength characters,
+     *        or 0 if the transport does not know its line speed (RTU over TCP/UDP).
      */
-    TFlowEvent SetFlowEventHandler( TFlowEvent EventHandler ) noexcept;
-
+    [[ nodiscard ]] unsigned GetFrameTime( FrameCont::size_type FrameLength ) const {
+        return DoGetFrameTime( FrameLength );
+    }
 protected:
-    virtual String DoGetProtocolName() const override { return _D( "Modbus RTU" ); }
-    virtual String DoGetProtocolParamsStr() const override;
-    virtual void DoOpen() override;
-    virtual void DoClose() override;
-    virtual bool DoIsConnected() const noexcept override;
+    /**
+     * @brief Constructs the framing layer.
+     * @param RetryCount Maximum number of retransmission attempts per transaction.
+     */
+    explicit RTUFramingProtocol( int RetryCount );
+
+    /** @brief Discards any byte already received, before a request is sent. */
+    virtual void DoInputBufferClear() = 0;
+
+    /**
+     * @brief Transmits a complete request frame.
+     * @throws EBaseException (or a subclass) on a transport failure.
+     */
+    virtual void DoWrite( FrameCont const & TxFrame ) = 0;
+
+    /**
+     * @brief Reads up to @p Length bytes into @p Buffer.
+     * @param FrameStart @c true for the first read of a frame (response or TX echo), so
+     *                   the transport can allow for the slave turnaround time.
+     * @return Number of bytes read; less than @p Length means that the read timed out.
+     * @throws EBaseException (or a subclass) on a transport failure.
+     */
+    virtual size_t DoRead( uint8_t* Buffer, size_t Length, bool FrameStart ) = 0;
+
+    /**
+     * @brief Returns the time (ms) to wait after a broadcast frame of @p FrameLength bytes
+     *        has been written.
+     * @details The default returns BroadcastTurnaround.  A serial transport adds the time
+     *  the frame needs to leave the UART and the 3.5 character inter-frame silence.
+     */
+    virtual unsigned DoGetBroadcastDelay( FrameCont::size_type FrameLength ) const;
+
+    /** @brief Returns the response timeout (ms) of the transport. */
+    virtual unsigned DoGetResponseTimeout() const = 0;
+
+    /** @brief Changes the response timeout (ms) of the transport. */
+    virtual void DoSetResponseTimeout( unsigned Val ) = 0;
+
+    /** @brief Line time (us) of @p FrameLength characters; the default returns 0. */
+    virtual unsigned DoGetFrameTime( FrameCont::size_type FrameLength ) const { return 0; }
+
+    /**
+     * @brief Returns the response timeout (ms) of the transaction in progress: the
+     *        Timeout of its TransactionPolicy, or DoGetResponseTimeout() if not set.
+     * @details The DoRead() overrides wait this long for a response to start.
+     */
+    [[ nodiscard ]] unsigned GetTransactionTimeout() const {
+        return transactionTimeout_.value_or( DoGetResponseTimeout() );
+    }
 
     virtual void DoReadCoilStatus( Context const & Context,
                                    CoilAddrType StartAddr,
@@ -185,8 +288,8 @@ protected:
                                        RegDataType Data ) override;
 //    DoProgram484
 //    DoPoll484
-//    DoFetchCommEventCtr
-//    DoFetchCommEventLog
+    virtual CommEventCounter DoFetchCommEventCtr( Context const & Context ) override;
+    virtual CommEventLog DoFetchCommEventLog( Context const & Context ) override;
 //    DoProgramController
 //    DoPollController
     virtual void DoForceMultipleCoils( Context const & Context,
@@ -198,7 +301,7 @@ protected:
                                     RegCountType PointCount,
                                     const RegDataType* Data ) override;
 
-//    DoReportSlave
+    virtual std::vector<uint8_t> DoReportSlave( Context const & Context ) override;
 //    DoProgram884_M84
 //    DoResetCommLink
     virtual void DoReadGeneralReference( Context const & Context,
@@ -223,14 +326,19 @@ protected:
     virtual FIFOCountType DoReadFIFOQueue( Context const & Context,
                                           FIFOAddrType FIFOAddr,
                                           RegDataType* Data ) override;
+    virtual std::optional<DeviceObjectIdType> DoReadDeviceIdentification(
+                                                  Context const & Context,
+                                                  ReadDeviceIdCode Code,
+                                                  DeviceObjectIdType ObjectId,
+                                                  DeviceIdentification& Result ) override;
 private:
 
     static Context const DefaultRTUContext;
 
-    TCommPort commPort_;
     bool cancelTXEcho_;
     int retryCount_;
-    unsigned timeoutValue_;
+    unsigned broadcastTurnaround_ { MODBUS_RTU_DEFAULT_BROADCAST_TURNAROUND };
+    std::optional<unsigned> transactionTimeout_;
     TFlowEvent onFlowEvent_;
 
   #if defined ( _DEBUG ) && defined( VIEW_RTU_PROTOCOL_DIAG )
@@ -238,121 +346,221 @@ private:
     void ShowBuffer( const P& Prefix, It Begin, It End );
   #endif
 
+    /** @brief Length of an exception response frame, and of the shortest valid response. */
+    static constexpr FrameCont::size_type ExceptionFrameLength = 5;
+
+    /** @brief Maximum length of an RTU frame (Modbus over serial line, 2.5.1.1). */
+    static constexpr FrameCont::size_type MaxFrameLength = 256;
+
     template<typename OutputIterator>
     void SendAndReceiveFrames( Context const & Context,
                                const FrameCont& TxFrame, OutputIterator Out,
                                FrameCont::size_type RxFramelength,
                                int RetryCount );
 
-    template<typename OutputIterator>
-    bool SendAndReceiveFramesInt( Context const & Context,
-                                  const FrameCont& TxFrame, OutputIterator Out,
-                                  FrameCont::size_type RxFramelength,
-                                  bool NoThrow );
+    /**
+     * @brief Sends @p TxFrame and receives the response into @p RxFrame, retrying on
+     *        timeout, CRC error or mismatched response.
+     * @details The TransactionPolicy of @p Context (completed by the slave policy)
+     *  overrides @p RetryCount and the response timeout, and sets the pause before
+     *  each retry.
+     * @param HeaderLength     Number of bytes needed by @p GetRxFrameLength.
+     * @param GetRxFrameLength Callable that returns the total length of the response
+     *                         frame given its first @p HeaderLength bytes.  It is called
+     *                         again once that many bytes are read, and the reading goes
+     *                         on while the length grows (responses read in stages).
+     */
+    template<typename FrameLengthFn>
+    void Transact( Context const & Context,
+                   const FrameCont& TxFrame, FrameCont& RxFrame,
+                   FrameCont::size_type HeaderLength, FrameLengthFn GetRxFrameLength,
+                   int RetryCount );
+
+    template<typename FrameLengthFn>
+    bool TransactInt( Context const & Context,
+                      const FrameCont& TxFrame, FrameCont& RxFrame,
+                      FrameCont::size_type HeaderLength, FrameLengthFn GetRxFrameLength,
+                      bool NoThrow );
 
-    template<typename OutputIterator>
-    static OutputIterator Write( OutputIterator Out, uint8_t Data );
+    /**
+     * @brief Sends a broadcast frame, retrying only when its TX echo is corrupted, then
+     *        waits for the broadcast turnaround delay.
+     */
+    void Broadcast( Context const & Context, const FrameCont& TxFrame, int RetryCount );
 
-    template<typename OutputIterator>
-    static OutputIterator Write( OutputIterator Out, uint16_t Data );
+    /** @brief Reports @p TxFrame to the diagnostics, clears the input and writes it. */
+    void SendFrame( const FrameCont& TxFrame );
 
-    template<typename InputIterator>
-    static InputIterator Read( InputIterator In, uint16_t& Data );
+    /**
+     * @brief Reads back the TX echo of @p TxFrame together with up to @p Lookahead bytes
+     *        of the response, which are left in @p RxFrame.
+     * @return @c false (only if @p NoThrow) on echo timeout or mismatch.
+     * @throws ERTUBusCollision if the echo differs from @p TxFrame.
+     */
+    bool ReadTXEcho( Context const & Context, const FrameCont& TxFrame, FrameCont& RxFrame,
+                     FrameCont::size_type Lookahead, bool NoThrow );
+
+    /** @brief Appends @p Count bytes read from the transport; @c false on timeout. */
+    bool ReadFrameBytes( FrameCont& RxFrame, FrameCont::size_type Count, bool FrameStart );
 
     template<typename InputIterator>
     static uint16_t ComputeCRC( InputIterator Begin, InputIterator End );
 
-    template<typename OutputIterator>
-    static OutputIterator WriteAddressPointCountPair( OutputIterator Out,
-                                                      RegAddrType StartAddr,
-                                                      RegCountType PointCount );
-
-    template<typename T>
-    __int64 GetMinimumFrameTime( T FrameLen ) const;
-
-    unsigned int GetParityBitCount() const;
-    unsigned int GetStopBitCount() const;
-
-//    static unsigned __int64 GetSystemTimeAsUint64();
-//    unsigned __int64 GetTimeoutIntervalAsUint64() const;
+    /** @brief RTU frame length for a PDU of @p PDULength bytes (slave address and CRC added). */
+    static constexpr FrameCont::size_type GetFrameLength( size_t PDULength ) noexcept {
+        return 1 + PDULength + 2;
+    }
 
-    static String ParityToStr( int Val );
-    static String StopBitsToStr( int Val );
+    /**
+     * @brief Builds a request frame: slave address, the PDU written by
+     *        @p CodecT::Encode( Args... ) and the CRC.
+     */
+    template<typename CodecT, typename... ArgsT>
+    static FrameCont EncodeFrame( Context const & Context, size_t PDULength,
+                                  ArgsT... Args );
 
+    /**
+     * @brief Passes a frame received by SendAndReceiveFrames() (PDU body followed
+     *        by the CRC) to @p CodecT::Decode.
+     */
+    template<typename CodecT, typename... ArgsT>
+    static auto DecodeFrame( Context const & Context, FrameCont const & RxFrame,
+                             ArgsT... Args );
 
-    void ReadRegisters( FunctionCode FnCode, Context const & Context,
+    template<FunctionCode FC>
+    void ReadRegisters( Context const & Context,
                         RegAddrType StartAddr, RegCountType PointCount,
                         RegDataType* Data );
 
-    void ReadBits( FunctionCode FnCode, Context const & Context,
+    template<FunctionCode FC>
+    void ReadBits( Context const & Context,
                    CoilAddrType StartAddr, CoilCountType PointCount,
                    CoilDataType* Data );
+};
+//---------------------------------------------------------------------------
 
+/**
+ * @brief Modbus RTU master protocol over a Win32 serial (COM) port.
+ *
+ * @details RTUProtocol is the serial transport of RTUFramingProtocol: the RTU framing and
+ *  every function code are inherited, the transport hooks are implemented on a TCommPort.
+ *
+ *  Features:
+ *  - Configurable serial port (name, baud rate, parity, data bits, stop bits).
+ *  - TimeoutValue exposed as a C++Builder __property member.
+ *
+ *  @note Open the port by calling Protocol::Open() before issuing any requests (inherited method).
+ *        Close it with Protocol::Close() when done, or use a SessionManager guard.
+ */
+class RTUProtocol : public RTUFramingProtocol {
 public:
     /**
-     * @brief Computes and appends the Modbus CRC16 to an output iterator range.
-     * @tparam OutputIterator Output iterator type (must accept uint8_t values).
-     * @tparam InputIterator  Input iterator type over the frame bytes to checksum.
-     * @param Out   Output iterator to receive the two CRC bytes (LSB first).
-     * @param Begin Iterator to the start of the frame data.
-     * @param End   Iterator past the end of the frame data.
-     * @return Iterator past the written CRC bytes.
+     * @brief Constructs the RTU protocol object.
+     * @param RetryCount Maximum number of retransmission attempts per transaction
+     *                   (default: MODBUS_RTU_DEFAULT_RETRY_COUNT = 3).
      */
-    template<typename OutputIterator, typename InputIterator>
-    static OutputIterator WriteCRC( OutputIterator Out,
-                                    InputIterator Begin, InputIterator End );
+    explicit RTUProtocol( int RetryCount = MODBUS_RTU_DEFAULT_RETRY_COUNT );
 
-    /** @brief When @c true, the protocol reads back and discards echoed TX bytes (half-duplex RS-485). */
-    __property bool CancelTXEcho = { read = cancelTXEcho_, write = cancelTXEcho_ };
+    /** @brief Destructor; closes the serial port if it is still open. */
+    ~RTUProtocol();
 
-    /** @brief Maximum number of retransmission attempts on timeout or CRC error. */
-    __property int RetryCount = { read = retryCount_, write = retryCount_ };
+    /** @brief Returns the COM port name (e.g., L"COM1"). */
+    [[ nodiscard ]] String GetCommPort() const;
+    /** @brief Sets the COM port name (e.g., L"COM3"). Must be called before Open(). */
+    void SetCommPort( String Val );
+
+    /** @brief Returns the configured baud rate (e.g., 9600, 19200). */
+    [[ nodiscard ]] int GetCommSpeed() const noexcept;
+    /** @brief Sets the baud rate. Must be called before Open(). */
+    void SetCommSpeed( int Val );
+
+    /** @brief Returns the configured parity (NOPARITY, ODDPARITY, EVENPARITY, etc.). */
+    [[ nodiscard ]] int GetCommParity() const noexcept;
+    /** @brief Sets the parity. Must be called before Open(). */
+    void SetCommParity( int Val );
 
-    /** @brief Per-character read timeout in milliseconds used by the serial port. */
+    /** @brief Returns the configured data bits (typically 8). */
+    [[ nodiscard ]] int GetCommBits() const noexcept;
+    /** @brief Sets the data bits. Must be called before Open(). */
+    void SetCommBits( int Val );
+
+    /** @brief Returns the configured stop bits (ONESTOPBIT, TWOSTOPBITS, etc.). */
+    [[ nodiscard ]] int GetCommStopBits() const noexcept;
+    /** @brief Sets the stop bits. Must be called before Open(). */
+    void SetCommStopBits( int Val );
+
+    /** @brief Returns @c true if the serial port uses overlapped (event-driven) I/O. */
+    [[ nodiscard ]] bool GetCommOverlapped() const noexcept;
+    /**
+     * @brief Selects overlapped I/O (default: off): each read then waits for the response
+     *        timeout of its own transaction, without reprogramming the port timeouts.
+     *        Must be called before Open().
+     */
+    void SetCommOverlapped( bool Val );
+
+    /**
+     * @brief Read timeout (ms) of the serial port: the longest wait for a response to
+     *        start (default: MODBUS_RTU_DEFAULT_TIMEOUT).
+     */
     __property unsigned TimeoutValue = { read = timeoutValue_, write = timeoutValue_ };
-};
-//---------------------------------------------------------------------------
+protected:
+    virtual String DoGetProtocolName() const override { return _D( "Modbus RTU" ); }
+    virtual String DoGetProtocolParamsStr() const override;
+    virtual void DoOpen() override;
+    virtual void DoClose() override;
+    virtual bool DoIsConnected() const noexcept override;
+    virtual void DoInputBufferClear() override;
+    virtual void DoWrite( FrameCont const & TxFrame ) override;
+    virtual size_t DoRead( uint8_t* Buffer, size_t Length, bool FrameStart ) override;
+    virtual unsigned DoGetBroadcastDelay( FrameCont::size_type FrameLength ) const override;
+    virtual unsigned DoGetResponseTimeout() const override { return timeoutValue_; }
+    virtual void DoSetResponseTimeout( unsigned Val ) override;
+    virtual unsigned DoGetFrameTime( FrameCont::size_type FrameLength ) const override;
+private:
+    TCommPort commPort_;
+    unsigned timeoutValue_ { MODBUS_RTU_DEFAULT_TIMEOUT };
 
-template<typename OutputIterator>
-OutputIterator RTUProtocol::Write( OutputIterator Out, uint8_t Data )
-{
-    *Out++ = Data;
-    return Out;
-}
-//---------------------------------------------------------------------------
+    template<typename T>
+    __int64 GetMinimumFrameTime( T FrameLen ) const;
 
-template<typename OutputIterator>
-OutputIterator RTUProtocol::Write( OutputIterator Out, uint16_t Data )
-{
-    *Out++ = ( Data >> 8 ) & 0xFF;   // Data Hi
-    *Out++ = Data & 0xFF;            // Data Lo
-    return Out;
-}
+    unsigned int GetParityBitCount() const;
+    unsigned int GetStopBitCount() const;
+
+//    static unsigned __int64 GetSystemTimeAsUint64();
+//    unsigned __int64 GetTimeoutIntervalAsUint64() const;
+
+    static String ParityToStr( int Val );
+    static String StopBitsToStr( int Val );
+};
 //---------------------------------------------------------------------------
 
-template<typename InputIterator>
-InputIterator RTUProtocol::Read( InputIterator In, uint16_t& Data )
+template<typename CodecT, typename... ArgsT>
+RTUFramingProtocol::FrameCont RTUFramingProtocol::EncodeFrame( Context const & Context,
+                                                               size_t PDULength,
+                                                               ArgsT... Args )
 {
-    uint16_t const HiData = static_cast<uint16_t>( *In++ & 0xFF ) << 8;
-    Data = HiData + *In++;
-    return In;
+    FrameCont TxFrame;
+    TxFrame.reserve( GetFrameLength( PDULength ) );
+    std::back_insert_iterator<FrameCont> TxFrameBkInsIt( TxFrame );
+    *TxFrameBkInsIt++ = Context.GetSlaveAddr();
+    TxFrameBkInsIt = CodecT::Encode( TxFrameBkInsIt, Args... );
+    WriteCRC( TxFrameBkInsIt, TxFrame.begin(), TxFrame.end() );
+    return TxFrame;
 }
 //---------------------------------------------------------------------------
 
-template<typename OutputIterator>
-OutputIterator RTUProtocol::WriteAddressPointCountPair( OutputIterator Out,
-                                                        RegAddrType StartAddr,
-                                                        RegCountType PointCount )
+template<typename CodecT, typename... ArgsT>
+auto RTUFramingProtocol::DecodeFrame( Context const & Context, FrameCont const & RxFrame,
+                                      ArgsT... Args )
 {
-    Out = Write( Out, StartAddr );
-    return Write( Out, PointCount );
+    return CodecT::Decode( Context, RxFrame.data(), RxFrame.size() - 2, Args... );
 }
 //---------------------------------------------------------------------------
 
 template<typename OutputIterator, typename InputIterator>
-OutputIterator RTUProtocol::WriteCRC( OutputIterator Out,
-                                            InputIterator Begin,
-                                            InputIterator End )
+OutputIterator RTUFramingProtocol::WriteCRC( OutputIterator Out,
+                                             InputIterator Begin,
+                                             InputIterator End )
 {
     uint16_t const CRC = ComputeCRC( Begin, End );
     *Out++ = CRC & 0xFF;
@@ -362,7 +570,7 @@ OutputIterator RTUProtocol::WriteCRC( OutputIterator Out,
 //---------------------------------------------------------------------------
 
 template<typename InputIterator>
-uint16_t RTUProtocol::ComputeCRC( InputIterator Begin, InputIterator End )
+uint16_t RTUFramingProtocol::ComputeCRC( InputIterator Begin, InputIterator End )
 {
     return std::for_each( Begin, End, boost::crc_16_type( 0xFFFF ) ).checksum();
 }
@@ -370,7 +578,7 @@ uint16_t RTUProtocol::ComputeCRC( InputIterator Begin, InputIterator End )
 
 #if defined ( _DEBUG ) && defined( VIEW_RTU_PROTOCOL_DIAG )
 template<typename P, typename It>
-void RTUProtocol::ShowBuffer( const P& Prefix, It Begin, It End )
+void RTUFramingProtocol::ShowBuffer( const P& Prefix, It Begin, It End )
 {
     String Msg = String( Prefix );
     while ( Begin != End ) {
@@ -381,112 +589,141 @@ void RTUProtocol::ShowBuffer( const P& Prefix, It Begin, It End )
 #endif
 
 template<typename OutputIterator>
-void RTUProtocol::SendAndReceiveFrames( Context const & Context,
-                                        const FrameCont& TxFrame, OutputIterator Out,
-                                        FrameCont::size_type RxFramelength,
-                                        int RetryCount )
+void RTUFramingProtocol::SendAndReceiveFrames( Context const & Context,
+                                               const FrameCont& TxFrame, OutputIterator Out,
+                                               FrameCont::size_type RxFramelength,
+                                               int RetryCount )
 {
-    for ( int Idx = 0 ; ; ++Idx ) {
-        if ( SendAndReceiveFramesInt( Context, TxFrame, Out, RxFramelength, Idx < RetryCount ) ) {
-            break;
-        }
-    }
-}
-
-template<typename OutputIterator>
-bool RTUProtocol::SendAndReceiveFramesInt( Context const & Context,
-                                           const FrameCont& TxFrame, OutputIterator Out,
-                                           FrameCont::size_type RxFramelength,
-                                           bool NoThrow )
-{
-    static const FrameCont::size_type EatEchoExtraCharCount = 0;
-
     FrameCont RxFrame;
+    RxFrame.reserve( RxFramelength );
 
-    RxFrame.reserve( 200 );
-
-#if defined ( _DEBUG ) && defined( VIEW_RTU_PROTOCOL_DIAG )
-    ShowBuffer(
-        Format(
-            _D( "TX(%s): " ), ARRAYOFCONST( ( commPort_.GetCommPort().c_str() ) )
-        ),
-        TxFrame.begin(), TxFrame.end()
+    Transact(
+        Context, TxFrame, RxFrame, ExceptionFrameLength,
+        [RxFramelength]( FrameCont const & ) { return RxFramelength; },
+        RetryCount
     );
-#endif
-    if ( onFlowEvent_ )
-        onFlowEvent_( *this, FlowDirection::TX, TxFrame );
 
-    commPort_.PurgeCommPort();
-
-    commPort_.WriteBuffer(
-        const_cast<FrameCont::value_type*>( &TxFrame[0] ), TxFrame.size()
-    );
+    std::copy( RxFrame.begin() + 2, RxFrame.end(), Out );
+}
+//---------------------------------------------------------------------------
 
-    if ( CancelTXEcho ) {
-        for ( FrameCont::size_type Cnt = TxFrame.size() + EatEchoExtraCharCount ; Cnt ; --Cnt ) {
-            uint8_t Char;
-
-            if ( !commPort_.ReadBytes( &Char, 1 ) ) {
-                    if ( NoThrow ) {
-                        return false;
-                    }
-                    else {
-                        throw EContextException(
-                            Context,
-                            SysErrorMessage( GetLastError() )
-                        );
-                    }
-            }
-        }
+template<typename FrameLengthFn>
+void RTUFramingProtocol::Transact( Context const & Context,
+                                   const FrameCont& TxFrame, FrameCont& RxFrame,
+                                   FrameCont::size_type HeaderLength,
+                                   FrameLengthFn GetRxFrameLength,
+                                   int RetryCount )
+{
+    // Slaves never answer a broadcast: waiting for a response would only time out
+    if ( TxFrame[0] == BroadcastAddress ) {
+        throw EContextException(
+            Context, _D( "Broadcast not supported by this function code" )
+        );
     }
 
-    boost::crc_16_type Crc( 0xFFFF );
+    TransactionPolicy Policy = GetEffectivePolicy( Context );
+    int const Retries = Policy.RetryCount.value_or( RetryCount );
 
-    for ( FrameCont::size_type Idx = 0 ; Idx < RxFramelength ; ++Idx ) {
-        uint8_t Char;
-        if ( unsigned int const BytesRead = commPort_.ReadBytes( &Char, 1 ) ) {
-            Crc.process_byte( Char );
-            RxFrame.push_back( Char );
+    for ( int Idx = 0 ; ; ++Idx ) {
+        WaitBeforeRetry( Policy.Backoff.value_or( 0 ), Idx );
+        // An adaptive timeout grows after every unanswered attempt
+        if ( Idx && GetAdaptiveTimeout() ) {
+            Policy = GetEffectivePolicy( Context );
+        }
+        transactionTimeout_ = Policy.Timeout;
+        bool const Answered =
+            RunAttempt(
+                Context, Idx,
+                [&]() {
+                    return TransactInt( Context, TxFrame, RxFrame, HeaderLength,
+                                        GetRxFrameLength, Idx < Retries );
+                }
+            );
+        if ( Answered ) {
+            break;
+        }
+    }
+}
+//---------------------------------------------------------------------------
 
-            if ( ( Char & 0x80 ) && Idx == 1 ) {
-//#if defined( _DEBUG )
-//::OutputDebugString( Format( _D( "%.2X" ), ARRAYOFCONST( ( int( Char ) ) ) ).c_str() );
-//endif
-                RxFramelength = 5;
-            }
+template<typename FrameLengthFn>
+bool RTUFramingProtocol::TransactInt( Context const & Context,
+                                      const FrameCont& TxFrame, FrameCont& RxFrame,
+                                      FrameCont::size_type HeaderLength,
+                                      FrameLengthFn GetRxFrameLength,
+                                      bool NoThrow )
+{
+    SendFrame( TxFrame );
 
-        }
-        else if ( NoThrow ) {
+    // Every response is at least as long as an exception response: read that much
+    // first, then the rest of the header (if any) and finally the rest of the frame.
+    RxFrame.clear();
+    bool Complete;
+    if ( CancelTXEcho ) {
+        // The read that returns the echo also returns the start of the response
+        if ( !ReadTXEcho( Context, TxFrame, RxFrame, ExceptionFrameLength, NoThrow ) ) {
             return false;
         }
-        else if ( !BytesRead ) {
-            throw EContextException(
-                Context,
-                _D( "Timeout error" )
-            );
+        // A short read means the transport timeout already elapsed: go on reading only
+        // if the response has started
+        Complete =
+            RxFrame.size() == ExceptionFrameLength ||
+            ( !RxFrame.empty() &&
+              ReadFrameBytes( RxFrame, ExceptionFrameLength - RxFrame.size(), false ) );
+    }
+    else {
+        Complete = ReadFrameBytes( RxFrame, ExceptionFrameLength, true );
+    }
+    bool const IsException = Complete && ( RxFrame[1] & 0x80 );
+
+    if ( Complete && !IsException ) {
+        if ( HeaderLength > RxFrame.size() ) {
+            Complete = ReadFrameBytes( RxFrame, HeaderLength - RxFrame.size(), false );
         }
-        else {
-            throw EContextException(
-                Context,
-                SysErrorMessage( GetLastError() )
-            );
+        // A response read in stages (FC43) announces a longer frame once the bytes
+        // read in place of the CRC are given back: read until the length settles
+        FrameCont::size_type RxFramelength {};
+        while ( Complete ) {
+            FrameCont::size_type const Length = GetRxFrameLength( RxFrame );
+            if ( Length == RxFramelength ) {
+                break;
+            }
+            if ( Length < RxFrame.size() || Length > MaxFrameLength ) {
+                if ( NoThrow ) {
+                    return false;
+                }
+                else {
+                    throw EContextException( Context, _D( "Invalid frame length" ) );
+                }
+            }
+            RxFramelength = Length;
+            Complete = ReadFrameBytes( RxFrame, RxFramelength - RxFrame.size(), false );
         }
     }
 
 #if defined ( _DEBUG ) && defined( VIEW_RTU_PROTOCOL_DIAG )
     ShowBuffer(
         Format(
-            _D( "RX(%s): " ), ARRAYOFCONST( ( commPort_.GetCommPort().c_str() ) )
+            _D( "RX(%s): " ), ARRAYOFCONST( ( GetProtocolParamsStr() ) )
         ),
         RxFrame.begin(), RxFrame.end()
     );
 #endif
 
+    if ( !Complete ) {
+        if ( NoThrow ) {
+            return false;
+        }
+        else {
+            throw EContextException( Context, _D( "Timeout error" ) );
+        }
+    }
+
     if ( onFlowEvent_ ) {
         onFlowEvent_( *this, FlowDirection::RX, RxFrame );
     }
 
-    if ( Crc.checksum() ) {
+    if ( ComputeCRC( RxFrame.begin(), RxFrame.end() ) ) {
         if ( NoThrow ) {
             return false;
         }
@@ -504,22 +741,20 @@ bool RTUProtocol::SendAndReceiveFramesInt( Context const & Context,
         }
     }
 
+    // A well-formed exception response is the slave's answer: retrying cannot change it
+    if ( IsException && ( RxFrame[1] & 0x7F ) == TxFrame[1] ) {
+        RaiseStandardException( Context, ExceptionCode( RxFrame[2] ) );
+    }
+
     if ( RxFrame[1] != TxFrame[1] ) {
         if ( NoThrow ) {
             return false;
         }
         else {
-            if ( RxFrame[1] & 0x80 ) {
-                RaiseStandardException( Context, ExceptionCode( RxFrame[2] ) );
-            }
-            else {
-                throw EContextException( Context, _D( "Function code mismatch" ) );
-            }
+            throw EContextException( Context, _D( "Function code mismatch" ) );
         }
     }
 
-    std::copy( RxFrame.begin() + 2, RxFrame.end(), Out );
-
     return true;
 }
 //---------------------------------------------------------------------------
@@ -531,4 +766,3 @@ bool RTUProtocol::SendAndReceiveFramesInt( Context const & Context,
 }; // End of namespace Modbus
 //---------------------------------------------------------------------------
 #endif
-
@@ -0,0 +1,146 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include "ModbusRTUOverTCP_WinSock.h"
+#include "ModbusWinSock.h"
+
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+#pragma comment( lib, "ws2_32" )
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace Master {
+//---------------------------------------------------------------------------
+
+RTUOverTCPProtocolWinSock::RTUOverTCPProtocolWinSock( String Host, uint16_t Port,
+                                                      int RetryCount )
+    : RTUFramingProtocol( RetryCount )
+    , host_( Host ), port_( Port ), socket_( INVALID_SOCKET )
+{
+    WSADATA wsaData;
+    if ( WSAStartup( MAKEWORD( 2, 2 ), &wsaData ) != 0 ) {
+        throw EBaseException( _D( "RTU over TCP: WSAStartup failed" ) );
+    }
+}
+//---------------------------------------------------------------------------
+
+RTUOverTCPProtocolWinSock::~RTUOverTCPProtocolWinSock()
+{
+    try {
+        DoClose();
+        WSACleanup();
+    }
+    catch ( ... ) {
+    }
+}
+//---------------------------------------------------------------------------
+
+String RTUOverTCPProtocolWinSock::DoGetProtocolParamsStr() const
+{
+    return Format( _D( "%s:%u" ), ARRAYOFCONST( ( host_, port_ ) ) );
+}
+//---------------------------------------------------------------------------
+
+void RTUOverTCPProtocolWinSock::DoOpen()
+{
+    DoClose();
+
+    SOCKET const sock = ConnectTCPSocket( host_, port_, GetConnectTimeout(), _D( "RTU over TCP" ) );
+
+    // Requests are single small frames: do not let Nagle hold them back
+    BOOL noDelay = TRUE;
+    setsockopt( sock, IPPROTO_TCP, TCP_NODELAY,
+                reinterpret_cast<const char*>( &noDelay ), sizeof( noDelay ) );
+
+    socket_ = sock;
+}
+//---------------------------------------------------------------------------
+
+void RTUOverTCPProtocolWinSock::DoClose()
+{
+    if ( socket_ != INVALID_SOCKET ) {
+        shutdown( socket_, SD_BOTH );
+        closesocket( socket_ );
+        socket_ = INVALID_SOCKET;
+    }
+}
+//---------------------------------------------------------------------------
+
+bool RTUOverTCPProtocolWinSock::DoIsConnected() const noexcept
+{
+    return socket_ != INVALID_SOCKET;
+}
+//---------------------------------------------------------------------------
+
+void RTUOverTCPProtocolWinSock::DoInputBufferClear()
+{
+    u_long available = 0;
+    ioctlsocket( socket_, FIONREAD, &available );
+    while ( available > 0 ) {
+        char buf[256];
+        recv( socket_, buf, sizeof( buf ), 0 );
+        ioctlsocket( socket_, FIONREAD, &available );
+    }
+}
+//---------------------------------------------------------------------------
+
+void RTUOverTCPProtocolWinSock::DoWrite( FrameCont const & TxFrame )
+{
+    const char* data   = reinterpret_cast<const char*>( TxFrame.data() );
+    int         total  = 0;
+    int         length = static_cast<int>( TxFrame.size() );
+
+    while ( total < length ) {
+        int sent = send( socket_, data + total, length - total, 0 );
+        if ( sent <= 0 ) {
+            throw EBaseException( _D( "RTU over TCP: send failed" ) );
+        }
+        total += sent;
+    }
+}
+//---------------------------------------------------------------------------
+
+size_t RTUOverTCPProtocolWinSock::DoRead( uint8_t* Buffer, size_t Length, bool FrameStart )
+{
+    char*  data     = reinterpret_cast<char*>( Buffer );
+    size_t received = 0;
+
+    while ( received < Length ) {
+        // A device server forwards a frame in as many segments as its serial side
+        // produced: only the wait for the first byte includes the slave turnaround.
+        unsigned const timeout =
+            FrameStart && !received ? GetTransactionTimeout() : segmentTimeout_;
+
+        fd_set readSet;
+        FD_ZERO( &readSet );
+        FD_SET( socket_, &readSet );
+        timeval tv = {
+            static_cast<long>( timeout / 1000 ), static_cast<long>( timeout % 1000 * 1000 )
+        };
+        int sel = select( 0, &readSet, nullptr, nullptr, &tv );
+        if ( sel == 0 ) {
+            break; // timeout: let the framing layer retry
+        }
+        if ( sel == SOCKET_ERROR ) {
+            throw EBaseException( _D( "RTU over TCP: select failed" ) );
+        }
+
+        int result = recv( socket_, data + received,
+                           static_cast<int>( Length - received ), 0 );
+        if ( result <= 0 ) {
+            DoClose();
+            throw EBaseException( _D( "RTU over TCP: connection closed" ) );
+        }
+        received += static_cast<size_t>( result );
+    }
+    return received;
+}
+
+//---------------------------------------------------------------------------
+}; // End of namespace Master
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
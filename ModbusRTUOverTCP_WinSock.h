@@ -0,0 +1,114 @@
+/**
+ * @file ModbusRTUOverTCP_WinSock.h
+ * @brief Modbus::Master::RTUOverTCPProtocolWinSock — raw RTU frames over a WinSock2 TCP stream.
+ *
+ * @details Serial device servers in "raw" or "transparent" mode forward the bytes of a TCP
+ *  connection to their serial port unchanged, so the master has to send complete RTU frames
+ *  (slave address, PDU, CRC) with no MBAP header.  This class plugs a WinSock2 TCP socket
+ *  into RTUFramingProtocol, replacing the COM-port redirector driver otherwise needed.
+ *  Key characteristics:
+ *  - WSAStartup / WSACleanup called in constructor / destructor.
+ *  - Hostname resolution via GetAddrInfoW() (supports Unicode hostnames).
+ *  - Non-blocking connect with GetConnectTimeout() (5 seconds by default) using select().
+ *  - Timeouts sized for network jitter instead of serial character timing: the first byte
+ *    of a response may take up to ResponseTimeout, after which each further TCP segment
+ *    of the same frame may take up to SegmentTimeout.
+ */
+
+//---------------------------------------------------------------------------
+
+#ifndef ModbusRTUOverTCP_WinSockH
+#define ModbusRTUOverTCP_WinSockH
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#include <cstdint>
+
+#include "ModbusRTU.h"
+#include "ModbusTCP_IP.h"
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace Master {
+//---------------------------------------------------------------------------
+
+/**
+ * @brief WinSock2 TCP transport for RTU framing (Modbus RTU over TCP).
+ *
+ * @details Implements the transport hooks of RTUFramingProtocol on a TCP socket.  Since
+ *  the stream carries no length prefix, frame boundaries come from the RTU framing layer,
+ *  which knows the expected response length.  Bytes left over by a broken or late response
+ *  are discarded by DoInputBufferClear() before the next request is sent.
+ *
+ *  A read timeout is reported to the framing layer, which retries the transaction up to
+ *  RetryCount times; a connection closed by the peer raises EBaseException and closes the
+ *  socket.
+ *
+ *  @note This class is Windows-only and requires linking against ws2_32.lib.
+ */
+class RTUOverTCPProtocolWinSock : public RTUFramingProtocol {
+public:
+    /**
+     * @brief Constructs the protocol object and initialises WinSock2.
+     * @param Host       Device server hostname or IP address (default: "localhost").
+     * @param Port       Device server TCP port (default: 502).
+     * @param RetryCount Maximum number of retransmission attempts per transaction.
+     * @throws EBaseException if WSAStartup fails.
+     */
+    RTUOverTCPProtocolWinSock( String Host = String( DEFAULT_MODBUS_TCPIP_HOST ),
+                               uint16_t Port = DEFAULT_MODBUS_TCPIP_PORT,
+                               int RetryCount = MODBUS_RTU_DEFAULT_RETRY_COUNT );
+
+    /** @brief Destructor; closes the socket and calls WSACleanup. */
+    ~RTUOverTCPProtocolWinSock();
+
+    [[ nodiscard ]] String GetHost() const { return host_; }
+    /** @brief Sets the device server host. Takes effect on the next Open(). */
+    void SetHost( String Val ) { host_ = Val; }
+
+    [[ nodiscard ]] uint16_t GetPort() const noexcept { return port_; }
+    /** @brief Sets the device server port. Takes effect on the next Open(). */
+    void SetPort( uint16_t Val ) noexcept { port_ = Val; }
+
+    /**
+     * @brief Returns the time (ms) Open() waits for a TCP connection
+     *        (default: MODBUS_TCP_IP_DEFAULT_CONNECT_TIMEOUT).
+     */
+    [[ nodiscard ]] unsigned GetConnectTimeout() const noexcept { return connectTimeout_; }
+
+    /** @brief Sets the time (ms) Open() waits for a TCP connection. */
+    void SetConnectTimeout( unsigned Val ) noexcept { connectTimeout_ = Val; }
+
+    /** @brief Time (ms) allowed for the first byte of a response to arrive. */
+    __property unsigned ResponseTimeout = { read = responseTimeout_, write = responseTimeout_ };
+
+    /** @brief Time (ms) allowed between two segments of a response that has started. */
+    __property unsigned SegmentTimeout = { read = segmentTimeout_, write = segmentTimeout_ };
+protected:
+    virtual String DoGetProtocolName() const override { return _D( "Modbus RTU over TCP (WinSock)" ); }
+    virtual String DoGetProtocolParamsStr() const override;
+    virtual void DoOpen() override;
+    virtual void DoClose() override;
+    virtual bool DoIsConnected() const noexcept override;
+    virtual void DoInputBufferClear() override;
+    virtual void DoWrite( FrameCont const & TxFrame ) override;
+    virtual size_t DoRead( uint8_t* Buffer, size_t Length, bool FrameStart ) override;
+    virtual unsigned DoGetResponseTimeout() const override { return responseTimeout_; }
+    virtual void DoSetResponseTimeout( unsigned Val ) override { responseTimeout_ = Val; }
+private:
+    String   host_;
+    uint16_t port_;
+    SOCKET   socket_;
+    unsigned connectTimeout_ { MODBUS_TCP_IP_DEFAULT_CONNECT_TIMEOUT };
+    unsigned responseTimeout_ { MODBUS_RTU_OVER_IP_DEFAULT_RESPONSE_TIMEOUT };
+    unsigned segmentTimeout_ { MODBUS_RTU_OVER_IP_DEFAULT_SEGMENT_TIMEOUT };
+};
+
+//---------------------------------------------------------------------------
+}; // End of namespace Master
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
+#endif
@@ -0,0 +1,180 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include <algorithm>
+#include <cstring>
+
+#include "ModbusRTUOverUDP_WinSock.h"
+
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+#pragma comment( lib, "ws2_32" )
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace Master {
+//---------------------------------------------------------------------------
+
+RTUOverUDPProtocolWinSock::RTUOverUDPProtocolWinSock( String Host, uint16_t Port,
+                                                      int RetryCount )
+    : RTUFramingProtocol( RetryCount )
+    , host_( Host ), port_( Port ), socket_( INVALID_SOCKET )
+{
+    WSADATA wsaData;
+    if ( WSAStartup( MAKEWORD( 2, 2 ), &wsaData ) != 0 ) {
+        throw EBaseException( _D( "RTU over UDP: WSAStartup failed" ) );
+    }
+}
+//---------------------------------------------------------------------------
+
+RTUOverUDPProtocolWinSock::~RTUOverUDPProtocolWinSock()
+{
+    try {
+        DoClose();
+        WSACleanup();
+    }
+    catch ( ... ) {
+    }
+}
+//---------------------------------------------------------------------------
+
+String RTUOverUDPProtocolWinSock::DoGetProtocolParamsStr() const
+{
+    return Format( _D( "%s:%u" ), ARRAYOFCONST( ( host_, port_ ) ) );
+}
+//---------------------------------------------------------------------------
+
+void RTUOverUDPProtocolWinSock::DoOpen()
+{
+    DoClose();
+
+    ADDRINFOW hints = {};
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_protocol = IPPROTO_UDP;
+
+    ADDRINFOW* result = nullptr;
+    if ( GetAddrInfoW( host_.c_str(), String( port_ ).c_str(), &hints, &result ) != 0 ) {
+        throw EBaseException( _D( "RTU over UDP: GetAddrInfoW failed" ) );
+    }
+
+    SOCKET sock = INVALID_SOCKET;
+    for ( ADDRINFOW* ptr = result; ptr != nullptr; ptr = ptr->ai_next ) {
+        sock = ::socket( ptr->ai_family, ptr->ai_socktype, ptr->ai_protocol );
+        if ( sock == INVALID_SOCKET )
+            continue;
+
+        // Fix the peer: send() goes to the device server, recv() accepts only its datagrams
+        if ( ::connect( sock, ptr->ai_addr, static_cast<int>( ptr->ai_addrlen ) ) == SOCKET_ERROR ) {
+            closesocket( sock );
+            sock = INVALID_SOCKET;
+            continue;
+        }
+        break;
+    }
+    FreeAddrInfoW( result );
+
+    if ( sock == INVALID_SOCKET ) {
+        throw EBaseException( _D( "RTU over UDP: socket creation failed" ) );
+    }
+
+    socket_ = sock;
+    recvBuffer_.clear();
+    recvBufferPos_ = 0;
+}
+//---------------------------------------------------------------------------
+
+void RTUOverUDPProtocolWinSock::DoClose()
+{
+    if ( socket_ != INVALID_SOCKET ) {
+        closesocket( socket_ );
+        socket_ = INVALID_SOCKET;
+    }
+}
+//---------------------------------------------------------------------------
+
+bool RTUOverUDPProtocolWinSock::DoIsConnected() const noexcept
+{
+    return socket_ != INVALID_SOCKET;
+}
+//---------------------------------------------------------------------------
+
+void RTUOverUDPProtocolWinSock::DoInputBufferClear()
+{
+    recvBuffer_.clear();
+    recvBufferPos_ = 0;
+
+    // Drain any pending datagrams without blocking
+    u_long available = 0;
+    ioctlsocket( socket_, FIONREAD, &available );
+    while ( available > 0 ) {
+        char buf[512];
+        recv( socket_, buf, sizeof( buf ), 0 );
+        ioctlsocket( socket_, FIONREAD, &available );
+    }
+}
+//---------------------------------------------------------------------------
+
+void RTUOverUDPProtocolWinSock::DoWrite( FrameCont const & TxFrame )
+{
+    if ( send( socket_, reinterpret_cast<const char*>( TxFrame.data() ),
+               static_cast<int>( TxFrame.size() ), 0 ) == SOCKET_ERROR ) {
+        throw EBaseException( _D( "RTU over UDP: send failed" ) );
+    }
+}
+//---------------------------------------------------------------------------
+
+size_t RTUOverUDPProtocolWinSock::DoRead( uint8_t* Buffer, size_t Length, bool FrameStart )
+{
+    size_t received = 0;
+
+    while ( received < Length ) {
+        if ( recvBufferPos_ == recvBuffer_.size() ) {
+            unsigned const timeout =
+                FrameStart && !received ? GetTransactionTimeout() : segmentTimeout_;
+
+            fd_set readSet;
+            FD_ZERO( &readSet );
+            FD_SET( socket_, &readSet );
+            timeval tv = {
+                static_cast<long>( timeout / 1000 ),
+                static_cast<long>( timeout % 1000 * 1000 )
+            };
+            int sel = select( 0, &readSet, nullptr, nullptr, &tv );
+            if ( sel == 0 ) {
+                break; // timeout: let the framing layer retry
+            }
+            if ( sel == SOCKET_ERROR ) {
+                throw EBaseException( _D( "RTU over UDP: select failed" ) );
+            }
+
+            // Larger than any RTU frame, so a datagram is never truncated
+            recvBuffer_.resize( 512 );
+            int result = recv( socket_, reinterpret_cast<char*>( recvBuffer_.data() ),
+                               static_cast<int>( recvBuffer_.size() ), 0 );
+            if ( result == SOCKET_ERROR ) {
+                // e.g. WSAECONNRESET after an ICMP port unreachable: no response
+                recvBuffer_.clear();
+                recvBufferPos_ = 0;
+                break;
+            }
+            recvBuffer_.resize( static_cast<size_t>( result ) );
+            recvBufferPos_ = 0;
+            continue;
+        }
+
+        size_t const count = std::min( Length - received, recvBuffer_.size() - recvBufferPos_ );
+        std::memcpy( Buffer + received, recvBuffer_.data() + recvBufferPos_, count );
+        recvBufferPos_ += count;
+        received += count;
+    }
+    return received;
+}
+
+//---------------------------------------------------------------------------
+}; // End of namespace Master
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
@@ -0,0 +1,102 @@
+/**
+ * @file ModbusRTUOverUDP_WinSock.h
+ * @brief Modbus::Master::RTUOverUDPProtocolWinSock — raw RTU frames over WinSock2 UDP datagrams.
+ *
+ * @details Counterpart of RTUOverTCPProtocolWinSock for device servers that exchange raw
+ *  RTU frames (slave address, PDU, CRC, no MBAP header) in UDP datagrams.
+ *  Key characteristics:
+ *  - WSAStartup / WSACleanup called in constructor / destructor.
+ *  - Hostname resolution via GetAddrInfoW() (supports Unicode hostnames).
+ *  - The socket is connected to the device server, so datagrams from other peers are
+ *    dropped by the stack.
+ *  - A response split by the device server over several datagrams is reassembled: the
+ *    first datagram may take up to ResponseTimeout, each further one up to SegmentTimeout.
+ */
+
+//---------------------------------------------------------------------------
+
+#ifndef ModbusRTUOverUDP_WinSockH
+#define ModbusRTUOverUDP_WinSockH
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "ModbusRTU.h"
+#include "ModbusTCP_IP.h"
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace Master {
+//---------------------------------------------------------------------------
+
+/**
+ * @brief WinSock2 UDP transport for RTU framing (Modbus RTU over UDP).
+ *
+ * @details Implements the transport hooks of RTUFramingProtocol on a connected UDP
+ *  socket.  Received datagrams are cached and DoRead() slices the requested bytes from
+ *  the cache, receiving a new datagram only when the cache is exhausted.  Stale datagrams
+ *  (e.g. a late answer to a request that already timed out) are discarded by
+ *  DoInputBufferClear() before the next request is sent.
+ *
+ *  @note This class is Windows-only and requires linking against ws2_32.lib.
+ */
+class RTUOverUDPProtocolWinSock : public RTUFramingProtocol {
+public:
+    /**
+     * @brief Constructs the protocol object and initialises WinSock2.
+     * @param Host       Device server hostname or IP address (default: "localhost").
+     * @param Port       Device server UDP port (default: 502).
+     * @param RetryCount Maximum number of retransmission attempts per transaction.
+     * @throws EBaseException if WSAStartup fails.
+     */
+    RTUOverUDPProtocolWinSock( String Host = String( DEFAULT_MODBUS_TCPIP_HOST ),
+                               uint16_t Port = DEFAULT_MODBUS_TCPIP_PORT,
+                               int RetryCount = MODBUS_RTU_DEFAULT_RETRY_COUNT );
+
+    /** @brief Destructor; closes the socket and calls WSACleanup. */
+    ~RTUOverUDPProtocolWinSock();
+
+    [[ nodiscard ]] String GetHost() const { return host_; }
+    /** @brief Sets the device server host. Takes effect on the next Open(). */
+    void SetHost( String Val ) { host_ = Val; }
+
+    [[ nodiscard ]] uint16_t GetPort() const noexcept { return port_; }
+    /** @brief Sets the device server port. Takes effect on the next Open(). */
+    void SetPort( uint16_t Val ) noexcept { port_ = Val; }
+
+    /** @brief Time (ms) allowed for the first datagram of a response to arrive. */
+    __property unsigned ResponseTimeout = { read = responseTimeout_, write = responseTimeout_ };
+
+    /** @brief Time (ms) allowed between two datagrams of a response that has started. */
+    __property unsigned SegmentTimeout = { read = segmentTimeout_, write = segmentTimeout_ };
+protected:
+    virtual String DoGetProtocolName() const override { return _D( "Modbus RTU over UDP (WinSock)" ); }
+    virtual String DoGetProtocolParamsStr() const override;
+    virtual void DoOpen() override;
+    virtual void DoClose() override;
+    virtual bool DoIsConnected() const noexcept override;
+    virtual void DoInputBufferClear() override;
+    virtual void DoWrite( FrameCont const & TxFrame ) override;
+    virtual size_t DoRead( uint8_t* Buffer, size_t Length, bool FrameStart ) override;
+    virtual unsigned DoGetResponseTimeout() const override { return responseTimeout_; }
+    virtual void DoSetResponseTimeout( unsigned Val ) override { responseTimeout_ = Val; }
+private:
+    String               host_;
+    uint16_t             port_;
+    SOCKET               socket_;
+    unsigned             responseTimeout_ { MODBUS_RTU_OVER_IP_DEFAULT_RESPONSE_TIMEOUT };
+    unsigned             segmentTimeout_ { MODBUS_RTU_OVER_IP_DEFAULT_SEGMENT_TIMEOUT };
+    std::vector<uint8_t> recvBuffer_;
+    size_t               recvBufferPos_ {};
+};
+
+//---------------------------------------------------------------------------
+}; // End of namespace Master
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
+#endif
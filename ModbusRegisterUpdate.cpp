@@ -0,0 +1,201 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include <algorithm>
+#include <vector>
+
+#include "ModbusRegisterUpdate.h"
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace Master {
+//---------------------------------------------------------------------------
+
+namespace {
+
+void CopyOutcome( Request& To, Request const & From )
+{
+    To.Status = From.Status;
+    To.ExceptCode = From.ExceptCode;
+    To.ErrorMessage = From.ErrorMessage;
+}
+
+} // End of anonymous namespace
+
+//---------------------------------------------------------------------------
+
+RegisterUpdater::RegisterUpdater( Protocol& Proto )
+  : proto_( Proto )
+{
+}
+//---------------------------------------------------------------------------
+
+void RegisterUpdater::SetBits( Context::SlaveAddrType SlaveAddr, RegAddrType Addr,
+                               RegDataType Mask, RegDataType Value )
+{
+    if ( !Mask ) {
+        return;
+    }
+    Change& Item = pending_[RegisterKey( SlaveAddr, Addr )];
+    Item.Mask |= Mask;
+    Item.Value = static_cast<RegDataType>( ( Item.Value & ~Mask ) | ( Value & Mask ) );
+}
+//---------------------------------------------------------------------------
+
+void RegisterUpdater::SetBit( Context::SlaveAddrType SlaveAddr, RegAddrType Addr,
+                              unsigned Bit, bool Value )
+{
+    RegDataType const Mask = static_cast<RegDataType>( 1U << ( Bit & 0x0F ) );
+    SetBits( SlaveAddr, Addr, Mask, Value ? Mask : 0 );
+}
+//---------------------------------------------------------------------------
+
+size_t RegisterUpdater::Flush()
+{
+    if ( pending_.empty() ) {
+        return 0;
+    }
+
+    // FC22: Result = ( Current AND AndMask ) OR ( OrMask AND NOT AndMask )
+    std::vector<Request> Requests;
+    Requests.reserve( pending_.size() );
+    for ( auto const & Item : pending_ ) {
+        Requests.push_back(
+            Request::MaskWrite4XRegister(
+                Item.first.first, Item.first.second,
+                static_cast<RegDataType>( ~Item.second.Mask ), Item.second.Value
+            )
+        );
+        Requests.back().Policy = policy_;
+    }
+
+    // Slaves known to lack FC22 go straight to the fallback
+    auto const AtomicEnd = std::stable_partition(
+        Requests.begin(), Requests.end(),
+        [this]( Request const & Req ) {
+            return !nonAtomicFallback_ ||
+                   IsSupported( Req.SlaveAddr, FunctionCode::MaskWrite4XRegister );
+        }
+    );
+
+    // Pending changes are kept if Execute() throws (e.g. not connected)
+    proto_.Execute( Requests.data(), static_cast<size_t>( AtomicEnd - Requests.begin() ) );
+    pending_.clear();
+
+    size_t Completed {};
+    Request const * Failed {};
+    for ( Request& Req : Requests ) {
+        if ( Req.Status == RequestStatus::Exception &&
+             Req.ExceptCode == ExceptionCode::IllegalFunction ) {
+            SetSupported( Req.SlaveAddr, FunctionCode::MaskWrite4XRegister, false );
+        }
+        if ( Req.Status != RequestStatus::Completed && nonAtomicFallback_ &&
+             !IsSupported( Req.SlaveAddr, FunctionCode::MaskWrite4XRegister ) ) {
+            UpdateNonAtomic( Req );
+        }
+        if ( Req.Status == RequestStatus::Completed ) {
+            ++Completed;
+        }
+        else if ( !Failed ) {
+            Failed = &Req;
+        }
+    }
+
+    if ( Failed ) {
+        throw EBaseException(
+            Format(
+                _D( "%d of %d register update(s) failed: %s" )
+              , ARRAYOFCONST( (
+                    static_cast<int>( Requests.size() - Completed ),
+                    static_cast<int>( Requests.size() ),
+                    Failed->ErrorMessage
+                ) )
+            )
+        );
+    }
+    return Completed;
+}
+//---------------------------------------------------------------------------
+
+void RegisterUpdater::UpdateNonAtomic( Request& Req )
+{
+    RegDataType Current {};
+    Request Read = Request::ReadHoldingRegisters( Req.SlaveAddr, Req.Addr, 1, &Current );
+    Read.Policy = policy_;
+    if ( !proto_.Execute( &Read, 1 ) ) {
+        CopyOutcome( Req, Read );
+        return;
+    }
+
+    Request Write =
+        Request::PresetSingleRegister(
+            Req.SlaveAddr, Req.Addr,
+            static_cast<RegDataType>( ( Current & Req.AndMask ) | ( Req.Value & ~Req.AndMask ) )
+        );
+    Write.Policy = policy_;
+    proto_.Execute( &Write, 1 );
+    CopyOutcome( Req, Write );
+}
+//---------------------------------------------------------------------------
+
+bool RegisterUpdater::Exchange( Context::SlaveAddrType SlaveAddr,
+                                RegAddrType WriteStartAddr, RegCountType WritePointCount,
+                                const RegDataType* WriteData,
+                                RegAddrType ReadStartAddr, RegCountType ReadPointCount,
+                                RegDataType* ReadData )
+{
+    Context const Ctx( SlaveAddr, policy_ );
+    if ( !nonAtomicFallback_ ||
+         IsSupported( SlaveAddr, FunctionCode::ReadWrite4XRegisters ) ) {
+        try {
+            proto_.ReadWrite4XRegisters(
+                Ctx, ReadStartAddr, ReadPointCount, ReadData,
+                WriteStartAddr, WritePointCount, WriteData
+            );
+            return true;
+        }
+        catch ( EIllegalFunction const & ) {
+            SetSupported( SlaveAddr, FunctionCode::ReadWrite4XRegisters, false );
+            if ( !nonAtomicFallback_ ) {
+                throw;
+            }
+        }
+    }
+
+    // FC23 writes first, then reads
+    if ( WritePointCount == 1 ) {
+        proto_.PresetSingleRegister( Ctx, WriteStartAddr, *WriteData );
+    }
+    else {
+        proto_.PresetMultipleRegisters( Ctx, WriteStartAddr, WritePointCount, WriteData );
+    }
+    proto_.ReadHoldingRegisters( Ctx, ReadStartAddr, ReadPointCount, ReadData );
+    return false;
+}
+//---------------------------------------------------------------------------
+
+bool RegisterUpdater::IsSupported( Context::SlaveAddrType SlaveAddr,
+                                   FunctionCode FnCode ) const
+{
+    return !unsupported_.count( SupportKey( SlaveAddr, FnCode ) );
+}
+//---------------------------------------------------------------------------
+
+void RegisterUpdater::SetSupported( Context::SlaveAddrType SlaveAddr, FunctionCode FnCode,
+                                    bool Val )
+{
+    if ( Val ) {
+        unsupported_.erase( SupportKey( SlaveAddr, FnCode ) );
+    }
+    else {
+        unsupported_.insert( SupportKey( SlaveAddr, FnCode ) );
+    }
+}
+
+//---------------------------------------------------------------------------
+}; // End of namespace Master
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
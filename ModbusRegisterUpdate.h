@@ -0,0 +1,136 @@
+/**
+ * @file ModbusRegisterUpdate.h
+ * @brief Modbus::Master::RegisterUpdater — bit-field writes over FC22, exchanges over FC23.
+ *
+ * @details Setting a bit of a control word with FC03 (read) and FC06 (write) takes two
+ *  transactions, and a write of another master between them is lost.  A RegisterUpdater
+ *  collects bit-field changes with SetBits() and SetBit(), merges the changes of the
+ *  same register, and on Flush() sends one FC22 (Mask Write 4X Register) per register:
+ *  the slave applies the masks itself, so the bits that were not changed keep whatever
+ *  value they have at that moment.  The whole flush is one Protocol::Execute() batch
+ *  (pipelined on Modbus TCP).
+ *
+ *  Exchange() writes a block of registers and reads a block back in one FC23 (Read/Write
+ *  4X Registers) transaction, the write first: a command word and the status it
+ *  produces, as in a request/acknowledge handshake.  Modbus has no conditional write,
+ *  so a compare-and-swap cannot be made atomic on the slave; Exchange() is the closest
+ *  handshake primitive.
+ *
+ *  A slave that answers FC22 or FC23 with IllegalFunction is remembered (see
+ *  IsSupported()) and, unless GetNonAtomicFallback() is @c false, served from then on
+ *  with FC03 followed by FC06 (bit fields) or with FC16 followed by FC03 (exchanges):
+ *  the result is the same, but another master may write between the two transactions.
+ *
+ *  A RegisterUpdater is not synchronised: call it from one thread.
+ */
+
+//---------------------------------------------------------------------------
+
+#ifndef ModbusRegisterUpdateH
+#define ModbusRegisterUpdateH
+
+#include <cstddef>
+#include <map>
+#include <set>
+#include <utility>
+
+#include "Modbus.h"
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace Master {
+//---------------------------------------------------------------------------
+
+/** @brief Atomic bit-field updates and register exchanges (see file description). */
+class RegisterUpdater {
+public:
+    /** @param Proto Protocol used for the transactions; must outlive the updater. */
+    explicit RegisterUpdater( Protocol& Proto );
+
+    RegisterUpdater( RegisterUpdater const & Rhs ) = delete;
+    RegisterUpdater& operator=( RegisterUpdater const & Rhs ) = delete;
+
+    /**
+     * @brief Queues a change of the bits of @p Mask of a holding register to the bits of
+     *        @p Value; the other bits are left as they are on the slave.
+     * @details A later change of the same bits overrides the earlier one.
+     */
+    void SetBits( Context::SlaveAddrType SlaveAddr, RegAddrType Addr,
+                  RegDataType Mask, RegDataType Value );
+
+    /** @brief Queues a change of bit @p Bit (0–15) of a holding register. */
+    void SetBit( Context::SlaveAddrType SlaveAddr, RegAddrType Addr, unsigned Bit,
+                 bool Value );
+
+    /**
+     * @brief Sends every queued change, one FC22 transaction per register.
+     * @return Number of registers updated.
+     * @details The queue is emptied even if some updates fail.
+     * @throws EBaseException if at least one update failed (the message reports the
+     *         first error), or if the protocol is not connected (the queue is kept).
+     */
+    size_t Flush();
+
+    /** @brief Discards every queued change. */
+    void Clear() noexcept { pending_.clear(); }
+
+    /** @brief Returns the number of registers with queued changes. */
+    [[ nodiscard ]] size_t GetPendingCount() const noexcept { return pending_.size(); }
+
+    /**
+     * @brief Writes @p WriteData, then reads @p ReadData back, in one FC23 transaction.
+     * @return @c true if the exchange was atomic (FC23), @c false if it used the
+     *         non-atomic fallback.
+     * @throws EProtocolException raised by the slave, or EBaseException on a
+     *         communication error.
+     */
+    bool Exchange( Context::SlaveAddrType SlaveAddr,
+                   RegAddrType WriteStartAddr, RegCountType WritePointCount,
+                   const RegDataType* WriteData,
+                   RegAddrType ReadStartAddr, RegCountType ReadPointCount,
+                   RegDataType* ReadData );
+
+    /**
+     * @brief Returns @c false if the slave answered @p FnCode (FC22 or FC23) with
+     *        IllegalFunction, or was declared so with SetSupported().
+     */
+    [[ nodiscard ]] bool IsSupported( Context::SlaveAddrType SlaveAddr,
+                                      FunctionCode FnCode ) const;
+
+    /** @brief Declares whether a slave implements FC22 or FC23 (e.g. from a DeviceProfile). */
+    void SetSupported( Context::SlaveAddrType SlaveAddr, FunctionCode FnCode, bool Val );
+
+    /** @brief Whether a slave without FC22/FC23 is served by two transactions (default @c true). */
+    [[ nodiscard ]] bool GetNonAtomicFallback() const noexcept { return nonAtomicFallback_; }
+    void SetNonAtomicFallback( bool Val ) noexcept { nonAtomicFallback_ = Val; }
+
+    /** @brief Transaction policy applied to every transaction. */
+    [[ nodiscard ]] TransactionPolicy const & GetPolicy() const noexcept { return policy_; }
+    void SetPolicy( TransactionPolicy const & Val ) { policy_ = Val; }
+private:
+    using RegisterKey = std::pair<Context::SlaveAddrType,RegAddrType>;
+    using SupportKey = std::pair<Context::SlaveAddrType,FunctionCode>;
+
+    /** @brief Bits to change and their values. */
+    struct Change {
+        RegDataType Mask {};
+        RegDataType Value {};
+    };
+
+    Protocol&                      proto_;
+    std::map<RegisterKey,Change>   pending_;
+    std::set<SupportKey>           unsupported_;
+    bool                           nonAtomicFallback_ { true };
+    TransactionPolicy              policy_;
+
+    /** @brief Updates a register with FC03 and FC06; sets Req's outcome. */
+    void UpdateNonAtomic( Request& Req );
+};
+
+//---------------------------------------------------------------------------
+}; // End of namespace Master
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
+#endif
@@ -0,0 +1,194 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include <algorithm>
+#include <exception>
+
+#include "ModbusScheduler.h"
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace Master {
+//---------------------------------------------------------------------------
+
+RequestScheduler::RequestScheduler( Protocol& Proto, unsigned AgingInterval )
+  : proto_( Proto )
+  , agingInterval_( AgingInterval )
+{
+    worker_ = std::thread( &RequestScheduler::Run, this );
+}
+//---------------------------------------------------------------------------
+
+RequestScheduler::~RequestScheduler()
+{
+    Stop();
+}
+//---------------------------------------------------------------------------
+
+std::future<Request> RequestScheduler::Submit( Request const & Req,
+                                               RequestPriority Priority )
+{
+    size_t const Class =
+        static_cast<size_t>(
+            std::clamp(
+                static_cast<int>( Priority ),
+                static_cast<int>( RequestPriority::Background ),
+                static_cast<int>( RequestPriority::Control )
+            )
+        );
+    Item Job { Req, std::promise<Request>(), ClockType::now() };
+    Job.Req.Status = RequestStatus::Pending;
+    Job.Req.ErrorMessage = String();
+    std::future<Request> Result = Job.Result.get_future();
+    {
+        std::lock_guard<std::mutex> Lock( mutex_ );
+        if ( stopped_ ) {
+            throw EBaseException( _D( "Request scheduler stopped" ) );
+        }
+        queues_[Class].push_back( std::move( Job ) );
+    }
+    wakeUp_.notify_one();
+    return Result;
+}
+//---------------------------------------------------------------------------
+
+std::future<Request> RequestScheduler::Submit( Request const & Req )
+{
+    return Submit(
+        Req,
+        static_cast<RequestPriority>(
+            Req.Policy.Priority.value_or( static_cast<int>( RequestPriority::Background ) )
+        )
+    );
+}
+//---------------------------------------------------------------------------
+
+void RequestScheduler::Stop()
+{
+    {
+        std::lock_guard<std::mutex> Lock( mutex_ );
+        stopped_ = true;
+    }
+    wakeUp_.notify_one();
+    if ( worker_.joinable() ) {
+        worker_.join();
+    }
+
+    // Nothing can be queued any more: fail whatever is left
+    for ( ItemQueue& Queue : queues_ ) {
+        for ( Item& Job : Queue ) {
+            Job.Req.Status = RequestStatus::Failed;
+            Job.Req.ErrorMessage = _D( "Request scheduler stopped" );
+            Job.Result.set_value( Job.Req );
+        }
+        Queue.clear();
+    }
+}
+//---------------------------------------------------------------------------
+
+size_t RequestScheduler::GetPendingCount() const
+{
+    std::lock_guard<std::mutex> Lock( mutex_ );
+    size_t Count {};
+    for ( ItemQueue const & Queue : queues_ ) {
+        Count += Queue.size();
+    }
+    return Count;
+}
+//---------------------------------------------------------------------------
+
+unsigned RequestScheduler::GetAgingInterval() const
+{
+    std::lock_guard<std::mutex> Lock( mutex_ );
+    return agingInterval_;
+}
+//---------------------------------------------------------------------------
+
+void RequestScheduler::SetAgingInterval( unsigned Val )
+{
+    std::lock_guard<std::mutex> Lock( mutex_ );
+    agingInterval_ = Val;
+}
+//---------------------------------------------------------------------------
+
+void RequestScheduler::Run()
+{
+    for ( ;; ) {
+        Item Job;
+        {
+            std::unique_lock<std::mutex> Lock( mutex_ );
+            ItemQueue* Queue {};
+            wakeUp_.wait(
+                Lock,
+                [this, &Queue]() {
+                    return stopped_ || ( Queue = SelectQueue( ClockType::now() ) ) != nullptr;
+                }
+            );
+            if ( stopped_ ) {
+                return;
+            }
+            Job = std::move( Queue->front() );
+            Queue->pop_front();
+        }
+        Execute( Job );
+    }
+}
+//---------------------------------------------------------------------------
+
+RequestScheduler::ItemQueue* RequestScheduler::SelectQueue( ClockType::time_point Now )
+{
+    // Within a class the head is the oldest, hence the most aged, request
+    size_t constexpr AgingCeiling = static_cast<size_t>( RequestPriority::Alarm );
+
+    ItemQueue* Selected {};
+    size_t SelectedLevel {};
+    for ( size_t Class = 0 ; Class < ClassCount ; ++Class ) {
+        ItemQueue& Queue = queues_[Class];
+        if ( Queue.empty() ) {
+            continue;
+        }
+        size_t Level = Class;
+        if ( Class < AgingCeiling && agingInterval_ ) {
+            auto const Waited =
+                std::chrono::duration_cast<std::chrono::milliseconds>(
+                    Now - Queue.front().Submitted
+                ).count();
+            Level = std::min<size_t>( Class + Waited / agingInterval_, AgingCeiling );
+        }
+        if ( !Selected || Level > SelectedLevel ||
+             ( Level == SelectedLevel &&
+               Queue.front().Submitted < Selected->front().Submitted ) ) {
+            Selected = &Queue;
+            SelectedLevel = Level;
+        }
+    }
+    return Selected;
+}
+//---------------------------------------------------------------------------
+
+void RequestScheduler::Execute( Item& Job )
+{
+    try {
+        proto_.Execute( &Job.Req, 1 );
+    }
+    catch ( Exception const & E ) {
+        // Protocol not open
+        Job.Req.Status = RequestStatus::Failed;
+        Job.Req.ErrorMessage = E.Message;
+    }
+    catch ( ... ) {
+        // Not a transaction outcome (e.g. out of memory): hand it to the caller, and
+        // keep the worker serving the queue
+        Job.Result.set_exception( std::current_exception() );
+        return;
+    }
+    Job.Result.set_value( Job.Req );
+}
+
+//---------------------------------------------------------------------------
+}; // End of namespace Master
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
@@ -0,0 +1,141 @@
+/**
+ * @file ModbusScheduler.h
+ * @brief Modbus::Master::RequestScheduler — per-link priority queue of Modbus requests.
+ *
+ * @details A link (one Protocol instance) carries one transaction at a time.  When the
+ *  application serializes the calls itself, a setpoint written by an operator waits
+ *  behind the whole bulk scan in progress.  A RequestScheduler owns the link instead:
+ *  any thread submits Request items with a priority class, and a worker thread sends
+ *  them one at a time, always picking the most urgent one.  A control write therefore
+ *  reaches the wire as soon as the transaction in progress completes, whatever the
+ *  number of polls queued before it.
+ *
+ *  Priority classes, from the most urgent: Control, Alarm, Trend, Background.  Within a
+ *  class the requests are sent in submission order.  To prevent starvation, a waiting
+ *  Alarm, Trend or Background request is promoted by one class every aging interval,
+ *  but never above Alarm: Control requests always go first, so their latency is bounded
+ *  by the transaction in progress plus the Control requests queued before them.  Each
+ *  request is executed with the retries and backoff of its TransactionPolicy, on every
+ *  transport, and keeps the link until its last attempt: give the bulk requests few
+ *  retries, so that they cannot hold back a Control request for long.
+ *
+ *  Each Submit() returns a std::future that delivers a copy of the request with its
+ *  Status, ExceptCode and ErrorMessage set, as Protocol::Execute() reports them.  The
+ *  buffers referenced by the request (RegData, CoilData, RegSource, CoilSource) must
+ *  stay valid until the future is ready.
+ *
+ *  The Protocol must be open; a request executed while it is closed fails.  While a
+ *  scheduler runs, the Protocol must not be used directly by other threads.
+ */
+
+//---------------------------------------------------------------------------
+
+#ifndef ModbusSchedulerH
+#define ModbusSchedulerH
+
+#include <cstddef>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+
+#include "Modbus.h"
+
+/**
+ * @brief Default time (ms) after which a waiting request is promoted by one priority class.
+ */
+#if !defined( MODBUS_SCHEDULER_DEFAULT_AGING_INTERVAL )
+  #define MODBUS_SCHEDULER_DEFAULT_AGING_INTERVAL  1000
+#endif
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace Master {
+//---------------------------------------------------------------------------
+
+/** @brief Priority class of a scheduled request (higher is more urgent). */
+enum class RequestPriority {
+    Background = 0,  ///< Bulk scans, discovery.
+    Trend      = 1,  ///< Periodic polls feeding trends and displays.
+    Alarm      = 2,  ///< Alarm and event polls.
+    Control    = 3,  ///< Operator commands and setpoint writes; never overtaken.
+};
+
+/** @brief Sends requests over one Protocol by priority (see file description). */
+class RequestScheduler {
+public:
+    /**
+     * @param Proto         Protocol used for the requests; must outlive the scheduler.
+     * @param AgingInterval Time in ms after which a waiting request is promoted by one
+     *                      class (0 disables aging).
+     */
+    explicit RequestScheduler( Protocol& Proto,
+                               unsigned AgingInterval = MODBUS_SCHEDULER_DEFAULT_AGING_INTERVAL );
+
+    /** @brief Stops the worker thread (see Stop()). */
+    ~RequestScheduler();
+
+    RequestScheduler( RequestScheduler const & Rhs ) = delete;
+    RequestScheduler& operator=( RequestScheduler const & Rhs ) = delete;
+
+    /**
+     * @brief Queues a request; a @p Priority outside RequestPriority is clamped to it.
+     * @return The future that receives the executed request.  If the execution throws
+     *         anything but a VCL Exception, the future rethrows it from get().
+     * @throws EBaseException if the scheduler was stopped.
+     */
+    [[ nodiscard ]] std::future<Request> Submit( Request const & Req,
+                                                 RequestPriority Priority );
+
+    /**
+     * @brief Queues a request with the priority set in its TransactionPolicy (clamped
+     *        to the range of RequestPriority), or RequestPriority::Background if unset.
+     */
+    [[ nodiscard ]] std::future<Request> Submit( Request const & Req );
+
+    /**
+     * @brief Stops the worker thread once the transaction in progress, if any, is
+     *        complete.  The requests still queued fail with RequestStatus::Failed.
+     */
+    void Stop();
+
+    /** @brief Returns the number of requests waiting to be sent. */
+    [[ nodiscard ]] size_t GetPendingCount() const;
+
+    [[ nodiscard ]] unsigned GetAgingInterval() const;
+    void SetAgingInterval( unsigned Val );
+private:
+    using ClockType = std::chrono::steady_clock;
+
+    struct Item {
+        Request               Req;
+        std::promise<Request> Result;
+        ClockType::time_point Submitted;
+    };
+
+    using ItemQueue = std::deque<Item>;
+    static constexpr size_t ClassCount = static_cast<size_t>( RequestPriority::Control ) + 1;
+
+    Protocol&                        proto_;
+    mutable std::mutex               mutex_;
+    std::condition_variable          wakeUp_;
+    std::array<ItemQueue,ClassCount> queues_;
+    unsigned                         agingInterval_;
+    bool                             stopped_ {};
+    std::thread                      worker_;
+
+    void Run();
+    [[ nodiscard ]] ItemQueue* SelectQueue( ClockType::time_point Now );
+    void Execute( Item& Job );
+};
+
+//---------------------------------------------------------------------------
+}; // End of namespace Master
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
+#endif
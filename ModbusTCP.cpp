@@ -3,6 +3,12 @@
 #pragma hdrstop
 #endif
 
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
 #include "ModbusTCP.h"
 
 //---------------------------------------------------------------------------
@@ -13,6 +19,197 @@ namespace Modbus {
 namespace Master {
 //---------------------------------------------------------------------------
 
+void TCPProtocol::DoExecute( Request* Requests, size_t RequestCount )
+{
+    // Encode every item up front, each with its own transaction identifier, response
+    // timeout and retry count
+    std::vector<TBytes> Frames( RequestCount );
+    std::vector<BMAPTransactionIdType> Tids( RequestCount );
+    std::vector<TransactionPolicy> Policies( RequestCount );
+    std::vector<int> Attempts( RequestCount );
+    std::deque<size_t> Queue;
+    for ( size_t Idx = 0 ; Idx < RequestCount ; ++Idx ) {
+        Request& Req = Requests[Idx];
+        Policies[Idx] = GetEffectivePolicy( Context( Req.SlaveAddr, Req.Policy ) );
+        try {
+            Frames[Idx] = EncodeItem( Req, Tids[Idx] );
+            Queue.push_back( Idx );
+        }
+        catch ( Exception const & E ) {
+            SetRequestError( Req, E );
+        }
+    }
+
+    size_t const Depth = std::max<size_t>( pipelineDepth_, 1 );
+    std::vector<size_t> InFlight;
+    InFlight.reserve( Depth );
+
+    // Round trips for the adaptive timeouts: a server answers the pipelined requests
+    // one after the other, so an item's turn starts when it was sent or when the
+    // previous reply arrived, whichever is later.  Only first attempts are sampled.
+    using Clock = std::chrono::steady_clock;
+    std::vector<Clock::time_point> SentAt( RequestCount );
+    Clock::time_point LastReplyAt {};
+
+    DoInputBufferClear();
+
+    for ( ;; ) {
+        // Top up the window with a single write
+        TBytes OutBuffer;
+        while ( !Queue.empty() && InFlight.size() < Depth ) {
+            TBytes const & Frame = Frames[Queue.front()];
+            if ( GetLength( OutBuffer ) + GetLength( Frame ) > 0xFFFF ) {
+                break;
+            }
+            int const Offset = GetLength( OutBuffer );
+            SetLength( OutBuffer, Offset + GetLength( Frame ) );
+            std::copy(
+                GetData( Frame ), GetData( Frame ) + GetLength( Frame ),
+                GetData( OutBuffer ) + Offset
+            );
+            NotifyTX( Frame );
+            InFlight.push_back( Queue.front() );
+            Queue.pop_front();
+        }
+
+        if ( InFlight.empty() ) {
+            break;
+        }
+
+        // Any item in flight may answer next: wait as long as the slowest of them
+        SetTransactionTimeout(
+            GetItemTimeout(
+                Policies[
+                    *std::max_element(
+                        InFlight.begin(), InFlight.end(),
+                        [this, &Policies]( size_t Lhs, size_t Rhs ) {
+                            return GetItemTimeout( Policies[Lhs] ) <
+                                   GetItemTimeout( Policies[Rhs] );
+                        }
+                    )
+                ]
+            )
+        );
+
+        TBytes ReplyBMAPBuffer;
+        TBytes ReplyBuffer;
+        try {
+            if ( GetLength( OutBuffer ) ) {
+                DoWrite( OutBuffer );
+                Clock::time_point const Now = Clock::now();
+                for ( size_t Idx : InFlight ) {
+                    if ( SentAt[Idx] == Clock::time_point() ) {
+                        SentAt[Idx] = Now;
+                    }
+                }
+            }
+            ReadReply(
+                TCPIPContext( Requests[InFlight.front()].SlaveAddr, Tids[InFlight.front()] ),
+                ReplyBMAPBuffer, ReplyBuffer
+            );
+        }
+        catch ( Exception const & E ) {
+            // Every item still in flight lost an attempt: send again the ones with
+            // retries left, ahead of the unsent ones and with new transaction
+            // identifiers, so that a late reply to the lost attempt is skipped
+            AddRoundTripTimeout( Context( Requests[InFlight.front()].SlaveAddr ) );
+            std::chrono::milliseconds Pause {};
+            for ( auto It = InFlight.rbegin() ; It != InFlight.rend() ; ++It ) {
+                size_t const Idx = *It;
+                Request& Req = Requests[Idx];
+                if ( Attempts[Idx] < Policies[Idx].RetryCount.value_or( 0 ) ) {
+                    ++Attempts[Idx];
+                    if ( GetAdaptiveTimeout() ) {
+                        Policies[Idx] = GetEffectivePolicy( Context( Req.SlaveAddr, Req.Policy ) );
+                    }
+                    Frames[Idx] = EncodeItem( Req, Tids[Idx] );
+                    Queue.push_front( Idx );
+                    Pause = std::max(
+                        Pause,
+                        GetRetryPause( Policies[Idx].Backoff.value_or( 0 ), Attempts[Idx] )
+                    );
+                }
+                else {
+                    SetRequestError( Req, E );
+                }
+            }
+            InFlight.clear();
+
+            // The retries of one failure share a single pause, the longest of their
+            // backoffs, so that the window is resent in one write
+            if ( Pause.count() ) {
+                std::this_thread::sleep_for( Pause );
+            }
+
+            // A link closed by the failure is opened again for the remaining items;
+            // if it cannot be, the retries fail and the unsent items stay pending
+            if ( !Queue.empty() && !IsConnected() ) {
+                try {
+                    Open();
+                }
+                catch ( Exception const & ) {
+                    for ( size_t Idx : Queue ) {
+                        if ( Attempts[Idx] ) {
+                            SetRequestError( Requests[Idx], E );
+                        }
+                    }
+                    return;
+                }
+            }
+            DoInputBufferClear();
+            continue;
+        }
+
+        BMAPTransactionIdType const Tid = GetBMAPTransactionIdentifier( ReplyBMAPBuffer );
+        auto const It = std::find_if(
+            InFlight.begin(), InFlight.end(),
+            [&Tids, Tid]( size_t Idx ) { return Tids[Idx] == Tid; }
+        );
+        if ( It == InFlight.end() ) {
+            // A complete frame answering an abandoned request: skip it
+            continue;
+        }
+
+        size_t const ReqIdx = *It;
+        InFlight.erase( It );
+
+        Request& Req = Requests[ReqIdx];
+        TCPIPContext const Context( Req.SlaveAddr, Tid );
+
+        // Karn: the answer to a retry may be a late answer to an earlier attempt
+        Clock::time_point const Now = Clock::now();
+        if ( !Attempts[ReqIdx] ) {
+            AddRoundTripSample( Context, Now - std::max( SentAt[ReqIdx], LastReplyAt ) );
+        }
+        LastReplyAt = Now;
+
+        try {
+            if ( GetBMAPUnitIdentifier( ReplyBMAPBuffer ) != Req.SlaveAddr ) {
+                throw EContextException( Context, _D( "Invalid BMAP Unit Identifier" ) );
+            }
+            DecodeReply( Context, Req, ReplyBuffer );
+            Req.Status = RequestStatus::Completed;
+        }
+        catch ( Exception const & E ) {
+            SetRequestError( Req, E );
+        }
+    }
+}
+//---------------------------------------------------------------------------
+
+TBytes TCPProtocol::EncodeItem( Request const & Req, BMAPTransactionIdType& Tid )
+{
+    Tid = NextTransactionIdentifier();
+    return EncodeRequest( TCPIPContext( Req.SlaveAddr, Tid, Req.Policy ), Req );
+}
+//---------------------------------------------------------------------------
+
+unsigned TCPProtocol::GetItemTimeout( TransactionPolicy const & Policy ) const
+{
+    return Policy.Timeout.value_or( GetResponseTimeout() );
+}
+//---------------------------------------------------------------------------
+
 //---------------------------------------------------------------------------
 }; // End of namespace Master
 //---------------------------------------------------------------------------
@@ -1,9 +1,10 @@
 /**
  * @file ModbusTCP.h
- * @brief Modbus::Master::TCPProtocol — TCP marker class in the MBAP protocol hierarchy.
+ * @brief Modbus::Master::TCPProtocol — TCP base class in the MBAP protocol hierarchy.
  *
  * @details TCPProtocol is a thin intermediate class that identifies TCP-based transports
- *  in the class hierarchy without adding behaviour.  Concrete implementations (TCPProtocolWinSock,
+ *  in the class hierarchy.  Its only behaviour is request pipelining for batches submitted
+ *  through Protocol::Execute().  Concrete implementations (TCPProtocolWinSock,
  *  TCPProtocolIndy) derive from this class and provide the actual TCP socket I/O.
  */
 
@@ -12,8 +13,20 @@
 #ifndef ModbusTCPH
 #define ModbusTCPH
 
+#include <cstddef>
+
 #include "ModbusTCP_IP.h"
 
+/**
+ * @brief Default maximum number of outstanding requests while executing a batch.
+ * @details Modbus/TCP servers are required to queue at least one request per
+ *  connection; most devices accept several.  Set the pipeline depth to 1 for
+ *  servers that cannot handle more than one outstanding transaction.
+ */
+#if !defined( MODBUS_TCP_DEFAULT_PIPELINE_DEPTH )
+  #define MODBUS_TCP_DEFAULT_PIPELINE_DEPTH  8
+#endif
+
 //---------------------------------------------------------------------------
 namespace Modbus {
 //---------------------------------------------------------------------------
@@ -21,15 +34,24 @@ namespace Master {
 //---------------------------------------------------------------------------
 
 /**
- * @brief Marker base class for TCP-based Modbus master implementations.
- *
- * @brief Marker base class for TCP-based Modbus master implementations (NVI pattern).
+ * @brief Base class for TCP-based Modbus master implementations (NVI pattern).
  *
  *  **Role in NVI Hierarchy:**
  *  - Inherits all MBAP framing logic and virtual hooks from TCPIPProtocol.
  *  - Concrete TCP transport classes (TCPProtocolWinSock, TCPProtocolIndy) derive from TCPProtocol
  *    and implement the Do…() virtual methods using their respective I/O libraries (WinSock2 or Indy).
- *  - Provides no additional virtual methods; all behavior is inherited from Protocol and TCPIPProtocol.
+ *  - Overrides DoExecute() to pipeline batches: up to GetPipelineDepth() requests are
+ *    written back to back, each with its own MBAP transaction identifier, and the
+ *    replies are matched to the requests by transaction identifier as they arrive.
+ *    A reply whose transaction identifier is not in flight answers an abandoned
+ *    request and is skipped.  Each read waits for the longest response timeout among
+ *    the items in flight (Request::Policy).
+ *  - A transport error or a malformed frame costs every item in flight one attempt: the
+ *    items with retries left (TransactionPolicy::RetryCount of their effective policy)
+ *    are sent again with new transaction identifiers, the others are marked
+ *    RequestStatus::Failed, and the batch goes on with the unsent items.  When the
+ *    failure closed the link it is opened again; if that fails too, the retried items
+ *    are marked RequestStatus::Failed and the unsent ones stay RequestStatus::Pending.
  *
  *  Use this class:
  *  - As a base (polymorphic reference) when you need to accept any TCP transport without
@@ -38,8 +60,24 @@ namespace Master {
  */
 class TCPProtocol : public TCPIPProtocol {
 public:
+    /** @brief Returns the maximum number of outstanding requests during Execute(). */
+    [[ nodiscard ]] size_t GetPipelineDepth() const noexcept { return pipelineDepth_; }
+
+    /**
+     * @brief Sets the maximum number of outstanding requests during Execute().
+     * @param Val Pipeline depth; 0 and 1 both execute the batch one request at a time.
+     */
+    void SetPipelineDepth( size_t Val ) noexcept { pipelineDepth_ = Val; }
 protected:
+    virtual void DoExecute( Request* Requests, size_t RequestCount ) override;
 private:
+    /** @brief Encodes a batch item with a new transaction identifier, stored in @p Tid. */
+    [[ nodiscard ]] TBytes EncodeItem( Request const & Req, BMAPTransactionIdType& Tid );
+
+    /** @brief Response timeout (ms) of a batch item with the effective @p Policy. */
+    [[ nodiscard ]] unsigned GetItemTimeout( TransactionPolicy const & Policy ) const;
+
+    size_t pipelineDepth_ { MODBUS_TCP_DEFAULT_PIPELINE_DEPTH };
 };
 
 //---------------------------------------------------------------------------
@@ -0,0 +1,498 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include <openssl/err.h>
+#include <openssl/x509v3.h>
+
+#include <iterator>
+#include <utility>
+
+#include "ModbusTCPSecurity_WinSock.h"
+#include "ModbusWinSock.h"
+
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+#pragma comment( lib, "ws2_32" )
+#pragma comment( lib, "libssl" )
+#pragma comment( lib, "libcrypto" )
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace Master {
+//---------------------------------------------------------------------------
+
+namespace {
+
+String TLSErrorStr()
+{
+    unsigned long const code = ERR_get_error();
+    ERR_clear_error();
+    if ( !code ) {
+        return _D( "no OpenSSL error" );
+    }
+    char buf[256];
+    ERR_error_string_n( code, buf, sizeof( buf ) );
+    return String( buf );
+}
+//---------------------------------------------------------------------------
+
+// An idle connection is alive if the peer has neither closed it nor reset it.
+// Readable data (e.g. a late session ticket) does not count against it.
+bool IsAlive( TLSClientContext::Connection const & Conn )
+{
+    fd_set readSet;
+    FD_ZERO( &readSet );
+    FD_SET( Conn.Socket, &readSet );
+    timeval tv = { 0, 0 };
+    int sel = select( 0, &readSet, nullptr, nullptr, &tv );
+    if ( sel == 0 ) {
+        return true;
+    }
+    if ( sel == SOCKET_ERROR ) {
+        return false;
+    }
+    char peek;
+    return recv( Conn.Socket, &peek, 1, MSG_PEEK ) > 0;
+}
+
+} // End of anonymous namespace
+
+//---------------------------------------------------------------------------
+
+TLSClientContext::Connection::~Connection()
+{
+    if ( Ssl ) {
+        if ( !Broken ) {
+            SSL_shutdown( Ssl ); // close_notify, without waiting for the peer's
+        }
+        SSL_free( Ssl );
+    }
+    if ( Socket != INVALID_SOCKET ) {
+        shutdown( Socket, SD_BOTH );
+        closesocket( Socket );
+    }
+}
+//---------------------------------------------------------------------------
+
+TLSClientContext::TLSClientContext()
+    : ctx_( SSL_CTX_new( TLS_client_method() ) )
+{
+    if ( !ctx_ ) {
+        throw EBaseException(
+            Format( _D( "TLS: SSL_CTX_new failed (%s)" ), ARRAYOFCONST( ( TLSErrorStr() ) ) )
+        );
+    }
+    SSL_CTX_set_min_proto_version( ctx_, TLS1_2_VERSION );
+    SSL_CTX_set_default_verify_paths( ctx_ );
+    SSL_CTX_set_verify( ctx_, SSL_VERIFY_PEER, nullptr );
+
+    // Sessions are kept here, per endpoint, rather than in OpenSSL's internal client
+    // cache: TLS 1.3 tickets arrive after the handshake and only the callback sees them
+    SSL_CTX_set_app_data( ctx_, this );
+    SSL_CTX_set_session_cache_mode(
+        ctx_, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE
+    );
+    SSL_CTX_sess_set_new_cb( ctx_, &TLSClientContext::OnNewSession );
+}
+//---------------------------------------------------------------------------
+
+TLSClientContext::~TLSClientContext()
+{
+    idle_.clear();
+    for ( auto& Entry : sessions_ ) {
+        SSL_SESSION_free( Entry.second );
+    }
+    SSL_CTX_free( ctx_ );
+}
+//---------------------------------------------------------------------------
+
+void TLSClientContext::SetCAFile( String FileName )
+{
+    std::lock_guard<std::mutex> Lock( mutex_ );
+    if ( SSL_CTX_load_verify_locations( ctx_, UTF8String( FileName ).c_str(), nullptr ) != 1 ) {
+        throw EBaseException(
+            Format(
+                _D( "TLS: unable to load CA file \"%s\" (%s)" ),
+                ARRAYOFCONST( ( FileName, TLSErrorStr() ) )
+            )
+        );
+    }
+}
+//---------------------------------------------------------------------------
+
+void TLSClientContext::SetCertificate( String CertFile, String KeyFile )
+{
+    std::lock_guard<std::mutex> Lock( mutex_ );
+    if ( SSL_CTX_use_certificate_chain_file( ctx_, UTF8String( CertFile ).c_str() ) != 1
+         || SSL_CTX_use_PrivateKey_file( ctx_, UTF8String( KeyFile ).c_str(), SSL_FILETYPE_PEM ) != 1
+         || SSL_CTX_check_private_key( ctx_ ) != 1 ) {
+        throw EBaseException(
+            Format(
+                _D( "TLS: unable to load certificate \"%s\" / key \"%s\" (%s)" ),
+                ARRAYOFCONST( ( CertFile, KeyFile, TLSErrorStr() ) )
+            )
+        );
+    }
+}
+//---------------------------------------------------------------------------
+
+bool TLSClientContext::GetVerifyPeer() const noexcept
+{
+    std::lock_guard<std::mutex> Lock( mutex_ );
+    return verifyPeer_;
+}
+//---------------------------------------------------------------------------
+
+void TLSClientContext::SetVerifyPeer( bool Val )
+{
+    std::lock_guard<std::mutex> Lock( mutex_ );
+    verifyPeer_ = Val;
+    SSL_CTX_set_verify( ctx_, Val ? SSL_VERIFY_PEER : SSL_VERIFY_NONE, nullptr );
+}
+//---------------------------------------------------------------------------
+
+size_t TLSClientContext::GetMaxIdleConnections() const noexcept
+{
+    std::lock_guard<std::mutex> Lock( mutex_ );
+    return maxIdleConnections_;
+}
+//---------------------------------------------------------------------------
+
+void TLSClientContext::SetMaxIdleConnections( size_t Val )
+{
+    ConnectionCont Dropped;
+    {
+        std::lock_guard<std::mutex> Lock( mutex_ );
+        maxIdleConnections_ = Val;
+        for ( auto It = idle_.begin(); It != idle_.end(); ) {
+            if ( idle_.count( It->first ) > Val ) {
+                auto Next = std::next( It );
+                Dropped.insert( idle_.extract( It ) );
+                It = Next;
+            }
+            else {
+                ++It;
+            }
+        }
+    }
+    // Dropped connections are closed here, outside the lock
+}
+//---------------------------------------------------------------------------
+
+void TLSClientContext::ResumeSession( Connection const & Conn )
+{
+    std::lock_guard<std::mutex> Lock( mutex_ );
+    auto It = sessions_.find( Conn.Endpoint );
+    if ( It != sessions_.end() ) {
+        SSL_set_session( Conn.Ssl, It->second );
+    }
+}
+//---------------------------------------------------------------------------
+
+void TLSClientContext::ForgetSession( std::string const & Endpoint )
+{
+    std::lock_guard<std::mutex> Lock( mutex_ );
+    auto It = sessions_.find( Endpoint );
+    if ( It != sessions_.end() ) {
+        SSL_SESSION_free( It->second );
+        sessions_.erase( It );
+    }
+}
+//---------------------------------------------------------------------------
+
+void TLSClientContext::StoreSession( std::string const & Endpoint, SSL_SESSION* Session )
+{
+    std::lock_guard<std::mutex> Lock( mutex_ );
+    SSL_SESSION*& Slot = sessions_[Endpoint];
+    if ( Slot ) {
+        SSL_SESSION_free( Slot );
+    }
+    Slot = Session;
+}
+//---------------------------------------------------------------------------
+
+int TLSClientContext::OnNewSession( SSL* Ssl, SSL_SESSION* Session )
+{
+    auto Self = static_cast<TLSClientContext*>( SSL_CTX_get_app_data( SSL_get_SSL_CTX( Ssl ) ) );
+    auto Conn = static_cast<Connection*>( SSL_get_app_data( Ssl ) );
+    if ( !Self || !Conn || !SSL_SESSION_is_resumable( Session ) ) {
+        return 0;
+    }
+    Self->StoreSession( Conn->Endpoint, Session );
+    return 1; // the cache keeps the reference
+}
+//---------------------------------------------------------------------------
+
+TLSClientContext::ConnectionPtr TLSClientContext::CheckOut( std::string const & Endpoint )
+{
+    for ( ;; ) {
+        ConnectionPtr Conn;
+        {
+            std::lock_guard<std::mutex> Lock( mutex_ );
+            auto It = idle_.find( Endpoint );
+            if ( It == idle_.end() ) {
+                return ConnectionPtr();
+            }
+            Conn = std::move( It->second );
+            idle_.erase( It );
+        }
+        if ( IsAlive( *Conn ) ) {
+            return Conn;
+        }
+        Conn->Broken = true; // closed by the peer while parked
+    }
+}
+//---------------------------------------------------------------------------
+
+void TLSClientContext::CheckIn( ConnectionPtr Conn )
+{
+    if ( !Conn || Conn->Broken ) {
+        return;
+    }
+    std::lock_guard<std::mutex> Lock( mutex_ );
+    if ( idle_.count( Conn->Endpoint ) < maxIdleConnections_ ) {
+        std::string Endpoint = Conn->Endpoint;
+        idle_.emplace( std::move( Endpoint ), std::move( Conn ) );
+    }
+    // otherwise Conn is closed when it goes out of scope
+}
+//---------------------------------------------------------------------------
+
+void TLSClientContext::ClearIdleConnections()
+{
+    ConnectionCont Dropped;
+    {
+        std::lock_guard<std::mutex> Lock( mutex_ );
+        Dropped.swap( idle_ );
+    }
+}
+//---------------------------------------------------------------------------
+
+TCPSecurityProtocolWinSock::TCPSecurityProtocolWinSock(
+                               std::shared_ptr<TLSClientContext> TLSContext,
+                               String Host, uint16_t Port )
+    : tlsContext_( std::move( TLSContext ) ), host_( Host ), port_( Port )
+{
+    if ( !tlsContext_ ) {
+        throw EBaseException( _D( "TLS: no TLS client context" ) );
+    }
+    WSADATA wsaData;
+    if ( WSAStartup( MAKEWORD( 2, 2 ), &wsaData ) != 0 ) {
+        throw EBaseException( _D( "TLS: WSAStartup failed" ) );
+    }
+}
+//---------------------------------------------------------------------------
+
+TCPSecurityProtocolWinSock::~TCPSecurityProtocolWinSock()
+{
+    try {
+        DoClose();
+        WSACleanup();
+    }
+    catch ( ... ) {
+    }
+}
+//---------------------------------------------------------------------------
+
+String TCPSecurityProtocolWinSock::DoGetHost() const
+{
+    return host_;
+}
+//---------------------------------------------------------------------------
+
+void TCPSecurityProtocolWinSock::DoSetHost( String Val )
+{
+    host_ = Val;
+}
+//---------------------------------------------------------------------------
+
+uint16_t TCPSecurityProtocolWinSock::DoGetPort() const noexcept
+{
+    return port_;
+}
+//---------------------------------------------------------------------------
+
+void TCPSecurityProtocolWinSock::DoSetPort( uint16_t Val )
+{
+    port_ = Val;
+}
+//---------------------------------------------------------------------------
+
+bool TCPSecurityProtocolWinSock::IsSessionResumed() const noexcept
+{
+    return connection_ && SSL_session_reused( connection_->Ssl ) == 1;
+}
+//---------------------------------------------------------------------------
+
+std::string TCPSecurityProtocolWinSock::GetEndpoint() const
+{
+    return std::string( UTF8String( host_ ).c_str() ) + ':' + std::to_string( port_ );
+}
+//---------------------------------------------------------------------------
+
+SOCKET TCPSecurityProtocolWinSock::Connect() const
+{
+    SOCKET const sock = ConnectTCPSocket( host_, port_, GetConnectTimeout(), _D( "TLS" ) );
+
+    // Read timeout of the handshake; DoRead() switches to the transaction timeout
+    DWORD readTimeout = GetResponseTimeout();
+    setsockopt( sock, SOL_SOCKET, SO_RCVTIMEO,
+                reinterpret_cast<const char*>( &readTimeout ), sizeof( readTimeout ) );
+
+    // Each request would otherwise wait for the ACK of the previous TLS record
+    BOOL noDelay = TRUE;
+    setsockopt( sock, IPPROTO_TCP, TCP_NODELAY,
+                reinterpret_cast<const char*>( &noDelay ), sizeof( noDelay ) );
+
+    return sock;
+}
+//---------------------------------------------------------------------------
+
+void TCPSecurityProtocolWinSock::DoOpen()
+{
+    DoClose();
+
+    std::string const endpoint = GetEndpoint();
+
+    connectionReused_ = false;
+    if ( auto idle = tlsContext_->CheckOut( endpoint ) ) {
+        connection_ = std::move( idle );
+        connectionReused_ = true;
+        return;
+    }
+
+    auto conn = std::make_unique<TLSClientContext::Connection>();
+    conn->Endpoint = endpoint;
+    conn->Socket = Connect();
+    conn->ReadTimeout = GetResponseTimeout();
+    conn->Ssl = SSL_new( tlsContext_->GetHandle() );
+    if ( !conn->Ssl ) {
+        conn->Broken = true;
+        throw EBaseException(
+            Format( _D( "TLS: SSL_new failed (%s)" ), ARRAYOFCONST( ( TLSErrorStr() ) ) )
+        );
+    }
+    SSL_set_app_data( conn->Ssl, conn.get() );
+    SSL_set_fd( conn->Ssl, static_cast<int>( conn->Socket ) );
+
+    // The certificate must name the address we connected to: an IP address is
+    // matched against the IP SANs, anything else is a host name (and sent as SNI)
+    UTF8String const hostName( host_ );
+    if ( X509_VERIFY_PARAM_set1_ip_asc( SSL_get0_param( conn->Ssl ), hostName.c_str() ) != 1 ) {
+        SSL_set_tlsext_host_name( conn->Ssl, hostName.c_str() );
+        SSL_set1_host( conn->Ssl, hostName.c_str() );
+    }
+
+    tlsContext_->ResumeSession( *conn );
+
+    if ( SSL_connect( conn->Ssl ) != 1 ) {
+        conn->Broken = true;
+        tlsContext_->ForgetSession( endpoint );
+        long const verifyResult = SSL_get_verify_result( conn->Ssl );
+        String const reason =
+            verifyResult != X509_V_OK ?
+                String( X509_verify_cert_error_string( verifyResult ) ) : TLSErrorStr();
+        throw EBaseException(
+            Format(
+                _D( "TLS: handshake with %s:%u failed (%s)" ),
+                ARRAYOFCONST( ( host_, port_, reason ) )
+            )
+        );
+    }
+
+    connection_ = std::move( conn );
+}
+//---------------------------------------------------------------------------
+
+void TCPSecurityProtocolWinSock::DoClose()
+{
+    if ( connection_ ) {
+        // Parked for reuse if the pool has room, closed otherwise
+        tlsContext_->CheckIn( std::move( connection_ ) );
+    }
+}
+//---------------------------------------------------------------------------
+
+bool TCPSecurityProtocolWinSock::DoIsConnected() const noexcept
+{
+    return static_cast<bool>( connection_ );
+}
+//---------------------------------------------------------------------------
+
+void TCPSecurityProtocolWinSock::Fail( String Msg )
+{
+    // After a fatal TLS error the session cannot go on: drop the connection so
+    // the next Open() reconnects (normally resuming the cached session)
+    connection_->Broken = true;
+    connection_.reset();
+    throw EBaseException( Msg );
+}
+//---------------------------------------------------------------------------
+
+void TCPSecurityProtocolWinSock::DoInputBufferClear()
+{
+    // Non-blocking, so that post-handshake messages (session tickets) are
+    // processed without waiting for application data that is not coming
+    if ( !SetSocketNonBlocking( connection_->Socket, true ) ) {
+        Fail( _D( "TLS: unable to switch the socket to non-blocking mode" ) );
+    }
+
+    char buf[256];
+    int  result;
+    while ( ( result = SSL_read( connection_->Ssl, buf, sizeof( buf ) ) ) > 0 ) {
+    }
+    int const error = SSL_get_error( connection_->Ssl, result );
+
+    if ( !SetSocketNonBlocking( connection_->Socket, false ) ) {
+        Fail( _D( "TLS: unable to switch the socket back to blocking mode" ) );
+    }
+
+    if ( error != SSL_ERROR_WANT_READ && error != SSL_ERROR_WANT_WRITE ) {
+        ERR_clear_error();
+        Fail( _D( "TLS: connection closed" ) );
+    }
+}
+//---------------------------------------------------------------------------
+
+void TCPSecurityProtocolWinSock::DoWrite( TBytes const OutBuffer )
+{
+    // Without SSL_MODE_ENABLE_PARTIAL_WRITE, SSL_write sends all or fails
+    if ( SSL_write( connection_->Ssl, &OutBuffer[0], OutBuffer.Length ) <= 0 ) {
+        ERR_clear_error();
+        Fail( _D( "TLS: send failed" ) );
+    }
+}
+//---------------------------------------------------------------------------
+
+void TCPSecurityProtocolWinSock::DoRead( TBytes & InBuffer, size_t Length )
+{
+    // The timeout travels with the socket, also through the idle connection pool
+    DWORD readTimeout = GetTransactionTimeout();
+    if ( readTimeout != connection_->ReadTimeout ) {
+        setsockopt( connection_->Socket, SOL_SOCKET, SO_RCVTIMEO,
+                    reinterpret_cast<const char*>( &readTimeout ), sizeof( readTimeout ) );
+        connection_->ReadTimeout = readTimeout;
+    }
+
+    InBuffer.Length = static_cast<int>( Length );
+    char*  data     = reinterpret_cast<char*>( &InBuffer[0] );
+    int    received = 0;
+
+    while ( static_cast<size_t>( received ) < Length ) {
+        int result = SSL_read( connection_->Ssl, data + received,
+                               static_cast<int>( Length ) - received );
+        if ( result <= 0 ) {
+            ERR_clear_error();
+            Fail( _D( "TLS: read timeout or connection closed" ) );
+        }
+        received += result;
+    }
+}
+
+//---------------------------------------------------------------------------
+}; // End of namespace Master
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
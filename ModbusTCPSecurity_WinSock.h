@@ -0,0 +1,238 @@
+/**
+ * @file ModbusTCPSecurity_WinSock.h
+ * @brief Modbus::Master::TCPSecurityProtocolWinSock — Modbus/TCP Security (TLS) over WinSock2.
+ *
+ * @details Implements the Modbus/TCP Security profile: the unchanged MBAP framing of
+ *  TCPIPProtocol carried over a TLS connection (OpenSSL) to IANA port 802.
+ *  Key characteristics:
+ *  - TLS 1.2 or later, server certificate and host name (or IP address) verification,
+ *    optional client certificate for mutual authentication (the device derives the
+ *    client role from it).
+ *  - TLS settings live in a TLSClientContext shared by any number of protocol objects.
+ *    The context caches the last session (TLS 1.2 session ID or TLS 1.3 ticket) per
+ *    endpoint, so a reconnect performs an abbreviated handshake.
+ *  - Optionally, Close() parks the connection in the context instead of closing it and
+ *    the next Open() to the same endpoint takes it back without any handshake.
+ *  - Non-blocking connect with GetConnectTimeout() (5 seconds by default); SO_RCVTIMEO
+ *    of GetResponseTimeout() for the handshake and of the transaction timeout for the
+ *    responses, as TCPProtocolWinSock.
+ */
+
+//---------------------------------------------------------------------------
+
+#ifndef ModbusTCPSecurity_WinSockH
+#define ModbusTCPSecurity_WinSockH
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#include <openssl/ssl.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "ModbusTCP.h"
+
+/** @brief Default Modbus/TCP Security port number (IANA assigned, "mbap-s"). */
+#define  DEFAULT_MODBUS_TCP_SECURITY_PORT  802
+
+/**
+ * @brief Default number of idle connections a TLSClientContext keeps per endpoint.
+ * @details 0 disables connection reuse: Close() always ends the TLS session with a
+ *  close_notify and closes the socket.
+ */
+#if !defined( MODBUS_TLS_DEFAULT_MAX_IDLE_CONNECTIONS )
+  #define MODBUS_TLS_DEFAULT_MAX_IDLE_CONNECTIONS  0
+#endif
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace Master {
+//---------------------------------------------------------------------------
+
+/**
+ * @brief TLS client configuration, session cache and idle connection pool.
+ *
+ * @details Owns the OpenSSL SSL_CTX used by TCPSecurityProtocolWinSock.  Share one
+ *  instance (through std::shared_ptr) between all the masters of an application: the
+ *  sessions the servers hand out are cached per "host:port" endpoint and offered on the
+ *  next handshake to the same endpoint, whichever protocol object performs it.  After a
+ *  device restart many masters reconnect at once; with a warm cache each of them costs
+ *  the device an abbreviated handshake instead of a full certificate exchange.
+ *
+ *  When GetMaxIdleConnections() is not 0, connections released by Close() are kept
+ *  open in the context (up to that many per endpoint) and handed to the next Open()
+ *  for the same endpoint, after a check that the peer has not closed them meanwhile.
+ *
+ *  All members are thread safe.  The configuration setters must be called before the
+ *  first Open() of a protocol object using the context.
+ */
+class TLSClientContext {
+public:
+    /** @brief A TLS connection: the socket and the OpenSSL session running over it. */
+    struct Connection {
+        SOCKET      Socket { INVALID_SOCKET };
+        SSL*        Ssl {};
+        std::string Endpoint;
+        bool        Broken {};  ///< Fatal TLS or socket error: no close_notify, no reuse
+        DWORD       ReadTimeout {};  ///< Current SO_RCVTIMEO of Socket (ms)
+
+        Connection() = default;
+        Connection( Connection const & ) = delete;
+        Connection& operator=( Connection const & ) = delete;
+
+        /** @brief Sends close_notify (unless broken), frees the session and closes the socket. */
+        ~Connection();
+    };
+
+    using ConnectionPtr = std::unique_ptr<Connection>;
+
+    /**
+     * @brief Creates the SSL_CTX (TLS 1.2 minimum, peer verification against the system
+     *  trust store).
+     * @throws EBaseException if OpenSSL cannot create the context.
+     */
+    TLSClientContext();
+
+    /** @brief Closes the idle connections and releases the cached sessions. */
+    ~TLSClientContext();
+
+    TLSClientContext( TLSClientContext const & ) = delete;
+    TLSClientContext& operator=( TLSClientContext const & ) = delete;
+
+    /**
+     * @brief Trusts the CA certificates in a PEM file, in addition to the system store.
+     * @throws EBaseException if the file cannot be loaded.
+     */
+    void SetCAFile( String FileName );
+
+    /**
+     * @brief Sets the client certificate (PEM chain) and its private key (PEM) for mutual
+     *  authentication.
+     * @throws EBaseException if either file cannot be loaded or they do not match.
+     */
+    void SetCertificate( String CertFile, String KeyFile );
+
+    [[ nodiscard ]] bool GetVerifyPeer() const noexcept;
+
+    /**
+     * @brief Enables (default) or disables the verification of the server certificate
+     *  and of its host name.  Disable only for commissioning.
+     */
+    void SetVerifyPeer( bool Val );
+
+    [[ nodiscard ]] size_t GetMaxIdleConnections() const noexcept;
+
+    /** @brief Sets how many idle connections per endpoint Close() may park (0 = none). */
+    void SetMaxIdleConnections( size_t Val );
+
+    /** @brief Returns the underlying OpenSSL context, for settings not wrapped here. */
+    [[ nodiscard ]] SSL_CTX* GetHandle() const noexcept { return ctx_; }
+
+    /** @brief Offers the session cached for Conn.Endpoint, if any, to the next handshake. */
+    void ResumeSession( Connection const & Conn );
+
+    /** @brief Drops the session cached for an endpoint (e.g. after a failed handshake). */
+    void ForgetSession( std::string const & Endpoint );
+
+    /**
+     * @brief Takes an idle connection to Endpoint out of the pool.
+     * @return A live connection, or an empty pointer if none is available.
+     */
+    [[ nodiscard ]] ConnectionPtr CheckOut( std::string const & Endpoint );
+
+    /**
+     * @brief Returns a connection to the pool, or closes it if it is broken or the pool
+     *  for its endpoint is full.
+     */
+    void CheckIn( ConnectionPtr Conn );
+
+    /** @brief Closes all the idle connections. */
+    void ClearIdleConnections();
+private:
+    using ConnectionCont = std::multimap<std::string,ConnectionPtr>;
+    using SessionCont = std::map<std::string,SSL_SESSION*>;
+
+    mutable std::mutex mutex_;
+    SSL_CTX*           ctx_ {};
+    bool               verifyPeer_ { true };
+    size_t             maxIdleConnections_ { MODBUS_TLS_DEFAULT_MAX_IDLE_CONNECTIONS };
+    SessionCont        sessions_;
+    ConnectionCont     idle_;
+
+    static int OnNewSession( SSL* Ssl, SSL_SESSION* Session );
+    void StoreSession( std::string const & Endpoint, SSL_SESSION* Session );
+};
+
+/**
+ * @brief Modbus/TCP Security master: MBAP over TLS on WinSock2 and OpenSSL.
+ *
+ * @details Concrete NVI implementation of the TCPIPProtocol hooks.  DoOpen() resolves
+ *  and connects as TCPProtocolWinSock does, then runs the TLS handshake offering the
+ *  session cached in the TLSClientContext; DoWrite() and DoRead() go through SSL_write()
+ *  and SSL_read().  A TLS or socket error drops the connection, so the next Open()
+ *  reconnects, normally with an abbreviated handshake.
+ *
+ *  @note This class is Windows-only, like the rest of the library (VCL strings and
+ *  exceptions, WinSock2), and requires linking against ws2_32.lib and the OpenSSL
+ *  libssl / libcrypto libraries (1.1.1 or later).  Only the OpenSSL side is portable;
+ *  the tests run on Windows with an OpenSSL build for the RAD Studio toolchain.
+ */
+class TCPSecurityProtocolWinSock : public TCPProtocol {
+public:
+    /**
+     * @brief Constructs the protocol object and initialises WinSock2.
+     * @param TLSContext Shared TLS configuration, session cache and connection pool.
+     * @param Host       Server hostname or IP address (default: "localhost").
+     * @param Port       Server TCP port (default: 802).
+     * @throws EBaseException if WSAStartup fails or TLSContext is empty.
+     */
+    TCPSecurityProtocolWinSock( std::shared_ptr<TLSClientContext> TLSContext,
+                                String Host = String( DEFAULT_MODBUS_TCPIP_HOST ),
+                                uint16_t Port = DEFAULT_MODBUS_TCP_SECURITY_PORT );
+
+    /** @brief Destructor; closes (or parks) the connection and calls WSACleanup. */
+    ~TCPSecurityProtocolWinSock();
+
+    [[ nodiscard ]] std::shared_ptr<TLSClientContext> GetTLSContext() const { return tlsContext_; }
+
+    /** @brief True if the current connection was set up with an abbreviated handshake. */
+    [[ nodiscard ]] bool IsSessionResumed() const noexcept;
+
+    /** @brief True if the last Open() took an idle connection from the pool. */
+    [[ nodiscard ]] bool IsConnectionReused() const noexcept { return connectionReused_; }
+protected:
+    virtual String DoGetProtocolName() const override { return _D( "Modbus/TCP Security (WinSock, OpenSSL)" ); }
+    virtual String DoGetHost() const override;
+    virtual void DoSetHost( String Val ) override;
+    virtual uint16_t DoGetPort() const noexcept override;
+    virtual void DoSetPort( uint16_t Val ) override;
+    virtual void DoOpen() override;
+    virtual void DoClose() override;
+    virtual bool DoIsConnected() const noexcept override;
+    virtual void DoInputBufferClear() override;
+    virtual void DoWrite( TBytes const OutBuffer ) override;
+    virtual void DoRead( TBytes & InBuffer, size_t Length ) override;
+private:
+    std::shared_ptr<TLSClientContext> tlsContext_;
+    String                            host_;
+    uint16_t                          port_;
+    TLSClientContext::ConnectionPtr   connection_;
+    bool                              connectionReused_ {};
+
+    [[ nodiscard ]] std::string GetEndpoint() const;
+    [[ nodiscard ]] SOCKET Connect() const;
+    [[ noreturn ]] void Fail( String Msg );
+};
+
+//---------------------------------------------------------------------------
+}; // End of namespace Master
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
+#endif
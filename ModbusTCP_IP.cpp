@@ -7,6 +7,7 @@
 
 #include "Modbus.h"
 #include "ModbusTCP_IP.h"
+#include "ModbusPDU.h"
 
 #define  MODBUS_TCP_IP_BMAP_TRANSACTION_ID_OFFSET  0
 #define  MODBUS_TCP_IP_BMAP_PROTOCOL_OFFSET        2
@@ -133,12 +134,6 @@ ExceptionCode TCPIPProtocol::GetExceptCode( TBytes const Buffer ) noexcept
 }
 //---------------------------------------------------------------------------
 
-TCPIPProtocol::BMAPDataLengthType TCPIPProtocol::GetDataLength( TBytes const Buffer ) noexcept
-{
-    return Buffer[MODBUS_TCP_IP_REPLY_DATA_OFFSET];
-}
-//---------------------------------------------------------------------------
-
 TCPIPProtocol::BMAPTransactionIdType TCPIPProtocol::GetBMAPTransactionIdentifier(
                                                  TBytes const Buffer ) noexcept
 {
@@ -148,6 +143,15 @@ TCPIPProtocol::BMAPTransactionIdType TCPIPProtocol::GetBMAPTransactionIdentifier
 }
 //---------------------------------------------------------------------------
 
+void TCPIPProtocol::SetBMAPTransactionIdentifier( TBytes & Buffer,
+                                                  BMAPTransactionIdType TransactionId ) noexcept
+{
+    int const Idx = MODBUS_TCP_IP_BMAP_TRANSACTION_ID_OFFSET;
+    Buffer[Idx] = ( TransactionId >> 8 ) & 0xFF;
+    Buffer[Idx + 1] = TransactionId & 0xFF;
+}
+//---------------------------------------------------------------------------
+
 TCPIPProtocol::BMAPProtocolType TCPIPProtocol::GetBMAPProtocol(
                                                  TBytes const Buffer ) noexcept
 {
@@ -210,58 +214,111 @@ int TCPIPProtocol::WriteBMAPHeader( TBytes & OutBuffer, int StartIdx,
 }
 //---------------------------------------------------------------------------
 
-int TCPIPProtocol::WriteAddressPointCountPair( TBytes & OutBuffer,
-                                               int StartIdx,
-                                               RegAddrType StartAddr,
-                                               RegCountType PointCount ) noexcept
+template<typename CodecT, typename... ArgsT>
+TBytes TCPIPProtocol::EncodeFrame( Context const & Context, size_t PDULength,
+                                   ArgsT... Args )
 {
-    OutBuffer[StartIdx++] = ( StartAddr >> 8 ) & 0xFF;   // Starting Address Hi
-    OutBuffer[StartIdx++] = StartAddr & 0xFF;            // Starting Address Lo
-    OutBuffer[StartIdx++] = ( PointCount >> 8 ) & 0xFF;  // No. of Points Hi
-    OutBuffer[StartIdx++] = PointCount & 0xFF;           // No. of Points Lo
-    return StartIdx;
+    TBytes OutBuffer;
+    SetLength( OutBuffer, GetBMAPHeaderLength() + PDULength );
+    int const Idx = WriteBMAPHeader( OutBuffer, 0, Context );
+    CodecT::Encode( GetData( OutBuffer ) + Idx, Args... );
+    return OutBuffer;
 }
 //---------------------------------------------------------------------------
 
-int TCPIPProtocol::WriteData( TBytes & OutBuffer,
-                              int StartIdx, RegAddrType Data ) noexcept
+template<typename CodecT, typename... ArgsT>
+auto TCPIPProtocol::DecodeFrame( Context const & Context, TBytes const & ReplyBuffer,
+                                 ArgsT... Args )
 {
-    OutBuffer[StartIdx++] = ( Data >> 8 ) & 0xFF;   // Data Hi
-    OutBuffer[StartIdx++] = Data & 0xFF;            // Data Lo
-    return StartIdx;
+    // Skip the function code, already checked by RaiseExceptionIfReplyIsNotValid()
+    return CodecT::Decode(
+        Context,
+        GetData( ReplyBuffer ) + MODBUS_TCP_IP_REPLY_DATA_OFFSET,
+        GetLength( ReplyBuffer ) - MODBUS_TCP_IP_REPLY_DATA_OFFSET,
+        Args...
+    );
 }
 //---------------------------------------------------------------------------
 
-void TCPIPProtocol::CopyDataWord( Context const & Context, TBytes const Buffer,
-                                  int BufferOffset, uint16_t* Data )
+TBytes TCPIPProtocol::SendAndReceive( Context const & Context, TBytes const OutBuffer,
+                                      FunctionCode FnCode )
 {
-    int DataLength = GetPayloadLength( Context, Buffer, BufferOffset );
-    for ( int Idx = BufferOffset + 1 ; DataLength ; DataLength -= 2 ) {
-        *Data++ = ( (uint16_t)Buffer[Idx] << 8 ) | ( (uint16_t)Buffer[Idx + 1] & 0xFF );
-        Idx += 2;
+    TransactionPolicy Policy = GetEffectivePolicy( Context );
+
+    for ( int Idx = 0 ; ; ++Idx ) {
+        WaitBeforeRetry( Policy.Backoff.value_or( 0 ), Idx );
+        // An adaptive timeout grows after every unanswered attempt
+        if ( Idx && GetAdaptiveTimeout() ) {
+            Policy = GetEffectivePolicy( Context );
+        }
+        SetTransactionTimeout( Policy.Timeout );
+        try {
+            TBytes ReplyBuffer;
+            RunAttempt(
+                Context, Idx,
+                [&]() {
+                    ReplyBuffer = SendAndReceiveInt( Context, OutBuffer, FnCode );
+                    return true;
+                }
+            );
+            return ReplyBuffer;
+        }
+        catch ( EProtocolException const & ) {
+            throw;
+        }
+        catch ( EBaseException const & ) {
+            if ( Idx >= Policy.RetryCount.value_or( 0 ) || !IsConnected() ) {
+                throw;
+            }
+        }
     }
 }
 //---------------------------------------------------------------------------
 
-int TCPIPProtocol::GetPayloadLength( Context const & Context,
-                                     TBytes const Buffer,
-                                     int BufferOffset )
+TBytes TCPIPProtocol::SendAndReceiveInt( Context const & Context, TBytes const OutBuffer,
+                                         FunctionCode FnCode )
 {
-    int const DataLength = GetDataLength( Buffer );
-    if ( ( GetLength( Buffer ) - 2 != DataLength ) ||
-         ( ~( GetLength( Buffer ) - BufferOffset ) & 1 ) )
-    {
-        throw EContextException(
-            Context,
-            Format(
-                _D( "Invalid received frame lenght %d" )
-              , ARRAYOFCONST( (
-                    DataLength
-                ) )
-            )
-        );
+    // A plain Context leaves the numbering to the link (see SendAndReceive())
+    TBytes Frame = OutBuffer;
+    if ( !Context.GetTransactionIdentifier() ) {
+        Frame = OutBuffer.CopyRange( 0, GetLength( OutBuffer ) );
+        SetBMAPTransactionIdentifier( Frame, NextTransactionIdentifier() );
     }
-    return DataLength;
+
+    // Send
+    DoInputBufferClear();
+    NotifyTX( Frame );
+    DoWrite( Frame );
+
+    // Receive, skipping the late replies to the requests abandoned before this one
+    TBytes ReplyBMAPBuffer;
+    for ( ;; ) {
+        SetLength( ReplyBMAPBuffer, GetBMAPHeaderLength() );
+        DoRead( ReplyBMAPBuffer, GetLength( ReplyBMAPBuffer ) );
+        if ( GetBMAPTransactionIdentifier( ReplyBMAPBuffer ) ==
+               GetBMAPTransactionIdentifier( Frame ) ||
+             GetBMAPProtocol( ReplyBMAPBuffer ) ) {
+            break;
+        }
+        BMAPDataLengthType const StaleLength = GetBMAPDataLength( ReplyBMAPBuffer );
+        RaiseExceptionIfBMAPDataLengthIsNotValid( Context, StaleLength );
+        TBytes StaleBuffer;
+        SetLength( StaleBuffer, StaleLength - 1 );
+        DoRead( StaleBuffer, GetLength( StaleBuffer ) );
+        NotifyRX( ReplyBMAPBuffer, StaleBuffer );
+    }
+
+    // Verifica BMAP di risposta
+    RaiseExceptionIfBMAPIsNotEQ( Context, Frame, ReplyBMAPBuffer );
+    TBytes ReplyBuffer;
+    SetLength( ReplyBuffer, GetBMAPDataLength( ReplyBMAPBuffer ) - 1 );
+    DoRead( ReplyBuffer, GetLength( ReplyBuffer ) );
+    NotifyRX( ReplyBMAPBuffer, ReplyBuffer );
+
+    // Verifica parametri di risposta
+    RaiseExceptionIfReplyIsNotValid( Context, ReplyBuffer, FnCode );
+
+    return ReplyBuffer;
 }
 //---------------------------------------------------------------------------
 
@@ -273,54 +330,27 @@ String TCPIPProtocol::DoGetProtocolParamsStr() const
 //---------------------------------------------------------------------------
 
 //    TCPIPProtocol::DoReadCoilStatus
-void TCPIPProtocol::ReadBits( FunctionCode FnCode, Context const & Context,
+//    TCPIPProtocol::DoReadInputStatus
+template<FunctionCode FC>
+void TCPIPProtocol::ReadBits( Context const & Context,
                               CoilAddrType StartAddr, CoilCountType PointCount,
                               CoilDataType* Data )
 {
-    if ( PointCount == 0 || PointCount > 2000 ) {
-        throw EContextException( Context, _D( "Invalid point count" ) );
-    }
+    using Codec = PDU::Codec<FC>;
 
-    const uint8_t ExpectedByteCount =
-        static_cast<uint8_t>( ( PointCount + 7 ) / 8 );
+    Codec::RaiseExceptionIfPointCountIsNotValid( Context, PointCount );
 
-    // Send
-    TBytes OutBuffer;
-    SetLength( OutBuffer, GetBMAPHeaderLength() + 1 + GetAddressPointCountPairLength() );
-    int Idx = WriteBMAPHeader( OutBuffer, 0, Context );
-    OutBuffer[Idx++] = static_cast<RegDataType>( FnCode );
-    Idx = WriteAddressPointCountPair( OutBuffer, Idx, StartAddr, PointCount );
-    DoInputBufferClear();
-    DoWrite( OutBuffer );
-
-    // Receive
-    TBytes ReplyBMAPBuffer;
-    SetLength( ReplyBMAPBuffer, GetBMAPHeaderLength() );
-    DoRead( ReplyBMAPBuffer, GetLength( ReplyBMAPBuffer ) );
-
-    // Validate BMAP and payload function code
-    RaiseExceptionIfBMAPIsNotEQ( Context, OutBuffer, ReplyBMAPBuffer );
-    TBytes ReplyBuffer;
-    SetLength( ReplyBuffer, GetBMAPDataLength( ReplyBMAPBuffer ) - 1 );
-    DoRead( ReplyBuffer, GetLength( ReplyBuffer ) );
-    RaiseExceptionIfReplyIsNotValid( Context, ReplyBuffer, FnCode );
-
-    if ( GetLength( ReplyBuffer ) < 2 ) {
-        throw EContextException( Context, _D( "Invalid reply length" ) );
-    }
-
-    const uint8_t ByteCount = ReplyBuffer[1];
-    if ( ByteCount != ExpectedByteCount || GetLength( ReplyBuffer ) != ByteCount + 2 ) {
-        throw EContextException( Context, _D( "Byte count mismatch" ) );
-    }
+    TBytes const ReplyBuffer =
+        SendAndReceive(
+            Context,
+            EncodeFrame<Codec>( Context, Codec::RequestLength, StartAddr, PointCount ),
+            FC
+        );
 
-    for ( uint8_t I = 0; I < ByteCount; ++I ) {
-        Data[I] = ReplyBuffer[2 + I];
-    }
+    DecodeFrame<Codec>( Context, ReplyBuffer, PointCount, Data );
 }
 //---------------------------------------------------------------------------
 
-//    TCPIPProtocol::DoReadInputStatus
 void TCPIPProtocol::DoReadCoilStatus( Context const & Context,
                                       CoilAddrType StartAddr,
                                       CoilCountType PointCount,
@@ -328,8 +358,7 @@ void TCPIPProtocol::DoReadCoilStatus( Context const & Context,
 {
     RaiseExceptionIfIsNotConnected( _D( "ReadCoilStatus failed" ) );
 
-    ReadBits( FunctionCode::ReadCoilStatus, Context, StartAddr,
-              PointCount, Data );
+    ReadBits<FunctionCode::ReadCoilStatus>( Context, StartAddr, PointCount, Data );
 }
 //---------------------------------------------------------------------------
 
@@ -340,39 +369,27 @@ void TCPIPProtocol::DoReadInputStatus( Context const & Context,
 {
     RaiseExceptionIfIsNotConnected( _D( "ReadInputStatus failed" ) );
 
-    ReadBits( FunctionCode::ReadInputStatus, Context, StartAddr,
-              PointCount, Data );
+    ReadBits<FunctionCode::ReadInputStatus>( Context, StartAddr, PointCount, Data );
 }
 //---------------------------------------------------------------------------
 
-void TCPIPProtocol::ReadRegisters( FunctionCode FnCode, Context const & Context,
+template<FunctionCode FC>
+void TCPIPProtocol::ReadRegisters( Context const & Context,
                                    RegAddrType StartAddr, RegCountType PointCount,
                                    RegDataType* Data )
 {
-    // Send
-    TBytes OutBuffer;
-    SetLength( OutBuffer, GetBMAPHeaderLength() + 1 + GetAddressPointCountPairLength() );
-    int Idx = WriteBMAPHeader( OutBuffer, 0, Context );
-    OutBuffer[Idx++] = static_cast<RegDataType>( FnCode );
-    Idx = WriteAddressPointCountPair( OutBuffer, Idx, StartAddr, PointCount );
-    DoInputBufferClear();
-    DoWrite( OutBuffer );
-
-    // Receive
-    TBytes ReplyBMAPBuffer;
-    SetLength( ReplyBMAPBuffer, GetBMAPHeaderLength() );
-    DoRead( ReplyBMAPBuffer, GetLength( ReplyBMAPBuffer ) );
+    using Codec = PDU::Codec<FC>;
 
-    // Verifica BMAP di risposta
-    RaiseExceptionIfBMAPIsNotEQ( Context, OutBuffer, ReplyBMAPBuffer );
-    TBytes ReplyBuffer;
-    SetLength( ReplyBuffer, GetBMAPDataLength( ReplyBMAPBuffer ) - 1 );
-    DoRead( ReplyBuffer, GetLength( ReplyBuffer ) );
+    Codec::RaiseExceptionIfPointCountIsNotValid( Context, PointCount );
 
-    // Verifica parametri di risposta
-    RaiseExceptionIfReplyIsNotValid( Context, ReplyBuffer, FnCode );
+    TBytes const ReplyBuffer =
+        SendAndReceive(
+            Context,
+            EncodeFrame<Codec>( Context, Codec::RequestLength, StartAddr, PointCount ),
+            FC
+        );
 
-    CopyDataWord( Context, ReplyBuffer, MODBUS_TCP_IP_REPLY_DATA_OFFSET, Data );
+    DecodeFrame<Codec>( Context, ReplyBuffer, PointCount, Data );
 }
 //---------------------------------------------------------------------------
 
@@ -383,8 +400,9 @@ void TCPIPProtocol::DoReadHoldingRegisters( Context const & Context,
 {
     RaiseExceptionIfIsNotConnected( _D( "ReadHoldingRegisters failed" ) );
 
-    ReadRegisters( FunctionCode::ReadHoldingRegisters, Context, StartAddr,
-                   PointCount, Data );
+    ReadRegisters<FunctionCode::ReadHoldingRegisters>(
+        Context, StartAddr, PointCount, Data
+    );
 }
 //---------------------------------------------------------------------------
 
@@ -395,8 +413,9 @@ void TCPIPProtocol::DoReadInputRegisters( Context const & Context,
 {
     RaiseExceptionIfIsNotConnected( _D( "ReadInputRegisters failed" ) );
 
-    ReadRegisters( FunctionCode::ReadInputRegisters, Context, StartAddr,
-                   PointCount, Data );
+    ReadRegisters<FunctionCode::ReadInputRegisters>(
+        Context, StartAddr, PointCount, Data
+    );
 }
 //---------------------------------------------------------------------------
 
@@ -406,32 +425,16 @@ void TCPIPProtocol::DoForceSingleCoil( Context const & Context,
 {
     RaiseExceptionIfIsNotConnected( _D( "ForceSingleCoil failed" ) );
 
-    // Send
-    TBytes OutBuffer;
-
-    SetLength( OutBuffer, GetBMAPHeaderLength() + 1 + 2 + 2 );
-    int Idx = WriteBMAPHeader( OutBuffer, 0, Context );
-    OutBuffer[Idx++] =
-        static_cast<RegDataType>( FunctionCode::ForceSingleCoil );
-    Idx = WriteData( OutBuffer, Idx, Addr );
-    Idx = WriteData( OutBuffer, Idx, static_cast<RegDataType>( Value ? 0xFF00 : 0x0000 ) );
-
-    DoInputBufferClear();
-    DoWrite( OutBuffer );
+    using Codec = PDU::Codec<FunctionCode::ForceSingleCoil>;
 
-    // Receive
-    TBytes ReplyBMAPBuffer;
-    SetLength( ReplyBMAPBuffer, GetBMAPHeaderLength() );
-    DoRead( ReplyBMAPBuffer, GetLength( ReplyBMAPBuffer ) );
-
-    // Verifica BMAP di risposta
-    RaiseExceptionIfBMAPIsNotEQ( Context, OutBuffer, ReplyBMAPBuffer );
-    TBytes ReplyBuffer;
-    SetLength( ReplyBuffer, GetBMAPDataLength( ReplyBMAPBuffer ) - 1 );
-    DoRead( ReplyBuffer, GetLength( ReplyBuffer ) );
+    TBytes const ReplyBuffer =
+        SendAndReceive(
+            Context,
+            EncodeFrame<Codec>( Context, Codec::RequestLength, Addr, Value ),
+            Codec::FnCode
+        );
 
-    // Verifica parametri di risposta
-    RaiseExceptionIfReplyIsNotValid( Context, ReplyBuffer, FunctionCode::ForceSingleCoil );
+    DecodeFrame<Codec>( Context, ReplyBuffer, Addr, Value );
 }
 //---------------------------------------------------------------------------
 
@@ -441,33 +444,16 @@ void TCPIPProtocol::DoPresetSingleRegister( Context const & Context,
 {
     RaiseExceptionIfIsNotConnected( _D( "PresetSingleRegister failed" ) );
 
-    // Send
-    TBytes OutBuffer;
-
-    SetLength( OutBuffer, GetBMAPHeaderLength() + 1 + 2 + 2 );
-    int Idx = WriteBMAPHeader( OutBuffer, 0, Context );
-    OutBuffer[Idx++] =
-        static_cast<RegDataType>( FunctionCode::PresetSingleRegister );
-
-    Idx = WriteData( OutBuffer, Idx, Addr );
-    Idx = WriteData( OutBuffer, Idx, Data );
-
-    DoInputBufferClear();
-    DoWrite( OutBuffer );
+    using Codec = PDU::Codec<FunctionCode::PresetSingleRegister>;
 
-    // Receive
-    TBytes ReplyBMAPBuffer;
-    SetLength( ReplyBMAPBuffer, GetBMAPHeaderLength() );
-    DoRead( ReplyBMAPBuffer, GetLength( ReplyBMAPBuffer ) );
-
-    // Verifica BMAP di risposta
-    RaiseExceptionIfBMAPIsNotEQ( Context, OutBuffer, ReplyBMAPBuffer );
-    TBytes ReplyBuffer;
-    SetLength( ReplyBuffer, GetBMAPDataLength( ReplyBMAPBuffer ) - 1 );
-    DoRead( ReplyBuffer, GetLength( ReplyBuffer ) );
+    TBytes const ReplyBuffer =
+        SendAndReceive(
+            Context,
+            EncodeFrame<Codec>( Context, Codec::RequestLength, Addr, Data ),
+            Codec::FnCode
+        );
 
-    // Verifica parametri di risposta
-    RaiseExceptionIfReplyIsNotValid( Context, ReplyBuffer, FunctionCode::PresetSingleRegister );
+    DecodeFrame<Codec>( Context, ReplyBuffer, Addr, Data );
 }
 //---------------------------------------------------------------------------
 
@@ -477,37 +463,16 @@ ExceptionStatusDataType TCPIPProtocol::DoReadExceptionStatus(
 {
     RaiseExceptionIfIsNotConnected( _D( "ReadExceptionStatus failed" ) );
 
-    // Send: BMAP(7) + FC(1) — no additional payload
-    TBytes OutBuffer;
-    SetLength( OutBuffer, GetBMAPHeaderLength() + 1 );
-    int Idx = WriteBMAPHeader( OutBuffer, 0, Context );
-    OutBuffer[Idx++] =
-        static_cast<RegDataType>( FunctionCode::ReadExceptionStatus );
+    using Codec = PDU::Codec<FunctionCode::ReadExceptionStatus>;
 
-    DoInputBufferClear();
-    DoWrite( OutBuffer );
-
-    // Receive BMAP header
-    TBytes ReplyBMAPBuffer;
-    SetLength( ReplyBMAPBuffer, GetBMAPHeaderLength() );
-    DoRead( ReplyBMAPBuffer, GetLength( ReplyBMAPBuffer ) );
-
-    RaiseExceptionIfBMAPIsNotEQ( Context, OutBuffer, ReplyBMAPBuffer );
-
-    // Receive payload: FC(1) + ExceptionStatus(1)
-    TBytes ReplyBuffer;
-    SetLength( ReplyBuffer, GetBMAPDataLength( ReplyBMAPBuffer ) - 1 );
-    DoRead( ReplyBuffer, GetLength( ReplyBuffer ) );
-
-    RaiseExceptionIfReplyIsNotValid(
-        Context, ReplyBuffer, FunctionCode::ReadExceptionStatus
-    );
-
-    if ( GetLength( ReplyBuffer ) < 2 ) {
-        throw EContextException( Context, _D( "Invalid reply length" ) );
-    }
+    TBytes const ReplyBuffer =
+        SendAndReceive(
+            Context,
+            EncodeFrame<Codec>( Context, Codec::RequestLength ),
+            Codec::FnCode
+        );
 
-    return static_cast<ExceptionStatusDataType>( ReplyBuffer[1] );
+    return DecodeFrame<Codec>( Context, ReplyBuffer );
 }
 //---------------------------------------------------------------------------
 
@@ -518,51 +483,16 @@ RegDataType TCPIPProtocol::DoDiagnostics( Context const & Context,
 {
     RaiseExceptionIfIsNotConnected( _D( "Diagnostics failed" ) );
 
-    // Send: BMAP(7) + FC(1) + SubFunction(2) + Data(2)
-    TBytes OutBuffer;
-    SetLength( OutBuffer, GetBMAPHeaderLength() + 1 + 2 + 2 );
-    int Idx = WriteBMAPHeader( OutBuffer, 0, Context );
-    OutBuffer[Idx++] =
-        static_cast<RegDataType>( FunctionCode::Diagnostics );
-    Idx = WriteData( OutBuffer, Idx, SubFunction );
-    Idx = WriteData( OutBuffer, Idx, Data );
-
-    DoInputBufferClear();
-    DoWrite( OutBuffer );
-
-    // Receive BMAP header
-    TBytes ReplyBMAPBuffer;
-    SetLength( ReplyBMAPBuffer, GetBMAPHeaderLength() );
-    DoRead( ReplyBMAPBuffer, GetLength( ReplyBMAPBuffer ) );
+    using Codec = PDU::Codec<FunctionCode::Diagnostics>;
 
-    RaiseExceptionIfBMAPIsNotEQ( Context, OutBuffer, ReplyBMAPBuffer );
-
-    // Receive payload: FC(1) + SubFunction(2) + Data(2)
-    TBytes ReplyBuffer;
-    SetLength( ReplyBuffer, GetBMAPDataLength( ReplyBMAPBuffer ) - 1 );
-    DoRead( ReplyBuffer, GetLength( ReplyBuffer ) );
-
-    RaiseExceptionIfReplyIsNotValid(
-        Context, ReplyBuffer, FunctionCode::Diagnostics
-    );
-
-    if ( GetLength( ReplyBuffer ) < 5 ) {
-        throw EContextException( Context, _D( "Invalid reply length" ) );
-    }
-
-    // Validate sub-function echo
-    uint16_t const ReplySF =
-        ( static_cast<uint16_t>( ReplyBuffer[1] ) << 8 ) |
-        ( static_cast<uint16_t>( ReplyBuffer[2] ) & 0xFF );
-    if ( ReplySF != SubFunction ) {
-        throw EContextException( Context, _D( "Sub-function mismatch" ) );
-    }
+    TBytes const ReplyBuffer =
+        SendAndReceive(
+            Context,
+            EncodeFrame<Codec>( Context, Codec::RequestLength, SubFunction, Data ),
+            Codec::FnCode
+        );
 
-    // Extract returned data word
-    return static_cast<RegDataType>(
-        ( static_cast<uint16_t>( ReplyBuffer[3] ) << 8 ) |
-        ( static_cast<uint16_t>( ReplyBuffer[4] ) & 0xFF )
-    );
+    return DecodeFrame<Codec>( Context, ReplyBuffer, SubFunction );
 }
 
 //---------------------------------------------------------------------------
@@ -576,11 +506,39 @@ RegDataType TCPIPProtocol::DoDiagnostics( Context const & Context,
 //---------------------------------------------------------------------------
 
 //    TCPIPProtocol::DoFetchCommEventCtr
+CommEventCounter TCPIPProtocol::DoFetchCommEventCtr( Context const & Context )
+{
+    RaiseExceptionIfIsNotConnected( _D( "FetchCommEventCtr failed" ) );
 
+    using Codec = PDU::Codec<FunctionCode::FetchCommEventCtr>;
+
+    TBytes const ReplyBuffer =
+        SendAndReceive(
+            Context,
+            EncodeFrame<Codec>( Context, Codec::RequestLength ),
+            Codec::FnCode
+        );
+
+    return DecodeFrame<Codec>( Context, ReplyBuffer );
+}
 //---------------------------------------------------------------------------
 
 //    TCPIPProtocol::DoFetchCommEventLog
+CommEventLog TCPIPProtocol::DoFetchCommEventLog( Context const & Context )
+{
+    RaiseExceptionIfIsNotConnected( _D( "FetchCommEventLog failed" ) );
+
+    using Codec = PDU::Codec<FunctionCode::FetchCommEventLog>;
+
+    TBytes const ReplyBuffer =
+        SendAndReceive(
+            Context,
+            EncodeFrame<Codec>( Context, Codec::RequestLength ),
+            Codec::FnCode
+        );
 
+    return DecodeFrame<Codec>( Context, ReplyBuffer );
+}
 //---------------------------------------------------------------------------
 
 //    TCPIPProtocol::DoProgramController
@@ -599,45 +557,20 @@ void TCPIPProtocol::DoForceMultipleCoils( Context const & Context,
 {
     RaiseExceptionIfIsNotConnected( _D( "ForceMultipleCoils failed" ) );
 
-    if ( PointCount == 0 || PointCount > 1968 ) {
-        throw EContextException( Context, _D( "Invalid point count" ) );
-    }
-
-    const uint8_t ByteCount = static_cast<uint8_t>( ( PointCount + 7 ) / 8 );
-
-    // Send
-    TBytes OutBuffer;
-
-    SetLength(
-        OutBuffer,
-        GetBMAPHeaderLength() + 1 + GetAddressPointCountPairLength() + 1 + ByteCount
-    );
-    int Idx = WriteBMAPHeader( OutBuffer, 0, Context );
-    OutBuffer[Idx++] =
-        static_cast<RegDataType>( FunctionCode::ForceMultipleCoils );
-    Idx = WriteAddressPointCountPair( OutBuffer, Idx, StartAddr, PointCount );
-    OutBuffer[Idx++] = ByteCount;
-
-    for ( uint8_t I = 0; I < ByteCount; ++I ) {
-        OutBuffer[Idx++] = Data[I];
-    }
-
-    DoInputBufferClear();
-    DoWrite( OutBuffer );
+    using Codec = PDU::Codec<FunctionCode::ForceMultipleCoils>;
 
-    // Receive
-    TBytes ReplyBMAPBuffer;
-    SetLength( ReplyBMAPBuffer, GetBMAPHeaderLength() );
-    DoRead( ReplyBMAPBuffer, GetLength( ReplyBMAPBuffer ) );
+    Codec::RaiseExceptionIfPointCountIsNotValid( Context, PointCount );
 
-    // Verifica BMAP di risposta
-    RaiseExceptionIfBMAPIsNotEQ( Context, OutBuffer, ReplyBMAPBuffer );
-    TBytes ReplyBuffer;
-    SetLength( ReplyBuffer, GetBMAPDataLength( ReplyBMAPBuffer ) - 1 );
-    DoRead( ReplyBuffer, GetLength( ReplyBuffer ) );
+    TBytes const ReplyBuffer =
+        SendAndReceive(
+            Context,
+            EncodeFrame<Codec>(
+                Context, Codec::RequestLength( PointCount ), StartAddr, PointCount, Data
+            ),
+            Codec::FnCode
+        );
 
-    // Verifica parametri di risposta
-    RaiseExceptionIfReplyIsNotValid( Context, ReplyBuffer, FunctionCode::ForceMultipleCoils );
+    DecodeFrame<Codec>( Context, ReplyBuffer, StartAddr, PointCount );
 }
 //---------------------------------------------------------------------------
 
@@ -648,47 +581,39 @@ void TCPIPProtocol::DoPresetMultipleRegisters( Context const & Context,
 {
     RaiseExceptionIfIsNotConnected( _D( "PresetMultipleRegister failed" ) );
 
-    // Send
-    TBytes OutBuffer;
-
-    SetLength(
-        OutBuffer,
-        GetBMAPHeaderLength() + GetAddressPointCountPairLength() +
-        PointCount * sizeof( RegDataType ) + 2
-    );
-    int Idx = WriteBMAPHeader( OutBuffer, 0, Context );
-    OutBuffer[Idx++] =
-        static_cast<RegDataType>( FunctionCode::PresetMultipleRegisters );
-    Idx = WriteAddressPointCountPair( OutBuffer, Idx, StartAddr, PointCount );
-    OutBuffer[Idx++] = PointCount * sizeof( RegDataType );
-
-    for ( RegCountType DataIdx = 0 ; DataIdx < PointCount ; ++DataIdx ) {
-        const RegDataType Reg = Data[DataIdx];
-        OutBuffer[Idx++] = ( Reg >> 8 ) & 0xFF;   // Data Hi
-        OutBuffer[Idx++] = Reg & 0xFF;            // Data Lo
-    }
-
-    DoInputBufferClear();
-    DoWrite( OutBuffer );
+    using Codec = PDU::Codec<FunctionCode::PresetMultipleRegisters>;
 
-    // Receive
-    TBytes ReplyBMAPBuffer;
-    SetLength( ReplyBMAPBuffer, GetBMAPHeaderLength() );
-    DoRead( ReplyBMAPBuffer, GetLength( ReplyBMAPBuffer ) );
+    Codec::RaiseExceptionIfPointCountIsNotValid( Context, PointCount );
 
-    // Verifica BMAP di risposta
-    RaiseExceptionIfBMAPIsNotEQ( Context, OutBuffer, ReplyBMAPBuffer );
-    TBytes ReplyBuffer;
-    SetLength( ReplyBuffer, GetBMAPDataLength( ReplyBMAPBuffer ) - 1 );
-    DoRead( ReplyBuffer, GetLength( ReplyBuffer ) );
+    TBytes const ReplyBuffer =
+        SendAndReceive(
+            Context,
+            EncodeFrame<Codec>(
+                Context, Codec::RequestLength( PointCount ), StartAddr, PointCount, Data
+            ),
+            Codec::FnCode
+        );
 
-    // Verifica parametri di risposta
-    RaiseExceptionIfReplyIsNotValid( Context, ReplyBuffer, FunctionCode::PresetMultipleRegisters );
+    DecodeFrame<Codec>( Context, ReplyBuffer, StartAddr, PointCount );
 }
 //---------------------------------------------------------------------------
 
 //    TCPIPProtocol::DoReportSlave
+std::vector<uint8_t> TCPIPProtocol::DoReportSlave( Context const & Context )
+{
+    RaiseExceptionIfIsNotConnected( _D( "ReportSlave failed" ) );
+
+    using Codec = PDU::Codec<FunctionCode::ReportSlave>;
+
+    TBytes const ReplyBuffer =
+        SendAndReceive(
+            Context,
+            EncodeFrame<Codec>( Context, Codec::RequestLength ),
+            Codec::FnCode
+        );
 
+    return DecodeFrame<Codec>( Context, ReplyBuffer );
+}
 //---------------------------------------------------------------------------
 
 //    TCPIPProtocol::DoProgram884_M84
@@ -707,73 +632,20 @@ void TCPIPProtocol::DoReadGeneralReference( Context const & Context,
 {
     RaiseExceptionIfIsNotConnected( _D( "ReadGeneralReference failed" ) );
 
-    // FC20 request PDU: FC(1) + ByteCount(1) + N * [RefType(1)+FileNo(2)+RecNo(2)+RecLen(2)]
-    const size_t subReqBytes = SubReqCount * 7;
-
-    TBytes OutBuffer;
-    SetLength( OutBuffer, GetBMAPHeaderLength() + 1 + 1 + subReqBytes );
-    int Idx = WriteBMAPHeader( OutBuffer, 0, Context );
-    OutBuffer[Idx++] =
-        static_cast<uint8_t>( FunctionCode::ReadGeneralReference );
-    OutBuffer[Idx++] = static_cast<uint8_t>( subReqBytes );
-
-    for ( size_t i = 0; i < SubReqCount; ++i ) {
-        OutBuffer[Idx++] = 0x06; // reference type
-        OutBuffer[Idx++] = static_cast<uint8_t>( SubRequests[i].FileNumber >> 8 );
-        OutBuffer[Idx++] = static_cast<uint8_t>( SubRequests[i].FileNumber & 0xFF );
-        OutBuffer[Idx++] = static_cast<uint8_t>( SubRequests[i].RecordNumber >> 8 );
-        OutBuffer[Idx++] = static_cast<uint8_t>( SubRequests[i].RecordNumber & 0xFF );
-        OutBuffer[Idx++] = static_cast<uint8_t>( SubRequests[i].RecordLength >> 8 );
-        OutBuffer[Idx++] = static_cast<uint8_t>( SubRequests[i].RecordLength & 0xFF );
-    }
-
-    DoInputBufferClear();
-    DoWrite( OutBuffer );
-
-    // Receive BMAP header
-    TBytes ReplyBMAPBuffer;
-    SetLength( ReplyBMAPBuffer, GetBMAPHeaderLength() );
-    DoRead( ReplyBMAPBuffer, GetLength( ReplyBMAPBuffer ) );
-
-    RaiseExceptionIfBMAPIsNotEQ( Context, OutBuffer, ReplyBMAPBuffer );
+    using Codec = PDU::Codec<FunctionCode::ReadGeneralReference>;
 
-    // Receive payload
-    TBytes ReplyBuffer;
-    SetLength( ReplyBuffer, GetBMAPDataLength( ReplyBMAPBuffer ) - 1 );
-    DoRead( ReplyBuffer, GetLength( ReplyBuffer ) );
+    Codec::RaiseExceptionIfSubRequestsAreNotValid( Context, SubRequests, SubReqCount );
 
-    RaiseExceptionIfReplyIsNotValid(
-        Context, ReplyBuffer, FunctionCode::ReadGeneralReference
-    );
-
-    // Response: FC(1) + RespDataLen(1) + N * [SubRespLen(1) + RefType(1) + Data(RecLen*2)]
-    if ( GetLength( ReplyBuffer ) < 2 ) {
-        throw EContextException( Context, _D( "Invalid reply length" ) );
-    }
+    TBytes const ReplyBuffer =
+        SendAndReceive(
+            Context,
+            EncodeFrame<Codec>(
+                Context, Codec::RequestLength( SubReqCount ), SubRequests, SubReqCount
+            ),
+            Codec::FnCode
+        );
 
-    int off = 2; // skip FC + RespDataLen
-    RegDataType* dataOut = Data;
-    for ( size_t i = 0; i < SubReqCount; ++i ) {
-        if ( off + 2 > GetLength( ReplyBuffer ) ) {
-            throw EContextException( Context, _D( "Truncated response" ) );
-        }
-        const uint8_t subRespLen = ReplyBuffer[off++];
-        const uint8_t refType    = ReplyBuffer[off++];
-        if ( refType != 0x06 ) {
-            throw EContextException( Context, _D( "Invalid reference type" ) );
-        }
-        const size_t dataBytes = subRespLen - 1;
-        if ( dataBytes != SubRequests[i].RecordLength * 2 ) {
-            throw EContextException( Context, _D( "Sub-response length mismatch" ) );
-        }
-        for ( RecordLengthType r = 0; r < SubRequests[i].RecordLength; ++r ) {
-            *dataOut++ = static_cast<RegDataType>(
-                ( static_cast<uint16_t>( ReplyBuffer[off] ) << 8 ) |
-                ( static_cast<uint16_t>( ReplyBuffer[off + 1] ) & 0xFF )
-            );
-            off += 2;
-        }
-    }
+    DecodeFrame<Codec>( Context, ReplyBuffer, SubRequests, SubReqCount, Data );
 }
 //---------------------------------------------------------------------------
 
@@ -785,55 +657,22 @@ void TCPIPProtocol::DoWriteGeneralReference( Context const & Context,
 {
     RaiseExceptionIfIsNotConnected( _D( "WriteGeneralReference failed" ) );
 
-    // FC21 request PDU: FC(1) + ByteCount(1)
-    //   + N * [RefType(1)+FileNo(2)+RecNo(2)+RecLen(2)+Data(RecLen*2)]
-    size_t totalRegs = 0;
-    for ( size_t i = 0; i < SubReqCount; ++i )
-        totalRegs += SubRequests[i].RecordLength;
-
-    const size_t reqBytes = SubReqCount * 7 + totalRegs * 2;
-
-    TBytes OutBuffer;
-    SetLength( OutBuffer, GetBMAPHeaderLength() + 1 + 1 + reqBytes );
-    int Idx = WriteBMAPHeader( OutBuffer, 0, Context );
-    OutBuffer[Idx++] =
-        static_cast<uint8_t>( FunctionCode::WriteGeneralReference );
-    OutBuffer[Idx++] = static_cast<uint8_t>( reqBytes );
-
-    const RegDataType* dataIn = Data;
-    for ( size_t i = 0; i < SubReqCount; ++i ) {
-        OutBuffer[Idx++] = 0x06; // reference type
-        OutBuffer[Idx++] = static_cast<uint8_t>( SubRequests[i].FileNumber >> 8 );
-        OutBuffer[Idx++] = static_cast<uint8_t>( SubRequests[i].FileNumber & 0xFF );
-        OutBuffer[Idx++] = static_cast<uint8_t>( SubRequests[i].RecordNumber >> 8 );
-        OutBuffer[Idx++] = static_cast<uint8_t>( SubRequests[i].RecordNumber & 0xFF );
-        OutBuffer[Idx++] = static_cast<uint8_t>( SubRequests[i].RecordLength >> 8 );
-        OutBuffer[Idx++] = static_cast<uint8_t>( SubRequests[i].RecordLength & 0xFF );
-        for ( RecordLengthType r = 0; r < SubRequests[i].RecordLength; ++r ) {
-            const RegDataType Reg = *dataIn++;
-            OutBuffer[Idx++] = static_cast<uint8_t>( ( Reg >> 8 ) & 0xFF );
-            OutBuffer[Idx++] = static_cast<uint8_t>( Reg & 0xFF );
-        }
-    }
-
-    DoInputBufferClear();
-    DoWrite( OutBuffer );
-
-    // Receive BMAP header
-    TBytes ReplyBMAPBuffer;
-    SetLength( ReplyBMAPBuffer, GetBMAPHeaderLength() );
-    DoRead( ReplyBMAPBuffer, GetLength( ReplyBMAPBuffer ) );
+    using Codec = PDU::Codec<FunctionCode::WriteGeneralReference>;
 
-    RaiseExceptionIfBMAPIsNotEQ( Context, OutBuffer, ReplyBMAPBuffer );
+    Codec::RaiseExceptionIfSubRequestsAreNotValid( Context, SubRequests, SubReqCount );
 
-    // Receive payload (response is an echo)
-    TBytes ReplyBuffer;
-    SetLength( ReplyBuffer, GetBMAPDataLength( ReplyBMAPBuffer ) - 1 );
-    DoRead( ReplyBuffer, GetLength( ReplyBuffer ) );
+    TBytes const ReplyBuffer =
+        SendAndReceive(
+            Context,
+            EncodeFrame<Codec>(
+                Context, Codec::RequestLength( SubRequests, SubReqCount ),
+                SubRequests, SubReqCount, Data
+            ),
+            Codec::FnCode
+        );
 
-    RaiseExceptionIfReplyIsNotValid(
-        Context, ReplyBuffer, FunctionCode::WriteGeneralReference
-    );
+    // The response is an echo of the request
+    DecodeFrame<Codec>( Context, ReplyBuffer, SubRequests, SubReqCount, Data );
 }
 //---------------------------------------------------------------------------
 
@@ -845,34 +684,16 @@ void TCPIPProtocol::DoMaskWrite4XRegister( Context const & Context,
 {
     RaiseExceptionIfIsNotConnected( _D( "MaskWrite4XRegister failed" ) );
 
-    // Send
-    TBytes OutBuffer;
-
-    SetLength( OutBuffer, GetBMAPHeaderLength() + 1 + 2 + 2 + 2 );
-    int Idx = WriteBMAPHeader( OutBuffer, 0, Context );
-    OutBuffer[Idx++] =
-        static_cast<RegDataType>( FunctionCode::MaskWrite4XRegister );
-    Idx = WriteData( OutBuffer, Idx, Addr );
-    Idx = WriteData( OutBuffer, Idx, AndMask );
-    Idx = WriteData( OutBuffer, Idx, OrMask );
-
-    DoInputBufferClear();
-    DoWrite( OutBuffer );
-
-    // Receive
-    TBytes ReplyBMAPBuffer;
-    SetLength( ReplyBMAPBuffer, GetBMAPHeaderLength() );
-    DoRead( ReplyBMAPBuffer, GetLength( ReplyBMAPBuffer ) );
-
-    // Verifica BMAP di risposta
-    RaiseExceptionIfBMAPIsNotEQ( Context, OutBuffer, ReplyBMAPBuffer );
-    TBytes ReplyBuffer;
-    SetLength( ReplyBuffer, GetBMAPDataLength( ReplyBMAPBuffer ) - 1 );
-    DoRead( ReplyBuffer, GetLength( ReplyBuffer ) );
+    using Codec = PDU::Codec<FunctionCode::MaskWrite4XRegister>;
 
-    // Verifica parametri di risposta
-    RaiseExceptionIfReplyIsNotValid( Context, ReplyBuffer, FunctionCode::MaskWrite4XRegister );
+    TBytes const ReplyBuffer =
+        SendAndReceive(
+            Context,
+            EncodeFrame<Codec>( Context, Codec::RequestLength, Addr, AndMask, OrMask ),
+            Codec::FnCode
+        );
 
+    DecodeFrame<Codec>( Context, ReplyBuffer, Addr, AndMask, OrMask );
 }
 //---------------------------------------------------------------------------
 
@@ -887,48 +708,21 @@ void TCPIPProtocol::DoReadWrite4XRegisters( Context const & Context,
 {
     RaiseExceptionIfIsNotConnected( _D( "ReadWrite4XRegisters failed" ) );
 
-    // Send
-    // PDU: FC(1) + ReadAddr(2) + ReadCount(2) + WriteAddr(2) + WriteCount(2)
-    //      + WriteByteCount(1) + WriteValues(WritePointCount * 2)
-    TBytes OutBuffer;
-
-    SetLength(
-        OutBuffer,
-        GetBMAPHeaderLength() + 1 + 2 + 2 + 2 + 2 + 1 +
-        WritePointCount * sizeof( RegDataType )
-    );
-    int Idx = WriteBMAPHeader( OutBuffer, 0, Context );
-    OutBuffer[Idx++] =
-        static_cast<RegDataType>( FunctionCode::ReadWrite4XRegisters );
-    Idx = WriteAddressPointCountPair( OutBuffer, Idx, ReadStartAddr, ReadPointCount );
-    Idx = WriteAddressPointCountPair( OutBuffer, Idx, WriteStartAddr, WritePointCount );
-    OutBuffer[Idx++] =
-        static_cast<uint8_t>( WritePointCount * sizeof( RegDataType ) );
-
-    for ( RegCountType DataIdx = 0; DataIdx < WritePointCount; ++DataIdx ) {
-        const RegDataType Reg = WriteData[DataIdx];
-        OutBuffer[Idx++] = ( Reg >> 8 ) & 0xFF;   // Data Hi
-        OutBuffer[Idx++] = Reg & 0xFF;            // Data Lo
-    }
-
-    DoInputBufferClear();
-    DoWrite( OutBuffer );
-
-    // Receive
-    TBytes ReplyBMAPBuffer;
-    SetLength( ReplyBMAPBuffer, GetBMAPHeaderLength() );
-    DoRead( ReplyBMAPBuffer, GetLength( ReplyBMAPBuffer ) );
+    using Codec = PDU::Codec<FunctionCode::ReadWrite4XRegisters>;
 
-    // Verifica BMAP di risposta
-    RaiseExceptionIfBMAPIsNotEQ( Context, OutBuffer, ReplyBMAPBuffer );
-    TBytes ReplyBuffer;
-    SetLength( ReplyBuffer, GetBMAPDataLength( ReplyBMAPBuffer ) - 1 );
-    DoRead( ReplyBuffer, GetLength( ReplyBuffer ) );
+    Codec::RaiseExceptionIfPointCountIsNotValid( Context, ReadPointCount, WritePointCount );
 
-    // Verifica parametri di risposta
-    RaiseExceptionIfReplyIsNotValid( Context, ReplyBuffer, FunctionCode::ReadWrite4XRegisters );
+    TBytes const ReplyBuffer =
+        SendAndReceive(
+            Context,
+            EncodeFrame<Codec>(
+                Context, Codec::RequestLength( WritePointCount ),
+                ReadStartAddr, ReadPointCount, WriteStartAddr, WritePointCount, WriteData
+            ),
+            Codec::FnCode
+        );
 
-    CopyDataWord( Context, ReplyBuffer, MODBUS_TCP_IP_REPLY_DATA_OFFSET, ReadData );
+    DecodeFrame<Codec>( Context, ReplyBuffer, ReadPointCount, ReadData );
 }
 //---------------------------------------------------------------------------
 
@@ -939,71 +733,268 @@ FIFOCountType TCPIPProtocol::DoReadFIFOQueue( Context const & Context,
 {
     RaiseExceptionIfIsNotConnected( _D( "ReadFIFOQueue failed" ) );
 
-    // Send: BMAP(7) + FC(1) + FIFOPointerAddr(2)
-    TBytes OutBuffer;
-    SetLength( OutBuffer, GetBMAPHeaderLength() + 1 + 2 );
-    int Idx = WriteBMAPHeader( OutBuffer, 0, Context );
-    OutBuffer[Idx++] =
-        static_cast<RegDataType>( FunctionCode::ReadFIFOQueue );
-    Idx = WriteData( OutBuffer, Idx, FIFOAddr );
+    using Codec = PDU::Codec<FunctionCode::ReadFIFOQueue>;
 
-    DoInputBufferClear();
-    DoWrite( OutBuffer );
+    TBytes const ReplyBuffer =
+        SendAndReceive(
+            Context,
+            EncodeFrame<Codec>( Context, Codec::RequestLength, FIFOAddr ),
+            Codec::FnCode
+        );
 
-    // Receive BMAP header
-    TBytes ReplyBMAPBuffer;
-    SetLength( ReplyBMAPBuffer, GetBMAPHeaderLength() );
-    DoRead( ReplyBMAPBuffer, GetLength( ReplyBMAPBuffer ) );
+    return DecodeFrame<Codec>( Context, ReplyBuffer, Data );
+}
+//---------------------------------------------------------------------------
 
-    RaiseExceptionIfBMAPIsNotEQ( Context, OutBuffer, ReplyBMAPBuffer );
+//    TCPIPProtocol::DoReadDeviceIdentification
+std::optional<DeviceObjectIdType> TCPIPProtocol::DoReadDeviceIdentification(
+                                                    Context const & Context,
+                                                    ReadDeviceIdCode Code,
+                                                    DeviceObjectIdType ObjectId,
+                                                    DeviceIdentification& Result )
+{
+    RaiseExceptionIfIsNotConnected( _D( "ReadDeviceIdentification failed" ) );
 
-    // Receive payload
-    TBytes ReplyBuffer;
-    SetLength( ReplyBuffer, GetBMAPDataLength( ReplyBMAPBuffer ) - 1 );
-    DoRead( ReplyBuffer, GetLength( ReplyBuffer ) );
+    using Codec = PDU::Codec<FunctionCode::EncapsulatedInterfaceTransport>;
 
-    RaiseExceptionIfReplyIsNotValid(
-        Context, ReplyBuffer, FunctionCode::ReadFIFOQueue
-    );
+    TBytes const ReplyBuffer =
+        SendAndReceive(
+            Context,
+            EncodeFrame<Codec>( Context, Codec::RequestLength, Code, ObjectId ),
+            Codec::FnCode
+        );
 
-    // Response: FC(1) + ByteCount(2) + FIFOCount(2) + FIFOValues(FIFOCount*2)
-    if ( GetLength( ReplyBuffer ) < 5 ) {
-        throw EContextException( Context, _D( "Invalid reply length" ) );
+    return DecodeFrame<Codec>( Context, ReplyBuffer, Code, ObjectId, std::ref( Result ) );
+}
+//---------------------------------------------------------------------------
+
+TBytes TCPIPProtocol::EncodeRequest( Context const & Context, Request const & Req )
+{
+    switch ( Req.FnCode ) {
+        case FunctionCode::ReadCoilStatus:
+            return EncodeRequest<PDU::Codec<FunctionCode::ReadCoilStatus>>( Context, Req );
+        case FunctionCode::ReadInputStatus:
+            return EncodeRequest<PDU::Codec<FunctionCode::ReadInputStatus>>( Context, Req );
+        case FunctionCode::ReadHoldingRegisters:
+            return EncodeRequest<PDU::Codec<FunctionCode::ReadHoldingRegisters>>( Context, Req );
+        case FunctionCode::ReadInputRegisters:
+            return EncodeRequest<PDU::Codec<FunctionCode::ReadInputRegisters>>( Context, Req );
+        case FunctionCode::ForceSingleCoil: {
+            using Codec = PDU::Codec<FunctionCode::ForceSingleCoil>;
+            return EncodeFrame<Codec>( Context, Codec::RequestLength, Req.Addr, Req.Value != 0 );
+        }
+        case FunctionCode::PresetSingleRegister: {
+            using Codec = PDU::Codec<FunctionCode::PresetSingleRegister>;
+            return EncodeFrame<Codec>( Context, Codec::RequestLength, Req.Addr, Req.Value );
+        }
+        case FunctionCode::Diagnostics: {
+            using Codec = PDU::Codec<FunctionCode::Diagnostics>;
+            return EncodeFrame<Codec>( Context, Codec::RequestLength, Req.Addr, Req.Value );
+        }
+        case FunctionCode::FetchCommEventCtr: {
+            using Codec = PDU::Codec<FunctionCode::FetchCommEventCtr>;
+            return EncodeFrame<Codec>( Context, Codec::RequestLength );
+        }
+        case FunctionCode::ForceMultipleCoils: {
+            using Codec = PDU::Codec<FunctionCode::ForceMultipleCoils>;
+            Codec::RaiseExceptionIfPointCountIsNotValid( Context, Req.PointCount );
+            return EncodeFrame<Codec>(
+                Context, Codec::RequestLength( Req.PointCount ),
+                Req.Addr, Req.PointCount, Req.CoilSource
+            );
+        }
+        case FunctionCode::PresetMultipleRegisters: {
+            using Codec = PDU::Codec<FunctionCode::PresetMultipleRegisters>;
+            Codec::RaiseExceptionIfPointCountIsNotValid( Context, Req.PointCount );
+            return EncodeFrame<Codec>(
+                Context, Codec::RequestLength( Req.PointCount ),
+                Req.Addr, Req.PointCount, Req.RegSource
+            );
+        }
+        case FunctionCode::ReadGeneralReference: {
+            using Codec = PDU::Codec<FunctionCode::ReadGeneralReference>;
+            Codec::RaiseExceptionIfSubRequestsAreNotValid(
+                Context, Req.SubRequests, Req.SubReqCount
+            );
+            return EncodeFrame<Codec>(
+                Context, Codec::RequestLength( Req.SubReqCount ),
+                Req.SubRequests, Req.SubReqCount
+            );
+        }
+        case FunctionCode::WriteGeneralReference: {
+            using Codec = PDU::Codec<FunctionCode::WriteGeneralReference>;
+            Codec::RaiseExceptionIfSubRequestsAreNotValid(
+                Context, Req.SubRequests, Req.SubReqCount
+            );
+            return EncodeFrame<Codec>(
+                Context, Codec::RequestLength( Req.SubRequests, Req.SubReqCount ),
+                Req.SubRequests, Req.SubReqCount, Req.RegSource
+            );
+        }
+        case FunctionCode::MaskWrite4XRegister: {
+            using Codec = PDU::Codec<FunctionCode::MaskWrite4XRegister>;
+            return EncodeFrame<Codec>(
+                Context, Codec::RequestLength, Req.Addr, Req.AndMask, Req.Value
+            );
+        }
+        case FunctionCode::ReadFIFOQueue: {
+            using Codec = PDU::Codec<FunctionCode::ReadFIFOQueue>;
+            return EncodeFrame<Codec>( Context, Codec::RequestLength, Req.Addr );
+        }
+        default:
+            RaiseFunctionCodeNotImplementedException( Req.FnCode );
     }
+    return TBytes();
+}
+//---------------------------------------------------------------------------
 
-    uint16_t const ByteCount =
-        ( static_cast<uint16_t>( ReplyBuffer[1] ) << 8 ) |
-        ( static_cast<uint16_t>( ReplyBuffer[2] ) & 0xFF );
+template<typename CodecT>
+TBytes TCPIPProtocol::EncodeRequest( Context const & Context, Request const & Req )
+{
+    CodecT::RaiseExceptionIfPointCountIsNotValid( Context, Req.PointCount );
+    return EncodeFrame<CodecT>( Context, CodecT::RequestLength, Req.Addr, Req.PointCount );
+}
+//---------------------------------------------------------------------------
 
-    uint16_t const FIFOCount =
-        ( static_cast<uint16_t>( ReplyBuffer[3] ) << 8 ) |
-        ( static_cast<uint16_t>( ReplyBuffer[4] ) & 0xFF );
+void TCPIPProtocol::ReadReply( Context const & Context, TBytes& ReplyBMAPBuffer,
+                               TBytes& ReplyBuffer )
+{
+    SetLength( ReplyBMAPBuffer, GetBMAPHeaderLength() );
+    DoRead( ReplyBMAPBuffer, GetLength( ReplyBMAPBuffer ) );
 
-    if ( FIFOCount > 31 ) {
-        throw EContextException( Context, _D( "FIFO count exceeds maximum (31)" ) );
+    if ( GetBMAPProtocol( ReplyBMAPBuffer ) ) {
+        throw EContextException( Context, _D( "Invalid BMAP Protocol" ) );
     }
+    RaiseExceptionIfBMAPDataLengthIsNotValid( Context, GetBMAPDataLength( ReplyBMAPBuffer ) );
 
-    if ( ByteCount != 2 + FIFOCount * 2 ) {
-        throw EContextException( Context, _D( "Byte count mismatch" ) );
-    }
+    SetLength( ReplyBuffer, GetBMAPDataLength( ReplyBMAPBuffer ) - 1 );
+    DoRead( ReplyBuffer, GetLength( ReplyBuffer ) );
+    NotifyRX( ReplyBMAPBuffer, ReplyBuffer );
+}
+//---------------------------------------------------------------------------
 
-    if ( GetLength( ReplyBuffer ) != 5 + FIFOCount * 2 ) {
-        throw EContextException( Context, _D( "Invalid reply length" ) );
-    }
+TCPIPProtocol::TFlowEvent TCPIPProtocol::SetFlowEventHandler(
+                                   TFlowEvent EventHandler ) noexcept
+{
+    TFlowEvent Old = onFlowEvent_;
+    onFlowEvent_ = EventHandler;
+    return Old;
+}
+//---------------------------------------------------------------------------
 
-    // Extract FIFO register values
-    for ( FIFOCountType I = 0; I < FIFOCount; ++I ) {
-        int const Off = 5 + I * 2;
-        Data[I] = static_cast<RegDataType>(
-            ( static_cast<uint16_t>( ReplyBuffer[Off] ) << 8 ) |
-            ( static_cast<uint16_t>( ReplyBuffer[Off + 1] ) & 0xFF )
-        );
+void TCPIPProtocol::NotifyRX( TBytes const & BMAPBuffer, TBytes const & Buffer )
+{
+    if ( !onFlowEvent_ ) {
+        return;
     }
-
-    return static_cast<FIFOCountType>( FIFOCount );
+    TBytes Frame;
+    SetLength( Frame, GetLength( BMAPBuffer ) + GetLength( Buffer ) );
+    std::copy(
+        GetData( BMAPBuffer ), GetData( BMAPBuffer ) + GetLength( BMAPBuffer ),
+        GetData( Frame )
+    );
+    std::copy(
+        GetData( Buffer ), GetData( Buffer ) + GetLength( Buffer ),
+        GetData( Frame ) + GetLength( BMAPBuffer )
+    );
+    onFlowEvent_( *this, FlowDirection::RX, Frame );
 }
 //---------------------------------------------------------------------------
 
+void TCPIPProtocol::DecodeReply( Context const & Context, Request& Req,
+                                 TBytes const ReplyBuffer )
+{
+    RaiseExceptionIfReplyIsNotValid( Context, ReplyBuffer, Req.FnCode );
+
+    switch ( Req.FnCode ) {
+        case FunctionCode::ReadCoilStatus:
+            DecodeFrame<PDU::Codec<FunctionCode::ReadCoilStatus>>(
+                Context, ReplyBuffer, Req.PointCount, Req.CoilData
+            );
+            break;
+        case FunctionCode::ReadInputStatus:
+            DecodeFrame<PDU::Codec<FunctionCode::ReadInputStatus>>(
+                Context, ReplyBuffer, Req.PointCount, Req.CoilData
+            );
+            break;
+        case FunctionCode::ReadHoldingRegisters:
+            DecodeFrame<PDU::Codec<FunctionCode::ReadHoldingRegisters>>(
+                Context, ReplyBuffer, Req.PointCount, Req.RegData
+            );
+            break;
+        case FunctionCode::ReadInputRegisters:
+            DecodeFrame<PDU::Codec<FunctionCode::ReadInputRegisters>>(
+                Context, ReplyBuffer, Req.PointCount, Req.RegData
+            );
+            break;
+        case FunctionCode::ForceSingleCoil:
+            DecodeFrame<PDU::Codec<FunctionCode::ForceSingleCoil>>(
+                Context, ReplyBuffer, Req.Addr, Req.Value != 0
+            );
+            break;
+        case FunctionCode::PresetSingleRegister:
+            DecodeFrame<PDU::Codec<FunctionCode::PresetSingleRegister>>(
+                Context, ReplyBuffer, Req.Addr, Req.Value
+            );
+            break;
+        case FunctionCode::Diagnostics: {
+            RegDataType const Result =
+                DecodeFrame<PDU::Codec<FunctionCode::Diagnostics>>(
+                    Context, ReplyBuffer, Req.Addr
+                );
+            if ( Req.RegData ) {
+                *Req.RegData = Result;
+            }
+            break;
+        }
+        case FunctionCode::FetchCommEventCtr: {
+            CommEventCounter const Result =
+                DecodeFrame<PDU::Codec<FunctionCode::FetchCommEventCtr>>(
+                    Context, ReplyBuffer
+                );
+            Req.Value = Result.EventCount;
+            if ( Req.RegData ) {
+                Req.RegData[0] = Result.Status;
+                Req.RegData[1] = Result.EventCount;
+            }
+            break;
+        }
+        case FunctionCode::ForceMultipleCoils:
+            DecodeFrame<PDU::Codec<FunctionCode::ForceMultipleCoils>>(
+                Context, ReplyBuffer, Req.Addr, Req.PointCount
+            );
+            break;
+        case FunctionCode::PresetMultipleRegisters:
+            DecodeFrame<PDU::Codec<FunctionCode::PresetMultipleRegisters>>(
+                Context, ReplyBuffer, Req.Addr, Req.PointCount
+            );
+            break;
+        case FunctionCode::ReadGeneralReference:
+            DecodeFrame<PDU::Codec<FunctionCode::ReadGeneralReference>>(
+                Context, ReplyBuffer, Req.SubRequests, Req.SubReqCount, Req.RegData
+            );
+            break;
+        case FunctionCode::WriteGeneralReference:
+            DecodeFrame<PDU::Codec<FunctionCode::WriteGeneralReference>>(
+                Context, ReplyBuffer, Req.SubRequests, Req.SubReqCount, Req.RegSource
+            );
+            break;
+        case FunctionCode::MaskWrite4XRegister:
+            DecodeFrame<PDU::Codec<FunctionCode::MaskWrite4XRegister>>(
+                Context, ReplyBuffer, Req.Addr, Req.AndMask, Req.Value
+            );
+            break;
+        case FunctionCode::ReadFIFOQueue:
+            Req.Value =
+                DecodeFrame<PDU::Codec<FunctionCode::ReadFIFOQueue>>(
+                    Context, ReplyBuffer, Req.RegData
+                );
+            break;
+        default:
+            RaiseFunctionCodeNotImplementedException( Req.FnCode );
+    }
+}
+//---------------------------------------------------------------------------
 //---------------------------------------------------------------------------
 }; // End of namespace Master
 //---------------------------------------------------------------------------
@@ -5,7 +5,7 @@
  * @details Defines:
  *  - Modbus::TCPIPContext: extends Context with an explicit MBAP transaction identifier.
  *  - Modbus::Master::TCPIPProtocol: abstract base implementing all Modbus function codes
- *    (FC01, FC02, FC03, FC04, FC05, FC06, FC07, FC08, FC15, FC16, FC20, FC21, FC22, FC23, FC24) over a byte-stream/datagram
+ *    (FC01, FC02, FC03, FC04, FC05, FC06, FC07, FC08, FC11, FC12, FC15, FC16, FC17, FC20, FC21, FC22, FC23, FC24, FC43/14) over a byte-stream/datagram
  *    transport.  Concrete subclasses provide the actual I/O by implementing DoWrite() and DoRead().
  */
 
@@ -26,6 +26,16 @@
 /** @brief Default Modbus TCP/UDP port number (IANA assigned Modbus port). */
 #define  DEFAULT_MODBUS_TCPIP_PORT  502
 
+#if !defined( MODBUS_TCP_IP_DEFAULT_RESPONSE_TIMEOUT )
+  /** @brief Default time (ms) a TCP/UDP master waits for a response. */
+  #define  MODBUS_TCP_IP_DEFAULT_RESPONSE_TIMEOUT  2000
+#endif
+
+#if !defined( MODBUS_TCP_IP_DEFAULT_CONNECT_TIMEOUT )
+  /** @brief Default time (ms) a TCP master waits for the connection to be established. */
+  #define  MODBUS_TCP_IP_DEFAULT_CONNECT_TIMEOUT  5000
+#endif
+
 //---------------------------------------------------------------------------
 namespace Modbus {
 //---------------------------------------------------------------------------
@@ -47,9 +57,11 @@ public:
      * @brief Constructs a TCP/IP context.
      * @param SlaveAddr     Modbus unit identifier (slave address).
      * @param TransactionId MBAP transaction identifier (default 0).
+     * @param Policy        Timeout and retry policy of the call (default: none).
      */
-    TCPIPContext( SlaveAddrType SlaveAddr, TransactionIdType TransactionId = 0 )
-        : Context( SlaveAddr ), transactionId_( TransactionId ) {}
+    TCPIPContext( SlaveAddrType SlaveAddr, TransactionIdType TransactionId = 0,
+                  TransactionPolicy const & Policy = TransactionPolicy() )
+        : Context( SlaveAddr, Policy ), transactionId_( TransactionId ) {}
 protected:
     /** @brief Returns the stored MBAP transaction identifier. */
     virtual TransactionIdType DoGetTransactionIdentifier() const noexcept override {
@@ -68,10 +80,13 @@ namespace Master {
  *
  * @details TCPIPProtocol is an abstract semi-concrete transport that handles the complete
  *  MBAP (Modbus Application Protocol) layer following the NVI pattern. It:
- *  - Builds Modbus request frames with proper MBAP headers.
+ *  - Builds Modbus request frames with proper MBAP headers around the PDUs produced
+ *    by the Modbus::PDU codecs (ModbusPDU.h).
  *  - Delegates I/O to pure virtual DoWrite() and DoRead() hooks.
  *  - Validates MBAP response headers (transaction ID, protocol ID = 0, unit identifier).
- *  - Implements all Modbus function codes (FC01, FC02, FC03, FC04, FC05, FC06, FC07, FC08, FC15, FC16, FC20, FC21, FC22, FC23, FC24)
+ *  - Reports every frame sent and received to an optional flow-event callback
+ *    (SetFlowEventHandler()), e.g. for a CaptureRecorder.
+ *  - Implements all Modbus function codes (FC01, FC02, FC03, FC04, FC05, FC06, FC07, FC08, FC11, FC12, FC15, FC16, FC17, FC20, FC21, FC22, FC23, FC24, FC43/14)
  *    inherited by TCP/UDP transports.
  *
  *  **NVI Architecture:**
@@ -88,7 +103,7 @@ namespace Master {
  *    (other Do…() methods for FC03, FC04, etc. are defined in Protocol and inherited here).
  *
  *  All Modbus function codes supported by this library
- *  (FC01, FC02, FC03, FC04, FC05, FC06, FC07, FC08, FC15, FC16, FC20, FC21, FC22, FC23, FC24) are
+ *  (FC01, FC02, FC03, FC04, FC05, FC06, FC07, FC08, FC11, FC12, FC15, FC16, FC17, FC20, FC21, FC22, FC23, FC24, FC43/14) are
  *  fully implemented in Protocol and inherited by TCPIPProtocol; concrete TCP/UDP subclasses
  *  do not need to reimplement function code logic.
  */
@@ -105,6 +120,49 @@ public:
 
     /** @brief Sets the TCP/UDP port number. */
     void SetPort( uint16_t Val );
+
+    /**
+     * @brief Returns the time (ms) the transport waits for a response
+     *        (default: MODBUS_TCP_IP_DEFAULT_RESPONSE_TIMEOUT).
+     */
+    [[ nodiscard ]] unsigned GetResponseTimeout() const noexcept { return responseTimeout_; }
+
+    /**
+     * @brief Sets the time (ms) the transport waits for a response.  The TransactionPolicy
+     *        of a call or of its slave overrides it.
+     */
+    void SetResponseTimeout( unsigned Val ) noexcept { responseTimeout_ = Val; }
+
+    /**
+     * @brief Returns the time (ms) Open() waits for a TCP connection
+     *        (default: MODBUS_TCP_IP_DEFAULT_CONNECT_TIMEOUT).
+     */
+    [[ nodiscard ]] unsigned GetConnectTimeout() const noexcept { return connectTimeout_; }
+
+    /** @brief Sets the time (ms) Open() waits for a TCP connection. */
+    void SetConnectTimeout( unsigned Val ) noexcept { connectTimeout_ = Val; }
+
+    /** @brief Indicates whether a flow event relates to a transmitted or received frame. */
+    enum class FlowDirection { RX, TX };
+
+    /**
+     * @brief Signature of the optional frame-flow diagnostic callback.
+     * @details Called once for each transmitted MBAP frame (FlowDirection::TX) before it
+     *  is written to the transport, and once for each received frame (FlowDirection::RX),
+     *  header and PDU together, before it is validated.  The frames of a pipelined batch
+     *  are reported one by one.
+     */
+    using TFlowEvent =
+       void __fastcall ( __closure * )(
+           TCPIPProtocol& Sender, FlowDirection Dir, TBytes const & Frame
+       );
+
+    /**
+     * @brief Installs a frame-flow diagnostic callback and returns the previous one.
+     * @param EventHandler New callback (pass @c nullptr to remove the current one).
+     * @return The previously installed callback, or @c nullptr if none was installed.
+     */
+    TFlowEvent SetFlowEventHandler( TFlowEvent EventHandler ) noexcept;
 protected:
     using BMAPTransactionIdType = uint16_t;  ///< MBAP Transaction Identifier field type.
     using BMAPProtocolType      = uint16_t;  ///< MBAP Protocol Identifier field type (always 0 for Modbus).
@@ -126,7 +184,10 @@ protected:
 
     /**
      * @brief Clears the receive-side input buffer (optional; no-op by default).
-     * @details UDP subclasses override this to discard stale cached datagrams.
+     * @details Called before each request is sent.  UDP subclasses override this to
+     *  discard stale cached datagrams.  Stream transports need not drain the socket
+     *  when the previous reply was read entirely: the late replies that arrive
+     *  afterwards are recognized by transaction identifier and skipped.
      */
     virtual void DoInputBufferClear() {}
 
@@ -173,8 +234,8 @@ protected:
                                        RegDataType Data ) override;
 //    DoProgram484
 //    DoPoll484
-//    DoFetchCommEventCtr
-//    DoFetchCommEventLog
+    virtual CommEventCounter DoFetchCommEventCtr( Context const & Context ) override;
+    virtual CommEventLog DoFetchCommEventLog( Context const & Context ) override;
 //    DoProgramController
 //    DoPollController
     virtual void DoForceMultipleCoils( Context const & Context,
@@ -185,7 +246,7 @@ protected:
                                       RegAddrType StartAddr,
                                       RegCountType PointCount,
                                       RegDataType const * Data ) override;
-//    DoReportSlave
+    virtual std::vector<uint8_t> DoReportSlave( Context const & Context ) override;
 //    DoProgram884_M84
 //    DoResetCommLink
     virtual void DoReadGeneralReference( Context const & Context,
@@ -210,7 +271,80 @@ protected:
     virtual FIFOCountType DoReadFIFOQueue( Context const & Context,
                                           FIFOAddrType FIFOAddr,
                                           RegDataType* Data ) override;
+    virtual std::optional<DeviceObjectIdType> DoReadDeviceIdentification(
+                                                  Context const & Context,
+                                                  ReadDeviceIdCode Code,
+                                                  DeviceObjectIdType ObjectId,
+                                                  DeviceIdentification& Result ) override;
+
+    /**
+     * @brief Builds the complete MBAP request frame for a batch item.
+     * @details The transaction identifier and unit identifier are taken from
+     *  @p Context.  Only the function codes accepted by Request are supported.
+     * @throws EContextException if the point count is out of range.
+     */
+    [[ nodiscard ]] static TBytes EncodeRequest( Context const & Context,
+                                                 Request const & Req );
+
+    /**
+     * @brief Reads one complete response frame (MBAP header and PDU).
+     * @details Only the protocol identifier and the length field are validated,
+     *  so that the caller can match the reply to an outstanding request by
+     *  transaction identifier.
+     */
+    void ReadReply( Context const & Context, TBytes& ReplyBMAPBuffer,
+                    TBytes& ReplyBuffer );
+
+    /**
+     * @brief Validates the PDU of a reply to a batch item and stores its data.
+     * @throws EProtocolException if the slave returned an exception response.
+     * @throws EContextException if the reply does not match the request.
+     */
+    static void DecodeReply( Context const & Context, Request& Req,
+                             TBytes const ReplyBuffer );
+
+    static BMAPTransactionIdType GetBMAPTransactionIdentifier( TBytes const Buffer ) noexcept;
+    static BMAPUnitIdType GetBMAPUnitIdentifier( TBytes const Buffer ) noexcept;
+
+    /**
+     * @brief Returns the next transaction identifier of the link.
+     * @details One sequence numbers both the pipelined batch items and the single
+     *  transactions sent with a plain Context, so that a late reply to any earlier
+     *  request never matches the one in progress.
+     */
+    [[ nodiscard ]] BMAPTransactionIdType NextTransactionIdentifier() noexcept {
+        return ++transactionId_;
+    }
+
+    /**
+     * @brief Returns the response timeout (ms) of the transaction in progress: the
+     *        Timeout of its TransactionPolicy, or GetResponseTimeout() if not set.
+     * @details The transports apply it to the reads (and, for UDP, to the receive that
+     *  follows DoWrite()) before they wait for a response.
+     */
+    [[ nodiscard ]] unsigned GetTransactionTimeout() const noexcept {
+        return transactionTimeout_.value_or( responseTimeout_ );
+    }
+
+    /** @brief Sets the response timeout of the transaction in progress (empty: default). */
+    void SetTransactionTimeout( std::optional<unsigned> Val ) noexcept { transactionTimeout_ = Val; }
+
+    /** @brief Reports a request frame to the flow-event callback, if one is installed. */
+    void NotifyTX( TBytes const & Frame ) {
+        if ( onFlowEvent_ ) {
+            onFlowEvent_( *this, FlowDirection::TX, Frame );
+        }
+    }
+
+    /** @brief Reports a reply (MBAP header and PDU) to the flow-event callback, if one is installed. */
+    void NotifyRX( TBytes const & BMAPBuffer, TBytes const & Buffer );
 private:
+    unsigned                responseTimeout_ { MODBUS_TCP_IP_DEFAULT_RESPONSE_TIMEOUT };
+    unsigned                connectTimeout_ { MODBUS_TCP_IP_DEFAULT_CONNECT_TIMEOUT };
+    std::optional<unsigned> transactionTimeout_;
+    BMAPTransactionIdType   transactionId_ {};
+    TFlowEvent              onFlowEvent_ {};
+
     static void RaiseExceptionIfBMAPIsNotValid( Context const & Context,
                                                 TBytes const Buffer );
     static void RaiseExceptionIfBMAPDataLengthIsNotValid( Context const & Context,
@@ -223,32 +357,54 @@ private:
                                                  FunctionCode ExpectedFunctionCode );
     static FunctionCode GetFunctionCode( TBytes const Buffer ) noexcept;
     static ExceptionCode GetExceptCode( TBytes const Buffer ) noexcept;
-    static BMAPDataLengthType GetDataLength( TBytes const Buffer ) noexcept;
-    static BMAPTransactionIdType GetBMAPTransactionIdentifier( TBytes const Buffer ) noexcept;
     static BMAPProtocolType GetBMAPProtocol( TBytes const Buffer ) noexcept;
     static BMAPDataLengthType GetBMAPDataLength( TBytes const Buffer ) noexcept;
-    static BMAPUnitIdType GetBMAPUnitIdentifier( TBytes const Buffer ) noexcept;
     static BMAPDataLengthType GetBMAPHeaderLength() noexcept { return 7; }
+    static void SetBMAPTransactionIdentifier( TBytes & Buffer,
+                                              BMAPTransactionIdType TransactionId ) noexcept;
     static int WriteBMAPHeader( TBytes & OutBuffer, int StartIdx,
                                 Context const & Context );
-    static int GetAddressPointCountPairLength() noexcept { return 4; }
-    static int WriteAddressPointCountPair( TBytes & OutBuffer, int StartIdx,
-                                           RegAddrType StartAddr,
-                                           RegCountType PointCount ) noexcept;
-    static int WriteData( TBytes & OutBuffer, int StartIdx, RegAddrType Data ) noexcept;
 
-    static void CopyDataWord( Context const & Context, TBytes const Buffer,
-                              int BufferOffset, uint16_t* Data );
+    /**
+     * @brief Builds a request frame: MBAP header followed by the PDU written by
+     *        @p CodecT::Encode( Args... ).
+     */
+    template<typename CodecT, typename... ArgsT>
+    static TBytes EncodeFrame( Context const & Context, size_t PDULength,
+                               ArgsT... Args );
+
+    /** @brief Passes the reply PDU body (after the function code) to @p CodecT::Decode. */
+    template<typename CodecT, typename... ArgsT>
+    static auto DecodeFrame( Context const & Context, TBytes const & ReplyBuffer,
+                             ArgsT... Args );
+
+    template<typename CodecT>
+    static TBytes EncodeRequest( Context const & Context, Request const & Req );
+
+    /**
+     * @brief Sends a request frame and returns the validated reply PDU.
+     * @details Checks the MBAP header against the request and raises the slave
+     *  exception, if any, or a function code mismatch.  If @p Context carries no
+     *  transaction identifier (0, as a plain Context), every attempt is numbered with
+     *  NextTransactionIdentifier(); the complete frames that arrive with another
+     *  identifier are late replies to abandoned requests and are skipped.  The
+     *  TransactionPolicy of @p Context (completed by the slave policy) sets the
+     *  response timeout and the retries (none by default) after a timeout or an
+     *  invalid reply; exception responses are never retried.
+     */
+    TBytes SendAndReceive( Context const & Context, TBytes const OutBuffer,
+                           FunctionCode FnCode );
 
-    static int GetPayloadLength( Context const & Context,
-                                 TBytes const  Buffer,
-                                 int BufferOffset );
+    TBytes SendAndReceiveInt( Context const & Context, TBytes const OutBuffer,
+                              FunctionCode FnCode );
 
-    void ReadRegisters( FunctionCode FnCode, Context const & Context,
+    template<FunctionCode FC>
+    void ReadRegisters( Context const & Context,
                         RegAddrType StartAddr, RegCountType PointCount,
                         RegDataType* Data );
 
-    void ReadBits( FunctionCode FnCode, Context const & Context,
+    template<FunctionCode FC>
+    void ReadBits( Context const & Context,
                    CoilAddrType StartAddr, CoilCountType PointCount,
                    CoilDataType* Data );
 
@@ -19,8 +19,7 @@ namespace Master {
 TCPProtocolIndy::TCPProtocolIndy( String Host, uint16_t Port )
     : idTCPClient_( new TIdTCPClient( 0 ) )
 {
-    idTCPClient_->ConnectTimeout = 5000;
-    idTCPClient_->ReadTimeout = 2000;
+    idTCPClient_->ReadTimeout = GetResponseTimeout();
 
     DoSetHost( Host );
     DoSetPort( Port );
@@ -53,6 +52,7 @@ void TCPProtocolIndy::DoSetPort( uint16_t Val )
 
 void TCPProtocolIndy::DoOpen()
 {
+    idTCPClient_->ConnectTimeout = GetConnectTimeout();
     idTCPClient_->Connect();
 }
 //---------------------------------------------------------------------------
@@ -85,6 +85,7 @@ void TCPProtocolIndy::DoWrite( TBytes const OutBuffer )
 
 void TCPProtocolIndy::DoRead( TBytes & InBuffer, size_t Length )
 {
+    idTCPClient_->ReadTimeout = GetTransactionTimeout();
     idTCPClient_->IOHandler->ReadBytes( InBuffer, Length, false );
 //DebugBytesToHex( _D( "TCP RX: " ), InBuffer );
 }
@@ -2,7 +2,10 @@
 
 #pragma hdrstop
 
+#include <algorithm>
+
 #include "ModbusTCP_WinSock.h"
+#include "ModbusWinSock.h"
 
 //---------------------------------------------------------------------------
 #pragma package(smart_init)
@@ -16,6 +19,7 @@ namespace Master {
 
 TCPProtocolWinSock::TCPProtocolWinSock( String Host, uint16_t Port )
     : host_( Host ), port_( Port ), socket_( INVALID_SOCKET )
+    , receiveBuffer_( MODBUS_TCP_WINSOCK_RECEIVE_BUFFER_SIZE )
 {
     WSADATA wsaData;
     if ( WSAStartup( MAKEWORD( 2, 2 ), &wsaData ) != 0 ) {
@@ -63,69 +67,15 @@ void TCPProtocolWinSock::DoOpen()
 {
     DoClose();
 
-    ADDRINFOW hints = {};
-    hints.ai_family   = AF_UNSPEC;
-    hints.ai_socktype = SOCK_STREAM;
-    hints.ai_protocol = IPPROTO_TCP;
-
-    ADDRINFOW* result = nullptr;
-    if ( GetAddrInfoW( host_.c_str(), String( port_ ).c_str(), &hints, &result ) != 0 ) {
-        throw EBaseException( _D( "TCP: GetAddrInfoW failed" ) );
-    }
-
-    SOCKET sock = INVALID_SOCKET;
-    for ( ADDRINFOW* ptr = result; ptr != nullptr; ptr = ptr->ai_next ) {
-        sock = ::socket( ptr->ai_family, ptr->ai_socktype, ptr->ai_protocol );
-        if ( sock == INVALID_SOCKET )
-            continue;
-
-        // Use non-blocking connect so we can apply a connect timeout
-        u_long nonBlocking = 1;
-        ioctlsocket( sock, FIONBIO, &nonBlocking );
-
-        ::connect( sock, ptr->ai_addr, static_cast<int>( ptr->ai_addrlen ) );
-
-        fd_set writeSet, errSet;
-        FD_ZERO( &writeSet );
-        FD_ZERO( &errSet );
-        FD_SET( sock, &writeSet );
-        FD_SET( sock, &errSet );
-        timeval tv = { 5, 0 }; // 5 second connect timeout
-        int sel = select( 0, nullptr, &writeSet, &errSet, &tv );
-
-        u_long blocking = 0;
-        ioctlsocket( sock, FIONBIO, &blocking );
-
-        if ( sel <= 0 || FD_ISSET( sock, &errSet ) ) {
-            closesocket( sock );
-            sock = INVALID_SOCKET;
-            continue;
-        }
-
-        // Verify the connect completed cleanly even when writeable
-        int soError = 0;
-        int soErrorLen = sizeof( soError );
-        if ( getsockopt( sock, SOL_SOCKET, SO_ERROR,
-                         reinterpret_cast<char*>( &soError ), &soErrorLen ) == SOCKET_ERROR
-             || soError != 0 ) {
-            closesocket( sock );
-            sock = INVALID_SOCKET;
-            continue;
-        }
-        break; // connected
-    }
-    FreeAddrInfoW( result );
-
-    if ( sock == INVALID_SOCKET ) {
-        throw EBaseException( _D( "TCP: connection failed" ) );
-    }
+    SOCKET const sock = ConnectTCPSocket( host_, port_, GetConnectTimeout(), _D( "TCP" ) );
 
     socket_ = sock;
+    DiscardReceived();
+    receiveFailed_ = false;
 
-    // 2 second read timeout
-    DWORD readTimeout = 2000;
-    setsockopt( socket_, SOL_SOCKET, SO_RCVTIMEO,
-                reinterpret_cast<const char*>( &readTimeout ), sizeof( readTimeout ) );
+    // A new socket never times out
+    readTimeout_ = 0;
+    SetReadTimeout( GetResponseTimeout() );
 }
 //---------------------------------------------------------------------------
 
@@ -147,11 +97,18 @@ bool TCPProtocolWinSock::DoIsConnected() const noexcept
 
 void TCPProtocolWinSock::DoInputBufferClear()
 {
+    // In step with the stream: the previous reply was consumed entirely
+    bool const InStep = receiveBegin_ == receiveEnd_ && !receiveFailed_;
+    DiscardReceived();
+    if ( InStep ) {
+        return;
+    }
+    receiveFailed_ = false;
+
     u_long available = 0;
     ioctlsocket( socket_, FIONREAD, &available );
     while ( available > 0 ) {
-        char buf[256];
-        recv( socket_, buf, sizeof( buf ), 0 );
+        recv( socket_, &receiveBuffer_[0], static_cast<int>( receiveBuffer_.size() ), 0 );
         ioctlsocket( socket_, FIONREAD, &available );
     }
 }
@@ -166,6 +123,7 @@ void TCPProtocolWinSock::DoWrite( TBytes const OutBuffer )
     while ( total < length ) {
         int sent = send( socket_, data + total, length - total, 0 );
         if ( sent <= 0 ) {
+            DoClose();
             throw EBaseException( _D( "TCP: send failed" ) );
         }
         total += sent;
@@ -175,19 +133,68 @@ void TCPProtocolWinSock::DoWrite( TBytes const OutBuffer )
 
 void TCPProtocolWinSock::DoRead( TBytes & InBuffer, size_t Length )
 {
-    InBuffer.Length = static_cast<int>( Length );
-    char*  data     = reinterpret_cast<char*>( &InBuffer[0] );
-    int    received = 0;
-
-    while ( static_cast<size_t>( received ) < Length ) {
-        int result = recv( socket_, data + received,
-                           static_cast<int>( Length ) - received, 0 );
-        if ( result <= 0 ) {
-            throw EBaseException( _D( "TCP: read timeout or connection closed" ) );
+    if ( receiveEnd_ - receiveBegin_ < Length ) {
+        SetReadTimeout( GetTransactionTimeout() );
+
+        // Make room at the end of the buffer for the whole read
+        if ( receiveBegin_ ) {
+            std::copy(
+                receiveBuffer_.begin() + receiveBegin_, receiveBuffer_.begin() + receiveEnd_,
+                receiveBuffer_.begin()
+            );
+            receiveEnd_ -= receiveBegin_;
+            receiveBegin_ = 0;
+        }
+        if ( receiveBuffer_.size() < Length ) {
+            receiveBuffer_.resize( Length );
         }
-        received += result;
+
+        do {
+            int result = recv( socket_, &receiveBuffer_[receiveEnd_],
+                               static_cast<int>( receiveBuffer_.size() - receiveEnd_ ), 0 );
+            if ( !result ) {
+                DoClose();
+                throw EBaseException( _D( "TCP: connection closed by the server" ) );
+            }
+            if ( result < 0 ) {
+                receiveFailed_ = true;
+                throw EBaseException( _D( "TCP: read timeout or connection closed" ) );
+            }
+            receiveEnd_ += result;
+        } while ( receiveEnd_ - receiveBegin_ < Length );
+    }
+
+    InBuffer.Length = static_cast<int>( Length );
+    if ( Length ) {
+        std::copy(
+            receiveBuffer_.begin() + receiveBegin_,
+            receiveBuffer_.begin() + receiveBegin_ + Length,
+            reinterpret_cast<char*>( &InBuffer[0] )
+        );
+    }
+    receiveBegin_ += Length;
+    if ( receiveBegin_ == receiveEnd_ ) {
+        DiscardReceived();
+    }
+}
+//---------------------------------------------------------------------------
+
+void TCPProtocolWinSock::SetReadTimeout( DWORD Val )
+{
+    // One setsockopt() per change of timeout, not per read
+    if ( Val != readTimeout_ ) {
+        setsockopt( socket_, SOL_SOCKET, SO_RCVTIMEO,
+                    reinterpret_cast<const char*>( &Val ), sizeof( Val ) );
+        readTimeout_ = Val;
     }
 }
+//---------------------------------------------------------------------------
+
+void TCPProtocolWinSock::DiscardReceived() noexcept
+{
+    receiveBegin_ = 0;
+    receiveEnd_ = 0;
+}
 
 //---------------------------------------------------------------------------
 }; // End of namespace Master
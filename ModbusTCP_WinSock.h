@@ -8,6 +8,8 @@
  *  - Hostname resolution via GetAddrInfoW() (supports Unicode hostnames).
  *  - Non-blocking connect with a 5-second timeout using select().
  *  - SO_RCVTIMEO set to 2 seconds for receive operations.
+ *  - Buffered receive: one recv() pulls everything available, so that a reply (and,
+ *    when pipelining, several replies) is usually parsed out of a single system call.
  */
 
 //---------------------------------------------------------------------------
@@ -18,10 +20,21 @@
 #include <winsock2.h>
 #include <ws2tcpip.h>
 
+#include <cstddef>
 #include <cstdint>
+#include <vector>
 
 #include "ModbusTCP.h"
 
+/**
+ * @brief Default size (bytes) of the receive buffer of TCPProtocolWinSock.
+ * @details Large enough for the replies of a full pipeline window of maximum-size
+ *  responses (8 × 260 bytes).
+ */
+#if !defined( MODBUS_TCP_WINSOCK_RECEIVE_BUFFER_SIZE )
+  #define MODBUS_TCP_WINSOCK_RECEIVE_BUFFER_SIZE  4096
+#endif
+
 //---------------------------------------------------------------------------
 namespace Modbus {
 //---------------------------------------------------------------------------
@@ -41,8 +54,23 @@ namespace Master {
  *  Connection & Initialization:
  *  - WSAStartup is called in the constructor; WSACleanup in the destructor.
  *  - GetAddrInfoW() is used for name resolution (Unicode-safe).
- *  - connect() is performed in non-blocking mode with a 5-second timeout via select().
- *  - SO_RCVTIMEO is set to 2 seconds; a timeout causes an EBaseException to be thrown.
+ *  - connect() is performed in non-blocking mode with a timeout (GetConnectTimeout(),
+ *    5 seconds by default) via select().
+ *  - SO_RCVTIMEO follows the response timeout of each transaction (2 seconds by default,
+ *    see TransactionPolicy) and is reprogrammed only when it changes; a timeout causes an
+ *    EBaseException to be thrown.
+ *  - A failed send or a connection closed by the server closes the socket as well, so
+ *    that IsConnected() reports the lost link (see TCPProtocol::DoExecute()).
+ *
+ *  Receive buffer:
+ *  - DoRead() serves the bytes already buffered and, when they are not enough, calls
+ *    recv() once for all the free space of the buffer instead of once per field.  A
+ *    header and its PDU, or a burst of pipelined replies, cost one system call.
+ *  - DoInputBufferClear() costs no system call when the previous reply was read
+ *    entirely: the late replies that may still arrive are skipped by transaction
+ *    identifier (see TCPIPProtocol).  The socket is drained as before only after a
+ *    read failure or when a reply was abandoned midway, since the stream position is
+ *    unknown then.
  *
  *  @note This class is Windows-only and requires linking against ws2_32.lib.
  */
@@ -75,6 +103,15 @@ private:
     String   host_;
     uint16_t port_;
     SOCKET   socket_;
+    DWORD    readTimeout_ {};
+
+    std::vector<char> receiveBuffer_;
+    size_t            receiveBegin_ {};
+    size_t            receiveEnd_ {};
+    bool              receiveFailed_ {};
+
+    void SetReadTimeout( DWORD Val );
+    void DiscardReceived() noexcept;
 };
 
 //---------------------------------------------------------------------------
@@ -0,0 +1,533 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <numeric>
+
+#include "ModbusPDU.h"
+#include "ModbusTagDatabase.h"
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace Master {
+//---------------------------------------------------------------------------
+
+namespace {
+
+char const * const TableNames[] = {
+    "Coil", "DiscreteInput", "InputRegister", "HoldingRegister"
+};
+
+char const * const TypeNames[] = {
+    "UInt16", "Int16", "UInt32", "Int32", "Float32", "Float64", "Bit"
+};
+
+char const * const WordOrderNames[] = { "ABCD", "CDAB", "BADC", "DCBA" };
+
+constexpr size_t MinFieldCount = 5;
+constexpr size_t MaxFieldCount = 9;
+
+[[ noreturn ]] void RaiseInvalidTagException( TagDefinition const & Tag, String Reason )
+{
+    throw EBaseException(
+        Format(
+            _D( "Invalid tag \"%s\": %s" )
+          , ARRAYOFCONST( ( UTF8ToString( Tag.Name.c_str() ), Reason ) )
+        )
+    );
+}
+//---------------------------------------------------------------------------
+
+[[ noreturn ]] void RaiseInvalidFieldException( std::string const & Field )
+{
+    throw EBaseException(
+        Format(
+            _D( "invalid field \"%s\"" ), ARRAYOFCONST( ( UTF8ToString( Field.c_str() ) ) )
+        )
+    );
+}
+//---------------------------------------------------------------------------
+
+std::string Trim( std::string const & Val )
+{
+    size_t const First = Val.find_first_not_of( " \t" );
+    if ( First == std::string::npos ) {
+        return std::string();
+    }
+    return Val.substr( First, Val.find_last_not_of( " \t" ) - First + 1 );
+}
+//---------------------------------------------------------------------------
+
+template<size_t N>
+size_t ParseName( char const * const ( &Names )[N], std::string const & Val )
+{
+    auto const It = std::find( std::begin( Names ), std::end( Names ), Val );
+    if ( It == std::end( Names ) ) {
+        RaiseInvalidFieldException( Val );
+    }
+    return static_cast<size_t>( It - std::begin( Names ) );
+}
+//---------------------------------------------------------------------------
+
+unsigned long ParseUnsigned( std::string const & Val )
+{
+    char* End {};
+    unsigned long const Result = std::strtoul( Val.c_str(), &End, 10 );
+    if ( Val.empty() || *End || Val[0] == '-' ) {
+        RaiseInvalidFieldException( Val );
+    }
+    return Result;
+}
+//---------------------------------------------------------------------------
+
+double ParseDouble( std::string const & Val )
+{
+    char* End {};
+    double const Result = std::strtod( Val.c_str(), &End );
+    if ( Val.empty() || *End ) {
+        RaiseInvalidFieldException( Val );
+    }
+    return Result;
+}
+//---------------------------------------------------------------------------
+
+TagDefinition ParseLine( std::string const & Line )
+{
+    std::vector<std::string> Fields;
+    size_t Begin = 0;
+    for ( ;; ) {
+        size_t const End = Line.find( ',', Begin );
+        Fields.push_back( Trim( Line.substr( Begin, End - Begin ) ) );
+        if ( End == std::string::npos ) {
+            break;
+        }
+        Begin = End + 1;
+    }
+    if ( Fields.size() < MinFieldCount || Fields.size() > MaxFieldCount ) {
+        throw EBaseException( _D( "wrong number of fields" ) );
+    }
+
+    TagDefinition Tag;
+    Tag.Name = Fields[0];
+    unsigned long const SlaveAddr = ParseUnsigned( Fields[1] );
+    if ( SlaveAddr > 0xFF ) {
+        RaiseInvalidFieldException( Fields[1] );
+    }
+    Tag.SlaveAddr = static_cast<Context::SlaveAddrType>( SlaveAddr );
+    Tag.Table = static_cast<TagTable>( ParseName( TableNames, Fields[2] ) );
+    unsigned long const Addr = ParseUnsigned( Fields[3] );
+    if ( Addr > 0xFFFF ) {
+        RaiseInvalidFieldException( Fields[3] );
+    }
+    Tag.Addr = static_cast<uint16_t>( Addr );
+    Tag.Type = static_cast<ChangeDetect::TagType>( ParseName( TypeNames, Fields[4] ) );
+    if ( Fields.size() > 5 && !Fields[5].empty() ) {
+        Tag.Order = static_cast<DataConv::WordOrder>( ParseName( WordOrderNames, Fields[5] ) );
+    }
+    if ( Fields.size() > 6 && !Fields[6].empty() ) {
+        Tag.Scale = ParseDouble( Fields[6] );
+    }
+    if ( Fields.size() > 7 && !Fields[7].empty() ) {
+        Tag.Offset = ParseDouble( Fields[7] );
+    }
+    if ( Fields.size() > 8 && !Fields[8].empty() ) {
+        std::string Deadband = Fields[8];
+        Tag.Deadband = ChangeDetect::DeadbandType::Absolute;
+        if ( Deadband.back() == '%' ) {
+            Deadband.pop_back();
+            Tag.Deadband = ChangeDetect::DeadbandType::Percent;
+        }
+        Tag.DeadbandValue = ParseDouble( Trim( Deadband ) );
+    }
+    return Tag;
+}
+//---------------------------------------------------------------------------
+
+bool IsBitTable( TagTable Table ) noexcept
+{
+    return Table == TagTable::Coil || Table == TagTable::DiscreteInput;
+}
+//---------------------------------------------------------------------------
+
+template<typename T>
+void DecodeRegisters( RegDataType const * Src, size_t Count, DataConv::WordOrder Order,
+                      double* Dst )
+{
+    // Converted in chunks through the SIMD kernels, widened to double after
+    constexpr size_t ChunkSize = 64;
+    constexpr size_t Stride = sizeof( T ) / sizeof( RegDataType );
+    T Chunk[ChunkSize];
+    while ( Count ) {
+        size_t const Length = std::min( Count, ChunkSize );
+        DataConv::FromRegisters( Src, Length, Chunk, Order );
+        std::copy( Chunk, Chunk + Length, Dst );
+        Src += Length * Stride;
+        Dst += Length;
+        Count -= Length;
+    }
+}
+
+} // End of anonymous namespace
+
+//---------------------------------------------------------------------------
+
+size_t TagDefinition::GetPointCount() const noexcept
+{
+    switch ( Type ) {
+        case ChangeDetect::TagType::UInt32:
+        case ChangeDetect::TagType::Int32:
+        case ChangeDetect::TagType::Float32:
+            return 2;
+        case ChangeDetect::TagType::Float64:
+            return 4;
+        default:
+            return 1;
+    }
+}
+//---------------------------------------------------------------------------
+
+size_t TagDatabase::Add( TagDefinition Tag )
+{
+    if ( Tag.Name.empty() ) {
+        RaiseInvalidTagException( Tag, _D( "empty name" ) );
+    }
+    if ( names_.count( Tag.Name ) ) {
+        RaiseInvalidTagException( Tag, _D( "duplicate name" ) );
+    }
+    if ( IsBitTable( Tag.Table ) != ( Tag.Type == ChangeDetect::TagType::Bit ) ) {
+        RaiseInvalidTagException( Tag, _D( "type does not match the table" ) );
+    }
+    if ( Tag.Addr + Tag.GetPointCount() > 0x10000 ) {
+        RaiseInvalidTagException( Tag, _D( "address out of range" ) );
+    }
+    if ( !std::isfinite( Tag.Scale ) || !std::isfinite( Tag.Offset ) ||
+         !std::isfinite( Tag.DeadbandValue ) || Tag.DeadbandValue < 0.0 ) {
+        RaiseInvalidTagException( Tag, _D( "invalid scaling or deadband" ) );
+    }
+
+    size_t const Idx = tags_.size();
+    names_[Tag.Name] = Idx;
+    tags_.push_back( std::move( Tag ) );
+    return Idx;
+}
+//---------------------------------------------------------------------------
+
+void TagDatabase::Load( String const & FileName )
+{
+    Clear();
+
+    std::ifstream In( std::filesystem::path( FileName.c_str() ), std::ios::binary );
+    if ( !In ) {
+        throw EBaseException(
+            Format( _D( "Unable to open \"%s\"" ), ARRAYOFCONST( ( FileName ) ) )
+        );
+    }
+
+    std::string Line;
+    for ( size_t LineNo = 1 ; std::getline( In, Line ) ; ++LineNo ) {
+        if ( !Line.empty() && Line.back() == '\r' ) {
+            Line.pop_back();
+        }
+        Line = Trim( Line );
+        if ( Line.empty() || Line[0] == '#' ) {
+            continue;
+        }
+        try {
+            Add( ParseLine( Line ) );
+        }
+        catch ( Exception const & E ) {
+            Clear();
+            throw EBaseException(
+                Format(
+                    _D( "Invalid tag file, line %u: %s" )
+                  , ARRAYOFCONST( ( static_cast<unsigned>( LineNo ), E.Message ) )
+                )
+            );
+        }
+    }
+}
+//---------------------------------------------------------------------------
+
+std::optional<size_t> TagDatabase::IndexOf( std::string const & Name ) const
+{
+    auto const It = names_.find( Name );
+    if ( It == names_.end() ) {
+        return std::nullopt;
+    }
+    return It->second;
+}
+//---------------------------------------------------------------------------
+
+TagScanner::TagScanner( Protocol& Proto, TagDatabase const & Database, unsigned MaxGap )
+  : proto_( Proto )
+  , maxGap_( MaxGap )
+{
+    Compile( Database );
+}
+//---------------------------------------------------------------------------
+
+void TagScanner::Compile( TagDatabase const & Database )
+{
+    size_t const TagCount = Database.GetCount();
+
+    // Slots are the tags sorted by unit, table and address
+    tagIndexes_.resize( TagCount );
+    std::iota( tagIndexes_.begin(), tagIndexes_.end(), size_t() );
+    std::stable_sort(
+        tagIndexes_.begin(), tagIndexes_.end(),
+        [&Database]( size_t Lhs, size_t Rhs ) {
+            TagDefinition const & L = Database.GetTag( Lhs );
+            TagDefinition const & R = Database.GetTag( Rhs );
+            if ( L.SlaveAddr != R.SlaveAddr ) {
+                return L.SlaveAddr < R.SlaveAddr;
+            }
+            if ( L.Table != R.Table ) {
+                return L.Table < R.Table;
+            }
+            return L.Addr < R.Addr;
+        }
+    );
+
+    slots_.resize( TagCount );
+    raw_.assign( TagCount, 0.0 );
+    scale_.resize( TagCount );
+    offset_.resize( TagCount );
+    values_.assign( TagCount, 0.0 );
+    reported_.assign( TagCount, 0.0 );
+    absDeadband_.resize( TagCount );
+    relDeadband_.resize( TagCount );
+    valid_.assign( TagCount, 0 );
+
+    // Requests are built once the images have their final size
+    struct BlockRead {
+        Context::SlaveAddrType SlaveAddr;
+        TagTable               Table;
+        uint16_t               Addr;
+        size_t                 PointCount;
+        size_t                 Image;     ///< Register index, or byte index, in the image.
+    };
+    std::vector<BlockRead> Reads;
+    size_t RegImageSize {};
+    size_t BitImageSize {};
+
+    for ( size_t Pos = 0 ; Pos < TagCount ; ) {
+        TagDefinition const & First = Database.GetTag( tagIndexes_[Pos] );
+        bool const Bits = IsBitTable( First.Table );
+        TransactionPolicy const Policy = proto_.GetSlavePolicy( First.SlaveAddr );
+        size_t const MaxCount =
+            Bits ?
+                std::min<size_t>(
+                    PDU::Codec<FunctionCode::ReadCoilStatus>::MaxPointCount,
+                    std::max( Policy.MaxCoilCount.value_or( 0xFFFF ), 1U )
+                )
+            :
+                std::min<size_t>(
+                    PDU::Codec<FunctionCode::ReadHoldingRegisters>::MaxPointCount,
+                    std::max( Policy.MaxRegisterCount.value_or( 0xFFFF ), 1U )
+                );
+
+        // Extend the block while the next tag fits and the gap is small enough
+        size_t End = First.Addr + First.GetPointCount();
+        size_t Next = Pos + 1;
+        for ( ; Next < TagCount ; ++Next ) {
+            TagDefinition const & Tag = Database.GetTag( tagIndexes_[Next] );
+            size_t const TagEnd = std::max( End, Tag.Addr + Tag.GetPointCount() );
+            if ( Tag.SlaveAddr != First.SlaveAddr || Tag.Table != First.Table ||
+                 Tag.Addr > End + maxGap_ || TagEnd - First.Addr > MaxCount ) {
+                break;
+            }
+            End = TagEnd;
+        }
+
+        size_t const PointCount = End - First.Addr;
+        size_t const Image = Bits ? BitImageSize : RegImageSize;
+        Block const Item { runs_.size(), 0, Pos, Next - Pos };
+        for ( size_t Slot = Pos ; Slot < Next ; ++Slot ) {
+            TagDefinition const & Tag = Database.GetTag( tagIndexes_[Slot] );
+            size_t const Source = ( Bits ? Image * 8 : Image ) + ( Tag.Addr - First.Addr );
+            if ( runs_.size() > Item.FirstRun &&
+                 runs_.back().Type == Tag.Type && runs_.back().Order == Tag.Order &&
+                 runs_.back().Source + runs_.back().Count * Tag.GetPointCount() == Source ) {
+                ++runs_.back().Count;
+            }
+            else {
+                runs_.push_back( { Tag.Type, Tag.Order, Source, 1, Slot } );
+            }
+
+            slots_[tagIndexes_[Slot]] = Slot;
+            scale_[Slot] = Tag.Scale;
+            offset_[Slot] = Tag.Offset;
+            absDeadband_[Slot] =
+                Tag.Deadband == ChangeDetect::DeadbandType::Absolute ? Tag.DeadbandValue : 0.0;
+            relDeadband_[Slot] =
+                Tag.Deadband == ChangeDetect::DeadbandType::Percent ?
+                    Tag.DeadbandValue / 100.0
+                :
+                    0.0;
+        }
+        blocks_.push_back( Item );
+        blocks_.back().RunCount = runs_.size() - Item.FirstRun;
+
+        Reads.push_back( { First.SlaveAddr, First.Table, First.Addr, PointCount, Image } );
+        if ( Bits ) {
+            BitImageSize += PDU::GetBitByteCount( PointCount );
+        }
+        else {
+            RegImageSize += PointCount;
+        }
+        Pos = Next;
+    }
+
+    regImage_.resize( RegImageSize );
+    bitImage_.resize( BitImageSize );
+    requests_.reserve( Reads.size() );
+    for ( BlockRead const & Read : Reads ) {
+        uint16_t const Count = static_cast<uint16_t>( Read.PointCount );
+        switch ( Read.Table ) {
+            case TagTable::Coil:
+                requests_.push_back(
+                    Request::ReadCoilStatus(
+                        Read.SlaveAddr, Read.Addr, Count, bitImage_.data() + Read.Image
+                    )
+                );
+                break;
+            case TagTable::DiscreteInput:
+                requests_.push_back(
+                    Request::ReadInputStatus(
+                        Read.SlaveAddr, Read.Addr, Count, bitImage_.data() + Read.Image
+                    )
+                );
+                break;
+            case TagTable::InputRegister:
+                requests_.push_back(
+                    Request::ReadInputRegisters(
+                        Read.SlaveAddr, Read.Addr, Count, regImage_.data() + Read.Image
+                    )
+                );
+                break;
+            default:
+                requests_.push_back(
+                    Request::ReadHoldingRegisters(
+                        Read.SlaveAddr, Read.Addr, Count, regImage_.data() + Read.Image
+                    )
+                );
+                break;
+        }
+    }
+    changes_.reserve( TagCount );
+}
+//---------------------------------------------------------------------------
+
+void TagScanner::SetPolicy( TransactionPolicy const & Val )
+{
+    policy_ = Val;
+    for ( Request& Req : requests_ ) {
+        Req.Policy = Val;
+    }
+}
+//---------------------------------------------------------------------------
+
+size_t TagScanner::Scan()
+{
+    proto_.Execute( requests_.data(), requests_.size() );
+    if ( image_ ) {
+        image_->Publish( requests_.data(), requests_.size() );
+    }
+
+    changes_.clear();
+    failedBlocks_ = 0;
+    lastError_ = String();
+    for ( size_t Idx = 0 ; Idx < blocks_.size() ; ++Idx ) {
+        Block const & Item = blocks_[Idx];
+        Request const & Req = requests_[Idx];
+        size_t const FirstSlot = Item.FirstSlot;
+        size_t const LastSlot = Item.FirstSlot + Item.SlotCount;
+        if ( Req.Status != RequestStatus::Completed ) {
+            if ( !failedBlocks_++ ) {
+                lastError_ = Req.ErrorMessage;
+            }
+            std::fill( valid_.begin() + FirstSlot, valid_.begin() + LastSlot, 0 );
+            continue;
+        }
+
+        for ( size_t Run = Item.FirstRun ; Run < Item.FirstRun + Item.RunCount ; ++Run ) {
+            Decode( runs_[Run] );
+        }
+        for ( size_t Slot = FirstSlot ; Slot < LastSlot ; ++Slot ) {
+            values_[Slot] = raw_[Slot] * scale_[Slot] + offset_[Slot];
+        }
+        for ( size_t Slot = FirstSlot ; Slot < LastSlot ; ++Slot ) {
+            double const Value = values_[Slot];
+            double const Limit =
+                absDeadband_[Slot] + relDeadband_[Slot] * std::fabs( reported_[Slot] );
+            if ( !primed_ || !valid_[Slot] || std::fabs( Value - reported_[Slot] ) > Limit ) {
+                reported_[Slot] = Value;
+                changes_.push_back( { tagIndexes_[Slot], Value } );
+            }
+            valid_[Slot] = 1;
+        }
+    }
+    primed_ = true;
+    return changes_.size();
+}
+//---------------------------------------------------------------------------
+
+std::vector<ProcessImageBlock> TagScanner::GetImageLayout() const
+{
+    std::vector<ProcessImageBlock> Layout;
+    Layout.reserve( requests_.size() );
+    for ( Request const & Req : requests_ ) {
+        Layout.push_back( { Req.SlaveAddr, Req.FnCode, Req.Addr, Req.PointCount } );
+    }
+    return Layout;
+}
+//---------------------------------------------------------------------------
+
+void TagScanner::Decode( DecodeRun const & Run )
+{
+    double* const Dst = raw_.data() + Run.Slot;
+    if ( Run.Type == ChangeDetect::TagType::Bit ) {
+        for ( size_t Idx = 0 ; Idx < Run.Count ; ++Idx ) {
+            size_t const Bit = Run.Source + Idx;
+            Dst[Idx] = ( bitImage_[Bit / 8] >> ( Bit % 8 ) ) & 1;
+        }
+        return;
+    }
+
+    RegDataType const * const Src = regImage_.data() + Run.Source;
+    switch ( Run.Type ) {
+        case ChangeDetect::TagType::UInt16:
+            DecodeRegisters<uint16_t>( Src, Run.Count, Run.Order, Dst );
+            break;
+        case ChangeDetect::TagType::Int16:
+            DecodeRegisters<int16_t>( Src, Run.Count, Run.Order, Dst );
+            break;
+        case ChangeDetect::TagType::UInt32:
+            DecodeRegisters<uint32_t>( Src, Run.Count, Run.Order, Dst );
+            break;
+        case ChangeDetect::TagType::Int32:
+            DecodeRegisters<int32_t>( Src, Run.Count, Run.Order, Dst );
+            break;
+        case ChangeDetect::TagType::Float32:
+            DecodeRegisters<float>( Src, Run.Count, Run.Order, Dst );
+            break;
+        case ChangeDetect::TagType::Float64:
+            DecodeRegisters<double>( Src, Run.Count, Run.Order, Dst );
+            break;
+        default:
+            break;
+    }
+}
+
+//---------------------------------------------------------------------------
+}; // End of namespace Master
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
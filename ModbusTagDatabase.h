@@ -0,0 +1,245 @@
+/**
+ * @file ModbusTagDatabase.h
+ * @brief Modbus::Master::TagDatabase and TagScanner — tag definitions compiled into scan plans.
+ *
+ * @details A TagDatabase holds the definitions of the points of an application: unit,
+ *  table, address, value type, word order, linear scaling and deadband, loaded from a
+ *  text file or added one by one.  Every definition is validated when it is added.
+ *
+ *  A TagScanner compiles a database once for a Protocol:
+ *  - the tags of each unit and table are sorted by address and packed into read blocks,
+ *    as long as a block fits the protocol limit and the MaxRegisterCount / MaxCoilCount
+ *    of the slave policy (see Protocol::SetSlavePolicy()), and the gap between two tags
+ *    does not exceed GetMaxGap() points;
+ *  - the tags of a block that are adjacent and share type and word order become one
+ *    decode run: a single DataConv::FromRegisters() call converts all of them.
+ *
+ *  Scan() then submits the blocks as one Protocol::Execute() batch (pipelined on Modbus
+ *  TCP), runs the decode program of the blocks that completed, scales every value with
+ *  one multiply-add and reports the tags that moved beyond their deadband.  No
+ *  definition is looked at during a scan.  The first Scan() reports every valid tag.
+ *
+ *  File format: one tag per line, comma separated, in UTF-8; empty lines and lines
+ *  starting with @c # are skipped.
+ *  @code
+ *  # Name, Unit, Table, Address, Type [, WordOrder [, Scale [, Offset [, Deadband ] ] ] ]
+ *  Boiler.Temp,   1, HoldingRegister, 100, Float32, CDAB, 1, 0, 0.5
+ *  Boiler.Level,  1, InputRegister,    10, UInt16,  ABCD, 0.1, 0, 2%
+ *  Boiler.Pump,   1, Coil,              5, Bit
+ *  @endcode
+ *  Tables: Coil, DiscreteInput, InputRegister, HoldingRegister.  Types: the names of
+ *  ChangeDetect::TagType.  The value is Raw * Scale + Offset.  A deadband ending with
+ *  @c % is a percentage of the last reported value; an empty deadband reports any
+ *  change.
+ *
+ *  A scanner can also publish the raw blocks of every scan in a process image (see
+ *  GetImageLayout() and SetProcessImage()), for readers in other processes.
+ *
+ *  Neither class is synchronised: scan from one thread.
+ */
+
+//---------------------------------------------------------------------------
+
+#ifndef ModbusTagDatabaseH
+#define ModbusTagDatabaseH
+
+#include <cstdint>
+#include <cstddef>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "Modbus.h"
+#include "ModbusChangeDetect.h"
+#include "ModbusDataConv.h"
+#include "ModbusProcessImage.h"
+
+/** @brief Default largest run of unused points a TagScanner reads to merge two blocks. */
+#if !defined( MODBUS_TAG_DEFAULT_MAX_GAP )
+  #define MODBUS_TAG_DEFAULT_MAX_GAP  8
+#endif
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace Master {
+//---------------------------------------------------------------------------
+
+/** @brief Modbus table a tag lives in. */
+enum class TagTable {
+    Coil,              ///< FC01.
+    DiscreteInput,     ///< FC02.
+    InputRegister,     ///< FC04.
+    HoldingRegister,   ///< FC03.
+};
+
+/** @brief Definition of one tag (see file description). */
+struct TagDefinition {
+    std::string                Name;   ///< Unique, UTF-8.
+    Context::SlaveAddrType     SlaveAddr {};
+    TagTable                   Table { TagTable::HoldingRegister };
+    uint16_t                   Addr {};
+    ChangeDetect::TagType      Type { ChangeDetect::TagType::UInt16 };
+    DataConv::WordOrder        Order { DataConv::WordOrder::ABCD };  ///< For 32/64-bit types.
+    double                     Scale { 1.0 };
+    double                     Offset {};
+    ChangeDetect::DeadbandType Deadband { ChangeDetect::DeadbandType::None };
+    double                     DeadbandValue {};
+
+    /** @brief Number of registers or bits the tag takes. */
+    [[ nodiscard ]] size_t GetPointCount() const noexcept;
+};
+
+/** @brief Validated tag definitions (see file description). */
+class TagDatabase {
+public:
+    /**
+     * @brief Adds a tag.
+     * @return The index of the tag.
+     * @throws EBaseException if the name is empty or already used, the type does not
+     *         match the table, the tag runs past address 0xFFFF, or the scaling or
+     *         the deadband is not a finite number.
+     */
+    size_t Add( TagDefinition Tag );
+
+    /**
+     * @brief Replaces the content of the database with the tags of a file.
+     * @throws EBaseException if the file cannot be read or a line is not valid (the
+     *         message reports the line); the database is left empty.
+     */
+    void Load( String const & FileName );
+
+    void Clear() noexcept { tags_.clear(); names_.clear(); }
+
+    [[ nodiscard ]] size_t GetCount() const noexcept { return tags_.size(); }
+    [[ nodiscard ]] TagDefinition const & GetTag( size_t Idx ) const { return tags_.at( Idx ); }
+
+    /** @brief Returns the index of a tag, or nothing if there is no tag with that name. */
+    [[ nodiscard ]] std::optional<size_t> IndexOf( std::string const & Name ) const;
+private:
+    std::vector<TagDefinition>    tags_;
+    std::map<std::string,size_t>  names_;
+};
+
+/** @brief Scans the tags of a TagDatabase through compiled read plans (see file description). */
+class TagScanner {
+public:
+    /**
+     * @brief Compiles the scan plan of @p Database.
+     * @param Proto    Protocol used for the scans; must outlive the scanner.  Its slave
+     *                 policies are read once, here.
+     * @param Database Tags to scan; copied into the plan, so it may be discarded.
+     * @param MaxGap   Largest run of unused points read to merge two blocks.
+     */
+    TagScanner( Protocol& Proto, TagDatabase const & Database,
+                unsigned MaxGap = MODBUS_TAG_DEFAULT_MAX_GAP );
+
+    TagScanner( TagScanner const & Rhs ) = delete;
+    TagScanner& operator=( TagScanner const & Rhs ) = delete;
+
+    /**
+     * @brief Reads every block and updates the values.
+     * @return The number of tags reported by GetChanges().
+     * @details The tags of a block that failed keep their last value and are no
+     *  longer valid (see IsValid()).
+     * @throws EBaseException if the protocol is not open.
+     */
+    size_t Scan();
+
+    /** @brief Tags that moved beyond their deadband at the last Scan(), by tag index. */
+    [[ nodiscard ]] std::vector<ChangeDetect::Change> const & GetChanges() const noexcept { return changes_; }
+
+    /** @brief Returns the scaled value of a tag at the last Scan() that read it. */
+    [[ nodiscard ]] double GetValue( size_t TagIndex ) const { return values_[slots_.at( TagIndex )]; }
+
+    /** @brief Returns @c true if the block of the tag was read by the last Scan(). */
+    [[ nodiscard ]] bool IsValid( size_t TagIndex ) const { return valid_[slots_.at( TagIndex )] != 0; }
+
+    [[ nodiscard ]] size_t GetTagCount() const noexcept { return slots_.size(); }
+
+    /** @brief Number of read transactions per scan. */
+    [[ nodiscard ]] size_t GetBlockCount() const noexcept { return blocks_.size(); }
+
+    /** @brief Number of decode runs per scan. */
+    [[ nodiscard ]] size_t GetRunCount() const noexcept { return runs_.size(); }
+
+    /** @brief Number of blocks that failed at the last Scan(). */
+    [[ nodiscard ]] size_t GetFailedBlockCount() const noexcept { return failedBlocks_; }
+
+    /** @brief Message of the first failed block of the last Scan(). */
+    [[ nodiscard ]] String GetLastError() const { return lastError_; }
+
+    [[ nodiscard ]] unsigned GetMaxGap() const noexcept { return maxGap_; }
+
+    /** @brief Transaction policy of the reads; the slave policies still apply beneath it. */
+    [[ nodiscard ]] TransactionPolicy const & GetPolicy() const noexcept { return policy_; }
+    void SetPolicy( TransactionPolicy const & Val );
+
+    /** @brief Layout of a process image matching the blocks, in scan order. */
+    [[ nodiscard ]] std::vector<ProcessImageBlock> GetImageLayout() const;
+
+    /**
+     * @brief Publishes the blocks in @p Image after every Scan() (@c nullptr to stop).
+     * @param Image Must have been created with GetImageLayout() and outlive its use.
+     */
+    void SetProcessImage( ProcessImageWriter* Image ) noexcept { image_ = Image; }
+
+    /** @brief Forgets the reported values: the next Scan() reports every valid tag. */
+    void Reset() noexcept { primed_ = false; }
+private:
+    /** @brief Tags of one type and word order, adjacent in a block and in the slots. */
+    struct DecodeRun {
+        ChangeDetect::TagType Type;
+        DataConv::WordOrder   Order;
+        size_t                Source;   ///< Register index, or bit index, in the image.
+        size_t                Count;    ///< Number of tags.
+        size_t                Slot;     ///< First slot.
+    };
+
+    /** @brief One read transaction and the slots it feeds. */
+    struct Block {
+        size_t FirstRun;
+        size_t RunCount;
+        size_t FirstSlot;
+        size_t SlotCount;
+    };
+
+    Protocol&                proto_;
+    unsigned                 maxGap_;
+    TransactionPolicy        policy_;
+
+    std::vector<Request>     requests_;     ///< One per block; buffers in the images.
+    std::vector<Block>       blocks_;
+    std::vector<DecodeRun>   runs_;
+    std::vector<RegDataType> regImage_;
+    std::vector<CoilDataType> bitImage_;
+
+    // By slot (tags in plan order)
+    std::vector<size_t>      tagIndexes_;
+    std::vector<double>      raw_;
+    std::vector<double>      scale_;
+    std::vector<double>      offset_;
+    std::vector<double>      values_;
+    std::vector<double>      reported_;
+    std::vector<double>      absDeadband_;
+    std::vector<double>      relDeadband_;
+    std::vector<uint8_t>     valid_;
+
+    std::vector<size_t>      slots_;        ///< Slot of each tag index.
+    std::vector<ChangeDetect::Change> changes_;
+    size_t                   failedBlocks_ {};
+    String                   lastError_;
+    bool                     primed_ {};
+    ProcessImageWriter*      image_ {};
+
+    void Compile( TagDatabase const & Database );
+    void Decode( DecodeRun const & Run );
+};
+
+//---------------------------------------------------------------------------
+}; // End of namespace Master
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
+#endif
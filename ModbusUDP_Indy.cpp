@@ -22,7 +22,7 @@ namespace Master {
 UDPProtocolIndy::UDPProtocolIndy( String Host, uint16_t Port )
     : idUDPClient_( new TIdUDPClient( 0 ) )
 {
-    idUDPClient_->ReceiveTimeout = 2000;
+    idUDPClient_->ReceiveTimeout = GetResponseTimeout();
 
     DoSetHost( Host );
     DoSetPort( Port );
@@ -86,7 +86,8 @@ void UDPProtocolIndy::DoWrite( TBytes const OutBuffer )
 DebugBytesToHex( _D( "UDP TX: " ), OutBuffer );
 #endif
     idUDPClient_->SendBuffer( OutBuffer );
-    recvBufferSize_ = idUDPClient_->ReceiveBuffer( recvBuffer_ );
+    recvBufferSize_ =
+        idUDPClient_->ReceiveBuffer( recvBuffer_, GetTransactionTimeout() );
 }
 //---------------------------------------------------------------------------
 
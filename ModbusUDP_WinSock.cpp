@@ -106,10 +106,9 @@ void UDPProtocolWinSock::DoOpen()
 
     socket_ = sock;
 
-    // 2 second receive timeout
-    DWORD readTimeout = 2000;
-    setsockopt( socket_, SOL_SOCKET, SO_RCVTIMEO,
-                reinterpret_cast<const char*>( &readTimeout ), sizeof( readTimeout ) );
+    // A new socket never times out
+    readTimeout_ = 0;
+    SetReadTimeout( GetResponseTimeout() );
 }
 //---------------------------------------------------------------------------
 
@@ -162,6 +161,7 @@ void UDPProtocolWinSock::DoWrite( TBytes const OutBuffer )
     }
 
     // Receive the response immediately — mirrors the Indy pattern
+    SetReadTimeout( GetTransactionTimeout() );
     recvBuffer_.Length = 2048;
     sockaddr_storage from;
     int fromLen = sizeof( from );
@@ -189,6 +189,17 @@ void UDPProtocolWinSock::DoRead( TBytes & InBuffer, size_t Length )
     DebugBytesToHex( _D( "UDP RX: " ), InBuffer );
 #endif
 }
+//---------------------------------------------------------------------------
+
+void UDPProtocolWinSock::SetReadTimeout( DWORD Val )
+{
+    // One setsockopt() per change of timeout, not per datagram
+    if ( Val != readTimeout_ ) {
+        setsockopt( socket_, SOL_SOCKET, SO_RCVTIMEO,
+                    reinterpret_cast<const char*>( &Val ), sizeof( Val ) );
+        readTimeout_ = Val;
+    }
+}
 
 //---------------------------------------------------------------------------
 }; // End of namespace Master
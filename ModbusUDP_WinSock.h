@@ -44,7 +44,9 @@ namespace Master {
  *    of a single sendto() immediately followed by recvfrom() on the same socket.
  *  - The received datagram is cached internally; subsequent DoRead() calls slice bytes from
  *    this cache without issuing further recvfrom() calls.
- *  - SO_RCVTIMEO is set to 2 seconds; a timeout causes an EBaseException to be thrown.
+ *  - SO_RCVTIMEO follows the response timeout of each transaction (2 seconds by default,
+ *    see TransactionPolicy) and is reprogrammed only when it changes; a timeout causes an
+ *    EBaseException to be thrown.
  *
  *  @note This class is Windows-only and requires linking against ws2_32.lib.
  */
@@ -82,6 +84,9 @@ private:
     TBytes          recvBuffer_;
     int             recvBufferPos_;
     int             recvBufferSize_;
+    DWORD           readTimeout_ {};
+
+    void SetReadTimeout( DWORD Val );
 };
 
 //---------------------------------------------------------------------------
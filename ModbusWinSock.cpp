@@ -0,0 +1,97 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include "ModbusWinSock.h"
+
+//---------------------------------------------------------------------------
+#pragma package(smart_init)
+#pragma comment( lib, "ws2_32" )
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace Master {
+//---------------------------------------------------------------------------
+
+namespace {
+
+// Returns true if the non-blocking connect of Socket completes within Timeout ms
+bool WaitForConnect( SOCKET Socket, unsigned Timeout )
+{
+    fd_set writeSet, errSet;
+    FD_ZERO( &writeSet );
+    FD_ZERO( &errSet );
+    FD_SET( Socket, &writeSet );
+    FD_SET( Socket, &errSet );
+    timeval tv = {
+        static_cast<long>( Timeout / 1000 ),
+        static_cast<long>( Timeout % 1000 * 1000 )
+    };
+    int const sel = select( 0, nullptr, &writeSet, &errSet, &tv );
+    if ( sel <= 0 || FD_ISSET( Socket, &errSet ) ) {
+        return false;
+    }
+
+    // Verify the connect completed cleanly even when writeable
+    int soError = 0;
+    int soErrorLen = sizeof( soError );
+    return getsockopt( Socket, SOL_SOCKET, SO_ERROR,
+                       reinterpret_cast<char*>( &soError ), &soErrorLen ) != SOCKET_ERROR
+           && soError == 0;
+}
+
+} // End of anonymous namespace
+
+//---------------------------------------------------------------------------
+
+bool SetSocketNonBlocking( SOCKET Socket, bool NonBlocking ) noexcept
+{
+    u_long mode = NonBlocking ? 1 : 0;
+    return ioctlsocket( Socket, FIONBIO, &mode ) != SOCKET_ERROR;
+}
+//---------------------------------------------------------------------------
+
+SOCKET ConnectTCPSocket( String const & Host, uint16_t Port, unsigned Timeout,
+                         String const & Prefix )
+{
+    ADDRINFOW hints = {};
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+
+    ADDRINFOW* result = nullptr;
+    if ( GetAddrInfoW( Host.c_str(), String( Port ).c_str(), &hints, &result ) != 0 ) {
+        throw EBaseException( Prefix + _D( ": GetAddrInfoW failed" ) );
+    }
+
+    SOCKET sock = INVALID_SOCKET;
+    for ( ADDRINFOW* ptr = result; ptr != nullptr; ptr = ptr->ai_next ) {
+        sock = ::socket( ptr->ai_family, ptr->ai_socktype, ptr->ai_protocol );
+        if ( sock == INVALID_SOCKET )
+            continue;
+
+        // Non-blocking connect, so that the connect timeout applies; a socket left
+        // in non-blocking mode would break the blocking reads of the transports
+        if ( SetSocketNonBlocking( sock, true ) ) {
+            ::connect( sock, ptr->ai_addr, static_cast<int>( ptr->ai_addrlen ) );
+            if ( WaitForConnect( sock, Timeout ) && SetSocketNonBlocking( sock, false ) ) {
+                break; // connected
+            }
+        }
+        closesocket( sock );
+        sock = INVALID_SOCKET;
+    }
+    FreeAddrInfoW( result );
+
+    if ( sock == INVALID_SOCKET ) {
+        throw EBaseException( Prefix + _D( ": connection failed" ) );
+    }
+    return sock;
+}
+
+//---------------------------------------------------------------------------
+}; // End of namespace Master
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
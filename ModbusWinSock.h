@@ -0,0 +1,52 @@
+/**
+ * @file ModbusWinSock.h
+ * @brief WinSock2 helpers shared by the TCP transports.
+ *
+ * @details ConnectTCPSocket() holds the non-blocking connect with a timeout used by
+ *  TCPProtocolWinSock, RTUOverTCPProtocolWinSock and TCPSecurityProtocolWinSock:
+ *  every address returned by GetAddrInfoW() is tried in turn, connect() runs in
+ *  non-blocking mode, select() waits up to the connect timeout and SO_ERROR confirms
+ *  the connection.  The socket is returned in blocking mode.
+ */
+
+//---------------------------------------------------------------------------
+
+#ifndef ModbusWinSockH
+#define ModbusWinSockH
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#include <cstdint>
+
+#include "Modbus.h"
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace Master {
+//---------------------------------------------------------------------------
+
+/**
+ * @brief Switches a socket to non-blocking (@p NonBlocking @c true) or blocking mode.
+ * @return @c false if ioctlsocket() failed.
+ */
+[[ nodiscard ]] extern bool SetSocketNonBlocking( SOCKET Socket, bool NonBlocking ) noexcept;
+
+/**
+ * @brief Connects a TCP socket to @p Host : @p Port (see file description).
+ * @param Timeout Time (ms) each address is given to accept the connection.
+ * @param Prefix  Transport name that starts the messages of the exceptions.
+ * @return The connected socket, in blocking mode.
+ * @throws EBaseException if the host cannot be resolved or no address accepts the
+ *         connection.
+ */
+[[ nodiscard ]] extern SOCKET ConnectTCPSocket( String const & Host, uint16_t Port,
+                                                unsigned Timeout, String const & Prefix );
+
+//---------------------------------------------------------------------------
+}; // End of namespace Master
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
+#endif
@@ -0,0 +1,249 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include <algorithm>
+
+#include "ModbusWriteQueue.h"
+#include "ModbusPDU.h"
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace Master {
+//---------------------------------------------------------------------------
+
+WriteQueue::WriteQueue( Protocol& Proto, WriteOrdering Ordering, unsigned FlushDeadline )
+  : proto_( Proto )
+  , ordering_( Ordering )
+  , flushDeadline_( FlushDeadline )
+{
+}
+//---------------------------------------------------------------------------
+
+void WriteQueue::ForceSingleCoil( Context::SlaveAddrType SlaveAddr, CoilAddrType Addr,
+                                  bool Value )
+{
+    Enqueue( SlaveAddr, true, Addr, Value ? 1 : 0 );
+}
+//---------------------------------------------------------------------------
+
+void WriteQueue::PresetSingleRegister( Context::SlaveAddrType SlaveAddr,
+                                       RegAddrType Addr, RegDataType Data )
+{
+    Enqueue( SlaveAddr, false, Addr, Data );
+}
+//---------------------------------------------------------------------------
+
+void WriteQueue::Enqueue( Context::SlaveAddrType SlaveAddr, bool Coils, uint16_t Addr,
+                          RegDataType Value )
+{
+    if ( !pendingCount_ ) {
+        oldest_ = ClockType::now();
+    }
+
+    if ( ordering_ == WriteOrdering::Address ) {
+        auto& Table = tables_[TableKey( SlaveAddr, Coils )];
+        auto const Ins = Table.insert_or_assign( Addr, Value );
+        if ( Ins.second ) {
+            ++pendingCount_;
+        }
+    }
+    else {
+        bool Merged {};
+        if ( !runs_.empty() ) {
+            Run& Last = runs_.back();
+            size_t const Length = Last.Values.size();
+            if ( Last.SlaveAddr == SlaveAddr && Last.Coils == Coils ) {
+                if ( Addr >= Last.StartAddr && Addr < Last.StartAddr + Length ) {
+                    Last.Values[Addr - Last.StartAddr] = Value;
+                    Merged = true;
+                }
+                else if ( Length < GetMaxRunLength( Coils ) ) {
+                    if ( Addr == Last.StartAddr + Length ) {
+                        Last.Values.push_back( Value );
+                        Merged = true;
+                        ++pendingCount_;
+                    }
+                    else if ( Addr + 1 == Last.StartAddr ) {
+                        Last.Values.insert( Last.Values.begin(), Value );
+                        Last.StartAddr = Addr;
+                        Merged = true;
+                        ++pendingCount_;
+                    }
+                }
+            }
+        }
+        if ( !Merged ) {
+            runs_.push_back( { SlaveAddr, Coils, Addr, { Value }, {} } );
+            ++pendingCount_;
+        }
+    }
+
+    if ( IsDue() ) {
+        Flush();
+    }
+}
+//---------------------------------------------------------------------------
+
+bool WriteQueue::IsDue() const noexcept
+{
+    return pendingCount_ &&
+           ClockType::now() - oldest_ >= std::chrono::milliseconds( flushDeadline_ );
+}
+//---------------------------------------------------------------------------
+
+bool WriteQueue::FlushIfDue()
+{
+    if ( IsDue() ) {
+        Flush();
+        return true;
+    }
+    return false;
+}
+//---------------------------------------------------------------------------
+
+void WriteQueue::Clear() noexcept
+{
+    tables_.clear();
+    runs_.clear();
+    pendingCount_ = 0;
+}
+//---------------------------------------------------------------------------
+
+size_t WriteQueue::Flush()
+{
+    if ( !pendingCount_ ) {
+        return 0;
+    }
+    return ordering_ == WriteOrdering::Address ? FlushByAddress() : FlushByIssue();
+}
+//---------------------------------------------------------------------------
+
+size_t WriteQueue::GetMaxRunLength( bool Coils ) noexcept
+{
+    return
+        Coils ?
+            PDU::Codec<FunctionCode::ForceMultipleCoils>::MaxPointCount
+        :
+            PDU::Codec<FunctionCode::PresetMultipleRegisters>::MaxPointCount;
+}
+//---------------------------------------------------------------------------
+
+Request WriteQueue::MakeRequest( Run& Item )
+{
+    size_t const Length = Item.Values.size();
+    if ( Item.Coils ) {
+        if ( Length == 1 ) {
+            return Request::ForceSingleCoil( Item.SlaveAddr, Item.StartAddr, Item.Values[0] );
+        }
+        Item.Packed.assign( PDU::GetBitByteCount( Length ), 0 );
+        for ( size_t Idx = 0 ; Idx < Length ; ++Idx ) {
+            if ( Item.Values[Idx] ) {
+                Item.Packed[Idx / 8] |= static_cast<CoilDataType>( 1 << ( Idx % 8 ) );
+            }
+        }
+        return Request::ForceMultipleCoils(
+            Item.SlaveAddr, Item.StartAddr, static_cast<CoilCountType>( Length ),
+            Item.Packed.data()
+        );
+    }
+    if ( Length == 1 ) {
+        return Request::PresetSingleRegister( Item.SlaveAddr, Item.StartAddr, Item.Values[0] );
+    }
+    return Request::PresetMultipleRegisters(
+        Item.SlaveAddr, Item.StartAddr, static_cast<RegCountType>( Length ),
+        Item.Values.data()
+    );
+}
+//---------------------------------------------------------------------------
+
+std::vector<WriteQueue::Run> WriteQueue::GetTableRuns() const
+{
+    // Split every table into runs of consecutive addresses
+    std::vector<Run> Runs;
+    for ( auto const & Table : tables_ ) {
+        size_t const MaxLength = GetMaxRunLength( Table.first.second );
+        for ( auto const & Point : Table.second ) {
+            if ( Runs.empty() ||
+                 Runs.back().SlaveAddr != Table.first.first ||
+                 Runs.back().Coils != Table.first.second ||
+                 Runs.back().StartAddr + Runs.back().Values.size() != Point.first ||
+                 Runs.back().Values.size() >= MaxLength ) {
+                Runs.push_back(
+                    { Table.first.first, Table.first.second, Point.first, {}, {} }
+                );
+            }
+            Runs.back().Values.push_back( Point.second );
+        }
+    }
+    return Runs;
+}
+//---------------------------------------------------------------------------
+
+size_t WriteQueue::FlushByAddress()
+{
+    std::vector<Run> Runs = GetTableRuns();
+
+    std::vector<Request> Requests;
+    Requests.reserve( Runs.size() );
+    for ( auto& Item : Runs ) {
+        Requests.push_back( MakeRequest( Item ) );
+    }
+
+    // Pending writes are kept if Execute() throws (e.g. not connected)
+    size_t const Completed = proto_.Execute( Requests.data(), Requests.size() );
+    tables_.clear();
+    pendingCount_ = 0;
+
+    if ( Completed != Requests.size() ) {
+        auto const Failed = std::find_if(
+            Requests.begin(), Requests.end(),
+            []( Request const & Req ) { return Req.Status != RequestStatus::Completed; }
+        );
+        throw EBaseException(
+            Format(
+                _D( "%d of %d coalesced write(s) failed: %s" )
+              , ARRAYOFCONST( (
+                    static_cast<int>( Requests.size() - Completed ),
+                    static_cast<int>( Requests.size() ),
+                    Failed->ErrorMessage
+                ) )
+            )
+        );
+    }
+    return Completed;
+}
+//---------------------------------------------------------------------------
+
+size_t WriteQueue::FlushByIssue()
+{
+    size_t Completed {};
+    while ( !runs_.empty() ) {
+        Request Req = MakeRequest( runs_.front() );
+        bool const Done = proto_.Execute( &Req, 1 ) != 0;
+
+        pendingCount_ -= runs_.front().Values.size();
+        runs_.pop_front();
+        oldest_ = ClockType::now();
+
+        if ( !Done ) {
+            throw EBaseException(
+                Format(
+                    _D( "Coalesced write failed: %s" )
+                  , ARRAYOFCONST( ( Req.ErrorMessage ) )
+                )
+            );
+        }
+        ++Completed;
+    }
+    return Completed;
+}
+
+//---------------------------------------------------------------------------
+}; // End of namespace Master
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
+
+#pragma package(smart_init)
@@ -0,0 +1,150 @@
+/**
+ * @file ModbusWriteQueue.h
+ * @brief Modbus::Master::WriteQueue — coalescing of single coil/register writes.
+ *
+ * @details Control logic often issues bursts of FC05 (Force Single Coil) and FC06
+ *  (Preset Single Register) writes to adjacent addresses of the same slave.  A
+ *  WriteQueue collects them and, on Flush(), sends every run of consecutive addresses
+ *  as a single FC15 (Force Multiple Coils) or FC16 (Preset Multiple Registers)
+ *  transaction.  A run made of a single address is still sent as FC05/FC06.
+ *
+ *  Repeated writes to the same address are last-writer-wins: only the most recent
+ *  value is sent.  Gaps are never filled, so addresses that were not written are left
+ *  untouched on the slave.
+ *
+ *  The whole flush is submitted through Protocol::Execute(), so it is pipelined on
+ *  Modbus TCP.  The queue does not own a thread: pending writes are flushed by an
+ *  explicit Flush(), by FlushIfDue() called from the application's scan loop, or by
+ *  the next queued write once the flush deadline of the oldest pending write expired.
+ *
+ *  The queue is not thread-safe and does not flush on destruction.
+ */
+
+//---------------------------------------------------------------------------
+
+#ifndef ModbusWriteQueueH
+#define ModbusWriteQueueH
+
+#include <cstdint>
+#include <cstddef>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "Modbus.h"
+
+/**
+ * @brief Default maximum time (ms) a write may wait in a WriteQueue before it is flushed.
+ */
+#if !defined( MODBUS_WRITE_QUEUE_DEFAULT_FLUSH_DEADLINE )
+  #define MODBUS_WRITE_QUEUE_DEFAULT_FLUSH_DEADLINE  50
+#endif
+
+//---------------------------------------------------------------------------
+namespace Modbus {
+//---------------------------------------------------------------------------
+namespace Master {
+//---------------------------------------------------------------------------
+
+/** @brief Ordering guarantee of a WriteQueue. */
+enum class WriteOrdering {
+    /**
+     * Pending writes are merged regardless of the order in which they were queued;
+     * each flush writes, slave by slave, the registers and then the coils in
+     * ascending address order.  Gives the fewest transactions.
+     */
+    Address,
+    /**
+     * Writes reach the slaves in the order they were queued: a write is merged only
+     * into the most recently queued run (overwriting it or extending it by one
+     * address), and runs are executed one at a time, stopping at the first failure.
+     */
+    Issue,
+};
+
+/** @brief Coalesces FC05/FC06 writes into FC15/FC16 transactions (see file description). */
+class WriteQueue {
+public:
+    /**
+     * @param Proto         Protocol used to flush the queue; must outlive the queue.
+     * @param Ordering      Ordering guarantee (see WriteOrdering).
+     * @param FlushDeadline Maximum time in ms a write waits before being flushed.
+     */
+    explicit WriteQueue( Protocol& Proto,
+                         WriteOrdering Ordering = WriteOrdering::Address,
+                         unsigned FlushDeadline = MODBUS_WRITE_QUEUE_DEFAULT_FLUSH_DEADLINE );
+
+    WriteQueue( WriteQueue const & Rhs ) = delete;
+    WriteQueue& operator=( WriteQueue const & Rhs ) = delete;
+
+    /** @brief Queues an FC05 write. Flushes the queue if the deadline has expired. */
+    void ForceSingleCoil( Context::SlaveAddrType SlaveAddr, CoilAddrType Addr, bool Value );
+
+    /** @brief Queues an FC06 write. Flushes the queue if the deadline has expired. */
+    void PresetSingleRegister( Context::SlaveAddrType SlaveAddr, RegAddrType Addr,
+                               RegDataType Data );
+
+    /**
+     * @brief Sends every pending write.
+     * @return Number of Modbus transactions executed successfully.
+     * @details A run that fails is discarded.  With WriteOrdering::Issue the flush
+     *  stops at the first failure and the later runs stay queued.
+     * @throws EBaseException if at least one run failed (the message reports the
+     *         first error), or if the protocol is not connected.
+     */
+    size_t Flush();
+
+    /** @brief Flushes the queue if the oldest pending write has reached its deadline. */
+    bool FlushIfDue();
+
+    /** @brief Discards every pending write. */
+    void Clear() noexcept;
+
+    /** @brief Returns the number of pending addresses (overwritten addresses count once). */
+    [[ nodiscard ]] size_t GetPendingCount() const noexcept { return pendingCount_; }
+
+    [[ nodiscard ]] WriteOrdering GetOrdering() const noexcept { return ordering_; }
+
+    [[ nodiscard ]] unsigned GetFlushDeadline() const noexcept { return flushDeadline_; }
+    void SetFlushDeadline( unsigned Val ) noexcept { flushDeadline_ = Val; }
+private:
+    using ClockType = std::chrono::steady_clock;
+
+    /** @brief A run of consecutive addresses of one slave and one table. */
+    struct Run {
+        Context::SlaveAddrType    SlaveAddr;
+        bool                      Coils;
+        uint16_t                  StartAddr;
+        std::vector<RegDataType>  Values;   // Coil states are stored as 0/1
+        std::vector<CoilDataType> Packed;   // Packed coil states, filled on flush
+    };
+
+    using TableKey = std::pair<Context::SlaveAddrType, bool>;
+
+    Protocol& proto_;
+    WriteOrdering ordering_;
+    unsigned flushDeadline_;
+    size_t pendingCount_ {};
+    ClockType::time_point oldest_;
+
+    std::map<TableKey, std::map<uint16_t, RegDataType>> tables_;   // WriteOrdering::Address
+    std::deque<Run> runs_;                                          // WriteOrdering::Issue
+
+    void Enqueue( Context::SlaveAddrType SlaveAddr, bool Coils, uint16_t Addr,
+                  RegDataType Value );
+    [[ nodiscard ]] bool IsDue() const noexcept;
+    [[ nodiscard ]] static size_t GetMaxRunLength( bool Coils ) noexcept;
+    [[ nodiscard ]] static Request MakeRequest( Run& Item );
+    [[ nodiscard ]] std::vector<Run> GetTableRuns() const;
+    size_t FlushByAddress();
+    size_t FlushByIssue();
+};
+
+//---------------------------------------------------------------------------
+}; // End of namespace Master
+//---------------------------------------------------------------------------
+}; // End of namespace Modbus
+//---------------------------------------------------------------------------
+#endif
@@ -3,14 +3,28 @@
 //
 // A Modbus TCP slave runs in a background std::thread on 127.0.0.1:5020.
 // ServerFixture (global fixture) starts it before any test runs and stops
-// it cleanly after the last test completes.
+// it cleanly after the last test completes.  A second thread on
+// 127.0.0.1:5021 serves the same register bank to raw RTU frames, like a
+// serial device server in transparent mode.  Modbus ASCII is tested against
+// a slave emulated behind the transport hooks of ASCIIProtocol.  When built
+// with OpenSSL (MODBUS_TEST_TLS), a TLS slave on 127.0.0.1:5802 serves the
+// Modbus/TCP Security suite.  The overlapped TCommPort tests need a serial
+// port nothing transmits on, named by the MODBUS_TEST_COMPORT environment
+// variable (e.g. one end of a null-modem emulator pair); without it they are
+// skipped.
 //
 // Server initial register state:
 //   coilRegs[i]   = (i & 1)        (FC01)
 //   inputBits[i]  = ((i % 3) == 0) (FC02)
 //   holdingRegs[i] = i          (FC03 / FC06 / FC16 / FC22)
 //   inputRegs[i]   = 0x1000 + i (FC04, read-only)
-//   fileRecords[f][r] = ((f+1)<<8)|r  (FC20/FC21, 4 files x 32 records)
+//   fileRecords[f][r] = ((f+1)<<8)|r  (FC20/FC21, 4 files x 1000 records)
+//   FC24 at STREAM_FIFO drains a sample counter the tests advance (streamProduced)
+//   FC24 at QUEUE_FIFO reads the same counter without draining it; an FC06 write of
+//   N to holding register QUEUE_FIFO removes N samples
+//   FC11/FC12 count the messages completed normally (commEventCount)
+//   FC43/14 serves deviceObjects, two objects per response
+//   BASIC_UNIT answers FC22/FC23 with IllegalFunction
 //---------------------------------------------------------------------------
 
 #pragma hdrstop
@@ -20,18 +34,51 @@
 #include <winsock2.h>
 #include <ws2tcpip.h>
 
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
 #include <future>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
 #include <tchar.h>
 #include <thread>
 #include <vector>
 
 #include "ModbusTCP_IP.h"
+#include "ModbusPDU.h"
+#include "ModbusDataConv.h"
+#include "ModbusChangeDetect.h"
+#include "ModbusWriteQueue.h"
 #include "ModbusTCP_WinSock.h"
 #include "ModbusDummy.h"
 #include "ModbusRTU.h"
+#include "ModbusRTUOverTCP_WinSock.h"
+#include "ModbusASCII.h"
+#include "ModbusDiscovery.h"
+#include "ModbusScheduler.h"
+#include "ModbusFileTransfer.h"
+#include "ModbusFIFOStream.h"
+#include "ModbusDeviceProfile.h"
+#include "ModbusHealth.h"
+#include "ModbusRegisterUpdate.h"
+#include "ModbusTagDatabase.h"
+#include "ModbusProcessImage.h"
+#include "ModbusCapture.h"
+#include "CommPort.h"
+#if defined( MODBUS_TEST_TLS )
+  #include <cstdio>
+  #include <openssl/pem.h>
+  #include <openssl/x509v3.h>
+  #include "ModbusTCPSecurity_WinSock.h"
+#endif
 
 // --- Boost.Test static-link -----------------------------------------------
 // Keep Boost-provided main() and use a Unicode _tmain wrapper at the end
@@ -49,11 +96,22 @@ using namespace Modbus::Master;
 //---------------------------------------------------------------------------
 
 static const uint16_t SERVER_PORT = 5020;
+static const uint16_t RTU_GATEWAY_PORT    = 5021;
+static const uint8_t  RTU_SILENT_SLAVE    = 0xF7;  // RTU gateway never answers this slave
+static const uint8_t  RTU_ECHO_SLAVE      = 0xF5;  // RTU gateway echoes the request first
+static const uint8_t  RTU_COLLIDING_SLAVE = 0xF6;  // corrupted echo and no answer
+static const uint8_t  SCAN_FIRST_UNIT     = 0xE0;  // discovery block: only 0xE3 and 0xE9
+static const uint8_t  SCAN_LAST_UNIT      = 0xEF;  // answer, the others are absent
+static const uint8_t  SCAN_SILENT_UNIT    = 0xEC;  // TCP server swallows its requests
+static const uint8_t  LATE_UNIT           = 0xF0;  // TCP server answers it 150 ms late
+static const uint8_t  BASIC_UNIT          = 0xF1;  // TCP server: no FC22/FC23 for it
 static const int      REG_COUNT   = 256;
 
 static const int      FIFO_MAX    = 31;
+static const uint16_t STREAM_FIFO = 0x80;  // FC24: draining FIFO of a sampling device
+static const uint16_t QUEUE_FIFO  = 0x81;  // FC24: FIFO cleared by an FC06 acknowledge
 static const int      FILE_COUNT  = 4;     // FC20/FC21: number of files
-static const int      FILE_RECS   = 32;    // FC20/FC21: records per file
+static const int      FILE_RECS   = 1000;  // FC20/FC21: records per file
 
 static std::atomic<bool> gServerStop { false };
 static uint8_t           coilRegs[REG_COUNT];
@@ -63,7 +121,11 @@ static uint16_t          inputRegs[REG_COUNT];
 static uint8_t           exceptionStatus;          // FC07
 static uint16_t          fifoQueue[FIFO_MAX];      // FC24
 static uint16_t          fifoCount;
+static std::atomic<uint32_t> streamProduced;   // FC24 at STREAM_FIFO: samples produced
+static std::atomic<uint32_t> streamConsumed;   // and samples read
 static uint16_t          fileRecords[FILE_COUNT][FILE_RECS]; // FC20/FC21
+static std::atomic<uint16_t> commEventCount;   // FC11/FC12: messages completed normally
+static std::atomic<uint16_t> commMessageCount; // FC12: all messages
 
 static void initRegisters()
 {
@@ -77,6 +139,8 @@ static void initRegisters()
     fifoCount = 5;           // FC24: 5 values in the FIFO
     for ( int i = 0; i < FIFO_MAX; ++i )
         fifoQueue[i] = static_cast<uint16_t>( 0x100 + i );
+    streamProduced = 0;
+    streamConsumed = 0;
     // FC20/FC21: file records — file F, record R = 0x(F+1)(R) pattern
     for ( int f = 0; f < FILE_COUNT; ++f )
         for ( int r = 0; r < FILE_RECS; ++r )
@@ -216,6 +280,10 @@ static std::vector<uint8_t> handleFC06( const uint8_t* d, int len )
     if ( len < 4 ) return errorPdu( 0x06, 0x03 );
     uint16_t addr = get16( d ), value = get16( d + 2 );
     if ( addr >= REG_COUNT ) return errorPdu( 0x06, 0x02 );
+    if ( addr == QUEUE_FIFO ) {
+        uint32_t const first = streamConsumed;
+        streamConsumed = first + std::min<uint32_t>( value, streamProduced - first );
+    }
     holdingRegs[addr] = value;
     return { 0x06, d[0], d[1], d[2], d[3] };
 }
@@ -314,18 +382,99 @@ static std::vector<uint8_t> handleFC24( const uint8_t* d, int len )
     uint16_t addr = get16( d );
     if ( addr >= REG_COUNT ) return errorPdu( 0x18, 0x02 );
 
-    // Response: FC(1) + ByteCount(2) + FIFOCount(2) + FIFOValues(fifoCount*2)
-    uint16_t byteCount = static_cast<uint16_t>( 2 + fifoCount * 2 );
+    // The stream FIFO hands out the next samples, up to 31, and forgets them; the
+    // queue FIFO keeps them until they are acknowledged
+    uint16_t count = fifoCount;
+    uint16_t values[FIFO_MAX];
+    if ( addr == STREAM_FIFO || addr == QUEUE_FIFO ) {
+        uint32_t const first = streamConsumed;
+        count = static_cast<uint16_t>(
+            std::min<uint32_t>( streamProduced - first, FIFO_MAX ) );
+        for ( uint16_t i = 0; i < count; ++i )
+            values[i] = static_cast<uint16_t>( first + i );
+        if ( addr == STREAM_FIFO )
+            streamConsumed = first + count;
+    }
+    else {
+        std::copy( fifoQueue, fifoQueue + count, values );
+    }
+
+    // Response: FC(1) + ByteCount(2) + FIFOCount(2) + FIFOValues(count*2)
+    uint16_t byteCount = static_cast<uint16_t>( 2 + count * 2 );
     std::vector<uint8_t> pdu;
-    pdu.reserve( 5 + fifoCount * 2 );
+    pdu.reserve( 5 + count * 2 );
     pdu.push_back( 0x18 );
     pdu.push_back( static_cast<uint8_t>( byteCount >> 8 ) );
     pdu.push_back( static_cast<uint8_t>( byteCount & 0xFF ) );
-    pdu.push_back( static_cast<uint8_t>( fifoCount >> 8 ) );
-    pdu.push_back( static_cast<uint8_t>( fifoCount & 0xFF ) );
-    for ( uint16_t i = 0; i < fifoCount; ++i ) {
-        pdu.push_back( static_cast<uint8_t>( fifoQueue[i] >> 8 ) );
-        pdu.push_back( static_cast<uint8_t>( fifoQueue[i] & 0xFF ) );
+    pdu.push_back( static_cast<uint8_t>( count >> 8 ) );
+    pdu.push_back( static_cast<uint8_t>( count & 0xFF ) );
+    for ( uint16_t i = 0; i < count; ++i ) {
+        pdu.push_back( static_cast<uint8_t>( values[i] >> 8 ) );
+        pdu.push_back( static_cast<uint8_t>( values[i] & 0xFF ) );
+    }
+    return pdu;
+}
+
+static std::vector<uint8_t> handleFC11( const uint8_t* d, int len )
+{
+    // FC11 Fetch Comm Event Counter: Status(2) + EventCount(2)
+    uint16_t const events = commEventCount;
+    return { 0x0B, 0x00, 0x00,
+             static_cast<uint8_t>( events >> 8 ), static_cast<uint8_t>( events & 0xFF ) };
+}
+
+static std::vector<uint8_t> handleFC12( const uint8_t* d, int len )
+{
+    // FC12 Fetch Comm Event Log: ByteCount(1) + Status(2) + EventCount(2) +
+    // MessageCount(2) + Events; two receive events, most recent first
+    uint16_t const events = commEventCount;
+    uint16_t const messages = commMessageCount;
+    return { 0x0C, 8, 0x00, 0x00,
+             static_cast<uint8_t>( events >> 8 ), static_cast<uint8_t>( events & 0xFF ),
+             static_cast<uint8_t>( messages >> 8 ), static_cast<uint8_t>( messages & 0xFF ),
+             0x80, 0x80 };
+}
+
+static std::vector<uint8_t> handleFC17( const uint8_t* d, int len )
+{
+    // FC17 Report Slave ID: ByteCount(1) + SlaveId + RunIndicator(0xFF = ON)
+    return { 0x11, 4, 'A', 'X', '1', 0xFF };
+}
+
+static const char* const deviceObjects[] = {
+    "Acme Automation", "AX-1000", "V2.11",
+    "http://acme.example", "Axis controller", "AX1000-B", "Line 3"
+};
+
+static std::vector<uint8_t> handleFC43( const uint8_t* d, int len )
+{
+    // FC43/14 Read Device Identification: MEIType(1) + ReadDevIdCode(1) + ObjectId(1)
+    if ( len < 3 || d[0] != 0x0E ) return errorPdu( 0x2B, 0x03 );
+    uint8_t code = d[1];
+    uint8_t id = d[2];
+    uint8_t const objCount = static_cast<uint8_t>( std::size( deviceObjects ) );
+    if ( code < 1 || code > 4 ) return errorPdu( 0x2B, 0x03 );
+    if ( id >= objCount ) {
+        if ( code == 4 ) return errorPdu( 0x2B, 0x02 );
+        id = 0;
+    }
+
+    // Basic objects end at 2; at most two objects per response ("more follows")
+    uint8_t const last = code == 4 ? id : code == 1 ? 2 : objCount - 1;
+    uint8_t const end = std::min<uint8_t>( last + 1, id + 2 );
+    bool const more = end <= last;
+
+    std::vector<uint8_t> pdu = {
+        0x2B, 0x0E, code, 0x82,
+        static_cast<uint8_t>( more ? 0xFF : 0x00 ),
+        static_cast<uint8_t>( more ? end : 0 ),
+        static_cast<uint8_t>( end - id )
+    };
+    for ( uint8_t i = id; i < end; ++i ) {
+        size_t const n = std::strlen( deviceObjects[i] );
+        pdu.push_back( i );
+        pdu.push_back( static_cast<uint8_t>( n ) );
+        pdu.insert( pdu.end(), deviceObjects[i], deviceObjects[i] + n );
     }
     return pdu;
 }
@@ -401,21 +550,8 @@ static std::vector<uint8_t> handleFC21( const uint8_t* d, int len )
     return pdu;
 }
 
-static bool handleRequest( SOCKET s )
+static std::vector<uint8_t> dispatchPdu( uint8_t fc, const uint8_t* data, int dataLen )
 {
-    uint8_t header[6];
-    if ( !srvRecvAll( s, header, 6 ) ) return false;
-    uint16_t tid       = get16( header + 0 );
-    uint16_t remaining = get16( header + 4 );
-    if ( remaining < 2 ) return false;
-    std::vector<uint8_t> body( remaining );
-    if ( !srvRecvAll( s, body.data(), remaining ) ) return false;
-
-    uint8_t        unitId  = body[0];
-    uint8_t        fc      = body[1];
-    const uint8_t* data    = body.data() + 2;
-    int            dataLen = static_cast<int>( remaining ) - 2;
-
     std::vector<uint8_t> pdu;
     switch ( fc ) {
         case 0x01: pdu = handleFC01( data, dataLen ); break;
@@ -426,17 +562,57 @@ static bool handleRequest( SOCKET s )
         case 0x06: pdu = handleFC06( data, dataLen ); break;
         case 0x07: pdu = handleFC07( data, dataLen ); break;
         case 0x08: pdu = handleFC08( data, dataLen ); break;
+        case 0x0B: pdu = handleFC11( data, dataLen ); break;
+        case 0x0C: pdu = handleFC12( data, dataLen ); break;
         case 0x0F: pdu = handleFC15( data, dataLen ); break;
         case 0x10: pdu = handleFC16( data, dataLen ); break;
+        case 0x11: pdu = handleFC17( data, dataLen ); break;
         case 0x14: pdu = handleFC20( data, dataLen ); break;
         case 0x15: pdu = handleFC21( data, dataLen ); break;
         case 0x16: pdu = handleFC22( data, dataLen ); break;
         case 0x17: pdu = handleFC23( data, dataLen ); break;
         case 0x18: pdu = handleFC24( data, dataLen ); break;
+        case 0x2B: pdu = handleFC43( data, dataLen ); break;
         default:   pdu = errorPdu( fc, 0x01 );        break;
     }
+    ++commMessageCount;
+    if ( fc != 0x0B && !( pdu[0] & 0x80 ) )
+        ++commEventCount;
+    return pdu;
+}
+
+static bool scanUnitAbsent( uint8_t unitId )
+{
+    return unitId >= SCAN_FIRST_UNIT && unitId <= SCAN_LAST_UNIT &&
+           unitId != 0xE3 && unitId != 0xE9;
+}
+
+static bool handleRequest( SOCKET s )
+{
+    uint8_t header[6];
+    if ( !srvRecvAll( s, header, 6 ) ) return false;
+    uint16_t tid       = get16( header + 0 );
+    uint16_t remaining = get16( header + 4 );
+    if ( remaining < 2 ) return false;
+    std::vector<uint8_t> body( remaining );
+    if ( !srvRecvAll( s, body.data(), remaining ) ) return false;
+
+    uint8_t        unitId  = body[0];
+    uint8_t        fc      = body[1];
+    const uint8_t* data    = body.data() + 2;
+    int            dataLen = static_cast<int>( remaining ) - 2;
 
-    auto frame = buildFrame( tid, unitId, pdu );
+    if ( unitId == SCAN_SILENT_UNIT ) return true;
+    if ( unitId == LATE_UNIT ) {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 150 ) );
+    }
+    if ( unitId == BASIC_UNIT && ( fc == 0x16 || fc == 0x17 ) ) {
+        auto frame = buildFrame( tid, unitId, errorPdu( fc, 0x01 ) );
+        return srvSendAll( s, frame.data(), static_cast<int>( frame.size() ) );
+    }
+    auto frame = buildFrame( tid, unitId,
+                             scanUnitAbsent( unitId ) ? errorPdu( fc, 0x0B )  // as a gateway
+                                                      : dispatchPdu( fc, data, dataLen ) );
     return srvSendAll( s, frame.data(), static_cast<int>( frame.size() ) );
 }
 
@@ -485,6 +661,107 @@ static void serverThread( std::promise<void> readyPromise )
     WSACleanup();
 }
 
+//---------------------------------------------------------------------------
+// RTU gateway — raw RTU frames (address + PDU + CRC) over TCP, no MBAP
+//---------------------------------------------------------------------------
+
+static uint16_t rtuCrc( const uint8_t* p, size_t len )
+{
+    uint16_t crc = 0xFFFF;
+    for ( size_t i = 0; i < len; ++i ) {
+        crc ^= p[i];
+        for ( int b = 0; b < 8; ++b )
+            crc = ( crc & 1 ) ? static_cast<uint16_t>( ( crc >> 1 ) ^ 0xA001 )
+                              : static_cast<uint16_t>( crc >> 1 );
+    }
+    return crc;
+}
+
+static bool handleRtuRequest( SOCKET s )
+{
+    // The request ends when the line stays idle, as on a device server
+    std::vector<uint8_t> req( 256 );
+    int got = recv( s, reinterpret_cast<char*>( req.data() ), 256, 0 );
+    if ( got <= 0 ) return false;
+    for ( ;; ) {
+        fd_set readSet;
+        FD_ZERO( &readSet );
+        FD_SET( s, &readSet );
+        timeval tv = { 0, 20000 }; // 20 ms
+        if ( got == 256 || select( 0, &readSet, nullptr, nullptr, &tv ) <= 0 ) break;
+        int r = recv( s, reinterpret_cast<char*>( req.data() + got ), 256 - got, 0 );
+        if ( r <= 0 ) return false;
+        got += r;
+    }
+    if ( got < 4 || rtuCrc( req.data(), got ) != 0 ) return true;  // drop it, like a slave
+    if ( req[0] == RTU_SILENT_SLAVE || scanUnitAbsent( req[0] ) ) return true;
+    if ( req[0] == 0 ) {
+        dispatchPdu( req[1], req.data() + 2, got - 4 );  // broadcast: act, never answer
+        return true;
+    }
+
+    // Half-duplex two-wire line: the master reads back what it transmitted
+    if ( req[0] == RTU_ECHO_SLAVE || req[0] == RTU_COLLIDING_SLAVE ) {
+        std::vector<uint8_t> echo( req.begin(), req.begin() + got );
+        if ( req[0] == RTU_COLLIDING_SLAVE ) {
+            echo[got / 2] ^= 0x10;
+        }
+        if ( !srvSendAll( s, echo.data(), got ) ) return false;
+        if ( req[0] == RTU_COLLIDING_SLAVE ) return true;
+    }
+
+    std::vector<uint8_t> frame { req[0] };
+    auto pdu = dispatchPdu( req[1], req.data() + 2, got - 4 );
+    frame.insert( frame.end(), pdu.begin(), pdu.end() );
+    uint16_t crc = rtuCrc( frame.data(), frame.size() );
+    frame.push_back( static_cast<uint8_t>( crc & 0xFF ) );
+    frame.push_back( static_cast<uint8_t>( crc >> 8 ) );
+
+    // Forward the response in two segments, as a device server does when its
+    // serial side pauses mid-frame
+    int split = static_cast<int>( frame.size() ) / 2;
+    if ( !srvSendAll( s, frame.data(), split ) ) return false;
+    std::this_thread::sleep_for( std::chrono::milliseconds( 30 ) );
+    return srvSendAll( s, frame.data() + split, static_cast<int>( frame.size() ) - split );
+}
+
+static void rtuGatewayThread( std::promise<void> readyPromise )
+{
+    WSADATA wsaData;
+    WSAStartup( MAKEWORD( 2, 2 ), &wsaData );
+
+    SOCKET listenSock = socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
+    int reuseAddr = 1;
+    setsockopt( listenSock, SOL_SOCKET, SO_REUSEADDR,
+                reinterpret_cast<const char*>( &reuseAddr ), sizeof( reuseAddr ) );
+
+    sockaddr_in addr4 = {};
+    addr4.sin_family      = AF_INET;
+    addr4.sin_port        = htons( RTU_GATEWAY_PORT );
+    addr4.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    bind  ( listenSock, reinterpret_cast<sockaddr*>( &addr4 ), sizeof( addr4 ) );
+    listen( listenSock, SOMAXCONN );
+
+    readyPromise.set_value();
+
+    while ( !gServerStop ) {
+        fd_set readSet;
+        FD_ZERO( &readSet );
+        FD_SET( listenSock, &readSet );
+        timeval tv = { 0, 100000 }; // 100 ms
+        if ( select( 0, &readSet, nullptr, nullptr, &tv ) > 0 ) {
+            SOCKET clientSock = accept( listenSock, nullptr, nullptr );
+            if ( clientSock != INVALID_SOCKET ) {
+                while ( handleRtuRequest( clientSock ) ) {}
+                closesocket( clientSock );
+            }
+        }
+    }
+
+    closesocket( listenSock );
+    WSACleanup();
+}
+
 //---------------------------------------------------------------------------
 // Global fixture — starts/stops the server around the entire test run
 //---------------------------------------------------------------------------
@@ -498,18 +775,25 @@ struct ServerFixture {
         thread_ = std::thread( serverThread, std::move( ready ) );
         readyFuture_.wait();
         BOOST_TEST_MESSAGE( "Embedded Modbus server listening on 127.0.0.1:" << SERVER_PORT );
+
+        std::promise<void> rtuReady;
+        std::future<void> rtuReadyFuture = rtuReady.get_future();
+        rtuThread_ = std::thread( rtuGatewayThread, std::move( rtuReady ) );
+        rtuReadyFuture.wait();
     }
     ~ServerFixture()
     {
         try {
             gServerStop = true;
             thread_.join();
+            rtuThread_.join();
         }
         catch ( ... ) {
         }
     }
 private:
     std::thread        thread_;
+    std::thread        rtuThread_;
     std::future<void>  readyFuture_;
 };
 
@@ -1010,6 +1294,50 @@ BOOST_AUTO_TEST_SUITE_END()
 
 //---------------------------------------------------------------------------
 
+BOOST_FIXTURE_TEST_SUITE( FC11_FC12_FC17_CommEvents, ProtoFixture )
+
+    BOOST_AUTO_TEST_CASE( EventCounterCountsCompletedMessagesOnly )
+    {
+        CommEventCounter before = proto_.FetchCommEventCtr( ctx() );
+        BOOST_TEST( !before.IsBusy() );
+        RegDataType v[1] = {};
+        proto_.ReadHoldingRegisters( ctx(), 0, 1, v );
+        BOOST_CHECK_THROW( proto_.ReadHoldingRegisters( ctx(), REG_COUNT, 1, v ),
+                           EIllegalDataAddress );
+        CommEventCounter after = proto_.FetchCommEventCtr( ctx() );
+        BOOST_TEST( static_cast<RegDataType>( after.EventCount - before.EventCount ) == 1u );
+    }
+
+    BOOST_AUTO_TEST_CASE( EventLogAndSlaveId )
+    {
+        CommEventLog log = proto_.FetchCommEventLog( ctx() );
+        BOOST_TEST( log.Status == 0u );
+        BOOST_TEST( log.MessageCount >= log.EventCount );
+        BOOST_TEST( log.Events.size() == 2u );
+
+        std::vector<uint8_t> id = proto_.ReportSlave( ctx() );
+        BOOST_TEST( id.size() == 4u );
+        BOOST_TEST( id[0] == 'A' );
+        BOOST_TEST( id.back() == 0xFFu );
+    }
+
+    BOOST_AUTO_TEST_CASE( CounterInBatch )
+    {
+        RegDataType result[2] = { 0xAAAA, 0xAAAA };
+        Request reqs[] = {
+            Request::FetchCommEventCtr( 1, result ),
+            Request::FetchCommEventCtr( 2 )
+        };
+        BOOST_TEST( proto_.Execute( reqs, 2 ) == 2u );
+        BOOST_TEST( result[0] == 0u );
+        BOOST_TEST( result[1] == reqs[0].Value );
+        BOOST_TEST( reqs[1].Value == reqs[0].Value );
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//---------------------------------------------------------------------------
+
 BOOST_FIXTURE_TEST_SUITE( FC24_ReadFIFOQueue, ProtoFixture )
 
     BOOST_AUTO_TEST_CASE( ReadsExpectedCount )
@@ -1049,6 +1377,183 @@ BOOST_FIXTURE_TEST_SUITE( FC24_ReadFIFOQueue, ProtoFixture )
 
 BOOST_AUTO_TEST_SUITE_END()
 
+//---------------------------------------------------------------------------
+// FIFO streaming
+//---------------------------------------------------------------------------
+
+// Collects the streamed values until @p count have arrived or @p timeoutMs elapses
+static std::vector<RegDataType> drainStream( FIFOStreamReader& reader, size_t count,
+                                             int timeoutMs, unsigned* minInterval = nullptr )
+{
+    std::vector<RegDataType> values;
+    RegDataType buf[64];
+    auto const deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds( timeoutMs );
+    while ( values.size() < count && std::chrono::steady_clock::now() < deadline ) {
+        size_t const n = reader.Read( buf, 64 );
+        values.insert( values.end(), buf, buf + n );
+        if ( minInterval )
+            *minInterval = std::min( *minInterval, reader.GetInterval() );
+        if ( !n )
+            std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+    }
+    return values;
+}
+
+static bool isSequence( std::vector<RegDataType> const & values )
+{
+    for ( size_t i = 0; i < values.size(); ++i )
+        if ( values[i] != static_cast<RegDataType>( i ) )
+            return false;
+    return true;
+}
+
+BOOST_FIXTURE_TEST_SUITE( FIFO_Stream, ProtoFixture )
+
+    BOOST_AUTO_TEST_CASE( BacklogIsDrainedInPipelinedBursts )
+    {
+        streamProduced = 500;
+        FIFOStreamReader reader( proto_, 1, STREAM_FIFO );
+        reader.SetMaxDepth( 4 );
+        reader.Start();
+        std::vector<RegDataType> values = drainStream( reader, 500, 5000 );
+        BOOST_TEST( values.size() == 500u );
+        BOOST_TEST( isSequence( values ) );
+
+        // Bursts of 4 full reads back to back could not keep up at first
+        BOOST_TEST( reader.GetOverflowCount() > 0u );
+        drainStream( reader, 1, 300 );          // one more burst finds the FIFO empty
+        BOOST_TEST( !reader.IsOverflowing() );
+        BOOST_TEST( reader.GetDroppedCount() == 0u );
+        BOOST_TEST( reader.GetErrorCount() == 0u );
+    }
+
+    BOOST_AUTO_TEST_CASE( PollRateFollowsTheProducer )
+    {
+        FIFOStreamReader reader( proto_, 1, STREAM_FIFO );
+        reader.SetMinInterval( 1 );
+        reader.SetMaxInterval( 50 );
+        reader.Start();
+
+        std::atomic<bool> producing { true };
+        std::thread producer( [&producing]() {
+            while ( producing ) {
+                streamProduced += 2;
+                std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+            }
+        } );
+        unsigned minInterval = 50;
+        std::vector<RegDataType> values = drainStream( reader, 400, 5000, &minInterval );
+        producing = false;
+        producer.join();
+        std::vector<RegDataType> rest =
+            drainStream( reader, streamProduced - values.size(), 2000 );
+        values.insert( values.end(), rest.begin(), rest.end() );
+        reader.Stop();
+
+        BOOST_TEST( values.size() == streamProduced.load() );
+        BOOST_TEST( isSequence( values ) );
+        BOOST_TEST( minInterval < 50u );        // polled faster while samples flowed
+        BOOST_TEST( reader.GetDroppedCount() == 0u );
+    }
+
+    BOOST_AUTO_TEST_CASE( SlowConsumerDropsAreCounted )
+    {
+        streamProduced = 200;
+        FIFOStreamReader reader( proto_, 1, STREAM_FIFO, 50 );   // rounded up to 64
+        reader.Start();
+        auto const deadline = std::chrono::steady_clock::now() + std::chrono::seconds( 5 );
+        while ( reader.GetReceivedCount() < 200u && std::chrono::steady_clock::now() < deadline )
+            std::this_thread::sleep_for( std::chrono::milliseconds( 5 ) );
+        reader.Stop();
+
+        BOOST_TEST( reader.GetReceivedCount() == 200u );
+        BOOST_TEST( reader.GetAvailable() == 64u );
+        BOOST_TEST( reader.GetDroppedCount() == 136u );
+        RegDataType buf[100];
+        BOOST_TEST( reader.Read( buf, 100 ) == 64u );
+        BOOST_TEST( buf[63] == 63u );
+    }
+
+    // Removes the values read from QUEUE_FIFO; fails the acknowledges listed in failAt
+    struct QueueAcknowledger {
+        std::vector<FIFOCountType> counts;
+        int                        calls {};
+        int                        failAt { -1 };
+
+        void __fastcall OnAcknowledge( Protocol& Proto, Context::SlaveAddrType SlaveAddr,
+                                       FIFOAddrType FIFOAddr, FIFOCountType Count )
+        {
+            if ( calls++ == failAt )
+                throw Exception( _D( "Acknowledge lost" ) );
+            counts.push_back( Count );
+            Proto.PresetSingleRegister( Context( SlaveAddr ), FIFOAddr, Count );
+        }
+    };
+
+    BOOST_AUTO_TEST_CASE( NonDestructiveFIFOIsAcknowledged )
+    {
+        streamProduced = 100;
+        QueueAcknowledger ack;
+        ack.failAt = 1;
+        FIFOStreamReader reader( proto_, 1, QUEUE_FIFO );
+        reader.SetMaxDepth( 4 );
+        reader.SetAcknowledgeHandler( ack.OnAcknowledge );
+        reader.Start();
+        std::vector<RegDataType> values = drainStream( reader, 100, 5000 );
+        drainStream( reader, 1, 300 );          // the FIFO stays empty: no duplicates
+        reader.Stop();
+
+        BOOST_TEST( values.size() == 100u );
+        BOOST_TEST( isSequence( values ) );
+        BOOST_TEST( reader.GetReceivedCount() == 100u );   // the failed read came again
+        BOOST_TEST( reader.GetErrorCount() == 1u );
+        BOOST_CHECK( reader.GetLastError() == String( _D( "Acknowledge lost" ) ) );
+        BOOST_TEST( !reader.IsOverflowing() );
+        BOOST_TEST( ack.counts.size() == 4u );
+        BOOST_TEST( ack.counts.back() == 7u );
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//---------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_SUITE( FC43_ReadDeviceIdentification, ProtoFixture )
+
+    BOOST_AUTO_TEST_CASE( BasicStreamIsReadAcrossResponses )
+    {
+        DeviceIdentification id = proto_.ReadDeviceIdentification( ctx() );
+        BOOST_TEST( id.ConformityLevel == 0x82u );
+        BOOST_TEST( id.Objects.size() == 3u );
+        BOOST_TEST( id.Objects[0] == "Acme Automation" );
+        BOOST_TEST( id.Objects[2] == "V2.11" );
+        BOOST_CHECK( id.GetText( DeviceObjectId::ProductCode ) == String( "AX-1000" ) );
+        BOOST_CHECK( id.GetText( DeviceObjectId::ModelName ).IsEmpty() );
+    }
+
+    BOOST_AUTO_TEST_CASE( RegularStreamFromAnObject )
+    {
+        DeviceIdentification id =
+            proto_.ReadDeviceIdentification( ctx(), ReadDeviceIdCode::Regular, 3 );
+        BOOST_TEST( id.Objects.size() == 4u );
+        BOOST_TEST( id.Objects.count( 2 ) == 0u );
+        BOOST_TEST( id.Objects[6] == "Line 3" );
+    }
+
+    BOOST_AUTO_TEST_CASE( IndividualAccess )
+    {
+        DeviceIdentification id =
+            proto_.ReadDeviceIdentification( ctx(), ReadDeviceIdCode::Individual, 5 );
+        BOOST_TEST( id.Objects.size() == 1u );
+        BOOST_TEST( id.Objects[5] == "AX1000-B" );
+        BOOST_CHECK_THROW(
+            proto_.ReadDeviceIdentification( ctx(), ReadDeviceIdCode::Individual, 0x40 ),
+            EIllegalDataAddress
+        );
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
 //---------------------------------------------------------------------------
 
 BOOST_FIXTURE_TEST_SUITE( FC20_ReadGeneralReference, ProtoFixture )
@@ -1190,6 +1695,112 @@ BOOST_AUTO_TEST_SUITE_END()
 
 //---------------------------------------------------------------------------
 
+// Serial port named by MODBUS_TEST_COMPORT, empty if not set
+static std::wstring idleCommPort()
+{
+    char const * name = std::getenv( "MODBUS_TEST_COMPORT" );
+    return name ? std::wstring( name, name + std::strlen( name ) ) : std::wstring();
+}
+
+struct HasIdleCommPort
+{
+    boost::test_tools::assertion_result operator()( boost::unit_test::test_unit_id ) const
+    {
+        return !idleCommPort().empty();
+    }
+};
+
+static void openOverlapped( TCommPort& port )
+{
+    port.SetCommPort( idleCommPort() );
+    port.SetOverlapped( true );
+    port.OpenCommPort();
+}
+
+BOOST_AUTO_TEST_SUITE( Comm_Port )
+
+    BOOST_AUTO_TEST_CASE( OverlappedReadNeedsAnOpenPort )
+    {
+        TCommPort port;
+        port.SetOverlapped( true );
+        BOOST_CHECK_EXCEPTION(
+            (void)port.EndRead( 0 ), ECommError,
+            []( ECommError const & e ) {
+                return e.Error == ECommError::ErrorType::PORT_NOT_OPEN;
+            } );
+        TCommPort* ports[] = { &port };
+        BOOST_TEST( TCommPort::WaitForRead( ports, 1, 5000 ) == -1 );
+        port.CloseCommPort();
+    }
+
+    BOOST_AUTO_TEST_CASE( EndReadWithoutPendingRead,
+                          * boost::unit_test::precondition( HasIdleCommPort() ) )
+    {
+        TCommPort port;
+        openOverlapped( port );
+        auto const start = std::chrono::steady_clock::now();
+        BOOST_TEST( port.EndRead( 5000 ) == 0u );
+        BOOST_TEST( ( std::chrono::steady_clock::now() - start < std::chrono::seconds( 1 ) ) );
+
+        // A completed read leaves nothing to cancel
+        BYTE buf[4];
+        port.BeginRead( buf, sizeof buf );
+        BOOST_TEST( port.EndRead( 50 ) == 0u );
+        BOOST_TEST( !port.IsReadPending() );
+        BOOST_TEST( port.EndRead( 5000 ) == 0u );
+    }
+
+    BOOST_AUTO_TEST_CASE( WaitForReadTimesOut,
+                          * boost::unit_test::precondition( HasIdleCommPort() ) )
+    {
+        TCommPort port;
+        openOverlapped( port );
+        BYTE buf[4];
+        port.BeginRead( buf, sizeof buf );
+        TCommPort* ports[] = { &port };
+        auto const start = std::chrono::steady_clock::now();
+        BOOST_TEST( TCommPort::WaitForRead( ports, 1, 100 ) == -1 );
+        BOOST_TEST( ( std::chrono::steady_clock::now() - start >= std::chrono::milliseconds( 90 ) ) );
+        BOOST_TEST( port.IsReadPending() );
+        BOOST_TEST( port.EndRead( 0 ) == 0u );
+        BOOST_TEST( !port.IsReadPending() );
+    }
+
+    BOOST_AUTO_TEST_CASE( CloseCancelsTheReadOfAnotherThread,
+                          * boost::unit_test::precondition( HasIdleCommPort() ) )
+    {
+        // Shared with a detached closer, so that a close stuck on the read fails
+        // the test instead of hanging it
+        auto port = std::make_shared<TCommPort>();
+        auto buf = std::make_shared<std::array<BYTE, 4>>();
+        openOverlapped( *port );
+
+        // The reader keeps its thread alive, waiting on its read, while
+        // another thread closes the port
+        std::promise<void> started;
+        auto reader = std::async( std::launch::async, [&] {
+            port->BeginRead( buf->data(), static_cast<unsigned>( buf->size() ) );
+            started.set_value();
+            TCommPort* ports[] = { port.get() };
+            return TCommPort::WaitForRead( ports, 1, 5000 );
+        } );
+        started.get_future().wait();
+
+        std::promise<void> closing;
+        auto closed = closing.get_future();
+        std::thread( [port, buf, closing = std::move( closing )]() mutable {
+            port->CloseCommPort();
+            closing.set_value();
+        } ).detach();
+        BOOST_REQUIRE( ( closed.wait_for( std::chrono::seconds( 2 ) ) == std::future_status::ready ) );
+        BOOST_TEST( !port->IsReadPending() );
+        BOOST_TEST( reader.get() == 0 );   // the cancel completes the read
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//---------------------------------------------------------------------------
+
 BOOST_FIXTURE_TEST_SUITE( TransactionId, ProtoFixture )
 
     BOOST_AUTO_TEST_CASE( LowTidEchoed )
@@ -1209,6 +1820,2745 @@ BOOST_FIXTURE_TEST_SUITE( TransactionId, ProtoFixture )
 
 BOOST_AUTO_TEST_SUITE_END()
 
+BOOST_AUTO_TEST_SUITE( PDU_Codec )
+
+    BOOST_AUTO_TEST_CASE( LengthsAreCompileTimeConstants )
+    {
+        using FC03 = PDU::Codec<FunctionCode::ReadHoldingRegisters>;
+        using FC15 = PDU::Codec<FunctionCode::ForceMultipleCoils>;
+        static_assert( FC03::RequestLength == 5 );
+        static_assert( FC03::ResponseLength( 125 ) == 252 );
+        static_assert( FC15::RequestLength( 9 ) == 8 );
+        static_assert( PDU::Codec<FunctionCode::MaskWrite4XRegister>::ResponseLength == 7 );
+        BOOST_TEST( FC03::MaxPointCount == 125u );
+    }
+
+    BOOST_AUTO_TEST_CASE( EncodeReadHoldingRegisters )
+    {
+        uint8_t buf[5] = {};
+        uint8_t* end =
+            PDU::Codec<FunctionCode::ReadHoldingRegisters>::Encode( buf, 0x1234, 3 );
+        BOOST_TEST( end == buf + 5 );
+        uint8_t const expected[] = { 0x03, 0x12, 0x34, 0x00, 0x03 };
+        BOOST_TEST( std::equal( buf, buf + 5, expected ) );
+    }
+
+    BOOST_AUTO_TEST_CASE( EncodePresetMultipleRegisters )
+    {
+        std::vector<uint8_t> pdu;
+        RegDataType const regs[2] = { 0xA1B2u, 0x0003u };
+        PDU::Codec<FunctionCode::PresetMultipleRegisters>::Encode(
+            std::back_inserter( pdu ), 10, 2, regs );
+        std::vector<uint8_t> const expected {
+            0x10, 0x00, 0x0A, 0x00, 0x02, 0x04, 0xA1, 0xB2, 0x00, 0x03
+        };
+        BOOST_TEST( pdu == expected );
+    }
+
+    BOOST_AUTO_TEST_CASE( DecodeReadRegisters )
+    {
+        uint8_t const body[] = { 0x04, 0x00, 0x01, 0xAB, 0xCD };
+        RegDataType v[2] = {};
+        PDU::Codec<FunctionCode::ReadInputRegisters>::Decode(
+            Context( 1 ), body, sizeof( body ), 2, v );
+        BOOST_TEST( v[0] == 0x0001u );
+        BOOST_TEST( v[1] == 0xABCDu );
+    }
+
+    BOOST_AUTO_TEST_CASE( DecodeByteCountMismatchThrows )
+    {
+        uint8_t const body[] = { 0x02, 0x00, 0x01 };
+        RegDataType v[2] = {};
+        BOOST_CHECK_THROW(
+            PDU::Codec<FunctionCode::ReadHoldingRegisters>::Decode(
+                Context( 1 ), body, sizeof( body ), 2, v ),
+            EContextException );
+    }
+
+    BOOST_AUTO_TEST_CASE( DecodeWriteEchoMismatchThrows )
+    {
+        uint8_t const body[] = { 0x00, 0x05, 0x12, 0x34 };
+        using FC06 = PDU::Codec<FunctionCode::PresetSingleRegister>;
+        BOOST_CHECK_NO_THROW( FC06::Decode( Context( 1 ), body, 4, 5, 0x1234 ) );
+        BOOST_CHECK_THROW(
+            FC06::Decode( Context( 1 ), body, 4, 5, 0x1235 ), EContextException );
+        BOOST_CHECK_THROW(
+            FC06::Decode( Context( 1 ), body, 4, 6, 0x1234 ), EContextException );
+    }
+
+    BOOST_AUTO_TEST_CASE( DecodeFIFOQueue )
+    {
+        uint8_t const body[] = { 0x00, 0x06, 0x00, 0x02, 0x11, 0x22, 0x33, 0x44 };
+        RegDataType v[31] = {};
+        using FC24 = PDU::Codec<FunctionCode::ReadFIFOQueue>;
+        BOOST_TEST( FC24::Decode( Context( 1 ), body, sizeof( body ), v ) == 2u );
+        BOOST_TEST( v[0] == 0x1122u );
+        BOOST_TEST( v[1] == 0x3344u );
+    }
+
+    BOOST_AUTO_TEST_CASE( InvalidPointCountThrows )
+    {
+        using FC01 = PDU::Codec<FunctionCode::ReadCoilStatus>;
+        BOOST_CHECK_THROW(
+            FC01::RaiseExceptionIfPointCountIsNotValid( Context( 1 ), 0 ), EContextException );
+        BOOST_CHECK_THROW(
+            FC01::RaiseExceptionIfPointCountIsNotValid( Context( 1 ), 2001 ), EContextException );
+        BOOST_CHECK_NO_THROW(
+            FC01::RaiseExceptionIfPointCountIsNotValid( Context( 1 ), 2000 ) );
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//---------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_SUITE( Data_Conversion )
+
+    BOOST_AUTO_TEST_CASE( FloatWordOrders )
+    {
+        // 10.0f == 0x41200000
+        uint8_t const abcd[] = { 0x41, 0x20, 0x00, 0x00 };
+        uint8_t const cdab[] = { 0x00, 0x00, 0x41, 0x20 };
+        uint8_t const badc[] = { 0x20, 0x41, 0x00, 0x00 };
+        uint8_t const dcba[] = { 0x00, 0x00, 0x20, 0x41 };
+        float v = 0.0F;
+        DataConv::FromWire( abcd, 1, &v, DataConv::WordOrder::ABCD );
+        BOOST_TEST( v == 10.0F );
+        DataConv::FromWire( cdab, 1, &v, DataConv::WordOrder::CDAB );
+        BOOST_TEST( v == 10.0F );
+        DataConv::FromWire( badc, 1, &v, DataConv::WordOrder::BADC );
+        BOOST_TEST( v == 10.0F );
+        DataConv::FromWire( dcba, 1, &v, DataConv::WordOrder::DCBA );
+        BOOST_TEST( v == 10.0F );
+    }
+
+    BOOST_AUTO_TEST_CASE( DoubleRoundTrip )
+    {
+        uint8_t const wire[] = { 0x40, 0x09, 0x21, 0xFB, 0x54, 0x44, 0x2D, 0x18 };
+        double v = 0.0;
+        DataConv::FromWire( wire, 1, &v );
+        BOOST_TEST( v == 3.141592653589793 );
+        uint8_t back[8] = {};
+        DataConv::ToWire( &v, 1, back );
+        BOOST_TEST( std::equal( back, back + 8, wire ) );
+    }
+
+    BOOST_AUTO_TEST_CASE( FromRegistersInt32 )
+    {
+        RegDataType const regs[] = { 0x0001, 0x0002 };
+        int32_t v = 0;
+        DataConv::FromRegisters( regs, 1, &v, DataConv::WordOrder::ABCD );
+        BOOST_TEST( v == 0x00010002 );
+        DataConv::FromRegisters( regs, 1, &v, DataConv::WordOrder::CDAB );
+        BOOST_TEST( v == 0x00020001 );
+        DataConv::FromRegisters( regs, 1, &v, DataConv::WordOrder::DCBA );
+        BOOST_TEST( v == 0x02000100 );
+    }
+
+    BOOST_AUTO_TEST_CASE( EverySimdLevelMatchesScalar )
+    {
+        // 125 registers: whole vector blocks plus a scalar tail
+        std::vector<uint8_t> wire( 250 );
+        for ( size_t i = 0 ; i < wire.size() ; ++i ) {
+            wire[i] = static_cast<uint8_t>( i * 37 + 11 );
+        }
+        DataConv::SimdLevel const saved = DataConv::GetSimdLevel();
+        for ( auto order : { DataConv::WordOrder::ABCD, DataConv::WordOrder::CDAB,
+                             DataConv::WordOrder::BADC, DataConv::WordOrder::DCBA } ) {
+            DataConv::SetSimdLevel( DataConv::SimdLevel::Scalar );
+            std::vector<uint32_t> expected( 62 );
+            DataConv::FromWire( wire.data(), expected.size(), expected.data(), order );
+            for ( auto level : { DataConv::SimdLevel::SSE2, DataConv::SimdLevel::AVX2,
+                                 DataConv::SimdLevel::NEON } ) {
+                if ( DataConv::IsSimdLevelSupported( level ) ) {
+                    DataConv::SetSimdLevel( level );
+                    std::vector<uint32_t> v( expected.size() );
+                    DataConv::FromWire( wire.data(), v.size(), v.data(), order );
+                    BOOST_TEST( v == expected );
+                }
+            }
+        }
+        DataConv::SetSimdLevel( saved );
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//---------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_SUITE( Change_Detection )
+
+    struct ChangeSink {
+        std::vector<ChangeDetect::Change> changes;
+        int calls = 0;
+
+        void __fastcall OnChanges( ChangeDetect::ChangeDetector& Sender,
+                                   ChangeDetect::Change const * Changes, size_t Count )
+        {
+            ++calls;
+            changes.assign( Changes, Changes + Count );
+        }
+    };
+
+    BOOST_AUTO_TEST_CASE( FirstUpdateReportsEveryTag )
+    {
+        ChangeDetect::ChangeDetector det(
+            ChangeDetect::BlockType::Registers, 125,
+            { { 0, ChangeDetect::TagType::UInt16 }, { 124, ChangeDetect::TagType::Int16 } }
+        );
+        ChangeSink sink;
+        det.Subscribe( sink.OnChanges );
+        std::vector<RegDataType> regs( 125 );
+        regs[124] = 0xFFFF;
+        BOOST_TEST( det.Update( regs.data() ) == 2u );
+        BOOST_TEST( sink.changes[1].Value == -1.0 );
+        BOOST_TEST( det.Update( regs.data() ) == 0u );
+        BOOST_TEST( sink.calls == 1 );
+    }
+
+    BOOST_AUTO_TEST_CASE( AbsoluteDeadband )
+    {
+        ChangeDetect::ChangeDetector det(
+            ChangeDetect::BlockType::Registers, 10,
+            { { 4, ChangeDetect::TagType::UInt16, DataConv::WordOrder::ABCD,
+                ChangeDetect::DeadbandType::Absolute, 5.0 } }
+        );
+        std::vector<RegDataType> regs( 10 );
+        det.Update( regs.data() );
+        regs[4] = 3;
+        BOOST_TEST( det.Update( regs.data() ) == 0u );
+        regs[4] = 6;    // compared with the last reported value (0), not the last scan
+        BOOST_TEST( det.Update( regs.data() ) == 1u );
+        BOOST_TEST( det.GetReportedValue( 0 ) == 6.0 );
+        regs[0] = 1;    // outside every tag
+        BOOST_TEST( det.Update( regs.data() ) == 0u );
+    }
+
+    BOOST_AUTO_TEST_CASE( PercentDeadbandFloat )
+    {
+        ChangeDetect::ChangeDetector det(
+            ChangeDetect::BlockType::Registers, 2,
+            { { 0, ChangeDetect::TagType::Float32, DataConv::WordOrder::CDAB,
+                ChangeDetect::DeadbandType::Percent, 10.0 } }
+        );
+        RegDataType regs[2];
+        float v = 100.0F;
+        DataConv::ToRegisters( &v, 1, regs, DataConv::WordOrder::CDAB );
+        det.Update( regs );
+        v = 105.0F;
+        DataConv::ToRegisters( &v, 1, regs, DataConv::WordOrder::CDAB );
+        BOOST_TEST( det.Update( regs ) == 0u );
+        v = 111.0F;
+        DataConv::ToRegisters( &v, 1, regs, DataConv::WordOrder::CDAB );
+        BOOST_TEST( det.Update( regs ) == 1u );
+        BOOST_TEST( det.GetReportedValue( 0 ) == 111.0 );
+    }
+
+    BOOST_AUTO_TEST_CASE( BitTags )
+    {
+        ChangeDetect::ChangeDetector det(
+            ChangeDetect::BlockType::Bits, 20,
+            { { 3, ChangeDetect::TagType::Bit }, { 17, ChangeDetect::TagType::Bit } }
+        );
+        ChangeSink sink;
+        det.Subscribe( sink.OnChanges );
+        CoilDataType bits[3] = {};
+        det.Update( bits );
+        bits[0] = 0x0C;     // bit 3 (tag) and bit 2 (no tag)
+        BOOST_TEST( det.Update( bits ) == 1u );
+        BOOST_TEST( sink.changes[0].TagIndex == 0u );
+        BOOST_TEST( sink.changes[0].Value == 1.0 );
+    }
+
+    BOOST_AUTO_TEST_CASE( InvalidTagThrows )
+    {
+        BOOST_CHECK_THROW(
+            ChangeDetect::ChangeDetector(
+                ChangeDetect::BlockType::Registers, 2,
+                { { 1, ChangeDetect::TagType::Float32 } }
+            ),
+            EBaseException
+        );
+        BOOST_CHECK_THROW(
+            ChangeDetect::ChangeDetector(
+                ChangeDetect::BlockType::Registers, 2, { { 0, ChangeDetect::TagType::Bit } }
+            ),
+            EBaseException
+        );
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//---------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_SUITE( Batch_Execute, ProtoFixture )
+
+    BOOST_AUTO_TEST_CASE( MixedBatchCompletes )
+    {
+        RegDataType  regs[4]  = {};
+        RegDataType  inRegs[2] = {};
+        CoilDataType coils[1] = {};
+        RegDataType  src[2]   = { 0x1111u, 0x2222u };
+
+        Request batch[] = {
+            Request::ReadHoldingRegisters( 1, 10, 4, regs ),
+            Request::ReadInputRegisters( 1, 5, 2, inRegs ),
+            Request::ReadCoilStatus( 1, 0, 8, coils ),
+            Request::PresetSingleRegister( 1, 50, 0xBEEFu ),
+            Request::PresetMultipleRegisters( 1, 60, 2, src ),
+            Request::ForceSingleCoil( 1, 0, true ),
+        };
+        size_t const n = sizeof( batch ) / sizeof( batch[0] );
+
+        BOOST_TEST( proto_.Execute( batch, n ) == n );
+        for ( size_t i = 0; i < n; ++i ) {
+            BOOST_TEST( ( batch[i].Status == RequestStatus::Completed ) );
+        }
+        BOOST_TEST( regs[0] == 10u );
+        BOOST_TEST( regs[3] == 13u );
+        BOOST_TEST( inRegs[1] == 0x1006u );
+        BOOST_TEST( coils[0] == 0xAAu );
+        BOOST_TEST( readH( proto_, 50 ) == 0xBEEFu );
+        BOOST_TEST( readH( proto_, 61 ) == 0x2222u );
+        BOOST_TEST( readC( proto_, 0 ) == 1u );
+    }
+
+    BOOST_AUTO_TEST_CASE( ExceptionDoesNotAbortBatch )
+    {
+        RegDataType a = 0, b = 0;
+        Request batch[] = {
+            Request::ReadHoldingRegisters( 1, REG_COUNT, 1, &a ),
+            Request::ReadHoldingRegisters( 1, 7, 1, &b ),
+        };
+
+        BOOST_TEST( proto_.Execute( batch, 2 ) == 1u );
+        BOOST_TEST( ( batch[0].Status == RequestStatus::Exception ) );
+        BOOST_TEST( ( batch[0].ExceptCode == ExceptionCode::IllegalDataAddress ) );
+        BOOST_TEST( ( batch[1].Status == RequestStatus::Completed ) );
+        BOOST_TEST( b == 7u );
+    }
+
+    BOOST_AUTO_TEST_CASE( InvalidItemFailsLocally )
+    {
+        RegDataType v = 0;
+        Request batch[] = {
+            Request::ReadHoldingRegisters( 1, 0, 0, &v ),
+            Request::ReadHoldingRegisters( 1, 3, 1, &v ),
+        };
+
+        BOOST_TEST( proto_.Execute( batch, 2 ) == 1u );
+        BOOST_TEST( ( batch[0].Status == RequestStatus::Failed ) );
+        BOOST_TEST( ( batch[1].Status == RequestStatus::Completed ) );
+        BOOST_TEST( v == 3u );
+    }
+
+    BOOST_AUTO_TEST_CASE( SequentialWhenDepthIsOne )
+    {
+        proto_.SetPipelineDepth( 1 );
+        RegDataType a = 0, b = 0;
+        Request batch[] = {
+            Request::ReadHoldingRegisters( 1, 1, 1, &a ),
+            Request::ReadHoldingRegisters( 1, 2, 1, &b ),
+        };
+
+        BOOST_TEST( proto_.Execute( batch, 2 ) == 2u );
+        BOOST_TEST( a == 1u );
+        BOOST_TEST( b == 2u );
+    }
+
+    BOOST_AUTO_TEST_CASE( DummyBatchCompletes )
+    {
+        DummyProtocol proto;
+        SessionManager session( proto );
+
+        RegDataType v = 0;
+        Request batch[] = { Request::ReadHoldingRegisters( 1, 0, 1, &v ) };
+        BOOST_TEST( proto.Execute( batch, 1 ) == 1u );
+    }
+
+    BOOST_AUTO_TEST_CASE( ExecuteWithoutOpenThrows )
+    {
+        DummyProtocol proto;
+        RegDataType v = 0;
+        Request batch[] = { Request::ReadHoldingRegisters( 1, 0, 1, &v ) };
+        BOOST_CHECK_THROW( proto.Execute( batch, 1 ), EBaseException );
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//---------------------------------------------------------------------------
+// Records the reads reaching the transport; registers read back their address
+//---------------------------------------------------------------------------
+
+struct ChunkRecorder : DummyProtocol {
+    std::vector<std::pair<uint16_t,uint16_t>> reads;   // start address, point count
+
+protected:
+    void DoReadCoilStatus( Context const & Context, CoilAddrType StartAddr,
+                           CoilCountType PointCount, CoilDataType* Data ) noexcept override
+    {
+        reads.emplace_back( StartAddr, PointCount );
+        std::fill( Data, Data + ( PointCount + 7 ) / 8, static_cast<CoilDataType>( 0x5A ) );
+    }
+    void DoReadHoldingRegisters( Context const & Context, RegAddrType StartAddr,
+                                 RegCountType PointCount,
+                                 RegDataType* Data ) noexcept override
+    {
+        reads.emplace_back( StartAddr, PointCount );
+        for ( RegCountType i = 0 ; i < PointCount ; ++i ) {
+            Data[i] = static_cast<RegDataType>( StartAddr + i );
+        }
+    }
+};
+
+// Loses one of the frames written from now on, so that the server never answers it,
+// or closes the link at the next write
+struct LossyLink : TCPProtocolWinSock {
+    LossyLink() : TCPProtocolWinSock( _D( "127.0.0.1" ), SERVER_PORT ) {}
+
+    int  dropFrame    = -1;     // index of the first frame to lose
+    int  dropCount    = 1;      // frames lost from there
+    int  frames       = 0;      // frames written so far
+    int  writes       = 0;
+    bool closeAtWrite = false;
+    std::vector<int> writeFrames;   // frames carried by each write
+
+protected:
+    void DoWrite( TBytes const OutBuffer ) override
+    {
+        if ( closeAtWrite ) {
+            closeAtWrite = false;
+            DoClose();
+            throw EBaseException( _D( "TCP: send failed" ) );
+        }
+        TBytes kept;
+        int const framesBefore = frames;
+        for ( int pos = 0; pos < OutBuffer.Length; ) {
+            int const len = 6 + ( ( OutBuffer[pos + 4] << 8 ) | OutBuffer[pos + 5] );
+            bool const lost = frames >= dropFrame && frames < dropFrame + dropCount;
+            ++frames;
+            if ( !lost ) {
+                int const offset = kept.Length;
+                kept.Length = offset + len;
+                std::copy( &OutBuffer[pos], &OutBuffer[pos] + len, &kept[0] + offset );
+            }
+            pos += len;
+        }
+        writeFrames.push_back( frames - framesBefore );
+        ++writes;
+        if ( kept.Length )
+            TCPProtocolWinSock::DoWrite( kept );
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE( Range_Read, ProtoFixture )
+
+    BOOST_AUTO_TEST_CASE( LongRangeIsSplitAndPipelined )
+    {
+        std::vector<RegDataType> regs( REG_COUNT );
+        proto_.ReadHoldingRegisterRange( Context( 1 ), 0, REG_COUNT, regs.data() );
+        for ( int i = 0; i < REG_COUNT; ++i )
+            BOOST_TEST( regs[i] == static_cast<RegDataType>( i ) );
+
+        std::vector<CoilDataType> coils( REG_COUNT / 8 );
+        TransactionPolicy limits;
+        limits.MaxCoilCount = 20;                       // rounded down to 16
+        proto_.SetSlavePolicy( 1, limits );
+        proto_.ReadCoilStatusRange( Context( 1 ), 0, REG_COUNT, coils.data() );
+        for ( CoilDataType c : coils )
+            BOOST_TEST( c == 0xAAu );
+    }
+
+    BOOST_AUTO_TEST_CASE( ChunksFollowTheDeviceLimits )
+    {
+        ChunkRecorder proto;
+        SessionManager session( proto );
+
+        std::vector<RegDataType> regs( 2000 );
+        proto.ReadHoldingRegisterRange( Context( 1 ), 100, regs.size(), regs.data() );
+        BOOST_TEST( proto.reads.size() == 16u );        // 15 x 125 + 125
+        BOOST_TEST( regs[1999] == 2099u );
+
+        proto.reads.clear();
+        TransactionPolicy limits;
+        limits.MaxRegisterCount = 60;
+        proto.ReadHoldingRegisterRange( Context( 1, limits ), 0, 130, regs.data() );
+        BOOST_TEST( proto.reads.size() == 3u );
+        BOOST_TEST( proto.reads[2].first == 120u );
+        BOOST_TEST( proto.reads[2].second == 10u );
+        BOOST_TEST( regs[129] == 129u );
+
+        proto.reads.clear();
+        std::vector<CoilDataType> coils( 2100 / 8 + 1 );
+        proto.ReadCoilStatusRange( Context( 1 ), 0, 2100, coils.data() );
+        BOOST_TEST( proto.reads.size() == 2u );
+        BOOST_TEST( proto.reads[1].first == 2000u );
+        BOOST_TEST( coils[262] == 0x5Au );
+    }
+
+    BOOST_AUTO_TEST_CASE( FirstFailingChunkIsRaised )
+    {
+        std::vector<RegDataType> regs( 300 );
+        BOOST_CHECK_THROW(
+            proto_.ReadHoldingRegisterRange( Context( 1 ), 200, 100, regs.data() ),
+            EIllegalDataAddress );
+        BOOST_CHECK_THROW(
+            proto_.ReadHoldingRegisterRange( Context( 1 ), 65500, 100, regs.data() ),
+            EContextException );
+        BOOST_CHECK_THROW(
+            proto_.ReadInputRegisterRange( Context( 1 ), 0, 0, regs.data() ),
+            EContextException );
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+// The server serves one connection at a time: no ProtoFixture connection alongside
+BOOST_AUTO_TEST_SUITE( Lossy_Link )
+
+    BOOST_AUTO_TEST_CASE( LostReplyIsRetried )
+    {
+        LossyLink link;
+        SessionManager session( link );
+        TransactionPolicy policy;
+        policy.Timeout = 100;
+        policy.RetryCount = 1;
+        policy.MaxRegisterCount = 32;
+        link.SetSlavePolicy( 1, policy );
+
+        // Eight chunks in one window: the fourth is lost and sent again alone
+        link.dropFrame = 3;
+        std::vector<RegDataType> regs( REG_COUNT );
+        link.ReadHoldingRegisterRange( Context( 1 ), 0, REG_COUNT, regs.data() );
+        for ( int i = 0; i < REG_COUNT; ++i )
+            BOOST_TEST( regs[i] == static_cast<RegDataType>( i ) );
+        BOOST_TEST( link.frames == 9 );
+
+        // Without retries only the lost item fails
+        policy.RetryCount = 0;
+        link.SetSlavePolicy( 1, policy );
+        link.frames = 0;
+        link.dropFrame = 2;
+        RegDataType v[4] = {};
+        Request batch[4];
+        for ( int i = 0; i < 4; ++i )
+            batch[i] = Request::ReadHoldingRegisters( 1, i + 10, 1, &v[i] );
+        BOOST_TEST( link.Execute( batch, 4 ) == 3u );
+        BOOST_TEST( ( batch[2].Status == RequestStatus::Failed ) );
+        BOOST_TEST( ( batch[3].Status == RequestStatus::Completed ) );
+        BOOST_TEST( v[3] == 13u );
+        link.dropFrame = link.frames + 1;
+        BOOST_CHECK_THROW(
+            link.ReadHoldingRegisterRange( Context( 1 ), 0, 64, regs.data() ),
+            EBaseException );
+    }
+
+    BOOST_AUTO_TEST_CASE( ClosedLinkIsReopened )
+    {
+        LossyLink link;
+        SessionManager session( link );
+        link.SetPipelineDepth( 2 );
+
+        // No retries: the first window fails, the rest goes out on a new connection
+        RegDataType v[4] = {};
+        Request batch[4];
+        for ( int i = 0; i < 4; ++i )
+            batch[i] = Request::ReadHoldingRegisters( 1, i + 20, 1, &v[i] );
+        link.closeAtWrite = true;
+        BOOST_TEST( link.Execute( batch, 4 ) == 2u );
+        BOOST_TEST( ( batch[0].Status == RequestStatus::Failed ) );
+        BOOST_TEST( ( batch[1].Status == RequestStatus::Failed ) );
+        BOOST_TEST( v[3] == 23u );
+        BOOST_TEST( link.IsConnected() );
+
+        // With a retry every item completes
+        for ( Request& req : batch )
+            req.Policy.RetryCount = 1;
+        link.closeAtWrite = true;
+        BOOST_TEST( link.Execute( batch, 4 ) == 4u );
+        BOOST_TEST( v[0] == 20u );
+    }
+
+    BOOST_AUTO_TEST_CASE( RetriesOfAWindowShareOneBackoff )
+    {
+        LossyLink link;
+        SessionManager session( link );
+
+        // Two items lost in one window: one pause of the longest backoff, then both
+        // go out again in one write
+        RegDataType v[3] = {};
+        Request batch[3];
+        for ( int i = 0; i < 3; ++i ) {
+            batch[i] = Request::ReadHoldingRegisters( 1, i + 30, 1, &v[i] );
+            batch[i].Policy.Timeout = 100;
+            batch[i].Policy.RetryCount = 2;
+            batch[i].Policy.Backoff = 50;
+        }
+        batch[2].Policy.Backoff = 200;
+        link.dropFrame = 1;
+        link.dropCount = 2;
+        auto const started = std::chrono::steady_clock::now();
+        BOOST_TEST( link.Execute( batch, 3 ) == 3u );
+        auto const elapsed = std::chrono::steady_clock::now() - started;
+        BOOST_CHECK( elapsed >= std::chrono::milliseconds( 100 + 200 ) );
+        BOOST_CHECK( elapsed < std::chrono::milliseconds( 100 + 200 + 200 ) );
+        BOOST_TEST( link.frames == 5 );
+        BOOST_TEST( link.writes == 2 );
+        BOOST_TEST( v[1] == 31u );
+    }
+
+    BOOST_AUTO_TEST_CASE( ScheduledRequestIsRetried )
+    {
+        LossyLink link;
+        SessionManager session( link );
+        RequestScheduler scheduler( link, 0 );
+
+        RegDataType v = 0;
+        Request req = Request::ReadHoldingRegisters( 1, 40, 1, &v );
+        req.Policy.Timeout = 100;
+        req.Policy.RetryCount = 1;
+        link.dropFrame = 0;
+        Request const done = scheduler.Submit( req, RequestPriority::Control ).get();
+        BOOST_TEST( ( done.Status == RequestStatus::Completed ) );
+        BOOST_TEST( v == 40u );
+        BOOST_TEST( link.frames == 2 );
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//---------------------------------------------------------------------------
+// File record transfers
+//---------------------------------------------------------------------------
+
+static RegDataType fileValue( int file, int rec )
+{
+    return static_cast<RegDataType>( ( file << 8 ) | rec );
+}
+
+// Records the FC20/FC21 transactions reaching the transport; reads return the
+// initial server records
+struct FileRecorder : DummyProtocol {
+    std::vector<std::vector<FileSubRequest>> transactions;
+
+protected:
+    void DoReadGeneralReference( Context const & Context,
+                                 const FileSubRequest* SubRequests, size_t SubReqCount,
+                                 RegDataType* Data ) noexcept override
+    {
+        transactions.emplace_back( SubRequests, SubRequests + SubReqCount );
+        for ( size_t i = 0; i < SubReqCount; ++i )
+            for ( int r = 0; r < SubRequests[i].RecordLength; ++r )
+                *Data++ = fileValue( SubRequests[i].FileNumber, SubRequests[i].RecordNumber + r );
+    }
+    void DoWriteGeneralReference( Context const & Context,
+                                  const FileSubRequest* SubRequests, size_t SubReqCount,
+                                  const RegDataType* Data ) noexcept override
+    {
+        transactions.emplace_back( SubRequests, SubRequests + SubReqCount );
+    }
+};
+
+// Drops the connection after the first items of the next batch: the rest stay Pending
+struct DroppingLink : TCPProtocolWinSock {
+    DroppingLink() : TCPProtocolWinSock( _D( "127.0.0.1" ), SERVER_PORT ) {}
+
+    size_t dropAfter = SIZE_MAX;
+    size_t executed  = 0;
+
+protected:
+    void DoExecute( Request* Requests, size_t RequestCount ) override
+    {
+        size_t const count = std::min( RequestCount, dropAfter );
+        TCPProtocolWinSock::DoExecute( Requests, count );
+        executed += count;
+        dropAfter = SIZE_MAX;
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE( File_Transfer, ProtoFixture )
+
+    BOOST_AUTO_TEST_CASE( WholeFileIsReadInPipelinedChunks )
+    {
+        FileSubRequest segments[2] = { { 3, 0, FILE_RECS }, { 4, 0, 100 } };
+        std::vector<RegDataType> data( FILE_RECS + 100 );
+        FileTransfer transfer = FileTransfer::Read( proto_, 1, segments, 2, data.data() );
+        BOOST_TEST( transfer.GetRecordCount() == data.size() );
+        BOOST_TEST( transfer.GetChunkCount() == 9u );   // 8 x 124, then 8 + 100 records
+
+        transfer.Run();
+        BOOST_TEST( transfer.IsComplete() );
+        BOOST_TEST( transfer.GetResumePoint() == data.size() );
+        for ( int r = 0; r < FILE_RECS; ++r )
+            BOOST_TEST( data[r] == fileValue( 3, r ) );
+        for ( int r = 0; r < 100; ++r )
+            BOOST_TEST( data[FILE_RECS + r] == fileValue( 4, r ) );
+    }
+
+    BOOST_AUTO_TEST_CASE( WrittenRecordsReadBack )
+    {
+        FileSubRequest segment { 4, 200, 600 };
+        std::vector<RegDataType> out( 600 ), in( 600 );
+        for ( size_t i = 0; i < out.size(); ++i )
+            out[i] = static_cast<RegDataType>( 0xA000 + i );
+
+        FileTransfer writer = FileTransfer::Write( proto_, 1, &segment, 1, out.data() );
+        BOOST_TEST( writer.GetChunkCount() == 5u );     // up to 122 records per write
+        writer.Run();
+        BOOST_TEST( writer.IsComplete() );
+
+        FileTransfer reader = FileTransfer::Read( proto_, 1, &segment, 1, in.data() );
+        reader.Run();
+        BOOST_TEST( in == out );
+    }
+
+    BOOST_AUTO_TEST_CASE( SubRequestsArePackedUpToThePDULimit )
+    {
+        FileRecorder proto;
+        SessionManager session( proto );
+
+        // Segments are continued across chunks, and a chunk is filled with the
+        // next segment up to 253 bytes of response
+        FileSubRequest segments[3] = { { 1, 0, 10 }, { 2, 5, 300 }, { 3, 9990, 10 } };
+        std::vector<RegDataType> data( 320 );
+        FileTransfer transfer = FileTransfer::Read( proto, 1, segments, 3, data.data() );
+        transfer.Run();
+        BOOST_TEST_REQUIRE( proto.transactions.size() == 3u );
+        BOOST_TEST( proto.transactions[0].size() == 2u );
+        BOOST_TEST( proto.transactions[0][1].RecordNumber == 5u );
+        BOOST_TEST( proto.transactions[0][1].RecordLength == 113u );
+        BOOST_TEST( proto.transactions[1][0].RecordLength == 124u );
+        BOOST_TEST( proto.transactions[2][0].RecordNumber == 242u );
+        BOOST_TEST( proto.transactions[2][1].RecordLength == 10u );
+        BOOST_TEST( data[10] == fileValue( 2, 5 ) );
+        BOOST_TEST( data[319] == fileValue( 3, 9999 ) );
+
+        // At most 35 sub-requests fit in a request
+        std::vector<FileSubRequest> single( 40 );
+        for ( size_t i = 0; i < single.size(); ++i )
+            single[i] = { 1, static_cast<RecordNumberType>( i * 2 ), 1 };
+        proto.transactions.clear();
+        FileTransfer scattered =
+            FileTransfer::Read( proto, 1, single.data(), single.size(), data.data() );
+        scattered.Run();
+        BOOST_TEST_REQUIRE( proto.transactions.size() == 2u );
+        BOOST_TEST( proto.transactions[0].size() == 35u );
+
+        FileSubRequest beyond { 1, 9999, 2 };
+        BOOST_CHECK_THROW(
+            FileTransfer::Read( proto, 1, &beyond, 1, data.data() ).Run(), EBaseException );
+    }
+
+    BOOST_AUTO_TEST_CASE( InterruptedTransferResumes )
+    {
+        DroppingLink link;
+        SessionManager session( link );
+
+        FileSubRequest segment { 3, 0, FILE_RECS };
+        std::vector<RegDataType> data( FILE_RECS );
+        FileTransfer transfer = FileTransfer::Read( link, 1, &segment, 1, data.data() );
+        transfer.SetBatchSize( 4 );
+        link.dropAfter = 2;
+        BOOST_CHECK_THROW( transfer.Run(), EContextException );
+        BOOST_TEST( !transfer.IsComplete() );
+        BOOST_TEST( transfer.GetResumePoint() == 248u );
+        BOOST_TEST( transfer.GetTransferredCount() == 248u );
+
+        // A new transfer starts from the stored resume point
+        std::vector<RegDataType> rest( FILE_RECS );
+        FileTransfer resumed = FileTransfer::Read( link, 1, &segment, 1, rest.data() );
+        resumed.SetResumePoint( transfer.GetResumePoint() );
+        link.executed = 0;
+        resumed.Run();
+        BOOST_TEST( link.executed == 7u );
+        BOOST_TEST( rest[247] == 0u );
+        BOOST_TEST( rest[248] == fileValue( 3, 248 ) );
+
+        // The interrupted one transfers only what is missing
+        link.executed = 0;
+        transfer.Run();
+        BOOST_TEST( link.executed == 7u );
+        BOOST_TEST( transfer.IsComplete() );
+        for ( int r = 0; r < FILE_RECS; ++r )
+            BOOST_TEST( data[r] == fileValue( 3, r ) );
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//---------------------------------------------------------------------------
+// Records the write transactions reaching the transport
+//---------------------------------------------------------------------------
+
+struct RecordingProtocol : DummyProtocol {
+    struct Write {
+        FunctionCode             fc;
+        uint16_t                 addr;
+        std::vector<RegDataType> values;   // registers, or one entry per coil
+    };
+    std::vector<Write> writes;
+
+protected:
+    void DoForceSingleCoil( Context const & Context, CoilAddrType Addr,
+                            bool Value ) noexcept override
+    {
+        writes.push_back( { FunctionCode::ForceSingleCoil, Addr, { Value } } );
+    }
+    void DoPresetSingleRegister( Context const & Context, RegAddrType Addr,
+                                 RegDataType Data ) noexcept override
+    {
+        writes.push_back( { FunctionCode::PresetSingleRegister, Addr, { Data } } );
+    }
+    void DoForceMultipleCoils( Context const & Context, CoilAddrType StartAddr,
+                               CoilCountType PointCount,
+                               const CoilDataType* Data ) noexcept override
+    {
+        Write w { FunctionCode::ForceMultipleCoils, StartAddr, {} };
+        for ( CoilCountType i = 0 ; i < PointCount ; ++i ) {
+            w.values.push_back( ( Data[i / 8] >> ( i % 8 ) ) & 1 );
+        }
+        writes.push_back( w );
+    }
+    void DoPresetMultipleRegisters( Context const & Context, RegAddrType StartAddr,
+                                    RegCountType PointCount,
+                                    const RegDataType* Data ) noexcept override
+    {
+        writes.push_back(
+            { FunctionCode::PresetMultipleRegisters, StartAddr, { Data, Data + PointCount } }
+        );
+    }
+};
+
+BOOST_AUTO_TEST_SUITE( Write_Queue )
+
+    BOOST_AUTO_TEST_CASE( AdjacentRegistersCoalesce )
+    {
+        RecordingProtocol proto;
+        SessionManager session( proto );
+        WriteQueue queue( proto, WriteOrdering::Address, 60000 );
+
+        queue.PresetSingleRegister( 1, 11, 0x11 );
+        queue.PresetSingleRegister( 1, 10, 0x10 );
+        queue.PresetSingleRegister( 1, 12, 0x12 );
+        queue.PresetSingleRegister( 1, 11, 0xAA );   // last writer wins
+        queue.PresetSingleRegister( 1, 20, 0x20 );   // not adjacent
+        BOOST_TEST( queue.GetPendingCount() == 4u );
+        BOOST_TEST( proto.writes.empty() );
+
+        BOOST_TEST( queue.Flush() == 2u );
+        BOOST_TEST( queue.GetPendingCount() == 0u );
+        BOOST_REQUIRE( proto.writes.size() == 2u );
+        BOOST_TEST( ( proto.writes[0].fc == FunctionCode::PresetMultipleRegisters ) );
+        BOOST_TEST( proto.writes[0].addr == 10u );
+        std::vector<RegDataType> const expected { 0x10, 0xAA, 0x12 };
+        BOOST_TEST( proto.writes[0].values == expected );
+        BOOST_TEST( ( proto.writes[1].fc == FunctionCode::PresetSingleRegister ) );
+        BOOST_TEST( proto.writes[1].addr == 20u );
+    }
+
+    BOOST_AUTO_TEST_CASE( CoilsCoalesceIntoFC15 )
+    {
+        RecordingProtocol proto;
+        SessionManager session( proto );
+        WriteQueue queue( proto, WriteOrdering::Address, 60000 );
+
+        for ( CoilAddrType a = 0 ; a < 10 ; ++a ) {
+            queue.ForceSingleCoil( 2, a, a % 3 == 0 );
+        }
+        BOOST_TEST( queue.Flush() == 1u );
+        BOOST_REQUIRE( proto.writes.size() == 1u );
+        BOOST_TEST( ( proto.writes[0].fc == FunctionCode::ForceMultipleCoils ) );
+        std::vector<RegDataType> const expected { 1, 0, 0, 1, 0, 0, 1, 0, 0, 1 };
+        BOOST_TEST( proto.writes[0].values == expected );
+    }
+
+    BOOST_AUTO_TEST_CASE( IssueOrderingKeepsOrder )
+    {
+        RecordingProtocol proto;
+        SessionManager session( proto );
+        WriteQueue queue( proto, WriteOrdering::Issue, 60000 );
+
+        queue.PresetSingleRegister( 1, 10, 1 );
+        queue.PresetSingleRegister( 1, 11, 2 );
+        queue.PresetSingleRegister( 1, 20, 3 );
+        queue.PresetSingleRegister( 1, 12, 4 );   // after 20: not merged with 10..11
+        BOOST_TEST( queue.Flush() == 3u );
+        BOOST_REQUIRE( proto.writes.size() == 3u );
+        BOOST_TEST( proto.writes[0].addr == 10u );
+        BOOST_TEST( proto.writes[0].values.size() == 2u );
+        BOOST_TEST( proto.writes[1].addr == 20u );
+        BOOST_TEST( proto.writes[2].addr == 12u );
+    }
+
+    BOOST_AUTO_TEST_CASE( ExpiredDeadlineFlushesOnWrite )
+    {
+        RecordingProtocol proto;
+        SessionManager session( proto );
+        WriteQueue queue( proto, WriteOrdering::Address, 0 );
+
+        queue.PresetSingleRegister( 1, 5, 42 );
+        BOOST_TEST( queue.GetPendingCount() == 0u );
+        BOOST_TEST( proto.writes.size() == 1u );
+        BOOST_TEST( !queue.FlushIfDue() );
+    }
+
+    BOOST_AUTO_TEST_CASE( NotConnectedKeepsPendingWrites )
+    {
+        RecordingProtocol proto;
+        WriteQueue queue( proto, WriteOrdering::Address, 60000 );
+        queue.PresetSingleRegister( 1, 5, 42 );
+        BOOST_CHECK_THROW( queue.Flush(), EBaseException );
+        BOOST_TEST( queue.GetPendingCount() == 1u );
+    }
+
+    BOOST_FIXTURE_TEST_CASE( FlushReachesServer, ProtoFixture )
+    {
+        WriteQueue queue( proto_, WriteOrdering::Address, 60000 );
+        queue.PresetSingleRegister( 1, 30, 0x0A0A );
+        queue.PresetSingleRegister( 1, 31, 0x0B0B );
+        queue.ForceSingleCoil( 1, 40, true );
+        queue.ForceSingleCoil( 1, 41, true );
+        BOOST_TEST( queue.Flush() == 2u );
+        BOOST_TEST( readH( proto_, 30 ) == 0x0A0Au );
+        BOOST_TEST( readH( proto_, 31 ) == 0x0B0Bu );
+        BOOST_TEST( readC( proto_, 40 ) == 1u );
+        BOOST_TEST( readC( proto_, 41 ) == 1u );
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//---------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_SUITE( Register_Update, ProtoFixture )
+
+    BOOST_AUTO_TEST_CASE( BitChangesShareOneMaskWrite )
+    {
+        proto_.PresetSingleRegister( ctx(), 90, 0x00F0 );
+        proto_.PresetSingleRegister( ctx(), 91, 0x0001 );
+
+        RegisterUpdater updater( proto_ );
+        updater.SetBit( 1, 90, 0, true );
+        updater.SetBit( 1, 90, 4, false );
+        updater.SetBits( 1, 90, 0xF000, 0xA0FF );   // only the bits of the mask count
+        updater.SetBit( 1, 91, 15, true );
+        BOOST_TEST( updater.GetPendingCount() == 2u );
+
+        BOOST_TEST( updater.Flush() == 2u );
+        BOOST_TEST( updater.GetPendingCount() == 0u );
+        BOOST_TEST( readH( proto_, 90 ) == 0xA0E1u );
+        BOOST_TEST( readH( proto_, 91 ) == 0x8001u );
+        BOOST_TEST( updater.IsSupported( 1, FunctionCode::MaskWrite4XRegister ) );
+    }
+
+    BOOST_AUTO_TEST_CASE( DeviceWithoutFC22FallsBack )
+    {
+        proto_.PresetSingleRegister( ctx(), 92, 0x0100 );
+
+        RegisterUpdater updater( proto_ );
+        updater.SetBit( BASIC_UNIT, 92, 3, true );
+        BOOST_TEST( updater.Flush() == 1u );
+        BOOST_TEST( readH( proto_, 92 ) == 0x0108u );
+        BOOST_TEST( !updater.IsSupported( BASIC_UNIT, FunctionCode::MaskWrite4XRegister ) );
+
+        updater.SetBit( BASIC_UNIT, 92, 8, false );  // known: no FC22 attempt
+        BOOST_TEST( updater.Flush() == 1u );
+        BOOST_TEST( readH( proto_, 92 ) == 0x0008u );
+
+        updater.SetNonAtomicFallback( false );
+        updater.SetBit( BASIC_UNIT, 92, 0, true );
+        BOOST_CHECK_THROW( updater.Flush(), EBaseException );
+        BOOST_TEST( readH( proto_, 92 ) == 0x0008u );
+    }
+
+    BOOST_AUTO_TEST_CASE( ExchangeUsesFC23OrFallsBack )
+    {
+        proto_.PresetSingleRegister( ctx(), 94, 0x0094 );
+
+        RegisterUpdater updater( proto_ );
+        RegDataType const command = 0x5555;
+        RegDataType status[2] {};
+        BOOST_TEST( updater.Exchange( 1, 93, 1, &command, 93, 2, status ) );
+        BOOST_TEST( status[0] == 0x5555u );
+        BOOST_TEST( status[1] == 0x0094u );
+
+        RegDataType const commands[2] { 0x1234, 0x5678 };
+        BOOST_TEST( !updater.Exchange( BASIC_UNIT, 93, 2, commands, 93, 2, status ) );
+        BOOST_TEST( status[0] == 0x1234u );
+        BOOST_TEST( status[1] == 0x5678u );
+        BOOST_TEST( !updater.IsSupported( BASIC_UNIT, FunctionCode::ReadWrite4XRegisters ) );
+
+        updater.SetNonAtomicFallback( false );
+        BOOST_CHECK_THROW(
+            updater.Exchange( BASIC_UNIT, 93, 1, &command, 93, 1, status ), EIllegalFunction
+        );
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//---------------------------------------------------------------------------
+
+struct RTUOverTCPFixture {
+    RTUOverTCPFixture()
+        : proto_( _D( "127.0.0.1" ), RTU_GATEWAY_PORT )
+        , session_( proto_ )
+    {
+        initRegisters();
+    }
+    RTUOverTCPProtocolWinSock proto_;
+    SessionManager            session_;
+};
+
+BOOST_FIXTURE_TEST_SUITE( RTU_Over_TCP, RTUOverTCPFixture )
+
+    BOOST_AUTO_TEST_CASE( ReadsSegmentedResponse )
+    {
+        RegDataType v[10] = {};
+        proto_.ReadHoldingRegisters( Context( 1 ), 20, 10, v );
+        for ( int i = 0; i < 10; ++i )
+            BOOST_TEST( v[i] == 20 + i );
+    }
+
+    BOOST_AUTO_TEST_CASE( ConnectTimeoutIsSettable )
+    {
+        BOOST_TEST( proto_.GetConnectTimeout() == unsigned( MODBUS_TCP_IP_DEFAULT_CONNECT_TIMEOUT ) );
+        proto_.SetConnectTimeout( 250 );
+        BOOST_TEST( proto_.GetConnectTimeout() == 250u );
+        proto_.Close();
+        proto_.Open();
+        RegDataType v[2] = {};
+        proto_.ReadHoldingRegisters( Context( 1 ), 20, 2, v );
+        BOOST_TEST( v[1] == 21u );
+    }
+
+    BOOST_AUTO_TEST_CASE( WriteThenReadBack )
+    {
+        RegDataType const w[3] = { 0xA1, 0xB2, 0xC3 };
+        proto_.PresetMultipleRegisters( Context( 1 ), 100, 3, w );
+        RegDataType r[3] = {};
+        proto_.ReadHoldingRegisters( Context( 1 ), 100, 3, r );
+        BOOST_TEST( r[0] == 0xA1u );
+        BOOST_TEST( r[1] == 0xB2u );
+        BOOST_TEST( r[2] == 0xC3u );
+    }
+
+    BOOST_AUTO_TEST_CASE( CommEventsAndSlaveId )
+    {
+        CommEventCounter counter = proto_.FetchCommEventCtr( Context( 1 ) );
+        CommEventLog log = proto_.FetchCommEventLog( Context( 1 ) );
+        BOOST_TEST( log.EventCount == counter.EventCount );
+        BOOST_TEST( log.Events.size() == 2u );
+        BOOST_TEST( proto_.ReportSlave( Context( 1 ) ).size() == 4u );
+    }
+
+    BOOST_AUTO_TEST_CASE( VariableLengthFIFOResponse )
+    {
+        RegDataType v[31] = {};
+        BOOST_TEST( proto_.ReadFIFOQueue( Context( 1 ), 0, v ) == 5u );
+        BOOST_TEST( v[0] == 0x100u );
+        BOOST_TEST( v[4] == 0x104u );
+    }
+
+    BOOST_AUTO_TEST_CASE( FileRecordsRoundTrip )
+    {
+        FileSubRequest subs[2] = { { 2, 30, 2 }, { 3, 30, 1 } };
+        RegDataType const w[3] = { 0x1234, 0x5678, 0x9ABC };
+        proto_.WriteGeneralReference( Context( 1 ), subs, 2, w );
+        RegDataType r[3] = {};
+        proto_.ReadGeneralReference( Context( 1 ), subs, 2, r );
+        BOOST_TEST( r[1] == 0x5678u );
+        BOOST_TEST( r[2] == 0x9ABCu );
+
+        std::vector<FileSubRequest> many( 40, FileSubRequest { 1, 0, 1 } );
+        BOOST_CHECK_THROW(
+            proto_.ReadGeneralReference( Context( 1 ), many.data(), many.size(), r ),
+            EContextException );
+    }
+
+    BOOST_AUTO_TEST_CASE( ExceptionResponseIsRaised )
+    {
+        RegDataType v[1] = {};
+        BOOST_CHECK_THROW(
+            proto_.ReadHoldingRegisters( Context( 1 ), REG_COUNT, 1, v ),
+            EIllegalDataAddress );
+    }
+
+    BOOST_AUTO_TEST_CASE( DeviceIdentificationIsReadInStages )
+    {
+        DeviceIdentification id =
+            proto_.ReadDeviceIdentification( Context( 1 ), ReadDeviceIdCode::Regular );
+        BOOST_TEST( id.ConformityLevel == 0x82u );
+        BOOST_TEST( id.Objects.size() == 7u );
+        BOOST_TEST( id.Objects[0] == "Acme Automation" );
+        BOOST_TEST( id.Objects[6] == "Line 3" );
+        BOOST_CHECK_THROW(
+            proto_.ReadDeviceIdentification( Context( 1 ), ReadDeviceIdCode::Individual, 0x40 ),
+            EIllegalDataAddress
+        );
+    }
+
+    BOOST_AUTO_TEST_CASE( SilentSlaveTimesOutAndLinkRecovers )
+    {
+        proto_.RetryCount = 1;
+        proto_.ResponseTimeout = 100;
+        RegDataType v[1] = {};
+        BOOST_CHECK_THROW(
+            proto_.ReadHoldingRegisters( Context( RTU_SILENT_SLAVE ), 0, 1, v ),
+            EContextException );
+        proto_.ReadHoldingRegisters( Context( 1 ), 7, 1, v );
+        BOOST_TEST( v[0] == 7u );
+    }
+
+    BOOST_AUTO_TEST_CASE( BroadcastWriteDoesNotWaitForResponse )
+    {
+        proto_.ResponseTimeout = 2000;
+        proto_.BroadcastTurnaround = 50;
+        RegDataType const w[2] = { 0x5A5A, 0xA5A5 };
+        auto const t0 = std::chrono::steady_clock::now();
+        proto_.PresetMultipleRegisters(
+            Context( RTUFramingProtocol::BroadcastAddress ), 130, 2, w );
+        proto_.PresetSingleRegister(
+            Context( RTUFramingProtocol::BroadcastAddress ), 132, 0x1234 );
+        auto const elapsed = std::chrono::steady_clock::now() - t0;
+        BOOST_CHECK( elapsed >= std::chrono::milliseconds( 100 ) );
+        BOOST_CHECK( elapsed < std::chrono::milliseconds( 1000 ) );
+
+        RegDataType r[3] = {};
+        proto_.ReadHoldingRegisters( Context( 1 ), 130, 3, r );
+        BOOST_TEST( r[0] == 0x5A5Au );
+        BOOST_TEST( r[1] == 0xA5A5u );
+        BOOST_TEST( r[2] == 0x1234u );
+    }
+
+    BOOST_AUTO_TEST_CASE( BroadcastReadIsRejected )
+    {
+        proto_.ResponseTimeout = 2000;
+        RegDataType v[1] = {};
+        auto const t0 = std::chrono::steady_clock::now();
+        BOOST_CHECK_THROW(
+            proto_.ReadHoldingRegisters(
+                Context( RTUFramingProtocol::BroadcastAddress ), 0, 1, v ),
+            EContextException );
+        BOOST_CHECK( std::chrono::steady_clock::now() - t0 < std::chrono::milliseconds( 1000 ) );
+    }
+
+    BOOST_AUTO_TEST_CASE( TXEchoIsCheckedAndDiscarded )
+    {
+        proto_.CancelTXEcho = true;
+        RegDataType v[4] = {};
+        proto_.ReadHoldingRegisters( Context( RTU_ECHO_SLAVE ), 40, 4, v );
+        BOOST_TEST( v[0] == 40u );
+        BOOST_TEST( v[3] == 43u );
+        BOOST_CHECK_THROW(
+            proto_.ReadHoldingRegisters( Context( RTU_ECHO_SLAVE ), REG_COUNT, 1, v ),
+            EIllegalDataAddress );
+    }
+
+    BOOST_AUTO_TEST_CASE( CorruptedTXEchoIsReportedAsCollision )
+    {
+        proto_.CancelTXEcho = true;
+        proto_.RetryCount = 1;
+        RegDataType v[1] = {};
+        BOOST_CHECK_THROW(
+            proto_.ReadHoldingRegisters( Context( RTU_COLLIDING_SLAVE ), 0, 1, v ),
+            ERTUBusCollision );
+        proto_.ReadHoldingRegisters( Context( RTU_ECHO_SLAVE ), 9, 1, v );
+        BOOST_TEST( v[0] == 9u );
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//---------------------------------------------------------------------------
+// Modbus ASCII — the slave answers through the register bank of the server
+//---------------------------------------------------------------------------
+
+class LoopbackASCIIProtocol : public ASCIIProtocol {
+public:
+    std::string Noise;          // Sent before every response
+    bool        LowerCase  {};  // Answer with lower-case hex digits
+    bool        CorruptLRC {};
+    std::function<void( std::vector<uint8_t>& )> Tamper;   // Edits the response PDU
+    std::string LastRequest;
+    int         Writes     {};
+protected:
+    void DoOpen() override { open_ = true; }
+    void DoClose() override { open_ = false; }
+    bool DoIsConnected() const noexcept override { return open_; }
+    void DoInputBufferClear() override { rx_.clear(); }
+
+    void DoWrite( FrameCont const & TxChars ) override
+    {
+        ++Writes;
+        LastRequest.assign( TxChars.begin(), TxChars.end() );
+
+        // ':' + hex(address, PDU, LRC) + CR LF
+        std::vector<uint8_t> req;
+        for ( size_t i = 1; i + 3 < TxChars.size(); i += 2 )
+            req.push_back( static_cast<uint8_t>(
+                std::stoi( std::string( TxChars.begin() + i, TxChars.begin() + i + 2 ), nullptr, 16 ) ) );
+        uint8_t sum = 0;
+        for ( uint8_t b : req ) sum += b;
+        if ( sum != 0 ) return;  // bad LRC: a slave stays silent
+
+        std::vector<uint8_t> frame { req[0] };
+        auto pdu = dispatchPdu( req[1], req.data() + 2, static_cast<int>( req.size() ) - 3 );
+        if ( Tamper )
+            Tamper( pdu );
+        frame.insert( frame.end(), pdu.begin(), pdu.end() );
+        uint8_t lrc = 0;
+        for ( uint8_t b : frame ) lrc -= b;
+        frame.push_back( CorruptLRC ? static_cast<uint8_t>( lrc ^ 1 ) : lrc );
+
+        const char* digits = LowerCase ? "0123456789abcdef" : "0123456789ABCDEF";
+        rx_ = Noise + ":";
+        for ( uint8_t b : frame ) {
+            rx_ += digits[b >> 4];
+            rx_ += digits[b & 0x0F];
+        }
+        rx_ += "\r\n";
+    }
+
+    size_t DoRead( uint8_t* Buffer, size_t Length ) override
+    {
+        size_t n = std::min( Length, rx_.size() );
+        std::copy( rx_.begin(), rx_.begin() + n, Buffer );
+        rx_.erase( 0, n );
+        return n;
+    }
+private:
+    bool        open_ {};
+    std::string rx_;
+};
+
+struct ASCIIFixture {
+    ASCIIFixture() : session_( proto_ ) { initRegisters(); }
+    LoopbackASCIIProtocol proto_;
+    SessionManager        session_;
+};
+
+BOOST_FIXTURE_TEST_SUITE( ASCII_Protocol, ASCIIFixture )
+
+    BOOST_AUTO_TEST_CASE( RequestIsHexEncodedWithLRC )
+    {
+        RegDataType v[2] = {};
+        proto_.ReadHoldingRegisters( Context( 1 ), 0x10, 2, v );
+        // 01 03 0010 0002, LRC = -(0x16) = 0xEA
+        BOOST_TEST( proto_.LastRequest == ":010300100002EA\r\n" );
+        BOOST_TEST( v[0] == 0x10u );
+        BOOST_TEST( v[1] == 0x11u );
+    }
+
+    BOOST_AUTO_TEST_CASE( NoiseBeforeColonAndLowerCaseAreAccepted )
+    {
+        proto_.Noise = "\r\n?x:0";
+        proto_.LowerCase = true;
+        RegDataType v[20] = {};
+        proto_.ReadInputRegisters( Context( 1 ), 0, 20, v );
+        BOOST_TEST( v[0] == 0x1000u );
+        BOOST_TEST( v[19] == 0x1013u );
+        BOOST_TEST( proto_.Writes == 1 );
+    }
+
+    BOOST_AUTO_TEST_CASE( WriteThenReadBack )
+    {
+        RegDataType const w[3] = { 0xA1, 0xB2, 0xC3 };
+        proto_.PresetMultipleRegisters( Context( 1 ), 100, 3, w );
+        proto_.ForceSingleCoil( Context( 1 ), 4, true );
+        RegDataType r[3] = {};
+        proto_.ReadHoldingRegisters( Context( 1 ), 100, 3, r );
+        BOOST_TEST( r[0] == 0xA1u );
+        BOOST_TEST( r[2] == 0xC3u );
+        CoilDataType c[1] = {};
+        proto_.ReadCoilStatus( Context( 1 ), 4, 1, c );
+        BOOST_TEST( ( c[0] & 1 ) == 1 );
+    }
+
+    BOOST_AUTO_TEST_CASE( VariableLengthResponses )
+    {
+        RegDataType v[31] = {};
+        BOOST_TEST( proto_.ReadFIFOQueue( Context( 1 ), 0, v ) == 5u );
+        BOOST_TEST( v[4] == 0x104u );
+
+        FileSubRequest subs[2] = { { 1, 0, 2 }, { 2, 4, 3 } };
+        RegDataType data[5] = {};
+        proto_.ReadGeneralReference( Context( 1 ), subs, 2, data );
+        BOOST_TEST( data[1] == 0x0101u );
+        BOOST_TEST( data[2] == 0x0204u );
+
+        BOOST_TEST( proto_.FetchCommEventLog( Context( 1 ) ).Events.size() == 2u );
+        BOOST_TEST( proto_.ReportSlave( Context( 1 ) ).back() == 0xFFu );
+    }
+
+    BOOST_AUTO_TEST_CASE( FileRecordsAreCheckedOnBothSides )
+    {
+        // Sub-request lists that do not fit a PDU never reach the line
+        RegDataType data[130] = {};
+        std::vector<FileSubRequest> many( 40, FileSubRequest { 1, 0, 1 } );
+        FileSubRequest big { 1, 0, 130 };
+        BOOST_CHECK_THROW(
+            proto_.ReadGeneralReference( Context( 1 ), many.data(), 0, data ), EContextException );
+        BOOST_CHECK_THROW(
+            proto_.ReadGeneralReference( Context( 1 ), many.data(), many.size(), data ),
+            EContextException );
+        BOOST_CHECK_THROW(
+            proto_.WriteGeneralReference( Context( 1 ), &big, 1, data ), EContextException );
+        BOOST_TEST( proto_.Writes == 0 );
+
+        // A sub-response cut short by the slave
+        FileSubRequest sub { 1, 0, 2 };
+        proto_.Tamper = []( std::vector<uint8_t>& pdu ) { pdu.resize( 6 ); pdu[1] = 4; };
+        BOOST_CHECK_THROW(
+            proto_.ReadGeneralReference( Context( 1 ), &sub, 1, data ), EContextException );
+
+        // An FC21 response that does not echo the request
+        proto_.Tamper = []( std::vector<uint8_t>& pdu ) { pdu.back() ^= 1; };
+        BOOST_CHECK_THROW(
+            proto_.WriteGeneralReference( Context( 1 ), &sub, 1, data ), EContextException );
+        proto_.Tamper = nullptr;
+        proto_.WriteGeneralReference( Context( 1 ), &sub, 1, data );
+    }
+
+    BOOST_AUTO_TEST_CASE( DeviceIdentificationIsReadUpToTheTerminator )
+    {
+        DeviceIdentification id = proto_.ReadDeviceIdentification( Context( 1 ) );
+        BOOST_TEST( id.Objects.size() == 3u );
+        BOOST_TEST( id.Objects[1] == "AX-1000" );
+        BOOST_TEST( id.Objects[2] == "V2.11" );
+        BOOST_TEST( proto_.Writes == 2 );
+
+        id = proto_.ReadDeviceIdentification( Context( 1 ), ReadDeviceIdCode::Individual, 4 );
+        BOOST_TEST( id.Objects.size() == 1u );
+        BOOST_TEST( id.Objects[4] == "Axis controller" );
+    }
+
+    BOOST_AUTO_TEST_CASE( ExceptionResponseIsNotRetried )
+    {
+        RegDataType v[1] = {};
+        BOOST_CHECK_THROW(
+            proto_.ReadHoldingRegisters( Context( 1 ), REG_COUNT, 1, v ),
+            EIllegalDataAddress );
+        BOOST_TEST( proto_.Writes == 1 );
+    }
+
+    BOOST_AUTO_TEST_CASE( BadLRCIsRetriedThenReported )
+    {
+        proto_.CorruptLRC = true;
+        proto_.RetryCount = 2;
+        RegDataType v[1] = {};
+        BOOST_CHECK_THROW(
+            proto_.ReadHoldingRegisters( Context( 1 ), 0, 1, v ),
+            EContextException );
+        BOOST_TEST( proto_.Writes == 3 );
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//---------------------------------------------------------------------------
+// Slave discovery — units 0xE0-0xEF: 0xE3 and 0xE9 answer; on TCP the others
+// get exception 0Bh except 0xEC, which never answers; on the RTU gateway all
+// the others are silent.
+//---------------------------------------------------------------------------
+
+static std::vector<unsigned> foundAddresses( DeviceInventory const & inventory )
+{
+    std::vector<unsigned> addrs;
+    for ( auto const & device : inventory )
+        addrs.push_back( device.SlaveAddr );
+    return addrs;
+}
+
+BOOST_AUTO_TEST_SUITE( Slave_Discovery )
+
+    BOOST_AUTO_TEST_CASE( PipelinedScanOverTCP )
+    {
+        TCPProtocolWinSock proto( _D( "127.0.0.1" ), SERVER_PORT );
+        SessionManager session( proto );
+        SlaveScanner scanner( proto );
+        scanner.SetRange( SCAN_FIRST_UNIT, SCAN_LAST_UNIT );
+        scanner.SetReprobeCount( 1 );
+        BOOST_TEST( scanner.GetProbeTimeout() ==
+                    unsigned( MODBUS_SCAN_DEFAULT_NETWORK_ROUND_TRIP + MODBUS_SCAN_DEFAULT_TURNAROUND ) );
+
+        auto const started = std::chrono::steady_clock::now();
+        auto const inventory = scanner.Scan();
+        auto const elapsed = std::chrono::steady_clock::now() - started;
+        std::vector<unsigned> const expected { 0xE3, 0xE9 };
+        BOOST_TEST( foundAddresses( inventory ) == expected, boost::test_tools::per_element() );
+        // The silent unit waits 120 + 240 ms, not twice the 2 s response timeout
+        BOOST_CHECK( elapsed < std::chrono::milliseconds( 1500 ) );
+        for ( auto const & device : inventory ) {
+            BOOST_TEST( device.Pass == 0u );
+            BOOST_TEST( !device.ExceptionResponse );
+            BOOST_TEST( device.TimedProbes == 3u );
+            BOOST_CHECK( device.MinResponseTime <= device.AvgResponseTime );
+            BOOST_CHECK( device.AvgResponseTime <= device.MaxResponseTime );
+        }
+        BOOST_TEST( proto.IsConnected() );
+        BOOST_TEST( readH( proto, 7 ) == 7u );
+    }
+
+    BOOST_AUTO_TEST_CASE( SilentAddressesAreReprobedInOneBatch )
+    {
+        // Probes 2 and 3 (0xE2 absent, 0xE3 present) are lost on the way, 0xEC is
+        // swallowed by the server
+        LossyLink proto;
+        SessionManager session( proto );
+        proto.dropFrame = 2;
+        proto.dropCount = 2;
+        SlaveScanner scanner( proto );
+        scanner.SetRange( SCAN_FIRST_UNIT, SCAN_LAST_UNIT );
+        scanner.SetReprobeCount( 1 );
+        scanner.SetTimingSamples( 0 );
+
+        auto const started = std::chrono::steady_clock::now();
+        auto const inventory = scanner.Scan();
+        auto const elapsed = std::chrono::steady_clock::now() - started;
+
+        std::vector<unsigned> const expected { 0xE3, 0xE9 };
+        BOOST_TEST( foundAddresses( inventory ) == expected, boost::test_tools::per_element() );
+        BOOST_TEST( inventory[0].Pass == 1u );
+        BOOST_TEST( inventory[1].Pass == 0u );
+        // The second pass re-probes the three silent addresses in a single write
+        BOOST_TEST( proto.frames == 16 + 3 );
+        BOOST_TEST( proto.writeFrames.back() == 3 );
+        BOOST_CHECK( elapsed < std::chrono::milliseconds( 1500 ) );
+    }
+
+    BOOST_AUTO_TEST_CASE( ShortProbeTimeoutOverRTU )
+    {
+        RTUOverTCPProtocolWinSock proto( _D( "127.0.0.1" ), RTU_GATEWAY_PORT );
+        proto.RetryCount = 2;
+        SessionManager session( proto );
+        SlaveScanner scanner( proto, ProbeMethod::ReadHoldingRegisters );
+        scanner.SetRange( SCAN_FIRST_UNIT, SCAN_LAST_UNIT );
+        scanner.SetProbeAddress( 12 );
+        scanner.SetReprobeCount( 0 );
+        scanner.SetTimingSamples( 1 );
+        // No line speed: the network round trip replaces the line time
+        BOOST_TEST( scanner.GetProbeTimeout() ==
+                    unsigned( MODBUS_SCAN_DEFAULT_NETWORK_ROUND_TRIP + MODBUS_SCAN_DEFAULT_TURNAROUND ) );
+
+        auto const started = std::chrono::steady_clock::now();
+        auto const inventory = scanner.Scan();
+        auto const elapsed = std::chrono::steady_clock::now() - started;
+
+        std::vector<unsigned> const expected { 0xE3, 0xE9 };
+        BOOST_TEST( foundAddresses( inventory ) == expected, boost::test_tools::per_element() );
+        BOOST_CHECK( elapsed < std::chrono::seconds( 5 ) );  // 14 silent units, no retries
+        BOOST_TEST( proto.RetryCount == 2 );                  // settings restored
+        BOOST_TEST( proto.GetResponseTimeout() == MODBUS_RTU_DEFAULT_TIMEOUT );
+    }
+
+    BOOST_AUTO_TEST_CASE( ReprobeStretchesTheTimeout )
+    {
+        // The gateway needs about 50 ms: a 5 ms probe misses everything at first
+        RTUOverTCPProtocolWinSock proto( _D( "127.0.0.1" ), RTU_GATEWAY_PORT );
+        SessionManager session( proto );
+        SlaveScanner scanner( proto );
+        scanner.SetRange( SCAN_FIRST_UNIT, SCAN_LAST_UNIT );
+        scanner.SetNetworkRoundTrip( 0 );
+        scanner.SetTurnaround( 5 );
+        scanner.SetReprobeCount( 5 );
+
+        auto const inventory = scanner.Scan();
+        std::vector<unsigned> const expected { 0xE3, 0xE9 };
+        BOOST_TEST( foundAddresses( inventory ) == expected, boost::test_tools::per_element() );
+        for ( auto const & device : inventory )
+            BOOST_TEST( device.Pass > 0u );
+    }
+
+    BOOST_AUTO_TEST_CASE( MeasuredRoundTripRaisesTheProbeTimeout )
+    {
+        RTUOverTCPProtocolWinSock proto( _D( "127.0.0.1" ), RTU_GATEWAY_PORT );
+        proto.SetAdaptiveTimeout( true );
+        SessionManager session( proto );
+        SlaveScanner scanner( proto );
+        scanner.SetRange( SCAN_FIRST_UNIT, SCAN_LAST_UNIT );
+        scanner.SetNetworkRoundTrip( 0 );
+        scanner.SetTurnaround( 5 );
+        BOOST_TEST( scanner.GetProbeTimeout() == 5u );
+
+        // The gateway answers in about 30 ms
+        for ( int i = 0; i < 3; ++i ) {
+            RegDataType v {};
+            proto.ReadHoldingRegisters( Context( 0xE3 ), 12, 1, &v );
+        }
+        BOOST_TEST( scanner.GetProbeTimeout() >= 35u );
+
+        auto const inventory = scanner.Scan();
+        std::vector<unsigned> const expected { 0xE3, 0xE9 };
+        BOOST_TEST( foundAddresses( inventory ) == expected, boost::test_tools::per_element() );
+        for ( auto const & device : inventory )
+            BOOST_TEST( device.Pass == 0u );
+    }
+
+    BOOST_AUTO_TEST_CASE( InvalidRangeIsRejected )
+    {
+        TCPProtocolWinSock proto( _D( "127.0.0.1" ), SERVER_PORT );
+        SlaveScanner scanner( proto );
+        BOOST_CHECK_THROW( scanner.SetRange( 0, 10 ), EBaseException );
+        BOOST_CHECK_THROW( scanner.SetRange( 20, 10 ), EBaseException );
+        BOOST_CHECK_THROW( (void)scanner.Scan(), EBaseException );  // not open
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//---------------------------------------------------------------------------
+// Transaction policies — per-call and per-slave timeout, retries and backoff
+//---------------------------------------------------------------------------
+
+static TransactionPolicy makePolicy( unsigned timeout, int retries, unsigned backoff = 0 )
+{
+    TransactionPolicy policy;
+    policy.Timeout = timeout;
+    policy.RetryCount = retries;
+    if ( backoff )
+        policy.Backoff = backoff;
+    return policy;
+}
+
+BOOST_AUTO_TEST_SUITE( Transaction_Policy )
+
+    BOOST_AUTO_TEST_CASE( CallPolicyOverridesSlavePolicy )
+    {
+        TCPProtocolWinSock proto( _D( "127.0.0.1" ), SERVER_PORT );
+        proto.SetSlavePolicy( 5, makePolicy( 300, 2, 10 ) );
+
+        TransactionPolicy call;
+        call.Timeout = 50;
+        TransactionPolicy const merged = proto.GetEffectivePolicy( Context( 5, call ) );
+        BOOST_TEST( merged.Timeout.value() == 50u );
+        BOOST_TEST( merged.RetryCount.value() == 2 );
+        BOOST_TEST( merged.Backoff.value() == 10u );
+        BOOST_TEST( !merged.Priority.has_value() );
+
+        BOOST_TEST( !proto.GetEffectivePolicy( Context( 6 ) ).Timeout.has_value() );
+        proto.ClearSlavePolicy( 5 );
+        BOOST_TEST( !proto.GetEffectivePolicy( Context( 5 ) ).RetryCount.has_value() );
+    }
+
+    BOOST_AUTO_TEST_CASE( SlavePolicyShortensTheTimeoutOverTCP )
+    {
+        TCPProtocolWinSock proto( _D( "127.0.0.1" ), SERVER_PORT );
+        SessionManager session( proto );
+        proto.SetSlavePolicy( SCAN_SILENT_UNIT, makePolicy( 100, 1, 50 ) );
+
+        RegDataType v[1] = {};
+        auto const started = std::chrono::steady_clock::now();
+        BOOST_CHECK_THROW(
+            proto.ReadHoldingRegisters( Context( SCAN_SILENT_UNIT ), 0, 1, v ),
+            EBaseException );
+        auto const elapsed = std::chrono::steady_clock::now() - started;
+        BOOST_CHECK( elapsed >= std::chrono::milliseconds( 250 ) );  // two attempts and a pause
+        BOOST_CHECK( elapsed < std::chrono::milliseconds( MODBUS_TCP_IP_DEFAULT_RESPONSE_TIMEOUT ) );
+
+        // The other units keep the default timeout
+        BOOST_TEST( readH( proto, 7 ) == 7u );
+    }
+
+    BOOST_AUTO_TEST_CASE( RequestPolicyAppliesToBatchItems )
+    {
+        RTUOverTCPProtocolWinSock proto( _D( "127.0.0.1" ), RTU_GATEWAY_PORT );
+        SessionManager session( proto );
+
+        RegDataType v[2] = {};
+        Request reqs[] = {
+            Request::ReadHoldingRegisters( RTU_SILENT_SLAVE, 0, 1, &v[0] ),
+            Request::ReadHoldingRegisters( 1, 7, 1, &v[1] ),
+        };
+        reqs[0].Policy = makePolicy( 100, 0 );
+
+        auto const started = std::chrono::steady_clock::now();
+        BOOST_TEST( proto.Execute( reqs, 2 ) == 1u );
+        auto const elapsed = std::chrono::steady_clock::now() - started;
+        BOOST_CHECK( reqs[0].Status == RequestStatus::Failed );
+        BOOST_CHECK( elapsed < std::chrono::milliseconds( MODBUS_RTU_OVER_IP_DEFAULT_RESPONSE_TIMEOUT ) );
+        BOOST_TEST( v[1] == 7u );
+    }
+
+    BOOST_AUTO_TEST_CASE( LateRepliesAreSkippedOverTCP )
+    {
+        TCPProtocolWinSock proto( _D( "127.0.0.1" ), SERVER_PORT );
+        SessionManager session( proto );
+
+        RegDataType v[3] = {};
+        BOOST_CHECK_THROW(
+            proto.ReadHoldingRegisters( Context( LATE_UNIT, makePolicy( 50, 0 ) ), 0, 1, v ),
+            EBaseException );
+        // The late reply reaches the master ahead of the answer to this request
+        proto.ReadHoldingRegisters( Context( 1 ), 7, 1, v );
+        BOOST_TEST( v[0] == 7u );
+
+        Request late[] = { Request::ReadHoldingRegisters( LATE_UNIT, 0, 1, &v[0] ) };
+        late[0].Policy = makePolicy( 50, 0 );
+        BOOST_TEST( proto.Execute( late, 1 ) == 0u );
+        Request next[] = {
+            Request::ReadHoldingRegisters( 1, 8, 1, &v[1] ),
+            Request::ReadHoldingRegisters( 1, 9, 1, &v[2] ),
+        };
+        BOOST_TEST( proto.Execute( next, 2 ) == 2u );
+        BOOST_TEST( v[1] == 8u );
+        BOOST_TEST( v[2] == 9u );
+    }
+
+    BOOST_AUTO_TEST_CASE( PolicyRetryCountOverridesTheProtocol )
+    {
+        LoopbackASCIIProtocol proto;
+        SessionManager session( proto );
+        proto.CorruptLRC = true;
+        proto.RetryCount = 3;
+        RegDataType v[1] = {};
+
+        BOOST_CHECK_THROW(
+            proto.ReadHoldingRegisters( Context( 1, makePolicy( 10, 0 ) ), 0, 1, v ),
+            EContextException );
+        BOOST_TEST( proto.Writes == 1 );
+
+        proto.SetSlavePolicy( 1, makePolicy( 10, 5 ) );
+        BOOST_CHECK_THROW(
+            proto.ReadHoldingRegisters( Context( 1 ), 0, 1, v ),
+            EContextException );
+        BOOST_TEST( proto.Writes == 7 );
+    }
+
+    BOOST_AUTO_TEST_CASE( EstimatorFollowsJacobsonKarels )
+    {
+        using std::chrono::milliseconds;
+        RoundTripEstimator rtt;
+        BOOST_TEST( rtt.GetTimeout( 20, 1000 ) == 1000u );   // no samples yet
+
+        rtt.AddSample( milliseconds( 100 ) );                // SRTT 100, RTTVAR 50
+        BOOST_TEST( rtt.GetTimeout( 20, 1000 ) == 300u );
+        rtt.AddSample( milliseconds( 200 ) );                // SRTT 112.5, RTTVAR 62.5
+        BOOST_CHECK( rtt.GetSmoothedRoundTrip() == std::chrono::microseconds( 112500 ) );
+        BOOST_TEST( rtt.GetTimeout( 20, 1000 ) == 363u );
+
+        rtt.AddTimeout();
+        BOOST_TEST( rtt.GetTimeout( 20, 1000 ) == 725u );
+        rtt.AddTimeout();
+        BOOST_TEST( rtt.GetTimeout( 20, 1000 ) == 1000u );   // clamped
+        rtt.AddSample( milliseconds( 112 ) );                 // backoff cleared
+        BOOST_TEST( rtt.GetTimeout( 20, 1000 ) < 400u );
+
+        TCPProtocolWinSock proto( _D( "127.0.0.1" ), SERVER_PORT );
+        BOOST_CHECK_THROW( proto.SetAdaptiveTimeoutBounds( 0, 100 ), EBaseException );
+        BOOST_CHECK_THROW( proto.SetAdaptiveTimeoutBounds( 200, 100 ), EBaseException );
+    }
+
+    BOOST_AUTO_TEST_CASE( AdaptiveTimeoutLearnsOverTCP )
+    {
+        TCPProtocolWinSock proto( _D( "127.0.0.1" ), SERVER_PORT );
+        SessionManager session( proto );
+        proto.SetAdaptiveTimeout( true );
+        proto.SetAdaptiveTimeoutBounds( 50, 1500 );
+        BOOST_TEST( proto.GetEffectivePolicy( Context( 1 ) ).Timeout.value() == 1500u );
+
+        for ( int i = 0; i < 8; ++i )
+            BOOST_TEST( readH( proto, 7 ) == 7u );
+
+        RegDataType v[4] = {};
+        Request reqs[] = {
+            Request::ReadHoldingRegisters( 1, 1, 1, &v[0] ),
+            Request::ReadHoldingRegisters( 1, 2, 1, &v[1] ),
+            Request::ReadHoldingRegisters( 1, 3, 1, &v[2] ),
+            Request::ReadHoldingRegisters( 1, 4, 1, &v[3] ),
+        };
+        BOOST_TEST( proto.Execute( reqs, 4 ) == 4u );
+
+        RoundTripEstimator const * const rtt = proto.GetRoundTripEstimator( 1 );
+        BOOST_REQUIRE( rtt != nullptr );
+        BOOST_TEST( rtt->GetSampleCount() == 12u );
+        // A loopback server answers in far less than the upper bound
+        BOOST_TEST( proto.GetEffectivePolicy( Context( 1 ) ).Timeout.value() < 1500u );
+        BOOST_TEST( proto.GetRoundTripEstimator( 2 ) == nullptr );
+
+        // An explicit timeout still wins
+        BOOST_TEST( proto.GetEffectivePolicy( Context( 1, makePolicy( 700, 0 ) ) ).Timeout.value() == 700u );
+    }
+
+    BOOST_AUTO_TEST_CASE( AdaptiveTimeoutLearnsOverRTU )
+    {
+        RTUOverTCPProtocolWinSock proto( _D( "127.0.0.1" ), RTU_GATEWAY_PORT );
+        SessionManager session( proto );
+        proto.SetAdaptiveTimeout( true );
+        proto.SetAdaptiveTimeoutBounds( 20, 1000 );
+
+        RegDataType v[1] = {};
+        for ( int i = 0; i < 5; ++i ) {
+            proto.ReadHoldingRegisters( Context( 1 ), 7, 1, v );
+            BOOST_TEST( v[0] == 7u );
+        }
+        RoundTripEstimator const * const rtt = proto.GetRoundTripEstimator( 1 );
+        BOOST_REQUIRE( rtt != nullptr );
+        BOOST_TEST( rtt->GetSampleCount() == 5u );
+        BOOST_CHECK( rtt->GetSmoothedRoundTrip() > std::chrono::microseconds( 0 ) );
+
+        unsigned const learned = proto.GetEffectivePolicy( Context( 1 ) ).Timeout.value();
+        BOOST_TEST( learned >= 20u );
+        BOOST_TEST( learned <= 1000u );
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//---------------------------------------------------------------------------
+// Device profile cache
+//---------------------------------------------------------------------------
+
+static std::wstring profileFile()
+{
+    return ( std::filesystem::temp_directory_path() / "ModbusTestProfiles.ini" ).wstring();
+}
+
+BOOST_FIXTURE_TEST_SUITE( Device_Profile, ProtoFixture )
+
+    BOOST_AUTO_TEST_CASE( IdentifiedProfileSurvivesSaveAndLoad )
+    {
+        DeviceProfile profile = IdentifyDevice( proto_, 1 );
+        BOOST_TEST( profile.VendorName == "Acme Automation" );
+        BOOST_TEST( profile.ProductCode == "AX-1000" );
+        BOOST_TEST( profile.Revision == "V2.11" );
+        BOOST_TEST( profile.ResponseTime.count() > 0 );
+        BOOST_TEST( profile.Supports( FunctionCode::EncapsulatedInterfaceTransport ) );
+        BOOST_TEST( !profile.Supports( FunctionCode::ReadFIFOQueue ) );
+
+        profile.MaxRegisterCount = 60;
+        profile.FunctionCodes.insert( FunctionCode::ReadHoldingRegisters );
+        profile.WordOrder = DataConv::WordOrder::CDAB;
+        DeviceProfile other;
+        other.Endpoint = "gateway:502";
+        other.SlaveAddr = 7;
+        other.VendorName = "Line\nbreak\nand \\ slash";
+        other.MaxCoilCount = 800;
+
+        DeviceProfileCache cache;
+        cache.Store( profile );
+        cache.Store( other );
+        std::wstring const file = profileFile();
+        cache.Save( String( file.c_str() ) );
+
+        DeviceProfileCache loaded;
+        BOOST_TEST( loaded.Load( String( file.c_str() ) ) );
+        std::filesystem::remove( file );
+        BOOST_TEST( loaded.GetCount() == 2u );
+
+        DeviceProfile const * p = loaded.Find( proto_, 1 );
+        BOOST_REQUIRE( p );
+        BOOST_TEST( p->VendorName == profile.VendorName );
+        BOOST_TEST( p->MaxRegisterCount.value_or( 0 ) == 60u );
+        BOOST_TEST( !p->MaxCoilCount );
+        BOOST_TEST( p->FunctionCodes == profile.FunctionCodes );
+        BOOST_CHECK( p->WordOrder == DataConv::WordOrder::CDAB );
+        BOOST_TEST( p->ResponseTime.count() == profile.ResponseTime.count() );
+
+        p = loaded.Find( "gateway:502", 7 );
+        BOOST_REQUIRE( p );
+        BOOST_TEST( p->VendorName == other.VendorName );
+        BOOST_TEST( p->FunctionCodes.empty() );
+        BOOST_TEST( p->Supports( FunctionCode::ReadFIFOQueue ) );
+        BOOST_TEST( !loaded.Find( "gateway:502", 1 ) );
+
+        // No file yet: nothing cached, nothing thrown
+        BOOST_TEST( !loaded.Load( String( file.c_str() ) ) );
+        BOOST_TEST( loaded.GetCount() == 0u );
+    }
+
+    BOOST_AUTO_TEST_CASE( LimitsBecomeSlavePolicies )
+    {
+        TransactionPolicy timeout;
+        timeout.Timeout = 250;
+        proto_.SetSlavePolicy( 1, timeout );
+
+        DeviceProfileCache cache;
+        DeviceProfile profile;
+        profile.Endpoint = UTF8String( proto_.GetProtocolParamsStr() ).c_str();
+        profile.SlaveAddr = 1;
+        profile.MaxRegisterCount = 10;
+        cache.Store( profile );
+        profile.SlaveAddr = 2;
+        profile.MaxRegisterCount = 20;
+        cache.Store( profile );
+        profile.Endpoint = "elsewhere:502";
+        profile.SlaveAddr = 3;
+        cache.Store( profile );
+
+        BOOST_TEST( cache.ApplyPolicies( proto_ ) == 2u );
+        TransactionPolicy const policy = proto_.GetSlavePolicy( 1 );
+        BOOST_TEST( policy.MaxRegisterCount.value_or( 0 ) == 10u );
+        BOOST_TEST( policy.Timeout.value_or( 0 ) == 250u );
+        BOOST_TEST( proto_.GetSlavePolicy( 2 ).MaxRegisterCount.value_or( 0 ) == 20u );
+        BOOST_TEST( !proto_.GetSlavePolicy( 3 ).MaxRegisterCount );
+
+        // Range reads use the cached limit
+        std::vector<RegDataType> regs( 25 );
+        proto_.ReadHoldingRegisterRange( Context( 1 ), 0, regs.size(), regs.data() );
+        BOOST_TEST( regs[24] == 24u );
+    }
+
+    BOOST_AUTO_TEST_CASE( MalformedFileIsRejected )
+    {
+        std::wstring const file = profileFile();
+        {
+            std::ofstream out( std::filesystem::path( file ), std::ios::binary );
+            out << "[Device]\nEndpoint=a:502\nUnit=1\nMaxRegisterCount=lots\n";
+        }
+        DeviceProfileCache cache;
+        BOOST_CHECK_THROW( cache.Load( String( file.c_str() ) ), EBaseException );
+        BOOST_TEST( cache.GetCount() == 0u );
+        {
+            // Unit 257 would wrap to unit 1
+            std::ofstream out( std::filesystem::path( file ), std::ios::binary );
+            out << "[Device]\nEndpoint=a:502\nUnit=257\n";
+        }
+        BOOST_CHECK_THROW( cache.Load( String( file.c_str() ) ), EBaseException );
+        BOOST_TEST( cache.GetCount() == 0u );
+        std::filesystem::remove( file );
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//---------------------------------------------------------------------------
+// Health monitor — another master is emulated by bumping the server's event counter
+//---------------------------------------------------------------------------
+
+struct NoEventCounter : DummyProtocol {
+protected:
+    CommEventCounter DoFetchCommEventCtr( Context const & Context ) override
+    {
+        RaiseStandardException( Context, ExceptionCode::IllegalFunction );
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE( Health_Monitor, ProtoFixture )
+
+    BOOST_AUTO_TEST_CASE( OnlyChangedDevicesAreScanned )
+    {
+        HealthMonitor monitor( proto_ );
+        monitor.AddDevice( 1 );
+        BOOST_TEST( monitor.Poll().size() == 1u );       // first answer
+        BOOST_TEST( monitor.Poll().empty() );
+
+        // The data scan of this master is acknowledged, a foreign write is not
+        RegDataType v[4] = {};
+        proto_.ReadHoldingRegisters( ctx( 1 ), 0, 4, v );
+        monitor.Acknowledge( 1, 1 );
+        BOOST_TEST( monitor.Poll().empty() );
+        ++commEventCount;
+        std::vector<Context::SlaveAddrType> changed = monitor.Poll();
+        BOOST_REQUIRE( changed.size() == 1u );
+        BOOST_TEST( changed[0] == 1u );
+        BOOST_TEST( monitor.Poll().empty() );
+
+        DeviceHealth const * health = monitor.GetDevice( 1 );
+        BOOST_REQUIRE( health );
+        BOOST_TEST( health->Online );
+        BOOST_TEST( health->Supported );
+        BOOST_TEST( health->EventCount.value() == commEventCount.load() );
+    }
+
+    BOOST_AUTO_TEST_CASE( SilentDeviceGoesOfflineAndComesBack )
+    {
+        HealthMonitor monitor( proto_ );
+        monitor.AddDevice( SCAN_FIRST_UNIT );   // gateway exception: nothing behind it
+        monitor.AddDevice( 1 );
+        BOOST_TEST( monitor.Poll().size() == 1u );
+        DeviceHealth const * health = monitor.GetDevice( SCAN_FIRST_UNIT );
+        BOOST_TEST( !health->Online );
+        BOOST_TEST( health->FailedPolls == 1u );
+        BOOST_TEST( monitor.Poll().empty() );
+        BOOST_TEST( health->FailedPolls == 2u );
+        BOOST_TEST( !health->EventCount );
+    }
+
+    BOOST_AUTO_TEST_CASE( SilentUnitInPipelinedBatchChargesOnlyItself )
+    {
+        // A window of two: the late unit, silent within the timeout, holds back the
+        // answer of the poll sent with it; the last two polls go out after the timeout
+        proto_.SetPipelineDepth( 2 );
+        HealthMonitor monitor( proto_ );
+        monitor.SetPolicy( makePolicy( 100, 0 ) );
+        Context::SlaveAddrType const units[] = { 1, 2, LATE_UNIT, 0xF1, 0xF2, 0xF3 };
+        for ( Context::SlaveAddrType unit : units )
+            monitor.AddDevice( unit );
+        BOOST_TEST( monitor.Poll().size() == 5u );
+        BOOST_TEST( monitor.Poll().empty() );
+
+        for ( Context::SlaveAddrType unit : units ) {
+            if ( unit == LATE_UNIT )
+                continue;
+            DeviceHealth const * health = monitor.GetDevice( unit );
+            BOOST_TEST( health->Online );
+            BOOST_TEST( health->FailedPolls == 0u );
+        }
+        DeviceHealth const * late = monitor.GetDevice( LATE_UNIT );
+        BOOST_TEST( !late->Online );
+        BOOST_TEST( late->FailedPolls == 2u );
+        BOOST_TEST( !late->LastError.IsEmpty() );
+    }
+
+    BOOST_AUTO_TEST_CASE( DeviceWithoutFC11IsAlwaysScanned )
+    {
+        NoEventCounter proto;
+        SessionManager session( proto );
+        HealthMonitor monitor( proto );
+        monitor.AddDevice( 3 );
+        BOOST_TEST( monitor.Poll().size() == 1u );
+        BOOST_TEST( monitor.Poll().size() == 1u );
+        BOOST_TEST( monitor.GetDevice( 3 )->Online );
+        BOOST_TEST( !monitor.GetDevice( 3 )->Supported );
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//---------------------------------------------------------------------------
+
+static std::wstring tagFile()
+{
+    return ( std::filesystem::temp_directory_path() / "ModbusTestTags.csv" ).wstring();
+}
+
+static TagDefinition makeTag( std::string name, uint8_t slave, TagTable table, uint16_t addr,
+                              ChangeDetect::TagType type )
+{
+    TagDefinition tag;
+    tag.Name = name;
+    tag.SlaveAddr = slave;
+    tag.Table = table;
+    tag.Addr = addr;
+    tag.Type = type;
+    return tag;
+}
+
+BOOST_FIXTURE_TEST_SUITE( Tag_Database, ProtoFixture )
+
+    BOOST_AUTO_TEST_CASE( LoadValidatesDefinitions )
+    {
+        std::wstring const file = tagFile();
+        {
+            std::ofstream out( std::filesystem::path( file ), std::ios::binary );
+            out << "# Name, Unit, Table, Address, Type, WordOrder, Scale, Offset, Deadband\r\n"
+                   "\r\n"
+                   "Boiler.Temp, 1, HoldingRegister, 40, Float32, CDAB, 1, 0, 0.5\r\n"
+                   "Boiler.Level,1,InputRegister,10,UInt16,,0.1,-5,2%\r\n"
+                   "Boiler.Pump, 1, Coil, 5, Bit\r\n";
+        }
+        TagDatabase db;
+        db.Load( String( file.c_str() ) );
+        BOOST_TEST( db.GetCount() == 3u );
+
+        auto const temp = db.IndexOf( "Boiler.Temp" );
+        BOOST_REQUIRE( temp );
+        BOOST_CHECK( db.GetTag( *temp ).Order == DataConv::WordOrder::CDAB );
+        BOOST_CHECK( db.GetTag( *temp ).Deadband == ChangeDetect::DeadbandType::Absolute );
+        auto const level = db.IndexOf( "Boiler.Level" );
+        BOOST_REQUIRE( level );
+        BOOST_CHECK( db.GetTag( *level ).Table == TagTable::InputRegister );
+        BOOST_TEST( db.GetTag( *level ).Scale == 0.1 );
+        BOOST_TEST( db.GetTag( *level ).Offset == -5.0 );
+        BOOST_CHECK( db.GetTag( *level ).Deadband == ChangeDetect::DeadbandType::Percent );
+        BOOST_TEST( db.GetTag( *level ).DeadbandValue == 2.0 );
+        BOOST_TEST( !db.IndexOf( "Boiler.Fan" ) );
+
+        // A duplicate name rejects the whole file
+        {
+            std::ofstream out( std::filesystem::path( file ), std::ios::app | std::ios::binary );
+            out << "Boiler.Pump, 2, Coil, 6, Bit\r\n";
+        }
+        BOOST_CHECK_THROW( db.Load( String( file.c_str() ) ), EBaseException );
+        BOOST_TEST( db.GetCount() == 0u );
+        std::filesystem::remove( file );
+
+        BOOST_CHECK_THROW(
+            db.Add( makeTag( "Word", 1, TagTable::Coil, 0, ChangeDetect::TagType::UInt16 ) ),
+            EBaseException
+        );
+        BOOST_CHECK_THROW(
+            db.Add( makeTag( "Last", 1, TagTable::HoldingRegister, 0xFFFF,
+                             ChangeDetect::TagType::Float32 ) ),
+            EBaseException
+        );
+    }
+
+    BOOST_AUTO_TEST_CASE( ScanDecodesPackedBlocks )
+    {
+        float const temp = 21.5f;
+        RegDataType regs[2];
+        DataConv::ToRegisters( &temp, 1, regs, DataConv::WordOrder::CDAB );
+        proto_.PresetMultipleRegisters( ctx(), 40, 2, regs );
+        proto_.PresetSingleRegister( ctx(), 44, 0xFFFB );
+
+        TagDatabase db;
+        TagDefinition tag = makeTag( "Temp", 1, TagTable::HoldingRegister, 40,
+                                     ChangeDetect::TagType::Float32 );
+        tag.Order = DataConv::WordOrder::CDAB;
+        size_t const tempIdx = db.Add( tag );
+        size_t const aIdx =
+            db.Add( makeTag( "A", 1, TagTable::HoldingRegister, 42, ChangeDetect::TagType::UInt16 ) );
+        tag = makeTag( "B", 1, TagTable::HoldingRegister, 43, ChangeDetect::TagType::UInt16 );
+        tag.Scale = 0.5;
+        tag.Offset = 1.0;
+        size_t const bIdx = db.Add( tag );
+        size_t const cIdx =
+            db.Add( makeTag( "C", 1, TagTable::HoldingRegister, 44, ChangeDetect::TagType::Int16 ) );
+        size_t const farIdx =
+            db.Add( makeTag( "Far", 1, TagTable::HoldingRegister, 60, ChangeDetect::TagType::UInt16 ) );
+        tag = makeTag( "Level", 1, TagTable::InputRegister, 10, ChangeDetect::TagType::UInt16 );
+        tag.Scale = 0.1;
+        size_t const levelIdx = db.Add( tag );
+        size_t coilIdx[4];
+        for ( uint16_t i = 0 ; i < 4 ; ++i ) {
+            coilIdx[i] = db.Add(
+                makeTag( "Coil" + std::to_string( i ), 1, TagTable::Coil,
+                         static_cast<uint16_t>( 4 + i ), ChangeDetect::TagType::Bit )
+            );
+        }
+
+        TagScanner scanner( proto_, db );
+        BOOST_TEST( scanner.GetBlockCount() == 4u );   // 40..44, 60, input 10, coils 4..7
+        BOOST_TEST( scanner.GetRunCount() == 6u );     // Temp, A+B, C, Far, Level, coils
+
+        BOOST_TEST( scanner.Scan() == db.GetCount() );
+        BOOST_TEST( scanner.GetFailedBlockCount() == 0u );
+        BOOST_TEST( scanner.GetValue( tempIdx ) == 21.5 );
+        BOOST_TEST( scanner.GetValue( aIdx ) == 42.0 );
+        BOOST_TEST( scanner.GetValue( bIdx ) == 22.5 );
+        BOOST_TEST( scanner.GetValue( cIdx ) == -5.0 );
+        BOOST_TEST( scanner.GetValue( farIdx ) == 60.0 );
+        BOOST_TEST( scanner.GetValue( levelIdx ) == 410.6, boost::test_tools::tolerance( 1e-9 ) );
+        for ( uint16_t i = 0 ; i < 4 ; ++i ) {
+            BOOST_TEST( scanner.GetValue( coilIdx[i] ) == static_cast<double>( i & 1 ) );
+        }
+
+        BOOST_TEST( scanner.Scan() == 0u );
+        proto_.PresetSingleRegister( ctx(), 42, 100 );
+        BOOST_REQUIRE( scanner.Scan() == 1u );
+        BOOST_TEST( scanner.GetChanges()[0].TagIndex == aIdx );
+        BOOST_TEST( scanner.GetChanges()[0].Value == 100.0 );
+    }
+
+    BOOST_AUTO_TEST_CASE( DeadbandsAndFailedBlocks )
+    {
+        TagDatabase db;
+        TagDefinition tag =
+            makeTag( "Abs", 1, TagTable::HoldingRegister, 50, ChangeDetect::TagType::UInt16 );
+        tag.Deadband = ChangeDetect::DeadbandType::Absolute;
+        tag.DeadbandValue = 10.0;
+        size_t const absIdx = db.Add( tag );
+        tag = makeTag( "Pct", 1, TagTable::HoldingRegister, 51, ChangeDetect::TagType::UInt16 );
+        tag.Deadband = ChangeDetect::DeadbandType::Percent;
+        tag.DeadbandValue = 10.0;
+        size_t const pctIdx = db.Add( tag );
+        size_t const goneIdx = db.Add(
+            makeTag( "Gone", SCAN_FIRST_UNIT, TagTable::HoldingRegister, 0,
+                     ChangeDetect::TagType::UInt16 )
+        );
+
+        TransactionPolicy limits;
+        limits.MaxRegisterCount = 1;
+        proto_.SetSlavePolicy( 1, limits );
+        TagScanner scanner( proto_, db );
+        BOOST_TEST( scanner.GetBlockCount() == 3u );
+
+        BOOST_TEST( scanner.Scan() == 2u );
+        BOOST_TEST( scanner.GetFailedBlockCount() == 1u );
+        BOOST_TEST( !scanner.IsValid( goneIdx ) );
+        BOOST_TEST( scanner.IsValid( absIdx ) );
+
+        proto_.PresetSingleRegister( ctx(), 50, 55 );   // within 10
+        proto_.PresetSingleRegister( ctx(), 51, 57 );   // beyond 10% of 51
+        BOOST_REQUIRE( scanner.Scan() == 1u );
+        BOOST_TEST( scanner.GetChanges()[0].TagIndex == pctIdx );
+
+        proto_.PresetSingleRegister( ctx(), 50, 61 );   // beyond 10 from the reported 50
+        BOOST_REQUIRE( scanner.Scan() == 1u );
+        BOOST_TEST( scanner.GetChanges()[0].TagIndex == absIdx );
+        BOOST_TEST( scanner.GetValue( absIdx ) == 61.0 );
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//---------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_SUITE( Process_Image, ProtoFixture )
+
+    BOOST_AUTO_TEST_CASE( ReaderSeesConsistentBlocks )
+    {
+        std::vector<ProcessImageBlock> layout {
+            { 1, FunctionCode::ReadHoldingRegisters, 100, 8 },
+            { 2, FunctionCode::ReadCoilStatus, 0, 10 },
+        };
+        ProcessImageWriter writer( _D( "ModbusTest.ProcessImage.Blocks" ), layout );
+        ProcessImageReader reader( _D( "ModbusTest.ProcessImage.Blocks" ) );
+        BOOST_REQUIRE( reader.GetBlockCount() == 2u );
+        BOOST_TEST( reader.GetBlock( 0 ).Addr == 100u );
+        BOOST_TEST( reader.GetBlock( 1 ).PointCount == 10u );
+        BOOST_TEST( reader.GetBlock( 1 ).IsBits() );
+        BOOST_CHECK_THROW( ProcessImageReader( _D( "ModbusTest.ProcessImage.None" ) ),
+                           EBaseException );
+
+        RegDataType regs[8] {};
+        ProcessImageBlockState state;
+        BOOST_REQUIRE( reader.Read( 0, regs, state ) );
+        BOOST_TEST( !state.Valid );
+        BOOST_TEST( state.Sequence == 0u );
+
+        RegDataType const written[8] { 1, 2, 3, 4, 5, 6, 7, 8 };
+        writer.Write( 0, written );
+        BOOST_TEST( reader.GetSequence( 0 ) == 2u );
+        BOOST_REQUIRE( reader.Read( 0, regs, state ) );
+        BOOST_TEST( state.Valid );
+        BOOST_TEST( std::equal( regs, regs + 8, written ) );
+        writer.Invalidate( 0 );
+        BOOST_REQUIRE( reader.Read( 0, regs, state ) );
+        BOOST_TEST( !state.Valid );
+        BOOST_TEST( state.Sequence == 4u );
+        BOOST_TEST( regs[7] == 8u );   // Last data kept
+
+        CoilDataType const bits[2] { 0xA5, 0x03 };
+        CoilDataType readBits[2] {};
+        BOOST_CHECK_THROW( writer.Write( 1, written ), EBaseException );
+        writer.Write( 1, bits );
+        BOOST_REQUIRE( reader.Read( 1, readBits, state ) );
+        BOOST_TEST( readBits[0] == 0xA5u );
+        BOOST_TEST( readBits[1] == 0x03u );
+        BOOST_TEST( reader.GetSequence( 0 ) == 4u );
+
+        // Every snapshot holds the registers of a single update
+        RegDataType const zeros[8] {};
+        writer.Write( 0, zeros );
+        std::atomic<bool> done { false };
+        std::thread updater( [&] {
+            RegDataType block[8];
+            for ( RegDataType k = 0 ; k < 5000 ; ++k ) {
+                std::fill( std::begin( block ), std::end( block ), k );
+                writer.Write( 0, block );
+            }
+            done = true;
+        } );
+        size_t torn {};
+        uint32_t last {};
+        while ( !done ) {
+            if ( reader.Read( 0, regs, state ) ) {
+                torn += !std::all_of( regs, regs + 8, [&]( RegDataType v ) { return v == regs[0]; } );
+                torn += state.Sequence < last;
+                last = state.Sequence;
+            }
+        }
+        updater.join();
+        BOOST_TEST( torn == 0u );
+        BOOST_REQUIRE( reader.Read( 0, regs, state ) );
+        BOOST_TEST( regs[0] == 4999u );
+        BOOST_TEST( state.Sequence == 6u + 2u * 5000u );
+    }
+
+    BOOST_AUTO_TEST_CASE( RestartedWriterTakesOverTheImage )
+    {
+        std::vector<ProcessImageBlock> const layout {
+            { 1, FunctionCode::ReadInputRegisters, 0, 4 },
+            { 1, FunctionCode::ReadInputStatus, 0, 16 },
+        };
+        RegDataType const written[4] { 10, 20, 30, 40 };
+        std::unique_ptr<ProcessImageWriter> writer(
+            new ProcessImageWriter( _D( "ModbusTest.ProcessImage.Restart" ), layout )
+        );
+        ProcessImageReader reader( _D( "ModbusTest.ProcessImage.Restart" ) );
+        writer->Write( 0, written );
+        writer.reset();   // The reader keeps the section
+
+        writer.reset( new ProcessImageWriter( _D( "ModbusTest.ProcessImage.Restart" ), layout ) );
+        RegDataType regs[4] {};
+        ProcessImageBlockState state;
+        BOOST_REQUIRE( reader.Read( 0, regs, state ) );
+        BOOST_TEST( state.Valid );
+        BOOST_TEST( state.Sequence == 2u );
+        BOOST_TEST( std::equal( regs, regs + 4, written ) );
+        writer->Invalidate( 0 );
+        BOOST_TEST( reader.GetSequence( 0 ) == 4u );
+        BOOST_TEST( reader.GetSequence( 1 ) == 0u );
+
+        // Another layout cannot reuse the name
+        std::vector<ProcessImageBlock> other { layout[0] };
+        BOOST_CHECK_THROW(
+            ProcessImageWriter( _D( "ModbusTest.ProcessImage.Restart" ), other ), EBaseException
+        );
+        other.push_back( { 1, FunctionCode::ReadInputStatus, 0, 17 } );
+        BOOST_CHECK_THROW(
+            ProcessImageWriter( _D( "ModbusTest.ProcessImage.Restart" ), other ), EBaseException
+        );
+    }
+
+    BOOST_AUTO_TEST_CASE( ScannerPublishesEveryScan )
+    {
+        TagDatabase db;
+        size_t const aIdx =
+            db.Add( makeTag( "A", 1, TagTable::HoldingRegister, 20, ChangeDetect::TagType::UInt16 ) );
+        db.Add( makeTag( "B", 1, TagTable::HoldingRegister, 23, ChangeDetect::TagType::UInt16 ) );
+        db.Add( makeTag( "Gone", SCAN_FIRST_UNIT, TagTable::HoldingRegister, 0,
+                         ChangeDetect::TagType::UInt16 ) );
+        TagScanner scanner( proto_, db );
+        BOOST_REQUIRE( scanner.GetBlockCount() == 2u );
+
+        ProcessImageWriter writer( _D( "ModbusTest.ProcessImage.Scan" ), scanner.GetImageLayout() );
+        ProcessImageReader reader( _D( "ModbusTest.ProcessImage.Scan" ) );
+        scanner.SetProcessImage( &writer );
+        proto_.PresetSingleRegister( ctx(), 20, 1234 );
+        scanner.Scan();
+        BOOST_TEST( scanner.GetValue( aIdx ) == 1234.0 );
+
+        RegDataType regs[4] {};
+        ProcessImageBlockState state;
+        size_t const ok = reader.GetBlock( 0 ).SlaveAddr == 1 ? 0 : 1;
+        BOOST_REQUIRE( reader.GetBlock( ok ).PointCount == 4u );
+        BOOST_REQUIRE( reader.Read( ok, regs, state ) );
+        BOOST_TEST( state.Valid );
+        BOOST_TEST( regs[0] == 1234u );
+        BOOST_TEST( regs[3] == 23u );
+        BOOST_REQUIRE( reader.Read( 1 - ok, regs, state ) );
+        BOOST_TEST( !state.Valid );
+
+        uint32_t const sequence = reader.GetSequence( ok );
+        scanner.Scan();
+        BOOST_TEST( reader.GetSequence( ok ) == sequence + 2u );
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//---------------------------------------------------------------------------
+
+static std::wstring captureFile()
+{
+    return ( std::filesystem::temp_directory_path() / "ModbusTestCapture.mbcp" ).wstring();
+}
+
+static CaptureFrame rtuFrame( int64_t time, CaptureDirection dir, std::vector<uint8_t> bytes )
+{
+    uint8_t crc[2];
+    RTUFramingProtocol::WriteCRC( crc, bytes.begin(), bytes.end() );
+    bytes.insert( bytes.end(), crc, crc + 2 );
+    CaptureFrame frame;
+    frame.Time = time;
+    frame.LinkId = 2;
+    frame.Dir = dir;
+    frame.Framing = CaptureFraming::RTU;
+    frame.Data = bytes;
+    return frame;
+}
+
+BOOST_FIXTURE_TEST_SUITE( Wire_Capture, ProtoFixture )
+
+    BOOST_AUTO_TEST_CASE( RecordsAndReplaysTCPTraffic )
+    {
+        std::wstring const file = captureFile();
+        RTUOverTCPProtocolWinSock rtu( _D( "127.0.0.1" ), RTU_GATEWAY_PORT );
+        SessionManager rtuSession( rtu );
+        {
+            CaptureRecorder recorder( file.c_str() );
+            recorder.Attach( proto_, 7 );
+            recorder.Attach( rtu, 9 );
+            BOOST_CHECK_THROW( recorder.Attach( proto_, 8 ), EBaseException );
+            recorder.Start();
+
+            RegDataType regs[10];
+            proto_.ReadHoldingRegisters( ctx(), 0, 10, regs );
+            proto_.PresetSingleRegister( ctx(), 5, 0x5555 );
+            BOOST_CHECK_THROW( readH( proto_, 0, SCAN_FIRST_UNIT ), EProtocolException );
+
+            // Pipelined: every frame of the batch is reported on its own
+            RegDataType a[4], b[4], c[4];
+            Request batch[] {
+                Request::ReadHoldingRegisters( 1, 0, 4, a ),
+                Request::ReadInputRegisters( 1, 0, 4, b ),
+                Request::ReadHoldingRegisters( 1, 8, 4, c ),
+            };
+            BOOST_REQUIRE( proto_.Execute( batch, 3 ) == 3u );
+            rtu.ReadHoldingRegisters( Context( 1 ), 20, 4, regs );
+
+            recorder.Stop();
+            BOOST_TEST( recorder.GetFrameCount() == 14u );
+            BOOST_TEST( recorder.GetDroppedCount() == 0u );
+            BOOST_TEST( !recorder.HasFailed() );
+        }
+
+        std::vector<CaptureFrame> const frames = CaptureReader::Load( file.c_str() );
+        BOOST_REQUIRE( frames.size() == 14u );
+        BOOST_TEST( ( frames[0].Dir == CaptureDirection::TX ) );
+        BOOST_TEST( ( frames[1].Dir == CaptureDirection::RX ) );
+        BOOST_TEST( frames[0].LinkId == 7u );
+        BOOST_TEST( ( frames[0].Framing == CaptureFraming::MBAP ) );
+        BOOST_TEST( frames[0].Data.size() == 12u );      // MBAP header and FC03 request
+        BOOST_TEST( frames[1].Data.size() == 9u + 20u );
+        for ( size_t i = 1 ; i < 12 ; ++i ) {
+            BOOST_TEST( frames[i].Time >= frames[i - 1].Time );
+        }
+        BOOST_TEST( frames[12].LinkId == 9u );
+        BOOST_TEST( ( frames[12].Framing == CaptureFraming::RTU ) );
+        BOOST_TEST( frames[12].Data.size() == 8u );      // Unit, FC03 request, CRC
+
+        CaptureReplayer replayer( frames );
+        BOOST_TEST( replayer.GetTransactionCount() == 7u );
+        BOOST_TEST( replayer.GetSkippedCount() == 0u );
+        BOOST_TEST( replayer.GetUnansweredCount() == 0u );
+        for ( int pass = 0 ; pass < 2 ; ++pass ) {
+            ReplayResult const result = replayer.Replay();
+            BOOST_TEST( result.Transactions == 7u );
+            BOOST_TEST( result.Completed == 6u );
+            BOOST_TEST( result.Exceptions == 1u );
+            BOOST_TEST( result.Failed == 0u );
+        }
+        std::filesystem::remove( std::filesystem::path( file ) );
+    }
+
+    BOOST_AUTO_TEST_CASE( ReplaysRTUFramesAndCountsDamage )
+    {
+        std::vector<CaptureFrame> frames {
+            rtuFrame( 0, CaptureDirection::TX, { 1, 0x03, 0x00, 0x00, 0x00, 0x02 } ),
+            rtuFrame( 1000, CaptureDirection::RX, { 1, 0x03, 0x04, 0x00, 0x0A, 0x00, 0x0B } ),
+            rtuFrame( 20000, CaptureDirection::TX, { 1, 0x06, 0x00, 0x05, 0x12, 0x34 } ),
+            rtuFrame( 21000, CaptureDirection::RX, { 1, 0x06, 0x00, 0x05, 0x12, 0x34 } ),
+            rtuFrame( 30000, CaptureDirection::TX, { 1, 0x03, 0x00, 0x00, 0x00, 0x02 } ),
+            rtuFrame( 31000, CaptureDirection::RX, { 1, 0x03, 0x02, 0x00, 0x0A } ),   // Short
+            rtuFrame( 40000, CaptureDirection::TX, { 1, 0x2B, 0x0E, 0x01, 0x00 } ),
+            rtuFrame( 50000, CaptureDirection::TX, { 1, 0x03, 0x00, 0x00, 0x00, 0x01 } ),
+            rtuFrame( 51000, CaptureDirection::RX, { 1, 0x03, 0x02, 0x00, 0x0A } ),
+        };
+        frames.back().Data.back() ^= 0xFF;   // Bad CRC: the request stays unanswered
+
+        CaptureReplayer replayer( frames );
+        BOOST_TEST( replayer.GetTransactionCount() == 3u );
+        BOOST_TEST( replayer.GetSkippedCount() == 1u );     // FC43
+        BOOST_TEST( replayer.GetUnmatchedCount() == 1u );
+        BOOST_TEST( replayer.GetUnansweredCount() == 1u );
+
+        ReplayResult const result = replayer.Replay( ReplayMode::RealTime );
+        BOOST_TEST( result.Completed == 2u );
+        BOOST_TEST( result.Failed == 1u );                  // Byte count mismatch
+        BOOST_TEST( result.Elapsed >= std::chrono::milliseconds( 30 ) );
+
+        std::wstring const file = captureFile();
+        {
+            std::ofstream out( std::filesystem::path( file ), std::ios::binary );
+            out << "MBCP";
+        }
+        BOOST_CHECK_THROW( CaptureReader reader( file.c_str() ), EBaseException );
+        {
+            std::ofstream out( std::filesystem::path( file ), std::ios::binary );
+            out.write( "MBCP\x01\x00\x00\x00\x00\x00", 10 );
+        }
+        BOOST_CHECK_THROW( CaptureReader::Load( file.c_str() ), EBaseException );
+        std::filesystem::remove( std::filesystem::path( file ) );
+    }
+
+    BOOST_AUTO_TEST_CASE( ReplaysDiagnosticAndFileRecordRequests )
+    {
+        std::vector<CaptureFrame> const frames {
+            rtuFrame( 0, CaptureDirection::TX, { 1, 0x08, 0x00, 0x00, 0x12, 0x34 } ),
+            rtuFrame( 1000, CaptureDirection::RX, { 1, 0x08, 0x00, 0x00, 0x12, 0x34 } ),
+            rtuFrame( 2000, CaptureDirection::TX, { 1, 0x0B } ),
+            rtuFrame( 3000, CaptureDirection::RX, { 1, 0x0B, 0x00, 0x00, 0x00, 0x05 } ),
+            rtuFrame( 4000, CaptureDirection::TX,
+                      { 1, 0x14, 0x07, 0x06, 0x00, 0x04, 0x00, 0x01, 0x00, 0x02 } ),
+            rtuFrame( 5000, CaptureDirection::RX,
+                      { 1, 0x14, 0x06, 0x05, 0x06, 0x0D, 0xFE, 0x00, 0x20 } ),
+            rtuFrame( 6000, CaptureDirection::TX,
+                      { 1, 0x15, 0x0B, 0x06, 0x00, 0x04, 0x00, 0x07, 0x00, 0x02,
+                        0x06, 0xAF, 0x04, 0xBE } ),
+            rtuFrame( 7000, CaptureDirection::RX,
+                      { 1, 0x15, 0x0B, 0x06, 0x00, 0x04, 0x00, 0x07, 0x00, 0x02,
+                        0x06, 0xAF, 0x04, 0xBE } ),
+            // Reference type 5 is not a file record request
+            rtuFrame( 8000, CaptureDirection::TX,
+                      { 1, 0x14, 0x07, 0x05, 0x00, 0x04, 0x00, 0x01, 0x00, 0x02 } ),
+            // The FC21 record data is shorter than its record length
+            rtuFrame( 9000, CaptureDirection::TX,
+                      { 1, 0x15, 0x09, 0x06, 0x00, 0x04, 0x00, 0x07, 0x00, 0x02, 0x06, 0xAF } ),
+        };
+
+        CaptureReplayer replayer( frames );
+        BOOST_TEST( replayer.GetTransactionCount() == 4u );
+        BOOST_TEST( replayer.GetSkippedCount() == 2u );
+        BOOST_TEST( replayer.GetUnansweredCount() == 0u );
+
+        for ( int pass = 0 ; pass < 2 ; ++pass ) {
+            ReplayResult const result = replayer.Replay();
+            BOOST_TEST( result.Transactions == 4u );
+            BOOST_TEST( result.Completed == 4u );
+            BOOST_TEST( result.Failed == 0u );
+        }
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//---------------------------------------------------------------------------
+// Request scheduler — the first request holds the link until the gate opens,
+// so the order of the queued ones is decided by priority and aging alone
+//---------------------------------------------------------------------------
+
+struct GatedProtocol : DummyProtocol {
+    std::promise<void>       gate;
+    std::shared_future<void> opened { gate.get_future().share() };
+    std::atomic<bool>        entered {};
+    std::vector<uint16_t>    order;     // addresses, in the order they reached the link
+
+protected:
+    void DoReadHoldingRegisters( Context const & Context, RegAddrType StartAddr,
+                                 RegCountType PointCount,
+                                 RegDataType* Data ) noexcept override
+    {
+        pass( StartAddr );
+    }
+    void DoPresetSingleRegister( Context const & Context, RegAddrType Addr,
+                                 RegDataType Data ) noexcept override
+    {
+        pass( Addr );
+    }
+private:
+    void pass( uint16_t addr )
+    {
+        order.push_back( addr );
+        entered = true;
+        opened.wait();
+    }
+};
+
+static void waitUntilEntered( GatedProtocol const & proto )
+{
+    while ( !proto.entered )
+        std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+}
+
+BOOST_AUTO_TEST_SUITE( Request_Scheduler )
+
+    BOOST_AUTO_TEST_CASE( ControlWriteOvertakesQueuedPolls )
+    {
+        GatedProtocol proto;
+        SessionManager session( proto );
+        RequestScheduler scheduler( proto, 0 );
+        RegDataType v[8] = {};
+
+        std::vector<std::future<Request>> results;
+        results.push_back( scheduler.Submit( Request::ReadHoldingRegisters( 1, 0, 1, v ),
+                                             RequestPriority::Background ) );
+        waitUntilEntered( proto );
+        for ( uint16_t addr = 1; addr <= 5; ++addr )
+            results.push_back( scheduler.Submit( Request::ReadHoldingRegisters( 1, addr, 1, v ),
+                                                 RequestPriority::Background ) );
+        results.push_back( scheduler.Submit( Request::ReadHoldingRegisters( 1, 10, 1, v ),
+                                             RequestPriority::Trend ) );
+        results.push_back( scheduler.Submit( Request::PresetSingleRegister( 1, 100, 0x55 ),
+                                             RequestPriority::Control ) );
+        BOOST_TEST( scheduler.GetPendingCount() == 7u );
+
+        proto.gate.set_value();
+        for ( auto& result : results )
+            BOOST_CHECK( result.get().Status == RequestStatus::Completed );
+        std::vector<uint16_t> const expected { 0, 100, 10, 1, 2, 3, 4, 5 };
+        BOOST_TEST( proto.order == expected, boost::test_tools::per_element() );
+    }
+
+    BOOST_AUTO_TEST_CASE( AgingPreventsStarvationButNotAboveAlarm )
+    {
+        GatedProtocol proto;
+        SessionManager session( proto );
+        RequestScheduler scheduler( proto, 20 );
+        RegDataType v[1] = {};
+
+        std::vector<std::future<Request>> results;
+        results.push_back( scheduler.Submit( Request::ReadHoldingRegisters( 1, 0, 1, v ),
+                                             RequestPriority::Background ) );
+        waitUntilEntered( proto );
+        results.push_back( scheduler.Submit( Request::ReadHoldingRegisters( 1, 1, 1, v ),
+                                             RequestPriority::Background ) );
+        std::this_thread::sleep_for( std::chrono::milliseconds( 80 ) );   // aged up to Alarm
+        results.push_back( scheduler.Submit( Request::ReadHoldingRegisters( 1, 10, 1, v ),
+                                             RequestPriority::Trend ) );
+        results.push_back( scheduler.Submit( Request::ReadHoldingRegisters( 1, 20, 1, v ),
+                                             RequestPriority::Alarm ) );
+        Request control = Request::PresetSingleRegister( 1, 30, 1 );
+        control.Policy.Priority = static_cast<int>( RequestPriority::Control );
+        results.push_back( scheduler.Submit( control ) );
+
+        proto.gate.set_value();
+        for ( auto& result : results )
+            result.wait();
+        std::vector<uint16_t> const expected { 0, 30, 1, 20, 10 };
+        BOOST_TEST( proto.order == expected, boost::test_tools::per_element() );
+    }
+
+    BOOST_AUTO_TEST_CASE( StopFailsTheQueuedRequests )
+    {
+        GatedProtocol proto;
+        SessionManager session( proto );
+        RequestScheduler scheduler( proto );
+        RegDataType v[1] = {};
+
+        auto first = scheduler.Submit( Request::ReadHoldingRegisters( 1, 0, 1, v ),
+                                       RequestPriority::Trend );
+        waitUntilEntered( proto );
+        auto queued = scheduler.Submit( Request::ReadHoldingRegisters( 1, 1, 1, v ),
+                                        RequestPriority::Trend );
+
+        std::thread opener( [&proto]() {
+            std::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );
+            proto.gate.set_value();
+        } );
+        scheduler.Stop();
+        opener.join();
+
+        BOOST_CHECK( first.get().Status == RequestStatus::Completed );
+        Request const failed = queued.get();
+        BOOST_CHECK( failed.Status == RequestStatus::Failed );
+        BOOST_TEST( failed.ErrorMessage.Length() > 0 );
+        BOOST_CHECK_THROW( (void)scheduler.Submit( Request::ReadHoldingRegisters( 1, 0, 1, v ),
+                                                   RequestPriority::Control ),
+                           EBaseException );
+    }
+
+    BOOST_AUTO_TEST_CASE( ClosedProtocolFailsTheRequest )
+    {
+        DummyProtocol proto;
+        RequestScheduler scheduler( proto );
+        RegDataType v[1] = {};
+        Request const result =
+            scheduler.Submit( Request::ReadHoldingRegisters( 1, 0, 1, v ),
+                              RequestPriority::Control ).get();
+        BOOST_CHECK( result.Status == RequestStatus::Failed );
+    }
+
+    BOOST_AUTO_TEST_CASE( ForeignExceptionReachesTheFuture )
+    {
+        struct ThrowingProtocol : GatedProtocol {
+        protected:
+            void DoExecute( Request* Requests, size_t RequestCount ) override
+            {
+                if ( Requests->Addr == 99 )
+                    throw std::runtime_error( "not a VCL exception" );
+                GatedProtocol::DoExecute( Requests, RequestCount );
+            }
+        } proto;
+        SessionManager session( proto );
+        RequestScheduler scheduler( proto, 0 );
+        RegDataType v[1] = {};
+
+        std::vector<std::future<Request>> results;
+        results.push_back( scheduler.Submit( Request::ReadHoldingRegisters( 1, 0, 1, v ),
+                                             RequestPriority::Background ) );
+        waitUntilEntered( proto );
+        auto failing = scheduler.Submit( Request::ReadHoldingRegisters( 1, 99, 1, v ),
+                                         RequestPriority::Trend );
+        // Out-of-range priorities are clamped, with or without a policy
+        results.push_back( scheduler.Submit( Request::ReadHoldingRegisters( 1, 1, 1, v ),
+                                             static_cast<RequestPriority>( -5 ) ) );
+        results.push_back( scheduler.Submit( Request::ReadHoldingRegisters( 1, 2, 1, v ),
+                                             static_cast<RequestPriority>( 42 ) ) );
+        Request urgent = Request::ReadHoldingRegisters( 1, 3, 1, v );
+        urgent.Policy.Priority = 1000;
+        results.push_back( scheduler.Submit( urgent ) );
+
+        proto.gate.set_value();
+        BOOST_CHECK_THROW( failing.get(), std::runtime_error );
+        for ( auto& result : results )
+            BOOST_CHECK( result.get().Status == RequestStatus::Completed );
+        std::vector<uint16_t> const expected { 0, 2, 3, 1 };
+        BOOST_TEST( proto.order == expected, boost::test_tools::per_element() );
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#if defined( MODBUS_TEST_TLS )
+
+//---------------------------------------------------------------------------
+// Modbus/TCP Security — a TLS slave on 127.0.0.1:5802 with a self-signed
+// certificate (SAN IP:127.0.0.1) generated at start-up.  It serves one
+// connection at a time and issues TLS 1.3 session tickets (OpenSSL default).
+//---------------------------------------------------------------------------
+
+static const uint16_t TLS_SERVER_PORT = 5802;
+
+static bool tlsRecvAll( SSL* ssl, uint8_t* buf, int len )
+{
+    int done = 0;
+    while ( done < len ) {
+        int r = SSL_read( ssl, buf + done, len - done );
+        if ( r <= 0 ) return false;
+        done += r;
+    }
+    return true;
+}
+
+static bool handleTlsRequest( SSL* ssl )
+{
+    uint8_t header[6];
+    if ( !tlsRecvAll( ssl, header, 6 ) ) return false;
+    uint16_t remaining = get16( header + 4 );
+    if ( remaining < 2 ) return false;
+    std::vector<uint8_t> body( remaining );
+    if ( !tlsRecvAll( ssl, body.data(), remaining ) ) return false;
+    auto frame = buildFrame( get16( header ), body[0],
+                             dispatchPdu( body[1], body.data() + 2, remaining - 2 ) );
+    return SSL_write( ssl, frame.data(), static_cast<int>( frame.size() ) ) > 0;
+}
+
+struct TLSServer {
+    TLSServer()
+        : key_( EVP_EC_gen( "P-256" ) ), cert_( X509_new() )
+        , ctx_( SSL_CTX_new( TLS_server_method() ) )
+    {
+        X509_set_version( cert_, 2 );
+        ASN1_INTEGER_set( X509_get_serialNumber( cert_ ), 1 );
+        X509_gmtime_adj( X509_getm_notBefore( cert_ ), -3600 );
+        X509_gmtime_adj( X509_getm_notAfter( cert_ ), 86400 );
+        X509_NAME* name = X509_get_subject_name( cert_ );
+        X509_NAME_add_entry_by_txt( name, "CN", MBSTRING_ASC,
+                                    reinterpret_cast<const unsigned char*>( "Modbus test slave" ),
+                                    -1, -1, 0 );
+        X509_set_issuer_name( cert_, name );
+        X509_set_pubkey( cert_, key_ );
+        X509V3_CTX v3;
+        X509V3_set_ctx_nodb( &v3 );
+        X509V3_set_ctx( &v3, cert_, cert_, nullptr, nullptr, 0 );
+        X509_EXTENSION* san = X509V3_EXT_conf_nid( nullptr, &v3, NID_subject_alt_name,
+                                                   "IP:127.0.0.1" );
+        X509_add_ext( cert_, san, -1 );
+        X509_EXTENSION_free( san );
+        X509_sign( cert_, key_, EVP_sha256() );
+
+        SSL_CTX_use_certificate( ctx_, cert_ );
+        SSL_CTX_use_PrivateKey( ctx_, key_ );
+
+        caFile_ = ( std::filesystem::temp_directory_path() / "ModbusTestTLS_CA.pem" ).string();
+        FILE* f = std::fopen( caFile_.c_str(), "w" );
+        PEM_write_X509( f, cert_ );
+        std::fclose( f );
+
+        std::promise<void> ready;
+        std::future<void> readyFuture = ready.get_future();
+        thread_ = std::thread( &TLSServer::Run, this, std::move( ready ) );
+        readyFuture.wait();
+    }
+    ~TLSServer()
+    {
+        stop_ = true;
+        thread_.join();
+        SSL_CTX_free( ctx_ );
+        X509_free( cert_ );
+        EVP_PKEY_free( key_ );
+        std::remove( caFile_.c_str() );
+    }
+    String CAFile() const { return String( caFile_.c_str() ); }
+    std::atomic<int> Handshakes { 0 };
+    std::atomic<int> Resumptions { 0 };
+private:
+    EVP_PKEY*         key_;
+    X509*             cert_;
+    SSL_CTX*          ctx_;
+    std::string       caFile_;
+    std::atomic<bool> stop_ { false };
+    std::thread       thread_;
+
+    void Run( std::promise<void> readyPromise )
+    {
+        SOCKET listenSock = socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
+        int reuseAddr = 1;
+        setsockopt( listenSock, SOL_SOCKET, SO_REUSEADDR,
+                    reinterpret_cast<const char*>( &reuseAddr ), sizeof( reuseAddr ) );
+        sockaddr_in addr4 = {};
+        addr4.sin_family      = AF_INET;
+        addr4.sin_port        = htons( TLS_SERVER_PORT );
+        addr4.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+        bind  ( listenSock, reinterpret_cast<sockaddr*>( &addr4 ), sizeof( addr4 ) );
+        listen( listenSock, SOMAXCONN );
+
+        readyPromise.set_value();
+
+        while ( !stop_ ) {
+            fd_set readSet;
+            FD_ZERO( &readSet );
+            FD_SET( listenSock, &readSet );
+            timeval tv = { 0, 100000 }; // 100 ms
+            if ( select( 0, &readSet, nullptr, nullptr, &tv ) <= 0 ) continue;
+            SOCKET clientSock = accept( listenSock, nullptr, nullptr );
+            if ( clientSock == INVALID_SOCKET ) continue;
+            DWORD readTimeout = 2000;
+            setsockopt( clientSock, SOL_SOCKET, SO_RCVTIMEO,
+                        reinterpret_cast<const char*>( &readTimeout ), sizeof( readTimeout ) );
+            SSL* ssl = SSL_new( ctx_ );
+            SSL_set_fd( ssl, static_cast<int>( clientSock ) );
+            if ( SSL_accept( ssl ) == 1 ) {
+                ++Handshakes;
+                if ( SSL_session_reused( ssl ) ) ++Resumptions;
+                while ( !stop_ && handleTlsRequest( ssl ) ) {}
+            }
+            SSL_free( ssl );
+            closesocket( clientSock );
+        }
+        closesocket( listenSock );
+    }
+};
+
+struct TLSFixture {
+    TLSFixture()
+        : tls_( std::make_shared<TLSClientContext>() )
+    {
+        initRegisters();
+        tls_->SetCAFile( server_.CAFile() );
+    }
+    TLSServer                         server_;
+    std::shared_ptr<TLSClientContext> tls_;
+};
+
+BOOST_FIXTURE_TEST_SUITE( TCP_Security, TLSFixture )
+
+    BOOST_AUTO_TEST_CASE( ReadsAndWritesOverTLS )
+    {
+        TCPSecurityProtocolWinSock proto( tls_, _D( "127.0.0.1" ), TLS_SERVER_PORT );
+        SessionManager session( proto );
+        BOOST_TEST( readH( proto, 30 ) == 30u );
+        proto.PresetSingleRegister( ctx(), 31, 0xBEEF );
+        BOOST_TEST( readH( proto, 31 ) == 0xBEEFu );
+        BOOST_TEST( !proto.IsSessionResumed() );
+    }
+
+    BOOST_AUTO_TEST_CASE( ReconnectResumesTheSession )
+    {
+        TCPSecurityProtocolWinSock proto( tls_, _D( "127.0.0.1" ), TLS_SERVER_PORT );
+        proto.Open();
+        BOOST_TEST( readH( proto, 1 ) == 1u );  // the ticket arrives with the response
+        proto.Close();
+
+        proto.Open();
+        BOOST_TEST( proto.IsSessionResumed() );
+        BOOST_TEST( readH( proto, 2 ) == 2u );
+        proto.Close();
+
+        // The cache belongs to the context: another master resumes as well
+        TCPSecurityProtocolWinSock other( tls_, _D( "127.0.0.1" ), TLS_SERVER_PORT );
+        SessionManager session( other );
+        BOOST_TEST( other.IsSessionResumed() );
+        BOOST_TEST( readH( other, 3 ) == 3u );
+        BOOST_TEST( server_.Resumptions == 2 );
+    }
+
+    BOOST_AUTO_TEST_CASE( IdleConnectionIsReused )
+    {
+        tls_->SetMaxIdleConnections( 1 );
+        {
+            TCPSecurityProtocolWinSock proto( tls_, _D( "127.0.0.1" ), TLS_SERVER_PORT );
+            SessionManager session( proto );
+            BOOST_TEST( !proto.IsConnectionReused() );
+            BOOST_TEST( readH( proto, 4 ) == 4u );
+        }
+        TCPSecurityProtocolWinSock proto( tls_, _D( "127.0.0.1" ), TLS_SERVER_PORT );
+        SessionManager session( proto );
+        BOOST_TEST( proto.IsConnectionReused() );
+        BOOST_TEST( readH( proto, 5 ) == 5u );
+        BOOST_TEST( server_.Handshakes == 1 );
+    }
+
+    BOOST_AUTO_TEST_CASE( UntrustedServerIsRejected )
+    {
+        auto untrusting = std::make_shared<TLSClientContext>();
+        TCPSecurityProtocolWinSock proto( untrusting, _D( "127.0.0.1" ), TLS_SERVER_PORT );
+        BOOST_CHECK_THROW( proto.Open(), EBaseException );
+        BOOST_TEST( !proto.IsConnected() );
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif // MODBUS_TEST_TLS
+
 //---------------------------------------------------------------------------
 // Entry point bridge for Unicode startup.
 // When _TCHAR maps to wchar_t, startup calls wmain; Boost.Test provides main.